@@ -66,6 +66,9 @@
 /* HTTP */
 #include <pjlib-util/http_client.h>
 
+/* Metrics */
+#include <pjlib-util/metrics.h>
+
 /** CLI **/
 #include <pjlib-util/cli.h>
 #include <pjlib-util/cli_console.h>
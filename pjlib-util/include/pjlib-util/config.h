@@ -205,6 +205,30 @@
 #endif
 
 
+/**
+ * Size of the name hash table of the DNS server (dns_server.c). Records
+ * are looked up by name, so the table should be large enough for the
+ * number of distinct names served, e.g. from a zone file.
+ *
+ * Default: 1023
+ */
+#ifndef PJ_DNS_SERVER_HASH_SIZE
+#   define PJ_DNS_SERVER_HASH_SIZE                  1023
+#endif
+
+
+/**
+ * Number of simultaneous read operations of the DNS server socket. More
+ * than one allows the server to answer from several ioqueue polling
+ * threads at once.
+ *
+ * Default: 4
+ */
+#ifndef PJ_DNS_SERVER_ASYNC_CNT
+#   define PJ_DNS_SERVER_ASYNC_CNT                  4
+#endif
+
+
 /* **************************************************************************
  * SCANNER CONFIGURATION
  */
@@ -263,6 +287,31 @@
 #   define PJ_CRC32_HAS_TABLES                      1
 #endif
 
+/**
+ * Specifies whether the table based CRC32 should process eight bytes at a
+ * time using eight lookup tables ("slicing-by-8"). This is several times
+ * faster for larger inputs such as STUN/TURN packets, at the expense of
+ * additional 7KB of tables. It is only used on little-endian platforms and
+ * when PJ_CRC32_HAS_TABLES is enabled.
+ *
+ * Default: 1
+ */
+#ifndef PJ_CRC32_SLICE_BY_8
+#   define PJ_CRC32_SLICE_BY_8                      1
+#endif
+
+/**
+ * Specifies whether SHA1 should use the SHA instructions of the CPU
+ * (Intel SHA extensions) when they are available. Support is detected at
+ * run-time, so the same binary still works on CPUs without them. This
+ * currently only applies to x86/x86-64 builds with GCC or clang.
+ *
+ * Default: 1
+ */
+#ifndef PJ_SHA1_USE_HW_ACCEL
+#   define PJ_SHA1_USE_HW_ACCEL                     1
+#endif
+
 
 /* **************************************************************************
  * HTTP Client configuration
@@ -275,6 +324,173 @@
 #   define PJ_HTTP_DEFAULT_TIMEOUT         (60000)
 #endif
 
+/**
+ * Default maximum number of connections to the same scheme, host and port
+ * in an HTTP connection pool (pj_http_conn_pool_param.max_conn_per_host).
+ *
+ * Default: 4
+ */
+#ifndef PJ_HTTP_POOL_MAX_CONN_PER_HOST
+#   define PJ_HTTP_POOL_MAX_CONN_PER_HOST  4
+#endif
+
+/**
+ * Default maximum number of idle connections kept by an HTTP connection
+ * pool (pj_http_conn_pool_param.max_idle).
+ *
+ * Default: 8
+ */
+#ifndef PJ_HTTP_POOL_MAX_IDLE
+#   define PJ_HTTP_POOL_MAX_IDLE           8
+#endif
+
+/**
+ * Default time an idle connection is kept in an HTTP connection pool
+ * (pj_http_conn_pool_param.idle_timeout). The value is in ms.
+ *
+ * Default: 30000ms
+ */
+#ifndef PJ_HTTP_POOL_IDLE_TIMEOUT
+#   define PJ_HTTP_POOL_IDLE_TIMEOUT       (30000)
+#endif
+
+/* **************************************************************************
+ * XML configuration
+ */
+
+/**
+ * Maximum nesting level of elements supported by the XML pull reader
+ * (pj_xml_reader). Documents nested deeper than this will be rejected.
+ *
+ * Default: 32
+ */
+#ifndef PJ_XML_READER_MAX_DEPTH
+#   define PJ_XML_READER_MAX_DEPTH         32
+#endif
+
+/**
+ * Maximum number of attributes in a single element that can be returned
+ * by the XML pull reader. Elements with more attributes will be rejected.
+ *
+ * Default: 16
+ */
+#ifndef PJ_XML_READER_MAX_ATTR
+#   define PJ_XML_READER_MAX_ATTR          16
+#endif
+
+/**
+ * Maximum number of namespace declarations that can be in scope at the
+ * same time, when the XML pull reader is created with PJ_XML_READER_NS
+ * option.
+ *
+ * Default: 16
+ */
+#ifndef PJ_XML_READER_MAX_NS
+#   define PJ_XML_READER_MAX_NS            16
+#endif
+
+/* **************************************************************************
+ * JSON configuration
+ */
+
+/**
+ * Maximum nesting level of objects and arrays supported by the JSON
+ * pull reader (pj_json_reader) and stream writer (pj_json_stream_writer).
+ * Since pj_json_parse(), pj_json_write() and pj_json_writef() are built
+ * on them, the limit applies to these functions too: documents and
+ * elements nested deeper than this will be rejected.
+ *
+ * Default: 64
+ */
+#ifndef PJ_JSON_MAX_DEPTH
+#   define PJ_JSON_MAX_DEPTH               64
+#endif
+
+/**
+ * Size of the temporary buffer allocated in the stack by pj_json_writef()
+ * to coalesce small text chunks before they are given to the writer
+ * callback.
+ *
+ * Default: 512 bytes
+ */
+#ifndef PJ_JSON_WRITE_BUF_SIZE
+#   define PJ_JSON_WRITE_BUF_SIZE          512
+#endif
+
+/* **************************************************************************
+ * PCAP configuration
+ */
+
+/**
+ * Use mmap() to map the capture file in pj_pcap_map(). When this is
+ * disabled, pj_pcap_map() reads the whole file into memory allocated from
+ * the pool instead.
+ *
+ * Default: 1 on platforms with unistd.h, 0 otherwise.
+ */
+#ifndef PJ_PCAP_HAS_MMAP
+#   if defined(PJ_HAS_UNISTD_H) && PJ_HAS_UNISTD_H != 0
+#       define PJ_PCAP_HAS_MMAP            1
+#   else
+#       define PJ_PCAP_HAS_MMAP            0
+#   endif
+#endif
+
+/**
+ * Number of hash table buckets used to demultiplex the flows found
+ * by pj_pcap_read_udp_pkt().
+ *
+ * Default: 127
+ */
+#ifndef PJ_PCAP_FLOW_HASH_SIZE
+#   define PJ_PCAP_FLOW_HASH_SIZE          127
+#endif
+
+/* **************************************************************************
+ * Metrics configuration
+ */
+
+/**
+ * Number of per-thread shards of each counter and histogram. Threads are
+ * assigned to the shards in round robin, so the shards are only contended
+ * when there are more threads updating a metric than shards. Each shard
+ * takes at least one cache line.
+ *
+ * Default: 16
+ */
+#ifndef PJ_METRICS_SHARD_CNT
+#   define PJ_METRICS_SHARD_CNT            16
+#endif
+
+/**
+ * Maximum number of buckets of a histogram, not including the "+Inf"
+ * bucket.
+ *
+ * Default: 32
+ */
+#ifndef PJ_METRICS_MAX_BUCKETS
+#   define PJ_METRICS_MAX_BUCKETS          32
+#endif
+
+/**
+ * Size of the hash table to find metrics by name.
+ *
+ * Default: 63
+ */
+#ifndef PJ_METRICS_HASH_SIZE
+#   define PJ_METRICS_HASH_SIZE            63
+#endif
+
+/**
+ * Size of the buffer allocated in the stack by pj_metrics_write() to
+ * coalesce the output before it is given to the writer callback.
+ *
+ * Default: 512 bytes
+ */
+#ifndef PJ_METRICS_WRITE_BUF_SIZE
+#   define PJ_METRICS_WRITE_BUF_SIZE       512
+#endif
+
 /* **************************************************************************
  * CLI configuration
  */
@@ -25,6 +25,7 @@
  */
 #include <pjlib-util/types.h>
 #include <pjlib-util/dns.h>
+#include <pj/timer.h>
 
 PJ_BEGIN_DECL
 
@@ -35,6 +36,12 @@ PJ_BEGIN_DECL
  * This contains a simple but fully working DNS server implementation, 
  * mostly for testing purposes. It supports serving various DNS resource 
  * records such as SRV, CNAME, A, and AAAA.
+ *
+ * Records are kept in a hash table keyed by name, and can be loaded in
+ * bulk from a zone file with #pj_dns_server_load_zone(), so the server
+ * can stand in for a real one when load testing the resolver offline.
+ * Network conditions can be simulated with #pj_dns_server_set_impair():
+ * answers may be delayed, dropped, or truncated (TC bit set).
  */
 
 /**
@@ -42,6 +49,48 @@ PJ_BEGIN_DECL
  */
 typedef struct pj_dns_server pj_dns_server;
 
+/**
+ * Network impairments simulated by the DNS server.
+ */
+typedef struct pj_dns_server_impair
+{
+    /**
+     * Delay added to every answer, in milliseconds.
+     */
+    unsigned    delay_msec;
+
+    /**
+     * Additional random delay, between zero and this value, in
+     * milliseconds.
+     */
+    unsigned    jitter_msec;
+
+    /**
+     * Percentage of queries to be silently dropped.
+     */
+    unsigned    loss_pct;
+
+    /**
+     * Percentage of answers to be sent truncated, i.e. with TC bit set and
+     * without any resource records.
+     */
+    unsigned    tc_pct;
+
+} pj_dns_server_impair;
+
+/**
+ * DNS server statistics.
+ */
+typedef struct pj_dns_server_stat
+{
+    unsigned    rx_cnt;         /**< Number of queries received.        */
+    unsigned    tx_cnt;         /**< Number of answers sent.            */
+    unsigned    drop_cnt;       /**< Number of queries dropped.         */
+    unsigned    tc_cnt;         /**< Number of truncated answers.       */
+    unsigned    nxdomain_cnt;   /**< Number of NXDOMAIN answers.        */
+    unsigned    err_cnt;        /**< Number of invalid queries.         */
+} pj_dns_server_stat;
+
 /**
  * Create the DNS server instance. The instance will run immediately.
  *
@@ -88,20 +137,23 @@ PJ_DECL(pj_status_t) pj_dns_server_destroy(pj_dns_server *srv);
 
 
 /**
- * Add generic resource record entries to the server.
+ * Add generic resource record entries to the server. Several records of
+ * the same name and type (e.g. SRV or A records) form a set, and they are
+ * all returned in the answer. The names are copied by the server.
  *
  * @param srv       The DNS server instance.
  * @param count     Number of records to be added.
  * @param rr        Array of records to be added.
  *
- * @return          PJ_SUCCESS on success or the appropriate error code.
+ * @return          PJ_SUCCESS on success, PJ_EEXISTS if an identical
+ *                  record exists, or the appropriate error code.
  */
 PJ_DECL(pj_status_t) pj_dns_server_add_rec(pj_dns_server *srv,
                                            unsigned count,
                                            const pj_dns_parsed_rr rr[]);
 
 /**
- * Remove the specified record from the server.
+ * Remove the records of the specified name and type from the server.
  *
  * @param srv       The DNS server instance.
  * @param dns_class The resource's DNS class. Valid value is PJ_DNS_CLASS_IN.
@@ -115,6 +167,64 @@ PJ_DECL(pj_status_t) pj_dns_server_del_rec(pj_dns_server *srv,
                                            pj_dns_type type,
                                            const pj_str_t *name);
 
+/**
+ * Add the records of a zone in master file format (RFC 1035 section 5).
+ * Supported directives are $ORIGIN and $TTL, and supported record types
+ * are A, AAAA, CNAME, NS, PTR, and SRV in class IN. Records of other
+ * types (e.g. SOA, NAPTR, or TXT) are skipped.
+ *
+ * @param srv       The DNS server instance.
+ * @param zone      The zone text.
+ * @param p_count   Optional pointer to receive the number of records
+ *                  added.
+ *
+ * @return          PJ_SUCCESS on success, or PJ_EINVAL if the zone
+ *                  contains a malformed record, in which case the
+ *                  records preceding it have been added.
+ */
+PJ_DECL(pj_status_t) pj_dns_server_add_zone(pj_dns_server *srv,
+                                            const pj_str_t *zone,
+                                            unsigned *p_count);
+
+/**
+ * Load a zone file, see #pj_dns_server_add_zone().
+ *
+ * @param srv       The DNS server instance.
+ * @param filename  The zone file.
+ * @param p_count   Optional pointer to receive the number of records
+ *                  added.
+ *
+ * @return          PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_server_load_zone(pj_dns_server *srv,
+                                             const char *filename,
+                                             unsigned *p_count);
+
+/**
+ * Set the network impairments to be simulated. Answer delay requires a
+ * timer heap, which must be polled by the application.
+ *
+ * @param srv       The DNS server instance.
+ * @param timer_heap The timer heap, or NULL if no delay is configured.
+ * @param impair    The impairments, or NULL to disable them.
+ *
+ * @return          PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_server_set_impair(
+                                        pj_dns_server *srv,
+                                        pj_timer_heap_t *timer_heap,
+                                        const pj_dns_server_impair *impair);
+
+/**
+ * Get the server statistics.
+ *
+ * @param srv       The DNS server instance.
+ * @param stat      The statistics.
+ *
+ * @return          PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_dns_server_get_stat(pj_dns_server *srv,
+                                            pj_dns_server_stat *stat);
 
 
 /**
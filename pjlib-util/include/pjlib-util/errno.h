@@ -393,6 +393,11 @@
  * Connection lost
  */
 #define PJLIB_UTIL_EHTTPLOST        (PJLIB_UTIL_ERRNO_START+155)/* 320155 */
+/**
+ * @hideinitializer
+ * Invalid chunked Transfer-Encoding
+ */
+#define PJLIB_UTIL_EHTTPINCHUNK     (PJLIB_UTIL_ERRNO_START+156)/* 320156 */
 
 /************************************************************
  * CLI ERROR
@@ -32,8 +32,12 @@ PJ_BEGIN_DECL
  * @ingroup PJ_PROTOCOLS
  * @{
  * This contains a simple HTTP client implementation.
+ * Responses with chunked Transfer-Encoding are decoded transparently.
+ * Requests may share persistent (keep-alive) connections by using a
+ * connection pool (#pj_http_conn_pool).
  * Some known limitations: 
- * - Does not support chunked Transfer-Encoding.
+ * - Does not support request pipelining; a connection carries one
+ *   request at a time.
  */
 
 /**
@@ -41,6 +45,11 @@ PJ_BEGIN_DECL
  */
 typedef struct pj_http_req pj_http_req;
 
+/**
+ * This opaque structure describes a pool of persistent HTTP connections.
+ */
+typedef struct pj_http_conn_pool pj_http_conn_pool;
+
 /**
  * Defines the maximum number of elements in a pj_http_headers
  * structure.
@@ -217,6 +226,19 @@ typedef struct pj_http_req_param
      */
     pj_uint16_t         max_retries;
 
+    /**
+     * Optional connection pool. If set, the request is sent over an idle
+     * connection to the same scheme, host and port if one is available,
+     * and its connection is returned to the pool instead of being closed
+     * when the response allows it (HTTP/1.1 without "Connection: close",
+     * or HTTP/1.0 with "Connection: keep-alive", and a body delimited by
+     * Content-Length or chunked encoding). The pool must have been created
+     * with the same timer heap and ioqueue as the request.
+     *
+     * Default is NULL (a new connection is created for each request).
+     */
+    pj_http_conn_pool  *conn_pool;
+
 } pj_http_req_param;
 
 /**
@@ -483,6 +505,102 @@ PJ_DECL(pj_bool_t) pj_http_req_is_running(const pj_http_req *http_req);
  */
 PJ_DECL(void *) pj_http_req_get_user_data(pj_http_req *http_req);
 
+/**
+ * HTTP connection pool settings.
+ */
+typedef struct pj_http_conn_pool_param
+{
+    /**
+     * Maximum number of connections, active and idle, to the same
+     * scheme, host and port. Requests started while all of them are busy
+     * are queued until one of them is released. The request timeout
+     * includes the time spent in the queue.
+     *
+     * Default is PJ_HTTP_POOL_MAX_CONN_PER_HOST.
+     */
+    unsigned            max_conn_per_host;
+
+    /**
+     * Maximum number of idle connections kept by the pool across all
+     * hosts. A released connection is closed if the limit has been
+     * reached.
+     *
+     * Default is PJ_HTTP_POOL_MAX_IDLE.
+     */
+    unsigned            max_idle;
+
+    /**
+     * Idle connections are closed after being unused for this long.
+     *
+     * Default is PJ_HTTP_POOL_IDLE_TIMEOUT.
+     */
+    pj_time_val         idle_timeout;
+
+} pj_http_conn_pool_param;
+
+/**
+ * HTTP connection pool statistics.
+ */
+typedef struct pj_http_conn_pool_stat
+{
+    unsigned    created;    /**< Number of connections created.         */
+    unsigned    reused;     /**< Number of requests sent over a
+                                 connection taken from the pool.        */
+    unsigned    idle;       /**< Current number of idle connections.    */
+    unsigned    queued;     /**< Current number of requests waiting for
+                                 a connection.                          */
+} pj_http_conn_pool_stat;
+
+/**
+ * Initialize the connection pool settings with the default values.
+ *
+ * @param param         The settings to be initialized.
+ */
+PJ_DECL(void) pj_http_conn_pool_param_default(pj_http_conn_pool_param *param);
+
+/**
+ * Create a pool of persistent HTTP connections, to be shared by requests
+ * via pj_http_req_param.conn_pool.
+ *
+ * @param pool          Pool whose factory will be used to create the
+ *                      connection pool's own memory pools.
+ * @param timer         Timer heap for idle timeouts. Requests using the
+ *                      pool must use the same timer heap.
+ * @param ioqueue       Ioqueue for the connections. Requests using the
+ *                      pool must use the same ioqueue.
+ * @param param         Optional settings, NULL for default.
+ * @param p_cpool       Pointer to receive the connection pool.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_http_conn_pool_create(
+                                    pj_pool_t *pool,
+                                    pj_timer_heap_t *timer,
+                                    pj_ioqueue_t *ioqueue,
+                                    const pj_http_conn_pool_param *param,
+                                    pj_http_conn_pool **p_cpool);
+
+/**
+ * Get the connection pool statistics.
+ *
+ * @param cpool         The connection pool.
+ * @param stat          Pointer to receive the statistics.
+ */
+PJ_DECL(void) pj_http_conn_pool_get_stat(pj_http_conn_pool *cpool,
+                                         pj_http_conn_pool_stat *stat);
+
+/**
+ * Close all idle connections and destroy the connection pool. The pool
+ * can only be destroyed once no request is using or waiting for its
+ * connections.
+ *
+ * @param cpool         The connection pool.
+ *
+ * @return              PJ_SUCCESS on success, or PJ_EBUSY if some
+ *                      requests are still using the pool.
+ */
+PJ_DECL(pj_status_t) pj_http_conn_pool_destroy(pj_http_conn_pool *cpool);
+
 /**
  * @}
  */
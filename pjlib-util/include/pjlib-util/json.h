@@ -24,7 +24,7 @@
  * @brief PJLIB JSON Implementation
  */
 
-#include <pj/types.h>
+#include <pjlib-util/types.h>
 #include <pj/list.h>
 #include <pj/pool.h>
 
@@ -36,6 +36,15 @@ PJ_BEGIN_DECL
  * @{
  * This API implements JSON file format according to RFC 4627. It can be used
  * to parse, write, and manipulate JSON documents.
+ *
+ * Besides the element tree API (#pj_json_parse() and #pj_json_writef()),
+ * two streaming APIs are provided for processing large documents:
+ *  - the pull reader (#pj_json_reader), which returns the document one
+ *    token at a time. The names and values of the tokens point directly to
+ *    the input buffer, hence no memory allocation is made by the reader.
+ *  - the stream writer (#pj_json_stream_writer), which renders the document
+ *    as the elements are added, coalescing the output into a buffer before
+ *    giving it to the writer callback.
  */
 
 /**
@@ -109,6 +118,73 @@ typedef pj_status_t (*pj_json_writer)(const char *s,
                                       unsigned size,
                                       void *user_data);
 
+/**
+ * Type of token returned by the JSON pull reader.
+ */
+typedef enum pj_json_token_type
+{
+    PJ_JSON_TOKEN_NULL,         /**< Null value (null).                 */
+    PJ_JSON_TOKEN_BOOL,         /**< Boolean value (true, false).       */
+    PJ_JSON_TOKEN_NUMBER,       /**< Numeric value.                     */
+    PJ_JSON_TOKEN_STRING,       /**< String value.                      */
+    PJ_JSON_TOKEN_ARRAY_START,  /**< Start of an array ('[').           */
+    PJ_JSON_TOKEN_ARRAY_END,    /**< End of an array (']').             */
+    PJ_JSON_TOKEN_OBJ_START,    /**< Start of an object ('{').          */
+    PJ_JSON_TOKEN_OBJ_END       /**< End of an object ('}').            */
+} pj_json_token_type;
+
+/**
+ * This describes a token returned by pj_json_reader_next(). All the
+ * strings in the token point to the buffer given to pj_json_reader_init(),
+ * and they are NOT NULL terminated.
+ */
+typedef struct pj_json_token
+{
+    pj_json_token_type  type;           /**< Token type.                */
+    pj_str_t            name;           /**< Element name, or empty.    */
+    pj_str_t            str;            /**< For PJ_JSON_TOKEN_STRING,
+                                             the unescaped string value.
+                                             For PJ_JSON_TOKEN_NUMBER,
+                                             the number text.           */
+    pj_bool_t           is_true;        /**< Boolean value.             */
+    float               num;            /**< Number value.              */
+} pj_json_token;
+
+/**
+ * JSON pull reader. Application should treat this as an opaque structure
+ * and only use the pj_json_reader_*() functions to manipulate it.
+ */
+typedef struct pj_json_reader
+{
+    char        *start;                 /**< Start of the buffer.       */
+    char        *end;                   /**< End of the buffer.         */
+    char        *cur;                   /**< Current position.          */
+    char        *err_pos;               /**< Position of error, if any. */
+    pj_bool_t    done;                  /**< Root element completed.    */
+    unsigned     depth;                 /**< Current nesting level.     */
+    char         nest[PJ_JSON_MAX_DEPTH]; /**< Closing char per level.  */
+    pj_pool_t   *pool;                  /**< Pool to decode escaped
+                                             strings to, or NULL to
+                                             decode them in the buffer. */
+} pj_json_reader;
+
+/**
+ * JSON stream writer. Application should treat this as an opaque structure
+ * and only use the pj_json_sw_*() functions to manipulate it.
+ */
+typedef struct pj_json_stream_writer
+{
+    pj_json_writer  writer;             /**< Output callback.           */
+    void           *user_data;          /**< Callback user data.        */
+    char           *buf;                /**< Output buffer, or NULL.    */
+    unsigned        size;               /**< Output buffer size.        */
+    unsigned        len;                /**< Pending output length.     */
+    pj_status_t     status;             /**< First error encountered.   */
+    int             indent;             /**< Current indentation.       */
+    unsigned        depth;              /**< Current nesting level.     */
+    pj_uint8_t      state[PJ_JSON_MAX_DEPTH]; /**< State per level.     */
+} pj_json_stream_writer;
+
 /**
  * Initialize null element.
  *
@@ -174,6 +250,11 @@ PJ_DECL(void) pj_json_elem_add(pj_json_elem *el, pj_json_elem *child);
 /**
  * Parse a JSON document in the buffer. The buffer MUST be NULL terminated,
  * or if not then it must have enough size to put the NULL character.
+ * The buffer is not modified. Element names and string values without
+ * escape sequences refer to the buffer, so it must remain valid for as
+ * long as the elements are used. Strings with escape sequences are
+ * decoded to the pool. Documents with objects and arrays nested more than
+ * PJ_JSON_MAX_DEPTH levels deep are rejected.
  *
  * @param pool          The pool to allocate memory for creating elements.
  * @param buffer        String buffer containing JSON document.
@@ -189,7 +270,9 @@ PJ_DECL(pj_json_elem*) pj_json_parse(pj_pool_t *pool,
                                      pj_json_err_info *err_info);
 
 /**
- * Write the specified element to the string buffer.
+ * Write the specified element to the string buffer. Elements with objects
+ * and arrays nested more than PJ_JSON_MAX_DEPTH levels deep are rejected
+ * with PJ_ETOOMANY.
  *
  * @param elem          The element to be written.
  * @param buffer        Output buffer.
@@ -204,7 +287,9 @@ PJ_DECL(pj_status_t)   pj_json_write(const pj_json_elem *elem,
 
 /**
  * Incrementally write the element to arbitrary medium using the specified
- * callback to write the document chunks.
+ * callback to write the document chunks. As with pj_json_write(), elements
+ * nested more than PJ_JSON_MAX_DEPTH levels deep are rejected with
+ * PJ_ETOOMANY.
  *
  * @param elem          The element to be written.
  * @param writer        Callback function which will be called to write
@@ -218,6 +303,190 @@ PJ_DECL(pj_status_t)   pj_json_writef(const pj_json_elem *elem,
                                       pj_json_writer writer,
                                       void *user_data);
 
+/**
+ * Initialize the JSON pull reader to read the document in the specified
+ * buffer. The buffer does not need to be NULL terminated, but it must stay
+ * valid for as long as the tokens returned by the reader are used. Note
+ * that string values containing escape sequences are unescaped in place,
+ * hence the content of the buffer may be modified by the reader.
+ *
+ * @param reader        The reader.
+ * @param buffer        String buffer containing JSON document.
+ * @param size          Size of the document.
+ */
+PJ_DECL(void) pj_json_reader_init(pj_json_reader *reader,
+                                  char *buffer,
+                                  unsigned size);
+
+/**
+ * Read the next token from the document.
+ *
+ * @param reader        The reader.
+ * @param token         Token to be filled with the result.
+ *
+ * @return              PJ_SUCCESS if a token is returned, PJ_EEOF if the
+ *                      root element has been completely read, or
+ *                      PJLIB_UTIL_EINJSON on syntax error.
+ */
+PJ_DECL(pj_status_t) pj_json_reader_next(pj_json_reader *reader,
+                                         pj_json_token *token);
+
+/**
+ * Skip the rest of the array or object that was most recently opened,
+ * including its end token. This is useful to ignore elements that are
+ * not interesting to the application without examining their contents.
+ *
+ * @param reader        The reader.
+ *
+ * @return              PJ_SUCCESS or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_reader_skip(pj_json_reader *reader);
+
+/**
+ * Get the nesting level of the reader, i.e. the number of arrays and
+ * objects that have been opened but not yet closed.
+ *
+ * @param reader        The reader.
+ *
+ * @return              The nesting level.
+ */
+PJ_DECL(unsigned) pj_json_reader_depth(const pj_json_reader *reader);
+
+/**
+ * Get the location of the error after pj_json_reader_next() has failed.
+ *
+ * @param reader        The reader.
+ * @param err_info      Structure to be filled with the error info.
+ */
+PJ_DECL(void) pj_json_reader_get_err_info(const pj_json_reader *reader,
+                                          pj_json_err_info *err_info);
+
+/**
+ * Initialize the JSON stream writer. The output is accumulated in the
+ * specified buffer and given to the writer callback each time the buffer
+ * is full, and when pj_json_sw_flush() is called.
+ *
+ * Errors are sticky: once an error has occurred (for example the writer
+ * callback has returned non-PJ_SUCCESS), subsequent calls will not write
+ * anything and will return the same error, so application may check the
+ * status only once at the end.
+ *
+ * @param sw            The stream writer.
+ * @param buf           Buffer to coalesce the output. If this is NULL,
+ *                      the writer callback will be called for every text
+ *                      chunk.
+ * @param size          The size of the buffer.
+ * @param writer        Callback function to write text chunks.
+ * @param user_data     Arbitrary user data for the callback.
+ */
+PJ_DECL(void) pj_json_sw_init(pj_json_stream_writer *sw,
+                              char *buf, unsigned size,
+                              pj_json_writer writer,
+                              void *user_data);
+
+/**
+ * Start writing an object. Subsequent elements will be written as the
+ * children of this object, until pj_json_sw_end() is called.
+ *
+ * @param sw            The stream writer.
+ * @param name          Name of the element, or NULL.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_sw_begin_obj(pj_json_stream_writer *sw,
+                                          const pj_str_t *name);
+
+/**
+ * Start writing an array. Subsequent elements will be written as the
+ * elements of this array, until pj_json_sw_end() is called.
+ *
+ * @param sw            The stream writer.
+ * @param name          Name of the element, or NULL.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_sw_begin_array(pj_json_stream_writer *sw,
+                                            const pj_str_t *name);
+
+/**
+ * Close the array or object that was most recently started.
+ *
+ * @param sw            The stream writer.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_sw_end(pj_json_stream_writer *sw);
+
+/**
+ * Write a null element.
+ *
+ * @param sw            The stream writer.
+ * @param name          Name of the element, or NULL.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_sw_null(pj_json_stream_writer *sw,
+                                     const pj_str_t *name);
+
+/**
+ * Write a boolean element.
+ *
+ * @param sw            The stream writer.
+ * @param name          Name of the element, or NULL.
+ * @param val           The value.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_sw_bool(pj_json_stream_writer *sw,
+                                     const pj_str_t *name,
+                                     pj_bool_t val);
+
+/**
+ * Write a number element.
+ *
+ * @param sw            The stream writer.
+ * @param name          Name of the element, or NULL.
+ * @param val           The value.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_sw_number(pj_json_stream_writer *sw,
+                                       const pj_str_t *name,
+                                       float val);
+
+/**
+ * Write a string element.
+ *
+ * @param sw            The stream writer.
+ * @param name          Name of the element, or NULL.
+ * @param val           The value.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_sw_string(pj_json_stream_writer *sw,
+                                       const pj_str_t *name,
+                                       const pj_str_t *val);
+
+/**
+ * Write an element and all of its children.
+ *
+ * @param sw            The stream writer.
+ * @param elem          The element to be written.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_sw_elem(pj_json_stream_writer *sw,
+                                     const pj_json_elem *elem);
+
+/**
+ * Give the pending output in the buffer to the writer callback.
+ *
+ * @param sw            The stream writer.
+ *
+ * @return              PJ_SUCCESS on success or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_json_sw_flush(pj_json_stream_writer *sw);
+
 /**
  * @}
  */
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJLIB_UTIL_METRICS_H__
+#define __PJLIB_UTIL_METRICS_H__
+
+/**
+ * @file metrics.h
+ * @brief Runtime metrics registry
+ */
+
+#include <pjlib-util/types.h>
+#include <pj/ioqueue.h>
+#include <pj/sock.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_METRICS Runtime Metrics
+ * @ingroup PJLIB_UTIL_BASE
+ * @{
+ *
+ * The metrics registry keeps named counters, gauges and histograms which
+ * are cheap enough to be updated from hot paths, and renders them in the
+ * Prometheus text exposition format with #pj_metrics_write(). The
+ * registry can be inspected with the "metrics" command of the CLI
+ * framework, or scraped over HTTP with #pj_metrics_http_create().
+ *
+ * Counters and histograms are sharded per thread: each thread updates
+ * its own cache line with a relaxed atomic add, and the shards are only
+ * summed when the registry is rendered. No lock is taken when a metric
+ * is updated.
+ *
+ * Libraries register their metrics in the default registry
+ * (#pj_metrics_set_default()) when their modules are created, so the
+ * default registry must be set before creating e.g. the SIP endpoint,
+ * and it must outlive them. When there is no default registry, the
+ * metric handles are NULL and updating them is a no-op.
+ */
+
+/**
+ * Opaque declaration of metrics registry.
+ */
+typedef struct pj_metrics pj_metrics;
+
+/**
+ * Opaque declaration of a metric.
+ */
+typedef struct pj_metric pj_metric;
+
+/**
+ * Metric types.
+ */
+typedef enum pj_metric_type
+{
+    /** Monotonically increasing value. */
+    PJ_METRIC_COUNTER,
+
+    /** Value which may go up and down. */
+    PJ_METRIC_GAUGE,
+
+    /** Distribution of observed values over fixed buckets. */
+    PJ_METRIC_HISTOGRAM
+
+} pj_metric_type;
+
+/**
+ * Collector callback, called by #pj_metrics_write() before the metrics
+ * are rendered. This is useful to update gauges from values which are
+ * expensive to track continuously, such as the number of objects in a
+ * table.
+ *
+ * @param metrics       The registry.
+ * @param user_data     User data given to #pj_metrics_add_collector().
+ */
+typedef void (*pj_metrics_collector)(pj_metrics *metrics, void *user_data);
+
+/**
+ * Output callback of #pj_metrics_write().
+ *
+ * @param s             Text to be written.
+ * @param size          Length of the text.
+ * @param user_data     User data given to #pj_metrics_write().
+ *
+ * @return              PJ_SUCCESS to continue, or other value to stop
+ *                      writing and return the value to the caller.
+ */
+typedef pj_status_t (*pj_metrics_writer)(const char *s,
+                                         unsigned size,
+                                         void *user_data);
+
+
+/**
+ * Create metrics registry.
+ *
+ * @param pf            Pool factory.
+ * @param p_metrics     Pointer to receive the registry.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_metrics_create(pj_pool_factory *pf,
+                                       pj_metrics **p_metrics);
+
+/**
+ * Destroy metrics registry. If this is the default registry, the default
+ * will be reset to NULL.
+ *
+ * @param metrics       The registry.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_metrics_destroy(pj_metrics *metrics);
+
+/**
+ * Set the default registry, where the libraries register their metrics.
+ *
+ * @param metrics       The registry, or NULL.
+ */
+PJ_DECL(void) pj_metrics_set_default(pj_metrics *metrics);
+
+/**
+ * Get the default registry.
+ *
+ * @return              The default registry, or NULL.
+ */
+PJ_DECL(pj_metrics*) pj_metrics_get_default(void);
+
+/**
+ * Register a counter. If a counter with the same name is already
+ * registered, that counter is returned, so modules can register their
+ * metrics each time they are created.
+ *
+ * @param metrics       The registry.
+ * @param name          Metric name, matching [a-zA-Z_:][a-zA-Z0-9_:]*.
+ *                      Counter names should end with "_total".
+ * @param help          Optional description.
+ * @param p_metric      Pointer to receive the metric.
+ *
+ * @return              PJ_SUCCESS on success, PJ_EEXISTS if a metric with
+ *                      the same name but different type exists, or the
+ *                      appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_metrics_add_counter(pj_metrics *metrics,
+                                            const char *name,
+                                            const char *help,
+                                            pj_metric **p_metric);
+
+/**
+ * Register a gauge. See #pj_metrics_add_counter() for the details.
+ *
+ * @param metrics       The registry.
+ * @param name          Metric name.
+ * @param help          Optional description.
+ * @param p_metric      Pointer to receive the metric.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_metrics_add_gauge(pj_metrics *metrics,
+                                          const char *name,
+                                          const char *help,
+                                          pj_metric **p_metric);
+
+/**
+ * Register a histogram. A value v is counted in the first bucket whose
+ * upper bound is greater or equal to v, or in the implicit "+Inf" bucket.
+ * See #pj_metrics_add_counter() for the details.
+ *
+ * @param metrics       The registry.
+ * @param name          Metric name.
+ * @param help          Optional description.
+ * @param bucket_cnt    Number of bucket bounds, at most
+ *                      PJ_METRICS_MAX_BUCKETS.
+ * @param bounds        Upper bounds of the buckets, in increasing order.
+ * @param p_metric      Pointer to receive the metric.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_metrics_add_histogram(pj_metrics *metrics,
+                                              const char *name,
+                                              const char *help,
+                                              unsigned bucket_cnt,
+                                              const pj_int64_t bounds[],
+                                              pj_metric **p_metric);
+
+/**
+ * Find a metric by name.
+ *
+ * @param metrics       The registry.
+ * @param name          Metric name.
+ *
+ * @return              The metric, or NULL if not found.
+ */
+PJ_DECL(pj_metric*) pj_metrics_find(pj_metrics *metrics, const char *name);
+
+/**
+ * Register a collector callback, see #pj_metrics_collector.
+ *
+ * @param metrics       The registry.
+ * @param cb            The callback.
+ * @param user_data     User data to be given to the callback.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_metrics_add_collector(pj_metrics *metrics,
+                                              pj_metrics_collector cb,
+                                              void *user_data);
+
+/**
+ * Unregister a collector callback.
+ *
+ * @param metrics       The registry.
+ * @param cb            The callback.
+ * @param user_data     User data given when registering the callback.
+ *
+ * @return              PJ_SUCCESS on success, PJ_ENOTFOUND if the
+ *                      collector is not registered.
+ */
+PJ_DECL(pj_status_t) pj_metrics_remove_collector(pj_metrics *metrics,
+                                                 pj_metrics_collector cb,
+                                                 void *user_data);
+
+/**
+ * Render all metrics whose name starts with the prefix, in Prometheus
+ * text exposition format. Collectors are called first.
+ *
+ * @param metrics       The registry.
+ * @param prefix        Optional name prefix, NULL to render all metrics.
+ * @param writer        Output callback.
+ * @param user_data     User data to be given to the callback.
+ *
+ * @return              PJ_SUCCESS on success, or the error returned by
+ *                      the writer.
+ */
+PJ_DECL(pj_status_t) pj_metrics_write(pj_metrics *metrics,
+                                      const pj_str_t *prefix,
+                                      pj_metrics_writer writer,
+                                      void *user_data);
+
+/**
+ * Get metric type.
+ *
+ * @param metric        The metric.
+ *
+ * @return              The type.
+ */
+PJ_DECL(pj_metric_type) pj_metric_get_type(const pj_metric *metric);
+
+/**
+ * Increment a counter or gauge by one. Nothing is done if the metric is
+ * NULL.
+ *
+ * @param metric        The metric, or NULL.
+ */
+PJ_DECL(void) pj_metric_inc(pj_metric *metric);
+
+/**
+ * Add a value to a counter or gauge. Counters must only be given
+ * positive values. Nothing is done if the metric is NULL.
+ *
+ * @param metric        The metric, or NULL.
+ * @param value         The value to add.
+ */
+PJ_DECL(void) pj_metric_add(pj_metric *metric, pj_int64_t value);
+
+/**
+ * Set the value of a gauge. Nothing is done if the metric is NULL.
+ *
+ * @param metric        The metric, or NULL.
+ * @param value         The value.
+ */
+PJ_DECL(void) pj_metric_set(pj_metric *metric, pj_int64_t value);
+
+/**
+ * Record a value in a histogram. Nothing is done if the metric is NULL.
+ *
+ * @param metric        The metric, or NULL.
+ * @param value         The value.
+ */
+PJ_DECL(void) pj_metric_observe(pj_metric *metric, pj_int64_t value);
+
+/**
+ * Get the current value of a metric. For histograms, this returns the
+ * number of observations.
+ *
+ * @param metric        The metric.
+ *
+ * @return              The value.
+ */
+PJ_DECL(pj_int64_t) pj_metric_get(const pj_metric *metric);
+
+
+/**
+ * Opaque declaration of the metrics HTTP endpoint.
+ */
+typedef struct pj_metrics_http pj_metrics_http;
+
+/**
+ * Create a plain HTTP endpoint, which serves the registry in text
+ * exposition format on "GET /metrics" (or "GET /"). Each connection
+ * serves one request and is then closed.
+ *
+ * @param pf            The pool factory.
+ * @param ioqueue       The ioqueue where the listening socket is
+ *                      registered.
+ * @param metrics       The registry to serve.
+ * @param bind_addr     The address to listen to. Port zero will bind to
+ *                      any port.
+ * @param p_srv         Pointer to receive the endpoint.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_metrics_http_create(pj_pool_factory *pf,
+                                            pj_ioqueue_t *ioqueue,
+                                            pj_metrics *metrics,
+                                            const pj_sockaddr *bind_addr,
+                                            pj_metrics_http **p_srv);
+
+/**
+ * Get the bound address of the HTTP endpoint.
+ *
+ * @param srv           The endpoint.
+ * @param addr          It will be filled with the bound address.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_metrics_http_get_addr(pj_metrics_http *srv,
+                                              pj_sockaddr *addr);
+
+/**
+ * Destroy the HTTP endpoint, closing all connections.
+ *
+ * @param srv           The endpoint.
+ *
+ * @return              PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_metrics_http_destroy(pj_metrics_http *srv);
+
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif  /* __PJLIB_UTIL_METRICS_H__ */
@@ -35,6 +35,13 @@ PJ_BEGIN_DECL
  * This module describes simple utility to read PCAP file. It is not intended
  * to support all PCAP features (that's what libpcap is for!), but it can
  * be useful for example to playback or stream PCAP contents.
+ *
+ * A capture can be opened with #pj_pcap_open(), which reads the packets
+ * record by record from the file, or with #pj_pcap_map(), which maps the
+ * whole file into memory so that #pj_pcap_read_udp_pkt() can return the
+ * packets without copying them. The latter also sorts the packets into
+ * flows (by UDP addresses and, for RTP, by SSRC), so that all the streams
+ * in a capture can be processed in a single pass.
  */
 
 /**
@@ -43,7 +50,10 @@ PJ_BEGIN_DECL
 typedef enum pj_pcap_link_type
 {
     /** Ethernet data link */
-    PJ_PCAP_LINK_TYPE_ETH   = 1
+    PJ_PCAP_LINK_TYPE_ETH   = 1,
+
+    /** Linux "cooked" capture, e.g. from "tcpdump -i any" */
+    PJ_PCAP_LINK_TYPE_LINUX_SLL = 113
 
 } pj_pcap_link_type;
 
@@ -124,6 +134,80 @@ typedef struct pj_pcap_filter
 typedef struct pj_pcap_file pj_pcap_file;
 
 
+/**
+ * This enumeration describes the type of a flow, as guessed from the
+ * content of its first packet.
+ */
+typedef enum pj_pcap_flow_type
+{
+    /** Plain UDP payload. */
+    PJ_PCAP_FLOW_UDP,
+
+    /** RTP packets. Flows of this type are separated by SSRC. */
+    PJ_PCAP_FLOW_RTP,
+
+    /** RTCP packets. */
+    PJ_PCAP_FLOW_RTCP
+
+} pj_pcap_flow_type;
+
+
+/**
+ * This structure describes a flow, i.e. the packets in the capture
+ * sharing the same addresses, ports, type and, for RTP, SSRC.
+ * Addresses and ports are in network byte order.
+ */
+typedef struct pj_pcap_flow
+{
+    pj_pcap_flow_type   type;       /**< Flow type.                     */
+    pj_uint32_t         ip_src;     /**< Source IPv4 address.           */
+    pj_uint32_t         ip_dst;     /**< Destination IPv4 address.      */
+    pj_uint16_t         src_port;   /**< Source UDP port.               */
+    pj_uint16_t         dst_port;   /**< Destination UDP port.          */
+    pj_uint32_t         ssrc;       /**< RTP SSRC in host byte order,
+                                         or zero for other types.       */
+    unsigned            pkt_cnt;    /**< Packets read so far.           */
+    pj_size_t           bytes;      /**< Payload bytes read so far.     */
+} pj_pcap_flow;
+
+
+/**
+ * This structure describes a UDP packet returned by
+ * #pj_pcap_read_udp_pkt().
+ */
+typedef struct pj_pcap_udp_pkt
+{
+    /** Capture time, seconds part. */
+    pj_uint32_t         ts_sec;
+
+    /** Capture time, microseconds part. */
+    pj_uint32_t         ts_usec;
+
+    /** Source IPv4 address, in network byte order. */
+    pj_uint32_t         ip_src;
+
+    /** Destination IPv4 address, in network byte order. */
+    pj_uint32_t         ip_dst;
+
+    /** The UDP header. */
+    pj_pcap_udp_hdr     udp;
+
+    /**
+     * The UDP payload. This points to the mapped file or to an internal
+     * buffer, and is only valid until the next read or until the file is
+     * closed. The content must not be modified.
+     */
+    const pj_uint8_t   *payload;
+
+    /** Size of the payload. */
+    pj_size_t           payload_len;
+
+    /** Index of the flow this packet belongs to, see #pj_pcap_get_flow(). */
+    unsigned            flow;
+
+} pj_pcap_udp_pkt;
+
+
 /**
  * Initialize filter with default values. The default value is to allow
  * any packets.
@@ -145,6 +229,23 @@ PJ_DECL(pj_status_t) pj_pcap_open(pj_pool_t *pool,
                                   const char *path,
                                   pj_pcap_file **p_file);
 
+/**
+ * Open PCAP file and map its whole content into memory. On platforms
+ * with mmap() support (see PJ_PCAP_HAS_MMAP) the file is memory mapped,
+ * otherwise it is read into memory allocated from the pool. Packets are
+ * then returned by #pj_pcap_read_udp_pkt() without copying, and the file
+ * can be replayed again with #pj_pcap_rewind() cheaply.
+ *
+ * @param pool      Pool to allocate memory.
+ * @param path      File/path name.
+ * @param p_file    Pointer to receive PCAP file handle.
+ *
+ * @return          PJ_SUCCESS if file can be opened successfully.
+ */
+PJ_DECL(pj_status_t) pj_pcap_map(pj_pool_t *pool,
+                                 const char *path,
+                                 pj_pcap_file **p_file);
+
 /**
  * Close PCAP file.
  *
@@ -184,6 +285,54 @@ PJ_DECL(pj_status_t) pj_pcap_read_udp(pj_pcap_file *file,
                                       pj_uint8_t *udp_payload,
                                       pj_size_t *udp_payload_size);
 
+/**
+ * Read the next UDP packet matching the filter, and assign it to a flow.
+ * New flows are created as they are found in the capture, and a flow's
+ * index never changes for the lifetime of the file handle, even after
+ * #pj_pcap_rewind().
+ *
+ * IPv4 packets over Ethernet (optionally VLAN tagged) and Linux cooked
+ * capture are supported. IP fragments are skipped.
+ *
+ * @param file      PCAP file handle.
+ * @param pkt       Packet descriptor to be filled in.
+ *
+ * @return          PJ_SUCCESS on success, PJ_EEOF when there are no
+ *                  more packets, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_pcap_read_udp_pkt(pj_pcap_file *file,
+                                          pj_pcap_udp_pkt *pkt);
+
+/**
+ * Get the number of flows found so far by #pj_pcap_read_udp_pkt().
+ *
+ * @param file      PCAP file handle.
+ *
+ * @return          Number of flows.
+ */
+PJ_DECL(unsigned) pj_pcap_get_flow_count(pj_pcap_file *file);
+
+/**
+ * Get flow information.
+ *
+ * @param file      PCAP file handle.
+ * @param index     Flow index, less than #pj_pcap_get_flow_count().
+ *
+ * @return          The flow, or NULL if the index is not valid.
+ */
+PJ_DECL(const pj_pcap_flow*) pj_pcap_get_flow(pj_pcap_file *file,
+                                              unsigned index);
+
+/**
+ * Restart reading from the first packet in the file. Flows found so far
+ * are kept, but their packet counters are reset.
+ *
+ * @param file      PCAP file handle.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_pcap_rewind(pj_pcap_file *file);
+
 
 /**
  * @}
@@ -24,7 +24,7 @@
  * @brief PJLIB XML Parser/Helper.
  */
 
-#include <pj/types.h>
+#include <pjlib-util/scanner.h>
 #include <pj/list.h>
 
 PJ_BEGIN_DECL
@@ -33,6 +33,12 @@ PJ_BEGIN_DECL
  * @defgroup PJ_TINY_XML Mini/Tiny XML Parser/Helper
  * @ingroup PJ_FILE_FMT
  * @{
+ *
+ * Besides the DOM-like parser (#pj_xml_parse()), an incremental pull
+ * reader (#pj_xml_reader) is provided. The pull reader returns the document
+ * as a sequence of events without allocating any memory, and all names and
+ * values returned point directly to the input buffer. It is useful when
+ * only a few elements need to be extracted from a large document.
  */
 
 /** Typedef for XML attribute. */
@@ -239,6 +245,145 @@ PJ_DECL(pj_xml_node*) pj_xml_find_rec(const pj_xml_node *parent,
                                                          const void*));
 
 
+/**
+ * Options for the XML pull reader, to be specified in pj_xml_reader_init().
+ */
+typedef enum pj_xml_reader_option
+{
+    /**
+     * Track namespace declarations ("xmlns" and "xmlns:prefix" attributes)
+     * and resolve the namespace URI of each element.
+     */
+    PJ_XML_READER_NS = 1
+
+} pj_xml_reader_option;
+
+/**
+ * Type of event returned by the XML pull reader.
+ */
+typedef enum pj_xml_event_type
+{
+    PJ_XML_EVENT_START,         /**< Element start tag.                 */
+    PJ_XML_EVENT_END,           /**< Element end tag. This is also
+                                     returned for empty element tag
+                                     (e.g. "<basic/>").                 */
+    PJ_XML_EVENT_TEXT           /**< Element content or CDATA section.  */
+} pj_xml_event_type;
+
+/**
+ * Attribute slice returned by the XML pull reader.
+ */
+typedef struct pj_xml_reader_attr
+{
+    pj_str_t    name;           /**< Attribute name.                    */
+    pj_str_t    value;          /**< Attribute value, without quotes.   */
+} pj_xml_reader_attr;
+
+/**
+ * This describes an event returned by pj_xml_reader_next(). All strings
+ * point to the input buffer and are NOT NULL terminated. The event is only
+ * valid until the next call to pj_xml_reader_next().
+ */
+typedef struct pj_xml_event
+{
+    pj_xml_event_type    type;          /**< Event type.                */
+    unsigned             depth;         /**< Nesting level of the
+                                             element, root is 1.        */
+    pj_str_t             name;          /**< Qualified element name,
+                                             e.g. "dm:person".          */
+    pj_str_t             local_name;    /**< Element name without the
+                                             namespace prefix.          */
+    pj_str_t             ns_uri;        /**< Namespace URI of the
+                                             element. Only set when the
+                                             PJ_XML_READER_NS option is
+                                             used.                      */
+    pj_str_t             text;          /**< Content, for TEXT event.   */
+    unsigned             attr_cnt;      /**< Number of attributes, for
+                                             START event.               */
+    const pj_xml_reader_attr *attr;     /**< Attributes.                */
+} pj_xml_event;
+
+/**
+ * XML pull reader. Application should treat this as an opaque structure
+ * and only use the pj_xml_reader_*() functions to manipulate it.
+ */
+typedef struct pj_xml_reader
+{
+    pj_scanner          scanner;        /**< The scanner, must be first. */
+    unsigned            options;        /**< pj_xml_reader_option.      */
+    pj_bool_t           has_root;       /**< Root element was found.    */
+    pj_bool_t           has_error;      /**< Syntax error was found.    */
+    pj_bool_t           pending_end;    /**< Empty element to close.    */
+    unsigned            depth;          /**< Current nesting level.     */
+    pj_str_t            names[PJ_XML_READER_MAX_DEPTH]; /**< Open names */
+    unsigned            attr_cnt;       /**< Number of attributes.      */
+    pj_xml_reader_attr  attr[PJ_XML_READER_MAX_ATTR]; /**< Attributes.  */
+    unsigned            ns_cnt;         /**< Number of namespaces.      */
+    struct {
+        pj_str_t        prefix;         /**< Prefix, empty for default. */
+        pj_str_t        uri;            /**< Namespace URI.             */
+        unsigned        depth;          /**< Declaring element level.   */
+    } ns[PJ_XML_READER_MAX_NS];         /**< Namespaces in scope.       */
+} pj_xml_reader;
+
+/**
+ * Initialize XML pull reader. The same rules as pj_xml_parse() apply to
+ * the input: processing instructions and comments are skipped, and the
+ * buffer MUST be NULL terminated and have length at least len+1. The
+ * buffer must remain valid while the reader and its events are used.
+ *
+ * @param reader    The reader.
+ * @param msg       The XML message to parse, MUST be NULL terminated.
+ * @param len       The length of the message, not including NULL terminator.
+ * @param options   Bitmask of pj_xml_reader_option, or zero.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_xml_reader_init(pj_xml_reader *reader,
+                                        char *msg, pj_size_t len,
+                                        unsigned options);
+
+/**
+ * Read the next event from the document.
+ *
+ * @param reader    The reader.
+ * @param event     Structure to be filled with the event.
+ *
+ * @return          PJ_SUCCESS if an event is returned, PJ_EEOF if the root
+ *                  element has been completely read, or PJLIB_UTIL_EINXML
+ *                  on syntax error.
+ */
+PJ_DECL(pj_status_t) pj_xml_reader_next(pj_xml_reader *reader,
+                                        pj_xml_event *event);
+
+/**
+ * Skip the rest of the element whose START event was most recently
+ * returned, including its END event.
+ *
+ * @param reader    The reader.
+ *
+ * @return          PJ_SUCCESS or the appropriate error.
+ */
+PJ_DECL(pj_status_t) pj_xml_reader_skip(pj_xml_reader *reader);
+
+/**
+ * Find attribute in a START event.
+ *
+ * @param event     The event.
+ * @param name      Attribute name to find (case insensitive).
+ *
+ * @return          The attribute value, or NULL if not found.
+ */
+PJ_DECL(const pj_str_t*) pj_xml_event_find_attr(const pj_xml_event *event,
+                                                const pj_str_t *name);
+
+/**
+ * Release resources used by the reader.
+ *
+ * @param reader    The reader.
+ */
+PJ_DECL(void) pj_xml_reader_fini(pj_xml_reader *reader);
+
 /**
  * @}
  */
@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE       "dns_server_test.c"
+
+#if INCLUDE_DNS_SERVER_TEST
+
+#include <pjlib-util/dns.h>
+#include <pjlib-util/dns_server.h>
+#include <pj/errno.h>
+#include <pj/ioqueue.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/sock.h>
+#include <pj/sock_select.h>
+#include <pj/string.h>
+#include <pj/timer.h>
+
+#define BURST_CNT       2000
+
+static const char *zone =
+    "; Test zone\n"
+    "$ORIGIN example.com.\n"
+    "$TTL 60\n"
+    "@               IN  A       10.0.0.1\n"
+    "_sip._udp       IN  SRV     10 60 5060 sip1\n"
+    "                IN  SRV     10 40 5060 sip2.example.com.\n"
+    "                IN  SRV     20 0 5060 ( backup )\n"
+    "sip1    300     IN  A       10.0.0.11\n"
+    "sip2            IN  A       10.0.0.12\n"
+    "sip2            IN  AAAA    2001:db8::12\n"
+    "backup          IN  A       10.0.0.13\n"
+    "www             IN  CNAME   @\n"
+    "@               IN  NAPTR   10 0 \"s\" \"SIP+D2U\" \"\" _sip._udp\n";
+
+static pj_bool_t poll_quit;
+
+static int poll_thread(void *arg)
+{
+    pj_ioqueue_t *ioqueue = (pj_ioqueue_t*)arg;
+
+    while (!poll_quit) {
+        pj_time_val delay = { 0, 10 };
+        pj_ioqueue_poll(ioqueue, &delay);
+    }
+    return 0;
+}
+
+typedef struct test_ctx
+{
+    pj_pool_t       *pool;
+    pj_sock_t        sock;
+    pj_sockaddr      srv_addr;
+    pj_timer_heap_t *timer_heap;
+    pj_uint16_t      id;
+} test_ctx;
+
+/* Send a query */
+static int send_query(test_ctx *ctx, int type, const char *name)
+{
+    pj_uint8_t pkt[512];
+    unsigned size = sizeof(pkt);
+    pj_ssize_t len;
+    pj_str_t qname = pj_str((char*)name);
+
+    PJ_TEST_SUCCESS(pj_dns_make_query(pkt, &size, ++ctx->id, type, &qname),
+                    NULL, return 10);
+    len = size;
+    PJ_TEST_SUCCESS(pj_sock_sendto(ctx->sock, pkt, &len, 0, &ctx->srv_addr,
+                                   pj_sockaddr_get_len(&ctx->srv_addr)),
+                    NULL, return 11);
+    return 0;
+}
+
+/* Wait for an answer, polling the timer heap. Returns NULL on timeout. */
+static pj_dns_parsed_packet *recv_answer(test_ctx *ctx, unsigned msec)
+{
+    pj_uint8_t pkt[PJ_DNS_RESOLVER_MAX_UDP_SIZE];
+    pj_dns_parsed_packet *res;
+    pj_time_val end, now;
+
+    pj_gettickcount(&end);
+    end.msec += msec;
+    pj_time_val_normalize(&end);
+
+    for (;;) {
+        pj_fd_set_t rset;
+        pj_time_val timeout = { 0, 5 };
+        pj_ssize_t len;
+
+        if (ctx->timer_heap)
+            pj_timer_heap_poll(ctx->timer_heap, NULL);
+
+        PJ_FD_ZERO(&rset);
+        PJ_FD_SET(ctx->sock, &rset);
+        if (pj_sock_select((int)ctx->sock + 1, &rset, NULL, NULL,
+                           &timeout) > 0)
+        {
+            len = sizeof(pkt);
+            if (pj_sock_recv(ctx->sock, pkt, &len, 0) != PJ_SUCCESS)
+                return NULL;
+            if (pj_dns_parse_packet(ctx->pool, pkt, (unsigned)len,
+                                    &res) != PJ_SUCCESS)
+            {
+                return NULL;
+            }
+            return res;
+        }
+
+        pj_gettickcount(&now);
+        if (PJ_TIME_VAL_GTE(now, end))
+            return NULL;
+    }
+}
+
+static int query_test(test_ctx *ctx)
+{
+    pj_dns_parsed_packet *res;
+    unsigned i;
+    int rc;
+
+    /* SRV with addresses of the targets in the additional section */
+    if ((rc = send_query(ctx, PJ_DNS_TYPE_SRV, "_sip._udp.example.com")))
+        return rc;
+    res = recv_answer(ctx, 1000);
+    PJ_TEST_NOT_NULL(res, NULL, return 20);
+    PJ_TEST_EQ(res->hdr.id, ctx->id, NULL, return 21);
+    PJ_TEST_EQ(PJ_DNS_GET_RCODE(res->hdr.flags), 0, NULL, return 22);
+    PJ_TEST_TRUE(PJ_DNS_GET_AA(res->hdr.flags), NULL, return 23);
+    PJ_TEST_EQ(res->hdr.anscount, 3, NULL, return 24);
+    PJ_TEST_EQ(res->hdr.arcount, 4, NULL, return 25);
+    for (i = 0; i < res->hdr.anscount; ++i) {
+        PJ_TEST_EQ(res->ans[i].type, PJ_DNS_TYPE_SRV, NULL, return 26);
+        PJ_TEST_EQ(res->ans[i].rdata.srv.port, 5060, NULL, return 27);
+    }
+    PJ_TEST_EQ(res->ans[0].ttl, 60, NULL, return 28);
+    PJ_TEST_EQ(pj_strcmp2(&res->ans[1].rdata.srv.target,
+                          "sip2.example.com"), 0, NULL, return 29);
+    PJ_TEST_EQ(pj_strcmp2(&res->ans[2].rdata.srv.target,
+                          "backup.example.com"), 0, NULL, return 30);
+
+    /* Explicit TTL, case insensitive name */
+    if ((rc = send_query(ctx, PJ_DNS_TYPE_A, "SIP1.Example.COM")))
+        return rc;
+    res = recv_answer(ctx, 1000);
+    PJ_TEST_NOT_NULL(res, NULL, return 31);
+    PJ_TEST_EQ(res->hdr.anscount, 1, NULL, return 32);
+    PJ_TEST_EQ(res->ans[0].ttl, 300, NULL, return 33);
+    PJ_TEST_EQ(res->ans[0].rdata.a.ip_addr.s_addr,
+               pj_inet_addr2("10.0.0.11").s_addr, NULL, return 34);
+
+    /* AAAA */
+    if ((rc = send_query(ctx, PJ_DNS_TYPE_AAAA, "sip2.example.com")))
+        return rc;
+    res = recv_answer(ctx, 1000);
+    PJ_TEST_NOT_NULL(res, NULL, return 35);
+    PJ_TEST_EQ(res->hdr.anscount, 1, NULL, return 36);
+    PJ_TEST_EQ(res->ans[0].type, PJ_DNS_TYPE_AAAA, NULL, return 37);
+
+    /* Alias is followed */
+    if ((rc = send_query(ctx, PJ_DNS_TYPE_A, "www.example.com")))
+        return rc;
+    res = recv_answer(ctx, 1000);
+    PJ_TEST_NOT_NULL(res, NULL, return 38);
+    PJ_TEST_EQ(res->hdr.anscount, 2, NULL, return 39);
+    PJ_TEST_EQ(res->ans[0].type, PJ_DNS_TYPE_CNAME, NULL, return 40);
+    PJ_TEST_EQ(res->ans[1].type, PJ_DNS_TYPE_A, NULL, return 41);
+
+    /* Unknown name */
+    if ((rc = send_query(ctx, PJ_DNS_TYPE_A, "nowhere.example.com")))
+        return rc;
+    res = recv_answer(ctx, 1000);
+    PJ_TEST_NOT_NULL(res, NULL, return 42);
+    PJ_TEST_EQ(PJ_DNS_GET_RCODE(res->hdr.flags), PJ_DNS_RCODE_NXDOMAIN,
+               NULL, return 43);
+
+    return 0;
+}
+
+static int impair_test(test_ctx *ctx, pj_dns_server *srv)
+{
+    pj_dns_server_impair impair;
+    pj_dns_parsed_packet *res;
+    pj_time_val t1, t2;
+    int rc;
+
+    /* Truncation */
+    pj_bzero(&impair, sizeof(impair));
+    impair.tc_pct = 100;
+    PJ_TEST_SUCCESS(pj_dns_server_set_impair(srv, NULL, &impair), NULL,
+                    return 50);
+    if ((rc = send_query(ctx, PJ_DNS_TYPE_A, "example.com")))
+        return rc;
+    res = recv_answer(ctx, 1000);
+    PJ_TEST_NOT_NULL(res, NULL, return 51);
+    PJ_TEST_TRUE(PJ_DNS_GET_TC(res->hdr.flags), NULL, return 52);
+    PJ_TEST_EQ(res->hdr.anscount, 0, NULL, return 53);
+
+    /* Loss */
+    pj_bzero(&impair, sizeof(impair));
+    impair.loss_pct = 100;
+    PJ_TEST_SUCCESS(pj_dns_server_set_impair(srv, NULL, &impair), NULL,
+                    return 54);
+    if ((rc = send_query(ctx, PJ_DNS_TYPE_A, "example.com")))
+        return rc;
+    res = recv_answer(ctx, 200);
+    PJ_TEST_TRUE(res == NULL, NULL, return 55);
+
+    /* Delay */
+    pj_bzero(&impair, sizeof(impair));
+    impair.delay_msec = 100;
+    PJ_TEST_SUCCESS(pj_dns_server_set_impair(srv, ctx->timer_heap, &impair),
+                    NULL, return 56);
+    pj_gettickcount(&t1);
+    if ((rc = send_query(ctx, PJ_DNS_TYPE_A, "example.com")))
+        return rc;
+    res = recv_answer(ctx, 1000);
+    pj_gettickcount(&t2);
+    PJ_TEST_NOT_NULL(res, NULL, return 57);
+    PJ_TIME_VAL_SUB(t2, t1);
+    PJ_TEST_GTE(PJ_TIME_VAL_MSEC(t2), 90, NULL, return 58);
+
+    PJ_TEST_SUCCESS(pj_dns_server_set_impair(srv, NULL, NULL), NULL,
+                    return 59);
+    return 0;
+}
+
+/* Keep a window of queries in flight and measure the answer rate */
+static int burst_test(test_ctx *ctx)
+{
+    pj_time_val t1, t2;
+    unsigned sent = 0, recvd = 0, msec;
+    int rc;
+
+    pj_gettickcount(&t1);
+    while (recvd < BURST_CNT) {
+        while (sent < BURST_CNT && sent - recvd < 32) {
+            if ((rc = send_query(ctx, PJ_DNS_TYPE_SRV,
+                                 "_sip._udp.example.com")))
+            {
+                return rc;
+            }
+            ++sent;
+        }
+        PJ_TEST_NOT_NULL(recv_answer(ctx, 1000), NULL, return 70);
+        ++recvd;
+        if ((recvd % 256) == 0)
+            pj_pool_reset(ctx->pool);
+    }
+    pj_gettickcount(&t2);
+
+    PJ_TIME_VAL_SUB(t2, t1);
+    msec = PJ_TIME_VAL_MSEC(t2);
+    PJ_LOG(3,(THIS_FILE, "  %u SRV queries answered in %u ms (%u qps)",
+              recvd, msec, msec ? recvd * 1000 / msec : recvd));
+    return 0;
+}
+
+int dns_server_test(void)
+{
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_dns_server *srv = NULL;
+    pj_thread_t *thread = NULL;
+    pj_dns_server_stat stat;
+    pj_str_t localhost = pj_str("127.0.0.1");
+    pj_str_t text;
+    unsigned count;
+    test_ctx ctx;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "dnssrvtest", 1000, 1000, NULL);
+    pj_bzero(&ctx, sizeof(ctx));
+    ctx.sock = PJ_INVALID_SOCKET;
+    ctx.pool = pj_pool_create(mem, "dnssrvans", 4000, 4000, NULL);
+
+    PJ_TEST_SUCCESS(pj_ioqueue_create(pool, 16, &ioqueue), NULL,
+                    { rc = 1; goto on_return; });
+    PJ_TEST_SUCCESS(pj_timer_heap_create(pool, 16, &ctx.timer_heap), NULL,
+                    { rc = 2; goto on_return; });
+    PJ_TEST_SUCCESS(pj_dns_server_create(mem, ioqueue, pj_AF_INET(), 0, 0,
+                                         &srv),
+                    NULL, { rc = 3; goto on_return; });
+
+    text = pj_str((char*)zone);
+    PJ_TEST_SUCCESS(pj_dns_server_add_zone(srv, &text, &count), NULL,
+                    { rc = 4; goto on_return; });
+    PJ_TEST_EQ(count, 9, NULL, { rc = 5; goto on_return; });
+
+    /* Bad zone */
+    text = pj_str("$ORIGIN example.net.\nhost IN A not-an-address\n");
+    PJ_TEST_TRUE(pj_dns_server_add_zone(srv, &text, NULL) != PJ_SUCCESS,
+                 NULL, { rc = 6; goto on_return; });
+
+    PJ_TEST_SUCCESS(pj_dns_server_get_addr(srv, &ctx.srv_addr), NULL,
+                    { rc = 7; goto on_return; });
+    pj_sockaddr_init(pj_AF_INET(), &ctx.srv_addr, &localhost,
+                     pj_sockaddr_get_port(&ctx.srv_addr));
+
+    PJ_TEST_SUCCESS(pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0,
+                                   &ctx.sock),
+                    NULL, { rc = 8; goto on_return; });
+
+    poll_quit = PJ_FALSE;
+    PJ_TEST_SUCCESS(pj_thread_create(pool, "dnspoll", &poll_thread, ioqueue,
+                                     0, 0, &thread),
+                    NULL, { rc = 9; goto on_return; });
+
+    rc = query_test(&ctx);
+    if (rc == 0)
+        rc = impair_test(&ctx, srv);
+    if (rc == 0)
+        rc = burst_test(&ctx);
+    if (rc)
+        goto on_return;
+
+    /* The last answer may be counted after it was received */
+    for (count = 0; count < 100; ++count) {
+        PJ_TEST_SUCCESS(pj_dns_server_get_stat(srv, &stat), NULL,
+                        { rc = 80; goto on_return; });
+        if (stat.tx_cnt + stat.drop_cnt == stat.rx_cnt)
+            break;
+        pj_thread_sleep(10);
+    }
+    PJ_TEST_EQ(stat.rx_cnt, BURST_CNT + 8, NULL, { rc = 81; goto on_return; });
+    PJ_TEST_EQ(stat.drop_cnt, 1, NULL, { rc = 82; goto on_return; });
+    PJ_TEST_EQ(stat.tc_cnt, 1, NULL, { rc = 83; goto on_return; });
+    PJ_TEST_EQ(stat.nxdomain_cnt, 1, NULL, { rc = 84; goto on_return; });
+    PJ_TEST_EQ(stat.tx_cnt, stat.rx_cnt - stat.drop_cnt, NULL,
+               { rc = 85; goto on_return; });
+
+on_return:
+    if (thread) {
+        poll_quit = PJ_TRUE;
+        pj_thread_join(thread);
+        pj_thread_destroy(thread);
+    }
+    if (ctx.sock != PJ_INVALID_SOCKET)
+        pj_sock_close(ctx.sock);
+    if (srv)
+        pj_dns_server_destroy(srv);
+    if (ctx.timer_heap)
+        pj_timer_heap_destroy(ctx.timer_heap);
+    if (ioqueue)
+        pj_ioqueue_destroy(ioqueue);
+    pj_pool_release(ctx.pool);
+    pj_pool_release(pool);
+    return rc;
+}
+
+#else
+int dns_server_test_dummy;
+#endif
@@ -444,6 +444,21 @@ struct crc32_test_t
     }
 };
 
+/* Reference CRC32 implementation, one bit at a time */
+static pj_uint32_t crc32_bitwise(const pj_uint8_t *data, pj_size_t len)
+{
+    pj_uint32_t crc = 0xFFFFFFFF;
+
+    while (len--) {
+        int j;
+
+        crc ^= *data++;
+        for (j=0; j<8; ++j)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
 /*
  * CRC32 test
  */
@@ -492,6 +507,26 @@ static int crc32_test(void)
         }
 
     }
+
+    /* Compare against bitwise calculation, with various lengths and
+     * alignments to exercise the multi-byte code paths.
+     */
+    {
+        pj_uint8_t data[300];
+        unsigned off, len;
+
+        for (i=0; i<sizeof(data); ++i)
+            data[i] = (pj_uint8_t)(pj_rand() & 0xFF);
+
+        for (off=0; off<8; ++off) {
+            for (len=0; off+len<=sizeof(data); len+=7) {
+                PJ_TEST_EQ(pj_crc32_calc(data+off, len),
+                           crc32_bitwise(data+off, len),
+                           NULL, return -87);
+            }
+        }
+    }
+
     return 0;
 }
 
@@ -624,6 +659,30 @@ static int base64_test(void)
         }
     }
 
+    /* Round trip of random data of various lengths */
+    for (i=0; i<=48; ++i) {
+        pj_uint8_t data[48], decoded[48];
+        char encoded[PJ_BASE256_TO_BASE64_LEN(48)];
+        pj_str_t input;
+        int enc_len, dec_len;
+        unsigned k;
+
+        for (k=0; k<i; ++k)
+            data[k] = (pj_uint8_t)(pj_rand() & 0xFF);
+
+        enc_len = sizeof(encoded);
+        PJ_TEST_SUCCESS(pj_base64_encode(data, i, encoded, &enc_len),
+                        NULL, return -98);
+
+        input.ptr = encoded;
+        input.slen = enc_len;
+        dec_len = sizeof(decoded);
+        PJ_TEST_SUCCESS(pj_base64_decode(&input, decoded, &dec_len),
+                        NULL, return -99);
+        PJ_TEST_EQ(dec_len, (int)i, NULL, return -100);
+        PJ_TEST_EQ(pj_memcmp(data, decoded, i), 0, NULL, return -101);
+    }
+
     return 0;
 }
 
@@ -767,6 +826,60 @@ int encryption_benchmark()
                    ((unsigned)(bytes) % (1024 * 1024)) / 1024));
     }
 
+    /* Short messages, as done for every STUN/TURN packet and for SDES
+     * crypto attributes.
+     */
+    {
+        enum { MSG_LEN = 120, KEY_LEN = 16, B64_LEN = 30 };
+        pj_uint8_t key[KEY_LEN];
+        char b64[PJ_BASE256_TO_BASE64_LEN(B64_LEN)];
+        pj_uint32_t crc = 0;
+        pj_timestamp t1, t2;
+        pj_str_t b64_str;
+        int j, len;
+
+        pj_memset(key, '\x55', sizeof(key));
+
+        pj_get_timestamp(&t1);
+        for (j=0; j<LOOP*10; ++j) {
+            pj_hmac_sha1(input, MSG_LEN, key, KEY_LEN, digest);
+        }
+        pj_get_timestamp(&t2);
+        PJ_LOG(3, (THIS_FILE, "    HMAC-SHA1 (%d bytes): %d nsec/msg",
+                   MSG_LEN, pj_elapsed_nanosec(&t1, &t2) / (LOOP*10)));
+
+        pj_get_timestamp(&t1);
+        for (j=0; j<LOOP*10; ++j) {
+            crc ^= pj_crc32_calc(input, MSG_LEN);
+        }
+        pj_get_timestamp(&t2);
+        PJ_LOG(3, (THIS_FILE, "    CRC32 (%d bytes): %d nsec/msg",
+                   MSG_LEN, pj_elapsed_nanosec(&t1, &t2) / (LOOP*10)));
+
+        pj_get_timestamp(&t1);
+        for (j=0; j<LOOP*10; ++j) {
+            len = sizeof(b64);
+            pj_base64_encode(input, B64_LEN, b64, &len);
+        }
+        pj_get_timestamp(&t2);
+        PJ_LOG(3, (THIS_FILE, "    base64 encode (%d bytes): %d nsec/msg",
+                   B64_LEN, pj_elapsed_nanosec(&t1, &t2) / (LOOP*10)));
+
+        b64_str.ptr = b64;
+        b64_str.slen = len;
+        pj_get_timestamp(&t1);
+        for (j=0; j<LOOP*10; ++j) {
+            len = sizeof(digest);
+            pj_base64_decode(&b64_str, digest, &len);
+        }
+        pj_get_timestamp(&t2);
+        PJ_LOG(3, (THIS_FILE, "    base64 decode (%d bytes): %d nsec/msg",
+                   B64_LEN, pj_elapsed_nanosec(&t1, &t2) / (LOOP*10)));
+
+        PJ_UNUSED_ARG(crc);
+    }
+
+    pj_pool_release(pool);
     return 0;
 }
 
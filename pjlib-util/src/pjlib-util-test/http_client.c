@@ -46,6 +46,15 @@ static struct server_t
     pj_bool_t       send_content_length;
     unsigned        data_size;
     unsigned        buf_size;
+
+    /* Reply with HTTP/1.1 and keep the connection open for the next
+     * request.
+     */
+    pj_bool_t       keep_alive;
+    /* Send the body with chunked Transfer-Encoding */
+    pj_bool_t       chunked;
+    /* Number of connections accepted */
+    unsigned        accept_cnt;
 } g_server;
 
 static pj_bool_t thread_quit;
@@ -60,6 +69,53 @@ static pj_status_t sstatus;
 static pj_sockaddr_in addr;
 static int counter = 0;
 
+/* Body content of keep-alive responses, verified by the client */
+static char body_char(unsigned pos)
+{
+    return (char)('a' + pos % 26);
+}
+
+/* Send the response body in chunks of varying size */
+static pj_status_t send_chunked_body(pj_sock_t sock, char *pkt,
+                                     unsigned buf_size, unsigned data_size)
+{
+    unsigned pos = 0, chunk_size = 1;
+    pj_ssize_t len;
+    pj_status_t rc;
+
+    while (pos < data_size) {
+        unsigned i;
+
+        if (chunk_size > data_size - pos)
+            chunk_size = data_size - pos;
+        if (chunk_size > buf_size)
+            chunk_size = buf_size;
+
+        len = pj_ansi_snprintf(pkt, buf_size, "%x;ext=1\r\n", chunk_size);
+        rc = pj_sock_send(sock, pkt, &len, 0);
+        if (rc != PJ_SUCCESS)
+            return rc;
+
+        for (i = 0; i < chunk_size; ++i)
+            pkt[i] = body_char(pos + i);
+        len = chunk_size;
+        rc = pj_sock_send(sock, pkt, &len, 0);
+        if (rc != PJ_SUCCESS)
+            return rc;
+
+        len = 2;
+        rc = pj_sock_send(sock, "\r\n", &len, 0);
+        if (rc != PJ_SUCCESS)
+            return rc;
+
+        pos += chunk_size;
+        chunk_size = chunk_size * 7 + 3;
+    }
+
+    len = pj_ansi_snprintf(pkt, buf_size, "0\r\nX-Trailer: 1\r\n\r\n");
+    return pj_sock_send(sock, pkt, &len, 0);
+}
+
 static int server_thread(void *p)
 {
     struct server_t *srv = (struct server_t*)p;
@@ -72,6 +128,24 @@ static int server_thread(void *p)
         pj_fd_set_t rset;
         pj_time_val timeout = {0, 500};
 
+        /* Wait for the next request on a kept connection */
+        if (newsock != PJ_INVALID_SOCKET) {
+            PJ_FD_ZERO(&rset);
+            PJ_FD_SET(newsock, &rset);
+            rc = pj_sock_select((int)newsock+1, &rset, NULL, NULL, &timeout);
+            if (rc != 1)
+                continue;
+
+            pkt_len = srv->buf_size;
+            rc = pj_sock_recv(newsock, pkt, &pkt_len, 0);
+            if (rc != PJ_SUCCESS || pkt_len == 0) {
+                pj_sock_close(newsock);
+                newsock = PJ_INVALID_SOCKET;
+                continue;
+            }
+            goto on_request;
+        }
+
         while (!thread_quit) {
             PJ_FD_ZERO(&rset);
             PJ_FD_SET(srv->sock, &rset);
@@ -82,6 +156,7 @@ static int server_thread(void *p)
 
             rc = pj_sock_accept(srv->sock, &newsock, NULL, NULL);
             if (rc == PJ_SUCCESS) {
+                ++srv->accept_cnt;
                 break;
             }
         }
@@ -108,6 +183,7 @@ static int server_thread(void *p)
         if (thread_quit)
             break;
 
+on_request:
         /* Simulate network RTT */
         pj_thread_sleep(50);
 
@@ -117,14 +193,18 @@ static int server_thread(void *p)
             pj_size_t send_len = 0;
             unsigned ctr = 0;
             pkt_len = pj_ansi_snprintf(pkt, srv->buf_size, 
-                                       "HTTP/1.0 200 OK\r\n");
+                                       "HTTP/1.%d 200 OK\r\n",
+                                       srv->keep_alive ? 1 : 0);
             PJ_ASSERT_ON_FAIL(pkt_len>0, {
                 PJ_LOG(2, (THIS_FILE, "Error creating response, pkt_len=%ld",
                            pkt_len));
                 pj_sock_close(newsock);
                 continue;
             })
-            if (srv->send_content_length) {
+            if (srv->chunked) {
+                pj_ansi_strxcat(pkt, "Transfer-Encoding: chunked\r\n",
+                                srv->buf_size);
+            } else if (srv->send_content_length) {
                 pj_ansi_snprintf(pkt + pkt_len, srv->buf_size - pkt_len,
                                 "Content-Length: %d\r\n",
                                 srv->data_size);
@@ -139,8 +219,28 @@ static int server_thread(void *p)
             rc = pj_sock_send(newsock, pkt, &pkt_len, 0);
             if (rc != PJ_SUCCESS) {
                 pj_sock_close(newsock);
+                newsock = PJ_INVALID_SOCKET;
                 continue;
             }
+            if (srv->chunked) {
+                send_chunked_body(newsock, pkt, srv->buf_size,
+                                  srv->data_size);
+            } else if (srv->keep_alive) {
+                while (send_len < srv->data_size) {
+                    pj_ssize_t i;
+
+                    pkt_len = srv->data_size - send_len;
+                    if (pkt_len > (signed)srv->buf_size)
+                        pkt_len = srv->buf_size;
+                    for (i = 0; i < pkt_len; ++i)
+                        pkt[i] = body_char((unsigned)(send_len + i));
+                    send_len += pkt_len;
+                    if (pj_sock_send(newsock, pkt, &pkt_len, 0))
+                        break;
+                }
+            }
+            if (srv->keep_alive)
+                continue;
             while (send_len < srv->data_size) {
                 pkt_len = srv->data_size - send_len;
                 if (pkt_len > (signed)srv->buf_size)
@@ -154,9 +254,16 @@ static int server_thread(void *p)
                     break;
             }
             pj_sock_close(newsock);
+            newsock = PJ_INVALID_SOCKET;
+        } else {
+            pj_sock_close(newsock);
+            newsock = PJ_INVALID_SOCKET;
         }
     }
 
+    if (newsock != PJ_INVALID_SOCKET)
+        pj_sock_close(newsock);
+
     return 0;
 }
 
@@ -923,6 +1030,160 @@ int http_client_test_delete()
     return PJ_SUCCESS;
 }
 
+/*
+ * Connection pool: sequential requests share one keep-alive connection,
+ * with the body delimited by Content-Length or chunked encoding.
+ */
+static pj_status_t pool_status;
+static pj_bool_t pool_body_ok;
+
+static void pool_on_complete(pj_http_req *hreq, pj_status_t status,
+                             const pj_http_resp *resp)
+{
+    unsigned i;
+
+    PJ_UNUSED_ARG(hreq);
+
+    pool_status = status;
+    if (status != PJ_SUCCESS)
+        return;
+
+    pool_body_ok = (resp->size == g_server.data_size);
+    for (i = 0; pool_body_ok && i < resp->size; ++i) {
+        if (((char*)resp->data)[i] != body_char(i))
+            pool_body_ok = PJ_FALSE;
+    }
+}
+
+int http_client_test_pool()
+{
+    pj_str_t url;
+    pj_http_req_callback hcb;
+    pj_http_req_param param;
+    pj_http_conn_pool *cpool;
+    pj_http_conn_pool_stat stat;
+    char urlbuf[80];
+    unsigned i;
+    int rc = 0;
+
+    pj_bzero(&hcb, sizeof(hcb));
+    hcb.on_complete = &pool_on_complete;
+
+    /* Create pool, timer, and ioqueue */
+    pool = pj_pool_create(mem, NULL, 8192, 4096, NULL);
+    if (pj_timer_heap_create(pool, 16, &timer_heap))
+        return -71;
+    if (pj_ioqueue_create(pool, 16, &ioqueue))
+        return -72;
+    if (pj_http_conn_pool_create(pool, timer_heap, ioqueue, NULL, &cpool))
+        return -73;
+
+    thread_quit = PJ_FALSE;
+    g_server.action = ACTION_REPLY;
+    g_server.send_content_length = PJ_TRUE;
+    g_server.keep_alive = PJ_TRUE;
+    g_server.accept_cnt = 0;
+    g_server.buf_size = 1024;
+
+    sstatus = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0, 
+                             &g_server.sock);
+    if (sstatus != PJ_SUCCESS)
+        return -41;
+
+    pj_sockaddr_in_init(&addr, NULL, 0);
+
+    sstatus = pj_sock_bind(g_server.sock, &addr, sizeof(addr));
+    if (sstatus != PJ_SUCCESS)
+        return -43;
+
+    {
+        pj_sockaddr_in addr2;
+        int addr_len = sizeof(addr2);
+        sstatus = pj_sock_getsockname(g_server.sock, &addr2, &addr_len);
+        if (sstatus != PJ_SUCCESS)
+            return -44;
+        g_server.port = pj_sockaddr_in_get_port(&addr2);
+        pj_ansi_snprintf(urlbuf, sizeof(urlbuf),
+                         "http://127.0.0.1:%d/test/pool.txt",
+                         g_server.port);
+        url = pj_str(urlbuf);
+    }
+
+    sstatus = pj_sock_listen(g_server.sock, 8);
+    if (sstatus != PJ_SUCCESS)
+        return -45;
+
+    sstatus = pj_thread_create(pool, NULL, &server_thread, &g_server,
+                               0, 0, &g_server.thread);
+    if (sstatus != PJ_SUCCESS)
+        return -47;
+
+    pj_http_req_param_default(&param);
+    pj_strset2(&param.version, (char*)"1.1");
+    param.conn_pool = cpool;
+
+    for (i = 0; i < 4 && rc == 0; ++i) {
+        /* Alternate between Content-Length and chunked responses, with
+         * an empty body in the last one.
+         */
+        g_server.chunked = (i & 1);
+        g_server.data_size = (i == 3 ? 0 : 3000 + i * 17);
+        pool_status = PJ_EPENDING;
+        pool_body_ok = PJ_FALSE;
+
+        if (pj_http_req_create(pool, &url, timer_heap, ioqueue,
+                               &param, &hcb, &http_req))
+        {
+            rc = -74;
+            break;
+        }
+        if (pj_http_req_start(http_req)) {
+            pj_http_req_destroy(http_req);
+            rc = -75;
+            break;
+        }
+
+        while (pj_http_req_is_running(http_req)) {
+            pj_time_val delay = {0, 50};
+            pj_ioqueue_poll(ioqueue, &delay);
+            pj_timer_heap_poll(timer_heap, NULL);
+        }
+        pj_http_req_destroy(http_req);
+
+        if (pool_status != PJ_SUCCESS)
+            rc = -76;
+        else if (!pool_body_ok)
+            rc = -77;
+    }
+
+    if (rc == 0) {
+        /* All requests must have been sent over the same connection */
+        pj_http_conn_pool_get_stat(cpool, &stat);
+        if (g_server.accept_cnt != 1 || stat.created != 1 ||
+            stat.reused != 3 || stat.idle != 1)
+        {
+            PJ_LOG(3, (THIS_FILE, "accepted=%u created=%u reused=%u "
+                       "idle=%u", g_server.accept_cnt, stat.created,
+                       stat.reused, stat.idle));
+            rc = -78;
+        }
+    }
+
+    if (pj_http_conn_pool_destroy(cpool) != PJ_SUCCESS && rc == 0)
+        rc = -79;
+
+    thread_quit = PJ_TRUE;
+    pj_thread_join(g_server.thread);
+    pj_sock_close(g_server.sock);
+    g_server.keep_alive = g_server.chunked = PJ_FALSE;
+
+    pj_ioqueue_destroy(ioqueue);
+    pj_timer_heap_destroy(timer_heap);
+    pj_pool_release(pool);
+
+    return rc;
+}
+
 int http_client_test()
 {
     int rc;
@@ -957,6 +1218,11 @@ int http_client_test()
     if (rc)
         return rc;
 
+    PJ_LOG(3, (THIS_FILE, "..Testing connection pool"));
+    rc = http_client_test_pool();
+    if (rc)
+        return rc;
+
     return PJ_SUCCESS;
 }
 
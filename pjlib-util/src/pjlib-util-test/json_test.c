@@ -86,6 +86,241 @@ on_error:
     return 10;
 }
 
+static char json_doc2[] =
+"{ \"name\": \"Al\\\"ice\", \"age\": -42.5, \"tags\": [\"a\", \"b\"],\
+   \"skipped\": { \"x\": [1, 2, {\"y\": null}] }, \"ok\": true }";
+
+/* Verify the pull reader */
+static int json_verify_2()
+{
+    char buf[sizeof(json_doc2)];
+    pj_json_reader rd;
+    pj_json_token tok;
+    unsigned i;
+    static const struct {
+        pj_json_token_type type;
+        const char *name;
+        const char *str;
+    } expected[] = {
+        { PJ_JSON_TOKEN_OBJ_START,   "",     NULL },
+        { PJ_JSON_TOKEN_STRING,      "name", "Al\"ice" },
+        { PJ_JSON_TOKEN_NUMBER,      "age",  "-42.5" },
+        { PJ_JSON_TOKEN_ARRAY_START, "tags", NULL },
+        { PJ_JSON_TOKEN_STRING,      "",     "a" },
+        { PJ_JSON_TOKEN_STRING,      "",     "b" },
+        { PJ_JSON_TOKEN_ARRAY_END,   "",     NULL },
+        { PJ_JSON_TOKEN_OBJ_START,   "skipped", NULL },
+        /* pj_json_reader_skip() is called here */
+        { PJ_JSON_TOKEN_BOOL,        "ok",   NULL },
+        { PJ_JSON_TOKEN_OBJ_END,     "",     NULL },
+    };
+
+    pj_memcpy(buf, json_doc2, sizeof(json_doc2));
+    pj_json_reader_init(&rd, buf, (unsigned)strlen(buf));
+
+    for (i=0; i<PJ_ARRAY_SIZE(expected); ++i) {
+        PJ_TEST_SUCCESS(pj_json_reader_next(&rd, &tok), NULL, return 20);
+        PJ_TEST_EQ(tok.type, expected[i].type, NULL, return 21);
+        PJ_TEST_EQ(pj_strcmp2(&tok.name, expected[i].name), 0, NULL,
+                   return 22);
+        if (expected[i].str) {
+            PJ_TEST_EQ(pj_strcmp2(&tok.str, expected[i].str), 0, NULL,
+                       return 23);
+            /* Must point to the input buffer */
+            PJ_TEST_TRUE(tok.str.ptr > buf &&
+                         tok.str.ptr < buf + sizeof(buf), NULL, return 24);
+        }
+        if (tok.type == PJ_JSON_TOKEN_OBJ_START && tok.name.slen) {
+            PJ_TEST_SUCCESS(pj_json_reader_skip(&rd), NULL, return 25);
+            PJ_TEST_EQ(pj_json_reader_depth(&rd), 1, NULL, return 26);
+        }
+    }
+    PJ_TEST_EQ(pj_json_reader_next(&rd, &tok), PJ_EEOF, NULL, return 27);
+
+    /* Syntax error */
+    pj_ansi_strxcpy(buf, "[ 1,\n  2, nul ]", sizeof(buf));
+    pj_json_reader_init(&rd, buf, (unsigned)strlen(buf));
+    while (pj_json_reader_next(&rd, &tok) == PJ_SUCCESS)
+        ;
+    {
+        pj_json_err_info err;
+
+        pj_json_reader_get_err_info(&rd, &err);
+        PJ_TEST_EQ(err.line, 2, NULL, return 28);
+        PJ_TEST_EQ(err.col, 6, NULL, return 29);
+    }
+
+    return 0;
+}
+
+struct str_output
+{
+    char        *buf;
+    unsigned     len;
+    unsigned     size;
+    unsigned     calls;
+};
+
+static pj_status_t str_writer(const char *s, unsigned size, void *user_data)
+{
+    struct str_output *out = (struct str_output*)user_data;
+
+    if (out->len + size >= out->size)
+        return PJ_ETOOBIG;
+    pj_memcpy(out->buf + out->len, s, size);
+    out->len += size;
+    out->buf[out->len] = '\0';
+    ++out->calls;
+    return PJ_SUCCESS;
+}
+
+/* Verify that the stream writer produces the same document as the
+ * element tree writer.
+ */
+static int json_verify_3()
+{
+    pj_pool_t *pool;
+    pj_json_elem *elem;
+    pj_json_stream_writer sw;
+    struct str_output out;
+    char *doc, *tree_out, sw_buf[64];
+    pj_str_t name, val;
+    unsigned size;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "json", 1000, 1000, NULL);
+
+    doc = pj_pool_alloc(pool, sizeof(json_doc2));
+    pj_memcpy(doc, json_doc2, sizeof(json_doc2));
+    size = (unsigned)strlen(doc);
+    elem = pj_json_parse(pool, doc, &size, NULL);
+    PJ_TEST_NOT_NULL(elem, NULL, { rc = 30; goto on_return; });
+
+    size = 1000;
+    tree_out = pj_pool_alloc(pool, size);
+    PJ_TEST_SUCCESS(pj_json_write(elem, tree_out, &size), NULL,
+                    { rc = 31; goto on_return; });
+
+    out.size = 1000;
+    out.buf = pj_pool_alloc(pool, out.size);
+    out.len = out.calls = 0;
+
+    pj_json_sw_init(&sw, sw_buf, sizeof(sw_buf), &str_writer, &out);
+    pj_json_sw_begin_obj(&sw, NULL);
+    pj_json_sw_string(&sw, pj_cstr(&name, "name"),
+                      pj_cstr(&val, "Al\"ice"));
+    pj_json_sw_number(&sw, pj_cstr(&name, "age"), -42.5);
+    pj_json_sw_begin_array(&sw, pj_cstr(&name, "tags"));
+    pj_json_sw_string(&sw, NULL, pj_cstr(&val, "a"));
+    pj_json_sw_string(&sw, NULL, pj_cstr(&val, "b"));
+    pj_json_sw_end(&sw);
+    pj_json_sw_begin_obj(&sw, pj_cstr(&name, "skipped"));
+    pj_json_sw_begin_array(&sw, pj_cstr(&name, "x"));
+    pj_json_sw_number(&sw, NULL, 1);
+    pj_json_sw_number(&sw, NULL, 2);
+    pj_json_sw_begin_obj(&sw, NULL);
+    pj_json_sw_null(&sw, pj_cstr(&name, "y"));
+    pj_json_sw_end(&sw);
+    pj_json_sw_end(&sw);
+    pj_json_sw_end(&sw);
+    pj_json_sw_bool(&sw, pj_cstr(&name, "ok"), PJ_TRUE);
+    pj_json_sw_end(&sw);
+    PJ_TEST_SUCCESS(pj_json_sw_flush(&sw), NULL,
+                    { rc = 32; goto on_return; });
+
+    PJ_TEST_EQ(out.len, size, NULL, { rc = 33; goto on_return; });
+    PJ_TEST_EQ(pj_ansi_strcmp(out.buf, tree_out), 0, NULL,
+               { rc = 34; goto on_return; });
+    /* Output must have been coalesced */
+    PJ_TEST_LTE(out.calls, out.len / sizeof(sw_buf) + 1, NULL,
+                { rc = 35; goto on_return; });
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+/* pj_json_parse() must not modify the buffer */
+static int json_verify_4()
+{
+    char buf[sizeof(json_doc2)];
+    pj_pool_t *pool;
+    pj_json_elem *root, *name;
+    unsigned size;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "json", 1000, 1000, NULL);
+
+    pj_memcpy(buf, json_doc2, sizeof(json_doc2));
+    size = (unsigned)strlen(buf);
+    root = pj_json_parse(pool, buf, &size, NULL);
+    PJ_TEST_NOT_NULL(root, NULL, { rc = 40; goto on_return; });
+    PJ_TEST_EQ(pj_memcmp(buf, json_doc2, sizeof(json_doc2)), 0, NULL,
+               { rc = 41; goto on_return; });
+
+    /* Plain strings refer to the buffer, escaped ones are decoded */
+    name = root->value.children.next;
+    PJ_TEST_EQ(pj_strcmp2(&name->name, "name"), 0, NULL,
+               { rc = 42; goto on_return; });
+    PJ_TEST_EQ(name->name.ptr, buf + 3, NULL, { rc = 43; goto on_return; });
+    PJ_TEST_EQ(pj_strcmp2(&name->value.str, "Al\"ice"), 0, NULL,
+               { rc = 44; goto on_return; });
+    PJ_TEST_TRUE(name->value.str.ptr < buf ||
+                 name->value.str.ptr >= buf + sizeof(buf), NULL,
+                 { rc = 45; goto on_return; });
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+/* Nesting limit of pj_json_parse() and pj_json_write() */
+static int json_verify_5()
+{
+    char doc[(PJ_JSON_MAX_DEPTH+1) * 2 + 1];
+    char out[(PJ_JSON_MAX_DEPTH+1) * 8];
+    pj_pool_t *pool;
+    pj_json_elem *root, *elem, *parent;
+    unsigned depth, i, size;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "json", 1000, 1000, NULL);
+
+    for (depth=PJ_JSON_MAX_DEPTH; depth<=PJ_JSON_MAX_DEPTH+1; ++depth) {
+        pj_bool_t ok = (depth <= PJ_JSON_MAX_DEPTH);
+
+        /* Parse "[[...]]" nested depth levels */
+        for (i=0; i<depth; ++i) {
+            doc[i] = '[';
+            doc[depth*2-1-i] = ']';
+        }
+        doc[depth*2] = '\0';
+        size = depth * 2;
+        root = pj_json_parse(pool, doc, &size, NULL);
+        PJ_TEST_EQ(root != NULL, ok, NULL, { rc = 50; goto on_return; });
+
+        /* Write the same document from a tree */
+        root = parent = NULL;
+        for (i=0; i<depth; ++i) {
+            elem = PJ_POOL_ALLOC_T(pool, pj_json_elem);
+            pj_json_elem_array(elem, NULL);
+            if (parent)
+                pj_json_elem_add(parent, elem);
+            else
+                root = elem;
+            parent = elem;
+        }
+        size = sizeof(out);
+        PJ_TEST_EQ(pj_json_write(root, out, &size),
+                   (ok ? PJ_SUCCESS : PJ_ETOOMANY), NULL,
+                   { rc = 51; goto on_return; });
+    }
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
 
 int json_test(void)
 {
@@ -95,6 +330,22 @@ int json_test(void)
     if (rc)
         return rc;
 
+    rc = json_verify_2();
+    if (rc)
+        return rc;
+
+    rc = json_verify_3();
+    if (rc)
+        return rc;
+
+    rc = json_verify_4();
+    if (rc)
+        return rc;
+
+    rc = json_verify_5();
+    if (rc)
+        return rc;
+
     return 0;
 }
 
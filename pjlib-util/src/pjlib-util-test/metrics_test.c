@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE       "metrics_test.c"
+
+#if INCLUDE_METRICS_TEST
+
+#include <pjlib-util/metrics.h>
+#include <pj/errno.h>
+#include <pj/ioqueue.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/sock.h>
+#include <pj/string.h>
+
+#define THREAD_CNT      4
+#define INC_CNT         100000
+
+/* Rendered output */
+typedef struct out_buf
+{
+    char        buf[2048];
+    unsigned    len;
+} out_buf;
+
+static pj_status_t out_writer(const char *s, unsigned size, void *user_data)
+{
+    out_buf *o = (out_buf*)user_data;
+
+    if (o->len + size >= sizeof(o->buf))
+        return PJ_ETOOSMALL;
+    pj_memcpy(o->buf + o->len, s, size);
+    o->len += size;
+    o->buf[o->len] = '\0';
+    return PJ_SUCCESS;
+}
+
+static int inc_thread(void *arg)
+{
+    pj_metric *m = (pj_metric*)arg;
+    unsigned i;
+
+    for (i = 0; i < INC_CNT; ++i)
+        pj_metric_inc(m);
+    return 0;
+}
+
+static void collect_cb(pj_metrics *metrics, void *user_data)
+{
+    pj_metric *m = pj_metrics_find(metrics, "test_collected");
+
+    ++*(unsigned*)user_data;
+    pj_metric_set(m, 42);
+}
+
+static int registry_test(pj_metrics *metrics)
+{
+    static const pj_int64_t bounds[] = { 10, 100 };
+    pj_pool_t *pool;
+    pj_metric *cnt, *gauge, *hist, *m;
+    pj_thread_t *thread[THREAD_CNT];
+    unsigned i, collect_cnt = 0;
+    pj_str_t prefix;
+    out_buf out;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "metrics", 1000, 1000, NULL);
+
+    PJ_TEST_SUCCESS(pj_metrics_add_counter(metrics, "test_inc_total",
+                                           "Increments", &cnt),
+                    NULL, { rc = 10; goto on_return; });
+    PJ_TEST_SUCCESS(pj_metrics_add_gauge(metrics, "test_gauge", NULL, &gauge),
+                    NULL, { rc = 11; goto on_return; });
+    PJ_TEST_SUCCESS(pj_metrics_add_histogram(metrics, "test_latency", NULL,
+                                             PJ_ARRAY_SIZE(bounds), bounds,
+                                             &hist),
+                    NULL, { rc = 12; goto on_return; });
+
+    /* Registering again returns the same metric */
+    PJ_TEST_SUCCESS(pj_metrics_add_counter(metrics, "test_inc_total", NULL,
+                                           &m),
+                    NULL, { rc = 13; goto on_return; });
+    PJ_TEST_TRUE(m == cnt, NULL, { rc = 14; goto on_return; });
+    PJ_TEST_EQ(pj_metrics_add_gauge(metrics, "test_inc_total", NULL, &m),
+               PJ_EEXISTS, NULL, { rc = 15; goto on_return; });
+    PJ_TEST_EQ(pj_metrics_add_counter(metrics, "9bad name", NULL, &m),
+               PJ_EINVAL, NULL, { rc = 16; goto on_return; });
+    PJ_TEST_TRUE(pj_metrics_find(metrics, "test_gauge") == gauge, NULL,
+                 { rc = 17; goto on_return; });
+    PJ_TEST_TRUE(pj_metrics_find(metrics, "test_none") == NULL, NULL,
+                 { rc = 18; goto on_return; });
+
+    /* Concurrent increments must not be lost */
+    for (i = 0; i < THREAD_CNT; ++i) {
+        PJ_TEST_SUCCESS(pj_thread_create(pool, "minc", &inc_thread, cnt, 0, 0,
+                                         &thread[i]),
+                        NULL, { rc = 20; goto on_return; });
+    }
+    for (i = 0; i < THREAD_CNT; ++i) {
+        pj_thread_join(thread[i]);
+        pj_thread_destroy(thread[i]);
+    }
+    PJ_TEST_EQ(pj_metric_get(cnt), THREAD_CNT * INC_CNT, NULL,
+               { rc = 21; goto on_return; });
+
+    pj_metric_set(gauge, 5);
+    pj_metric_add(gauge, -2);
+    PJ_TEST_EQ(pj_metric_get(gauge), 3, NULL, { rc = 22; goto on_return; });
+
+    pj_metric_observe(hist, 5);
+    pj_metric_observe(hist, 10);
+    pj_metric_observe(hist, 50);
+    pj_metric_observe(hist, 500);
+    PJ_TEST_EQ(pj_metric_get(hist), 4, NULL, { rc = 23; goto on_return; });
+
+    /* NULL metrics are ignored */
+    pj_metric_inc(NULL);
+    pj_metric_observe(NULL, 1);
+
+    /* Rendering */
+    out.len = 0;
+    prefix = pj_str("test_latency");
+    PJ_TEST_SUCCESS(pj_metrics_write(metrics, &prefix, &out_writer, &out),
+                    NULL, { rc = 30; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(out.buf, "# TYPE test_latency histogram"),
+                     NULL, { rc = 31; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(out.buf,
+                                    "test_latency_bucket{le=\"10\"} 2\n"),
+                     NULL, { rc = 32; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(out.buf,
+                                    "test_latency_bucket{le=\"100\"} 3\n"),
+                     NULL, { rc = 33; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(out.buf,
+                                    "test_latency_bucket{le=\"+Inf\"} 4\n"),
+                     NULL, { rc = 34; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(out.buf, "test_latency_sum 565\n"),
+                     NULL, { rc = 35; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(out.buf, "test_latency_count 4\n"),
+                     NULL, { rc = 36; goto on_return; });
+    PJ_TEST_TRUE(pj_ansi_strstr(out.buf, "test_gauge") == NULL, NULL,
+                 { rc = 37; goto on_return; });
+
+    /* Collector */
+    PJ_TEST_SUCCESS(pj_metrics_add_gauge(metrics, "test_collected", NULL,
+                                         &m),
+                    NULL, { rc = 40; goto on_return; });
+    PJ_TEST_SUCCESS(pj_metrics_add_collector(metrics, &collect_cb,
+                                             &collect_cnt),
+                    NULL, { rc = 41; goto on_return; });
+    out.len = 0;
+    PJ_TEST_SUCCESS(pj_metrics_write(metrics, NULL, &out_writer, &out),
+                    NULL, { rc = 42; goto on_return; });
+    PJ_TEST_EQ(collect_cnt, 1, NULL, { rc = 43; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(out.buf, "test_collected 42\n"),
+                     NULL, { rc = 44; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(out.buf, "# HELP test_inc_total "
+                                             "Increments\n"),
+                     NULL, { rc = 45; goto on_return; });
+    PJ_TEST_SUCCESS(pj_metrics_remove_collector(metrics, &collect_cb,
+                                                &collect_cnt),
+                    NULL, { rc = 46; goto on_return; });
+    PJ_TEST_EQ(pj_metrics_remove_collector(metrics, &collect_cb,
+                                           &collect_cnt),
+               PJ_ENOTFOUND, NULL, { rc = 47; goto on_return; });
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+/* Poll the ioqueue of the HTTP endpoint */
+static pj_bool_t poll_quit;
+
+static int poll_thread(void *arg)
+{
+    pj_ioqueue_t *ioqueue = (pj_ioqueue_t*)arg;
+
+    while (!poll_quit) {
+        pj_time_val delay = { 0, 10 };
+        pj_ioqueue_poll(ioqueue, &delay);
+    }
+    return 0;
+}
+
+/* Send a request to the endpoint and read the whole response */
+static int http_get(const pj_sockaddr *addr, const char *req, out_buf *resp)
+{
+    pj_sock_t sock;
+    pj_ssize_t len;
+    int rc = 0;
+
+    PJ_TEST_SUCCESS(pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0, &sock),
+                    NULL, return 50);
+    PJ_TEST_SUCCESS(pj_sock_connect(sock, addr, pj_sockaddr_get_len(addr)),
+                    NULL, { rc = 51; goto on_return; });
+
+    len = pj_ansi_strlen(req);
+    PJ_TEST_SUCCESS(pj_sock_send(sock, req, &len, 0), NULL,
+                    { rc = 52; goto on_return; });
+
+    resp->len = 0;
+    for (;;) {
+        len = sizeof(resp->buf) - 1 - resp->len;
+        if (pj_sock_recv(sock, resp->buf + resp->len, &len, 0) != PJ_SUCCESS
+            || len <= 0)
+        {
+            break;
+        }
+        resp->len += (unsigned)len;
+    }
+    resp->buf[resp->len] = '\0';
+
+on_return:
+    pj_sock_close(sock);
+    return rc;
+}
+
+static int http_test(pj_metrics *metrics)
+{
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_metrics_http *srv = NULL;
+    pj_thread_t *thread = NULL;
+    pj_sockaddr addr;
+    pj_str_t localhost = pj_str("127.0.0.1");
+    out_buf resp;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "metricshttp", 1000, 1000, NULL);
+
+    PJ_TEST_SUCCESS(pj_ioqueue_create(pool, 16, &ioqueue), NULL,
+                    { rc = 60; goto on_return; });
+
+    pj_sockaddr_init(pj_AF_INET(), &addr, &localhost, 0);
+    PJ_TEST_SUCCESS(pj_metrics_http_create(mem, ioqueue, metrics, &addr,
+                                           &srv),
+                    NULL, { rc = 61; goto on_return; });
+    PJ_TEST_SUCCESS(pj_metrics_http_get_addr(srv, &addr), NULL,
+                    { rc = 62; goto on_return; });
+    PJ_TEST_TRUE(pj_sockaddr_get_port(&addr) != 0, NULL,
+                 { rc = 63; goto on_return; });
+
+    poll_quit = PJ_FALSE;
+    PJ_TEST_SUCCESS(pj_thread_create(pool, "mpoll", &poll_thread, ioqueue,
+                                     0, 0, &thread),
+                    NULL, { rc = 64; goto on_return; });
+
+    rc = http_get(&addr, "GET /metrics HTTP/1.1\r\nHost: test\r\n\r\n",
+                  &resp);
+    if (rc)
+        goto on_return;
+    PJ_TEST_TRUE(pj_ansi_strncmp(resp.buf, "HTTP/1.0 200 OK\r\n", 17) == 0,
+                 resp.buf, { rc = 65; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(resp.buf, "\r\n\r\n# HELP "), NULL,
+                     { rc = 66; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(resp.buf, "test_gauge 3\n"), NULL,
+                     { rc = 67; goto on_return; });
+
+    rc = http_get(&addr, "GET /other HTTP/1.0\r\n\r\n", &resp);
+    if (rc)
+        goto on_return;
+    PJ_TEST_TRUE(pj_ansi_strncmp(resp.buf, "HTTP/1.0 404 ", 13) == 0,
+                 resp.buf, { rc = 68; goto on_return; });
+
+    rc = http_get(&addr, "POST /metrics HTTP/1.0\r\n\r\n", &resp);
+    if (rc)
+        goto on_return;
+    PJ_TEST_TRUE(pj_ansi_strncmp(resp.buf, "HTTP/1.0 405 ", 13) == 0,
+                 resp.buf, { rc = 69; goto on_return; });
+
+on_return:
+    if (thread) {
+        poll_quit = PJ_TRUE;
+        pj_thread_join(thread);
+        pj_thread_destroy(thread);
+    }
+    if (srv)
+        pj_metrics_http_destroy(srv);
+    if (ioqueue)
+        pj_ioqueue_destroy(ioqueue);
+    pj_pool_release(pool);
+    return rc;
+}
+
+int metrics_test(void)
+{
+    pj_metrics *metrics;
+    int rc;
+
+    PJ_TEST_SUCCESS(pj_metrics_create(mem, &metrics), NULL, return 1);
+
+    rc = registry_test(metrics);
+    if (rc == 0)
+        rc = http_test(metrics);
+
+    pj_metrics_destroy(metrics);
+    return rc;
+}
+
+#else
+int metrics_test_dummy;
+#endif
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE       "pcap_test.c"
+
+#if INCLUDE_PCAP_TEST
+
+#include <pjlib-util/pcap.h>
+#include <pj/file_access.h>
+#include <pj/file_io.h>
+#include <pj/log.h>
+#include <pj/pool.h>
+#include <pj/sock.h>
+#include <pj/string.h>
+
+#define PCAP_FILE       "pcap_test.pcap"
+
+/* Packet variants written to the test capture */
+enum pkt_kind
+{
+    PKT_UDP,            /* Plain Ethernet/IPv4/UDP                  */
+    PKT_VLAN,           /* VLAN tagged                              */
+    PKT_IP_OPT,         /* IPv4 header with options                 */
+    PKT_FRAG,           /* IP fragment, must be skipped             */
+    PKT_ARP,            /* Not IPv4, must be skipped                */
+    PKT_TCP             /* Not UDP, must be skipped                 */
+};
+
+static const struct test_pkt
+{
+    enum pkt_kind   kind;
+    pj_uint16_t     src_port;
+    pj_uint16_t     dst_port;
+    pj_uint8_t      b0, b1;         /* First two payload bytes      */
+    pj_uint32_t     ssrc;
+    unsigned        len;            /* Payload length               */
+    int             flow;           /* Expected flow, -1 if skipped */
+} test_pkts[] =
+{
+    { PKT_UDP,    4000, 5000, 0x80, 0,   0x11111111, 172, 0 },
+    { PKT_UDP,    4000, 5000, 0x80, 0,   0x22222222, 172, 1 },
+    { PKT_VLAN,   4001, 5001, 0x81, 200, 0x11111111, 52,  2 },
+    { PKT_UDP,    4000, 5000, 0x80, 0,   0x11111111, 172, 0 },
+    { PKT_IP_OPT, 5353, 53,   0x80, 0,   0x33333333, 40,  3 },
+    { PKT_FRAG,   4000, 5000, 0x80, 0,   0x11111111, 172, -1 },
+    { PKT_ARP,    4000, 5000, 0x80, 0,   0x11111111, 28,  -1 },
+    { PKT_TCP,    4000, 5000, 0x80, 0,   0x11111111, 60,  -1 },
+    { PKT_UDP,    4000, 5000, 0x80, 0,   0x22222222, 172, 1 },
+    { PKT_UDP,    4000, 5000, 0x80, 0,   0x11111111, 172, 0 },
+};
+
+#define FLOW_CNT        4
+
+static void put16(pj_uint8_t *p, unsigned v)
+{
+    p[0] = (pj_uint8_t)(v >> 8);
+    p[1] = (pj_uint8_t)v;
+}
+
+static void put32(pj_uint8_t *p, pj_uint32_t v)
+{
+    put16(p, v >> 16);
+    put16(p + 2, v & 0xFFFF);
+}
+
+static pj_uint8_t payload_byte(unsigned pkt_idx, unsigned i)
+{
+    return (pj_uint8_t)(pkt_idx * 7 + i);
+}
+
+/* Build the link layer frame of a test packet, return the length */
+static unsigned build_frame(unsigned idx, pj_uint8_t *buf)
+{
+    const struct test_pkt *t = &test_pkts[idx];
+    pj_uint8_t *p = buf, *ip;
+    unsigned i, ihl;
+
+    /* Ethernet */
+    pj_bzero(p, 12);
+    p += 12;
+    if (t->kind == PKT_VLAN) {
+        put16(p, 0x8100);
+        put16(p + 2, 100);
+        p += 4;
+    }
+    put16(p, t->kind == PKT_ARP ? 0x0806 : 0x0800);
+    p += 2;
+
+    /* IPv4 */
+    ip = p;
+    ihl = (t->kind == PKT_IP_OPT) ? 24 : 20;
+    pj_bzero(ip, ihl);
+    ip[0] = (pj_uint8_t)(0x40 | (ihl / 4));
+    put16(ip + 2, ihl + 8 + t->len);
+    if (t->kind == PKT_FRAG)
+        put16(ip + 6, 0x2000);
+    ip[8] = 64;
+    ip[9] = (t->kind == PKT_TCP) ? 6 : 17;
+    put32(ip + 12, 0x0a000001);
+    put32(ip + 16, 0x0a000002);
+    p += ihl;
+
+    /* UDP */
+    put16(p, t->src_port);
+    put16(p + 2, t->dst_port);
+    put16(p + 4, 8 + t->len);
+    put16(p + 6, 0);
+    p += 8;
+
+    /* Payload */
+    for (i = 0; i < t->len; ++i)
+        p[i] = payload_byte(idx, i);
+    p[0] = t->b0;
+    p[1] = t->b1;
+    put32(p + 8, t->ssrc);
+    p += t->len;
+
+    /* Ethernet trailer */
+    pj_bzero(p, 4);
+    p += 4;
+
+    return (unsigned)(p - buf);
+}
+
+static int write_capture(void)
+{
+    pj_pool_t *pool;
+    pj_oshandle_t fd;
+    pj_uint8_t buf[512];
+    pj_ssize_t sz;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "pcapw", 1000, 1000, NULL);
+    PJ_TEST_SUCCESS(pj_file_open(pool, PCAP_FILE, PJ_O_WRONLY, &fd), NULL,
+                    { pj_pool_release(pool); return 10; });
+
+    /* File header, in native byte order */
+    {
+        pj_uint32_t hdr[6];
+
+        hdr[0] = 0xa1b2c3d4;
+        hdr[1] = 2 | (4 << 16);
+        hdr[2] = 0;
+        hdr[3] = 0;
+        hdr[4] = 65535;
+        hdr[5] = PJ_PCAP_LINK_TYPE_ETH;
+        sz = sizeof(hdr);
+        PJ_TEST_SUCCESS(pj_file_write(fd, hdr, &sz), NULL,
+                        { rc = 11; goto on_return; });
+    }
+
+    for (i = 0; i < PJ_ARRAY_SIZE(test_pkts); ++i) {
+        pj_uint32_t rec[4];
+        unsigned len = build_frame(i, buf);
+
+        rec[0] = 1000 + i / 3;
+        rec[1] = (i % 3) * 20000;
+        rec[2] = rec[3] = len;
+        sz = sizeof(rec);
+        PJ_TEST_SUCCESS(pj_file_write(fd, rec, &sz), NULL,
+                        { rc = 12; goto on_return; });
+        sz = len;
+        PJ_TEST_SUCCESS(pj_file_write(fd, buf, &sz), NULL,
+                        { rc = 13; goto on_return; });
+    }
+
+on_return:
+    pj_file_close(fd);
+    pj_pool_release(pool);
+    return rc;
+}
+
+/* Check a packet against the test packet */
+static int check_payload(unsigned idx, const pj_uint8_t *p, pj_size_t len)
+{
+    const struct test_pkt *t = &test_pkts[idx];
+    unsigned i;
+
+    PJ_TEST_EQ(len, t->len, NULL, return 20);
+    PJ_TEST_EQ(p[0], t->b0, NULL, return 21);
+    for (i = 12; i < t->len; ++i) {
+        PJ_TEST_EQ(p[i], payload_byte(idx, i), NULL, return 22);
+    }
+    return 0;
+}
+
+/* Read the whole capture with pj_pcap_read_udp_pkt() */
+static int read_flows(pj_pcap_file *file)
+{
+    pj_pcap_udp_pkt pkt;
+    unsigned i;
+    int rc;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(test_pkts); ++i) {
+        const struct test_pkt *t = &test_pkts[i];
+
+        if (t->flow < 0)
+            continue;
+
+        PJ_TEST_SUCCESS(pj_pcap_read_udp_pkt(file, &pkt), NULL, return 30);
+        PJ_TEST_EQ(pkt.flow, (unsigned)t->flow, NULL, return 31);
+        PJ_TEST_EQ(pj_ntohs(pkt.udp.dst_port), t->dst_port, NULL, return 32);
+        PJ_TEST_EQ(pkt.ip_src, pj_htonl(0x0a000001), NULL, return 33);
+        PJ_TEST_EQ(pkt.ts_sec, 1000 + i / 3, NULL, return 34);
+        PJ_TEST_EQ(pkt.ts_usec, (i % 3) * 20000, NULL, return 35);
+        rc = check_payload(i, pkt.payload, pkt.payload_len);
+        if (rc)
+            return rc;
+    }
+    PJ_TEST_EQ(pj_pcap_read_udp_pkt(file, &pkt), PJ_EEOF, NULL, return 36);
+
+    PJ_TEST_EQ(pj_pcap_get_flow_count(file), FLOW_CNT, NULL, return 37);
+    PJ_TEST_EQ(pj_pcap_get_flow(file, 0)->type, PJ_PCAP_FLOW_RTP, NULL,
+               return 38);
+    PJ_TEST_EQ(pj_pcap_get_flow(file, 0)->pkt_cnt, 3, NULL, return 39);
+    PJ_TEST_EQ(pj_pcap_get_flow(file, 1)->ssrc, 0x22222222, NULL, return 40);
+    PJ_TEST_EQ(pj_pcap_get_flow(file, 1)->pkt_cnt, 2, NULL, return 41);
+    PJ_TEST_EQ(pj_pcap_get_flow(file, 2)->type, PJ_PCAP_FLOW_RTCP, NULL,
+               return 42);
+    PJ_TEST_EQ(pj_pcap_get_flow(file, 3)->type, PJ_PCAP_FLOW_UDP, NULL,
+               return 43);
+    PJ_TEST_EQ(pj_pcap_get_flow(file, FLOW_CNT), NULL, NULL, return 44);
+
+    return 0;
+}
+
+static int pcap_test_map(pj_bool_t map)
+{
+    pj_pool_t *pool;
+    pj_pcap_file *file;
+    int rc;
+
+    pool = pj_pool_create(mem, "pcap", 1000, 1000, NULL);
+    if (map) {
+        PJ_TEST_SUCCESS(pj_pcap_map(pool, PCAP_FILE, &file), NULL,
+                        { pj_pool_release(pool); return 50; });
+    } else {
+        PJ_TEST_SUCCESS(pj_pcap_open(pool, PCAP_FILE, &file), NULL,
+                        { pj_pool_release(pool); return 51; });
+    }
+
+    rc = read_flows(file);
+    if (rc == 0) {
+        /* Flow indexes must be kept across rewind */
+        PJ_TEST_SUCCESS(pj_pcap_rewind(file), NULL, { rc = 52; goto on_return; });
+        rc = read_flows(file);
+    }
+
+on_return:
+    pj_pcap_close(file);
+    pj_pool_release(pool);
+    return rc;
+}
+
+/* The classic reader with filter */
+static int pcap_test_read_udp(pj_bool_t map)
+{
+    pj_pool_t *pool;
+    pj_pcap_file *file;
+    pj_pcap_filter filter;
+    pj_pcap_udp_hdr udp;
+    pj_uint8_t buf[200];
+    pj_size_t len;
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "pcap", 1000, 1000, NULL);
+    if (map) {
+        PJ_TEST_SUCCESS(pj_pcap_map(pool, PCAP_FILE, &file), NULL,
+                        { pj_pool_release(pool); return 60; });
+    } else {
+        PJ_TEST_SUCCESS(pj_pcap_open(pool, PCAP_FILE, &file), NULL,
+                        { pj_pool_release(pool); return 61; });
+    }
+
+    pj_pcap_filter_default(&filter);
+    filter.dst_port = pj_htons(5000);
+    pj_pcap_set_filter(file, &filter);
+
+    for (i = 0; i < PJ_ARRAY_SIZE(test_pkts); ++i) {
+        if (test_pkts[i].flow < 0 || test_pkts[i].dst_port != 5000)
+            continue;
+
+        len = sizeof(buf);
+        PJ_TEST_SUCCESS(pj_pcap_read_udp(file, &udp, buf, &len), NULL,
+                        { rc = 62; goto on_return; });
+        PJ_TEST_EQ(pj_ntohs(udp.src_port), test_pkts[i].src_port, NULL,
+                   { rc = 63; goto on_return; });
+        rc = check_payload(i, buf, len);
+        if (rc)
+            goto on_return;
+    }
+
+    len = sizeof(buf);
+    PJ_TEST_EQ(pj_pcap_read_udp(file, &udp, buf, &len), PJ_EEOF, NULL,
+               { rc = 64; goto on_return; });
+
+    /* Buffer too small */
+    pj_pcap_rewind(file);
+    len = 100;
+    PJ_TEST_EQ(pj_pcap_read_udp(file, &udp, buf, &len), PJ_ETOOSMALL, NULL,
+               { rc = 65; goto on_return; });
+
+on_return:
+    pj_pcap_close(file);
+    pj_pool_release(pool);
+    return rc;
+}
+
+int pcap_test(void)
+{
+    int rc;
+
+    rc = write_capture();
+    if (rc)
+        goto on_return;
+
+    PJ_LOG(3,(THIS_FILE, "  mapped file"));
+    rc = pcap_test_map(PJ_TRUE);
+    if (rc)
+        goto on_return;
+
+    PJ_LOG(3,(THIS_FILE, "  file reader"));
+    rc = pcap_test_map(PJ_FALSE);
+    if (rc)
+        goto on_return;
+
+    PJ_LOG(3,(THIS_FILE, "  pj_pcap_read_udp()"));
+    rc = pcap_test_read_udp(PJ_TRUE);
+    if (rc)
+        goto on_return;
+
+    rc = pcap_test_read_udp(PJ_FALSE);
+
+on_return:
+    pj_file_delete(PCAP_FILE);
+    return rc;
+}
+
+#else
+int pcap_test_dummy;
+#endif
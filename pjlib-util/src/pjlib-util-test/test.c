@@ -86,6 +86,18 @@ static int test_inner(int argc, char *argv[])
     UT_ADD_TEST(&test_app.ut_app, http_client_test, 0);
 #endif
 
+#if INCLUDE_PCAP_TEST
+    UT_ADD_TEST(&test_app.ut_app, pcap_test, 0);
+#endif
+
+#if INCLUDE_METRICS_TEST
+    UT_ADD_TEST(&test_app.ut_app, metrics_test, 0);
+#endif
+
+#if INCLUDE_DNS_SERVER_TEST
+    UT_ADD_TEST(&test_app.ut_app, dns_server_test, 0);
+#endif
+
     if (ut_run_tests(&test_app.ut_app, "pjlib-util tests", argc, argv)) {
         ut_app_destroy(&test_app.ut_app);
         return 1;
@@ -31,6 +31,9 @@
 #define INCLUDE_STUN_TEST           1
 #define INCLUDE_RESOLVER_TEST       1
 #define INCLUDE_HTTP_CLIENT_TEST    1
+#define INCLUDE_PCAP_TEST           1
+#define INCLUDE_METRICS_TEST        1
+#define INCLUDE_DNS_SERVER_TEST     1
 
 extern int xml_test(void);
 extern int json_test(void);
@@ -40,6 +43,9 @@ extern int stun_test();
 extern int test_main(int argc, char *argv[]);
 extern int resolver_test(void);
 extern int http_client_test();
+extern int pcap_test(void);
+extern int metrics_test(void);
+extern int dns_server_test(void);
 
 extern void app_perror(const char *title, pj_status_t rc);
 extern pj_pool_factory *mem;
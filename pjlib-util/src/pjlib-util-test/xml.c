@@ -22,6 +22,7 @@
 #if INCLUDE_XML_TEST
 
 #include <pjlib-util/xml.h>
+#include <pjlib-util/errno.h>
 #include <pjlib.h>
 
 #define THIS_FILE   "xml_test"
@@ -123,6 +124,108 @@ static int xml_parse_print_test(const char *doc)
     return 0;
 }
 
+/* Count elements in the tree */
+static unsigned xml_count_nodes(const pj_xml_node *node)
+{
+    const pj_xml_node *child = node->node_head.next;
+    unsigned cnt = 1;
+
+    while (child != (pj_xml_node*)&node->node_head) {
+        cnt += xml_count_nodes(child);
+        child = child->next;
+    }
+    return cnt;
+}
+
+/* Verify that the pull reader sees the same document as the parser */
+static int xml_reader_test(const char *doc)
+{
+    static const pj_str_t RPID_NS = {"urn:ietf:params:xml:ns:pidf:rpid", 32};
+    static const pj_str_t PIDF_NS = {"urn:ietf:params:xml:ns:pidf", 27};
+    static const pj_str_t PERSON = {"person", 6};
+    static const pj_str_t TUPLE = {"tuple", 5};
+    static const pj_str_t BASIC = {"basic", 5};
+    static const pj_str_t ID = {"id", 2};
+    pj_str_t msg;
+    pj_pool_t *pool;
+    pj_xml_node *root;
+    pj_xml_reader rd;
+    pj_xml_event ev;
+    pj_status_t status;
+    unsigned start_cnt = 0, end_cnt = 0, tuple_cnt = 0, open_cnt = 0;
+    pj_bool_t in_basic = PJ_FALSE, person_found = PJ_FALSE;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "xml", 4096, 1024, NULL);
+    pj_strdup2_with_null(pool, &msg, doc);
+    root = pj_xml_parse(pool, msg.ptr, msg.slen);
+    PJ_TEST_NOT_NULL(root, NULL, { rc = -30; goto on_return; });
+
+    pj_strdup2_with_null(pool, &msg, doc);
+    PJ_TEST_SUCCESS(pj_xml_reader_init(&rd, msg.ptr, msg.slen,
+                                       PJ_XML_READER_NS),
+                    NULL, { rc = -31; goto on_return; });
+
+    while ((status=pj_xml_reader_next(&rd, &ev)) == PJ_SUCCESS) {
+        switch (ev.type) {
+        case PJ_XML_EVENT_START:
+            ++start_cnt;
+            /* Must be zero-copy */
+            PJ_TEST_TRUE(ev.name.ptr > msg.ptr &&
+                         ev.name.ptr < msg.ptr + msg.slen, NULL,
+                         { rc = -32; goto on_return; });
+            if (pj_strcmp(&ev.local_name, &TUPLE)==0) {
+                ++tuple_cnt;
+                PJ_TEST_EQ(pj_strcmp(&ev.ns_uri, &PIDF_NS), 0, NULL,
+                           { rc = -33; goto on_return; });
+                PJ_TEST_NOT_NULL(pj_xml_event_find_attr(&ev, &ID), NULL,
+                                 { rc = -34; goto on_return; });
+            } else if (pj_strcmp(&ev.local_name, &PERSON)==0) {
+                person_found = PJ_TRUE;
+                PJ_TEST_EQ(pj_strcmp(&ev.ns_uri, &RPID_NS), 0, NULL,
+                           { rc = -35; goto on_return; });
+                PJ_TEST_SUCCESS(pj_xml_reader_skip(&rd), NULL,
+                                { rc = -36; goto on_return; });
+                ++end_cnt;
+                /* <person> has 4 descendants */
+                start_cnt += 4;
+                end_cnt += 4;
+            }
+            in_basic = (pj_strcmp(&ev.local_name, &BASIC)==0);
+            break;
+        case PJ_XML_EVENT_END:
+            ++end_cnt;
+            in_basic = PJ_FALSE;
+            break;
+        case PJ_XML_EVENT_TEXT:
+            if (in_basic && pj_strcmp2(&ev.text, "open")==0)
+                ++open_cnt;
+            break;
+        }
+    }
+    pj_xml_reader_fini(&rd);
+
+    PJ_TEST_EQ(status, PJ_EEOF, NULL, { rc = -37; goto on_return; });
+    PJ_TEST_EQ(start_cnt, xml_count_nodes(root), NULL,
+               { rc = -38; goto on_return; });
+    PJ_TEST_EQ(start_cnt, end_cnt, NULL, { rc = -39; goto on_return; });
+    PJ_TEST_EQ(tuple_cnt, 3, NULL, { rc = -40; goto on_return; });
+    PJ_TEST_EQ(open_cnt, 2, NULL, { rc = -41; goto on_return; });
+    PJ_TEST_TRUE(person_found, NULL, { rc = -42; goto on_return; });
+
+    /* Mismatched end tag */
+    pj_strdup2_with_null(pool, &msg, "<a><b>text</c></a>");
+    pj_xml_reader_init(&rd, msg.ptr, msg.slen, 0);
+    while ((status=pj_xml_reader_next(&rd, &ev)) == PJ_SUCCESS)
+        ;
+    pj_xml_reader_fini(&rd);
+    PJ_TEST_EQ(status, PJLIB_UTIL_EINXML, NULL, { rc = -43; goto on_return; });
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
 int xml_test()
 {
     unsigned i;
@@ -130,6 +233,8 @@ int xml_test()
         int status;
         if ((status=xml_parse_print_test(xml_doc[i])) != 0)
             return status;
+        if ((status=xml_reader_test(xml_doc[i])) != 0)
+            return status;
     }
     return 0;
 }
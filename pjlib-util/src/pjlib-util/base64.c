@@ -44,26 +44,44 @@ static const char base64url_char[] = {
     '8', '9', '-', '_' 
 };
 
-static int base256_char(char c, pj_bool_t url)
-{
-    if (c >= 'A' && c <= 'Z')
-        return (c - 'A');
-    else if (c >= 'a' && c <= 'z')
-        return (c - 'a' + 26);
-    else if (c >= '0' && c <= '9')
-        return (c - '0' + 52);
-    else if ((!url && c == '+') || (url && c == '-'))
-        return (62);
-    else if ((!url && c == '/') || (url && c == '_'))
-        return (63);
-    else {
-        /* It *may* happen on bad input, so this is not a good idea.
-         * pj_assert(!"Should not happen as '=' should have been filtered");
-         */
-        return INV;
-    }
-}
+/* Decoding tables, INV for characters outside the alphabet */
+static const signed char base64_dec[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
 
+static const signed char base64url_dec[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, 63,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
 
 static void base256to64(pj_uint8_t c1, pj_uint8_t c2, pj_uint8_t c3, 
                         int padding, char *output, pj_bool_t url)
@@ -93,6 +111,7 @@ static pj_status_t b64_encode(const pj_uint8_t *input, int in_len,
                               pj_bool_t url)
 {
     const pj_uint8_t *pi = input;
+    const char *b64 = url ? base64url_char : base64_char;
     pj_uint8_t c1, c2, c3;
     int i = 0;
     char *po = output;
@@ -101,29 +120,23 @@ static pj_status_t b64_encode(const pj_uint8_t *input, int in_len,
     PJ_ASSERT_RETURN(*out_len >= PJ_BASE256_TO_BASE64_LEN(in_len), 
                      PJ_ETOOSMALL);
 
-    while (i < in_len) {
+    /* Full three byte groups */
+    for ( ; in_len - i >= 3; i += 3) {
         c1 = *pi++;
-        ++i;
-
-        if (i == in_len) {
-            base256to64(c1, 0, 0, 2, po, url);
-            po += 4;
-            break;
-        } else {
-            c2 = *pi++;
-            ++i;
-
-            if (i == in_len) {
-                base256to64(c1, c2, 0, 1, po, url);
-                po += 4;
-                break;
-            } else {
-                c3 = *pi++;
-                ++i;
-                base256to64(c1, c2, c3, 0, po, url);
-            }
-        }
+        c2 = *pi++;
+        c3 = *pi++;
+        *po++ = b64[c1>>2];
+        *po++ = b64[((c1 & 0x3)<< 4) | ((c2 & 0xF0) >> 4)];
+        *po++ = b64[((c2 & 0xF) << 2) | ((c3 & 0xC0) >>6)];
+        *po++ = b64[c3 & 0x3F];
+    }
 
+    /* The last, padded group */
+    if (in_len - i == 1) {
+        base256to64(pi[0], 0, 0, 2, po, url);
+        po += 4;
+    } else if (in_len - i == 2) {
+        base256to64(pi[0], pi[1], 0, 1, po, url);
         po += 4;
     }
 
@@ -135,6 +148,7 @@ static pj_status_t b64_decode(const pj_str_t *input,
                               pj_uint8_t *out, int *out_len,
                               pj_bool_t url)
 {
+    const signed char *dec = url ? base64url_dec : base64_dec;
     const char *buf;
     int len;
     int i, j, k;
@@ -151,10 +165,26 @@ static pj_status_t b64_decode(const pj_str_t *input,
                      PJ_ETOOSMALL);
 
     for (i=0, j=0; i<len; ) {
+        /* Fast path: the next four characters are all valid */
+        if (len - i >= 4) {
+            c[0] = dec[(pj_uint8_t)buf[i]];
+            c[1] = dec[(pj_uint8_t)buf[i+1]];
+            c[2] = dec[(pj_uint8_t)buf[i+2]];
+            c[3] = dec[(pj_uint8_t)buf[i+3]];
+            if ((c[0] | c[1] | c[2] | c[3]) >= 0) {
+                out[j++] = (pj_uint8_t)((c[0]<<2) | ((c[1] & 0x30)>>4));
+                out[j++] = (pj_uint8_t)(((c[1] & 0x0F)<<4) |
+                                        ((c[2] & 0x3C)>>2));
+                out[j++] = (pj_uint8_t)(((c[2] & 0x03)<<6) | (c[3] & 0x3F));
+                i += 4;
+                continue;
+            }
+        }
+
         /* Fill up c, silently ignoring invalid characters */
         for (k=0; k<4 && i<len; ++k) {
             do {
-                c[k] = base256_char(buf[i++], url);
+                c[k] = dec[(pj_uint8_t)buf[i++]];
             } while (c[k]==INV && i<len);
         }
 
@@ -25,6 +25,7 @@
 #include <pj/pool.h>
 #include <pj/string.h>
 #include <pjlib-util/errno.h>
+#include <pjlib-util/metrics.h>
 #include <pjlib-util/scanner.h>
 #include <pjlib-util/xml.h>
 
@@ -32,6 +33,7 @@
 
 #define CLI_CMD_CHANGE_LOG  30000
 #define CLI_CMD_EXIT        30001
+#define CLI_CMD_METRICS     30002
 
 #define MAX_CMD_HASH_NAME_LENGTH PJ_CLI_MAX_CMDBUF
 #define MAX_CMD_ID_LENGTH 16
@@ -331,6 +333,14 @@ PJ_DEF(void) pj_cli_sess_write_msg(pj_cli_sess *sess,
         (*fe->op->on_write_log)(fe, 0, buffer, len);
 }
 
+/* Metrics writer */
+static pj_status_t metrics_writer(const char *s, unsigned size,
+                                  void *user_data)
+{
+    pj_cli_sess_write_msg((pj_cli_sess*)user_data, s, size);
+    return PJ_SUCCESS;
+}
+
 /* Command handler */
 static pj_status_t cmd_handler(pj_cli_cmd_val *cval)
 {
@@ -349,6 +359,15 @@ static pj_status_t cmd_handler(pj_cli_cmd_val *cval)
     case CLI_CMD_EXIT:
         pj_cli_sess_end_session(cval->sess);
         return PJ_CLI_EEXIT;
+    case CLI_CMD_METRICS:
+        if (!pj_metrics_get_default()) {
+            static const char msg[] = "Metrics are not enabled\n";
+            pj_cli_sess_write_msg(cval->sess, msg, sizeof(msg)-1);
+            return PJ_SUCCESS;
+        }
+        return pj_metrics_write(pj_metrics_get_default(),
+                                cval->argc > 1 ? &cval->argv[1] : NULL,
+                                &metrics_writer, cval->sess);
     default:
         return PJ_SUCCESS;
     }
@@ -368,6 +387,10 @@ PJ_DEF(pj_status_t) pj_cli_create(pj_cli_cfg *cfg,
      "</CMD>",     
      "<CMD name='exit' id='30001' sc='' desc='Exit session'>"     
      "</CMD>",
+     "<CMD name='metrics' id='30002' sc='' desc='Show runtime metrics'>"
+     "    <ARG name='prefix' type='string' optional='1' "
+     "         desc='Metric name prefix'/>"
+     "</CMD>",
     };
 
     PJ_ASSERT_RETURN(cfg && cfg->pf && p_cli, PJ_EINVAL);
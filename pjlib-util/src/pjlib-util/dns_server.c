@@ -1,4 +1,4 @@
-/* 
+/*
  * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
  * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
  *
@@ -14,21 +14,29 @@
  *
  * You should have received a copy of the GNU General Public License
  * along with this program; if not, write to the Free Software
- * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 #include <pjlib-util/dns_server.h>
 #include <pjlib-util/errno.h>
 #include <pj/activesock.h>
 #include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/file_access.h>
+#include <pj/file_io.h>
+#include <pj/hash.h>
 #include <pj/list.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/pool.h>
+#include <pj/rand.h>
 #include <pj/string.h>
 
 #define THIS_FILE   "dns_server.c"
 #define MAX_ANS     16
 #define MAX_PKT     1500
 #define MAX_LABEL   32
+#define MAX_TOKEN   16
+#define MAX_LINE    1024
 
 struct label_tab
 {
@@ -46,6 +54,27 @@ struct rr
     pj_dns_parsed_rr    rec;
 };
 
+/* All records of a name */
+typedef struct name_node
+{
+    pj_str_t            name;
+    struct rr           rr_list;
+    pj_hash_entry_buf   hbuf;
+} name_node;
+
+/* Answer to be sent */
+typedef struct answer
+{
+    PJ_DECL_LIST_MEMBER(struct answer);
+    pj_dns_server       *srv;
+    pj_timer_entry       timer;
+    pj_ioqueue_op_key_t  send_key;
+    pj_sockaddr          addr;
+    int                  addr_len;
+    pj_ssize_t           len;
+    pj_uint8_t           pkt[MAX_PKT];
+} answer;
+
 
 struct pj_dns_server
 {
@@ -53,8 +82,14 @@ struct pj_dns_server
     pj_pool_factory     *pf;
     pj_activesock_t     *asock;
     pj_sockaddr          bound_addr;
-    pj_ioqueue_op_key_t  send_key;
-    struct rr            rr_list;
+    pj_lock_t           *lock;
+    pj_hash_table_t     *ht;
+    struct rr            free_rr;
+    answer               free_ans;
+    answer               delayed_list;
+    pj_timer_heap_t     *timer_heap;
+    pj_dns_server_impair impair;
+    pj_dns_server_stat   stat;
 };
 
 
@@ -64,6 +99,9 @@ static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
                                   const pj_sockaddr_t *src_addr,
                                   int addr_len,
                                   pj_status_t status);
+static pj_bool_t on_data_sent(pj_activesock_t *asock,
+                              pj_ioqueue_op_key_t *send_key,
+                              pj_ssize_t sent);
 
 
 PJ_DEF(pj_status_t) pj_dns_server_create( pj_pool_factory *pf,
@@ -82,12 +120,20 @@ PJ_DEF(pj_status_t) pj_dns_server_create( pj_pool_factory *pf,
 
     PJ_ASSERT_RETURN(pf && ioqueue && p_srv && flags==0, PJ_EINVAL);
     PJ_ASSERT_RETURN(af==pj_AF_INET() || af==pj_AF_INET6(), PJ_EINVAL);
-    
+
     pool = pj_pool_create(pf, "dnsserver", 256, 256, NULL);
     srv = (pj_dns_server*) PJ_POOL_ZALLOC_T(pool, pj_dns_server);
     srv->pool = pool;
     srv->pf = pf;
-    pj_list_init(&srv->rr_list);
+    pj_list_init(&srv->free_rr);
+    pj_list_init(&srv->free_ans);
+    pj_list_init(&srv->delayed_list);
+
+    srv->ht = pj_hash_create(pool, PJ_DNS_SERVER_HASH_SIZE);
+
+    status = pj_lock_create_simple_mutex(pool, "dnsserver", &srv->lock);
+    if (status != PJ_SUCCESS)
+        goto on_error;
 
     pj_bzero(&sock_addr, sizeof(sock_addr));
     sock_addr.addr.sa_family = (pj_uint16_t)af;
@@ -95,7 +141,9 @@ PJ_DEF(pj_status_t) pj_dns_server_create( pj_pool_factory *pf,
 
     pj_bzero(&sock_cb, sizeof(sock_cb));
     sock_cb.on_data_recvfrom = &on_data_recvfrom;
+    sock_cb.on_data_sent = &on_data_sent;
     pj_activesock_cfg_default(&sock_cfg);
+    sock_cfg.async_cnt = PJ_DNS_SERVER_ASYNC_CNT;
 
     status = pj_activesock_create_udp(pool, &sock_addr, &sock_cfg, ioqueue,
                                       &sock_cb, srv, &srv->asock,
@@ -103,8 +151,6 @@ PJ_DEF(pj_status_t) pj_dns_server_create( pj_pool_factory *pf,
     if (status != PJ_SUCCESS)
         goto on_error;
 
-    pj_ioqueue_op_key_init(&srv->send_key, sizeof(srv->send_key));
-
     status = pj_activesock_start_recvfrom(srv->asock, pool, MAX_PKT, 0);
     if (status != PJ_SUCCESS)
         goto on_error;
@@ -136,30 +182,111 @@ PJ_DEF(pj_status_t) pj_dns_server_destroy(pj_dns_server *srv)
         srv->asock = NULL;
     }
 
+    if (srv->lock) {
+        answer *a;
+
+        /* Cancel delayed answers */
+        pj_lock_acquire(srv->lock);
+        for (a = srv->delayed_list.next; a != &srv->delayed_list;
+             a = a->next)
+        {
+            pj_timer_heap_cancel_if_active(srv->timer_heap, &a->timer, 0);
+        }
+        pj_list_init(&srv->delayed_list);
+        pj_lock_release(srv->lock);
+
+        pj_lock_destroy(srv->lock);
+        srv->lock = NULL;
+    }
+
     pj_pool_safe_release(&srv->pool);
 
     return PJ_SUCCESS;
 }
 
 
-static struct rr* find_rr( pj_dns_server *srv,
-                           unsigned dns_class,
-                           unsigned type        /* pj_dns_type */,
-                           const pj_str_t *name)
+static name_node* find_node(pj_dns_server *srv, const pj_str_t *name)
+{
+    return (name_node*) pj_hash_get_lower(srv->ht, name->ptr,
+                                          (unsigned)name->slen, NULL);
+}
+
+
+/* Check if two records of the same name have the same data */
+static pj_bool_t rr_equal(const pj_dns_parsed_rr *r1,
+                          const pj_dns_parsed_rr *r2)
 {
+    if (r1->dnsclass != r2->dnsclass || r1->type != r2->type)
+        return PJ_FALSE;
+
+    switch (r1->type) {
+    case PJ_DNS_TYPE_A:
+        return pj_memcmp(&r1->rdata.a.ip_addr, &r2->rdata.a.ip_addr,
+                         sizeof(r1->rdata.a.ip_addr)) == 0;
+    case PJ_DNS_TYPE_AAAA:
+        return pj_memcmp(&r1->rdata.aaaa.ip_addr, &r2->rdata.aaaa.ip_addr,
+                         sizeof(r1->rdata.aaaa.ip_addr)) == 0;
+    case PJ_DNS_TYPE_CNAME:
+    case PJ_DNS_TYPE_NS:
+    case PJ_DNS_TYPE_PTR:
+        return pj_stricmp(&r1->rdata.cname.name, &r2->rdata.cname.name)==0;
+    case PJ_DNS_TYPE_SRV:
+        return r1->rdata.srv.prio == r2->rdata.srv.prio &&
+               r1->rdata.srv.weight == r2->rdata.srv.weight &&
+               r1->rdata.srv.port == r2->rdata.srv.port &&
+               pj_stricmp(&r1->rdata.srv.target, &r2->rdata.srv.target)==0;
+    default:
+        return PJ_TRUE;
+    }
+}
+
+
+/* Add a record, the server must be locked */
+static pj_status_t add_rr(pj_dns_server *srv, const pj_dns_parsed_rr *rec)
+{
+    name_node *node;
     struct rr *r;
 
-    r = srv->rr_list.next;
-    while (r != &srv->rr_list) {
-        if (r->rec.dnsclass == dns_class && r->rec.type == type && 
-            pj_stricmp(&r->rec.name, name)==0)
-        {
-            return r;
+    node = find_node(srv, &rec->name);
+    if (node) {
+        for (r = node->rr_list.next; r != &node->rr_list; r = r->next) {
+            if (rr_equal(&r->rec, rec))
+                return PJ_EEXISTS;
         }
-        r = r->next;
+    } else {
+        node = PJ_POOL_ZALLOC_T(srv->pool, name_node);
+        pj_strdup(srv->pool, &node->name, &rec->name);
+        pj_list_init(&node->rr_list);
+        pj_hash_set_np_lower(srv->ht, node->name.ptr,
+                             (unsigned)node->name.slen, 0, node->hbuf, node);
     }
 
-    return NULL;
+    if (!pj_list_empty(&srv->free_rr)) {
+        r = srv->free_rr.next;
+        pj_list_erase(r);
+    } else {
+        r = PJ_POOL_ZALLOC_T(srv->pool, struct rr);
+    }
+
+    pj_memcpy(&r->rec, rec, sizeof(pj_dns_parsed_rr));
+    r->rec.name = node->name;
+
+    switch (rec->type) {
+    case PJ_DNS_TYPE_CNAME:
+    case PJ_DNS_TYPE_NS:
+    case PJ_DNS_TYPE_PTR:
+        pj_strdup(srv->pool, &r->rec.rdata.cname.name,
+                  &rec->rdata.cname.name);
+        break;
+    case PJ_DNS_TYPE_SRV:
+        pj_strdup(srv->pool, &r->rec.rdata.srv.target,
+                  &rec->rdata.srv.target);
+        break;
+    }
+
+    pj_list_push_back(&node->rr_list, r);
+
+    return PJ_SUCCESS;
 }
 
 
@@ -167,24 +294,18 @@ PJ_DEF(pj_status_t) pj_dns_server_add_rec( pj_dns_server *srv,
                                            unsigned count,
                                            const pj_dns_parsed_rr rr_param[])
 {
+    pj_status_t status = PJ_SUCCESS;
     unsigned i;
 
     PJ_ASSERT_RETURN(srv && count && rr_param, PJ_EINVAL);
 
-    for (i=0; i<count; ++i) {
-        struct rr *rr;
-
-        PJ_ASSERT_RETURN(find_rr(srv, rr_param[i].dnsclass, rr_param[i].type,
-                                 &rr_param[i].name) == NULL,
-                         PJ_EEXISTS);
-
-        rr = (struct rr*) PJ_POOL_ZALLOC_T(srv->pool, struct rr);
-        pj_memcpy(&rr->rec, &rr_param[i], sizeof(pj_dns_parsed_rr));
-
-        pj_list_push_back(&srv->rr_list, rr);
+    pj_lock_acquire(srv->lock);
+    for (i=0; i<count && status==PJ_SUCCESS; ++i) {
+        status = add_rr(srv, &rr_param[i]);
     }
+    pj_lock_release(srv->lock);
 
-    return PJ_SUCCESS;
+    return status;
 }
 
 
@@ -193,15 +314,399 @@ PJ_DEF(pj_status_t) pj_dns_server_del_rec( pj_dns_server *srv,
                                            pj_dns_type type,
                                            const pj_str_t *name)
 {
-    struct rr *rr;
+    name_node *node;
+    struct rr *r;
+    pj_status_t status = PJ_ENOTFOUND;
 
     PJ_ASSERT_RETURN(srv && type && name, PJ_EINVAL);
 
-    rr = find_rr(srv, dns_class, type, name);
-    if (!rr)
+    pj_lock_acquire(srv->lock);
+
+    node = find_node(srv, name);
+    if (node) {
+        r = node->rr_list.next;
+        while (r != &node->rr_list) {
+            struct rr *next = r->next;
+
+            if (r->rec.dnsclass == dns_class && r->rec.type == type) {
+                pj_list_erase(r);
+                pj_list_push_back(&srv->free_rr, r);
+                status = PJ_SUCCESS;
+            }
+            r = next;
+        }
+    }
+
+    pj_lock_release(srv->lock);
+
+    return status;
+}
+
+
+/* Zone parser state */
+typedef struct zone_ctx
+{
+    char        origin[PJ_MAX_HOSTNAME];
+    char        last_name[PJ_MAX_HOSTNAME];
+    unsigned    ttl;
+    unsigned    line;
+} zone_ctx;
+
+static pj_bool_t is_number(const pj_str_t *s)
+{
+    pj_ssize_t i;
+
+    for (i=0; i<s->slen; ++i) {
+        if (!pj_isdigit(s->ptr[i]))
+            return PJ_FALSE;
+    }
+    return s->slen > 0;
+}
+
+/* Make absolute name (without the trailing dot) from zone file name */
+static pj_status_t make_name(const zone_ctx *ctx, const pj_str_t *in,
+                             char *buf, pj_str_t *out)
+{
+    pj_size_t origin_len = pj_ansi_strlen(ctx->origin);
+
+    if (in->slen == 1 && in->ptr[0] == '@') {
+        pj_ansi_strxcpy(buf, ctx->origin, PJ_MAX_HOSTNAME);
+    } else if (in->slen && in->ptr[in->slen-1] == '.') {
+        if (in->slen > PJ_MAX_HOSTNAME)
+            return PJ_ENAMETOOLONG;
+        pj_memcpy(buf, in->ptr, in->slen-1);
+        buf[in->slen-1] = '\0';
+    } else if (origin_len) {
+        if (in->slen + 1 + origin_len >= PJ_MAX_HOSTNAME)
+            return PJ_ENAMETOOLONG;
+        pj_memcpy(buf, in->ptr, in->slen);
+        buf[in->slen] = '.';
+        pj_memcpy(buf + in->slen + 1, ctx->origin, origin_len + 1);
+    } else {
+        if (in->slen >= PJ_MAX_HOSTNAME)
+            return PJ_ENAMETOOLONG;
+        pj_memcpy(buf, in->ptr, in->slen);
+        buf[in->slen] = '\0';
+    }
+
+    out->ptr = buf;
+    out->slen = pj_ansi_strlen(buf);
+    return PJ_SUCCESS;
+}
+
+/* Process one logical line of zone file, the server must be locked */
+static pj_status_t parse_zone_line(pj_dns_server *srv, zone_ctx *ctx,
+                                   char *line, pj_bool_t has_owner,
+                                   pj_bool_t *added)
+{
+    pj_str_t tok[MAX_TOKEN];
+    unsigned cnt = 0, idx = 0, ttl = ctx->ttl;
+    char name_buf[PJ_MAX_HOSTNAME], target_buf[PJ_MAX_HOSTNAME];
+    pj_str_t name, target;
+    pj_dns_parsed_rr rec;
+    char *p = line;
+    pj_status_t status;
+
+    *added = PJ_FALSE;
+
+    /* Tokenize */
+    while (*p && cnt < MAX_TOKEN) {
+        while (*p && pj_isspace(*p))
+            ++p;
+        if (!*p)
+            break;
+        tok[cnt].ptr = p;
+        while (*p && !pj_isspace(*p))
+            ++p;
+        tok[cnt].slen = p - tok[cnt].ptr;
+        if (*p)
+            *p++ = '\0';
+        ++cnt;
+    }
+
+    if (cnt == 0)
+        return PJ_SUCCESS;
+
+    /* Directives */
+    if (tok[0].ptr[0] == '$') {
+        if (pj_stricmp2(&tok[0], "$ORIGIN")==0 && cnt > 1) {
+            status = make_name(ctx, &tok[1], name_buf, &name);
+            if (status != PJ_SUCCESS)
+                return status;
+            pj_ansi_strxcpy(ctx->origin, name_buf, sizeof(ctx->origin));
+        } else if (pj_stricmp2(&tok[0], "$TTL")==0 && cnt > 1 &&
+                   is_number(&tok[1]))
+        {
+            ctx->ttl = (unsigned)pj_strtoul(&tok[1]);
+        } else {
+            PJ_LOG(4,(THIS_FILE, "Zone line %d: ignoring %.*s directive",
+                      ctx->line, (int)tok[0].slen, tok[0].ptr));
+        }
+        return PJ_SUCCESS;
+    }
+
+    /* Owner name, or the previous one if the line starts with space */
+    if (has_owner) {
+        status = make_name(ctx, &tok[idx++], name_buf, &name);
+        if (status != PJ_SUCCESS)
+            return status;
+        pj_ansi_strxcpy(ctx->last_name, name_buf, sizeof(ctx->last_name));
+    } else if (ctx->last_name[0]) {
+        name = pj_str(ctx->last_name);
+    } else {
+        return PJ_EINVAL;
+    }
+
+    /* Optional TTL and class, in any order */
+    for (; idx < cnt; ++idx) {
+        if (is_number(&tok[idx])) {
+            ttl = (unsigned)pj_strtoul(&tok[idx]);
+        } else if (pj_stricmp2(&tok[idx], "IN")==0) {
+            continue;
+        } else if (pj_stricmp2(&tok[idx], "CH")==0 ||
+                   pj_stricmp2(&tok[idx], "HS")==0)
+        {
+            /* Only IN class is supported */
+            return PJ_SUCCESS;
+        } else {
+            break;
+        }
+    }
+
+    if (idx == cnt)
+        return PJ_EINVAL;
+
+    pj_bzero(&rec, sizeof(rec));
+
+    if (pj_stricmp2(&tok[idx], "A")==0) {
+        pj_in_addr addr;
+
+        if (idx + 1 >= cnt ||
+            pj_inet_pton(pj_AF_INET(), &tok[idx+1], &addr) != PJ_SUCCESS)
+        {
+            return PJ_EINVAL;
+        }
+        pj_dns_init_a_rr(&rec, &name, PJ_DNS_CLASS_IN, ttl, &addr);
+
+    } else if (pj_stricmp2(&tok[idx], "AAAA")==0) {
+        pj_in6_addr addr;
+
+        if (idx + 1 >= cnt ||
+            pj_inet_pton(pj_AF_INET6(), &tok[idx+1], &addr) != PJ_SUCCESS)
+        {
+            return PJ_EINVAL;
+        }
+        pj_dns_init_aaaa_rr(&rec, &name, PJ_DNS_CLASS_IN, ttl, &addr);
+
+    } else if (pj_stricmp2(&tok[idx], "CNAME")==0 ||
+               pj_stricmp2(&tok[idx], "NS")==0 ||
+               pj_stricmp2(&tok[idx], "PTR")==0)
+    {
+        if (idx + 1 >= cnt)
+            return PJ_EINVAL;
+        status = make_name(ctx, &tok[idx+1], target_buf, &target);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        pj_dns_init_cname_rr(&rec, &name, PJ_DNS_CLASS_IN, ttl, &target);
+        if (pj_stricmp2(&tok[idx], "NS")==0)
+            rec.type = PJ_DNS_TYPE_NS;
+        else if (pj_stricmp2(&tok[idx], "PTR")==0)
+            rec.type = PJ_DNS_TYPE_PTR;
+
+    } else if (pj_stricmp2(&tok[idx], "SRV")==0) {
+        if (idx + 4 >= cnt || !is_number(&tok[idx+1]) ||
+            !is_number(&tok[idx+2]) || !is_number(&tok[idx+3]))
+        {
+            return PJ_EINVAL;
+        }
+        status = make_name(ctx, &tok[idx+4], target_buf, &target);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        pj_dns_init_srv_rr(&rec, &name, PJ_DNS_CLASS_IN, ttl,
+                           (unsigned)pj_strtoul(&tok[idx+1]),
+                           (unsigned)pj_strtoul(&tok[idx+2]),
+                           (unsigned)pj_strtoul(&tok[idx+3]),
+                           &target);
+    } else {
+        /* Unsupported record type */
+        PJ_LOG(5,(THIS_FILE, "Zone line %d: skipping %.*s record",
+                  ctx->line, (int)tok[idx].slen, tok[idx].ptr));
+        return PJ_SUCCESS;
+    }
+
+    status = add_rr(srv, &rec);
+    if (status == PJ_SUCCESS)
+        *added = PJ_TRUE;
+    else if (status != PJ_EEXISTS)
+        return status;
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_dns_server_add_zone(pj_dns_server *srv,
+                                           const pj_str_t *zone,
+                                           unsigned *p_count)
+{
+    zone_ctx ctx;
+    char line[MAX_LINE];
+    unsigned len = 0, count = 0, paren = 0;
+    pj_bool_t has_owner = PJ_FALSE, comment = PJ_FALSE, bol = PJ_TRUE;
+    pj_ssize_t i;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(srv && zone, PJ_EINVAL);
+
+    pj_bzero(&ctx, sizeof(ctx));
+    ctx.ttl = 3600;
+    ctx.line = 1;
+
+    pj_lock_acquire(srv->lock);
+
+    /* Join the physical lines into logical lines, removing comments and
+     * parentheses.
+     */
+    for (i=0; i<=zone->slen; ++i) {
+        char c = (i < zone->slen) ? zone->ptr[i] : '\n';
+
+        if (bol) {
+            has_owner = !pj_isspace(c);
+            bol = PJ_FALSE;
+        }
+
+        if (c == '\n') {
+            comment = PJ_FALSE;
+            if (!paren) {
+                pj_bool_t added;
+
+                line[len] = '\0';
+                status = parse_zone_line(srv, &ctx, line, has_owner, &added);
+                if (status != PJ_SUCCESS)
+                    break;
+                if (added)
+                    ++count;
+                len = 0;
+                bol = PJ_TRUE;
+                ++ctx.line;
+                continue;
+            }
+            ++ctx.line;
+            c = ' ';
+        }
+
+        if (comment)
+            continue;
+
+        if (c == ';') {
+            comment = PJ_TRUE;
+            continue;
+        } else if (c == '(') {
+            ++paren;
+            c = ' ';
+        } else if (c == ')') {
+            if (paren)
+                --paren;
+            c = ' ';
+        } else if (c == '\r' || c == '\t') {
+            c = ' ';
+        }
+
+        if (len + 1 >= sizeof(line)) {
+            status = PJ_ETOOBIG;
+            break;
+        }
+        line[len++] = c;
+    }
+
+    pj_lock_release(srv->lock);
+
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(3,(THIS_FILE, status, "Error in zone line %d", ctx.line));
+    }
+
+    if (p_count)
+        *p_count = count;
+
+    return status;
+}
+
+
+PJ_DEF(pj_status_t) pj_dns_server_load_zone(pj_dns_server *srv,
+                                            const char *filename,
+                                            unsigned *p_count)
+{
+    pj_pool_t *pool;
+    pj_oshandle_t fd;
+    pj_off_t size;
+    pj_ssize_t read;
+    pj_str_t zone;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(srv && filename, PJ_EINVAL);
+
+    if (p_count)
+        *p_count = 0;
+
+    size = pj_file_size(filename);
+    if (size < 0)
         return PJ_ENOTFOUND;
 
-    pj_list_erase(rr);
+    pool = pj_pool_create(srv->pf, "dnszone", (pj_size_t)size + 1, 256,
+                          NULL);
+    zone.ptr = (char*) pj_pool_alloc(pool, (pj_size_t)size + 1);
+
+    status = pj_file_open(pool, filename, PJ_O_RDONLY, &fd);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    read = (pj_ssize_t)size;
+    status = pj_file_read(fd, zone.ptr, &read);
+    pj_file_close(fd);
+    if (status != PJ_SUCCESS)
+        goto on_return;
+
+    zone.slen = read;
+    status = pj_dns_server_add_zone(srv, &zone, p_count);
+
+on_return:
+    pj_pool_release(pool);
+    return status;
+}
+
+
+PJ_DEF(pj_status_t) pj_dns_server_set_impair(
+                                        pj_dns_server *srv,
+                                        pj_timer_heap_t *timer_heap,
+                                        const pj_dns_server_impair *impair)
+{
+    PJ_ASSERT_RETURN(srv, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!impair || (impair->delay_msec==0 &&
+                                 impair->jitter_msec==0) || timer_heap,
+                     PJ_EINVAL);
+
+    pj_lock_acquire(srv->lock);
+    if (impair)
+        pj_memcpy(&srv->impair, impair, sizeof(*impair));
+    else
+        pj_bzero(&srv->impair, sizeof(srv->impair));
+    if (timer_heap)
+        srv->timer_heap = timer_heap;
+    pj_lock_release(srv->lock);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_dns_server_get_stat(pj_dns_server *srv,
+                                           pj_dns_server_stat *stat)
+{
+    PJ_ASSERT_RETURN(srv && stat, PJ_EINVAL);
+
+    pj_lock_acquire(srv->lock);
+    pj_memcpy(stat, &srv->stat, sizeof(*stat));
+    pj_lock_release(srv->lock);
 
     return PJ_SUCCESS;
 }
@@ -458,6 +963,238 @@ static int print_packet(const pj_dns_parsed_packet *rec, pj_uint8_t *pkt,
 }
 
 
+
+/* Parse the header and the question of a query, without allocating */
+static pj_status_t parse_query(const pj_uint8_t *pkt, pj_size_t size,
+                               pj_dns_hdr *hdr, pj_dns_parsed_query *q,
+                               char *name, unsigned name_size)
+{
+    const pj_uint8_t *p, *end = pkt + size;
+    unsigned len = 0;
+
+    if (size < sizeof(pj_dns_hdr))
+        return PJLIB_UTIL_EDNSINSIZE;
+
+    hdr->id      = (pj_uint16_t)((pkt[0] << 8) | pkt[1]);
+    hdr->flags   = (pj_uint16_t)((pkt[2] << 8) | pkt[3]);
+    hdr->qdcount = (pj_uint16_t)((pkt[4] << 8) | pkt[5]);
+
+    /* Ignore answers */
+    if (PJ_DNS_GET_QR(hdr->flags))
+        return PJLIB_UTIL_EDNSINANSWER;
+
+    /* Will be answered with FORMERR */
+    if (hdr->qdcount != 1)
+        return PJ_SUCCESS;
+
+    p = pkt + sizeof(pj_dns_hdr);
+    while (p < end && *p) {
+        unsigned label = *p++;
+
+        /* Queries don't use name compression */
+        if ((label & 0xC0) || p + label > end || len + label + 1 >= name_size)
+            return PJLIB_UTIL_EDNSINNAMEPTR;
+
+        if (len)
+            name[len++] = '.';
+        pj_memcpy(name + len, p, label);
+        len += label;
+        p += label;
+    }
+
+    if (p + 5 > end)
+        return PJLIB_UTIL_EDNSINSIZE;
+    ++p;
+
+    name[len] = '\0';
+    q->name.ptr = name;
+    q->name.slen = len;
+    q->type = (pj_uint16_t)((p[0] << 8) | p[1]);
+    q->dnsclass = (pj_uint16_t)((p[2] << 8) | p[3]);
+
+    return PJ_SUCCESS;
+}
+
+/* Append the records with the specified name and type */
+static unsigned add_answers(pj_dns_server *srv, const pj_str_t *name,
+                            unsigned type, pj_dns_parsed_rr rr[],
+                            unsigned cnt, unsigned max)
+{
+    name_node *node;
+    struct rr *r;
+
+    node = find_node(srv, name);
+    if (!node)
+        return cnt;
+
+    for (r = node->rr_list.next; r != &node->rr_list && cnt < max;
+         r = r->next)
+    {
+        if (r->rec.dnsclass == PJ_DNS_CLASS_IN && r->rec.type == type) {
+            pj_memcpy(&rr[cnt], &r->rec, sizeof(pj_dns_parsed_rr));
+            ++cnt;
+        }
+    }
+
+    return cnt;
+}
+
+/* Build the answer, the server must be locked */
+static void build_answer(pj_dns_server *srv, const pj_dns_hdr *qhdr,
+                         pj_dns_parsed_query *q, answer *a)
+{
+    pj_dns_parsed_packet ans;
+    pj_dns_parsed_rr ans_rr[MAX_ANS];
+    pj_dns_parsed_rr add_rr[MAX_ANS];
+    unsigned i, cnt = 0, add_cnt = 0;
+    int len;
+
+    pj_bzero(&ans, sizeof(ans));
+    ans.hdr.id = qhdr->id;
+    ans.hdr.flags = (pj_uint16_t)(PJ_DNS_SET_QR(1) | PJ_DNS_SET_AA(1) |
+                                  (qhdr->flags & PJ_DNS_SET_RD(1)));
+    ans.q = q;
+    ans.ans = ans_rr;
+    ans.arr = add_rr;
+
+    if (qhdr->qdcount != 1) {
+        ans.hdr.flags |= PJ_DNS_SET_RCODE(PJ_DNS_RCODE_FORMERR);
+        goto print;
+    }
+
+    if (q->dnsclass != PJ_DNS_CLASS_IN) {
+        ans.hdr.flags |= PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NOTIMPL);
+        goto print;
+    }
+
+    ans.hdr.qdcount = 1;
+
+    cnt = add_answers(srv, &q->name, q->type, ans_rr, 0, MAX_ANS);
+    if (q->type == PJ_DNS_TYPE_CNAME) {
+        /* Add the A records of the canonical names */
+        unsigned n = cnt;
+        for (i=0; i<n; ++i) {
+            cnt = add_answers(srv, &ans_rr[i].rdata.cname.name,
+                              PJ_DNS_TYPE_A, ans_rr, cnt, MAX_ANS);
+        }
+    } else if (cnt == 0) {
+        /* Follow alias */
+        cnt = add_answers(srv, &q->name, PJ_DNS_TYPE_CNAME, ans_rr, 0, 1);
+        if (cnt) {
+            cnt = add_answers(srv, &ans_rr[0].rdata.cname.name, q->type,
+                              ans_rr, cnt, MAX_ANS);
+        }
+    }
+
+    if (cnt == 0) {
+        ans.hdr.flags |= PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NXDOMAIN);
+        ++srv->stat.nxdomain_cnt;
+        goto print;
+    }
+    ans.hdr.anscount = (pj_uint16_t)cnt;
+
+    /* Addresses of SRV targets go to the additional section */
+    if (q->type == PJ_DNS_TYPE_SRV) {
+        for (i=0; i<cnt; ++i) {
+            add_cnt = add_answers(srv, &ans_rr[i].rdata.srv.target,
+                                  PJ_DNS_TYPE_A, add_rr, add_cnt, MAX_ANS);
+            add_cnt = add_answers(srv, &ans_rr[i].rdata.srv.target,
+                                  PJ_DNS_TYPE_AAAA, add_rr, add_cnt,
+                                  MAX_ANS);
+        }
+        ans.hdr.arcount = (pj_uint16_t)add_cnt;
+    }
+
+    /* Simulated truncation */
+    if (srv->impair.tc_pct &&
+        (unsigned)(pj_rand() % 100) < srv->impair.tc_pct)
+    {
+        ans.hdr.anscount = ans.hdr.arcount = 0;
+        ans.hdr.flags |= PJ_DNS_SET_TC(1);
+        ++srv->stat.tc_cnt;
+    }
+
+print:
+    len = print_packet(&ans, a->pkt, PJ_DNS_RESOLVER_MAX_UDP_SIZE);
+
+    /* Too large for UDP: drop the additional records, then truncate */
+    if (len < 0 && ans.hdr.arcount) {
+        ans.hdr.arcount = 0;
+        len = print_packet(&ans, a->pkt, PJ_DNS_RESOLVER_MAX_UDP_SIZE);
+    }
+    if (len < 0) {
+        ans.hdr.anscount = 0;
+        ans.hdr.flags |= PJ_DNS_SET_TC(1);
+        ++srv->stat.tc_cnt;
+        len = print_packet(&ans, a->pkt, PJ_DNS_RESOLVER_MAX_UDP_SIZE);
+    }
+
+    a->len = len;
+}
+
+/* Release answer to the free list, the server must be locked */
+static void release_answer(pj_dns_server *srv, answer *a)
+{
+    pj_list_push_back(&srv->free_ans, a);
+}
+
+static void send_answer(pj_dns_server *srv, answer *a)
+{
+    pj_status_t status;
+
+    pj_ioqueue_op_key_init(&a->send_key, sizeof(a->send_key));
+    a->send_key.user_data = a;
+
+    status = pj_activesock_sendto(srv->asock, &a->send_key, a->pkt, &a->len,
+                                  0, &a->addr, a->addr_len);
+    if (status == PJ_EPENDING) {
+        pj_lock_acquire(srv->lock);
+        ++srv->stat.tx_cnt;
+        pj_lock_release(srv->lock);
+        return;
+    }
+
+    if (status != PJ_SUCCESS)
+        PJ_PERROR(4,(THIS_FILE, status, "Error sending answer"));
+
+    pj_lock_acquire(srv->lock);
+    if (status == PJ_SUCCESS)
+        ++srv->stat.tx_cnt;
+    release_answer(srv, a);
+    pj_lock_release(srv->lock);
+}
+
+static void on_delay_timer(pj_timer_heap_t *th, pj_timer_entry *e)
+{
+    answer *a = (answer*) e->user_data;
+    pj_dns_server *srv = a->srv;
+
+    PJ_UNUSED_ARG(th);
+
+    pj_lock_acquire(srv->lock);
+    pj_list_erase(a);
+    pj_lock_release(srv->lock);
+
+    send_answer(srv, a);
+}
+
+static pj_bool_t on_data_sent(pj_activesock_t *asock,
+                              pj_ioqueue_op_key_t *send_key,
+                              pj_ssize_t sent)
+{
+    pj_dns_server *srv;
+    answer *a = (answer*) send_key->user_data;
+
+    PJ_UNUSED_ARG(sent);
+
+    srv = (pj_dns_server*) pj_activesock_get_user_data(asock);
+    pj_lock_acquire(srv->lock);
+    release_answer(srv, a);
+    pj_lock_release(srv->lock);
+
+    return PJ_TRUE;
+}
+
 static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
                                   void *data,
                                   pj_size_t size,
@@ -466,112 +1203,89 @@ static pj_bool_t on_data_recvfrom(pj_activesock_t *asock,
                                   pj_status_t status)
 {
     pj_dns_server *srv;
-    pj_pool_t *pool;
-    pj_dns_parsed_packet *req;
-    pj_dns_parsed_packet ans;
-    struct rr *rr;
-    pj_ssize_t pkt_len;
-    unsigned i;
+    pj_dns_hdr qhdr;
+    pj_dns_parsed_query q;
+    char name[PJ_MAX_HOSTNAME];
+    unsigned delay = 0;
+    answer *a;
 
     if (status != PJ_SUCCESS)
         return PJ_TRUE;
 
     srv = (pj_dns_server*) pj_activesock_get_user_data(asock);
-    pool = pj_pool_create(srv->pf, "dnssrvrx", 512, 256, NULL);
 
-    status = pj_dns_parse_packet(pool, data, (unsigned)size, &req);
+    status = parse_query((const pj_uint8_t*)data, size, &qhdr, &q, name,
+                         sizeof(name));
+
+    pj_lock_acquire(srv->lock);
+
+    ++srv->stat.rx_cnt;
+
     if (status != PJ_SUCCESS) {
         char addrinfo[PJ_INET6_ADDRSTRLEN+10];
+
+        ++srv->stat.err_cnt;
+        pj_lock_release(srv->lock);
+
         pj_sockaddr_print(src_addr, addrinfo, sizeof(addrinfo), 3);
         PJ_PERROR(4,(THIS_FILE, status, "Error parsing query from %s",
                      addrinfo));
-        goto on_return;
+        return PJ_TRUE;
     }
 
-    /* Init answer */
-    pj_bzero(&ans, sizeof(ans));
-    ans.hdr.id = req->hdr.id;
-    ans.hdr.qdcount = 1;
-    ans.q = (pj_dns_parsed_query*) PJ_POOL_ALLOC_T(pool, pj_dns_parsed_query);
-    pj_memcpy(ans.q, req->q, sizeof(pj_dns_parsed_query));
+    /* Simulated loss */
+    if (srv->impair.loss_pct &&
+        (unsigned)(pj_rand() % 100) < srv->impair.loss_pct)
+    {
+        ++srv->stat.drop_cnt;
+        pj_lock_release(srv->lock);
+        return PJ_TRUE;
+    }
 
-    if (req->hdr.qdcount != 1) {
-        ans.hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_FORMERR);
-        goto send_pkt;
+    if (!pj_list_empty(&srv->free_ans)) {
+        a = srv->free_ans.next;
+        pj_list_erase(a);
+    } else {
+        a = PJ_POOL_ZALLOC_T(srv->pool, answer);
+        a->srv = srv;
+        pj_timer_entry_init(&a->timer, 0, a, &on_delay_timer);
     }
 
-    if (req->q[0].dnsclass != PJ_DNS_CLASS_IN) {
-        ans.hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NOTIMPL);
-        goto send_pkt;
+    pj_memcpy(&a->addr, src_addr, addr_len);
+    a->addr_len = addr_len;
+
+    build_answer(srv, &qhdr, &q, a);
+    if (a->len < 1) {
+        PJ_LOG(4,(THIS_FILE, "Error: answer too large"));
+        release_answer(srv, a);
+        pj_lock_release(srv->lock);
+        return PJ_TRUE;
     }
 
-    /* Find the record */
-    rr = find_rr(srv, req->q->dnsclass, req->q->type, &req->q->name);
-    if (rr == NULL) {
-        ans.hdr.flags = PJ_DNS_SET_RCODE(PJ_DNS_RCODE_NXDOMAIN);
-        goto send_pkt;
+    /* Simulated latency */
+    if (srv->timer_heap) {
+        delay = srv->impair.delay_msec;
+        if (srv->impair.jitter_msec)
+            delay += (unsigned)pj_rand() % (srv->impair.jitter_msec + 1);
     }
 
-    /* Init answer record */
-    ans.hdr.anscount = 0;
-    ans.ans = (pj_dns_parsed_rr*)
-              pj_pool_calloc(pool, MAX_ANS, sizeof(pj_dns_parsed_rr));
+    if (delay) {
+        pj_time_val tv;
 
-    /* DNS SRV query needs special treatment since it returns multiple
-     * records
-     */
-    if (req->q->type == PJ_DNS_TYPE_SRV) {
-        struct rr *r;
-
-        r = srv->rr_list.next;
-        while (r != &srv->rr_list) {
-            if (r->rec.dnsclass == req->q->dnsclass && 
-                r->rec.type == PJ_DNS_TYPE_SRV && 
-                pj_stricmp(&r->rec.name, &req->q->name)==0 &&
-                ans.hdr.anscount < MAX_ANS)
-            {
-                pj_memcpy(&ans.ans[ans.hdr.anscount], &r->rec,
-                          sizeof(pj_dns_parsed_rr));
-                ++ans.hdr.anscount;
-            }
-            r = r->next;
-        }
-    } else {
-        /* Otherwise just copy directly from the server record */
-        pj_memcpy(&ans.ans[ans.hdr.anscount], &rr->rec,
-                          sizeof(pj_dns_parsed_rr));
-        ++ans.hdr.anscount;
-    }
-
-    /* For each CNAME entry, add A entry */
-    for (i=0; i<ans.hdr.anscount && ans.hdr.anscount < MAX_ANS; ++i) {
-        if (ans.ans[i].type == PJ_DNS_TYPE_CNAME) {
-            struct rr *r;
-
-            r = find_rr(srv, ans.ans[i].dnsclass, PJ_DNS_TYPE_A,
-                        &ans.ans[i].name);
-            pj_memcpy(&ans.ans[ans.hdr.anscount], &r->rec,
-                              sizeof(pj_dns_parsed_rr));
-            ++ans.hdr.anscount;
+        tv.sec = delay / 1000;
+        tv.msec = delay % 1000;
+        if (pj_timer_heap_schedule(srv->timer_heap, &a->timer,
+                                   &tv) == PJ_SUCCESS)
+        {
+            pj_list_push_back(&srv->delayed_list, a);
+            pj_lock_release(srv->lock);
+            return PJ_TRUE;
         }
     }
 
-send_pkt:
-    pkt_len = print_packet(&ans, (pj_uint8_t*)data, MAX_PKT);
-    if (pkt_len < 1) {
-        PJ_LOG(4,(THIS_FILE, "Error: answer too large"));
-        goto on_return;
-    }
+    pj_lock_release(srv->lock);
 
-    status = pj_activesock_sendto(srv->asock, &srv->send_key, data, &pkt_len,
-                                  0, src_addr, addr_len);
-    if (status != PJ_SUCCESS && status != PJ_EPENDING) {
-        PJ_PERROR(4,(THIS_FILE, status, "Error sending answer"));
-        goto on_return;
-    }
+    send_answer(srv, a);
 
-on_return:
-    pj_pool_release(pool);
     return PJ_TRUE;
 }
-
@@ -98,6 +98,7 @@ static const struct
     PJ_BUILD_ERR( PJLIB_UTIL_EHTTPINCHDR,       "Incomplete response header received"),
     PJ_BUILD_ERR( PJLIB_UTIL_EHTTPINSBUF,       "Insufficient buffer"),
     PJ_BUILD_ERR( PJLIB_UTIL_EHTTPLOST,         "Connection lost"),
+    PJ_BUILD_ERR( PJLIB_UTIL_EHTTPINCHUNK,      "Invalid chunked transfer encoding"),
 
     /* CLI */
     PJ_BUILD_ERR( PJ_CLI_EEXIT,                 "Exit current session"),
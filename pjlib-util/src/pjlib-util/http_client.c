@@ -22,6 +22,8 @@
 #include <pj/ctype.h>
 #include <pj/errno.h>
 #include <pj/except.h>
+#include <pj/list.h>
+#include <pj/lock.h>
 #include <pj/pool.h>
 #include <pj/string.h>
 #include <pj/timer.h>
@@ -97,6 +99,18 @@ enum http_state
     READING_DATA,
     READING_COMPLETE,
     ABORTING,
+    QUEUED,             /* Waiting for a pooled connection */
+};
+
+/* Chunked Transfer-Encoding decoder state */
+enum chunk_state
+{
+    CHUNK_SIZE,         /* Reading the chunk size (hex) */
+    CHUNK_EXT,          /* Skipping chunk extensions until LF */
+    CHUNK_DATA,         /* Reading chunk data */
+    CHUNK_DATA_END,     /* Expecting the CRLF after chunk data */
+    CHUNK_TRAILER,      /* Skipping trailer lines until an empty line */
+    CHUNK_DONE          /* Last chunk and trailer have been read */
 };
 
 enum auth_state
@@ -106,6 +120,57 @@ enum auth_state
     AUTH_DONE           /* Done retrying the request with auth. */
 };
 
+typedef struct conn_host conn_host;
+
+/* A TCP connection carrying the requests. A connection that belongs to a
+ * connection pool has its own memory pool and may outlive the request;
+ * otherwise it is embedded in, and owned by, the request.
+ */
+typedef struct http_conn
+{
+    PJ_DECL_LIST_MEMBER(struct http_conn);
+    pj_http_conn_pool       *cpool;     /* Owner pool, NULL if not pooled */
+    conn_host               *host;      /* Pool host entry                */
+    pj_pool_t               *pool;      /* Pool for asock and read buffer */
+    pj_activesock_t         *asock;     /* Active socket                  */
+    pj_http_req             *hreq;      /* Current request, NULL if idle  */
+    void                    *rbuf;      /* Read buffer                    */
+    pj_bool_t               reading;    /* Whether reading has started    */
+    unsigned                in_cb;      /* Destroy must be deferred       */
+    pj_bool_t               closed;     /* Closed while in_cb             */
+    pj_timer_entry          idle_timer; /* Idle timeout timer             */
+} http_conn;
+
+/* Entry of a request waiting for a pooled connection */
+typedef struct http_queue_node
+{
+    PJ_DECL_LIST_MEMBER(struct http_queue_node);
+    pj_http_req             *hreq;
+} http_queue_node;
+
+/* Pooled connections to the same scheme, host and port */
+struct conn_host
+{
+    PJ_DECL_LIST_MEMBER(struct conn_host);
+    const char              *protocol;  /* One of http_protocol_names    */
+    pj_str_t                host;       /* Host name                     */
+    pj_uint16_t             port;       /* Port number                   */
+    unsigned                conn_cnt;   /* Active and idle connections   */
+    http_conn               idle_list;  /* Idle connections, MRU first   */
+    http_queue_node         pending;    /* Requests waiting, FIFO        */
+};
+
+struct pj_http_conn_pool
+{
+    pj_pool_t               *pool;      /* Pool for host entries         */
+    pj_timer_heap_t         *timer;     /* Timer for idle timeout        */
+    pj_ioqueue_t            *ioqueue;   /* Ioqueue for the connections   */
+    pj_lock_t               *lock;      /* Protects the lists below      */
+    pj_http_conn_pool_param param;      /* Settings                      */
+    conn_host               host_list;  /* Known hosts                   */
+    pj_http_conn_pool_stat  stat;       /* Statistics                    */
+};
+
 struct pj_http_req
 {
     pj_str_t                url;        /* Request URL */
@@ -125,6 +190,11 @@ struct pj_http_req
     pj_bool_t               resolved;   /* Whether URL's host is resolved */
     pj_http_resp            response;   /* HTTP response */
     pj_ioqueue_op_key_t     op_key;
+    http_conn               own_conn;   /* Connection if not pooled      */
+    http_conn               *conn;      /* Current connection            */
+    http_queue_node         queue_node; /* Entry in the pending queue    */
+    pj_bool_t               chunked;    /* Chunked response body         */
+    pj_bool_t               keep_alive; /* Connection may be reused      */
     struct tcp_state
     {
         /* Total data sent so far if the data is sent in segments (i.e.
@@ -137,6 +207,12 @@ struct pj_http_req
         pj_size_t current_send_size;
         /* Total data received so far. */
         pj_size_t current_read_size;
+        /* Chunked body decoder state. */
+        enum chunk_state chunk_state;
+        /* Bytes left in the current chunk. */
+        pj_size_t chunk_left;
+        /* Length of the current size or trailer line. */
+        pj_size_t chunk_line_len;
     } tcp_state;
 };
 
@@ -146,6 +222,20 @@ static pj_status_t http_req_start_sending(pj_http_req *hreq);
 static pj_status_t http_req_start_reading(pj_http_req *hreq);
 /* End the request */
 static pj_status_t http_req_end_request(pj_http_req *hreq);
+/* Connect to the server on the request's connection */
+static pj_status_t http_req_connect(pj_http_req *hreq);
+/* Continue a request that has been waiting for a pooled connection */
+static void http_req_resume(pj_http_req *hreq, http_conn *conn);
+/* Close the connection and free its resources */
+static void http_conn_destroy(http_conn *conn);
+/* Get a connection for the request from its pool */
+static pj_status_t conn_pool_acquire(pj_http_req *hreq, http_conn **p_conn);
+/* Return a connection to its pool after a completed request */
+static void conn_pool_release(http_conn *conn);
+/* Remove an idle connection from its pool */
+static pj_bool_t conn_pool_remove_idle(http_conn *conn);
+/* Remove the request from the queue of requests waiting for a connection */
+static void conn_pool_dequeue(pj_http_req *hreq);
 /* Parse the header data and populate the header fields with the result. */
 static pj_status_t http_headers_parse(char *hdata, pj_size_t size, 
                                       pj_http_headers *headers);
@@ -196,12 +286,19 @@ static void on_syntax_error(pj_scanner *scanner)
 }
 
 /* Callback when connection is established to the server */
+/* Get the request currently using the connection of the active socket */
+static pj_http_req *get_asock_req(pj_activesock_t *asock)
+{
+    http_conn *conn = (http_conn*) pj_activesock_get_user_data(asock);
+    return conn->hreq;
+}
+
 static pj_bool_t http_on_connect(pj_activesock_t *asock,
                                  pj_status_t status)
 {
-    pj_http_req *hreq = (pj_http_req*) pj_activesock_get_user_data(asock);
+    pj_http_req *hreq = get_asock_req(asock);
 
-    if (hreq->state == ABORTING || hreq->state == IDLE)
+    if (!hreq || hreq->state == ABORTING || hreq->state == IDLE)
         return PJ_FALSE;
 
     if (status != PJ_SUCCESS) {
@@ -220,13 +317,17 @@ static pj_bool_t http_on_data_sent(pj_activesock_t *asock,
                                    pj_ioqueue_op_key_t *op_key,
                                    pj_ssize_t sent)
 {
-    pj_http_req *hreq = (pj_http_req*) pj_activesock_get_user_data(asock);
+    pj_http_req *hreq = get_asock_req(asock);
 
     PJ_UNUSED_ARG(op_key);
 
-    if (hreq->state == ABORTING || hreq->state == IDLE)
+    if (!hreq || hreq->state == ABORTING || hreq->state == IDLE)
         return PJ_FALSE;
 
+    /* The response may already be being read on a reused connection */
+    if (hreq->state != SENDING_REQUEST && hreq->state != SENDING_REQUEST_BODY)
+        return PJ_TRUE;
+
     if (sent <= 0) {
         hreq->error = (sent < 0 ? (pj_status_t)-sent : PJLIB_UTIL_EHTTPLOST);
         pj_http_req_cancel(hreq, PJ_TRUE);
@@ -288,21 +389,242 @@ static pj_bool_t http_on_data_sent(pj_activesock_t *asock,
     return PJ_TRUE;
 }
 
-static pj_bool_t http_on_data_read(pj_activesock_t *asock,
-                                  void *data,
-                                  pj_size_t size,
-                                  pj_status_t status,
-                                  pj_size_t *remainder)
+/* Check the response header to find out whether the connection may be
+ * kept open after the response body.
+ */
+static pj_bool_t http_resp_is_persistent(const pj_http_resp *resp)
 {
-    pj_http_req *hreq = (pj_http_req*) pj_activesock_get_user_data(asock);
+    const pj_str_t STR_CONNECTION = { "Connection", 10 };
+    const pj_str_t STR_CLOSE = { "close", 5 };
+    const pj_str_t STR_KEEP_ALIVE = { "keep-alive", 10 };
+    pj_bool_t persistent;
+    unsigned i;
 
-    TRACE_((THIS_FILE, "\nData received: %d bytes", size));
+    /* HTTP/1.1 connections are persistent unless told otherwise */
+    persistent = (pj_stricmp2(&resp->version, "HTTP/1.0") != 0);
 
-    if (data == NULL)
+    for (i = 0; i < resp->headers.count; i++) {
+        const pj_http_header_elmt *hdr = &resp->headers.header[i];
+
+        if (pj_stricmp(&hdr->name, &STR_CONNECTION))
+            continue;
+        if (pj_stristr(&hdr->value, &STR_CLOSE))
+            return PJ_FALSE;
+        if (pj_stristr(&hdr->value, &STR_KEEP_ALIVE))
+            persistent = PJ_TRUE;
+    }
+
+    return persistent;
+}
+
+/* Check whether the response body uses chunked Transfer-Encoding */
+static pj_bool_t http_resp_is_chunked(const pj_http_resp *resp)
+{
+    const pj_str_t STR_TRANSFER_ENCODING = { "Transfer-Encoding", 17 };
+    const pj_str_t STR_CHUNKED = { "chunked", 7 };
+    unsigned i;
+
+    for (i = 0; i < resp->headers.count; i++) {
+        const pj_http_header_elmt *hdr = &resp->headers.header[i];
+
+        if (!pj_stricmp(&hdr->name, &STR_TRANSFER_ENCODING) &&
+            pj_stristr(&hdr->value, &STR_CHUNKED))
+        {
+            return PJ_TRUE;
+        }
+    }
+    return PJ_FALSE;
+}
+
+/* Pass a segment of the response body to the application, or append it
+ * to the response data.
+ */
+static void http_req_on_body(pj_http_req *hreq, void *data, pj_size_t size)
+{
+    if (hreq->cb.on_data_read) {
+        /* If application wishes to receive the data once available, call
+         * its callback.
+         */
+        if (size > 0)
+            (*hreq->cb.on_data_read)(hreq, data, size);
+    } else {
+        if (hreq->response.size == 0) {
+            /* If we know the content length, allocate the data based
+             * on that, otherwise we'll use initial buffer size and grow 
+             * it later if necessary.
+             */
+            hreq->response.size = (hreq->response.content_length == -1 ? 
+                                   INITIAL_DATA_BUF_SIZE : 
+                                   hreq->response.content_length);
+            hreq->response.data = pj_pool_alloc(hreq->pool, 
+                                                hreq->response.size);
+        }
+
+        /* If the size of data received exceeds its current size,
+         * grow the buffer by a factor of 2.
+         */
+        if (hreq->tcp_state.current_read_size + size > 
+            hreq->response.size) 
+        {
+            void *olddata = hreq->response.data;
+            pj_size_t new_size = hreq->response.size ?
+                                 hreq->response.size : INITIAL_DATA_BUF_SIZE;
+
+            while (hreq->tcp_state.current_read_size + size > new_size)
+                new_size <<= 1;
+            hreq->response.data = pj_pool_alloc(hreq->pool, new_size);
+            pj_memcpy(hreq->response.data, olddata,
+                      hreq->tcp_state.current_read_size);
+            hreq->response.size = new_size;
+        }
+
+        /* Append the response data. */
+        pj_memcpy((char *)hreq->response.data + 
+                  hreq->tcp_state.current_read_size, data, size);
+    }
+    hreq->tcp_state.current_read_size += size;
+}
+
+/* Decode chunked body data, passing the chunk payload to
+ * http_req_on_body(). On return, consumed is the number of bytes used,
+ * which is less than size only when the last chunk has been read.
+ */
+static pj_status_t http_chunk_decode(pj_http_req *hreq, char *data,
+                                     pj_size_t size, pj_size_t *consumed)
+{
+    struct tcp_state *ts = &hreq->tcp_state;
+    char *p = data, *end = data + size;
+
+    while (p != end && ts->chunk_state != CHUNK_DONE) {
+        switch (ts->chunk_state) {
+        case CHUNK_SIZE:
+        case CHUNK_EXT:
+            if (*p == '\n') {
+                if (ts->chunk_line_len == 0)
+                    return PJLIB_UTIL_EHTTPINCHUNK;
+                ts->chunk_state = ts->chunk_left ? CHUNK_DATA : CHUNK_TRAILER;
+                ts->chunk_line_len = 0;
+            } else if (ts->chunk_state == CHUNK_EXT) {
+                /* Ignore chunk extensions */
+            } else if (pj_isxdigit(*p)) {
+                /* Guard against overflow */
+                if (ts->chunk_left >> (sizeof(ts->chunk_left) * 8 - 4))
+                    return PJ_ETOOBIG;
+                ts->chunk_left = (ts->chunk_left << 4) |
+                                 pj_hex_digit_to_val((unsigned char)*p);
+                ++ts->chunk_line_len;
+            } else if (*p == ';' || *p == ' ' || *p == '\t' || *p == '\r') {
+                ts->chunk_state = CHUNK_EXT;
+            } else {
+                return PJLIB_UTIL_EHTTPINCHUNK;
+            }
+            ++p;
+            break;
+
+        case CHUNK_DATA:
+            {
+                pj_size_t len = end - p;
+
+                if (len > ts->chunk_left)
+                    len = ts->chunk_left;
+                http_req_on_body(hreq, p, len);
+                /* Application may have cancelled the request */
+                if (hreq->state != READING_DATA) {
+                    *consumed = size;
+                    return PJ_SUCCESS;
+                }
+                p += len;
+                ts->chunk_left -= len;
+                if (ts->chunk_left == 0)
+                    ts->chunk_state = CHUNK_DATA_END;
+            }
+            break;
+
+        case CHUNK_DATA_END:
+            if (*p == '\n')
+                ts->chunk_state = CHUNK_SIZE;
+            else if (*p != '\r')
+                return PJLIB_UTIL_EHTTPINCHUNK;
+            ++p;
+            break;
+
+        case CHUNK_TRAILER:
+            if (*p == '\n') {
+                if (ts->chunk_line_len == 0)
+                    ts->chunk_state = CHUNK_DONE;
+                ts->chunk_line_len = 0;
+            } else if (*p != '\r') {
+                ++ts->chunk_line_len;
+            }
+            ++p;
+            break;
+
+        case CHUNK_DONE:
+            break;
+        }
+    }
+
+    *consumed = p - data;
+    return PJ_SUCCESS;
+}
+
+/* The response has been completely received. Returns the value for the
+ * activesock's on_data_read().
+ */
+static pj_bool_t http_req_on_complete(pj_http_req *hreq)
+{
+    http_conn *conn = hreq->conn;
+    pj_bool_t keep_alive = hreq->keep_alive;
+
+    /* Finish reading. The connection goes back to its pool if it can be
+     * reused, in which case it must stay alive until we return to the
+     * activesock even if the application destroys the pool.
+     */
+    hreq->state = READING_COMPLETE;
+    if (keep_alive)
+        ++conn->in_cb;
+    http_req_end_request(hreq);
+    hreq->response.size = hreq->tcp_state.current_read_size;
+
+    /* HTTP request is completed, call the callback. */
+    if (hreq->cb.on_complete) {
+        (*hreq->cb.on_complete)(hreq, PJ_SUCCESS, &hreq->response);
+    }
+
+    if (!keep_alive)
+        return PJ_FALSE;
+
+    if (--conn->in_cb == 0 && conn->closed) {
+        pj_pool_release(conn->pool);
         return PJ_FALSE;
+    }
+    return PJ_TRUE;
+}
+
+static pj_bool_t http_req_on_data_read(pj_http_req *hreq,
+                                       void *data,
+                                       pj_size_t size,
+                                       pj_status_t status,
+                                       pj_size_t *remainder)
+{
+    pj_bool_t done;
+
+    TRACE_((THIS_FILE, "\nData received: %d bytes", size));
+
     if (hreq->state == ABORTING || hreq->state == IDLE)
         return PJ_FALSE;
 
+    if (hreq->state == SENDING_REQUEST ||
+        hreq->state == SENDING_REQUEST_BODY ||
+        hreq->state == REQUEST_SENT)
+    {
+        /* The response arrives on a reused connection before the send
+         * completion is reported.
+         */
+        hreq->state = READING_RESPONSE;
+        hreq->tcp_state.current_read_size = 0;
+    }
+
     if (hreq->state == READING_RESPONSE) {
         pj_status_t st;
         pj_size_t rem;
@@ -336,6 +658,21 @@ static pj_bool_t http_on_data_read(pj_activesock_t *asock,
                  */
                 hreq->response.data = data;
                 hreq->response.size = size - rem;
+            } else {
+                hreq->chunked = http_resp_is_chunked(&hreq->response);
+                if (hreq->chunked) {
+                    /* Content-Length must be ignored */
+                    hreq->response.content_length = -1;
+                } else if (hreq->response.status_code == 204 ||
+                           hreq->response.status_code == 304)
+                {
+                    /* These never have a body */
+                    hreq->response.content_length = 0;
+                }
+                hreq->keep_alive = hreq->conn->cpool &&
+                                   (hreq->chunked ||
+                                    hreq->response.content_length >= 0) &&
+                                   http_resp_is_persistent(&hreq->response);
             }
 
             /* If code is 401 or 407, find and parse WWW-Authenticate or
@@ -396,10 +733,13 @@ static pj_bool_t http_on_data_read(pj_activesock_t *asock,
             hreq->response.data = NULL;
             hreq->response.size = 0;
 
+            /* Process the body that came with the header. An empty body
+             * is complete already.
+             */
             if (rem > 0 || hreq->response.content_length == 0)
-                return http_on_data_read(asock, (rem == 0 ? NULL:
-                                         (char *)data + size - rem),
-                                         rem, PJ_SUCCESS, NULL);
+                return http_req_on_data_read(hreq,
+                                             (char *)data + size - rem,
+                                             rem, PJ_SUCCESS, NULL);
         }
 
         return PJ_TRUE;
@@ -407,68 +747,51 @@ static pj_bool_t http_on_data_read(pj_activesock_t *asock,
 
     if (hreq->state != READING_DATA)
         return PJ_FALSE;
-    if (hreq->cb.on_data_read) {
-        /* If application wishes to receive the data once available, call
-         * its callback.
-         */
-        if (size > 0)
-            (*hreq->cb.on_data_read)(hreq, data, size);
-    } else {
-        if (hreq->response.size == 0) {
-            /* If we know the content length, allocate the data based
-             * on that, otherwise we'll use initial buffer size and grow 
-             * it later if necessary.
-             */
-            hreq->response.size = (hreq->response.content_length == -1 ? 
-                                   INITIAL_DATA_BUF_SIZE : 
-                                   hreq->response.content_length);
-            hreq->response.data = pj_pool_alloc(hreq->pool, 
-                                                hreq->response.size);
-        }
 
-        /* If the size of data received exceeds its current size,
-         * grow the buffer by a factor of 2.
-         */
-        if (hreq->tcp_state.current_read_size + size > 
-            hreq->response.size) 
-        {
-            void *olddata = hreq->response.data;
+    if (hreq->chunked) {
+        pj_status_t st;
+        pj_size_t consumed;
 
-            hreq->response.data = pj_pool_alloc(hreq->pool, 
-                                                hreq->response.size << 1);
-            pj_memcpy(hreq->response.data, olddata, hreq->response.size);
-            hreq->response.size <<= 1;
+        st = http_chunk_decode(hreq, (char*)data, size, &consumed);
+        if (st != PJ_SUCCESS) {
+            hreq->error = st;
+            pj_http_req_cancel(hreq, PJ_TRUE);
+            return PJ_FALSE;
         }
+        if (hreq->state != READING_DATA)
+            return PJ_FALSE;
 
-        /* Append the response data. */
-        pj_memcpy((char *)hreq->response.data + 
-                  hreq->tcp_state.current_read_size, data, size);
-    }
-    hreq->tcp_state.current_read_size += size;
-
-    /* If the total data received so far is equal to the content length
-     * or if it's already EOF.
-     */
-    if ((hreq->response.content_length >=0 &&
-        (pj_ssize_t)hreq->tcp_state.current_read_size >=
-        hreq->response.content_length) ||
-        (status == PJ_EEOF && hreq->response.content_length == -1)) 
-    {
-        /* Finish reading */
-        http_req_end_request(hreq);
-        hreq->response.size = hreq->tcp_state.current_read_size;
+        done = (hreq->tcp_state.chunk_state == CHUNK_DONE);
+        /* Trailing data would belong to a response we didn't ask for */
+        if (done && consumed != size)
+            hreq->keep_alive = PJ_FALSE;
+    } else {
+        http_req_on_body(hreq, data, size);
 
-        /* HTTP request is completed, call the callback. */
-        if (hreq->cb.on_complete) {
-            (*hreq->cb.on_complete)(hreq, PJ_SUCCESS, &hreq->response);
+        /* If the total data received so far is equal to the content
+         * length or if it's already EOF.
+         */
+        done = (hreq->response.content_length >=0 &&
+                (pj_ssize_t)hreq->tcp_state.current_read_size >=
+                hreq->response.content_length) ||
+               (status == PJ_EEOF && hreq->response.content_length == -1);
+        if (done && (pj_ssize_t)hreq->tcp_state.current_read_size !=
+                    hreq->response.content_length)
+        {
+            hreq->keep_alive = PJ_FALSE;
         }
+    }
 
-        return PJ_FALSE;
+    if (done) {
+        if (status != PJ_SUCCESS && status != PJ_EPENDING)
+            hreq->keep_alive = PJ_FALSE;
+        return http_req_on_complete(hreq);
     }
 
     /* Error status or premature EOF. */
     if ((status != PJ_SUCCESS && status != PJ_EPENDING && status != PJ_EEOF)
-        || (status == PJ_EEOF && hreq->response.content_length > -1)) 
+        || (status == PJ_EEOF && (hreq->response.content_length > -1 ||
+                                  hreq->chunked)))
     {
         hreq->error = status;
         pj_http_req_cancel(hreq, PJ_TRUE);
@@ -478,6 +801,29 @@ static pj_bool_t http_on_data_read(pj_activesock_t *asock,
     return PJ_TRUE;
 }
 
+static pj_bool_t http_on_data_read(pj_activesock_t *asock,
+                                  void *data,
+                                  pj_size_t size,
+                                  pj_status_t status,
+                                  pj_size_t *remainder)
+{
+    http_conn *conn = (http_conn*) pj_activesock_get_user_data(asock);
+
+    if (data == NULL)
+        return PJ_FALSE;
+
+    if (!conn->hreq) {
+        /* Data or EOF on an idle pooled connection. The server is closing
+         * it, or it is out of sync; either way it can't be reused.
+         */
+        conn_pool_remove_idle(conn);
+        http_conn_destroy(conn);
+        return PJ_FALSE;
+    }
+
+    return http_req_on_data_read(conn->hreq, data, size, status, remainder);
+}
+
 /* Callback to be called when query has timed out */
 static void on_timeout( pj_timer_heap_t *timer_heap,
                         struct pj_timer_entry *entry)
@@ -920,6 +1266,9 @@ PJ_DEF(pj_status_t) pj_http_req_create(pj_pool_t *pool,
     hreq->state = IDLE;
     hreq->resolved = PJ_FALSE;
     hreq->buffer.ptr = NULL;
+    hreq->own_conn.pool = own_pool;
+    pj_list_init(&hreq->queue_node);
+    hreq->queue_node.hreq = hreq;
     pj_timer_entry_init(&hreq->timer_entry, 0, hreq, &on_timeout);
 
     /* Initialize parameter */
@@ -937,6 +1286,10 @@ PJ_DEF(pj_status_t) pj_http_req_create(pj_pool_t *pool,
         PJ_ASSERT_RETURN(!pj_strcmp2(&hreq->param.version, HTTP_1_0) || 
                          !pj_strcmp2(&hreq->param.version, HTTP_1_1), 
                          PJ_ENOTSUP); 
+        PJ_ASSERT_RETURN(!hreq->param.conn_pool ||
+                         (hreq->param.conn_pool->timer == timer &&
+                          hreq->param.conn_pool->ioqueue == ioqueue),
+                         PJ_EINVAL);
         pj_time_val_normalize(&hreq->param.timeout);
     } else {
         pj_http_req_param_default(&hreq->param);
@@ -1008,25 +1361,17 @@ PJ_DEF(void*) pj_http_req_get_user_data(pj_http_req *http_req)
     return http_req->param.user_data;
 }
 
-static pj_status_t start_http_req(pj_http_req *http_req,
-                                  pj_bool_t notify_on_fail)
+/* Create the socket for the request's connection and connect to the
+ * server.
+ */
+static pj_status_t http_req_connect(pj_http_req *http_req)
 {
+    http_conn *conn = http_req->conn;
     pj_sock_t sock = PJ_INVALID_SOCKET;
     pj_status_t status;
     pj_activesock_cb asock_cb;
     int retry = 0;
 
-    PJ_ASSERT_RETURN(http_req, PJ_EINVAL);
-    /* Http request is not idle, a request was initiated before and 
-     * is still in progress
-     */
-    PJ_ASSERT_RETURN(http_req->state == IDLE, PJ_EBUSY);
-
-    /* Reset few things to make sure restarting works */
-    http_req->error = 0;
-    http_req->response.headers.count = 0;
-    pj_bzero(&http_req->tcp_state, sizeof(http_req->tcp_state));
-
     if (!http_req->resolved) {
         /* Resolve the Internet address of the host */
         status = pj_sockaddr_init(http_req->param.addr_family, 
@@ -1037,7 +1382,7 @@ static pj_status_t start_http_req(pj_http_req *http_req,
             (http_req->param.addr_family==pj_AF_INET() &&
              http_req->addr.ipv4.sin_addr.s_addr==PJ_INADDR_NONE))
         {
-            goto on_return;
+            return (status != PJ_SUCCESS ? status : PJ_ERESOLVE);
         }
         http_req->resolved = PJ_TRUE;
     }
@@ -1046,7 +1391,7 @@ static pj_status_t start_http_req(pj_http_req *http_req,
                             pj_SOCK_STREAM() | pj_SOCK_CLOEXEC(),
                             0, &sock);
     if (status != PJ_SUCCESS)
-        goto on_return; // error creating socket
+        return status; // error creating socket
 
     pj_bzero(&asock_cb, sizeof(asock_cb));
     asock_cb.on_data_read = &http_on_data_read;
@@ -1076,20 +1421,84 @@ static pj_status_t start_http_req(pj_http_req *http_req,
         PJ_PERROR(1,(THIS_FILE, status,
                      "Unable to bind to the requested port"));
         pj_sock_close(sock);
-        goto on_return;
+        return status;
     }
 
     // TODO: should we set whole data to 0 by default?
     // or add it in the param?
-    status = pj_activesock_create(http_req->pool, sock, pj_SOCK_STREAM(), 
+    status = pj_activesock_create(conn->pool, sock, pj_SOCK_STREAM(), 
                                   NULL, http_req->ioqueue,
-                                  &asock_cb, http_req, &http_req->asock);
+                                  &asock_cb, conn, &conn->asock);
     if (status != PJ_SUCCESS) {
         pj_sock_close(sock);
-        goto on_return; // error creating activesock
+        return status; // error creating activesock
+    }
+    http_req->asock = conn->asock;
+
+    /* Connect to host */
+    http_req->state = CONNECTING;
+    status = pj_activesock_start_connect(http_req->asock, conn->pool, 
+                                         (pj_sockaddr_t *)&(http_req->addr), 
+                                         pj_sockaddr_get_len(&http_req->addr));
+    if (status == PJ_SUCCESS) {
+        http_req->state = SENDING_REQUEST;
+        status =  http_req_start_sending(http_req);
+    } else if (status == PJ_EPENDING) {
+        status = PJ_SUCCESS;
+    }
+
+    return status;
+}
+
+/* Start the request on a pooled connection, which is either idle and
+ * connected, or newly created.
+ */
+static pj_status_t http_req_start_on_conn(pj_http_req *http_req,
+                                          http_conn *conn)
+{
+    http_req->conn = conn;
+    http_req->asock = conn->asock;
+
+    if (!conn->asock)
+        return http_req_connect(http_req);
+
+    /* Connected already, send the request right away */
+    http_req->state = SENDING_REQUEST;
+    return http_req_start_sending(http_req);
+}
+
+static void http_req_resume(pj_http_req *hreq, http_conn *conn)
+{
+    pj_status_t status;
+
+    status = http_req_start_on_conn(hreq, conn);
+    if (status != PJ_SUCCESS) {
+        hreq->error = status;
+        pj_http_req_cancel(hreq, PJ_TRUE);
     }
+}
+
+static pj_status_t start_http_req(pj_http_req *http_req,
+                                  pj_bool_t notify_on_fail)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(http_req, PJ_EINVAL);
+    /* Http request is not idle, a request was initiated before and 
+     * is still in progress
+     */
+    PJ_ASSERT_RETURN(http_req->state == IDLE, PJ_EBUSY);
+
+    /* Reset few things to make sure restarting works */
+    http_req->error = 0;
+    http_req->response.headers.count = 0;
+    http_req->chunked = PJ_FALSE;
+    http_req->keep_alive = PJ_FALSE;
+    pj_bzero(&http_req->tcp_state, sizeof(http_req->tcp_state));
 
-    /* Schedule timeout timer for the request */
+    /* Schedule timeout timer for the request. This also covers the time
+     * spent waiting for a pooled connection.
+     */
     pj_assert(http_req->timer_entry.id == 0);
     http_req->timer_entry.id = 1;
     status = pj_timer_heap_schedule(http_req->timer, &http_req->timer_entry, 
@@ -1099,19 +1508,25 @@ static pj_status_t start_http_req(pj_http_req *http_req,
         goto on_return; // error scheduling timer
     }
 
-    /* Connect to host */
-    http_req->state = CONNECTING;
-    status = pj_activesock_start_connect(http_req->asock, http_req->pool, 
-                                         (pj_sockaddr_t *)&(http_req->addr), 
-                                         pj_sockaddr_get_len(&http_req->addr));
-    if (status == PJ_SUCCESS) {
-        http_req->state = SENDING_REQUEST;
-        status =  http_req_start_sending(http_req);
-        if (status != PJ_SUCCESS)
+    if (http_req->param.conn_pool) {
+        http_conn *conn;
+
+        status = conn_pool_acquire(http_req, &conn);
+        if (status == PJ_EPENDING) {
+            /* All connections to the host are busy */
+            http_req->state = QUEUED;
+            return PJ_SUCCESS;
+        } else if (status != PJ_SUCCESS) {
             goto on_return;
-    } else if (status != PJ_EPENDING) {
-        goto on_return; // error connecting
+        }
+        status = http_req_start_on_conn(http_req, conn);
+    } else {
+        http_req->conn = &http_req->own_conn;
+        http_req->own_conn.hreq = http_req;
+        status = http_req_connect(http_req);
     }
+    if (status != PJ_SUCCESS)
+        goto on_return;
 
     return PJ_SUCCESS;
 
@@ -1561,6 +1976,13 @@ static pj_status_t http_req_start_sending(pj_http_req *hreq)
                          STR_PREC(hreq->param.headers.header[i].name),
                          STR_PREC(hreq->param.headers.header[i].value));
         }
+        /* HTTP/1.0 servers close the connection unless asked not to */
+        if (hreq->param.conn_pool &&
+            !pj_strcmp2(&hreq->param.version, HTTP_1_0))
+        {
+            str_snprintf(&pkt, BUF_SIZE, PJ_TRUE,
+                         "Connection: keep-alive\r\n");
+        }
         if (pkt.slen >= BUF_SIZE - 1) {
             status = PJLIB_UTIL_EHTTPINSBUF;
             goto on_return;
@@ -1597,6 +2019,7 @@ on_return:
 
 static pj_status_t http_req_start_reading(pj_http_req *hreq)
 {
+    http_conn *conn = hreq->conn;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(hreq->state == REQUEST_SENT, PJ_EBUG);
@@ -1604,23 +2027,46 @@ static pj_status_t http_req_start_reading(pj_http_req *hreq)
     /* Receive the response */
     hreq->state = READING_RESPONSE;
     hreq->tcp_state.current_read_size = 0;
-    pj_assert(hreq->buffer.ptr);
-    status = pj_activesock_start_read2(hreq->asock, hreq->pool, BUF_SIZE, 
-                                       (void**)&hreq->buffer.ptr, 0);
+
+    /* A reused connection is reading already */
+    if (conn->reading)
+        return PJ_SUCCESS;
+
+    /* Not pooled, the buffer is shared with the request */
+    if (!conn->cpool)
+        conn->rbuf = hreq->buffer.ptr;
+    pj_assert(conn->rbuf);
+    status = pj_activesock_start_read2(hreq->asock, conn->pool, BUF_SIZE, 
+                                       &conn->rbuf, 0);
     if (status != PJ_SUCCESS) {
         /* Error reading */
         http_req_end_request(hreq);
         return status;
     }
+    conn->reading = PJ_TRUE;
 
     return PJ_SUCCESS;
 }
 
 static pj_status_t http_req_end_request(pj_http_req *hreq)
 {
-    if (hreq->asock) {
-        pj_activesock_close(hreq->asock);
+    if (hreq->conn) {
+        http_conn *conn = hreq->conn;
+
+        hreq->conn = NULL;
         hreq->asock = NULL;
+        conn->hreq = NULL;
+
+        /* Keep the connection if the response has been read completely
+         * and the server allows it.
+         */
+        if (hreq->state == READING_COMPLETE && hreq->keep_alive)
+            conn_pool_release(conn);
+        else
+            http_conn_destroy(conn);
+    } else if (hreq->param.conn_pool) {
+        /* May be waiting for a connection */
+        conn_pool_dequeue(hreq);
     }
 
     /* Cancel query timeout timer. */
@@ -1664,3 +2110,335 @@ PJ_DEF(pj_status_t) pj_http_req_destroy(pj_http_req *http_req)
 
     return PJ_SUCCESS;
 }
+
+
+/*
+ * Connection pool.
+ */
+
+/* Find the entry of the request's scheme, host and port, creating it if
+ * not found. Must be called with the pool's lock held.
+ */
+static conn_host *conn_pool_get_host(pj_http_conn_pool *cpool,
+                                     const pj_http_req *hreq)
+{
+    const char *protocol = get_protocol(&hreq->hurl.protocol);
+    conn_host *host;
+
+    for (host = cpool->host_list.next; host != &cpool->host_list;
+         host = host->next)
+    {
+        if (host->protocol == protocol && host->port == hreq->hurl.port &&
+            !pj_stricmp(&host->host, &hreq->hurl.host))
+        {
+            return host;
+        }
+    }
+
+    host = PJ_POOL_ZALLOC_T(cpool->pool, conn_host);
+    host->protocol = protocol;
+    pj_strdup(cpool->pool, &host->host, &hreq->hurl.host);
+    host->port = hreq->hurl.port;
+    pj_list_init(&host->idle_list);
+    pj_list_init(&host->pending);
+    pj_list_push_back(&cpool->host_list, host);
+
+    return host;
+}
+
+/* Pop the oldest request waiting for a connection to the host. Must be
+ * called with the pool's lock held.
+ */
+static pj_http_req *conn_host_pop_pending(pj_http_conn_pool *cpool,
+                                          conn_host *host)
+{
+    http_queue_node *node;
+
+    if (pj_list_empty(&host->pending))
+        return NULL;
+
+    node = host->pending.next;
+    pj_list_erase(node);
+    pj_list_init(node);
+    --cpool->stat.queued;
+
+    return node->hreq;
+}
+
+static void conn_on_idle_timeout(pj_timer_heap_t *timer_heap,
+                                 struct pj_timer_entry *entry)
+{
+    http_conn *conn = (http_conn*) entry->user_data;
+
+    PJ_UNUSED_ARG(timer_heap);
+
+    if (conn_pool_remove_idle(conn))
+        http_conn_destroy(conn);
+}
+
+/* Create a connection, not yet connected. Must be called with the pool's
+ * lock held.
+ */
+static pj_status_t http_conn_create(pj_http_conn_pool *cpool,
+                                    conn_host *host,
+                                    http_conn **p_conn)
+{
+    pj_pool_t *pool;
+    http_conn *conn;
+
+    pool = pj_pool_create(cpool->pool->factory, "httpc%p",
+                          BUF_SIZE + INITIAL_POOL_SIZE, POOL_INCREMENT_SIZE,
+                          NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    conn = PJ_POOL_ZALLOC_T(pool, http_conn);
+    conn->cpool = cpool;
+    conn->host = host;
+    conn->pool = pool;
+    conn->rbuf = pj_pool_alloc(pool, BUF_SIZE);
+    pj_timer_entry_init(&conn->idle_timer, 0, conn, &conn_on_idle_timeout);
+
+    ++host->conn_cnt;
+    ++cpool->stat.created;
+
+    *p_conn = conn;
+    return PJ_SUCCESS;
+}
+
+static void http_conn_destroy(http_conn *conn)
+{
+    pj_http_conn_pool *cpool = conn->cpool;
+    pj_http_req *next = NULL;
+    http_conn *new_conn = NULL;
+
+    if (conn->asock) {
+        pj_activesock_close(conn->asock);
+        conn->asock = NULL;
+    }
+    conn->reading = PJ_FALSE;
+
+    /* Connection is owned by the request */
+    if (!cpool)
+        return;
+
+    pj_timer_heap_cancel_if_active(cpool->timer, &conn->idle_timer, 0);
+
+    pj_lock_acquire(cpool->lock);
+    --conn->host->conn_cnt;
+    /* Give the free slot to a request waiting for it */
+    if (!pj_list_empty(&conn->host->pending) &&
+        http_conn_create(cpool, conn->host, &new_conn) == PJ_SUCCESS)
+    {
+        next = conn_host_pop_pending(cpool, conn->host);
+        new_conn->hreq = next;
+    }
+    pj_lock_release(cpool->lock);
+
+    /* The read callback is still using the connection, it will release
+     * the pool when it returns.
+     */
+    if (conn->in_cb)
+        conn->closed = PJ_TRUE;
+    else
+        pj_pool_release(conn->pool);
+
+    if (next)
+        http_req_resume(next, new_conn);
+}
+
+static pj_status_t conn_pool_acquire(pj_http_req *hreq, http_conn **p_conn)
+{
+    pj_http_conn_pool *cpool = hreq->param.conn_pool;
+    conn_host *host;
+    http_conn *conn = NULL;
+    pj_status_t status = PJ_SUCCESS;
+
+    pj_lock_acquire(cpool->lock);
+
+    host = conn_pool_get_host(cpool, hreq);
+    if (!pj_list_empty(&host->idle_list)) {
+        /* Take the most recently used connection */
+        conn = host->idle_list.next;
+        pj_list_erase(conn);
+        conn->next = conn->prev = NULL;
+        --cpool->stat.idle;
+        ++cpool->stat.reused;
+        pj_timer_heap_cancel_if_active(cpool->timer, &conn->idle_timer, 0);
+    } else if (host->conn_cnt < cpool->param.max_conn_per_host) {
+        status = http_conn_create(cpool, host, &conn);
+    } else {
+        pj_list_push_back(&host->pending, &hreq->queue_node);
+        ++cpool->stat.queued;
+        status = PJ_EPENDING;
+    }
+    if (conn)
+        conn->hreq = hreq;
+
+    pj_lock_release(cpool->lock);
+
+    *p_conn = conn;
+    return status;
+}
+
+static void conn_pool_release(http_conn *conn)
+{
+    pj_http_conn_pool *cpool = conn->cpool;
+    pj_http_req *next;
+    pj_bool_t keep = PJ_TRUE;
+
+    pj_lock_acquire(cpool->lock);
+
+    next = conn_host_pop_pending(cpool, conn->host);
+    if (next) {
+        /* Hand the connection to the oldest waiting request */
+        conn->hreq = next;
+        ++cpool->stat.reused;
+    } else if (cpool->stat.idle < cpool->param.max_idle) {
+        pj_list_push_front(&conn->host->idle_list, conn);
+        ++cpool->stat.idle;
+        pj_timer_heap_schedule(cpool->timer, &conn->idle_timer,
+                               &cpool->param.idle_timeout);
+    } else {
+        keep = PJ_FALSE;
+    }
+
+    pj_lock_release(cpool->lock);
+
+    if (!keep)
+        http_conn_destroy(conn);
+    else if (next)
+        http_req_resume(next, conn);
+}
+
+static pj_bool_t conn_pool_remove_idle(http_conn *conn)
+{
+    pj_http_conn_pool *cpool = conn->cpool;
+    pj_bool_t removed = PJ_FALSE;
+
+    pj_lock_acquire(cpool->lock);
+    if (conn->next) {
+        pj_list_erase(conn);
+        conn->next = conn->prev = NULL;
+        --cpool->stat.idle;
+        removed = PJ_TRUE;
+    }
+    pj_lock_release(cpool->lock);
+
+    return removed;
+}
+
+static void conn_pool_dequeue(pj_http_req *hreq)
+{
+    pj_http_conn_pool *cpool = hreq->param.conn_pool;
+
+    pj_lock_acquire(cpool->lock);
+    if (!pj_list_empty(&hreq->queue_node)) {
+        pj_list_erase(&hreq->queue_node);
+        pj_list_init(&hreq->queue_node);
+        --cpool->stat.queued;
+    }
+    pj_lock_release(cpool->lock);
+}
+
+PJ_DEF(void) pj_http_conn_pool_param_default(pj_http_conn_pool_param *param)
+{
+    pj_assert(param);
+    pj_bzero(param, sizeof(*param));
+    param->max_conn_per_host = PJ_HTTP_POOL_MAX_CONN_PER_HOST;
+    param->max_idle = PJ_HTTP_POOL_MAX_IDLE;
+    param->idle_timeout.msec = PJ_HTTP_POOL_IDLE_TIMEOUT;
+    pj_time_val_normalize(&param->idle_timeout);
+}
+
+PJ_DEF(pj_status_t) pj_http_conn_pool_create(
+                                    pj_pool_t *pool,
+                                    pj_timer_heap_t *timer,
+                                    pj_ioqueue_t *ioqueue,
+                                    const pj_http_conn_pool_param *param,
+                                    pj_http_conn_pool **p_cpool)
+{
+    pj_pool_t *own_pool;
+    pj_http_conn_pool *cpool;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && timer && ioqueue && p_cpool, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!param || param->max_conn_per_host > 0, PJ_EINVAL);
+
+    own_pool = pj_pool_create(pool->factory, "httpcp%p", INITIAL_POOL_SIZE,
+                              POOL_INCREMENT_SIZE, NULL);
+    if (!own_pool)
+        return PJ_ENOMEM;
+
+    cpool = PJ_POOL_ZALLOC_T(own_pool, pj_http_conn_pool);
+    cpool->pool = own_pool;
+    cpool->timer = timer;
+    cpool->ioqueue = ioqueue;
+    if (param) {
+        pj_memcpy(&cpool->param, param, sizeof(*param));
+        pj_time_val_normalize(&cpool->param.idle_timeout);
+    } else {
+        pj_http_conn_pool_param_default(&cpool->param);
+    }
+    pj_list_init(&cpool->host_list);
+
+    status = pj_lock_create_recursive_mutex(own_pool, own_pool->obj_name,
+                                            &cpool->lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(own_pool);
+        return status;
+    }
+
+    *p_cpool = cpool;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_http_conn_pool_get_stat(pj_http_conn_pool *cpool,
+                                        pj_http_conn_pool_stat *stat)
+{
+    pj_assert(cpool && stat);
+
+    pj_lock_acquire(cpool->lock);
+    pj_memcpy(stat, &cpool->stat, sizeof(*stat));
+    pj_lock_release(cpool->lock);
+}
+
+PJ_DEF(pj_status_t) pj_http_conn_pool_destroy(pj_http_conn_pool *cpool)
+{
+    conn_host *host;
+
+    PJ_ASSERT_RETURN(cpool, PJ_EINVAL);
+
+    pj_lock_acquire(cpool->lock);
+
+    /* All connections must be idle */
+    for (host = cpool->host_list.next; host != &cpool->host_list;
+         host = host->next)
+    {
+        if (!pj_list_empty(&host->pending) ||
+            host->conn_cnt != pj_list_size(&host->idle_list))
+        {
+            pj_lock_release(cpool->lock);
+            return PJ_EBUSY;
+        }
+    }
+
+    for (host = cpool->host_list.next; host != &cpool->host_list;
+         host = host->next)
+    {
+        while (!pj_list_empty(&host->idle_list)) {
+            http_conn *conn = host->idle_list.next;
+
+            pj_list_erase(conn);
+            conn->next = conn->prev = NULL;
+            --cpool->stat.idle;
+            http_conn_destroy(conn);
+        }
+    }
+
+    pj_lock_release(cpool->lock);
+    pj_lock_destroy(cpool->lock);
+    pj_pool_release(cpool->pool);
+
+    return PJ_SUCCESS;
+}
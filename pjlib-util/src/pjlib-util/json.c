@@ -17,10 +17,8 @@
  */
 #include <pjlib-util/json.h>
 #include <pjlib-util/errno.h>
-#include <pjlib-util/scanner.h>
 #include <pj/assert.h>
 #include <pj/ctype.h>
-#include <pj/except.h>
 #include <pj/string.h>
 
 #define EL_INIT(p_el, nm, typ)  do { \
@@ -33,17 +31,6 @@
                                     p_el->type = typ; \
                                 } while (0)
 
-struct write_state;
-struct parse_state;
-
-#define NO_NAME 1
-
-static pj_status_t elem_write(const pj_json_elem *elem,
-                              struct write_state *st,
-                              unsigned flags);
-static pj_json_elem* parse_elem_throw(struct parse_state *st,
-                                      pj_json_elem *elem);
-
 
 PJ_DEF(void) pj_json_elem_null(pj_json_elem *el, pj_str_t *name)
 {
@@ -89,209 +76,284 @@ PJ_DEF(void) pj_json_elem_add(pj_json_elem *el, pj_json_elem *child)
     pj_list_push_back(&el->value.children, child);
 }
 
-struct parse_state
-{
-    pj_pool_t           *pool;
-    pj_scanner           scanner;
-    pj_json_err_info    *err_info;
-    pj_cis_t             float_spec;    /* numbers with dot! */
-};
+#define IS_WS(c)        ((c)==' ' || (c)=='\t' || (c)=='\r' || (c)=='\n')
+#define IS_NUM(c)       (pj_isdigit(c) || (c)=='.')
 
-static pj_status_t parse_children(struct parse_state *st,
-                                  pj_json_elem *parent)
+PJ_DEF(void) pj_json_reader_init(pj_json_reader *rd,
+                                 char *buffer,
+                                 unsigned size)
 {
-    char end_quote = (parent->type == PJ_JSON_VAL_ARRAY)? ']' : '}';
-
-    pj_scan_get_char(&st->scanner);
-
-    while (*st->scanner.curptr != end_quote) {
-        pj_json_elem *child;
-
-        while (*st->scanner.curptr == ',')
-            pj_scan_get_char(&st->scanner);
-
-        if (*st->scanner.curptr == end_quote)
-            break;
+    pj_bzero(rd, sizeof(*rd));
+    rd->start = rd->cur = buffer;
+    rd->end = buffer + size;
+}
 
-        child = parse_elem_throw(st, NULL);
-        if (!child)
-            return PJLIB_UTIL_EINJSON;
+PJ_DEF(unsigned) pj_json_reader_depth(const pj_json_reader *rd)
+{
+    return rd->depth;
+}
 
-        pj_json_elem_add(parent, child);
-    }
+static pj_status_t reader_error(pj_json_reader *rd, char *pos)
+{
+    rd->err_pos = pos;
+    rd->cur = pos;
+    return PJLIB_UTIL_EINJSON;
+}
 
-    pj_scan_get_char(&st->scanner);
-    return PJ_SUCCESS;
+static void skip_ws(pj_json_reader *rd)
+{
+    while (rd->cur != rd->end && IS_WS(*rd->cur))
+        ++rd->cur;
 }
 
-/* Return 0 if success or the index of the invalid char in the string */
-static unsigned parse_quoted_string(struct parse_state *st,
-                                    pj_str_t *output)
+/* Read quoted string at rd->cur. Escape sequences are decoded in place,
+ * which is always possible since the decoded string is never longer than
+ * its escaped form. If the reader has a pool, strings with escape
+ * sequences are decoded to the pool instead, leaving the buffer untouched.
+ * Strings without escape sequences always refer to the buffer.
+ */
+static pj_status_t read_quoted_string(pj_json_reader *rd, pj_str_t *output)
 {
-    pj_str_t token;
-    char *op, *ip, *iend;
+    char *start = rd->cur + 1;
+    char *ip = start;
+    char *op;
+    pj_bool_t has_esc = PJ_FALSE;
 
-    pj_scan_get_quote(&st->scanner, '"', '"', &token);
+    while (ip != rd->end && *ip != '"') {
+        if (*ip == '\\') {
+            has_esc = PJ_TRUE;
+            if (++ip == rd->end)
+                break;
+        }
+        ++ip;
+    }
+    if (ip == rd->end)
+        return reader_error(rd, rd->cur);
 
-    /* Remove the quote characters */
-    token.ptr++;
-    token.slen-=2;
+    rd->cur = ip + 1;
 
-    if (pj_strchr(&token, '\\') == NULL) {
-        *output = token;
-        return 0;
+    if (!has_esc) {
+        pj_strset(output, start, ip - start);
+        return PJ_SUCCESS;
     }
 
-    output->ptr = op = pj_pool_alloc(st->pool, token.slen);
+    if (rd->pool)
+        op = (char*) pj_pool_alloc(rd->pool, ip - start);
+    else
+        op = start;
+    output->ptr = op;
+    for (ip = start; *ip != '"'; ) {
+        if (*ip != '\\') {
+            *op++ = *ip++;
+            continue;
+        }
 
-    ip = token.ptr;
-    iend = token.ptr + token.slen;
+        ++ip;
+        if (*ip == 'u') {
+            ip++;
+            if (rd->cur - 1 - ip < 4)
+                return reader_error(rd, ip);
+            /* Only use the last two hext digits because we're on
+             * ASCII */
+            *op++ = (char)(pj_hex_digit_to_val(ip[2]) * 16 +
+                           pj_hex_digit_to_val(ip[3]));
+            ip += 4;
+            continue;
+        }
 
-    while (ip != iend) {
-        if (*ip == '\\') {
-            ++ip;
-            if (ip==iend) {
-                goto on_error;
-            }
-            if (*ip == 'u') {
-                ip++;
-                if (iend - ip < 4) {
-                    ip = iend -1;
-                    goto on_error;
-                }
-                /* Only use the last two hext digits because we're on
-                 * ASCII */
-                *op++ = (char)(pj_hex_digit_to_val(ip[2]) * 16 +
-                               pj_hex_digit_to_val(ip[3]));
-                ip += 4;
-            } else if (*ip=='"' || *ip=='\\' || *ip=='/') {
-                *op++ = *ip++;
-            } else if (*ip=='b') {
-                *op++ = '\b';
-                ip++;
-            } else if (*ip=='f') {
-                *op++ = '\f';
-                ip++;
-            } else if (*ip=='n') {
-                *op++ = '\n';
-                ip++;
-            } else if (*ip=='r') {
-                *op++ = '\r';
-                ip++;
-            } else if (*ip=='t') {
-                *op++ = '\t';
-                ip++;
-            } else {
-                goto on_error;
-            }
-        } else {
-            *op++ = *ip++;
+        switch (*ip) {
+        case '"':
+        case '\\':
+        case '/':
+            *op = *ip;
+            break;
+        case 'b':
+            *op = '\b';
+            break;
+        case 'f':
+            *op = '\f';
+            break;
+        case 'n':
+            *op = '\n';
+            break;
+        case 'r':
+            *op = '\r';
+            break;
+        case 't':
+            *op = '\t';
+            break;
+        default:
+            return reader_error(rd, ip);
         }
+        ++op;
+        ++ip;
     }
 
     output->slen = op - output->ptr;
-    return 0;
-
-on_error:
-    output->slen = op - output->ptr;
-    return (unsigned)(ip - token.ptr);
+    return PJ_SUCCESS;
 }
 
-static pj_json_elem* parse_elem_throw(struct parse_state *st,
-                                      pj_json_elem *elem)
+PJ_DEF(pj_status_t) pj_json_reader_next(pj_json_reader *rd,
+                                        pj_json_token *tok)
 {
-    pj_str_t name = {NULL, 0}, value = {NULL, 0};
-    pj_str_t token;
+    pj_status_t status;
+    char c;
+
+    PJ_ASSERT_RETURN(rd && tok, PJ_EINVAL);
+
+    if (rd->err_pos)
+        return PJLIB_UTIL_EINJSON;
 
-    if (!elem)
-        elem = pj_pool_alloc(st->pool, sizeof(*elem));
+    skip_ws(rd);
+
+    if (rd->depth) {
+        /* Be lenient with superfluous commas, like trailing comma
+         * after the last element.
+         */
+        while (rd->cur != rd->end && (*rd->cur == ',' || IS_WS(*rd->cur)))
+            ++rd->cur;
+
+        if (rd->cur == rd->end)
+            return reader_error(rd, rd->cur);
+
+        if (*rd->cur == rd->nest[rd->depth-1]) {
+            tok->type = (*rd->cur == ']') ? PJ_JSON_TOKEN_ARRAY_END :
+                                            PJ_JSON_TOKEN_OBJ_END;
+            tok->name.ptr = (char*)"";
+            tok->name.slen = 0;
+            ++rd->cur;
+            if (--rd->depth == 0)
+                rd->done = PJ_TRUE;
+            return PJ_SUCCESS;
+        }
+    } else if (rd->done || rd->cur == rd->end) {
+        return rd->done ? PJ_EEOF : reader_error(rd, rd->cur);
+    }
+
+    tok->name.ptr = (char*)"";
+    tok->name.slen = 0;
 
     /* Parse name */
-    if (*st->scanner.curptr == '"') {
-        pj_scan_get_char(&st->scanner);
-        pj_scan_get_until_ch(&st->scanner, '"', &token);
-        pj_scan_get_char(&st->scanner);
-
-        if (*st->scanner.curptr == ':') {
-            pj_scan_get_char(&st->scanner);
-            name = token;
+    if (*rd->cur == '"') {
+        pj_str_t token;
+
+        status = read_quoted_string(rd, &token);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        skip_ws(rd);
+        if (rd->cur != rd->end && *rd->cur == ':') {
+            ++rd->cur;
+            skip_ws(rd);
+            tok->name = token;
         } else {
-            value = token;
+            /* Element with string value and no name */
+            tok->type = PJ_JSON_TOKEN_STRING;
+            tok->str = token;
+            goto on_value;
         }
     }
 
-    if (value.slen) {
-        /* Element with string value and no name */
-        pj_json_elem_string(elem, &name, &value);
-        return elem;
-    }
+    if (rd->cur == rd->end)
+        return reader_error(rd, rd->cur);
 
     /* Parse value */
-    if (pj_cis_match(&st->float_spec, *st->scanner.curptr) ||
-        *st->scanner.curptr == '-')
-    {
-        float val;
-        pj_bool_t neg = PJ_FALSE;
-
-        if (*st->scanner.curptr == '-') {
-            pj_scan_get_char(&st->scanner);
-            neg = PJ_TRUE;
+    c = *rd->cur;
+    if (IS_NUM(c) || c == '-') {
+        char *start = rd->cur;
+        pj_str_t num;
+
+        if (c == '-')
+            ++rd->cur;
+        num.ptr = rd->cur;
+        while (rd->cur != rd->end && IS_NUM(*rd->cur))
+            ++rd->cur;
+        num.slen = rd->cur - num.ptr;
+        if (num.slen == 0)
+            return reader_error(rd, rd->cur);
+
+        tok->type = PJ_JSON_TOKEN_NUMBER;
+        tok->num = pj_strtof(&num);
+        if (c == '-') tok->num = -tok->num;
+        pj_strset(&tok->str, start, rd->cur - start);
+
+    } else if (c == '"') {
+        tok->type = PJ_JSON_TOKEN_STRING;
+        status = read_quoted_string(rd, &tok->str);
+        if (status != PJ_SUCCESS)
+            return status;
+
+    } else if (pj_isalpha(c)) {
+        unsigned avail = (unsigned)(rd->end - rd->cur);
+
+        if (avail >= 5 && pj_memcmp(rd->cur, "false", 5)==0) {
+            tok->type = PJ_JSON_TOKEN_BOOL;
+            tok->is_true = PJ_FALSE;
+            rd->cur += 5;
+        } else if (avail >= 4 && pj_memcmp(rd->cur, "true", 4)==0) {
+            tok->type = PJ_JSON_TOKEN_BOOL;
+            tok->is_true = PJ_TRUE;
+            rd->cur += 4;
+        } else if (avail >= 4 && pj_memcmp(rd->cur, "null", 4)==0) {
+            tok->type = PJ_JSON_TOKEN_NULL;
+            rd->cur += 4;
+        } else {
+            return reader_error(rd, rd->cur);
         }
 
-        pj_scan_get(&st->scanner, &st->float_spec, &token);
-        val = pj_strtof(&token);
-        if (neg) val = -val;
-
-        pj_json_elem_number(elem, &name, val);
-
-    } else if (*st->scanner.curptr == '"') {
-        unsigned err;
-        char *start = st->scanner.curptr;
+    } else if (c == '[' || c == '{') {
+        if (rd->depth == PJ_JSON_MAX_DEPTH)
+            return reader_error(rd, rd->cur);
 
-        err = parse_quoted_string(st, &token);
-        if (err) {
-            st->scanner.curptr = start + err;
-            return NULL;
-        }
-
-        pj_json_elem_string(elem, &name, &token);
+        tok->type = (c == '[') ? PJ_JSON_TOKEN_ARRAY_START :
+                                 PJ_JSON_TOKEN_OBJ_START;
+        rd->nest[rd->depth++] = (c == '[') ? ']' : '}';
+        ++rd->cur;
+        return PJ_SUCCESS;
 
-    } else if (pj_isalpha(*st->scanner.curptr)) {
+    } else {
+        return reader_error(rd, rd->cur);
+    }
 
-        if (pj_scan_strcmp(&st->scanner, "false", 5)==0) {
-            pj_json_elem_bool(elem, &name, PJ_FALSE);
-            pj_scan_advance_n(&st->scanner, 5, PJ_TRUE);
-        } else if (pj_scan_strcmp(&st->scanner, "true", 4)==0) {
-            pj_json_elem_bool(elem, &name, PJ_TRUE);
-            pj_scan_advance_n(&st->scanner, 4, PJ_TRUE);
-        } else if (pj_scan_strcmp(&st->scanner, "null", 4)==0) {
-            pj_json_elem_null(elem, &name);
-            pj_scan_advance_n(&st->scanner, 4, PJ_TRUE);
-        } else {
-            return NULL;
-        }
+on_value:
+    if (rd->depth == 0)
+        rd->done = PJ_TRUE;
+    return PJ_SUCCESS;
+}
 
-    } else if (*st->scanner.curptr == '[') {
-        pj_json_elem_array(elem, &name);
-        if (parse_children(st, elem) != PJ_SUCCESS)
-            return NULL;
+PJ_DEF(pj_status_t) pj_json_reader_skip(pj_json_reader *rd)
+{
+    unsigned depth;
+    pj_json_token tok;
 
-    } else if (*st->scanner.curptr == '{') {
-        pj_json_elem_obj(elem, &name);
-        if (parse_children(st, elem) != PJ_SUCCESS)
-            return NULL;
+    PJ_ASSERT_RETURN(rd && rd->depth, PJ_EINVALIDOP);
 
-    } else {
-        return NULL;
+    depth = rd->depth;
+    while (rd->depth >= depth) {
+        pj_status_t status = pj_json_reader_next(rd, &tok);
+        if (status != PJ_SUCCESS)
+            return status;
     }
 
-    return elem;
+    return PJ_SUCCESS;
 }
 
-static void on_syntax_error(pj_scanner *scanner)
+PJ_DEF(void) pj_json_reader_get_err_info(const pj_json_reader *rd,
+                                         pj_json_err_info *err_info)
 {
-    PJ_UNUSED_ARG(scanner);
-    PJ_THROW(11);
+    const char *pos = rd->err_pos ? rd->err_pos : rd->cur;
+    const char *line_start = rd->start;
+    const char *p;
+
+    err_info->line = 1;
+    for (p = rd->start; p != pos; ++p) {
+        if (*p == '\n') {
+            ++err_info->line;
+            line_start = p + 1;
+        }
+    }
+    err_info->col = (unsigned)(pos - line_start) + 1;
+    err_info->err_char = (pos != rd->end) ? *pos : 0;
 }
 
 PJ_DEF(pj_json_elem*) pj_json_parse(pj_pool_t *pool,
@@ -299,43 +361,78 @@ PJ_DEF(pj_json_elem*) pj_json_parse(pj_pool_t *pool,
                                     unsigned *size,
                                     pj_json_err_info *err_info)
 {
-    pj_cis_buf_t cis_buf;
-    struct parse_state st;
-    pj_json_elem *root;
-    PJ_USE_EXCEPTION;
+    pj_json_reader rd;
+    pj_json_token tok;
+    pj_json_elem *stack[PJ_JSON_MAX_DEPTH];
+    pj_json_elem *root = NULL;
+    pj_status_t status;
 
     PJ_ASSERT_RETURN(pool && buffer && size, NULL);
 
     if (!*size)
         return NULL;
 
-    pj_bzero(&st, sizeof(st));
-    st.pool = pool;
-    st.err_info = err_info;
-    pj_scan_init(&st.scanner, buffer, *size,
-                 PJ_SCAN_AUTOSKIP_WS | PJ_SCAN_AUTOSKIP_NEWLINE,
-                 &on_syntax_error);
-    pj_cis_buf_init(&cis_buf);
-    pj_cis_init(&cis_buf, &st.float_spec);
-    pj_cis_add_str(&st.float_spec, ".0123456789");
-
-    PJ_TRY {
-        root = parse_elem_throw(&st, NULL);
-    }
-    PJ_CATCH_ANY {
-        root = NULL;
-    }
-    PJ_END
+    pj_json_reader_init(&rd, buffer, *size);
+    rd.pool = pool;
 
-    if (!root && err_info) {
-        err_info->line = st.scanner.line;
-        err_info->col = pj_scan_get_col(&st.scanner) + 1;
-        err_info->err_char = *st.scanner.curptr;
+    while ((status=pj_json_reader_next(&rd, &tok)) == PJ_SUCCESS) {
+        pj_json_elem *elem;
+
+        if (tok.type == PJ_JSON_TOKEN_ARRAY_END ||
+            tok.type == PJ_JSON_TOKEN_OBJ_END)
+        {
+            if (rd.depth == 0)
+                break;
+            continue;
+        }
+
+        elem = PJ_POOL_ALLOC_T(pool, pj_json_elem);
+
+        switch (tok.type) {
+        case PJ_JSON_TOKEN_NULL:
+            pj_json_elem_null(elem, &tok.name);
+            break;
+        case PJ_JSON_TOKEN_BOOL:
+            pj_json_elem_bool(elem, &tok.name, tok.is_true);
+            break;
+        case PJ_JSON_TOKEN_NUMBER:
+            pj_json_elem_number(elem, &tok.name, tok.num);
+            break;
+        case PJ_JSON_TOKEN_STRING:
+            pj_json_elem_string(elem, &tok.name, &tok.str);
+            break;
+        case PJ_JSON_TOKEN_ARRAY_START:
+            pj_json_elem_array(elem, &tok.name);
+            break;
+        default:
+            pj_json_elem_obj(elem, &tok.name);
+            break;
+        }
+
+        if (tok.type == PJ_JSON_TOKEN_ARRAY_START ||
+            tok.type == PJ_JSON_TOKEN_OBJ_START)
+        {
+            if (rd.depth > 1)
+                pj_json_elem_add(stack[rd.depth-2], elem);
+            else
+                root = elem;
+            stack[rd.depth-1] = elem;
+        } else if (rd.depth) {
+            pj_json_elem_add(stack[rd.depth-1], elem);
+        } else {
+            root = elem;
+            break;
+        }
     }
 
-    *size = (unsigned)((buffer + *size) - st.scanner.curptr);
+    if (status != PJ_SUCCESS) {
+        root = NULL;
+        if (err_info)
+            pj_json_reader_get_err_info(&rd, err_info);
+    }
 
-    pj_scan_fini(&st.scanner);
+    skip_ws(&rd);
+    *size = (unsigned)(rd.end - rd.cur);
 
     return root;
 }
@@ -365,6 +462,7 @@ PJ_DEF(pj_status_t) pj_json_write(const pj_json_elem *elem,
                                   char *buffer, unsigned *size)
 {
     struct buf_writer_data buf_data;
+    pj_json_stream_writer sw;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(elem && buffer && size, PJ_EINVAL);
@@ -372,7 +470,9 @@ PJ_DEF(pj_status_t) pj_json_write(const pj_json_elem *elem,
     buf_data.pos = buffer;
     buf_data.size = *size;
 
-    status = pj_json_writef(elem, &buf_writer, &buf_data);
+    /* No need for intermediate buffer since we're writing to memory */
+    pj_json_sw_init(&sw, NULL, 0, &buf_writer, &buf_data);
+    status = pj_json_sw_elem(&sw, elem);
     if (status != PJ_SUCCESS)
         return status;
 
@@ -385,219 +485,325 @@ PJ_DEF(pj_status_t) pj_json_write(const pj_json_elem *elem,
 #ifndef PJ_JSON_NAME_MIN_LEN
 #  define PJ_JSON_NAME_MIN_LEN  20
 #endif
-#define ESC_BUF_LEN             64
 #ifndef PJ_JSON_INDENT_SIZE
 #  define PJ_JSON_INDENT_SIZE   3
 #endif
 
-struct write_state
+/* Stream writer state flags, for each nesting level */
+enum sw_state
 {
-    pj_json_writer       writer;
-    void                *user_data;
-    char                 indent_buf[MAX_INDENT];
-    int                  indent;
-    char                 space[PJ_JSON_NAME_MIN_LEN];
+    SW_ARRAY        = 1,    /* Level is an array                        */
+    SW_HAS_CHILD    = 2,    /* At least one child has been written      */
+    SW_MULTILINE    = 4,    /* Children are written one per line        */
+    SW_INDENTED     = 8     /* Indentation was added for this level     */
 };
 
+static const char indent_buf[MAX_INDENT] =
+    "                                                  "
+    "                                                  ";
+
 #define CHECK(expr) do { \
                         status=expr; if (status!=PJ_SUCCESS) return status; } \
                     while (0)
 
-static pj_status_t write_string_escaped(const pj_str_t *value,
-                                        struct write_state *st)
+static pj_status_t sw_put(pj_json_stream_writer *sw,
+                          const char *s, unsigned len)
+{
+    if (sw->status != PJ_SUCCESS || len == 0)
+        return sw->status;
+
+    if (sw->len + len > sw->size) {
+        if (sw->len) {
+            sw->status = sw->writer(sw->buf, sw->len, sw->user_data);
+            sw->len = 0;
+            if (sw->status != PJ_SUCCESS)
+                return sw->status;
+        }
+        if (len > sw->size) {
+            sw->status = sw->writer(s, len, sw->user_data);
+            return sw->status;
+        }
+    }
+
+    pj_memcpy(sw->buf + sw->len, s, len);
+    sw->len += len;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t write_string_escaped(pj_json_stream_writer *sw,
+                                        const pj_str_t *value)
 {
     const char *ip = value->ptr;
     const char *iend = value->ptr + value->slen;
-    char buf[ESC_BUF_LEN];
-    char *op = buf;
-    char *oend = buf + ESC_BUF_LEN;
     pj_status_t status;
 
     while (ip != iend) {
-        /* Write to buffer to speedup writing instead of calling
-         * the callback one by one for each character.
-         */
-        while (ip != iend && op != oend) {
-            if (oend - op < 2)
-                break;
+        const char *run = ip;
+        char esc[6];
+        unsigned esc_len = 2;
 
-            if (*ip == '"') {
-                *op++ = '\\';
-                *op++ = '"';
-                ip++;
-            } else if (*ip == '\\') {
-                *op++ = '\\';
-                *op++ = '\\';
-                ip++;
-            } else if (*ip == '/') {
-                *op++ = '\\';
-                *op++ = '/';
-                ip++;
-            } else if (*ip == '\b') {
-                *op++ = '\\';
-                *op++ = 'b';
-                ip++;
-            } else if (*ip == '\f') {
-                *op++ = '\\';
-                *op++ = 'f';
-                ip++;
-            } else if (*ip == '\n') {
-                *op++ = '\\';
-                *op++ = 'n';
-                ip++;
-            } else if (*ip == '\r') {
-                *op++ = '\\';
-                *op++ = 'r';
-                ip++;
-            } else if (*ip == '\t') {
-                *op++ = '\\';
-                *op++ = 't';
-                ip++;
-            } else if ((*ip >= 32 && *ip < 127)) {
-                /* unescaped */
-                *op++ = *ip++;
-            } else {
-                /* escaped */
-                if (oend - op < 6)
-                    break;
-                *op++ = '\\';
-                *op++ = 'u';
-                *op++ = '0';
-                *op++ = '0';
-                pj_val_to_hex_digit(*ip, op);
-                op+=2;
-                ip++;
-            }
+        /* Write unescaped characters in one go */
+        while (ip != iend && *ip >= 32 && *ip < 127 &&
+               *ip != '"' && *ip != '\\' && *ip != '/')
+        {
+            ++ip;
         }
+        CHECK( sw_put(sw, run, (unsigned)(ip - run)) );
+
+        if (ip == iend)
+            break;
 
-        CHECK( st->writer( buf, (unsigned)(op-buf), st->user_data) );
-        op = buf;
+        esc[0] = '\\';
+        switch (*ip) {
+        case '"':
+        case '\\':
+        case '/':
+            esc[1] = *ip;
+            break;
+        case '\b':
+            esc[1] = 'b';
+            break;
+        case '\f':
+            esc[1] = 'f';
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            pj_val_to_hex_digit(*ip, &esc[4]);
+            esc_len = 6;
+            break;
+        }
+        CHECK( sw_put(sw, esc, esc_len) );
+        ++ip;
     }
 
     return PJ_SUCCESS;
 }
 
-static pj_status_t write_children(const pj_json_list *list,
-                                  const char quotes[2],
-                                  struct write_state *st)
+/* Write the separator and name preceding an element. The layout is
+ * decided by the first child of a container: if it has a name, the
+ * children are written one per line, otherwise they are written in a
+ * single line.
+ */
+static pj_status_t sw_begin_elem(pj_json_stream_writer *sw,
+                                 const pj_str_t *name)
 {
-    unsigned flags = (quotes[0]=='[') ? NO_NAME : 0;
     pj_status_t status;
+    pj_bool_t in_array = PJ_FALSE;
+    pj_ssize_t name_len = name ? name->slen : 0;
 
-    //CHECK( st->writer( st->indent_buf, st->indent, st->user_data) );
-    CHECK( st->writer( &quotes[0], 1, st->user_data) );
-    CHECK( st->writer( " ", 1, st->user_data) );
+    if (sw->status != PJ_SUCCESS)
+        return sw->status;
 
-    if (!pj_list_empty(list)) {
-        pj_bool_t indent_added = PJ_FALSE;
-        pj_json_elem *child = list->next;
+    if (sw->depth) {
+        pj_uint8_t *state = &sw->state[sw->depth-1];
 
-        if (child->name.slen == 0) {
-            /* Simple list */
-            while (child != (pj_json_elem*)list) {
-                status = elem_write(child, st, flags);
-                if (status != PJ_SUCCESS)
-                    return status;
+        in_array = (*state & SW_ARRAY) != 0;
 
-                if (child->next != (pj_json_elem*)list)
-                    CHECK( st->writer( ", ", 2, st->user_data) );
-                child = child->next;
+        if ((*state & SW_HAS_CHILD) == 0) {
+            *state |= SW_HAS_CHILD;
+            if (name_len) {
+                *state |= SW_MULTILINE;
+                if (sw->indent + PJ_JSON_INDENT_SIZE <= MAX_INDENT) {
+                    sw->indent += PJ_JSON_INDENT_SIZE;
+                    *state |= SW_INDENTED;
+                }
+                CHECK( sw_put(sw, "\n", 1) );
             }
+        } else if (*state & SW_MULTILINE) {
+            CHECK( sw_put(sw, ",\n", 2) );
         } else {
-            if (st->indent < (int)sizeof(st->indent_buf)) {
-                st->indent += PJ_JSON_INDENT_SIZE;
-                indent_added = PJ_TRUE;
-            }
-            CHECK( st->writer( "\n", 1, st->user_data) );
-            while (child != (pj_json_elem*)list) {
-                status = elem_write(child, st, flags);
-                if (status != PJ_SUCCESS)
-                    return status;
-
-                if (child->next != (pj_json_elem*)list)
-                    CHECK( st->writer( ",\n", 2, st->user_data) );
-                else
-                    CHECK( st->writer( "\n", 1, st->user_data) );
-                child = child->next;
-            }
-            if (indent_added) {
-                st->indent -= PJ_JSON_INDENT_SIZE;
+            CHECK( sw_put(sw, ", ", 2) );
+        }
+    }
+
+    if (name_len) {
+        CHECK( sw_put(sw, indent_buf, sw->indent) );
+        if (!in_array) {
+            CHECK( sw_put(sw, "\"", 1) );
+            CHECK( write_string_escaped(sw, name) );
+            CHECK( sw_put(sw, "\": ", 3) );
+            if (name_len < PJ_JSON_NAME_MIN_LEN) {
+                CHECK( sw_put(sw, indent_buf,
+                              (unsigned)(PJ_JSON_NAME_MIN_LEN - name_len)) );
             }
-            CHECK( st->writer( st->indent_buf, st->indent, st->user_data) );
         }
     }
-    CHECK( st->writer( &quotes[1], 1, st->user_data) );
 
     return PJ_SUCCESS;
 }
 
-static pj_status_t elem_write(const pj_json_elem *elem,
-                              struct write_state *st,
-                              unsigned flags)
+static pj_status_t sw_begin_container(pj_json_stream_writer *sw,
+                                      const pj_str_t *name,
+                                      pj_bool_t is_array)
 {
     pj_status_t status;
 
-    if (elem->name.slen) {
-        CHECK( st->writer( st->indent_buf, st->indent, st->user_data) );
-        if ((flags & NO_NAME)==0) {
-            CHECK( st->writer( "\"", 1, st->user_data) );
-            CHECK( write_string_escaped(&elem->name, st) );
-            CHECK( st->writer( "\": ", 3, st->user_data) );
-            if (elem->name.slen < PJ_JSON_NAME_MIN_LEN /*&&
-                elem->type != PJ_JSON_VAL_OBJ &&
-                elem->type != PJ_JSON_VAL_ARRAY*/)
-            {
-                CHECK( st->writer( st->space,
-                                   (unsigned)(PJ_JSON_NAME_MIN_LEN -
-                                              elem->name.slen),
-                                   st->user_data) );
-            }
-        }
+    PJ_ASSERT_RETURN(sw, PJ_EINVAL);
+
+    if (sw->depth == PJ_JSON_MAX_DEPTH && sw->status == PJ_SUCCESS)
+        sw->status = PJ_ETOOMANY;
+
+    CHECK( sw_begin_elem(sw, name) );
+    CHECK( sw_put(sw, is_array ? "[ " : "{ ", 2) );
+    sw->state[sw->depth++] = (pj_uint8_t)(is_array ? SW_ARRAY : 0);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_json_sw_init(pj_json_stream_writer *sw,
+                             char *buf, unsigned size,
+                             pj_json_writer writer,
+                             void *user_data)
+{
+    pj_bzero(sw, sizeof(*sw));
+    sw->writer = writer;
+    sw->user_data = user_data;
+    sw->buf = buf;
+    sw->size = buf ? size : 0;
+}
+
+PJ_DEF(pj_status_t) pj_json_sw_begin_obj(pj_json_stream_writer *sw,
+                                         const pj_str_t *name)
+{
+    return sw_begin_container(sw, name, PJ_FALSE);
+}
+
+PJ_DEF(pj_status_t) pj_json_sw_begin_array(pj_json_stream_writer *sw,
+                                           const pj_str_t *name)
+{
+    return sw_begin_container(sw, name, PJ_TRUE);
+}
+
+PJ_DEF(pj_status_t) pj_json_sw_end(pj_json_stream_writer *sw)
+{
+    pj_uint8_t state;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(sw && sw->depth, PJ_EINVALIDOP);
+
+    state = sw->state[--sw->depth];
+    if (state & SW_MULTILINE) {
+        if (state & SW_INDENTED)
+            sw->indent -= PJ_JSON_INDENT_SIZE;
+        CHECK( sw_put(sw, "\n", 1) );
+        CHECK( sw_put(sw, indent_buf, sw->indent) );
+    }
+    return sw_put(sw, (state & SW_ARRAY) ? "]" : "}", 1);
+}
+
+PJ_DEF(pj_status_t) pj_json_sw_null(pj_json_stream_writer *sw,
+                                    const pj_str_t *name)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(sw, PJ_EINVAL);
+    CHECK( sw_begin_elem(sw, name) );
+    return sw_put(sw, "null", 4);
+}
+
+PJ_DEF(pj_status_t) pj_json_sw_bool(pj_json_stream_writer *sw,
+                                    const pj_str_t *name,
+                                    pj_bool_t val)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(sw, PJ_EINVAL);
+    CHECK( sw_begin_elem(sw, name) );
+    return val ? sw_put(sw, "true", 4) : sw_put(sw, "false", 5);
+}
+
+PJ_DEF(pj_status_t) pj_json_sw_number(pj_json_stream_writer *sw,
+                                      const pj_str_t *name,
+                                      float val)
+{
+    char num_buf[65];
+    int len;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(sw, PJ_EINVAL);
+    CHECK( sw_begin_elem(sw, name) );
+
+    if (val == (int)val)
+        len = pj_ansi_snprintf(num_buf, sizeof(num_buf), "%d", (int)val);
+    else
+        len = pj_ansi_snprintf(num_buf, sizeof(num_buf), "%f", val);
+
+    if (len < 0 || len >= (int)sizeof(num_buf)) {
+        sw->status = PJ_ETOOBIG;
+        return sw->status;
     }
+    return sw_put(sw, num_buf, len);
+}
+
+PJ_DEF(pj_status_t) pj_json_sw_string(pj_json_stream_writer *sw,
+                                      const pj_str_t *name,
+                                      const pj_str_t *val)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(sw && val, PJ_EINVAL);
+    CHECK( sw_begin_elem(sw, name) );
+    CHECK( sw_put(sw, "\"", 1) );
+    CHECK( write_string_escaped(sw, val) );
+    return sw_put(sw, "\"", 1);
+}
+
+PJ_DEF(pj_status_t) pj_json_sw_elem(pj_json_stream_writer *sw,
+                                    const pj_json_elem *elem)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(sw && elem, PJ_EINVAL);
 
     switch (elem->type) {
     case PJ_JSON_VAL_NULL:
-        CHECK( st->writer( "null", 4, st->user_data) );
-        break;
+        return pj_json_sw_null(sw, &elem->name);
     case PJ_JSON_VAL_BOOL:
-        if (elem->value.is_true)
-            CHECK( st->writer( "true", 4, st->user_data) );
-        else
-            CHECK( st->writer( "false", 5, st->user_data) );
-        break;
+        return pj_json_sw_bool(sw, &elem->name, elem->value.is_true);
     case PJ_JSON_VAL_NUMBER:
-        {
-            char num_buf[65];
-            int len;
-
-            if (elem->value.num == (int)elem->value.num)
-                len = pj_ansi_snprintf(num_buf, sizeof(num_buf), "%d",
-                                       (int)elem->value.num);
-            else
-                len = pj_ansi_snprintf(num_buf, sizeof(num_buf), "%f",
-                                       elem->value.num);
-
-            if (len < 0 || len >= (int)sizeof(num_buf))
-                return PJ_ETOOBIG;
-            CHECK( st->writer( num_buf, len, st->user_data) );
-        }
-        break;
+        return pj_json_sw_number(sw, &elem->name, elem->value.num);
     case PJ_JSON_VAL_STRING:
-        CHECK( st->writer( "\"", 1, st->user_data) );
-        CHECK( write_string_escaped( &elem->value.str, st) );
-        CHECK( st->writer( "\"", 1, st->user_data) );
-        break;
+        return pj_json_sw_string(sw, &elem->name, &elem->value.str);
     case PJ_JSON_VAL_ARRAY:
-        CHECK( write_children(&elem->value.children, "[]", st) );
-        break;
     case PJ_JSON_VAL_OBJ:
-        CHECK( write_children(&elem->value.children, "{}", st) );
-        break;
+        {
+            const pj_json_elem *child = elem->value.children.next;
+
+            CHECK( sw_begin_container(sw, &elem->name,
+                                      elem->type == PJ_JSON_VAL_ARRAY) );
+            while (child != (pj_json_elem*)&elem->value.children) {
+                CHECK( pj_json_sw_elem(sw, child) );
+                child = child->next;
+            }
+            return pj_json_sw_end(sw);
+        }
     default:
         pj_assert(!"Unhandled value type");
     }
 
-    return PJ_SUCCESS;
+    return PJ_EBUG;
+}
+
+PJ_DEF(pj_status_t) pj_json_sw_flush(pj_json_stream_writer *sw)
+{
+    PJ_ASSERT_RETURN(sw, PJ_EINVAL);
+
+    if (sw->status == PJ_SUCCESS && sw->len) {
+        sw->status = sw->writer(sw->buf, sw->len, sw->user_data);
+        sw->len = 0;
+    }
+    return sw->status;
 }
 
 #undef CHECK
@@ -606,16 +812,13 @@ PJ_DEF(pj_status_t) pj_json_writef( const pj_json_elem *elem,
                                     pj_json_writer writer,
                                     void *user_data)
 {
-    struct write_state st;
+    pj_json_stream_writer sw;
+    char buf[PJ_JSON_WRITE_BUF_SIZE];
 
     PJ_ASSERT_RETURN(elem && writer, PJ_EINVAL);
 
-    st.writer           = writer;
-    st.user_data        = user_data;
-    st.indent           = 0;
-    pj_memset(st.indent_buf, ' ', MAX_INDENT);
-    pj_memset(st.space, ' ', PJ_JSON_NAME_MIN_LEN);
+    pj_json_sw_init(&sw, buf, sizeof(buf), writer, user_data);
+    pj_json_sw_elem(&sw, elem);
 
-    return elem_write(elem, &st, 0);
+    return pj_json_sw_flush(&sw);
 }
-
@@ -101,6 +101,17 @@ PJ_DEF(void) pj_md5_update( pj_md5_context *ctx,
     }
     /* Process data in 64-byte chunks */
 
+#ifndef HIGHFIRST
+    /* No byte reversal is needed, so aligned input can be hashed in place */
+    if ((((pj_size_t)buf) & 3) == 0) {
+        while (len >= 64) {
+            MD5Transform(ctx->buf, (pj_uint32_t const *) buf);
+            buf += 64;
+            len -= 64;
+        }
+    }
+#endif
+
     while (len >= 64) {
         pj_memcpy(ctx->in, buf, 64);
         byteReverse(ctx->in, 16);
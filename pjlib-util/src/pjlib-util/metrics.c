@@ -0,0 +1,973 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjlib-util/metrics.h>
+#include <pjlib-util/config.h>
+#include <pj/activesock.h>
+#include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/errno.h>
+#include <pj/hash.h>
+#include <pj/list.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+#define THIS_FILE       "metrics.c"
+
+/* Relaxed atomic operations on 64bit values. Without them, updates are
+ * serialized with the registry lock.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE==2
+#   define HAS_ATOMIC64         1
+#   define ATOMIC_ADD(p, v)     __atomic_fetch_add(p, v, __ATOMIC_RELAXED)
+#   define ATOMIC_LOAD(p)       __atomic_load_n(p, __ATOMIC_RELAXED)
+#   define ATOMIC_STORE(p, v)   __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#elif defined(_MSC_VER) && defined(_WIN64)
+#   include <windows.h>
+#   define HAS_ATOMIC64         1
+#   define ATOMIC_ADD(p, v)     InterlockedExchangeAdd64(p, v)
+#   define ATOMIC_LOAD(p)       (*(volatile pj_int64_t*)(p))
+#   define ATOMIC_STORE(p, v)   InterlockedExchange64(p, v)
+#else
+#   define HAS_ATOMIC64         0
+#endif
+
+/* Size of a cache line, in number of pj_int64_t */
+#define LINE_SIZE           (64 / sizeof(pj_int64_t))
+
+#define MAX_NAME_LEN        128
+
+typedef struct collector
+{
+    PJ_DECL_LIST_MEMBER(struct collector);
+    pj_metrics_collector    cb;
+    void                   *user_data;
+} collector;
+
+struct pj_metric
+{
+    PJ_DECL_LIST_MEMBER(struct pj_metric);
+    pj_metrics         *metrics;
+    pj_metric_type      type;
+    char               *name;
+    char               *help;
+
+    /* Histogram bounds */
+    unsigned            bucket_cnt;
+    pj_int64_t         *bounds;
+
+    /* Values of each shard, each shard is "stride" values long and
+     * starts at a cache line boundary. Gauges only use shard zero.
+     * Histograms store the bucket counts (including "+Inf") followed by
+     * the sum of observed values.
+     */
+    unsigned            stride;
+    pj_int64_t         *val;
+};
+
+struct pj_metrics
+{
+    pj_pool_t          *pool;
+    pj_lock_t          *lock;
+    pj_hash_table_t    *ht;
+    struct pj_metric    metric_list;
+    collector           collector_list;
+    collector           free_collector;
+};
+
+/* Default registry */
+static pj_metrics *default_metrics;
+
+/* Thread local shard index, plus one */
+static long shard_tls_id = -1;
+static pj_int64_t shard_seq;
+
+static void metrics_atexit(void)
+{
+    if (shard_tls_id != -1) {
+        pj_thread_local_free(shard_tls_id);
+        shard_tls_id = -1;
+    }
+    default_metrics = NULL;
+}
+
+/* Get the shard of the calling thread */
+static unsigned get_shard(void)
+{
+    pj_ssize_t idx;
+
+    if (shard_tls_id == -1)
+        return 0;
+
+    idx = (pj_ssize_t)pj_thread_local_get(shard_tls_id);
+    if (idx == 0) {
+#if HAS_ATOMIC64
+        idx = (pj_ssize_t)(ATOMIC_ADD(&shard_seq, 1) %
+                           PJ_METRICS_SHARD_CNT) + 1;
+#else
+        idx = (pj_ssize_t)(shard_seq++ % PJ_METRICS_SHARD_CNT) + 1;
+#endif
+        pj_thread_local_set(shard_tls_id, (void*)idx);
+    }
+
+    return (unsigned)(idx - 1);
+}
+
+static void val_add(pj_metric *m, pj_int64_t *p, pj_int64_t v)
+{
+#if HAS_ATOMIC64
+    PJ_UNUSED_ARG(m);
+    ATOMIC_ADD(p, v);
+#else
+    pj_lock_acquire(m->metrics->lock);
+    *p += v;
+    pj_lock_release(m->metrics->lock);
+#endif
+}
+
+static pj_int64_t val_get(const pj_int64_t *p)
+{
+#if HAS_ATOMIC64
+    return ATOMIC_LOAD((pj_int64_t*)p);
+#else
+    return *(volatile const pj_int64_t*)p;
+#endif
+}
+
+PJ_DEF(pj_status_t) pj_metrics_create(pj_pool_factory *pf,
+                                      pj_metrics **p_metrics)
+{
+    pj_pool_t *pool;
+    pj_metrics *metrics;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf && p_metrics, PJ_EINVAL);
+
+    if (shard_tls_id == -1) {
+        status = pj_thread_local_alloc(&shard_tls_id);
+        if (status != PJ_SUCCESS)
+            return status;
+        pj_atexit(&metrics_atexit);
+    }
+
+    pool = pj_pool_create(pf, "metrics%p", 1024, 1024, NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    metrics = PJ_POOL_ZALLOC_T(pool, pj_metrics);
+    metrics->pool = pool;
+    pj_list_init(&metrics->metric_list);
+    pj_list_init(&metrics->collector_list);
+    pj_list_init(&metrics->free_collector);
+    metrics->ht = pj_hash_create(pool, PJ_METRICS_HASH_SIZE);
+
+    status = pj_lock_create_recursive_mutex(pool, "metrics", &metrics->lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+
+    *p_metrics = metrics;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_metrics_destroy(pj_metrics *metrics)
+{
+    PJ_ASSERT_RETURN(metrics, PJ_EINVAL);
+
+    if (default_metrics == metrics)
+        default_metrics = NULL;
+
+    pj_lock_destroy(metrics->lock);
+    pj_pool_release(metrics->pool);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_metrics_set_default(pj_metrics *metrics)
+{
+    default_metrics = metrics;
+}
+
+PJ_DEF(pj_metrics*) pj_metrics_get_default(void)
+{
+    return default_metrics;
+}
+
+static pj_bool_t is_valid_name(const char *name)
+{
+    const char *p = name;
+
+    if (!*p || (*p >= '0' && *p <= '9'))
+        return PJ_FALSE;
+
+    for (; *p; ++p) {
+        if (!pj_isalnum(*p) && *p != '_' && *p != ':')
+            return PJ_FALSE;
+    }
+
+    return (p - name) <= MAX_NAME_LEN;
+}
+
+/* Register a metric */
+static pj_status_t add_metric(pj_metrics *metrics,
+                              pj_metric_type type,
+                              const char *name,
+                              const char *help,
+                              unsigned bucket_cnt,
+                              const pj_int64_t bounds[],
+                              pj_metric **p_metric)
+{
+    pj_metric *m;
+    unsigned i, shard_cnt, len;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(metrics && name && p_metric, PJ_EINVAL);
+    if (!is_valid_name(name) || (help && pj_ansi_strchr(help, '\n')))
+        return PJ_EINVAL;
+
+    len = (unsigned)pj_ansi_strlen(name);
+
+    pj_lock_acquire(metrics->lock);
+
+    m = (pj_metric*)pj_hash_get(metrics->ht, name, len, NULL);
+    if (m) {
+        if (m->type != type || m->bucket_cnt != bucket_cnt)
+            status = PJ_EEXISTS;
+        else
+            *p_metric = m;
+        goto on_return;
+    }
+
+    m = PJ_POOL_ZALLOC_T(metrics->pool, pj_metric);
+    m->metrics = metrics;
+    m->type = type;
+    m->name = (char*)pj_pool_alloc(metrics->pool, len + 1);
+    pj_memcpy(m->name, name, len + 1);
+    if (help && *help) {
+        pj_size_t help_len = pj_ansi_strlen(help);
+
+        m->help = (char*)pj_pool_alloc(metrics->pool, help_len + 1);
+        pj_memcpy(m->help, help, help_len + 1);
+    }
+
+    switch (type) {
+    case PJ_METRIC_COUNTER:
+        m->stride = LINE_SIZE;
+        shard_cnt = PJ_METRICS_SHARD_CNT;
+        break;
+    case PJ_METRIC_GAUGE:
+        m->stride = LINE_SIZE;
+        shard_cnt = 1;
+        break;
+    default:
+        m->bucket_cnt = bucket_cnt;
+        m->bounds = (pj_int64_t*)pj_pool_calloc(metrics->pool, bucket_cnt,
+                                                sizeof(pj_int64_t));
+        for (i = 0; i < bucket_cnt; ++i)
+            m->bounds[i] = bounds[i];
+        /* Bucket counts, "+Inf" bucket and sum */
+        m->stride = (bucket_cnt + 2 + LINE_SIZE - 1) / LINE_SIZE * LINE_SIZE;
+        shard_cnt = PJ_METRICS_SHARD_CNT;
+        break;
+    }
+
+    /* Align the values to cache line */
+    {
+        pj_size_t sz = (shard_cnt * m->stride + LINE_SIZE) *
+                       sizeof(pj_int64_t);
+        char *buf = (char*)pj_pool_zalloc(metrics->pool, sz);
+        pj_size_t off = (pj_size_t)buf % (LINE_SIZE * sizeof(pj_int64_t));
+
+        if (off)
+            buf += LINE_SIZE * sizeof(pj_int64_t) - off;
+        m->val = (pj_int64_t*)buf;
+    }
+
+    pj_hash_set(metrics->pool, metrics->ht, m->name, len, 0, m);
+    pj_list_push_back(&metrics->metric_list, m);
+    *p_metric = m;
+
+on_return:
+    pj_lock_release(metrics->lock);
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_metrics_add_counter(pj_metrics *metrics,
+                                           const char *name,
+                                           const char *help,
+                                           pj_metric **p_metric)
+{
+    return add_metric(metrics, PJ_METRIC_COUNTER, name, help, 0, NULL,
+                      p_metric);
+}
+
+PJ_DEF(pj_status_t) pj_metrics_add_gauge(pj_metrics *metrics,
+                                         const char *name,
+                                         const char *help,
+                                         pj_metric **p_metric)
+{
+    return add_metric(metrics, PJ_METRIC_GAUGE, name, help, 0, NULL,
+                      p_metric);
+}
+
+PJ_DEF(pj_status_t) pj_metrics_add_histogram(pj_metrics *metrics,
+                                             const char *name,
+                                             const char *help,
+                                             unsigned bucket_cnt,
+                                             const pj_int64_t bounds[],
+                                             pj_metric **p_metric)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(bucket_cnt && bounds, PJ_EINVAL);
+    PJ_ASSERT_RETURN(bucket_cnt <= PJ_METRICS_MAX_BUCKETS, PJ_ETOOMANY);
+    for (i = 1; i < bucket_cnt; ++i) {
+        PJ_ASSERT_RETURN(bounds[i] > bounds[i-1], PJ_EINVAL);
+    }
+
+    return add_metric(metrics, PJ_METRIC_HISTOGRAM, name, help, bucket_cnt,
+                      bounds, p_metric);
+}
+
+PJ_DEF(pj_metric*) pj_metrics_find(pj_metrics *metrics, const char *name)
+{
+    pj_metric *m;
+
+    PJ_ASSERT_RETURN(metrics && name, NULL);
+
+    pj_lock_acquire(metrics->lock);
+    m = (pj_metric*)pj_hash_get(metrics->ht, name,
+                                (unsigned)pj_ansi_strlen(name), NULL);
+    pj_lock_release(metrics->lock);
+
+    return m;
+}
+
+PJ_DEF(pj_status_t) pj_metrics_add_collector(pj_metrics *metrics,
+                                             pj_metrics_collector cb,
+                                             void *user_data)
+{
+    collector *c;
+
+    PJ_ASSERT_RETURN(metrics && cb, PJ_EINVAL);
+
+    pj_lock_acquire(metrics->lock);
+    if (!pj_list_empty(&metrics->free_collector)) {
+        c = metrics->free_collector.next;
+        pj_list_erase(c);
+    } else {
+        c = PJ_POOL_ZALLOC_T(metrics->pool, collector);
+    }
+    c->cb = cb;
+    c->user_data = user_data;
+    pj_list_push_back(&metrics->collector_list, c);
+    pj_lock_release(metrics->lock);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_metrics_remove_collector(pj_metrics *metrics,
+                                                pj_metrics_collector cb,
+                                                void *user_data)
+{
+    collector *c;
+    pj_status_t status = PJ_ENOTFOUND;
+
+    PJ_ASSERT_RETURN(metrics && cb, PJ_EINVAL);
+
+    pj_lock_acquire(metrics->lock);
+    for (c = metrics->collector_list.next; c != &metrics->collector_list;
+         c = c->next)
+    {
+        if (c->cb == cb && c->user_data == user_data) {
+            pj_list_erase(c);
+            pj_list_push_back(&metrics->free_collector, c);
+            status = PJ_SUCCESS;
+            break;
+        }
+    }
+    pj_lock_release(metrics->lock);
+
+    return status;
+}
+
+PJ_DEF(pj_metric_type) pj_metric_get_type(const pj_metric *metric)
+{
+    return metric->type;
+}
+
+PJ_DEF(void) pj_metric_add(pj_metric *m, pj_int64_t value)
+{
+    if (!m)
+        return;
+
+    if (m->type == PJ_METRIC_COUNTER) {
+        val_add(m, &m->val[get_shard() * m->stride], value);
+    } else if (m->type == PJ_METRIC_GAUGE) {
+        val_add(m, &m->val[0], value);
+    } else {
+        pj_assert(!"Not counter nor gauge");
+    }
+}
+
+PJ_DEF(void) pj_metric_inc(pj_metric *m)
+{
+    pj_metric_add(m, 1);
+}
+
+PJ_DEF(void) pj_metric_set(pj_metric *m, pj_int64_t value)
+{
+    if (!m)
+        return;
+
+    PJ_ASSERT_ON_FAIL(m->type == PJ_METRIC_GAUGE, return);
+#if HAS_ATOMIC64
+    ATOMIC_STORE(&m->val[0], value);
+#else
+    pj_lock_acquire(m->metrics->lock);
+    m->val[0] = value;
+    pj_lock_release(m->metrics->lock);
+#endif
+}
+
+PJ_DEF(void) pj_metric_observe(pj_metric *m, pj_int64_t value)
+{
+    pj_int64_t *shard;
+    unsigned i;
+
+    if (!m)
+        return;
+
+    PJ_ASSERT_ON_FAIL(m->type == PJ_METRIC_HISTOGRAM, return);
+
+    for (i = 0; i < m->bucket_cnt && value > m->bounds[i]; ++i)
+        ;
+
+    shard = &m->val[get_shard() * m->stride];
+    val_add(m, &shard[i], 1);
+    val_add(m, &shard[m->bucket_cnt + 1], value);
+}
+
+/* Sum the value at the offset of all shards */
+static pj_int64_t sum_shards(const pj_metric *m, unsigned offset)
+{
+    pj_int64_t sum = 0;
+    unsigned i;
+
+    for (i = 0; i < PJ_METRICS_SHARD_CNT; ++i)
+        sum += val_get(&m->val[i * m->stride + offset]);
+
+    return sum;
+}
+
+PJ_DEF(pj_int64_t) pj_metric_get(const pj_metric *m)
+{
+    pj_int64_t sum = 0;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(m, 0);
+
+    switch (m->type) {
+    case PJ_METRIC_COUNTER:
+        return sum_shards(m, 0);
+    case PJ_METRIC_GAUGE:
+        return val_get(&m->val[0]);
+    default:
+        for (i = 0; i <= m->bucket_cnt; ++i)
+            sum += sum_shards(m, i);
+        return sum;
+    }
+}
+
+
+/*
+ * Exposition format writer.
+ */
+typedef struct out_buf
+{
+    pj_metrics_writer   writer;
+    void               *user_data;
+    pj_status_t         status;
+    unsigned            len;
+    char                buf[PJ_METRICS_WRITE_BUF_SIZE];
+} out_buf;
+
+static void out_flush(out_buf *o)
+{
+    if (o->len && o->status == PJ_SUCCESS)
+        o->status = (*o->writer)(o->buf, o->len, o->user_data);
+    o->len = 0;
+}
+
+static void out_str(out_buf *o, const char *s, unsigned len)
+{
+    if (o->len + len > sizeof(o->buf))
+        out_flush(o);
+
+    if (len > sizeof(o->buf)) {
+        if (o->status == PJ_SUCCESS)
+            o->status = (*o->writer)(s, len, o->user_data);
+        return;
+    }
+
+    pj_memcpy(o->buf + o->len, s, len);
+    o->len += len;
+}
+
+static void out_cstr(out_buf *o, const char *s)
+{
+    out_str(o, s, (unsigned)pj_ansi_strlen(s));
+}
+
+static void out_i64(out_buf *o, pj_int64_t v)
+{
+    char tmp[24];
+    int len;
+
+    len = pj_ansi_snprintf(tmp, sizeof(tmp), "%lld", (long long)v);
+    out_str(o, tmp, (unsigned)len);
+}
+
+static void write_metric(out_buf *o, const pj_metric *m)
+{
+    static const char *type_names[] = { "counter", "gauge", "histogram" };
+
+    if (m->help) {
+        out_cstr(o, "# HELP ");
+        out_cstr(o, m->name);
+        out_cstr(o, " ");
+        out_cstr(o, m->help);
+        out_cstr(o, "\n");
+    }
+    out_cstr(o, "# TYPE ");
+    out_cstr(o, m->name);
+    out_cstr(o, " ");
+    out_cstr(o, type_names[m->type]);
+    out_cstr(o, "\n");
+
+    if (m->type != PJ_METRIC_HISTOGRAM) {
+        out_cstr(o, m->name);
+        out_cstr(o, " ");
+        out_i64(o, pj_metric_get(m));
+        out_cstr(o, "\n");
+    } else {
+        pj_int64_t cnt = 0;
+        unsigned i;
+
+        for (i = 0; i <= m->bucket_cnt; ++i) {
+            cnt += sum_shards(m, i);
+            out_cstr(o, m->name);
+            out_cstr(o, "_bucket{le=\"");
+            if (i < m->bucket_cnt)
+                out_i64(o, m->bounds[i]);
+            else
+                out_cstr(o, "+Inf");
+            out_cstr(o, "\"} ");
+            out_i64(o, cnt);
+            out_cstr(o, "\n");
+        }
+        out_cstr(o, m->name);
+        out_cstr(o, "_sum ");
+        out_i64(o, sum_shards(m, m->bucket_cnt + 1));
+        out_cstr(o, "\n");
+        out_cstr(o, m->name);
+        out_cstr(o, "_count ");
+        out_i64(o, cnt);
+        out_cstr(o, "\n");
+    }
+}
+
+PJ_DEF(pj_status_t) pj_metrics_write(pj_metrics *metrics,
+                                     const pj_str_t *prefix,
+                                     pj_metrics_writer writer,
+                                     void *user_data)
+{
+    out_buf o;
+    collector *c;
+    pj_metric *m;
+
+    PJ_ASSERT_RETURN(metrics && writer, PJ_EINVAL);
+
+    o.writer = writer;
+    o.user_data = user_data;
+    o.status = PJ_SUCCESS;
+    o.len = 0;
+
+    pj_lock_acquire(metrics->lock);
+
+    for (c = metrics->collector_list.next; c != &metrics->collector_list; ) {
+        collector *next = c->next;
+
+        (*c->cb)(metrics, c->user_data);
+        c = next;
+    }
+
+    for (m = metrics->metric_list.next;
+         m != &metrics->metric_list && o.status == PJ_SUCCESS;
+         m = m->next)
+    {
+        if (prefix && prefix->slen &&
+            pj_ansi_strncmp(m->name, prefix->ptr, prefix->slen) != 0)
+        {
+            continue;
+        }
+        write_metric(&o, m);
+    }
+
+    pj_lock_release(metrics->lock);
+
+    out_flush(&o);
+    return o.status;
+}
+
+
+/*
+ * HTTP endpoint
+ */
+typedef struct http_conn
+{
+    PJ_DECL_LIST_MEMBER(struct http_conn);
+    pj_metrics_http        *srv;
+    pj_pool_t              *pool;
+    pj_activesock_t        *asock;
+    pj_ioqueue_op_key_t     send_key;
+
+    /* Response being built */
+    char                   *resp;
+    unsigned                resp_len;
+    unsigned                resp_size;
+} http_conn;
+
+struct pj_metrics_http
+{
+    pj_pool_factory        *pf;
+    pj_pool_t              *pool;
+    pj_ioqueue_t           *ioqueue;
+    pj_metrics             *metrics;
+    pj_lock_t              *lock;
+    pj_activesock_t        *listener;
+    pj_sockaddr             addr;
+    http_conn               conn_list;
+};
+
+#define HTTP_REQ_SIZE       2048
+
+static void http_conn_destroy(http_conn *conn)
+{
+    pj_metrics_http *srv = conn->srv;
+
+    pj_lock_acquire(srv->lock);
+    pj_list_erase(conn);
+    pj_lock_release(srv->lock);
+
+    pj_activesock_close(conn->asock);
+    pj_pool_release(conn->pool);
+}
+
+/* Append to the response buffer, growing it as needed */
+static pj_status_t resp_writer(const char *s, unsigned size, void *user_data)
+{
+    http_conn *conn = (http_conn*)user_data;
+
+    if (conn->resp_len + size > conn->resp_size) {
+        unsigned new_size = conn->resp_size * 2;
+        char *new_resp;
+
+        while (new_size < conn->resp_len + size)
+            new_size *= 2;
+        new_resp = (char*)pj_pool_alloc(conn->pool, new_size);
+        pj_memcpy(new_resp, conn->resp, conn->resp_len);
+        conn->resp = new_resp;
+        conn->resp_size = new_size;
+    }
+
+    pj_memcpy(conn->resp + conn->resp_len, s, size);
+    conn->resp_len += size;
+    return PJ_SUCCESS;
+}
+
+/* Build the response, leaving space for the header at the beginning */
+static void http_build_resp(http_conn *conn, const char *req)
+{
+    enum { HDR_SPACE = 160 };
+    const char *status_line, *content_type;
+    char hdr[HDR_SPACE];
+    int hdr_len;
+    unsigned body_len;
+
+    conn->resp_size = 4096;
+    conn->resp = (char*)pj_pool_alloc(conn->pool, conn->resp_size);
+    conn->resp_len = HDR_SPACE;
+
+    if (pj_ansi_strncmp(req, "GET /metrics ", 13) == 0 ||
+        pj_ansi_strncmp(req, "GET / ", 6) == 0)
+    {
+        status_line = "200 OK";
+        content_type = "text/plain; version=0.0.4";
+        if (pj_metrics_write(conn->srv->metrics, NULL, &resp_writer,
+                             conn) != PJ_SUCCESS)
+        {
+            conn->resp_len = HDR_SPACE;
+            status_line = "500 Internal Server Error";
+        }
+    } else if (pj_ansi_strncmp(req, "GET ", 4) == 0) {
+        status_line = "404 Not Found";
+        content_type = "text/plain";
+    } else {
+        status_line = "405 Method Not Allowed";
+        content_type = "text/plain";
+    }
+
+    body_len = conn->resp_len - HDR_SPACE;
+    hdr_len = pj_ansi_snprintf(hdr, sizeof(hdr),
+                               "HTTP/1.0 %s\r\n"
+                               "Content-Type: %s\r\n"
+                               "Content-Length: %u\r\n"
+                               "Connection: close\r\n"
+                               "\r\n",
+                               status_line, content_type, body_len);
+    pj_assert(hdr_len > 0 && hdr_len < HDR_SPACE);
+
+    /* Move the header next to the body */
+    pj_memcpy(conn->resp + HDR_SPACE - hdr_len, hdr, hdr_len);
+    conn->resp += HDR_SPACE - hdr_len;
+    conn->resp_len = body_len + hdr_len;
+}
+
+static pj_bool_t http_on_data_read(pj_activesock_t *asock,
+                                   void *data,
+                                   pj_size_t size,
+                                   pj_status_t status,
+                                   pj_size_t *remainder)
+{
+    http_conn *conn = (http_conn*)pj_activesock_get_user_data(asock);
+    char *req = (char*)data;
+    pj_ssize_t sent;
+
+    if (status != PJ_SUCCESS) {
+        http_conn_destroy(conn);
+        return PJ_FALSE;
+    }
+
+    /* Wait for the complete request header */
+    req[size] = '\0';
+    if (!pj_ansi_strstr(req, "\r\n\r\n") && !pj_ansi_strstr(req, "\n\n")) {
+        if (size >= HTTP_REQ_SIZE - 1) {
+            http_conn_destroy(conn);
+            return PJ_FALSE;
+        }
+        *remainder = size;
+        return PJ_TRUE;
+    }
+
+    http_build_resp(conn, req);
+
+    sent = conn->resp_len;
+    status = pj_activesock_send(asock, &conn->send_key, conn->resp, &sent, 0);
+    if (status != PJ_EPENDING) {
+        http_conn_destroy(conn);
+        return PJ_FALSE;
+    }
+
+    /* Wait for on_data_sent(), ignore further data */
+    *remainder = 0;
+    return PJ_TRUE;
+}
+
+static pj_bool_t http_on_data_sent(pj_activesock_t *asock,
+                                   pj_ioqueue_op_key_t *send_key,
+                                   pj_ssize_t sent)
+{
+    http_conn *conn = (http_conn*)pj_activesock_get_user_data(asock);
+
+    PJ_UNUSED_ARG(send_key);
+    PJ_UNUSED_ARG(sent);
+
+    http_conn_destroy(conn);
+    return PJ_FALSE;
+}
+
+static pj_bool_t http_on_accept_complete(pj_activesock_t *asock,
+                                         pj_sock_t newsock,
+                                         const pj_sockaddr_t *src_addr,
+                                         int src_addr_len)
+{
+    pj_metrics_http *srv = (pj_metrics_http*)pj_activesock_get_user_data(asock);
+    pj_activesock_cfg asock_cfg;
+    pj_activesock_cb cb;
+    pj_pool_t *pool;
+    http_conn *conn;
+    void *readbuf[1];
+    pj_status_t status;
+
+    PJ_UNUSED_ARG(src_addr);
+    PJ_UNUSED_ARG(src_addr_len);
+
+    pool = pj_pool_create(srv->pf, "metricsc%p", 1024, 4096, NULL);
+    if (!pool) {
+        pj_sock_close(newsock);
+        return PJ_TRUE;
+    }
+
+    conn = PJ_POOL_ZALLOC_T(pool, http_conn);
+    conn->srv = srv;
+    conn->pool = pool;
+    pj_ioqueue_op_key_init(&conn->send_key, sizeof(conn->send_key));
+
+    /* Serialize the callbacks, so that on_data_sent() doesn't destroy the
+     * connection while on_data_read() is still running.
+     */
+    pj_activesock_cfg_default(&asock_cfg);
+    asock_cfg.concurrency = 0;
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_data_read = &http_on_data_read;
+    cb.on_data_sent = &http_on_data_sent;
+
+    status = pj_activesock_create(pool, newsock, pj_SOCK_STREAM(), &asock_cfg,
+                                  srv->ioqueue, &cb, conn, &conn->asock);
+    if (status != PJ_SUCCESS) {
+        pj_sock_close(newsock);
+        pj_pool_release(pool);
+        return PJ_TRUE;
+    }
+
+    pj_lock_acquire(srv->lock);
+    pj_list_push_back(&srv->conn_list, conn);
+    pj_lock_release(srv->lock);
+
+    /* One extra byte for the NULL terminator */
+    readbuf[0] = pj_pool_alloc(pool, HTTP_REQ_SIZE);
+    status = pj_activesock_start_read2(conn->asock, pool, HTTP_REQ_SIZE - 1,
+                                       readbuf, 0);
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(4,(THIS_FILE, status, "Metrics HTTP read error"));
+        http_conn_destroy(conn);
+    }
+
+    return PJ_TRUE;
+}
+
+PJ_DEF(pj_status_t) pj_metrics_http_create(pj_pool_factory *pf,
+                                           pj_ioqueue_t *ioqueue,
+                                           pj_metrics *metrics,
+                                           const pj_sockaddr *bind_addr,
+                                           pj_metrics_http **p_srv)
+{
+    pj_pool_t *pool;
+    pj_metrics_http *srv;
+    pj_activesock_cb cb;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    int addr_len;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf && ioqueue && metrics && bind_addr && p_srv,
+                     PJ_EINVAL);
+
+    pool = pj_pool_create(pf, "metricsh%p", 512, 512, NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    srv = PJ_POOL_ZALLOC_T(pool, pj_metrics_http);
+    srv->pf = pf;
+    srv->pool = pool;
+    srv->ioqueue = ioqueue;
+    srv->metrics = metrics;
+    pj_list_init(&srv->conn_list);
+
+    status = pj_lock_create_recursive_mutex(pool, "metricsh", &srv->lock);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    status = pj_sock_socket(bind_addr->addr.sa_family, pj_SOCK_STREAM(), 0,
+                            &sock);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    {
+        int val = 1;
+        pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEADDR(),
+                           &val, sizeof(val));
+    }
+
+    status = pj_sock_bind(sock, bind_addr, pj_sockaddr_get_len(bind_addr));
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    status = pj_sock_listen(sock, 5);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    addr_len = sizeof(srv->addr);
+    status = pj_sock_getsockname(sock, &srv->addr, &addr_len);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_accept_complete = &http_on_accept_complete;
+    status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(), NULL,
+                                  ioqueue, &cb, srv, &srv->listener);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+    sock = PJ_INVALID_SOCKET;
+
+    status = pj_activesock_start_accept(srv->listener, pool);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    *p_srv = srv;
+    return PJ_SUCCESS;
+
+on_error:
+    if (sock != PJ_INVALID_SOCKET)
+        pj_sock_close(sock);
+    pj_metrics_http_destroy(srv);
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_metrics_http_get_addr(pj_metrics_http *srv,
+                                             pj_sockaddr *addr)
+{
+    PJ_ASSERT_RETURN(srv && addr, PJ_EINVAL);
+    pj_sockaddr_cp(addr, &srv->addr);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_metrics_http_destroy(pj_metrics_http *srv)
+{
+    PJ_ASSERT_RETURN(srv, PJ_EINVAL);
+
+    if (srv->listener) {
+        pj_activesock_close(srv->listener);
+        srv->listener = NULL;
+    }
+
+    if (srv->lock) {
+        pj_lock_acquire(srv->lock);
+        while (!pj_list_empty(&srv->conn_list))
+            http_conn_destroy(srv->conn_list.next);
+        pj_lock_release(srv->lock);
+        pj_lock_destroy(srv->lock);
+    }
+
+    pj_pool_release(srv->pool);
+    return PJ_SUCCESS;
+}
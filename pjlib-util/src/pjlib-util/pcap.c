@@ -17,14 +17,25 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
 #include <pjlib-util/pcap.h>
+#include <pjlib-util/config.h>
 #include <pj/assert.h>
 #include <pj/errno.h>
+#include <pj/file_access.h>
 #include <pj/file_io.h>
+#include <pj/hash.h>
 #include <pj/log.h>
 #include <pj/pool.h>
 #include <pj/sock.h>
 #include <pj/string.h>
 
+#if PJ_PCAP_HAS_MMAP
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
 #if 0
 #   define TRACE_(x)    PJ_LOG(5,x)
 #else
@@ -79,17 +90,73 @@ typedef struct pj_pcap_ip_hdr
     pj_uint32_t ip_dst;
 } pj_pcap_ip_hdr;
 
+#pragma pack()
+
+/* Key to find a flow in the flow table. It must not contain padding. */
+typedef struct flow_key
+{
+    pj_uint32_t     ip_src;
+    pj_uint32_t     ip_dst;
+    pj_uint16_t     src_port;
+    pj_uint16_t     dst_port;
+    pj_uint32_t     ssrc;
+    pj_uint32_t     type;
+} flow_key;
+
+typedef struct flow_entry
+{
+    pj_pcap_flow        info;
+    unsigned            index;
+    flow_key            key;
+    pj_hash_entry_buf   hbuf;
+} flow_entry;
+
 /* Implementation of pcap file */
 struct pj_pcap_file
 {
     char            obj_name[PJ_MAX_OBJ_NAME];
+    pj_pool_t      *pool;
     pj_oshandle_t   fd;
     pj_bool_t       swap;
     pj_pcap_hdr     hdr;
     pj_pcap_filter  filter;
+    unsigned        ts_div;         /* 1000 for nanosecond captures     */
+
+    /* Memory image of the file, for pj_pcap_map() */
+    const pj_uint8_t *map;
+    pj_size_t       map_size;
+    pj_size_t       map_pos;
+    pj_bool_t       mmapped;
+
+    /* Record buffer, for pj_pcap_open() */
+    pj_uint8_t     *rec_buf;
+    pj_size_t       rec_buf_size;
+
+    /* Flow table */
+    pj_hash_table_t *flow_ht;
+    flow_entry    **flows;
+    unsigned        flow_cnt;
+    unsigned        flow_max;
 };
 
-#pragma pack()
+/* Magic numbers */
+#define MAGIC_USEC          0xa1b2c3d4
+#define MAGIC_USEC_SWAPPED  0xd4c3b2a1
+#define MAGIC_NSEC          0xa1b23c4d
+#define MAGIC_NSEC_SWAPPED  0x4d3cb2a1
+
+/* Sanity limit of a record length, twice the largest snaplen used by
+ * tcpdump/wireshark.
+ */
+#define MAX_REC_LEN         (2*262144)
+
+#define ETH_TYPE_IPV4       0x0800
+#define ETH_TYPE_VLAN       0x8100
+#define ETH_TYPE_QINQ       0x88a8
+
+#define GET16(p)    (pj_uint16_t)(((p)[0] << 8) | (p)[1])
+#define GET32(p)    (((pj_uint32_t)(p)[0] << 24) | ((p)[1] << 16) | \
+                     ((p)[2] << 8) | (p)[3])
 
 /* Init default filter */
 PJ_DEF(void) pj_pcap_filter_default(pj_pcap_filter *filter)
@@ -97,31 +164,63 @@ PJ_DEF(void) pj_pcap_filter_default(pj_pcap_filter *filter)
     pj_bzero(filter, sizeof(*filter));
 }
 
-/* Open pcap file */
-PJ_DEF(pj_status_t) pj_pcap_open(pj_pool_t *pool,
-                                 const char *path,
-                                 pj_pcap_file **p_file)
+/* Check the file header */
+static pj_status_t init_hdr(pj_pcap_file *file)
 {
-    pj_pcap_file *file;
-    pj_ssize_t sz;
-    pj_status_t status;
+    switch (file->hdr.magic_number) {
+    case MAGIC_USEC:
+    case MAGIC_NSEC:
+        file->swap = PJ_FALSE;
+        break;
+    case MAGIC_USEC_SWAPPED:
+    case MAGIC_NSEC_SWAPPED:
+        file->swap = PJ_TRUE;
+        file->hdr.magic_number = pj_ntohl(file->hdr.magic_number);
+        file->hdr.network = pj_ntohl(file->hdr.network);
+        break;
+    default:
+        /* Not PCAP file */
+        return PJ_EINVALIDOP;
+    }
 
-    PJ_ASSERT_RETURN(pool && path && p_file, PJ_EINVAL);
+    file->ts_div = (file->hdr.magic_number == MAGIC_NSEC) ? 1000 : 1;
+    return PJ_SUCCESS;
+}
+
+static pj_pcap_file *create_file(pj_pool_t *pool)
+{
+    pj_pcap_file *file;
 
     /* More sanity checks */
     TRACE_(("pcap", "sizeof(pj_pcap_eth_hdr)=%d",
             sizeof(pj_pcap_eth_hdr)));
-    PJ_ASSERT_RETURN(sizeof(pj_pcap_eth_hdr)==14, PJ_EBUG);
+    PJ_ASSERT_RETURN(sizeof(pj_pcap_eth_hdr)==14, NULL);
     TRACE_(("pcap", "sizeof(pj_pcap_ip_hdr)=%d",
             sizeof(pj_pcap_ip_hdr)));
-    PJ_ASSERT_RETURN(sizeof(pj_pcap_ip_hdr)==20, PJ_EBUG);
+    PJ_ASSERT_RETURN(sizeof(pj_pcap_ip_hdr)==20, NULL);
     TRACE_(("pcap", "sizeof(pj_pcap_udp_hdr)=%d",
             sizeof(pj_pcap_udp_hdr)));
-    PJ_ASSERT_RETURN(sizeof(pj_pcap_udp_hdr)==8, PJ_EBUG);
-    
-    file = PJ_POOL_ZALLOC_T(pool, pj_pcap_file);
+    PJ_ASSERT_RETURN(sizeof(pj_pcap_udp_hdr)==8, NULL);
 
+    file = PJ_POOL_ZALLOC_T(pool, pj_pcap_file);
     pj_ansi_strxcpy(file->obj_name, "pcap", sizeof(file->obj_name));
+    file->pool = pool;
+    return file;
+}
+
+/* Open pcap file */
+PJ_DEF(pj_status_t) pj_pcap_open(pj_pool_t *pool,
+                                 const char *path,
+                                 pj_pcap_file **p_file)
+{
+    pj_pcap_file *file;
+    pj_ssize_t sz;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && path && p_file, PJ_EINVAL);
+
+    file = create_file(pool);
+    PJ_ASSERT_RETURN(file, PJ_EBUG);
 
     status = pj_file_open(pool, path, PJ_O_RDONLY | PJ_O_CLOEXEC, &file->fd);
     if (status != PJ_SUCCESS)
@@ -130,25 +229,116 @@ PJ_DEF(pj_status_t) pj_pcap_open(pj_pool_t *pool,
     /* Read file pcap header */
     sz = sizeof(file->hdr);
     status = pj_file_read(file->fd, &file->hdr, &sz);
+    if (status == PJ_SUCCESS && sz != sizeof(file->hdr))
+        status = PJ_EINVALIDOP;
+    if (status == PJ_SUCCESS)
+        status = init_hdr(file);
     if (status != PJ_SUCCESS) {
         pj_file_close(file->fd);
         return status;
     }
 
-    /* Check magic number */
-    if (file->hdr.magic_number == 0xa1b2c3d4) {
-        file->swap = PJ_FALSE;
-    } else if (file->hdr.magic_number == 0xd4c3b2a1) {
-        file->swap = PJ_TRUE;
-        file->hdr.network = pj_ntohl(file->hdr.network);
-    } else {
-        /* Not PCAP file */
+    TRACE_((file->obj_name, "PCAP file %s opened", path));
+    
+    *p_file = file;
+    return PJ_SUCCESS;
+}
+
+/* Open and map pcap file */
+PJ_DEF(pj_status_t) pj_pcap_map(pj_pool_t *pool,
+                                const char *path,
+                                pj_pcap_file **p_file)
+{
+    pj_pcap_file *file;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && path && p_file, PJ_EINVAL);
+
+    file = create_file(pool);
+    PJ_ASSERT_RETURN(file, PJ_EBUG);
+
+#if PJ_PCAP_HAS_MMAP
+    {
+        struct stat st;
+        void *addr;
+        int fd;
+
+        fd = open(path, O_RDONLY
+#  ifdef O_CLOEXEC
+                  | O_CLOEXEC
+#  endif
+                  );
+        if (fd < 0)
+            return PJ_RETURN_OS_ERROR(errno);
+
+        if (fstat(fd, &st) != 0) {
+            status = PJ_RETURN_OS_ERROR(errno);
+            close(fd);
+            return status;
+        }
+
+        if (st.st_size < (off_t)sizeof(file->hdr)) {
+            close(fd);
+            return PJ_EINVALIDOP;
+        }
+
+        addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        status = (addr == MAP_FAILED) ? PJ_RETURN_OS_ERROR(errno) :
+                                        PJ_SUCCESS;
+        close(fd);
+        if (status != PJ_SUCCESS)
+            return status;
+
+#  if defined(MADV_SEQUENTIAL)
+        madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+#  endif
+        file->map = (const pj_uint8_t*)addr;
+        file->map_size = (pj_size_t)st.st_size;
+        file->mmapped = PJ_TRUE;
+    }
+#else
+    {
+        pj_off_t size;
+        pj_ssize_t sz;
+        pj_uint8_t *buf;
+
+        size = pj_file_size(path);
+        if (size < 0)
+            return PJ_ENOTFOUND;
+        if (size < (pj_off_t)sizeof(file->hdr))
+            return PJ_EINVALIDOP;
+        if ((pj_uint64_t)size > PJ_MAXINT32)
+            return PJ_ETOOBIG;
+
+        status = pj_file_open(pool, path, PJ_O_RDONLY | PJ_O_CLOEXEC,
+                              &file->fd);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        buf = (pj_uint8_t*)pj_pool_alloc(pool, (pj_size_t)size);
+        sz = (pj_ssize_t)size;
+        status = pj_file_read(file->fd, buf, &sz);
         pj_file_close(file->fd);
-        return PJ_EINVALIDOP;
+        file->fd = NULL;
+        if (status != PJ_SUCCESS)
+            return status;
+
+        file->map = buf;
+        file->map_size = (pj_size_t)sz;
     }
+#endif
+
+    pj_memcpy(&file->hdr, file->map, sizeof(file->hdr));
+    status = init_hdr(file);
+    if (status != PJ_SUCCESS) {
+        pj_pcap_close(file);
+        return status;
+    }
+    file->map_pos = sizeof(file->hdr);
+
+    TRACE_((file->obj_name, "PCAP file %s mapped, %lu bytes", path,
+            (unsigned long)file->map_size));
 
-    TRACE_((file->obj_name, "PCAP file %s opened", path));
-    
     *p_file = file;
     return PJ_SUCCESS;
 }
@@ -158,6 +348,15 @@ PJ_DEF(pj_status_t) pj_pcap_close(pj_pcap_file *file)
 {
     PJ_ASSERT_RETURN(file, PJ_EINVAL);
     TRACE_((file->obj_name, "PCAP file closed"));
+
+    if (file->map) {
+#if PJ_PCAP_HAS_MMAP
+        if (file->mmapped)
+            munmap((void*)file->map, file->map_size);
+#endif
+        file->map = NULL;
+        return PJ_SUCCESS;
+    }
     return pj_file_close(file->fd);
 }
 
@@ -184,214 +383,408 @@ static pj_status_t read_file(pj_pcap_file *file,
     return PJ_SUCCESS;
 }
 
-static pj_status_t skip(pj_oshandle_t fd, pj_off_t bytes)
+/* Get the next record. On success, data points to rec->incl_len bytes
+ * of the captured packet.
+ */
+static pj_status_t next_record(pj_pcap_file *file,
+                               pj_pcap_rec_hdr *rec,
+                               const pj_uint8_t **data)
 {
+    pj_size_t remain = 0;
+    pj_ssize_t sz;
     pj_status_t status;
-    status = pj_file_setpos(fd, bytes, PJ_SEEK_CUR);
-    if (status != PJ_SUCCESS)
-        return status; 
-    return PJ_SUCCESS;
-}
 
+    if (file->map) {
+        remain = file->map_size - file->map_pos;
+        if (remain < sizeof(*rec))
+            return PJ_EEOF;
+        pj_memcpy(rec, file->map + file->map_pos, sizeof(*rec));
+        remain -= sizeof(*rec);
+    } else {
+        sz = sizeof(*rec);
+        status = read_file(file, rec, &sz);
+        if (status != PJ_SUCCESS) {
+            TRACE_((file->obj_name, "read_file() error: %d", status));
+            return status;
+        }
+        if (sz != sizeof(*rec))
+            return PJ_EEOF;
+    }
+
+    /* Swap byte ordering */
+    if (file->swap) {
+        rec->incl_len = pj_ntohl(rec->incl_len);
+        rec->orig_len = pj_ntohl(rec->orig_len);
+        rec->ts_sec = pj_ntohl(rec->ts_sec);
+        rec->ts_usec = pj_ntohl(rec->ts_usec);
+    }
 
-#define SKIP_PKT()  \
-        if (rec_incl > sz_read) { \
-            status = skip(file->fd, rec_incl-sz_read);\
-            if (status != PJ_SUCCESS) \
-                return status; \
+    if (file->map) {
+        if (rec->incl_len > remain) {
+            /* Truncated capture */
+            file->map_pos = file->map_size;
+            return PJ_EEOF;
         }
+        *data = file->map + file->map_pos + sizeof(*rec);
+        file->map_pos += sizeof(*rec) + rec->incl_len;
+        return PJ_SUCCESS;
+    }
 
-/* Read UDP packet */
-PJ_DEF(pj_status_t) pj_pcap_read_udp(pj_pcap_file *file,
-                                     pj_pcap_udp_hdr *udp_hdr,
-                                     pj_uint8_t *udp_payload,
-                                     pj_size_t *udp_payload_size)
+    if (rec->incl_len > MAX_REC_LEN) {
+        TRACE_((file->obj_name, "Error: invalid record length %u",
+                rec->incl_len));
+        return PJ_ETOOBIG;
+    }
+
+    if (rec->incl_len > file->rec_buf_size) {
+        file->rec_buf_size = rec->incl_len < 2048 ? 2048 : rec->incl_len;
+        file->rec_buf = (pj_uint8_t*)pj_pool_alloc(file->pool,
+                                                   file->rec_buf_size);
+    }
+
+    if (rec->incl_len) {
+        sz = rec->incl_len;
+        status = read_file(file, file->rec_buf, &sz);
+        if (status != PJ_SUCCESS)
+            return status;
+        if (sz != (pj_ssize_t)rec->incl_len)
+            return PJ_EEOF;
+    }
+
+    *data = file->rec_buf;
+    return PJ_SUCCESS;
+}
+
+/* Decode the record as UDP packet. Returns PJ_ENOTFOUND if the packet
+ * is not UDP or it doesn't match the filter.
+ */
+static pj_status_t parse_udp(pj_pcap_file *file,
+                             const pj_pcap_rec_hdr *rec,
+                             const pj_uint8_t *p,
+                             pj_pcap_udp_pkt *pkt)
 {
-    PJ_ASSERT_RETURN(file && udp_payload && udp_payload_size, PJ_EINVAL);
-    PJ_ASSERT_RETURN(*udp_payload_size, PJ_EINVAL);
+    const pj_uint8_t *end = p + rec->incl_len;
+    pj_pcap_ip_hdr ip;
+    pj_uint16_t eth_type;
+    unsigned ihl, udp_len;
+
+    /* Link layer header */
+    switch (file->hdr.network) {
+    case PJ_PCAP_LINK_TYPE_ETH:
+        if (end - p < (int)sizeof(pj_pcap_eth_hdr))
+            return PJ_ENOTFOUND;
+        eth_type = GET16(p + 12);
+        p += sizeof(pj_pcap_eth_hdr);
+        /* Skip VLAN tags */
+        while ((eth_type == ETH_TYPE_VLAN || eth_type == ETH_TYPE_QINQ) &&
+               end - p >= 4)
+        {
+            eth_type = GET16(p + 2);
+            p += 4;
+        }
+        break;
+    case PJ_PCAP_LINK_TYPE_LINUX_SLL:
+        if (end - p < 16)
+            return PJ_ENOTFOUND;
+        eth_type = GET16(p + 14);
+        p += 16;
+        break;
+    default:
+        TRACE_((file->obj_name, "Error: link layer not supported"));
+        return PJ_ENOTSUP;
+    }
+
+    if (eth_type != ETH_TYPE_IPV4) {
+        TRACE_((file->obj_name, "Not IPv4, skipping"));
+        return PJ_ENOTFOUND;
+    }
+
+    /* IP header */
+    if (end - p < (int)sizeof(ip))
+        return PJ_ENOTFOUND;
+    pj_memcpy(&ip, p, sizeof(ip));
+
+    ihl = (ip.v_ihl & 0x0F) * 4;
+    if ((ip.v_ihl >> 4) != 4 || ihl < sizeof(ip) || end - p < (int)ihl)
+        return PJ_ENOTFOUND;
+
+    /* Skip if IP source mismatch */
+    if (file->filter.ip_src && ip.ip_src != file->filter.ip_src) {
+        TRACE_((file->obj_name, "IP source mismatch, skipping"));
+        return PJ_ENOTFOUND;
+    }
+
+    /* Skip if IP destination mismatch */
+    if (file->filter.ip_dst && ip.ip_dst != file->filter.ip_dst) {
+        TRACE_((file->obj_name, "IP destination mismatch, skipping"));
+        return PJ_ENOTFOUND;
+    }
+
+    /* Skip if proto mismatch */
+    if (file->filter.proto && ip.proto != file->filter.proto) {
+        TRACE_((file->obj_name, "IP proto %d mismatch, skipping", ip.proto));
+        return PJ_ENOTFOUND;
+    }
+
+    if (ip.proto != PJ_PCAP_PROTO_TYPE_UDP) {
+        TRACE_((file->obj_name, "Not UDP, skipping"));
+        return PJ_ENOTFOUND;
+    }
+
+    /* Skip fragments, i.e. MF flag set or non-zero offset */
+    if (pj_ntohs(ip.flags_fragment) & 0x3FFF) {
+        TRACE_((file->obj_name, "IP fragment, skipping"));
+        return PJ_ENOTFOUND;
+    }
 
+    /* UDP header */
+    p += ihl;
+    if (end - p < (int)sizeof(pkt->udp))
+        return PJ_ENOTFOUND;
+    pj_memcpy(&pkt->udp, p, sizeof(pkt->udp));
+    p += sizeof(pkt->udp);
+
+    /* Skip if source port mismatch */
+    if (file->filter.src_port && pkt->udp.src_port != file->filter.src_port) {
+        TRACE_((file->obj_name, "UDP src port %d mismatch, skipping", 
+                pj_ntohs(pkt->udp.src_port)));
+        return PJ_ENOTFOUND;
+    }
+
+    /* Skip if destination port mismatch */
+    if (file->filter.dst_port && pkt->udp.dst_port != file->filter.dst_port) {
+        TRACE_((file->obj_name, "UDP dst port %d mismatch, skipping", 
+                pj_ntohs(pkt->udp.dst_port)));
+        return PJ_ENOTFOUND;
+    }
+
+    udp_len = pj_ntohs(pkt->udp.len);
+    if (udp_len < sizeof(pkt->udp))
+        return PJ_ENOTFOUND;
+    udp_len -= sizeof(pkt->udp);
+
+    /* The packet may have been truncated by the capture's snaplen, and
+     * some links may have trailer after the IP packet.
+     */
+    if (udp_len > (unsigned)(end - p))
+        udp_len = (unsigned)(end - p);
+
+    pkt->ts_sec = rec->ts_sec;
+    pkt->ts_usec = rec->ts_usec / file->ts_div;
+    pkt->ip_src = ip.ip_src;
+    pkt->ip_dst = ip.ip_dst;
+    pkt->payload = p;
+    pkt->payload_len = udp_len;
+    pkt->flow = 0;
+
+    return PJ_SUCCESS;
+}
+
+/* Read the next UDP packet matching the filter */
+static pj_status_t read_udp(pj_pcap_file *file, pj_pcap_udp_pkt *pkt)
+{
     /* Check data link type in PCAP file header */
     if ((file->filter.link && 
             file->hdr.network != (pj_uint32_t)file->filter.link) ||
-        file->hdr.network != PJ_PCAP_LINK_TYPE_ETH)
+        (file->hdr.network != PJ_PCAP_LINK_TYPE_ETH &&
+         file->hdr.network != PJ_PCAP_LINK_TYPE_LINUX_SLL))
     {
-        /* Link header other than Ethernet is not supported for now */
         return PJ_ENOTSUP;
     }
 
     /* Loop until we have the packet */
     for (;;) {
-        union {
-            pj_pcap_rec_hdr rec;
-            pj_pcap_eth_hdr eth;
-            pj_pcap_ip_hdr ip;
-            pj_pcap_udp_hdr udp;
-        } tmp;
-        unsigned rec_incl;
-        pj_ssize_t sz;
-        pj_size_t sz_read = 0;
-        char addr[PJ_INET_ADDRSTRLEN];
+        pj_pcap_rec_hdr rec;
+        const pj_uint8_t *data;
         pj_status_t status;
 
         TRACE_((file->obj_name, "Reading packet.."));
-        pj_bzero(&addr, sizeof(addr));
 
-        /* Read PCAP packet header */
-        sz = sizeof(tmp.rec);
-        status = read_file(file, &tmp.rec, &sz); 
-        if (status != PJ_SUCCESS) {
-            TRACE_((file->obj_name, "read_file() error: %d", status));
+        status = next_record(file, &rec, &data);
+        if (status != PJ_SUCCESS)
             return status;
-        }
 
-        rec_incl = tmp.rec.incl_len;
+        status = parse_udp(file, &rec, data, pkt);
+        if (status != PJ_ENOTFOUND)
+            return status;
+    }
 
-        /* Swap byte ordering */
-        if (file->swap) {
-            tmp.rec.incl_len = pj_ntohl(tmp.rec.incl_len);
-            tmp.rec.orig_len = pj_ntohl(tmp.rec.orig_len);
-            tmp.rec.ts_sec = pj_ntohl(tmp.rec.ts_sec);
-            tmp.rec.ts_usec = pj_ntohl(tmp.rec.ts_usec);
-        }
+    /* Does not reach here */
+}
 
-        /* Read link layer header */
-        switch (file->hdr.network) {
-        case PJ_PCAP_LINK_TYPE_ETH:
-            sz = sizeof(tmp.eth);
-            status = read_file(file, &tmp.eth, &sz);
-            break;
-        default:
-            TRACE_((file->obj_name, "Error: link layer not Ethernet"));
-            return PJ_ENOTSUP;
-        }
+/* Read UDP packet */
+PJ_DEF(pj_status_t) pj_pcap_read_udp(pj_pcap_file *file,
+                                     pj_pcap_udp_hdr *udp_hdr,
+                                     pj_uint8_t *udp_payload,
+                                     pj_size_t *udp_payload_size)
+{
+    pj_pcap_udp_pkt pkt;
+    pj_status_t status;
 
-        if (status != PJ_SUCCESS) {
-            TRACE_((file->obj_name, "Error reading Eth header: %d", status));
-            return status;
-        }
+    PJ_ASSERT_RETURN(file && udp_payload && udp_payload_size, PJ_EINVAL);
+    PJ_ASSERT_RETURN(*udp_payload_size, PJ_EINVAL);
 
-        sz_read += sz;
-            
-        /* Read IP header */
-        sz = sizeof(tmp.ip);
-        status = read_file(file, &tmp.ip, &sz);
-        if (status != PJ_SUCCESS) {
-            TRACE_((file->obj_name, "Error reading IP header: %d", status));
-            return status;
-        }
+    status = read_udp(file, &pkt);
+    if (status != PJ_SUCCESS)
+        return status;
 
-        sz_read += sz;
+    /* Copy UDP header if caller wants it */
+    if (udp_hdr) {
+        pj_memcpy(udp_hdr, &pkt.udp, sizeof(*udp_hdr));
+    }
 
-        /* Skip if IP source mismatch */
-        if (file->filter.ip_src && tmp.ip.ip_src != file->filter.ip_src) {
-            TRACE_((file->obj_name, "IP source %s mismatch, skipping", 
-                    pj_inet_ntop2(pj_AF_INET(), (pj_in_addr*)&tmp.ip.ip_src,
-                                  addr, sizeof(addr))));
-            SKIP_PKT();
-            continue;
-        }
+    /* Check if payload fits the buffer */
+    if (pkt.payload_len > *udp_payload_size) {
+        TRACE_((file->obj_name, 
+                "Error: packet too large (%d bytes required)",
+                (int)pkt.payload_len));
+        return PJ_ETOOSMALL;
+    }
 
-        /* Skip if IP destination mismatch */
-        if (file->filter.ip_dst && tmp.ip.ip_dst != file->filter.ip_dst) {
-            TRACE_((file->obj_name, "IP detination %s mismatch, skipping", 
-                    pj_inet_ntop2(pj_AF_INET(), (pj_in_addr*)&tmp.ip.ip_dst,
-                                  addr, sizeof(addr))));
-            SKIP_PKT();
-            continue;
-        }
+    pj_memcpy(udp_payload, pkt.payload, pkt.payload_len);
+    *udp_payload_size = pkt.payload_len;
 
-        /* Skip if proto mismatch */
-        if (file->filter.proto && tmp.ip.proto != file->filter.proto) {
-            TRACE_((file->obj_name, "IP proto %d mismatch, skipping", 
-                    tmp.ip.proto));
-            SKIP_PKT();
-            continue;
-        }
+    return PJ_SUCCESS;
+}
 
-        /* Read transport layer header */
-        switch (tmp.ip.proto) {
-        case PJ_PCAP_PROTO_TYPE_UDP:
-            sz = sizeof(tmp.udp);
-            status = read_file(file, &tmp.udp, &sz);
-            if (status != PJ_SUCCESS) {
-                TRACE_((file->obj_name, "Error reading UDP header: %d",status));
-                return status;
-            }
-
-            sz_read += sz;
-
-            /* Skip if source port mismatch */
-            if (file->filter.src_port && 
-                tmp.udp.src_port != file->filter.src_port) 
-            {
-                TRACE_((file->obj_name, "UDP src port %d mismatch, skipping", 
-                        pj_ntohs(tmp.udp.src_port)));
-                SKIP_PKT();
-                continue;
-            }
-
-            /* Skip if destination port mismatch */
-            if (file->filter.dst_port && 
-                tmp.udp.dst_port != file->filter.dst_port) 
-            {
-                TRACE_((file->obj_name, "UDP dst port %d mismatch, skipping", 
-                        pj_ntohs(tmp.udp.dst_port)));
-                SKIP_PKT();
-                continue;
-            }
-
-            /* Copy UDP header if caller wants it */
-            if (udp_hdr) {
-                pj_memcpy(udp_hdr, &tmp.udp, sizeof(*udp_hdr));
-            }
-
-            /* Calculate payload size */
-            sz = pj_ntohs(tmp.udp.len) - sizeof(tmp.udp);
-            break;
-        default:
-            TRACE_((file->obj_name, "Not UDP, skipping"));
-            SKIP_PKT();
-            continue;
-        }
+/* Guess the flow type from the payload. RTP and RTCP are only expected
+ * on unprivileged ports, and RTCP is told from RTP by its packet type
+ * (RFC 5761 Section 4).
+ */
+static pj_pcap_flow_type get_flow_type(const pj_pcap_udp_pkt *pkt,
+                                       pj_uint32_t *ssrc)
+{
+    const pj_uint8_t *p = pkt->payload;
 
-        /* Check if payload fits the buffer */
-        if (sz > (pj_ssize_t)*udp_payload_size) {
-            TRACE_((file->obj_name, 
-                    "Error: packet too large (%d bytes required)", sz));
-            SKIP_PKT();
-            return PJ_ETOOSMALL;
-        }
+    *ssrc = 0;
 
-        /* Read the payload */
-        status = read_file(file, udp_payload, &sz);
-        if (status != PJ_SUCCESS) {
-            TRACE_((file->obj_name, "Error reading payload: %d", status));
-            return status;
-        }
+    if (pj_ntohs(pkt->udp.src_port) < 1024 ||
+        pj_ntohs(pkt->udp.dst_port) < 1024 ||
+        pkt->payload_len < 8 || (p[0] & 0xC0) != 0x80)
+    {
+        return PJ_PCAP_FLOW_UDP;
+    }
 
-        sz_read += sz;
+    if (p[1] >= 192 && p[1] <= 223)
+        return PJ_PCAP_FLOW_RTCP;
 
-        *udp_payload_size = sz;
+    if (pkt->payload_len < 12)
+        return PJ_PCAP_FLOW_UDP;
 
-        // Some layers may have trailer, e.g: link eth2.
-        /* Check that we've read all the packets */
-        //PJ_ASSERT_RETURN(sz_read == rec_incl, PJ_EBUG);
+    *ssrc = GET32(p + 8);
+    return PJ_PCAP_FLOW_RTP;
+}
 
-        /* Skip trailer */
-        while (sz_read < rec_incl) {
-            sz = rec_incl - sz_read;
-            status = read_file(file, &tmp.eth, &sz);
-            if (status != PJ_SUCCESS) {
-                TRACE_((file->obj_name, "Error reading trailer: %d", status));
-                return status;
-            }
-            sz_read += sz;
+/* Find or create the flow of the packet */
+static void assign_flow(pj_pcap_file *file, pj_pcap_udp_pkt *pkt)
+{
+    flow_key key;
+    flow_entry *flow;
+    pj_uint32_t hval;
+    pj_uint32_t ssrc;
+
+    pj_bzero(&key, sizeof(key));
+    key.ip_src = pkt->ip_src;
+    key.ip_dst = pkt->ip_dst;
+    key.src_port = pkt->udp.src_port;
+    key.dst_port = pkt->udp.dst_port;
+    key.type = get_flow_type(pkt, &ssrc);
+    key.ssrc = ssrc;
+
+    if (!file->flow_ht)
+        file->flow_ht = pj_hash_create(file->pool, PJ_PCAP_FLOW_HASH_SIZE);
+
+    hval = pj_hash_calc(0, &key, sizeof(key));
+    flow = (flow_entry*)pj_hash_get(file->flow_ht, &key, sizeof(key), &hval);
+    if (!flow) {
+        if (file->flow_cnt == file->flow_max) {
+            flow_entry **flows;
+            unsigned max = file->flow_max ? file->flow_max * 2 : 16;
+
+            flows = (flow_entry**)pj_pool_calloc(file->pool, max,
+                                                 sizeof(flow_entry*));
+            if (file->flow_cnt)
+                pj_memcpy(flows, file->flows,
+                          file->flow_cnt * sizeof(flow_entry*));
+            file->flows = flows;
+            file->flow_max = max;
         }
 
-        return PJ_SUCCESS;
+        flow = PJ_POOL_ZALLOC_T(file->pool, flow_entry);
+        pj_memcpy(&flow->key, &key, sizeof(key));
+        flow->info.type = (pj_pcap_flow_type)key.type;
+        flow->info.ip_src = key.ip_src;
+        flow->info.ip_dst = key.ip_dst;
+        flow->info.src_port = key.src_port;
+        flow->info.dst_port = key.dst_port;
+        flow->info.ssrc = key.ssrc;
+        pj_hash_set_np(file->flow_ht, &flow->key, sizeof(flow->key), hval,
+                       flow->hbuf, flow);
+
+        flow->index = file->flow_cnt;
+        file->flows[file->flow_cnt++] = flow;
     }
 
-    /* Does not reach here */
+    flow->info.pkt_cnt++;
+    flow->info.bytes += pkt->payload_len;
+    pkt->flow = flow->index;
 }
 
+/* Read UDP packet and assign flow */
+PJ_DEF(pj_status_t) pj_pcap_read_udp_pkt(pj_pcap_file *file,
+                                         pj_pcap_udp_pkt *pkt)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(file && pkt, PJ_EINVAL);
+
+    status = read_udp(file, pkt);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    assign_flow(file, pkt);
+    return PJ_SUCCESS;
+}
+
+/* Get number of flows */
+PJ_DEF(unsigned) pj_pcap_get_flow_count(pj_pcap_file *file)
+{
+    PJ_ASSERT_RETURN(file, 0);
+    return file->flow_cnt;
+}
+
+/* Get flow info */
+PJ_DEF(const pj_pcap_flow*) pj_pcap_get_flow(pj_pcap_file *file,
+                                             unsigned index)
+{
+    PJ_ASSERT_RETURN(file, NULL);
+    if (index >= file->flow_cnt)
+        return NULL;
+    return &file->flows[index]->info;
+}
+
+/* Rewind */
+PJ_DEF(pj_status_t) pj_pcap_rewind(pj_pcap_file *file)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(file, PJ_EINVAL);
+
+    if (file->map) {
+        file->map_pos = sizeof(file->hdr);
+    } else {
+        pj_status_t status;
+
+        status = pj_file_setpos(file->fd, sizeof(file->hdr), PJ_SEEK_SET);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+
+    for (i = 0; i < file->flow_cnt; ++i) {
+        file->flows[i]->info.pkt_cnt = 0;
+        file->flows[i]->info.bytes = 0;
+    }
+
+    return PJ_SUCCESS;
+}
 
@@ -99,10 +99,20 @@ A million repetitions of "a"
 #include "sha1.h"
 */
 #include <pjlib-util/sha1.h>
+#include <pjlib-util/config.h>
 #include <pj/string.h>
 
 #undef SHA1HANDSOFF
 
+/* Intel SHA extensions, selected at run-time */
+#if defined(PJ_SHA1_USE_HW_ACCEL) && PJ_SHA1_USE_HW_ACCEL != 0 && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#  define SHA1_HAS_SHANI    1
+#  include <cpuid.h>
+#  include <immintrin.h>
+#endif
+
 
 static void SHA1_Transform(pj_uint32_t state[5], pj_uint8_t buffer[64]);
 
@@ -201,6 +211,148 @@ PJ_DEF(void) pj_sha1_init(pj_sha1_context* context)
 }
 
 
+#if defined(SHA1_HAS_SHANI)
+
+/* Four rounds, also preparing the message schedule for the next rounds */
+#define SHANI_ROUNDS4(e_in, e_out, m0, m1, m2, m3, f) \
+    e_in = _mm_sha1nexte_epu32(e_in, m0); \
+    e_out = abcd; \
+    m1 = _mm_sha1msg2_epu32(m1, m0); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e_in, f); \
+    m3 = _mm_sha1msg1_epu32(m3, m0); \
+    m2 = _mm_xor_si128(m2, m0)
+
+/* Hash 512-bit blocks with the SHA instructions. */
+__attribute__((target("sha,sse4.1")))
+static void SHA1_Transform_shani(pj_uint32_t state[5],
+                                 const pj_uint8_t *data, pj_size_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+    __m128i abcd, abcd_save, e0, e0_save, e1;
+    __m128i msg0, msg1, msg2, msg3;
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+    e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    for ( ; blocks; --blocks, data += 64) {
+        abcd_save = abcd;
+        e0_save = e0;
+
+        /* Rounds 0-3 */
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), mask);
+        e0 = _mm_add_epi32(e0, msg0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        /* Rounds 4-7 */
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+16)),
+                                mask);
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+        /* Rounds 8-11 */
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+32)),
+                                mask);
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        /* Rounds 12-67 */
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data+48)),
+                                mask);
+        SHANI_ROUNDS4(e1, e0, msg3, msg0, msg1, msg2, 0);
+        SHANI_ROUNDS4(e0, e1, msg0, msg1, msg2, msg3, 0);
+        SHANI_ROUNDS4(e1, e0, msg1, msg2, msg3, msg0, 1);
+        SHANI_ROUNDS4(e0, e1, msg2, msg3, msg0, msg1, 1);
+        SHANI_ROUNDS4(e1, e0, msg3, msg0, msg1, msg2, 1);
+        SHANI_ROUNDS4(e0, e1, msg0, msg1, msg2, msg3, 1);
+        SHANI_ROUNDS4(e1, e0, msg1, msg2, msg3, msg0, 1);
+        SHANI_ROUNDS4(e0, e1, msg2, msg3, msg0, msg1, 2);
+        SHANI_ROUNDS4(e1, e0, msg3, msg0, msg1, msg2, 2);
+        SHANI_ROUNDS4(e0, e1, msg0, msg1, msg2, msg3, 2);
+        SHANI_ROUNDS4(e1, e0, msg1, msg2, msg3, msg0, 2);
+        SHANI_ROUNDS4(e0, e1, msg2, msg3, msg0, msg1, 2);
+        SHANI_ROUNDS4(e1, e0, msg3, msg0, msg1, msg2, 3);
+        SHANI_ROUNDS4(e0, e1, msg0, msg1, msg2, msg3, 3);
+
+        /* Rounds 68-71 */
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        /* Rounds 72-75 */
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+        /* Rounds 76-79 */
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+        /* Add the working vars back into state */
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = (pj_uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+/* Check whether the CPU supports SHA, SSSE3 and SSE4.1 instructions.
+ * The result is cached; concurrent first calls just detect it twice.
+ */
+static pj_bool_t sha1_has_shani(void)
+{
+    static int has_shani = -1;
+
+    if (has_shani < 0) {
+        unsigned eax, ebx, ecx, edx;
+        int result = 0;
+
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+            (ecx & bit_SSSE3) && (ecx & bit_SSE4_1) &&
+            __get_cpuid_max(0, NULL) >= 7)
+        {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            result = (ebx & (1 << 29)) != 0;
+        }
+        has_shani = result;
+    }
+    return has_shani;
+}
+
+#endif  /* SHA1_HAS_SHANI */
+
+
+/* Hash a number of consecutive 512-bit blocks. */
+static void SHA1_Transform_blocks(pj_uint32_t state[5],
+                                  const pj_uint8_t *data, pj_size_t blocks)
+{
+#if defined(SHA1_HAS_SHANI)
+    if (sha1_has_shani()) {
+        SHA1_Transform_shani(state, data, blocks);
+        return;
+    }
+#endif
+
+    /* SHA1_Transform() modifies the buffer, so work on a copy */
+    for ( ; blocks; --blocks, data += 64) {
+        pj_uint8_t tmp[64];
+        pj_memcpy(tmp, data, 64);
+        SHA1_Transform(state, tmp);
+    }
+}
+
+
 /* Run your data through this. */
 PJ_DEF(void) pj_sha1_update(pj_sha1_context* context, 
                             const pj_uint8_t* data, pj_size_t len)
@@ -213,11 +365,10 @@ PJ_DEF(void) pj_sha1_update(pj_sha1_context* context,
     context->count[1] += ((pj_uint32_t)len >> 29);
     if ((j + len) > 63) {
         pj_memcpy(&context->buffer[j], data, (i = 64-j));
-        SHA1_Transform(context->state, context->buffer);
-        for ( ; i + 63 < len; i += 64) {
-            pj_uint8_t tmp[64];
-            pj_memcpy(tmp, data + i, 64);
-            SHA1_Transform(context->state, tmp);
+        SHA1_Transform_blocks(context->state, context->buffer, 1);
+        if (len - i >= 64) {
+            SHA1_Transform_blocks(context->state, data + i, (len - i) / 64);
+            i += (len - i) & ~((pj_size_t)63);
         }
         j = 0;
     }
@@ -231,6 +382,7 @@ PJ_DEF(void) pj_sha1_update(pj_sha1_context* context,
 PJ_DEF(void) pj_sha1_final(pj_sha1_context* context, 
                            pj_uint8_t digest[PJ_SHA1_DIGEST_SIZE])
 {
+    static const pj_uint8_t padding[64] = { 0x80 };
     pj_uint32_t i;
     pj_uint8_t  finalcount[8];
 
@@ -238,10 +390,9 @@ PJ_DEF(void) pj_sha1_final(pj_sha1_context* context,
         finalcount[i] = (unsigned char)((context->count[(i >= 4 ? 0 : 1)]
          >> ((3-(i & 3)) * 8) ) & 255);  /* Endian independent */
     }
-    pj_sha1_update(context, (pj_uint8_t *)"\200", 1);
-    while ((context->count[0] & 504) != 448) {
-        pj_sha1_update(context, (pj_uint8_t *)"\0", 1);
-    }
+    /* Pad with "\200" and zeros to 56 mod 64 bytes, in a single update */
+    i = (context->count[0] >> 3) & 63;
+    pj_sha1_update(context, padding, (i < 56) ? (56 - i) : (120 - i));
     pj_sha1_update(context, finalcount, 8);  /* Should cause a SHA1_Transform() */
     for (i = 0; i < PJ_SHA1_DIGEST_SIZE; i++) {
         digest[i] = (pj_uint8_t)
@@ -17,7 +17,9 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
 #include <pjlib-util/xml.h>
+#include <pjlib-util/errno.h>
 #include <pjlib-util/scanner.h>
+#include <pj/assert.h>
 #include <pj/except.h>
 #include <pj/pool.h>
 #include <pj/string.h>
@@ -198,6 +200,351 @@ PJ_DEF(pj_xml_node*) pj_xml_parse( pj_pool_t *pool, char *msg, pj_size_t len)
     return node;
 }
 
+/*
+ * XML pull reader.
+ *
+ * Unlike pj_xml_parse(), the reader does not use exception to report syntax
+ * error, since installing an exception handler for every event would cost
+ * more than the event itself. Instead the scanner callback marks the reader
+ * as failed and moves the scanner to the end of the input, and the reader
+ * checks the flag after each scanner operation that may fail.
+ */
+
+static const pj_str_t STR_XMLNS = { "xmlns", 5 };
+
+#define READER_CHECK(rd)    if ((rd)->has_error) return PJLIB_UTIL_EINXML
+
+static void on_reader_error(struct pj_scanner *scanner)
+{
+    /* The scanner is the first member of the reader */
+    pj_xml_reader *rd = (pj_xml_reader*)scanner;
+
+    if (!rd->has_error) {
+        PJ_LOG(4,(THIS_FILE, "Syntax error parsing XML in line %d column %d",
+                  scanner->line, pj_scan_get_col(scanner)));
+        rd->has_error = PJ_TRUE;
+    }
+    scanner->curptr = scanner->end;
+}
+
+static pj_status_t reader_error(pj_xml_reader *rd)
+{
+    on_reader_error(&rd->scanner);
+    return PJLIB_UTIL_EINXML;
+}
+
+PJ_DEF(pj_status_t) pj_xml_reader_init(pj_xml_reader *rd,
+                                       char *msg, pj_size_t len,
+                                       unsigned options)
+{
+    PJ_ASSERT_RETURN(rd && msg && len, PJ_EINVAL);
+
+    /* Only the bookkeeping fields need resetting; the element, attribute
+     * and namespace stacks are written before they are read.
+     */
+    rd->options = options;
+    rd->has_root = rd->has_error = rd->pending_end = PJ_FALSE;
+    rd->depth = rd->attr_cnt = rd->ns_cnt = 0;
+    pj_scan_init( &rd->scanner, msg, len,
+                  PJ_SCAN_AUTOSKIP_WS|PJ_SCAN_AUTOSKIP_NEWLINE,
+                  &on_reader_error);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_xml_reader_fini(pj_xml_reader *rd)
+{
+    pj_scan_fini(&rd->scanner);
+}
+
+/* Split qualified name into prefix and local name */
+static void split_qname(const pj_str_t *name, pj_str_t *prefix,
+                        pj_str_t *local_name)
+{
+    char *colon = (char*)pj_memchr(name->ptr, ':', name->slen);
+
+    if (colon) {
+        pj_strset3(prefix, name->ptr, colon);
+        pj_strset3(local_name, colon+1, name->ptr + name->slen);
+    } else {
+        pj_strset(prefix, name->ptr, 0);
+        *local_name = *name;
+    }
+}
+
+/* Resolve the namespace URI of the element in the event */
+static void resolve_ns(pj_xml_reader *rd, pj_xml_event *ev)
+{
+    pj_str_t prefix;
+    unsigned i;
+
+    split_qname(&ev->name, &prefix, &ev->local_name);
+
+    if ((rd->options & PJ_XML_READER_NS) == 0)
+        return;
+
+    for (i=rd->ns_cnt; i>0; --i) {
+        if (pj_strcmp(&rd->ns[i-1].prefix, &prefix) == 0) {
+            ev->ns_uri = rd->ns[i-1].uri;
+            break;
+        }
+    }
+}
+
+/* Register namespace declarations in the element just opened */
+static pj_status_t push_ns(pj_xml_reader *rd)
+{
+    unsigned i;
+
+    for (i=0; i<rd->attr_cnt; ++i) {
+        const pj_xml_reader_attr *a = &rd->attr[i];
+        pj_str_t prefix;
+
+        if (a->name.slen < STR_XMLNS.slen ||
+            pj_memcmp(a->name.ptr, STR_XMLNS.ptr, STR_XMLNS.slen) != 0)
+        {
+            continue;
+        }
+
+        if (a->name.slen == STR_XMLNS.slen) {
+            pj_strset(&prefix, a->name.ptr, 0);
+        } else if (a->name.ptr[STR_XMLNS.slen] == ':') {
+            pj_strset3(&prefix, a->name.ptr + STR_XMLNS.slen + 1,
+                       a->name.ptr + a->name.slen);
+        } else {
+            continue;
+        }
+
+        if (rd->ns_cnt == PJ_XML_READER_MAX_NS)
+            return reader_error(rd);
+
+        rd->ns[rd->ns_cnt].prefix = prefix;
+        rd->ns[rd->ns_cnt].uri = a->value;
+        rd->ns[rd->ns_cnt].depth = rd->depth;
+        ++rd->ns_cnt;
+    }
+    return PJ_SUCCESS;
+}
+
+/* Close the innermost element */
+static void pop_element(pj_xml_reader *rd, pj_xml_event *ev)
+{
+    ev->type = PJ_XML_EVENT_END;
+    ev->depth = rd->depth;
+    ev->name = rd->names[rd->depth-1];
+    resolve_ns(rd, ev);
+
+    while (rd->ns_cnt && rd->ns[rd->ns_cnt-1].depth == rd->depth)
+        --rd->ns_cnt;
+    --rd->depth;
+}
+
+/* Read the next event. */
+static pj_status_t xml_read_event(pj_xml_reader *rd, pj_xml_event *ev)
+{
+    pj_scanner *scanner = &rd->scanner;
+
+    if (rd->pending_end) {
+        rd->pending_end = PJ_FALSE;
+        pop_element(rd, ev);
+        return PJ_SUCCESS;
+    }
+
+    for (;;) {
+        if (pj_scan_is_eof(scanner) || *scanner->curptr != '<') {
+            /* Content is only valid inside an element */
+            if (rd->depth == 0)
+                return reader_error(rd);
+
+            pj_scan_get_until_ch(scanner, '<', &ev->text);
+            READER_CHECK(rd);
+
+            ev->type = PJ_XML_EVENT_TEXT;
+            ev->depth = rd->depth;
+            ev->name = rd->names[rd->depth-1];
+            resolve_ns(rd, ev);
+            return PJ_SUCCESS;
+        }
+
+        /* Skip Processing Instruction (PI) construct (i.e. "<?") */
+        if (*(scanner->curptr+1) == '?') {
+            pj_scan_advance_n(scanner, 2, PJ_FALSE);
+            for (;;) {
+                pj_str_t dummy;
+                pj_scan_get_until_ch(scanner, '?', &dummy);
+                READER_CHECK(rd);
+                if (*scanner->curptr=='?' && *(scanner->curptr+1)=='>') {
+                    pj_scan_advance_n(scanner, 2, PJ_TRUE);
+                    break;
+                } else {
+                    pj_scan_advance_n(scanner, 1, PJ_FALSE);
+                }
+            }
+            continue;
+        }
+
+        /* CDATA content. */
+        if (pj_scan_strcmp(scanner, "<![CDATA[", 9) == 0) {
+            if (rd->depth == 0)
+                return reader_error(rd);
+
+            pj_scan_advance_n(scanner, 9, PJ_FALSE);
+            pj_scan_get_until_ch(scanner, ']', &ev->text);
+            READER_CHECK(rd);
+            while (pj_scan_strcmp(scanner, "]]>", 3)) {
+                pj_str_t dummy;
+
+                pj_scan_advance_n(scanner, 1, PJ_FALSE);
+                pj_scan_get_until_ch(scanner, ']', &dummy);
+                READER_CHECK(rd);
+            }
+            ev->text.slen = scanner->curptr - ev->text.ptr;
+            pj_scan_advance_n(scanner, 3, PJ_TRUE);
+
+            ev->type = PJ_XML_EVENT_TEXT;
+            ev->depth = rd->depth;
+            ev->name = rd->names[rd->depth-1];
+            resolve_ns(rd, ev);
+            return PJ_SUCCESS;
+        }
+
+        /* Skip comments construct (i.e. "<!") */
+        if (*(scanner->curptr+1) == '!') {
+            pj_str_t dummy;
+
+            pj_scan_advance_n(scanner, 2, PJ_FALSE);
+            pj_scan_get_until_ch(scanner, '>', &dummy);
+            READER_CHECK(rd);
+            pj_scan_advance_n(scanner, 1, PJ_TRUE);
+            continue;
+        }
+
+        /* Enclosing node. */
+        if (*(scanner->curptr+1) == '/') {
+            pj_str_t end_name;
+
+            if (rd->depth == 0)
+                return reader_error(rd);
+
+            pj_scan_advance_n(scanner, 2, PJ_FALSE);
+            pj_scan_get_until_chr(scanner, " \t>", &end_name);
+            READER_CHECK(rd);
+
+            /* Compare name. */
+            if (pj_stricmp(&rd->names[rd->depth-1], &end_name) != 0)
+                return reader_error(rd);
+
+            /* Enclosing '>' */
+            if (pj_scan_get_char(scanner) != '>')
+                return reader_error(rd);
+
+            pop_element(rd, ev);
+            return PJ_SUCCESS;
+        }
+
+        /* Only one root element is allowed */
+        if (rd->depth == 0 && rd->has_root)
+            return reader_error(rd);
+        if (rd->depth == PJ_XML_READER_MAX_DEPTH)
+            return reader_error(rd);
+
+        /* Get '<' and node name. */
+        pj_scan_get_char(scanner);
+        pj_scan_get_until_chr(scanner, " />\t\r\n", &ev->name);
+        READER_CHECK(rd);
+
+        /* Get attributes. */
+        rd->attr_cnt = 0;
+        while (*scanner->curptr != '>' && *scanner->curptr != '/') {
+            pj_xml_reader_attr *attr;
+
+            if (rd->attr_cnt == PJ_XML_READER_MAX_ATTR)
+                return reader_error(rd);
+
+            attr = &rd->attr[rd->attr_cnt++];
+            pj_scan_get_until_chr(scanner, "=> \t\r\n", &attr->name);
+            READER_CHECK(rd);
+            if (*scanner->curptr == '=') {
+                pj_scan_get_char(scanner);
+                pj_scan_get_quotes(scanner, "\"'", "\"'", 2, &attr->value);
+                READER_CHECK(rd);
+                /* remove quote characters */
+                ++attr->value.ptr;
+                attr->value.slen -= 2;
+            } else {
+                attr->value.ptr = attr->name.ptr;
+                attr->value.slen = 0;
+            }
+        }
+
+        if (*scanner->curptr == '/') {
+            pj_scan_get_char(scanner);
+            rd->pending_end = PJ_TRUE;
+        }
+
+        /* Enclosing bracket. */
+        if (pj_scan_get_char(scanner) != '>')
+            return reader_error(rd);
+
+        rd->has_root = PJ_TRUE;
+        rd->names[rd->depth++] = ev->name;
+        if ((rd->options & PJ_XML_READER_NS) && push_ns(rd) != PJ_SUCCESS)
+            return PJLIB_UTIL_EINXML;
+
+        ev->type = PJ_XML_EVENT_START;
+        ev->depth = rd->depth;
+        ev->attr_cnt = rd->attr_cnt;
+        ev->attr = rd->attr;
+        resolve_ns(rd, ev);
+        return PJ_SUCCESS;
+    }
+}
+
+PJ_DEF(pj_status_t) pj_xml_reader_next(pj_xml_reader *rd,
+                                       pj_xml_event *ev)
+{
+    PJ_ASSERT_RETURN(rd && ev, PJ_EINVAL);
+
+    READER_CHECK(rd);
+
+    ev->attr_cnt = 0;
+    ev->attr = NULL;
+    ev->ns_uri.ptr = ev->text.ptr = NULL;
+    ev->ns_uri.slen = ev->text.slen = 0;
+
+    if (rd->depth == 0 && rd->has_root)
+        return PJ_EEOF;
+
+    return xml_read_event(rd, ev);
+}
+
+PJ_DEF(pj_status_t) pj_xml_reader_skip(pj_xml_reader *rd)
+{
+    unsigned depth;
+    pj_xml_event ev;
+
+    PJ_ASSERT_RETURN(rd && rd->depth, PJ_EINVALIDOP);
+
+    depth = rd->depth;
+    while (rd->depth >= depth) {
+        pj_status_t status = xml_read_event(rd, &ev);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(const pj_str_t*) pj_xml_event_find_attr(const pj_xml_event *ev,
+                                               const pj_str_t *name)
+{
+    unsigned i;
+
+    for (i=0; i<ev->attr_cnt; ++i) {
+        if (pj_stricmp(&ev->attr[i].name, name) == 0)
+            return &ev->attr[i].value;
+    }
+    return NULL;
+}
+
 /* This is a recursive function. */
 static int xml_print_node( const pj_xml_node *node, int indent, 
                            char *buf, pj_size_t len )
@@ -44,6 +44,7 @@
 #include <pjmedia/master_port.h>
 #include <pjmedia/mem_port.h>
 #include <pjmedia/null_port.h>
+#include <pjmedia/pcap_replay.h>
 #include <pjmedia/plc.h>
 #include <pjmedia/port.h>
 #include <pjmedia/resample.h>
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJMEDIA_PCAP_REPLAY_H__
+#define __PJMEDIA_PCAP_REPLAY_H__
+
+/**
+ * @file pcap_replay.h
+ * @brief Replay captured RTP/RTCP flows into media transports.
+ */
+
+#include <pjmedia/transport.h>
+#include <pjlib-util/pcap.h>
+
+/**
+ * @defgroup PJMEDIA_PCAP_REPLAY PCAP Replay
+ * @ingroup PJMEDIA_TRANSPORT
+ * @brief Replay all flows of a PCAP capture into media transports.
+ * @{
+ *
+ * The PCAP replay reads a capture opened with #pj_pcap_map() (or
+ * #pj_pcap_open()) and sends the packets of each flow to the media
+ * transport attached to that flow, with the original timing or scaled
+ * by a speed factor. A typical use is to attach every flow to a loop
+ * transport (see @ref PJMEDIA_TRANSPORT_LOOP) which has streams attached
+ * to it, to drive jitter buffers and decoders with real traffic.
+ *
+ * The replay does not create any thread. Application either calls
+ * #pjmedia_pcap_replay_poll() periodically, e.g. from its own worker or
+ * clock thread, or calls the blocking #pjmedia_pcap_replay_run().
+ */
+
+PJ_BEGIN_DECL
+
+/**
+ * Opaque declaration of PCAP replay.
+ */
+typedef struct pjmedia_pcap_replay pjmedia_pcap_replay;
+
+/**
+ * PCAP replay settings.
+ */
+typedef struct pjmedia_pcap_replay_param
+{
+    /**
+     * Replay speed, in percent of the original speed. For example,
+     * 200 replays twice as fast as captured. Zero sends the packets as
+     * fast as possible.
+     *
+     * Default: 100
+     */
+    unsigned            speed;
+
+} pjmedia_pcap_replay_param;
+
+
+/**
+ * Initialize PCAP replay settings with default values.
+ *
+ * @param param     The settings.
+ */
+PJ_DECL(void) pjmedia_pcap_replay_param_default(
+                                        pjmedia_pcap_replay_param *param);
+
+/**
+ * Create PCAP replay. The capture is scanned once to find all the flows
+ * in it (see #pj_pcap_get_flow_count() and #pj_pcap_get_flow()), then
+ * rewound. Any filter must be set in the file before calling this
+ * function. The file must be kept open while the replay is in use, and
+ * it must not be read by other parties.
+ *
+ * All memory is allocated from the pool, there is no need to destroy
+ * the replay.
+ *
+ * @param pool      Pool to allocate memory.
+ * @param file      The capture file.
+ * @param param     Optional settings, NULL for default.
+ * @param p_replay  Pointer to receive the replay.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjmedia_pcap_replay_create(
+                                        pj_pool_t *pool,
+                                        pj_pcap_file *file,
+                                        const pjmedia_pcap_replay_param *param,
+                                        pjmedia_pcap_replay **p_replay);
+
+/**
+ * Attach a flow of the capture to a media transport. RTCP flows are sent
+ * with #pjmedia_transport_send_rtcp(), other flows are sent with
+ * #pjmedia_transport_send_rtp(). Packets of flows without transport are
+ * skipped. The same transport may be attached to more than one flow.
+ *
+ * @param replay    The replay.
+ * @param flow      Flow index.
+ * @param tp        The transport, or NULL to detach the flow.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjmedia_pcap_replay_attach(pjmedia_pcap_replay *replay,
+                                                unsigned flow,
+                                                pjmedia_transport *tp);
+
+/**
+ * Send all packets which are due. The replay clock starts on the first
+ * call.
+ *
+ * @param replay    The replay.
+ * @param next_delay Optional pointer to receive the time until the next
+ *                  packet is due.
+ *
+ * @return          PJ_SUCCESS if there are more packets to send, PJ_EEOF
+ *                  when the whole capture has been replayed, or the
+ *                  appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjmedia_pcap_replay_poll(pjmedia_pcap_replay *replay,
+                                              pj_time_val *next_delay);
+
+/**
+ * Replay the whole capture, sleeping between packets as needed. This
+ * function blocks until all packets have been sent.
+ *
+ * @param replay    The replay.
+ *
+ * @return          PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjmedia_pcap_replay_run(pjmedia_pcap_replay *replay);
+
+/**
+ * Get the number of packets sent so far.
+ *
+ * @param replay    The replay.
+ *
+ * @return          Number of packets sent.
+ */
+PJ_DECL(unsigned) pjmedia_pcap_replay_get_sent(pjmedia_pcap_replay *replay);
+
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif  /* __PJMEDIA_PCAP_REPLAY_H__ */
@@ -25,6 +25,7 @@
 #include <pjmedia/silencedet.h>
 #include <pjmedia/sound_port.h>
 #include <pjmedia/stereo.h>
+#include <pjlib-util/metrics.h>
 #include <pj/array.h>
 #include <pj/assert.h>
 #include <pj/log.h>
@@ -254,6 +255,9 @@ struct pjmedia_conf
 
     op_entry             *op_queue;     /**< Queue of operations.           */
     op_entry             *op_queue_free;/**< Queue of free entries.         */
+
+    pj_metric            *m_ports;      /**< Port count gauge, shared by all
+                                             conference bridges.            */
 };
 
 
@@ -718,6 +722,7 @@ static pj_status_t create_sound_port( pj_pool_t *pool,
      /* Add the port to the bridge */
     conf->ports[0] = conf_port;
     conf->port_cnt++;
+    pj_metric_inc(conf->m_ports);
 
     return PJ_SUCCESS;
 }
@@ -769,6 +774,12 @@ PJ_DEF(pj_status_t) pjmedia_conf_create( pj_pool_t *pool_,
     conf->samples_per_frame = samples_per_frame;
     conf->bits_per_sample = bits_per_sample;
 
+    if (pj_metrics_get_default()) {
+        pj_metrics_add_gauge(pj_metrics_get_default(), "pjmedia_conf_ports",
+                             "Number of conference bridge ports",
+                             &conf->m_ports);
+    }
+
     
     /* Create and initialize the master port interface. */
     conf->master_port = PJ_POOL_ZALLOC_T(pool, pjmedia_port);
@@ -1064,6 +1075,7 @@ static void op_add_port(pjmedia_conf *conf, const op_param *prm)
     /* Activate newly added port */
     cport->is_new = PJ_FALSE;
     ++conf->port_cnt;
+    pj_metric_inc(conf->m_ports);
 
     PJ_LOG(4,(THIS_FILE, "Added port %d (%.*s), port count=%d",
               port, (int)cport->name.slen, cport->name.ptr, conf->port_cnt));
@@ -1161,6 +1173,7 @@ PJ_DEF(pj_status_t) pjmedia_conf_add_passive_port( pjmedia_conf *conf,
     /* Put the port. */
     conf->ports[index] = conf_port;
     conf->port_cnt++;
+    pj_metric_inc(conf->m_ports);
 
     /* Done. */
     if (p_slot)
@@ -1804,8 +1817,10 @@ static void op_remove_port(pjmedia_conf *conf, const op_param *prm)
     conf->ports[port] = NULL;
     pj_mutex_unlock(conf->mutex);
 
-    if (!conf_port->is_new)
+    if (!conf_port->is_new) {
         --conf->port_cnt;
+        pj_metric_add(conf->m_ports, -1);
+    }
 
     PJ_LOG(4,(THIS_FILE,"Removed port %d (%.*s), port count=%d",
               port, (int)conf_port->name.slen, conf_port->name.ptr,
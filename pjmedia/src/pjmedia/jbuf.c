@@ -21,6 +21,7 @@
  */
 #include <pjmedia/jbuf.h>
 #include <pjmedia/errno.h>
+#include <pjlib-util/metrics.h>
 #include <pj/pool.h>
 #include <pj/assert.h>
 #include <pj/log.h>
@@ -151,6 +152,12 @@ struct pjmedia_jbuf
     unsigned        jb_discard;         /**< Number of discarded frames.    */
     unsigned        jb_empty;           /**< Number of empty/prefetching frame
                                              returned by GET. */
+
+    /* Metrics, shared by all jitter buffers */
+    pj_metric      *m_frames;           /**< Frames stored by PUT           */
+    pj_metric      *m_lost;             /**< Lost frames                    */
+    pj_metric      *m_discard;          /**< Discarded frames               */
+    pj_metric      *m_delay;            /**< Delay histogram (in ms)        */
 };
 
 
@@ -590,6 +597,33 @@ enum pjmedia_jb_op
 };
 
 
+/* Get the jitter buffer metrics from the default registry */
+static void jbuf_init_metrics(pjmedia_jbuf *jb)
+{
+    static const pj_int64_t delay_bounds[] =
+    {
+        20, 40, 60, 80, 100, 150, 200, 300, 500, 1000
+    };
+    pj_metrics *metrics = pj_metrics_get_default();
+
+    if (!metrics)
+        return;
+
+    pj_metrics_add_counter(metrics, "pjmedia_jbuf_frames_total",
+                           "Number of frames stored in jitter buffers",
+                           &jb->m_frames);
+    pj_metrics_add_counter(metrics, "pjmedia_jbuf_lost_total",
+                           "Number of frames lost in jitter buffers",
+                           &jb->m_lost);
+    pj_metrics_add_counter(metrics, "pjmedia_jbuf_discard_total",
+                           "Number of frames discarded by jitter buffers",
+                           &jb->m_discard);
+    pj_metrics_add_histogram(metrics, "pjmedia_jbuf_delay_ms",
+                             "Jitter buffer delay in milliseconds",
+                             PJ_ARRAY_SIZE(delay_bounds), delay_bounds,
+                             &jb->m_delay);
+}
+
 PJ_DEF(pj_status_t) pjmedia_jbuf_create(pj_pool_t *pool,
                                         const pj_str_t *name,
                                         unsigned frame_size,
@@ -620,6 +654,8 @@ PJ_DEF(pj_status_t) pjmedia_jbuf_create(pj_pool_t *pool,
     pj_math_stat_init(&jb->jb_delay);
     pj_math_stat_init(&jb->jb_burst);
 
+    jbuf_init_metrics(jb);
+
     pjmedia_jbuf_set_discard(jb, PJMEDIA_JB_DISCARD_PROGRESSIVE);
     pjmedia_jbuf_reset(jb);
 
@@ -880,6 +916,7 @@ static void jbuf_discard_static(pjmedia_jbuf *jb)
             diff = jb_framelist_remove_head(&jb->jb_framelist, diff);
             jb->jb_discard_ref = jb_framelist_origin(&jb->jb_framelist);
             jb->jb_discard += diff;
+            pj_metric_add(jb->m_discard, diff);
 
             TRACE__((jb->jb_name.ptr,
                      "JB shrinking %d frame(s), cur size=%d", diff,
@@ -1073,6 +1110,7 @@ PJ_DEF(void) pjmedia_jbuf_put_frame3(pjmedia_jbuf *jb,
                                      PJMEDIA_JB_NORMAL_FRAME);
 
         jb->jb_discard += removed;
+        pj_metric_add(jb->m_discard, removed);
     }
 
     /* Get new JB size after PUT */
@@ -1091,8 +1129,11 @@ PJ_DEF(void) pjmedia_jbuf_put_frame3(pjmedia_jbuf *jb,
         }
         jb->jb_level += (new_size > cur_size ? new_size-cur_size : 1);
         jbuf_update(jb, JB_OP_PUT);
-    } else
+        pj_metric_inc(jb->m_frames);
+    } else {
         jb->jb_discard++;
+        pj_metric_inc(jb->m_discard);
+    }
 }
 
 /*
@@ -1163,17 +1204,19 @@ PJ_DEF(void) pjmedia_jbuf_get_frame3(pjmedia_jbuf *jb,
             } else {
                 *p_frame_type = PJMEDIA_JB_MISSING_FRAME;
                 jb->jb_lost++;
+                pj_metric_inc(jb->m_lost);
             }
 
             /* Store delay history at the first GET */
             if (jb->jb_last_op == JB_OP_PUT) {
-                unsigned cur_size;
+                unsigned cur_size, delay;
 
                 /* We've just retrieved one frame, so add one to cur_size */
                 cur_size = jb_framelist_eff_size(&jb->jb_framelist) + 1;
-                pj_math_stat_update(&jb->jb_delay,
-                                    cur_size * jb->jb_frame_ptime /
-                                    jb->jb_frame_ptime_denum);
+                delay = cur_size * jb->jb_frame_ptime /
+                        jb->jb_frame_ptime_denum;
+                pj_math_stat_update(&jb->jb_delay, delay);
+                pj_metric_observe(jb->m_delay, delay);
             }
         } else {
             /* Jitter buffer is empty */
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pjmedia/pcap_replay.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+#define THIS_FILE   "pcap_replay.c"
+
+struct pjmedia_pcap_replay
+{
+    pj_pcap_file        *file;
+    pjmedia_pcap_replay_param param;
+
+    /* Transport of each flow, indexed by flow index */
+    pjmedia_transport  **tp;
+    unsigned             flow_cnt;
+
+    /* Capture time of the first packet, in usec */
+    pj_uint64_t          first_ts;
+
+    /* Replay clock */
+    pj_bool_t            started;
+    pj_timestamp         start_time;
+
+    /* The next packet to send */
+    pj_pcap_udp_pkt      pkt;
+    pj_bool_t            has_pkt;
+    pj_bool_t            eof;
+
+    /* The payload is copied here before sending, since the receiver
+     * (e.g. SRTP) may modify the packet in place while the capture may
+     * be mapped read-only.
+     */
+    pj_uint8_t          *buf;
+    pj_size_t            buf_size;
+
+    unsigned             sent;
+};
+
+
+static pj_uint64_t pkt_ts(const pj_pcap_udp_pkt *pkt)
+{
+    return (pj_uint64_t)pkt->ts_sec * 1000000 + pkt->ts_usec;
+}
+
+PJ_DEF(void) pjmedia_pcap_replay_param_default(
+                                        pjmedia_pcap_replay_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->speed = 100;
+}
+
+PJ_DEF(pj_status_t) pjmedia_pcap_replay_create(
+                                        pj_pool_t *pool,
+                                        pj_pcap_file *file,
+                                        const pjmedia_pcap_replay_param *param,
+                                        pjmedia_pcap_replay **p_replay)
+{
+    pjmedia_pcap_replay *rp;
+    pj_pcap_udp_pkt pkt;
+    pj_bool_t first = PJ_TRUE;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && file && p_replay, PJ_EINVAL);
+
+    rp = PJ_POOL_ZALLOC_T(pool, pjmedia_pcap_replay);
+    rp->file = file;
+    if (param)
+        pj_memcpy(&rp->param, param, sizeof(*param));
+    else
+        pjmedia_pcap_replay_param_default(&rp->param);
+
+    /* Scan the capture to find the flows and the largest packet */
+    while ((status = pj_pcap_read_udp_pkt(file, &pkt)) == PJ_SUCCESS) {
+        pj_uint64_t ts = pkt_ts(&pkt);
+
+        if (first || ts < rp->first_ts) {
+            rp->first_ts = ts;
+            first = PJ_FALSE;
+        }
+        if (pkt.payload_len > rp->buf_size)
+            rp->buf_size = pkt.payload_len;
+    }
+    if (status != PJ_EEOF)
+        return status;
+
+    status = pj_pcap_rewind(file);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    rp->flow_cnt = pj_pcap_get_flow_count(file);
+    if (rp->flow_cnt) {
+        rp->tp = (pjmedia_transport**)
+                 pj_pool_calloc(pool, rp->flow_cnt, sizeof(rp->tp[0]));
+    }
+    rp->buf = (pj_uint8_t*)pj_pool_alloc(pool, rp->buf_size + 1);
+
+    PJ_LOG(5,(THIS_FILE, "PCAP replay created, %d flow(s)", rp->flow_cnt));
+
+    *p_replay = rp;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjmedia_pcap_replay_attach(pjmedia_pcap_replay *rp,
+                                               unsigned flow,
+                                               pjmedia_transport *tp)
+{
+    PJ_ASSERT_RETURN(rp, PJ_EINVAL);
+    PJ_ASSERT_RETURN(flow < rp->flow_cnt, PJ_EINVAL);
+
+    rp->tp[flow] = tp;
+    return PJ_SUCCESS;
+}
+
+/* Send the pending packet */
+static void send_pkt(pjmedia_pcap_replay *rp)
+{
+    const pj_pcap_flow *flow = pj_pcap_get_flow(rp->file, rp->pkt.flow);
+    pjmedia_transport *tp = rp->tp[rp->pkt.flow];
+    pj_status_t status;
+
+    pj_memcpy(rp->buf, rp->pkt.payload, rp->pkt.payload_len);
+
+    if (flow->type == PJ_PCAP_FLOW_RTCP) {
+        status = pjmedia_transport_send_rtcp(tp, rp->buf,
+                                             rp->pkt.payload_len);
+    } else {
+        status = pjmedia_transport_send_rtp(tp, rp->buf,
+                                            rp->pkt.payload_len);
+    }
+
+    if (status == PJ_SUCCESS) {
+        ++rp->sent;
+    } else {
+        PJ_PERROR(5,(THIS_FILE, status, "Error sending flow %d packet",
+                     rp->pkt.flow));
+    }
+}
+
+PJ_DEF(pj_status_t) pjmedia_pcap_replay_poll(pjmedia_pcap_replay *rp,
+                                             pj_time_val *next_delay)
+{
+    pj_uint64_t elapsed = 0;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(rp, PJ_EINVAL);
+
+    if (next_delay)
+        next_delay->sec = next_delay->msec = 0;
+
+    if (rp->eof)
+        return PJ_EEOF;
+
+    if (!rp->started) {
+        pj_get_timestamp(&rp->start_time);
+        rp->started = PJ_TRUE;
+    }
+
+    if (rp->param.speed) {
+        pj_timestamp now;
+
+        pj_get_timestamp(&now);
+        elapsed = pj_elapsed_msec64(&rp->start_time, &now);
+    }
+
+    for (;;) {
+        if (!rp->has_pkt) {
+            status = pj_pcap_read_udp_pkt(rp->file, &rp->pkt);
+            if (status == PJ_EEOF) {
+                rp->eof = PJ_TRUE;
+                return PJ_EEOF;
+            } else if (status != PJ_SUCCESS) {
+                return status;
+            }
+
+            /* Skip flows without transport */
+            if (rp->pkt.flow >= rp->flow_cnt || !rp->tp[rp->pkt.flow])
+                continue;
+
+            rp->has_pkt = PJ_TRUE;
+        }
+
+        if (rp->param.speed) {
+            pj_uint64_t due = 0;
+
+            if (pkt_ts(&rp->pkt) > rp->first_ts) {
+                due = (pkt_ts(&rp->pkt) - rp->first_ts) * 100 /
+                      rp->param.speed / 1000;
+            }
+            if (due > elapsed) {
+                if (next_delay) {
+                    next_delay->sec = (long)((due - elapsed) / 1000);
+                    next_delay->msec = (long)((due - elapsed) % 1000);
+                }
+                return PJ_SUCCESS;
+            }
+        }
+
+        send_pkt(rp);
+        rp->has_pkt = PJ_FALSE;
+    }
+}
+
+PJ_DEF(pj_status_t) pjmedia_pcap_replay_run(pjmedia_pcap_replay *rp)
+{
+    pj_time_val delay;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(rp, PJ_EINVAL);
+
+    while ((status = pjmedia_pcap_replay_poll(rp, &delay)) == PJ_SUCCESS) {
+        unsigned msec = PJ_TIME_VAL_MSEC(delay);
+
+        if (msec)
+            pj_thread_sleep(msec);
+    }
+
+    return (status == PJ_EEOF) ? PJ_SUCCESS : status;
+}
+
+PJ_DEF(unsigned) pjmedia_pcap_replay_get_sent(pjmedia_pcap_replay *rp)
+{
+    PJ_ASSERT_RETURN(rp, 0);
+    return rp->sent;
+}
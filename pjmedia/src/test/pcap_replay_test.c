@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE       "pcap_replay_test.c"
+#define PCAP_FILE       "pcap_replay_test.pcap"
+
+#define SSRC_A          0x1000
+#define SSRC_B          0x2000
+#define PKT_CNT         8       /* Per RTP flow                     */
+#define PTIME           10      /* Packet interval, in ms           */
+#define PAYLOAD_LEN     60
+
+/* Receiver attached to a loop transport */
+struct receiver
+{
+    unsigned    rtp_cnt;
+    unsigned    rtcp_cnt;
+    pj_uint32_t ssrc;
+    pj_bool_t   bad_ssrc;
+};
+
+static void put16(pj_uint8_t *p, unsigned v)
+{
+    p[0] = (pj_uint8_t)(v >> 8);
+    p[1] = (pj_uint8_t)v;
+}
+
+static void put32(pj_uint8_t *p, pj_uint32_t v)
+{
+    put16(p, v >> 16);
+    put16(p + 2, v & 0xFFFF);
+}
+
+/* Write Ethernet/IPv4/UDP record */
+static pj_status_t write_pkt(pj_oshandle_t fd, unsigned ts_msec,
+                             unsigned dst_port, pj_uint8_t pt,
+                             pj_uint32_t ssrc)
+{
+    pj_uint8_t buf[14 + 20 + 8 + PAYLOAD_LEN];
+    pj_uint32_t rec[4];
+    pj_uint8_t *p = buf;
+    pj_ssize_t sz;
+    pj_status_t status;
+
+    pj_bzero(buf, sizeof(buf));
+    put16(p + 12, 0x0800);
+    p += 14;
+
+    p[0] = 0x45;
+    put16(p + 2, 20 + 8 + PAYLOAD_LEN);
+    p[9] = 17;
+    put32(p + 12, 0x7f000001);
+    put32(p + 16, 0x7f000001);
+    p += 20;
+
+    put16(p, 4000);
+    put16(p + 2, dst_port);
+    put16(p + 4, 8 + PAYLOAD_LEN);
+    p += 8;
+
+    p[0] = 0x80;
+    p[1] = pt;
+    put32(p + 8, ssrc);
+
+    rec[0] = 1700000000 + ts_msec / 1000;
+    rec[1] = (ts_msec % 1000) * 1000;
+    rec[2] = rec[3] = sizeof(buf);
+
+    sz = sizeof(rec);
+    status = pj_file_write(fd, rec, &sz);
+    if (status != PJ_SUCCESS)
+        return status;
+    sz = sizeof(buf);
+    return pj_file_write(fd, buf, &sz);
+}
+
+static int write_capture(pj_pool_t *pool)
+{
+    pj_oshandle_t fd;
+    pj_uint32_t hdr[6] = { 0xa1b2c3d4, 2 | (4 << 16), 0, 0, 65535, 1 };
+    pj_ssize_t sz = sizeof(hdr);
+    unsigned i;
+    int rc = 0;
+
+    PJ_TEST_SUCCESS(pj_file_open(pool, PCAP_FILE, PJ_O_WRONLY, &fd), NULL,
+                    return 10);
+    PJ_TEST_SUCCESS(pj_file_write(fd, hdr, &sz), NULL,
+                    { rc = 11; goto on_return; });
+
+    /* Two interleaved RTP streams on the same ports, and RTCP */
+    for (i = 0; i < PKT_CNT; ++i) {
+        PJ_TEST_SUCCESS(write_pkt(fd, i * PTIME, 5000, 0, SSRC_A), NULL,
+                        { rc = 12; goto on_return; });
+        PJ_TEST_SUCCESS(write_pkt(fd, i * PTIME + 1, 5000, 8, SSRC_B), NULL,
+                        { rc = 13; goto on_return; });
+        if (i % 4 == 3) {
+            PJ_TEST_SUCCESS(write_pkt(fd, i * PTIME + 2, 5001, 200, SSRC_B),
+                            NULL, { rc = 14; goto on_return; });
+        }
+    }
+
+on_return:
+    pj_file_close(fd);
+    return rc;
+}
+
+static void on_rx_rtp(void *user_data, void *pkt, pj_ssize_t size)
+{
+    struct receiver *r = (struct receiver*)user_data;
+    const pj_uint8_t *p = (const pj_uint8_t*)pkt;
+    pj_uint32_t ssrc;
+
+    PJ_UNUSED_ARG(size);
+    ssrc = ((pj_uint32_t)p[8] << 24) | (p[9] << 16) | (p[10] << 8) | p[11];
+    if (ssrc != r->ssrc)
+        r->bad_ssrc = PJ_TRUE;
+    ++r->rtp_cnt;
+}
+
+static void on_rx_rtcp(void *user_data, void *pkt, pj_ssize_t size)
+{
+    struct receiver *r = (struct receiver*)user_data;
+
+    PJ_UNUSED_ARG(pkt);
+    PJ_UNUSED_ARG(size);
+    ++r->rtcp_cnt;
+}
+
+static int replay(pjmedia_endpt *endpt, pj_pool_t *pool, unsigned speed,
+                  pj_uint32_t *duration)
+{
+    pj_pcap_file *file;
+    pjmedia_pcap_replay *rp;
+    pjmedia_pcap_replay_param prm;
+    pjmedia_transport *tp[2] = { NULL, NULL };
+    struct receiver rcv[2];
+    pj_sockaddr addr;
+    pj_timestamp t0, t1;
+    unsigned i;
+    int rc = 0;
+
+    PJ_TEST_SUCCESS(pj_pcap_map(pool, PCAP_FILE, &file), NULL, return 20);
+
+    pjmedia_pcap_replay_param_default(&prm);
+    prm.speed = speed;
+    PJ_TEST_SUCCESS(pjmedia_pcap_replay_create(pool, file, &prm, &rp), NULL,
+                    { rc = 21; goto on_return; });
+    PJ_TEST_EQ(pj_pcap_get_flow_count(file), 3, NULL,
+               { rc = 22; goto on_return; });
+
+    pj_bzero(rcv, sizeof(rcv));
+    pj_sockaddr_init(pj_AF_INET(), &addr, NULL, 4000);
+    for (i = 0; i < 2; ++i) {
+        PJ_TEST_SUCCESS(pjmedia_transport_loop_create(endpt, &tp[i]), NULL,
+                        { rc = 23; goto on_return; });
+        PJ_TEST_SUCCESS(pjmedia_transport_attach(tp[i], &rcv[i], &addr,
+                                                 &addr, sizeof(addr),
+                                                 &on_rx_rtp, &on_rx_rtcp),
+                        NULL, { rc = 24; goto on_return; });
+    }
+
+    /* Each RTP stream goes to its own receiver */
+    for (i = 0; i < pj_pcap_get_flow_count(file); ++i) {
+        const pj_pcap_flow *f = pj_pcap_get_flow(file, i);
+        unsigned idx = (f->ssrc == SSRC_A) ? 0 : 1;
+
+        if (f->type == PJ_PCAP_FLOW_RTP)
+            rcv[idx].ssrc = f->ssrc;
+        PJ_TEST_SUCCESS(pjmedia_pcap_replay_attach(rp, i, tp[idx]), NULL,
+                        { rc = 25; goto on_return; });
+    }
+
+    pj_get_timestamp(&t0);
+    PJ_TEST_SUCCESS(pjmedia_pcap_replay_run(rp), NULL,
+                    { rc = 26; goto on_return; });
+    pj_get_timestamp(&t1);
+    *duration = pj_elapsed_msec(&t0, &t1);
+
+    PJ_TEST_EQ(pjmedia_pcap_replay_get_sent(rp), 2 * PKT_CNT + PKT_CNT / 4,
+               NULL, { rc = 27; goto on_return; });
+    PJ_TEST_EQ(rcv[0].rtp_cnt, PKT_CNT, NULL, { rc = 28; goto on_return; });
+    PJ_TEST_EQ(rcv[1].rtp_cnt, PKT_CNT, NULL, { rc = 29; goto on_return; });
+    PJ_TEST_EQ(rcv[0].rtcp_cnt, 0, NULL, { rc = 30; goto on_return; });
+    PJ_TEST_EQ(rcv[1].rtcp_cnt, PKT_CNT / 4, NULL,
+               { rc = 31; goto on_return; });
+    PJ_TEST_TRUE(!rcv[0].bad_ssrc && !rcv[1].bad_ssrc, NULL,
+                 { rc = 32; goto on_return; });
+    PJ_TEST_EQ(pjmedia_pcap_replay_poll(rp, NULL), PJ_EEOF, NULL,
+               { rc = 33; goto on_return; });
+
+on_return:
+    for (i = 0; i < 2; ++i) {
+        if (tp[i])
+            pjmedia_transport_close(tp[i]);
+    }
+    pj_pcap_close(file);
+    return rc;
+}
+
+int pcap_replay_test(void)
+{
+    pj_pool_t *pool;
+    pjmedia_endpt *endpt = NULL;
+    pj_uint32_t duration;
+    int rc;
+
+    pool = pj_pool_create(mem, "pcaprp", 1000, 1000, NULL);
+
+    PJ_TEST_SUCCESS(pjmedia_endpt_create(mem, NULL, 0, &endpt), NULL,
+                    { rc = 1; goto on_return; });
+
+    rc = write_capture(pool);
+    if (rc)
+        goto on_return;
+
+    /* As fast as possible */
+    rc = replay(endpt, pool, 0, &duration);
+    if (rc)
+        goto on_return;
+    PJ_LOG(3,(THIS_FILE, "  full speed replay: %u ms", duration));
+
+    /* Original timing, the capture spans (PKT_CNT-1)*PTIME+2 ms */
+    rc = replay(endpt, pool, 100, &duration);
+    if (rc)
+        goto on_return;
+    PJ_LOG(3,(THIS_FILE, "  original speed replay: %u ms", duration));
+    PJ_TEST_GTE(duration, (PKT_CNT - 1) * PTIME - PTIME, NULL,
+                { rc = 40; goto on_return; });
+
+on_return:
+    pj_file_delete(PCAP_FILE);
+    if (endpt)
+        pjmedia_endpt_destroy(endpt);
+    pj_pool_release(pool);
+    return rc;
+}
@@ -111,6 +111,9 @@ int test_main(int argc, char *argv[])
 #if HAS_CODEC_VECTOR_TEST
     UT_ADD_TEST(&test_app.ut_app, codec_test_vectors, 0);
 #endif
+#if HAS_PCAP_REPLAY_TEST
+    UT_ADD_TEST(&test_app.ut_app, pcap_replay_test, 0);
+#endif
 
     if (ut_run_tests(&test_app.ut_app, "pjmedia tests", argc, argv)) {
         rc = 99;
@@ -33,6 +33,9 @@ static struct global_struct
     pj_bool_t            quit_flag;
 
     pj_bool_t            record_route;
+    unsigned             fwd_options;
+    unsigned             fwd_cnt;
+    pj_time_val          start_time;
 
     unsigned             name_cnt;
     pjsip_host_port      name[16];
@@ -55,6 +58,7 @@ static void usage(void)
          "\n"
          " -p, --port N       Set local listener port to N\n"
          " -R, --rr           Perform record routing\n"
+         " -Z, --zero-copy    Forward messages with PJSIP_FWD_ZERO_COPY\n"
          " -L, --log-level N  Set log level to N (default: 4)\n"
          " -h, --help         Show this help screen\n"
          );
@@ -66,6 +70,7 @@ static pj_status_t init_options(int argc, char *argv[])
     struct pj_getopt_option long_opt[] = {
         { "port",       1, 0, 'p'},
         { "rr",         0, 0, 'R'},
+        { "zero-copy",  0, 0, 'Z'},
         { "log-level",  1, 0, 'L'},
         { "help",       0, 0, 'h'},
         { NULL,         0, 0, 0}
@@ -74,7 +79,7 @@ static pj_status_t init_options(int argc, char *argv[])
     int opt_ind;
 
     pj_optind = 0;
-    while((c=pj_getopt_long(argc, argv, "p:L:Rh", long_opt, &opt_ind))!=-1) {
+    while((c=pj_getopt_long(argc, argv, "p:L:RZh", long_opt, &opt_ind))!=-1) {
         switch (c) {
         case 'p':
             global.port = atoi(pj_optarg);
@@ -86,6 +91,11 @@ static pj_status_t init_options(int argc, char *argv[])
             printf("Using record route mode\n");
             break;
 
+        case 'Z':
+            global.fwd_options |= PJSIP_FWD_ZERO_COPY;
+            printf("Using zero-copy forwarding\n");
+            break;
+
         case 'L':
             pj_log_set_level(atoi(pj_optarg));
             break;
@@ -305,10 +315,38 @@ static pj_status_t init_proxy(void)
         PJ_LOG(3,(THIS_FILE, "Using Record-Route mode"));
     }
 
+    if (global.fwd_options & PJSIP_FWD_ZERO_COPY) {
+        PJ_LOG(3,(THIS_FILE, "Using zero-copy forwarding"));
+    }
+
+    pj_gettimeofday(&global.start_time);
+
     return PJ_SUCCESS;
 }
 
 
+/* Display the number of forwarded messages and the throughput, to compare
+ * forwarding with and without --zero-copy.
+ */
+static void dump_fwd_stat(void)
+{
+    pj_time_val now;
+    unsigned msec;
+
+    pj_gettimeofday(&now);
+    PJ_TIME_VAL_SUB(now, global.start_time);
+    msec = PJ_TIME_VAL_MSEC(now);
+    if (msec == 0)
+        msec = 1;
+
+    PJ_LOG(3,(THIS_FILE, "Forwarded %u messages in %u.%03us (%u msg/sec, "
+                         "zero-copy %s)",
+              global.fwd_cnt, msec / 1000, msec % 1000,
+              (unsigned)((pj_uint64_t)global.fwd_cnt * 1000 / msec),
+              (global.fwd_options & PJSIP_FWD_ZERO_COPY) ? "on" : "off"));
+}
+
+
 #if PJ_HAS_THREADS
 static int worker_thread(void *p)
 {
@@ -124,7 +124,8 @@ static pj_bool_t proxy_on_rx_request( pjsip_rx_data *rdata )
          * Request looks sane, next clone the request to create transmit data.
          */
         status = pjsip_endpt_create_request_fwd(global.endpt, rdata, NULL,
-                                                NULL, 0, &tdata);
+                                                NULL, global.fwd_options,
+                                                &tdata);
         if (status != PJ_SUCCESS) {
             pjsip_endpt_respond_stateless(global.endpt, rdata,
                                           PJSIP_SC_INTERNAL_SERVER_ERROR, 
@@ -132,6 +133,7 @@ static pj_bool_t proxy_on_rx_request( pjsip_rx_data *rdata )
             return PJ_TRUE;
         }
 
+        ++global.fwd_cnt;
 
         /* Process routing */
         status = proxy_process_routing(tdata);
@@ -303,12 +305,15 @@ static pj_bool_t proxy_on_rx_response( pjsip_rx_data *rdata )
     pj_status_t status;
 
     /* Create response to be forwarded upstream (Via will be stripped here) */
-    status = pjsip_endpt_create_response_fwd(global.endpt, rdata, 0, &tdata);
+    status = pjsip_endpt_create_response_fwd(global.endpt, rdata,
+                                             global.fwd_options, &tdata);
     if (status != PJ_SUCCESS) {
         app_perror("Error creating response", status);
         return PJ_TRUE;
     }
 
+    ++global.fwd_cnt;
+
     /* Get topmost Via header */
     hvia = (pjsip_via_hdr*) pjsip_msg_find_hdr(tdata->msg, PJSIP_H_VIA, NULL);
     if (hvia == NULL) {
@@ -401,13 +406,15 @@ static void tu_on_tsx_state(pjsip_transaction *tsx, pjsip_event *event)
         /* Create response to be forwarded upstream 
          * (Via will be stripped here) 
          */
-        status = pjsip_endpt_create_response_fwd(global.endpt, rdata, 0, 
-                                                 &tdata);
+        status = pjsip_endpt_create_response_fwd(global.endpt, rdata,
+                                                 global.fwd_options, &tdata);
         if (status != PJ_SUCCESS) {
             app_perror("Error creating response", status);
             return;
         }
 
+        ++global.fwd_cnt;
+
         /* Get topmost Via header of the new response */
         hvia = (pjsip_via_hdr*) pjsip_msg_find_hdr(tdata->msg, PJSIP_H_VIA, 
                                                    NULL);
@@ -566,6 +573,7 @@ int main(int argc, char *argv[])
         } else if (line[0] == 'd') {
             pj_bool_t detail = (line[1] == 'd');
             pjsip_endpt_dump(global.endpt, detail);
+            dump_fwd_stat();
             pjsip_tsx_layer_dump(detail);
         }
     }
@@ -366,6 +366,33 @@ PJ_DECL(pj_status_t) pjsip_pres_parse_pidf2(char *body, unsigned body_len,
                                             pjsip_pres_status *status);
 
 
+/**
+ * This is a lightweight version of pjsip_pres_parse_pidf2(), which extracts
+ * only the tuple id, contact, basic status and note fields from the PIDF
+ * body using the XML pull reader, without building the XML tree of the
+ * document. Since no tree is built, the \a tuple_node field of the
+ * presence status will be set to NULL. Of the RPID information, only the
+ * note is extracted. This is useful for handling large presence documents
+ * such as resource list NOTIFY requests.
+ *
+ * @param body          Text body, with one extra space at the end to place
+ *                      NULL character temporarily during parsing.
+ * @param body_len      Length of the body, not including the NULL termination
+ *                      character.
+ * @param pool          Pool to allocate memory to copy the strings into
+ *                      the presence status structure.
+ * @param status        The presence status to be initialized.
+ *
+ * @return              PJ_SUCCESS on success.
+ *
+ * @see pjsip_pres_parse_pidf2()
+ */
+PJ_DECL(pj_status_t) pjsip_pres_parse_pidf_basic(char *body,
+                                                 unsigned body_len,
+                                                 pj_pool_t *pool,
+                                                 pjsip_pres_status *status);
+
+
 /**
  * This is a utility function to parse X-PIDF body into PJSIP presence status.
  *
@@ -502,6 +502,144 @@ PJ_DECL(pj_status_t) pjsip_regc_send(pjsip_regc *regc, pjsip_tx_data *tdata);
 PJ_DECL(pj_status_t) pjsip_regc_set_auth_sess( pjsip_regc *regc,
                                               pjsip_auth_clt_sess *session );
 
+
+/**
+ * Opaque declaration of registration scheduler. A registration scheduler
+ * sends the REGISTER requests of many client registrations at a limited
+ * rate, so that they don't reach the registrar at the same time, e.g.
+ * when the application starts or when their refreshes are due together.
+ */
+typedef struct pjsip_regc_sched pjsip_regc_sched;
+
+/**
+ * Registration scheduler settings.
+ */
+typedef struct pjsip_regc_sched_param
+{
+    /**
+     * Maximum number of REGISTER requests that the scheduler sends per
+     * second. Zero means no limit.
+     *
+     * Default: PJSIP_REGC_SCHED_MAX_RATE
+     */
+    unsigned    max_rate;
+
+    /**
+     * Maximum random delay, in milliseconds, of registrations that are
+     * queued with #pjsip_regc_sched_register(). Retries of failed
+     * registrations are not delayed.
+     *
+     * Default: PJSIP_REGC_SCHED_INIT_JITTER
+     */
+    unsigned    init_jitter;
+
+    /**
+     * Maximum part of the refresh interval, in percent, that is randomly
+     * taken off the automatic registration refreshes, so that refreshes
+     * of registrations made at the same time are spread.
+     *
+     * Default: PJSIP_REGC_SCHED_REFRESH_JITTER
+     */
+    unsigned    refresh_jitter;
+
+} pjsip_regc_sched_param;
+
+/**
+ * Registration scheduler information.
+ */
+typedef struct pjsip_regc_sched_info
+{
+    unsigned    queue_cnt;  /**< Number of queued registrations, including
+                                 the retries.                           */
+    unsigned    retry_cnt;  /**< Number of queued registrations that
+                                 retry a failed registration.           */
+    unsigned    sent_cnt;   /**< Number of registrations sent by the
+                                 scheduler.                             */
+} pjsip_regc_sched_info;
+
+
+/**
+ * Initialize registration scheduler settings with default values.
+ *
+ * @param param     The settings to initialize.
+ */
+PJ_DECL(void) pjsip_regc_sched_param_default(pjsip_regc_sched_param *param);
+
+/**
+ * Create a registration scheduler.
+ *
+ * @param endpt     The endpoint instance.
+ * @param param     The settings, or NULL to use default settings.
+ * @param p_sched   Pointer to receive the scheduler.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_regc_sched_create(
+                                        pjsip_endpoint *endpt,
+                                        const pjsip_regc_sched_param *param,
+                                        pjsip_regc_sched **p_sched);
+
+/**
+ * Destroy a registration scheduler. Registrations that are still queued
+ * are dropped. Client registrations that use the scheduler must have been
+ * destroyed or detached from the scheduler before this function is
+ * called.
+ *
+ * @param sched     The scheduler.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_regc_sched_destroy(pjsip_regc_sched *sched);
+
+/**
+ * Get the information of a registration scheduler, such as its queue
+ * depth.
+ *
+ * @param sched     The scheduler.
+ * @param info      Pointer to receive the information.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_regc_sched_get_info(pjsip_regc_sched *sched,
+                                               pjsip_regc_sched_info *info);
+
+/**
+ * Attach the client registration to a registration scheduler, or detach
+ * it if \a sched is NULL. Once attached, automatic registration refreshes
+ * are spread with the scheduler's \a refresh_jitter and are sent through
+ * the scheduler's queue.
+ *
+ * @param regc      The client registration structure.
+ * @param sched     The scheduler, or NULL.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_regc_set_sched(pjsip_regc *regc,
+                                          pjsip_regc_sched *sched);
+
+/**
+ * Queue a registration in the scheduler that the client registration is
+ * attached to. The REGISTER request is created and sent by the scheduler,
+ * as #pjsip_regc_register() and #pjsip_regc_send() would, and the result
+ * is reported to the registration callback.
+ *
+ * If the last registration of the client failed, the registration is
+ * queued as a retry, and retries are sent before other queued
+ * registrations. Otherwise it is delayed randomly up to the scheduler's
+ * \a init_jitter. If the registration is already queued, only the
+ * \a autoreg setting is updated.
+ *
+ * @param regc      The client registration structure.
+ * @param autoreg   If non zero, the library will automatically refresh
+ *                  the next registration until application unregister.
+ *
+ * @return          PJ_SUCCESS if the registration has been queued, or
+ *                  PJ_EINVALIDOP if the client is not attached to a
+ *                  scheduler.
+ */
+PJ_DECL(pj_status_t) pjsip_regc_sched_register(pjsip_regc *regc,
+                                               pj_bool_t autoreg);
+
 PJ_END_DECL
 
 /**
@@ -254,6 +254,13 @@ typedef struct pjsip_cached_auth
 #endif
     pjsip_auth_algorithm_type    challenge_algorithm_type; /**< Challenge
                                                                 algorithm   */
+    const pjsip_cred_info       *ha1_cred;  /**< Credential of cached ha1.  */
+    pj_ssize_t                   ha1_len;   /**< Length of cached ha1.      */
+    char                         ha1[PJSIP_AUTH_MAX_DIGEST_BUFFER_LENGTH * 2];
+                                            /**< The "ha1" of ha1_cred for
+                                                 the realm and algorithm, so
+                                                 the password isn't hashed
+                                                 for every request.         */
 } pjsip_cached_auth;
 
 
@@ -276,9 +283,36 @@ typedef struct pjsip_auth_clt_pref
      */
     pj_str_t    algorithm;
 
+    /**
+     * If this flag is set, the authentication client framework will
+     * send an Authorization header created from the last challenge of
+     * each realm in new requests, to avoid being challenged again. This
+     * is always done if PJSIP_AUTH_AUTO_SEND_NEXT is enabled.
+     * Default is no.
+     */
+    pj_bool_t   auto_send_next;
+
 } pjsip_auth_clt_pref;
 
 
+/**
+ * Client authentication session statistics, see #pjsip_auth_clt_get_stat().
+ */
+typedef struct pjsip_auth_clt_stat
+{
+    unsigned    chal_cnt;       /**< Number of challenges received.     */
+    unsigned    retry_cnt;      /**< Number of requests resent with
+                                     authorization after a challenge.   */
+    unsigned    reuse_cnt;      /**< Number of authorization headers
+                                     sent in new requests from a
+                                     previous challenge.                */
+    unsigned    ha1_cnt;        /**< Number of "ha1" hashed from a
+                                     password.                          */
+    unsigned    ha1_reuse_cnt;  /**< Number of "ha1" reused from the
+                                     cache.                             */
+} pjsip_auth_clt_stat;
+
+
 /**
  * Get a pjsip_auth_algorithm structure by type.
  *
@@ -349,6 +383,7 @@ typedef struct pjsip_auth_clt_sess
                                              pjsip_auth_clt_set_parent      */
     struct pjsip_auth_clt_sess *parent; /**< allow a common parent
                                              for multiple sessions.         */
+    pjsip_auth_clt_stat  stat;          /**< Statistics.                    */
 } pjsip_auth_clt_sess;
 
 
@@ -437,6 +472,17 @@ typedef pj_status_t pjsip_auth_lookup_cred2(
 /** Flag to specify that server is a proxy. */
 #define PJSIP_AUTH_SRV_IS_PROXY     1
 
+/**
+ * Opaque type of server credential cache, see
+ * #pjsip_auth_srv_cache_create().
+ */
+typedef struct pjsip_auth_srv_cache pjsip_auth_srv_cache;
+
+/**
+ * Opaque type of server nonce store, see #pjsip_auth_nonce_store_create().
+ */
+typedef struct pjsip_auth_nonce_store pjsip_auth_nonce_store;
+
 /**
  * This structure describes server authentication information.
  */
@@ -447,9 +493,108 @@ typedef struct pjsip_auth_srv
     pjsip_auth_lookup_cred  *lookup;    /**< Lookup function.               */
     pjsip_auth_lookup_cred2 *lookup2;   /**< Lookup function with additional
                                              info in its input param.       */
+    pjsip_auth_srv_cache    *cache;     /**< Optional credential cache.     */
+    pjsip_auth_nonce_store  *nonce_store;/**< Optional nonce store.         */
 } pjsip_auth_srv;
 
 
+/**
+ * Create a credential cache for server authentication. The cache keeps the
+ * credentials returned by the lookup function, converted to the "ha1" hash
+ * of the algorithm used by the client, so that subsequent requests from
+ * the same account are verified without calling the lookup function nor
+ * hashing the password again. Entries expire after the specified time,
+ * and the least recently used entry is replaced when the cache is full.
+ *
+ * The cache may be shared by several server authentication instances, and
+ * it must only be used if the lookup result doesn't depend on the request
+ * being authenticated.
+ *
+ * @param pf            Pool factory.
+ * @param max_cnt       Maximum number of cached credentials. If zero,
+ *                      PJSIP_AUTH_SRV_CACHE_MAX_CNT is used.
+ * @param ttl           Lifetime of the cached credentials, in seconds. If
+ *                      zero, PJSIP_AUTH_SRV_CACHE_TTL is used.
+ * @param p_cache       Pointer to receive the cache.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_srv_cache_create(pj_pool_factory *pf,
+                                                 unsigned max_cnt,
+                                                 unsigned ttl,
+                                                 pjsip_auth_srv_cache **p_cache);
+
+/**
+ * Remove the cached credentials of an account, e.g. after its password
+ * has been changed.
+ *
+ * @param cache         The credential cache.
+ * @param realm         The realm.
+ * @param acc_name      The account name, or NULL to remove all accounts
+ *                      of the realm.
+ */
+PJ_DECL(void) pjsip_auth_srv_cache_invalidate(pjsip_auth_srv_cache *cache,
+                                              const pj_str_t *realm,
+                                              const pj_str_t *acc_name);
+
+/**
+ * Get the number of requests verified with a cached credential (hits) and
+ * with a credential from the lookup function (misses).
+ *
+ * @param cache         The credential cache.
+ * @param hits          Optional pointer to receive the number of hits.
+ * @param misses        Optional pointer to receive the number of misses.
+ */
+PJ_DECL(void) pjsip_auth_srv_cache_get_stat(pjsip_auth_srv_cache *cache,
+                                            unsigned *hits,
+                                            unsigned *misses);
+
+/**
+ * Destroy a credential cache. It must not be used by any server
+ * authentication instance anymore.
+ *
+ * @param cache         The credential cache.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_srv_cache_destroy(pjsip_auth_srv_cache *cache);
+
+
+/**
+ * Create a nonce store for server authentication. When a server
+ * authentication instance has a nonce store, the nonces of its challenges
+ * are remembered, and #pjsip_auth_srv_verify() only accepts authorization
+ * with a nonce that it issued and that hasn't expired, and with a nonce
+ * count higher than the previous one. Otherwise, if the digest is
+ * correct, verification fails with PJSIP_EAUTHSTALENONCE and the server
+ * should challenge again with stale set to PJ_TRUE.
+ *
+ * @param pf            Pool factory.
+ * @param max_cnt       Maximum number of nonces. When full, the oldest
+ *                      nonce is forgotten. If zero,
+ *                      PJSIP_AUTH_NONCE_STORE_MAX_CNT is used.
+ * @param lifetime      Lifetime of a nonce, in seconds. If zero,
+ *                      PJSIP_AUTH_NONCE_LIFETIME is used.
+ * @param p_store       Pointer to receive the nonce store.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_nonce_store_create(pj_pool_factory *pf,
+                                                   unsigned max_cnt,
+                                                   unsigned lifetime,
+                                                   pjsip_auth_nonce_store **p_store);
+
+/**
+ * Destroy a nonce store. It must not be used by any server authentication
+ * instance anymore.
+ *
+ * @param store         The nonce store.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_nonce_store_destroy(pjsip_auth_nonce_store *store);
+
+
 /**
  * Initialize client authentication session data structure, and set the 
  * session to use pool for its subsequent memory allocation. The argument 
@@ -533,6 +678,19 @@ PJ_DECL(pj_status_t) pjsip_auth_clt_set_prefs(pjsip_auth_clt_sess *sess,
 PJ_DECL(pj_status_t) pjsip_auth_clt_get_prefs(pjsip_auth_clt_sess *sess,
                                               pjsip_auth_clt_pref *p);
 
+
+/**
+ * Get the statistics of the client authentication session. If the session
+ * has a parent, the statistics of the parent are returned.
+ *
+ * @param sess      The client authentication session.
+ * @param stat      Pointer to receive the statistics.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_clt_get_stat(pjsip_auth_clt_sess *sess,
+                                             pjsip_auth_clt_stat *stat);
+
 /**
  * Initialize new request message with authorization headers.
  * This function will put Authorization/Proxy-Authorization headers to the
@@ -644,6 +802,16 @@ typedef struct pjsip_auth_srv_init_param
      */
     unsigned                     options;
 
+    /**
+     * Optional credential cache, see #pjsip_auth_srv_cache_create().
+     */
+    pjsip_auth_srv_cache        *cache;
+
+    /**
+     * Optional nonce store, see #pjsip_auth_nonce_store_create().
+     */
+    pjsip_auth_nonce_store      *nonce_store;
+
 } pjsip_auth_srv_init_param;
 
 
@@ -681,6 +849,11 @@ PJ_DECL(pj_status_t) pjsip_auth_srv_init2(
  *                      - PJSIP_EAUTHACCDISABLED
  *                      - PJSIP_EAUTHINVALIDREALM
  *                      - PJSIP_EAUTHINVALIDDIGEST
+ *                      - PJSIP_EAUTHSTALENONCE, if the server has a nonce
+ *                        store and the digest is correct but the nonce
+ *                        is not valid anymore. The status code is set to
+ *                        401 or 407, and the request should be challenged
+ *                        again with stale set to PJ_TRUE.
  */
 PJ_DECL(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
                                             pjsip_rx_data *rdata,
@@ -718,6 +891,10 @@ PJ_DECL(pj_status_t) pjsip_auth_srv_challenge( pjsip_auth_srv *auth_srv,
  * random characters.
  * Application must specify the algorithm to use.
  *
+ * If the server has a nonce store, the nonce is added to the store so that
+ * #pjsip_auth_srv_verify() accepts it. Nonces longer than
+ * PJSIP_AUTH_NONCE_MAX_LEN can't be stored.
+ *
  * @param auth_srv       The server authentication structure.
  * @param qop            Optional qop value.
  * @param nonce          Optional nonce value.
@@ -870,6 +1047,27 @@ PJ_DECL(pj_status_t) pjsip_auth_create_digest2(pj_str_t *result,
                                  const pj_str_t *method,
                                  const pjsip_auth_algorithm_type algorithm_type);
 
+/**
+ * Helper function to create the "ha1" hash of a credential, i.e.
+ * pjsip_cred_info::username + ":" + realm + ":" + pjsip_cred_info::data
+ * hashed with the specified algorithm. The result can be used as the data
+ * of a #PJSIP_CRED_DATA_DIGEST credential.
+ *
+ * @param result         String to store the hash, preallocated by the
+ *                       caller with the buffer at least as large as the
+ *                       digest_str_length member of the algorithm.
+ * @param realm          Realm.
+ * @param cred_info      Credential info, the data type must be
+ *                       #PJSIP_CRED_DATA_PLAIN_PASSWD.
+ * @param algorithm_type The hash algorithm to use.
+ *
+ * @return              PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_auth_create_ha1(pj_str_t *result,
+                                 const pj_str_t *realm,
+                                 const pjsip_cred_info *cred_info,
+                                 pjsip_auth_algorithm_type algorithm_type);
+
 /**
  * @}
  */
@@ -188,6 +188,35 @@ typedef struct pjsip_cfg_t
          */
         pj_bool_t keep_inv_after_tsx_timeout;
 
+        /**
+         * Parse incoming headers lazily. When enabled, only the headers
+         * which are referenced by the rdata (the top Via, From, To,
+         * Call-ID, CSeq, Max-Forwards, Content-Type, Content-Length,
+         * Route, Record-Route, Require and Supported) are parsed when the
+         * message is received. Other headers with a registered parser are
+         * kept as raw #pjsip_lazy_hdr and parsed when they are first
+         * looked up with #pjsip_msg_find_hdr() or its variants.
+         *
+         * Default is PJSIP_LAZY_HDR_PARSING
+         */
+        pj_bool_t lazy_hdr_parsing;
+
+        /**
+         * Number of worker threads to process incoming messages. When
+         * non-zero, the endpoint creates this many threads, each with its
+         * own queue, and incoming messages are queued to the worker
+         * selected by the hash of their Call-ID. Messages of a dialog are
+         * then processed in order by the same thread, so its dialog and
+         * transactions are mostly used by one thread. When zero, messages
+         * are processed by the thread which received them. This setting
+         * is read when the endpoint is created, so it only applies to
+         * endpoints created with pjsip_endpt_create() after it is set.
+         * It is not available in pjsua_config.
+         *
+         * Default is PJSIP_RX_WORKER_CNT
+         */
+        unsigned rx_worker_cnt;
+
     } endpt;
 
     /** Transaction layer settings. */
@@ -221,6 +250,14 @@ typedef struct pjsip_cfg_t
          */
         unsigned td;
 
+        /** Schedule retransmissions in the retransmission wheel of the
+         *  transaction layer instead of in the timer heap. The setting is
+         *  read whenever a retransmission is scheduled.
+         *
+         *  Default is PJSIP_TSX_RETRANS_WHEEL
+         */
+        pj_bool_t retrans_wheel;
+
     } tsx;
 
     /* Dialog layer settings .. TODO */
@@ -261,6 +298,16 @@ typedef struct pjsip_cfg_t
          */
         long keep_alive_interval;
 
+        /**
+         * Maximum size of a SIP message received over TCP. Messages that
+         * don't fit in the packet buffer of the connection are received in
+         * a buffer that grows up to this size, and that is released once
+         * the message has been processed.
+         *
+         * Default is PJSIP_TCP_MAX_MSG_LEN.
+         */
+        pj_size_t max_msg_len;
+
     } tcp;
 
     /** TLS transport settings */
@@ -273,6 +320,14 @@ typedef struct pjsip_cfg_t
          */
         long keep_alive_interval;
 
+        /**
+         * Maximum size of a SIP message received over TLS, see
+         * \a tcp.max_msg_len.
+         *
+         * Default is PJSIP_TLS_MAX_MSG_LEN.
+         */
+        pj_size_t max_msg_len;
+
     } tls;
 
 } pjsip_cfg_t;
@@ -316,6 +371,20 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_MAX_TSX_COUNT          (1024-1)
 #endif
 
+/**
+ * Specify the number of partitions of the transaction table. Each
+ * partition has its own hash table and mutex, and transactions are
+ * assigned to partitions by the hash of their key, so that message
+ * lookups from different worker threads rarely contend for the same
+ * lock. The hash table size of each partition is PJSIP_MAX_TSX_COUNT
+ * divided by this value. Set to 1 to use a single table.
+ *
+ * Default value is 16
+ */
+#ifndef PJSIP_TSX_TABLE_SHARD_CNT
+#   define PJSIP_TSX_TABLE_SHARD_CNT    16
+#endif
+
 /**
  * Specify maximum number of dialogs in the dialog hash table.
  * For efficiency, the value should be 2^n-1 since it will be
@@ -327,6 +396,20 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_MAX_DIALOG_COUNT       (512-1)
 #endif
 
+/**
+ * Specify the number of partitions of the dialog table in the user agent
+ * layer. Each partition has its own hash table and mutex, and dialog sets
+ * are assigned to partitions by the hash of their Call-ID, so that
+ * in-dialog messages for different calls rarely contend for the same
+ * lock. The hash table size of each partition is PJSIP_MAX_DIALOG_COUNT
+ * divided by this value. Set to 1 to use a single table.
+ *
+ * Default value is 16
+ */
+#ifndef PJSIP_UA_DLG_TABLE_SHARD_CNT
+#   define PJSIP_UA_DLG_TABLE_SHARD_CNT 16
+#endif
+
 
 /**
  * Specify maximum number of transports.
@@ -347,6 +430,51 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify whether dialogs cache the transport used to send their requests
+ * (see #pjsip_tpcache), so that subsequent requests of the dialog to the
+ * same destination don't need to lock the transport manager to look up
+ * the transport.
+ *
+ * Default: 1
+ */
+#ifndef PJSIP_DLG_USE_TPCACHE
+#   define PJSIP_DLG_USE_TPCACHE        1
+#endif
+
+
+/**
+ * Default number of connections of a transport group, see
+ * #pjsip_tpmgr_create_tpgroup().
+ *
+ * Default: 2
+ */
+#ifndef PJSIP_TPGROUP_CONN_CNT
+#   define PJSIP_TPGROUP_CONN_CNT       2
+#endif
+
+
+/**
+ * Maximum number of connections of a transport group.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_TPGROUP_MAX_CONN
+#   define PJSIP_TPGROUP_MAX_CONN       16
+#endif
+
+
+/**
+ * Default interval, in seconds, to check the connections of a transport
+ * group and reconnect the closed ones.
+ *
+ * Default: 5
+ */
+#ifndef PJSIP_TPGROUP_CHECK_INTERVAL
+#   define PJSIP_TPGROUP_CHECK_INTERVAL 5
+#endif
+
+
 /**
  * Specify maximum URL size.
  */
@@ -507,6 +635,17 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Maximum number of sockets that can back a single UDP transport, see
+ * \a sock_cnt setting in pjsip_udp_transport_cfg.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_UDP_MAX_SOCK_CNT
+#   define PJSIP_UDP_MAX_SOCK_CNT       16
+#endif
+
+
 /**
  * Encode SIP headers in their short forms to reduce size. By default,
  * SIP headers in outgoing messages will be encoded in their full names. 
@@ -526,6 +665,56 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Parse incoming headers lazily, see the \a lazy_hdr_parsing setting in
+ * pjsip_cfg_t. This is useful for proxies and B2BUAs which only look at a
+ * few headers of each message.
+ *
+ * This option can also be controlled at run-time by the
+ * \a lazy_hdr_parsing setting in pjsip_cfg_t.
+ *
+ * Default is 0 (no)
+ */
+#ifndef PJSIP_LAZY_HDR_PARSING
+#   define PJSIP_LAZY_HDR_PARSING       0
+#endif
+
+
+/**
+ * Maximum length of the encoded form of a frozen header, see
+ * #pjsip_hdr_freeze(). Longer headers are not frozen and are printed
+ * normally.
+ *
+ * Default is 512
+ */
+#ifndef PJSIP_MAX_FROZEN_HDR_LEN
+#   define PJSIP_MAX_FROZEN_HDR_LEN     512
+#endif
+
+
+/**
+ * Default number of worker threads to process incoming messages, see
+ * pjsip_cfg_t.endpt.rx_worker_cnt.
+ *
+ * Default is 0 (messages are processed by the receiving thread)
+ */
+#ifndef PJSIP_RX_WORKER_CNT
+#   define PJSIP_RX_WORKER_CNT          0
+#endif
+
+
+/**
+ * Maximum number of incoming messages waiting in the queue of each
+ * worker, see pjsip_cfg_t.endpt.rx_worker_cnt. Messages received while
+ * the queue is full are dropped.
+ *
+ * Default is 1000
+ */
+#ifndef PJSIP_RX_WORKER_MAX_QUEUE
+#   define PJSIP_RX_WORKER_MAX_QUEUE    1000
+#endif
+
+
 /**
  * Send Allow header in dialog establishing requests?
  * RFC 3261 Allow header SHOULD be included in dialog establishing
@@ -562,6 +751,21 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Number of locks used to protect message dispatch to modules when
+ * PJSIP_SAFE_MODULE is enabled. Dispatch reads a snapshot of the module
+ * list while holding, for reading, only the lock selected by the calling
+ * thread, so worker threads don't share one lock. Module registration
+ * and unregistration lock all of them briefly for writing to publish a
+ * new snapshot.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_MODULE_DISPATCH_LOCK_CNT
+#   define PJSIP_MODULE_DISPATCH_LOCK_CNT       16
+#endif
+
+
 /**
  * Perform Via sent-by checking as specified in RFC 3261 Section 18.1.2,
  * which says that UAC MUST silently discard responses with Via sent-by
@@ -839,6 +1043,29 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_TCP_INITIAL_TIMEOUT        0
 #endif
 
+
+/**
+ * Maximum size of a SIP message received over TCP. Each connection reads
+ * into a packet buffer of PJSIP_MAX_PKT_LEN bytes; a message that doesn't
+ * fit there is moved to a separate buffer which grows as more of the
+ * message arrives, up to this size, and which is released when the message
+ * has been processed. This allows receiving large messages without raising
+ * PJSIP_MAX_PKT_LEN, which would enlarge the buffer of every connection.
+ * Setting this to PJSIP_MAX_PKT_LEN disables the separate buffer.
+ *
+ * Note that this doesn't reduce the memory of idle connections: each one
+ * keeps its PJSIP_MAX_PKT_LEN packet buffer for its whole lifetime, so
+ * that is still the setting to lower for many mostly idle connections.
+ *
+ * This option can be changed in run-time by settting
+ * \a tcp.max_msg_len field of pjsip_cfg().
+ *
+ * Default: 65536
+ */
+#ifndef PJSIP_TCP_MAX_MSG_LEN
+#   define PJSIP_TCP_MAX_MSG_LEN            65536
+#endif
+
 /**
  * Set the interval to send keep-alive packet for TLS transports.
  * If the value is zero, keep-alive will be disabled for TLS.
@@ -865,6 +1092,20 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Maximum size of a SIP message received over TLS, see
+ * PJSIP_TCP_MAX_MSG_LEN.
+ *
+ * This option can be changed in run-time by settting
+ * \a tls.max_msg_len field of pjsip_cfg().
+ *
+ * Default: PJSIP_TCP_MAX_MSG_LEN
+ */
+#ifndef PJSIP_TLS_MAX_MSG_LEN
+#   define PJSIP_TLS_MAX_MSG_LEN            PJSIP_TCP_MAX_MSG_LEN
+#endif
+
+
 /**
  * This macro specifies whether full DNS resolution should be used.
  * When enabled, #pjsip_resolve() will perform asynchronous DNS SRV and
@@ -908,6 +1149,52 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Default duration, in seconds, to keep the target sets in the routing
+ * cache of the SIP resolver. The routing cache is only active after it is
+ * enabled with #pjsip_resolver_set_cache().
+ *
+ * Default: 60
+ */
+#ifndef PJSIP_RESOLVE_CACHE_TTL
+#   define PJSIP_RESOLVE_CACHE_TTL              60
+#endif
+
+
+/**
+ * Default maximum number of target sets and target addresses to keep in
+ * the routing cache of the SIP resolver.
+ *
+ * Default: 256
+ */
+#ifndef PJSIP_RESOLVE_CACHE_MAX_CNT
+#   define PJSIP_RESOLVE_CACHE_MAX_CNT          256
+#endif
+
+
+/**
+ * Default number of consecutive failures (transaction timeouts, 503
+ * responses, or transport errors) after which the routing cache considers
+ * a target down.
+ *
+ * Default: 2
+ */
+#ifndef PJSIP_RESOLVE_FAIL_THRESHOLD
+#   define PJSIP_RESOLVE_FAIL_THRESHOLD         2
+#endif
+
+
+/**
+ * Default duration, in seconds, for a target to be considered down by
+ * the routing cache.
+ *
+ * Default: 30
+ */
+#ifndef PJSIP_RESOLVE_DOWN_TIME
+#   define PJSIP_RESOLVE_DOWN_TIME              30
+#endif
+
+
 /**
  * Enable TLS SIP transport support. For most systems this means that
  * OpenSSL must be installed.
@@ -1026,6 +1313,28 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_POOL_INC_TDATA         4000
 #endif
 
+/**
+ * Maximum number of tdata pools that the transport manager keeps, after
+ * resetting them, for reuse by new transmit data instead of releasing
+ * them to the pool factory. Set to zero to disable tdata pool recycling.
+ *
+ * Default: 64
+ */
+#ifndef PJSIP_TDATA_POOL_CACHE_SIZE
+#   define PJSIP_TDATA_POOL_CACHE_SIZE  64
+#endif
+
+/**
+ * Maximum number of rdata pools of closed TCP and TLS connections that
+ * the transport manager keeps for reuse by new connections. Set to zero
+ * to disable rdata pool recycling.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_RDATA_POOL_CACHE_SIZE
+#   define PJSIP_RDATA_POOL_CACHE_SIZE  16
+#endif
+
 /**
  * Initial memory size for UA layer
  */
@@ -1128,6 +1437,47 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_TSX_UAS_CONTINUE_ON_TP_ERROR 1
 #endif
 
+/**
+ * Specify whether transactions schedule their retransmissions in the
+ * retransmission wheel of the transaction layer instead of in the
+ * endpoint's timer heap. Retransmissions with the same interval are
+ * queued in a bucket in the order of their due time, and each bucket uses
+ * a single timer entry, which sweeps all the retransmissions that are due
+ * in one pass. This reduces the timer heap size and rescheduling cost
+ * when there are many concurrent transactions over unreliable transports.
+ *
+ * This setting can also be changed at run-time with the
+ * \a tsx.retrans_wheel field of #pjsip_cfg_t.
+ *
+ * Default: 0 (no)
+ */
+#ifndef PJSIP_TSX_RETRANS_WHEEL
+#   define PJSIP_TSX_RETRANS_WHEEL      0
+#endif
+
+/**
+ * Number of buckets in the retransmission wheel, i.e. the number of
+ * distinct retransmission intervals that can be queued at the same time.
+ * With the default timer values, the intervals are T1, 2*T1, 4*T1, T2
+ * and the delay of non-100 provisional response retransmission.
+ * Retransmissions of other intervals use the timer heap.
+ *
+ * Default: 8
+ */
+#ifndef PJSIP_TSX_RETRANS_BUCKET_CNT
+#   define PJSIP_TSX_RETRANS_BUCKET_CNT 8
+#endif
+
+/**
+ * Maximum number of retransmissions that are collected by a sweep of a
+ * retransmission wheel bucket before they are sent.
+ *
+ * Default: 64
+ */
+#ifndef PJSIP_TSX_RETRANS_BATCH_SIZE
+#   define PJSIP_TSX_RETRANS_BATCH_SIZE 64
+#endif
+
 #define PJSIP_MAX_TSX_KEY_LEN           (PJSIP_MAX_URL_SIZE*2)
 
 /* User agent's pool setting. */
@@ -1307,6 +1657,41 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Default maximum number of REGISTER requests per second that are sent by
+ * a registration scheduler, see #pjsip_regc_sched_param. Zero means no
+ * limit.
+ *
+ * Default: 50
+ */
+#ifndef PJSIP_REGC_SCHED_MAX_RATE
+#   define PJSIP_REGC_SCHED_MAX_RATE    50
+#endif
+
+
+/**
+ * Default maximum random delay, in milliseconds, of registrations that are
+ * queued to a registration scheduler, see #pjsip_regc_sched_param.
+ *
+ * Default: 2000
+ */
+#ifndef PJSIP_REGC_SCHED_INIT_JITTER
+#   define PJSIP_REGC_SCHED_INIT_JITTER 2000
+#endif
+
+
+/**
+ * Default maximum part of the refresh interval, in percent, that a
+ * registration scheduler randomly takes off registration refreshes, see
+ * #pjsip_regc_sched_param.
+ *
+ * Default: 10
+ */
+#ifndef PJSIP_REGC_SCHED_REFRESH_JITTER
+#   define PJSIP_REGC_SCHED_REFRESH_JITTER  10
+#endif
+
+
 /**
  * Allow client to send refresh registration when the registrar sent a Contact
  * header with expire parameter 0 in the 200/OK REGISTER response.
@@ -1371,6 +1756,68 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_AUTH_ALLOW_MULTIPLE_AUTH_HEADER 0
 #endif
 
+/**
+ * Default maximum number of credentials kept in a server authorization
+ * cache, see #pjsip_auth_srv_cache_create(). When the cache is full, the
+ * least recently used credential is replaced.
+ *
+ * Default: 1024
+ */
+#ifndef PJSIP_AUTH_SRV_CACHE_MAX_CNT
+#   define PJSIP_AUTH_SRV_CACHE_MAX_CNT         1024
+#endif
+
+/**
+ * Default time (in seconds) a credential is kept in a server authorization
+ * cache before it is looked up again.
+ *
+ * Default: 300
+ */
+#ifndef PJSIP_AUTH_SRV_CACHE_TTL
+#   define PJSIP_AUTH_SRV_CACHE_TTL             300
+#endif
+
+/**
+ * Maximum length of the realm and the account name together for the
+ * credential to be kept in a server authorization cache. Credentials
+ * with longer names are always looked up.
+ *
+ * Default: 128
+ */
+#ifndef PJSIP_AUTH_SRV_CACHE_KEY_LEN
+#   define PJSIP_AUTH_SRV_CACHE_KEY_LEN         128
+#endif
+
+/**
+ * Default maximum number of nonces remembered by a nonce store, see
+ * #pjsip_auth_nonce_store_create(). When the store is full, the oldest
+ * nonce is forgotten.
+ *
+ * Default: 4096
+ */
+#ifndef PJSIP_AUTH_NONCE_STORE_MAX_CNT
+#   define PJSIP_AUTH_NONCE_STORE_MAX_CNT       4096
+#endif
+
+/**
+ * Default lifetime (in seconds) of a nonce in a nonce store. After this
+ * time, authorization using the nonce is rejected as stale.
+ *
+ * Default: 300
+ */
+#ifndef PJSIP_AUTH_NONCE_LIFETIME
+#   define PJSIP_AUTH_NONCE_LIFETIME            300
+#endif
+
+/**
+ * Maximum length of a nonce that can be kept in a nonce store.
+ *
+ * Default: 64
+ */
+#ifndef PJSIP_AUTH_NONCE_MAX_LEN
+#   define PJSIP_AUTH_NONCE_MAX_LEN             64
+#endif
+
 /*****************************************************************************
  *  SIP Event framework and presence settings.
  */
@@ -192,6 +192,9 @@ struct pjsip_dialog
      */
     pjsip_host_port     via_addr;   /**< Via address.                       */
     const void         *via_tp;     /**< Via transport.                     */
+
+    /** Cache of the transport last used to send requests. */
+    pjsip_tpcache       tp_cache;
 };
 
 /**
@@ -456,6 +456,16 @@ PJ_DECL(pj_status_t) pjsip_endpt_set_ext_resolver(pjsip_endpoint *endpt,
  */
 PJ_DECL(pj_dns_resolver*) pjsip_endpt_get_resolver(pjsip_endpoint *endpt);
 
+/**
+ * Get the SIP resolver engine of the endpoint, e.g. to configure its
+ * routing cache with #pjsip_resolver_set_cache().
+ *
+ * @param endpt         The SIP endpoint instance.
+ *
+ * @return              The SIP resolver engine.
+ */
+PJ_DECL(pjsip_resolver_t*) pjsip_endpt_get_sip_resolver(pjsip_endpoint *endpt);
+
 /**
  * Asynchronously resolve a SIP target host or domain according to rule 
  * specified in RFC 3263 (Locating SIP Servers). When the resolving operation
@@ -400,6 +400,13 @@ PJ_BEGIN_DECL
  * No challenge is found in the challenge.
  */
 #define PJSIP_EAUTHNOCHAL       (PJSIP_ERRNO_START_PJSIP + 114) /* 171114 */
+/**
+ * @hideinitializer
+ * The nonce in the authorization is unknown, expired or its nonce count
+ * has been used before. The request should be challenged again with
+ * stale=true.
+ */
+#define PJSIP_EAUTHSTALENONCE   (PJSIP_ERRNO_START_PJSIP + 115) /* 171115 */
 
 /************************************************************
  * UA AND DIALOG ERRORS
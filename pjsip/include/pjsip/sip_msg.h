@@ -361,6 +361,47 @@ PJ_DECL(void*) pjsip_hdr_shallow_clone( pj_pool_t *pool, const void *hdr );
  */
 PJ_DECL(int) pjsip_hdr_print_on( void *hdr, char *buf, pj_size_t len);
 
+/**
+ * Mark the header as immutable and store its encoded form, so that
+ * printing the header only copies the stored bytes instead of formatting
+ * the header again. This is useful for headers which are added to many
+ * messages without being changed, such as the endpoint capability headers
+ * or the route set and local Contact of a dialog.
+ *
+ * Clones of a frozen header are frozen too. The header (and its clones)
+ * must not be modified after it is frozen; call #pjsip_hdr_unfreeze()
+ * before modifying it, and optionally freeze it again afterwards. Note that
+ * the header name is encoded according to the \a use_compact_form setting
+ * at the time the header is frozen.
+ *
+ * Freezing a frozen header refreshes its encoded form.
+ *
+ * @param pool      Pool to allocate the encoded form, which must remain
+ *                  valid for as long as the header is used.
+ * @param hdr       The header.
+ *
+ * @return          PJ_SUCCESS, or PJSIP_EMSGTOOLONG if the encoded header
+ *                  is longer than PJSIP_MAX_FROZEN_HDR_LEN. The header is
+ *                  still usable (but not frozen) on error.
+ */
+PJ_DECL(pj_status_t) pjsip_hdr_freeze( pj_pool_t *pool, void *hdr );
+
+/**
+ * Restore a frozen header to normal, so that it can be modified.
+ *
+ * @param hdr       The header.
+ */
+PJ_DECL(void) pjsip_hdr_unfreeze( void *hdr );
+
+/**
+ * Check whether the header is frozen (see #pjsip_hdr_freeze()).
+ *
+ * @param hdr       The header.
+ *
+ * @return          PJ_TRUE if the header is frozen.
+ */
+PJ_DECL(pj_bool_t) pjsip_hdr_is_frozen( const void *hdr );
+
 /**
  * Find a header in a header list by the header type.
  *
@@ -371,6 +412,11 @@ PJ_DECL(int) pjsip_hdr_print_on( void *hdr, char *buf, pj_size_t len);
  *                  first header, otherwise the search will begin at the
  *                  specified header.
  *
+ * Lazy headers of the specified type (see #pjsip_lazy_hdr) are parsed
+ * when they are found, and replaced in the list by the parsed headers,
+ * even though the list is passed as const. For PJSIP_H_OTHER, only lazy
+ * headers whose name is not one of the known header types are parsed.
+ *
  * @return          The header field, or NULL if no header with the specified
  *                  type is found.
  */
@@ -892,7 +938,10 @@ PJ_DECL(pjsip_msg*)  pjsip_msg_create( pj_pool_t *pool, pjsip_msg_type_e type);
 
 
 /**
- * Perform a deep clone of a SIP message.
+ * Perform a deep clone of a SIP message. The request/status line and the
+ * standard headers are copied into a single allocation from the pool;
+ * headers with their own clone function (e.g. frozen headers) and the
+ * message body are cloned separately.
  *
  * @param pool      The pool for creating the new message.
  * @param msg       The message to be duplicated.
@@ -913,6 +962,9 @@ PJ_DECL(pjsip_msg*) pjsip_msg_clone( pj_pool_t *pool, const pjsip_msg *msg);
  *                  first header, otherwise the search will begin at the
  *                  specified header.
  *
+ * As with #pjsip_hdr_find(), lazy headers of the specified type are
+ * parsed in place in the message when they are found.
+ *
  * @return          The header field, or NULL if no header with the specified 
  *                  type is found.
  */
@@ -968,6 +1020,16 @@ PJ_DECL(void*)  pjsip_msg_find_hdr_by_names(const pjsip_msg *msg,
 PJ_DECL(void*)  pjsip_msg_find_remove_hdr( pjsip_msg *msg, 
                                            pjsip_hdr_e hdr, void *start);
 
+/**
+ * Parse all lazy headers in the message (see #pjsip_lazy_hdr). This must
+ * be called before iterating the header list directly and checking the
+ * header types, if the message may have been parsed with lazy header
+ * parsing enabled.
+ *
+ * @param msg       The message.
+ */
+PJ_DECL(void) pjsip_msg_parse_lazy_hdrs( pjsip_msg *msg );
+
 /** 
  * Add a header to the message, putting it last in the header list.
  *
@@ -1133,6 +1195,66 @@ PJ_DECL(void) pjsip_generic_string_hdr_init2(pjsip_generic_string_hdr *h,
                                              pj_str_t *hvalue);
 
 
+/* **************************************************************************/
+
+/**
+ * Header whose value has not been parsed yet. The parser creates this
+ * header for known header types when lazy header parsing is enabled (see
+ * \a lazy_hdr_parsing setting in #pjsip_cfg_t). Until it is parsed, the
+ * header has PJSIP_H_OTHER type and behaves as a generic string header
+ * (its layout is compatible with #pjsip_generic_string_hdr).
+ *
+ * The header is replaced with its typed version in the list the first time
+ * it is looked up with #pjsip_hdr_find(), #pjsip_msg_find_hdr(), or the
+ * by-name variants. Code that iterates the header list directly and checks
+ * the header type must call #pjsip_msg_parse_lazy_hdrs() first.
+ */
+typedef struct pjsip_lazy_hdr
+{
+    /** Standard header field. */
+    PJSIP_DECL_HDR_MEMBER(struct pjsip_lazy_hdr);
+    /** The raw header value. */
+    pj_str_t hvalue;
+    /** The pool to parse the value with. */
+    pj_pool_t *pool;
+} pjsip_lazy_hdr;
+
+
+/**
+ * Create a lazy header. The name and value are not duplicated, so they
+ * must remain valid for the lifetime of the pool.
+ *
+ * @param pool      The pool, which is also used to parse the header later.
+ * @param hname     The header name.
+ * @param hvalue    The raw header value, or NULL to set it later.
+ *
+ * @return          The header.
+ */
+PJ_DECL(pjsip_lazy_hdr*) pjsip_lazy_hdr_create(pj_pool_t *pool,
+                                               const pj_str_t *hname,
+                                               const pj_str_t *hvalue);
+
+/**
+ * Check whether the header is a lazy header which has not been parsed.
+ *
+ * @param hdr       The header.
+ *
+ * @return          PJ_TRUE if the header is a lazy header.
+ */
+PJ_DECL(pj_bool_t) pjsip_hdr_is_lazy(const void *hdr);
+
+/**
+ * Parse the lazy header and replace it with the parsed header(s) in the
+ * list it belongs to. On parse error, the header is converted to a generic
+ * string header.
+ *
+ * @param hdr       The lazy header.
+ *
+ * @return          The first parsed header, or NULL on parse error.
+ */
+PJ_DECL(pjsip_hdr*) pjsip_lazy_hdr_parse(pjsip_lazy_hdr *hdr);
+
+
 /* **************************************************************************/
 
 /**
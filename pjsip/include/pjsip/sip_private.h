@@ -25,6 +25,72 @@
  */ 
 
 #include <pjsip/sip_types.h>
+#include <pjsip/sip_uri.h>
+#include <pj/string.h>
+
+PJ_BEGIN_DECL
+
+/*
+ * Contiguous clone arena, used by pjsip_msg_clone() to copy a message into
+ * a single allocation. The message is walked twice: the first pass counts
+ * the size of the structures and strings, the second pass copies them into
+ * one block, structures (aligned) at the start and strings after them.
+ * Objects which are not known to the arena (e.g. URI of other schemes) are
+ * not counted, and are cloned from the pool with their own clone function.
+ */
+typedef struct pjsip_clone_arena
+{
+    pj_pool_t   *pool;      /* Pool for objects not copied to the arena.   */
+    pj_size_t    obj_size;  /* First pass: total size of the structures.   */
+    pj_size_t    str_size;  /* First pass: total size of the strings.      */
+    char        *obj;       /* Second pass: next structure.                */
+    char        *str;       /* Second pass: next string.                   */
+} pjsip_clone_arena;
+
+#define PJSIP_ARENA_ALIGN(size) \
+            (((size) + PJ_POOL_ALIGNMENT - 1) & \
+             ~((pj_size_t)PJ_POOL_ALIGNMENT - 1))
+
+PJ_INLINE(void) pjsip_arena_count(pjsip_clone_arena *a, pj_size_t size)
+{
+    a->obj_size += PJSIP_ARENA_ALIGN(size);
+}
+
+PJ_INLINE(void) pjsip_arena_count_str(pjsip_clone_arena *a, const pj_str_t *s)
+{
+    if (s->slen > 0)
+        a->str_size += s->slen;
+}
+
+PJ_INLINE(void*) pjsip_arena_alloc(pjsip_clone_arena *a, pj_size_t size)
+{
+    void *p = a->obj;
+    a->obj += PJSIP_ARENA_ALIGN(size);
+    return p;
+}
+
+PJ_INLINE(void) pjsip_arena_strdup(pjsip_clone_arena *a, pj_str_t *dst,
+                                   const pj_str_t *src)
+{
+    if (src->slen > 0) {
+        pj_memcpy(a->str, src->ptr, src->slen);
+        dst->ptr = a->str;
+        dst->slen = src->slen;
+        a->str += src->slen;
+    } else {
+        dst->ptr = NULL;
+        dst->slen = 0;
+    }
+}
+
+/* Parameter list and URI, implemented in sip_uri.c */
+void pjsip_param_arena_count(pjsip_clone_arena *a, const pjsip_param *list);
+void pjsip_param_arena_copy(pjsip_clone_arena *a, pjsip_param *dst_list,
+                            const pjsip_param *src_list);
+void pjsip_uri_arena_count(pjsip_clone_arena *a, const pjsip_uri *uri);
+pjsip_uri* pjsip_uri_arena_copy(pjsip_clone_arena *a, const pjsip_uri *uri);
+
+PJ_END_DECL
 
 
 #endif /* __PJSIP_PRIVATE_I_H__ */
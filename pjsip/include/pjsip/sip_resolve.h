@@ -164,6 +164,23 @@ PJ_BEGIN_DECL
  * implementation needs feature from PJLIB-UTL DNS resolver, it has to create
  * its own PJLIB-UTL DNS resolver instance.
  *
+ * \section PJSIP_RESOLVE_CACHE Routing Cache
+ *
+ * Optionally, application can enable the routing cache with
+ * #pjsip_resolver_set_cache(). When enabled, the SIP resolver keeps the
+ * target sets resolved with DNS for a configured duration, so subsequent
+ * requests to the same destination don't have to wait for DNS queries.
+ * Targets in the same priority class are ordered with the weighted random
+ * selection specified in RFC 2782 on each resolution.
+ *
+ * The cache also keeps health score for each target address. The transaction
+ * layer reports the outcome of every client transaction sent to a target
+ * with #pjsip_resolver_report_target(). When a target accumulates
+ * consecutive failures (transaction timeout, 503 response, or transport
+ * error), it is considered down for a while and it will be put at the end
+ * of the target list, so new requests fail over to the next target
+ * immediately instead of waiting for the transaction timeout.
+ *
  * \section PJSIP_RESOLVE_REFERENCE Reference
  *
  * Reference:
@@ -308,6 +325,125 @@ PJ_DECL(pj_status_t) pjsip_resolver_set_ext_resolver(
  */
 PJ_DECL(pj_dns_resolver*) pjsip_resolver_get_resolver(pjsip_resolver_t *res);
 
+/**
+ * Routing cache settings, to be specified in #pjsip_resolver_set_cache().
+ */
+typedef struct pjsip_resolver_cache_cfg
+{
+    /**
+     * The duration, in seconds, to keep the target set resolved with DNS.
+     * Zero disables caching of the target sets, while still keeping the
+     * health score of the targets.
+     *
+     * Default: PJSIP_RESOLVE_CACHE_TTL
+     */
+    unsigned    ttl;
+
+    /**
+     * Maximum number of target sets, and also target addresses, to keep
+     * in the cache. When the limit is reached, the least recently used
+     * entry will be recycled.
+     *
+     * Default: PJSIP_RESOLVE_CACHE_MAX_CNT
+     */
+    unsigned    max_cnt;
+
+    /**
+     * Number of consecutive failures after which a target is considered
+     * down.
+     *
+     * Default: PJSIP_RESOLVE_FAIL_THRESHOLD
+     */
+    unsigned    fail_threshold;
+
+    /**
+     * The duration, in seconds, for a target to be considered down. Once
+     * this expires, the target will be tried again in its normal order,
+     * and another failure will put it down again immediately.
+     *
+     * Default: PJSIP_RESOLVE_DOWN_TIME
+     */
+    unsigned    down_time;
+
+} pjsip_resolver_cache_cfg;
+
+/**
+ * Health information of a target address, as returned by
+ * #pjsip_resolver_get_target_info().
+ */
+typedef struct pjsip_resolver_target_info
+{
+    /** Number of consecutive failures. */
+    unsigned    fail_cnt;
+
+    /** Whether the target is currently considered down. */
+    pj_bool_t   is_down;
+
+    /** Smoothed round trip time, in milliseconds (zero if unknown). */
+    unsigned    rtt;
+
+} pjsip_resolver_target_info;
+
+/**
+ * Initialize routing cache settings with default values.
+ *
+ * @param cfg       The settings to be initialized.
+ */
+PJ_DECL(void) pjsip_resolver_cache_cfg_default(pjsip_resolver_cache_cfg *cfg);
+
+/**
+ * Enable, reconfigure, or disable the routing cache of the SIP resolver.
+ * Reconfiguring the cache will clear its content. The cache is disabled
+ * by default.
+ *
+ * @param res       The SIP resolver engine.
+ * @param pf        Pool factory to allocate the cache.
+ * @param cfg       The cache settings, or NULL to disable the cache.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_resolver_set_cache(pjsip_resolver_t *res,
+                                              pj_pool_factory *pf,
+                                              const pjsip_resolver_cache_cfg *cfg);
+
+/**
+ * Report the outcome of a request sent to a target address, to update the
+ * health score of the target. Status code PJSIP_SC_TSX_TIMEOUT and
+ * PJSIP_SC_SERVICE_UNAVAILABLE (which is also used for transport error)
+ * are counted as failure, any other status code means that the target is
+ * alive. This function does nothing when the routing cache is disabled.
+ *
+ * Note that this function is normally called by the transaction layer.
+ *
+ * @param res       The SIP resolver engine.
+ * @param addr      The target address.
+ * @param addr_len  Length of the address.
+ * @param code      The final status code of the request.
+ * @param rtt       Round trip time of the request in milliseconds, or
+ *                  zero if it is not known.
+ */
+PJ_DECL(void) pjsip_resolver_report_target(pjsip_resolver_t *res,
+                                           const pj_sockaddr_t *addr,
+                                           int addr_len,
+                                           int code,
+                                           unsigned rtt);
+
+/**
+ * Get the health information of a target address.
+ *
+ * @param res       The SIP resolver engine.
+ * @param addr      The target address.
+ * @param addr_len  Length of the address.
+ * @param info      Pointer to receive the information.
+ *
+ * @return          PJ_SUCCESS, or PJ_ENOTFOUND if the target is not known.
+ */
+PJ_DECL(pj_status_t) pjsip_resolver_get_target_info(
+                                        pjsip_resolver_t *res,
+                                        const pj_sockaddr_t *addr,
+                                        int addr_len,
+                                        pjsip_resolver_target_info *info);
+
 /**
  * Destroy resolver engine. Note that this will also destroy the internal
  * DNS resolver inside the engine. If application doesn't want the internal
@@ -141,6 +141,10 @@ struct pjsip_transaction
     int                         retransmit_count;/**< Retransmission count. */
     pj_timer_entry              retransmit_timer;/**< Retransmit timer.     */
     pj_timer_entry              timeout_timer;  /**< Timeout timer.         */
+    pj_time_val                 send_time;      /**< Time request was sent,
+                                                     for target RTT.        */
+    struct pjsip_tsx_retrans   *retrans;        /**< Entry in retransmission
+                                                     wheel.                 */
 
     /** Module specific data. */
     void                       *mod_data[PJSIP_MAX_MODULE];
@@ -299,6 +299,70 @@ PJ_DECL(void) pjsip_tpselector_add_ref(pjsip_tpselector *sel);
 PJ_DECL(void) pjsip_tpselector_dec_ref(pjsip_tpselector *sel);
 
 
+/**
+ * Transport cache, remembering the transport that was last acquired for
+ * a destination by an object which repeatedly sends requests to the same
+ * destination, such as a dialog. When a transmit data is associated with
+ * a cache (see #pjsip_tx_data_set_tpcache()), the transport manager will
+ * first try the cached transport, which only requires locking the cache
+ * owner, and fall back to the regular (locked) transport lookup when the
+ * cache is empty or stale.
+ *
+ * The cache does not hold a reference to the transport, so it does not
+ * prevent the transport from being shut down or destroyed. Instead, a
+ * cached entry is valid only as long as the transport manager generation
+ * counter, which changes whenever a transport is registered or destroyed,
+ * stays the same, and the transport is still usable and referenced.
+ *
+ * The cache is only consulted when the transmit data has no transport
+ * selector (or a #PJSIP_TPSELECTOR_NONE one) with connection reuse
+ * enabled, so the semantics of transport selectors are unchanged.
+ */
+typedef struct pjsip_tpcache
+{
+    /** The owner's group lock, protecting the cache. */
+    pj_grp_lock_t          *grp_lock;
+
+    /** The cached transport, or NULL. */
+    pjsip_transport        *tp;
+
+    /** Transport type of the cached destination. */
+    pjsip_transport_type_e  type;
+
+    /** Remote address of the cached destination. */
+    pj_sockaddr             rem_addr;
+
+    /** Length of the remote address. */
+    int                     addr_len;
+
+    /** Transport manager generation when the entry was cached. */
+    unsigned                gen;
+
+} pjsip_tpcache;
+
+
+/**
+ * Initialize a transport cache.
+ *
+ * @param cache     The transport cache.
+ * @param grp_lock  The group lock of the cache owner, which is used to
+ *                  protect the cache. Transmit data associated with the
+ *                  cache keep a reference to this group lock.
+ */
+PJ_DECL(void) pjsip_tpcache_init(pjsip_tpcache *cache,
+                                 pj_grp_lock_t *grp_lock);
+
+
+/**
+ * Forget the transport in the cache, if any. The owner must call this
+ * before it is destroyed.
+ *
+ * @param cache     The transport cache.
+ */
+PJ_DECL(void) pjsip_tpcache_clear(pjsip_tpcache *cache);
+
+
+
 /*****************************************************************************
  *
  * RECEIVE DATA BUFFER.
@@ -673,6 +737,13 @@ struct pjsip_tx_data
      */
     pjsip_host_port          via_addr;      /**< Via address.           */
     const void              *via_tp;        /**< Via transport.         */
+
+    /**
+     * Optional transport cache to be consulted when acquiring transport
+     * for this transmit data. The value here must be set with
+     * pjsip_tx_data_set_tpcache().
+     */
+    pjsip_tpcache           *tp_cache;
 };
 
 
@@ -766,6 +837,22 @@ PJ_DECL(char*) pjsip_tx_data_get_info( pjsip_tx_data *tdata );
 PJ_DECL(pj_status_t) pjsip_tx_data_set_transport(pjsip_tx_data *tdata,
                                                  const pjsip_tpselector *sel);
 
+/**
+ * Associate a transport cache with this transmit data, so that the
+ * transport manager may reuse the transport cached there instead of
+ * looking it up. The transmit data keeps a reference to the group lock
+ * of the cache until it is destroyed or another cache is set.
+ * Application should not need to call this function, as dialogs set
+ * their own cache when sending requests.
+ *
+ * @param tdata     The transmit buffer.
+ * @param cache     The transport cache, or NULL to remove the association.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_tx_data_set_tpcache(pjsip_tx_data *tdata,
+                                               pjsip_tpcache *cache);
+
 /**
  * Clone pjsip_tx_data. This will duplicate the message contents of
  * pjsip_tx_data (pjsip_tx_data.msg) and add reference count to the tdata.
@@ -783,6 +870,43 @@ PJ_DECL(pj_status_t) pjsip_tx_data_clone(const pjsip_tx_data *src,
                                          unsigned flags,
                                          pjsip_tx_data **p_rdata);
 
+/**
+ * Opaque cache of pools, used by the transport manager to recycle the
+ * pools of transmit data and of the receive data of connection oriented
+ * transports. Each pool given out by the cache keeps a reference to the
+ * cache, so the pool may be returned even after the transport manager
+ * has been destroyed.
+ */
+typedef struct pjsip_pool_cache pjsip_pool_cache;
+
+/**
+ * Get a pool for the receive data of a connection oriented transport,
+ * such as TCP or TLS. The pool may be recycled from a previously closed
+ * connection. The pool must be returned with #pjsip_pool_cache_release().
+ *
+ * @param mgr       The transport manager.
+ * @param p_cache   Pointer to receive the cache which the pool must be
+ *                  returned to.
+ *
+ * @return          The pool, or NULL when there's no memory.
+ */
+PJ_DECL(pj_pool_t*) pjsip_tpmgr_create_rdata_pool(pjsip_tpmgr *mgr,
+                                                  pjsip_pool_cache **p_cache);
+
+/**
+ * Return a pool to the cache which it was obtained from. The pool is
+ * reset and kept for reuse if the cache is not full, otherwise it is
+ * released.
+ *
+ * @param cache     The cache.
+ * @param pool      The pool.
+ * @param secure    If non-zero, the pool memory will be cleared first,
+ *                  e.g. for pools which have held decrypted data.
+ */
+PJ_DECL(void) pjsip_pool_cache_release(pjsip_pool_cache *cache,
+                                       pj_pool_t *pool,
+                                       pj_bool_t secure);
+
 /*****************************************************************************
  *
  * TRANSPORT
@@ -1051,6 +1175,85 @@ PJ_DECL(pj_ssize_t) pjsip_tpmgr_receive_packet(pjsip_tpmgr *mgr,
                                                pjsip_rx_data *rdata);
 
 
+/**
+ * Receive state of a stream oriented transport connection (e.g. TCP, TLS),
+ * used with #pjsip_tpmgr_receive_stream(). The connection reads into the
+ * packet buffer of its rdata; a message that doesn't fit there is moved to
+ * an overflow buffer, which grows as more of the message is received and
+ * which is released once the message has been processed. The state also
+ * remembers how far a partially received message has been examined, so
+ * that it isn't searched again from the start when more data arrives.
+ */
+typedef struct pjsip_rx_stream
+{
+    /** Maximum size of a message, see PJSIP_TCP_MAX_MSG_LEN. */
+    pj_size_t                    max_msg_len;
+
+    /** Pool of the overflow buffer, or NULL if there is none. */
+    pj_pool_t                   *pool;
+
+    /** The overflow buffer. */
+    char                        *buf;
+
+    /** Capacity of the overflow buffer. */
+    pj_size_t                    size;
+
+    /** Length of the data in the overflow buffer. */
+    pj_size_t                    len;
+
+    /** Total size of the pending partial message, if already known. */
+    pj_size_t                    msg_size;
+
+    /** Length of the pending partial message already searched for the
+     *  end of the header section, if the total size is not yet known. */
+    pj_size_t                    scanned;
+
+} pjsip_rx_stream;
+
+
+/**
+ * Initialize the receive state of a stream oriented connection.
+ *
+ * @param stream        The receive state.
+ * @param max_msg_len   Maximum size of an incoming message.
+ */
+PJ_DECL(void) pjsip_rx_stream_init(pjsip_rx_stream *stream,
+                                   pj_size_t max_msg_len);
+
+
+/**
+ * Release the overflow buffer of a stream oriented connection and clear
+ * any pending partial message state. The transport must call this when the
+ * connection is destroyed.
+ *
+ * @param stream        The receive state.
+ */
+PJ_DECL(void) pjsip_rx_stream_reset(pjsip_rx_stream *stream);
+
+
+/**
+ * This function is called by stream oriented transports instead of
+ * #pjsip_tpmgr_receive_packet() to report data received in the packet
+ * buffer of the rdata. All complete messages are processed, and the data
+ * of a partial message is kept either at the start of the packet buffer
+ * or in the overflow buffer of the stream.
+ *
+ * @param mgr           The transport manager instance.
+ * @param rdata         The receive data buffer containing the data. The
+ *                      transport MUST fully initialize tp_info and pkt_info
+ *                      member of the rdata.
+ * @param stream        The receive state of the connection.
+ *
+ * @return              The number of bytes of a partial message left at
+ *                      the start of the packet buffer, which the transport
+ *                      MUST keep and complete with subsequently received
+ *                      data.
+ */
+PJ_DECL(pj_size_t) pjsip_tpmgr_receive_stream(pjsip_tpmgr *mgr,
+                                              pjsip_rx_data *rdata,
+                                              pjsip_rx_stream *stream);
+
+
 /*****************************************************************************
  *
  * TRANSPORT FACTORY
@@ -1429,7 +1632,9 @@ PJ_DECL(pj_status_t) pjsip_tpmgr_acquire_transport(pjsip_tpmgr *mgr,
  * @param addr_len  Length of the remote address.
  * @param sel       Optional pointer to transport selector instance which is
  *                  used to find explicit transport, if required.
- * @param tdata     Optional pointer to data to be sent.
+ * @param tdata     Optional pointer to data to be sent. If it has a
+ *                  transport cache (see #pjsip_tx_data_set_tpcache()),
+ *                  the cache is tried first and updated on success.
  * @param tp        Pointer to receive the transport instance, if one is found.
  *
  * @return          PJ_SUCCESS on success, or the appropriate error code.
@@ -1442,6 +1647,119 @@ PJ_DECL(pj_status_t) pjsip_tpmgr_acquire_transport2(pjsip_tpmgr *mgr,
                                                     pjsip_tx_data *tdata,
                                                     pjsip_transport **tp);
 
+
+/**
+ * Opaque type of a transport group, see #pjsip_tpmgr_create_tpgroup().
+ */
+typedef struct pjsip_tpgroup pjsip_tpgroup;
+
+/**
+ * How a transport group selects a connection for an outgoing message.
+ */
+typedef enum pjsip_tpgroup_sel
+{
+    /** Use the connections in turn. */
+    PJSIP_TPGROUP_ROUND_ROBIN,
+
+    /** Use the connection with the fewest references, i.e. the fewest
+     *  pending messages and transactions. */
+    PJSIP_TPGROUP_LEAST_USED
+
+} pjsip_tpgroup_sel;
+
+/**
+ * Transport group settings.
+ */
+typedef struct pjsip_tpgroup_cfg
+{
+    /**
+     * Number of connections kept open to the destination.
+     *
+     * Default: PJSIP_TPGROUP_CONN_CNT
+     */
+    unsigned            conn_cnt;
+
+    /**
+     * Connection selection method.
+     *
+     * Default: PJSIP_TPGROUP_ROUND_ROBIN
+     */
+    pjsip_tpgroup_sel   sel;
+
+    /**
+     * Interval, in seconds, to check the connections and to reconnect
+     * the ones that have been closed.
+     *
+     * Default: PJSIP_TPGROUP_CHECK_INTERVAL
+     */
+    unsigned            check_interval;
+
+} pjsip_tpgroup_cfg;
+
+
+/**
+ * Initialize transport group settings with the default values.
+ *
+ * @param cfg       The settings to be initialized.
+ */
+PJ_DECL(void) pjsip_tpgroup_cfg_default(pjsip_tpgroup_cfg *cfg);
+
+/**
+ * Create a group of connection oriented transports (e.g. TCP, TLS) to a
+ * single destination, such as an upstream proxy of a SIP trunk. The group
+ * opens the configured number of connections immediately and keeps them
+ * open: the connections are not closed when idle, they send keep-alive as
+ * usual for their transport type, and those that get closed are
+ * reconnected on the next check.
+ *
+ * Once the group is created, #pjsip_tpmgr_acquire_transport2() selects one
+ * of its connections for messages to the destination, unless a specific
+ * transport or listener is requested or connection reuse is disabled in
+ * the selector. Traffic to the destination is thus spread over several
+ * connections.
+ *
+ * @param mgr       The transport manager.
+ * @param type      The transport type, must be connection oriented.
+ * @param remote    The destination address.
+ * @param addr_len  Length of the destination address.
+ * @param host      Optional destination host name. For secure transports,
+ *                  it's used to verify the server certificate, and the
+ *                  group is only used for messages to this host name.
+ * @param cfg       Optional settings, if NULL the default is used.
+ * @param p_grp     Pointer to receive the group.
+ *
+ * @return          PJ_SUCCESS if the group has been created, even if some
+ *                  of its connections have failed to start.
+ */
+PJ_DECL(pj_status_t) pjsip_tpmgr_create_tpgroup(pjsip_tpmgr *mgr,
+                                                pjsip_transport_type_e type,
+                                                const pj_sockaddr_t *remote,
+                                                int addr_len,
+                                                const pj_str_t *host,
+                                                const pjsip_tpgroup_cfg *cfg,
+                                                pjsip_tpgroup **p_grp);
+
+/**
+ * Get the number of usable connections of a transport group, i.e. those
+ * that are not being shut down or destroyed.
+ *
+ * @param grp       The transport group.
+ *
+ * @return          Number of usable connections.
+ */
+PJ_DECL(unsigned) pjsip_tpgroup_get_conn_cnt(pjsip_tpgroup *grp);
+
+/**
+ * Destroy a transport group. Its connections are released, and will be
+ * closed once idle like other transports.
+ *
+ * @param grp       The transport group.
+ *
+ * @return          PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_tpgroup_destroy(pjsip_tpgroup *grp);
+
+
 /**
  * Type of callback to receive notification when message or raw data
  * has been sent.
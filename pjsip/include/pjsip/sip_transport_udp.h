@@ -85,10 +85,10 @@ typedef struct pjsip_udp_transport_cfg
     pjsip_host_port     addr_name;
 
     /**
-     * Number of simultaneous asynchronous accept() operations to be 
-     * supported. It is recommended that the number here corresponds to 
-     * the number of processors in the system (or the number of SIP
-     * worker threads).
+     * Number of simultaneous asynchronous read operations (read slots) to
+     * be supported on each socket of the transport. It is recommended that
+     * the number here corresponds to the number of processors in the system
+     * (or the number of SIP worker threads).
      *
      * Default: 1
      */
@@ -120,9 +120,77 @@ typedef struct pjsip_udp_transport_cfg
      */
     pj_sockopt_params   sockopt_params;
 
+    /**
+     * Number of sockets backing the transport. When it is greater than one,
+     * all sockets are bound to the same address with SO_REUSEPORT, so the
+     * kernel spreads incoming packets across the sockets, each with its own
+     * receive buffer and \a async_cnt read slots. Outgoing packets are sent
+     * with the first socket. This is only supported on platforms that have
+     * SO_REUSEPORT, otherwise transport creation fails with PJ_ENOTSUP.
+     *
+     * When the transport is restarted with a new socket, the additional
+     * sockets are closed and the transport continues with the new socket
+     * only.
+     *
+     * Default: 1
+     */
+    unsigned            sock_cnt;
+
+    /**
+     * Socket receive buffer size (SO_RCVBUF) to be applied to the sockets.
+     * If the size can't be applied, the highest possible size will be used.
+     * Zero means to use the operating system default.
+     *
+     * Default: PJSIP_UDP_SO_RCVBUF_SIZE
+     */
+    unsigned            rcvbuf_size;
+
+    /**
+     * Socket send buffer size (SO_SNDBUF) to be applied to the sockets.
+     * If the size can't be applied, the highest possible size will be used.
+     * Zero means to use the operating system default.
+     *
+     * Default: PJSIP_UDP_SO_SNDBUF_SIZE
+     */
+    unsigned            sndbuf_size;
+
 } pjsip_udp_transport_cfg;
 
 
+/**
+ * Packet statistics of UDP transport, see #pjsip_udp_transport_get_stat().
+ */
+typedef struct pjsip_udp_transport_stat
+{
+    /** Number of packets received and passed to the transport manager. */
+    pj_uint64_t         rx_pkt;
+
+    /** Number of bytes received, in packets counted in \a rx_pkt. */
+    pj_uint64_t         rx_bytes;
+
+    /** Number of received packets dropped because they are too short to
+     *  be a SIP message. */
+    pj_uint64_t         rx_drop;
+
+    /** Number of received packets which failed to be parsed as SIP
+     *  message. */
+    pj_uint64_t         rx_parse_err;
+
+    /** Number of receive errors reported by the socket. */
+    pj_uint64_t         rx_err;
+
+    /** Number of packets sent. */
+    pj_uint64_t         tx_pkt;
+
+    /** Number of bytes sent. */
+    pj_uint64_t         tx_bytes;
+
+    /** Number of packets which failed to be sent. */
+    pj_uint64_t         tx_err;
+
+} pjsip_udp_transport_stat;
+
+
 /**
  * Initialize pjsip_udp_transport_cfg structure with default values for
  * the specifed address family.
@@ -244,6 +312,27 @@ PJ_DECL(pj_status_t) pjsip_udp_transport_attach2(pjsip_endpoint *endpt,
 PJ_DECL(pj_sock_t) pjsip_udp_transport_get_socket(pjsip_transport *transport);
 
 
+/**
+ * Get the packet statistics of the UDP transport, either of the whole
+ * transport or of one of its sockets (see \a sock_cnt setting in
+ * #pjsip_udp_transport_cfg). The counters are updated without locking,
+ * so a snapshot taken while the transport is busy may be slightly
+ * inconsistent between the fields.
+ *
+ * @param transport     The UDP transport.
+ * @param sock_idx      Index of the socket, or -1 to get the statistics
+ *                      of the whole transport.
+ * @param stat          Pointer to receive the statistics.
+ *
+ * @return              PJ_SUCCESS, or PJ_EINVAL if the socket index is
+ *                      invalid.
+ */
+PJ_DECL(pj_status_t) pjsip_udp_transport_get_stat(
+                                        pjsip_transport *transport,
+                                        int sock_idx,
+                                        pjsip_udp_transport_stat *stat);
+
+
 /**
  * Temporarily pause or shutdown the transport. When transport is being
  * paused, it cannot be used by the SIP stack to send or receive SIP
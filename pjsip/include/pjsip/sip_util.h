@@ -803,6 +803,30 @@ PJ_DECL(pj_status_t) pjsip_endpt_send_request( pjsip_endpoint *endpt,
  * @{
  */
 
+/**
+ * Option flags for #pjsip_endpt_create_request_fwd() and
+ * #pjsip_endpt_create_response_fwd().
+ */
+typedef enum pjsip_fwd_option
+{
+    /**
+     * Build the forwarded message from the bytes of the received message
+     * instead of deep cloning every header. The received packet is copied
+     * once, and the headers which a proxy does not normally touch are kept
+     * as lazy headers (see #pjsip_lazy_hdr) which are printed from the
+     * original bytes. The new Via, Max-Forwards, From, To, Call-ID and
+     * CSeq headers are created as typed headers.
+     *
+     * A lazy header is parsed, and from then on is printed from the parsed
+     * header, as soon as it is looked up by type, e.g. with
+     * #pjsip_msg_find_hdr(), so headers which are modified by application
+     * are always re-encoded. Application which walks the header list and
+     * checks the header type must call #pjsip_msg_parse_lazy_hdrs() first.
+     */
+    PJSIP_FWD_ZERO_COPY = 1
+
+} pjsip_fwd_option;
+
 /**
  * Create new request message to be forwarded upstream to new destination URI 
  * in uri. The new request is a full/deep clone of the request received in 
@@ -823,7 +847,8 @@ PJ_DECL(pj_status_t) pjsip_endpt_send_request( pjsip_endpoint *endpt,
  *                  detection. If the branch parameter is not specified,
  *                  this function will generate its own by calling 
  *                  #pjsip_calculate_branch_id() function.
- * @param options   Optional option flags when duplicating the message.
+ * @param options   Optional option flags when duplicating the message,
+ *                  see #pjsip_fwd_option.
  * @param tdata     The result.
  *
  * @return          PJ_SUCCESS on success.
@@ -847,7 +872,8 @@ PJ_DECL(pj_status_t) pjsip_endpt_create_request_fwd(pjsip_endpoint *endpt,
  *
  * @param endpt     The endpoint instance.
  * @param rdata     The incoming response message.
- * @param options   Optional option flags when duplicate the message.
+ * @param options   Optional option flags when duplicate the message,
+ *                  see #pjsip_fwd_option.
  * @param tdata     The result
  *
  * @return          PJ_SUCCESS on success.
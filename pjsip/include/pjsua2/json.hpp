@@ -53,14 +53,17 @@ public:
     ~JsonDocument();
 
     /**
-     * Load this document from a file.
+     * Load this document from a file. The whole document is read and
+     * parsed into a tree of elements, since persistent objects may read
+     * their fields by name and in any order.
      *
      * @param filename          The file name.
      */
     virtual void   loadFile(const string &filename) PJSUA2_THROW(Error);
 
     /**
-     * Load this document from string.
+     * Load this document from string. As with loadFile(), the whole
+     * document is parsed into a tree of elements.
      *
      * @param input             The string.
      */
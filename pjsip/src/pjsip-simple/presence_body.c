@@ -259,6 +259,174 @@ PJ_DEF(pj_status_t) pjsip_pres_parse_pidf2(char *body, unsigned body_len,
 }
 
 
+/* Element of interest in pjsip_pres_parse_pidf_basic() */
+enum pidf_field
+{
+    PIDF_NONE,
+    PIDF_CONTACT,
+    PIDF_BASIC,
+    PIDF_TUPLE_NOTE,
+    PIDF_ROOT_NOTE,
+    PIDF_PERSON_NOTE,
+    PIDF_ACTIVITIES_NOTE
+};
+
+/*
+ * Parse PIDF body without building the XML tree.
+ */
+PJ_DEF(pj_status_t) pjsip_pres_parse_pidf_basic(char *body,
+                                                unsigned body_len,
+                                                pj_pool_t *pool,
+                                                pjsip_pres_status *pres_status)
+{
+    static const pj_str_t STR_PRESENCE = { "presence", 8 };
+    static const pj_str_t STR_TUPLE = { "tuple", 5 };
+    static const pj_str_t STR_STATUS = { "status", 6 };
+    static const pj_str_t STR_BASIC = { "basic", 5 };
+    static const pj_str_t STR_CONTACT = { "contact", 7 };
+    static const pj_str_t STR_NOTE = { "note", 4 };
+    static const pj_str_t STR_PERSON = { "person", 6 };
+    static const pj_str_t STR_ACTIVITIES = { "activities", 10 };
+    static const pj_str_t STR_ID = { "id", 2 };
+    static const pj_str_t STR_OPEN = { "open", 4 };
+    pj_xml_reader rd;
+    pj_xml_event ev;
+    pj_str_t path[4];
+    pj_str_t notes[PIDF_ACTIVITIES_NOTE+1];
+    enum pidf_field field = PIDF_NONE;
+    pj_bool_t has_person = PJ_FALSE;
+    int tuple = -1;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(body && pool && pres_status, PJ_EINVAL);
+
+    if (pj_xml_reader_init(&rd, body, body_len, 0) != PJ_SUCCESS)
+        return PJSIP_SIMPLE_EBADPIDF;
+
+    pres_status->info_cnt = 0;
+    pj_bzero(notes, sizeof(notes));
+
+    while ((status=pj_xml_reader_next(&rd, &ev)) == PJ_SUCCESS) {
+        if (ev.type == PJ_XML_EVENT_END) {
+            field = PIDF_NONE;
+            continue;
+        }
+
+        if (ev.type == PJ_XML_EVENT_TEXT) {
+            if (field == PIDF_CONTACT) {
+                pj_strdup(pool, &pres_status->info[tuple].contact, &ev.text);
+            } else if (field == PIDF_BASIC) {
+                pj_str_t text = ev.text;
+                pj_strtrim(&text);
+                pres_status->info[tuple].basic_open =
+                    (pj_stricmp(&text, &STR_OPEN) == 0);
+            } else if (field != PIDF_NONE && notes[field].slen == 0) {
+                notes[field] = ev.text;
+            }
+            continue;
+        }
+
+        /* Start of element. Elements deeper than the ones we're
+         * interested in are skipped altogether.
+         */
+        if (ev.depth > PJ_ARRAY_SIZE(path)) {
+            pj_xml_reader_skip(&rd);
+            continue;
+        }
+        path[ev.depth-1] = ev.local_name;
+
+        switch (ev.depth) {
+        case 1:
+            if (pj_stricmp(&ev.local_name, &STR_PRESENCE) != 0) {
+                pj_xml_reader_fini(&rd);
+                return PJSIP_SIMPLE_EBADPIDF;
+            }
+            break;
+        case 2:
+            if (pj_stricmp(&ev.local_name, &STR_TUPLE) == 0) {
+                const pj_str_t *id;
+
+                if (pres_status->info_cnt == PJSIP_PRES_STATUS_MAX_INFO) {
+                    pj_xml_reader_skip(&rd);
+                    break;
+                }
+
+                tuple = pres_status->info_cnt++;
+                pj_bzero(&pres_status->info[tuple],
+                         sizeof(pres_status->info[tuple]));
+                id = pj_xml_event_find_attr(&ev, &STR_ID);
+                if (id)
+                    pj_strdup(pool, &pres_status->info[tuple].id, id);
+            } else if (pj_stricmp(&ev.local_name, &STR_PERSON) == 0) {
+                has_person = PJ_TRUE;
+            } else if (pj_stricmp(&ev.local_name, &STR_NOTE) == 0) {
+                field = PIDF_ROOT_NOTE;
+            } else {
+                pj_xml_reader_skip(&rd);
+            }
+            break;
+        case 3:
+            if (pj_stricmp(&path[1], &STR_TUPLE) == 0) {
+                if (pj_stricmp(&ev.local_name, &STR_CONTACT) == 0)
+                    field = PIDF_CONTACT;
+                else if (pj_stricmp(&ev.local_name, &STR_NOTE) == 0 &&
+                         tuple == 0)
+                    field = PIDF_TUPLE_NOTE;
+                else if (pj_stricmp(&ev.local_name, &STR_STATUS) != 0)
+                    pj_xml_reader_skip(&rd);
+            } else {
+                /* Inside <person> */
+                if (pj_stricmp(&ev.local_name, &STR_NOTE) == 0)
+                    field = PIDF_PERSON_NOTE;
+                else if (pj_stricmp(&ev.local_name, &STR_ACTIVITIES) != 0)
+                    pj_xml_reader_skip(&rd);
+            }
+            break;
+        case 4:
+            if (pj_stricmp(&path[2], &STR_STATUS) == 0 &&
+                pj_stricmp(&ev.local_name, &STR_BASIC) == 0)
+            {
+                field = PIDF_BASIC;
+            } else if (pj_stricmp(&path[2], &STR_ACTIVITIES) == 0 &&
+                       pj_stricmp(&ev.local_name, &STR_NOTE) == 0)
+            {
+                field = PIDF_ACTIVITIES_NOTE;
+            } else {
+                pj_xml_reader_skip(&rd);
+            }
+            break;
+        }
+    }
+
+    pj_xml_reader_fini(&rd);
+
+    if (status != PJ_EEOF)
+        return PJSIP_SIMPLE_EBADPIDF;
+
+    /* Get the note with the same precedence as pjrpid_get_element() */
+    if (pres_status->info_cnt) {
+        pjrpid_element *rpid = &pres_status->info[0].rpid;
+        const pj_str_t *note = NULL;
+
+        rpid->activity = PJRPID_ACTIVITY_UNKNOWN;
+
+        if (has_person && notes[PIDF_ACTIVITIES_NOTE].slen)
+            note = &notes[PIDF_ACTIVITIES_NOTE];
+        else if (has_person && notes[PIDF_PERSON_NOTE].slen)
+            note = &notes[PIDF_PERSON_NOTE];
+        else if (notes[PIDF_TUPLE_NOTE].slen)
+            note = &notes[PIDF_TUPLE_NOTE];
+        else if (notes[PIDF_ROOT_NOTE].slen)
+            note = &notes[PIDF_ROOT_NOTE];
+
+        if (note)
+            pj_strdup(pool, &rpid->note, note);
+    }
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * This is a utility function to parse X-PIDF body into PJSIP presence status.
  */
@@ -2060,6 +2060,8 @@ static void remove_val_from_array_hdr(pjsip_generic_array_hdr *arr_hdr,
     unsigned i;
     for (i=0; i<arr_hdr->count; ++i) {
         if (pj_stricmp(&arr_hdr->values[i], val)==0) {
+            /* May be a clone of the endpoint capability header */
+            pjsip_hdr_unfreeze(arr_hdr);
             pj_array_erase(arr_hdr->values, sizeof(arr_hdr->values[0]),
                            arr_hdr->count, i);
             --arr_hdr->count;
@@ -3567,8 +3569,10 @@ PJ_DEF(pj_status_t) pjsip_inv_reinvite( pjsip_inv_session *inv,
         }
     }
 
-    if (contact_hdr)
+    if (contact_hdr) {
+        pjsip_hdr_freeze(inv->dlg->pool, contact_hdr);
         inv->dlg->local.contact = contact_hdr;
+    }
 
     status = pjsip_inv_invite(inv, p_tdata);
 
@@ -3654,6 +3658,7 @@ PJ_DEF(pj_status_t) pjsip_inv_update (  pjsip_inv_session *inv,
             goto on_error;
         }
 
+        pjsip_hdr_freeze(inv->dlg->pool, contact_hdr);
         inv->dlg->local.contact = contact_hdr;
     }
 
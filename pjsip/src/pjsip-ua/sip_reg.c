@@ -57,6 +57,45 @@ enum regc_op
     REGC_UNREGISTERING
 };
 
+/* Entry of a client registration in the scheduler's queue */
+typedef struct regc_sched_entry
+{
+    PJ_DECL_LIST_MEMBER(struct regc_sched_entry);
+    pjsip_regc                  *regc;
+    pj_time_val                  ready;     /* Earliest time to send.   */
+    pj_bool_t                    autoreg;
+    pj_bool_t                    is_retry;
+    pj_bool_t                    queued;
+} regc_sched_entry;
+
+/**
+ * Registration scheduler.
+ */
+struct pjsip_regc_sched
+{
+    pj_pool_t                   *pool;
+    pjsip_endpoint              *endpt;
+    pj_lock_t                   *lock;
+    pjsip_regc_sched_param       param;
+
+    regc_sched_entry             retry_list;
+    regc_sched_entry             queue_list;
+    unsigned                     queue_cnt;
+    unsigned                     retry_cnt;
+    unsigned                     sent_cnt;
+
+    /* Earliest tick time, in usec, the next request may be sent, for the
+     * rate limit. Kept finer than the msec tick count so that rates which
+     * don't divide a second evenly, or exceed 1000/s, are honoured.
+     */
+    pj_uint64_t                  next_send;
+
+    /* The timer, and the time it is scheduled to fire. */
+    pj_timer_entry               timer;
+    pj_time_val                  wake_time;
+    pj_bool_t                    in_callback;
+};
+
 /**
  * SIP client registration structure.
  */
@@ -115,8 +154,17 @@ struct pjsip_regc
      * we don't keep this transport.
      */
     pjsip_transport             *info_transport;
+
+    /* Registration scheduler, and our entry in its queue. */
+    pjsip_regc_sched            *sched;
+    regc_sched_entry             sched_entry;
+    pj_bool_t                    last_failed;
 };
 
+static void regc_sched_enqueue(pjsip_regc *regc, pj_bool_t autoreg,
+                               pj_bool_t jitter);
+static void regc_sched_cancel(pjsip_regc *regc);
+
 
 PJ_DEF(pj_status_t) pjsip_regc_create( pjsip_endpoint *endpt, void *token,
                                        pjsip_regc_cb *cb,
@@ -184,6 +232,9 @@ PJ_DEF(pj_status_t) pjsip_regc_destroy2(pjsip_regc *regc, pj_bool_t force)
         return PJ_EBUSY;
     }
 
+    /* Drop the registration that is still queued in the scheduler */
+    regc_sched_cancel(regc);
+
     if (regc->has_tsx || pj_atomic_get(regc->busy_ctr) != 0) {
         regc->_delete_flag = 1;
         regc->cb = NULL;
@@ -629,6 +680,7 @@ PJ_DEF(pj_status_t) pjsip_regc_register(pjsip_regc *regc, pj_bool_t autoreg,
         pjsip_endpt_cancel_timer(regc->endpt, &regc->timer);
         regc->timer.id = 0;
     }
+    regc_sched_cancel(regc);
 
     /* Add Allow header (https://github.com/pjsip/pjproject/issues/1039) */
     h_allow = pjsip_endpt_get_capability(regc->endpt, PJSIP_H_ALLOW, NULL);
@@ -664,6 +716,7 @@ PJ_DEF(pj_status_t) pjsip_regc_unregister(pjsip_regc *regc,
         pjsip_endpt_cancel_timer(regc->endpt, &regc->timer);
         regc->timer.id = 0;
     }
+    regc_sched_cancel(regc);
 
     regc->expires_requested = 0;
 
@@ -718,6 +771,7 @@ PJ_DEF(pj_status_t) pjsip_regc_unregister_all(pjsip_regc *regc,
         pjsip_endpt_cancel_timer(regc->endpt, &regc->timer);
         regc->timer.id = 0;
     }
+    regc_sched_cancel(regc);
 
     status = create_request(regc, &tdata);
     if (status != PJ_SUCCESS) {
@@ -814,37 +868,54 @@ static void call_callback(pjsip_regc *regc, pj_status_t status, int st_code,
     (*regc->cb)(&cbparam);
 }
 
-static void regc_refresh_timer_cb( pj_timer_heap_t *timer_heap,
-                                   struct pj_timer_entry *entry)
+/* Create and send REGISTER request, report the error to the callback */
+static void regc_send_register(pjsip_regc *regc, pj_bool_t autoreg)
 {
-    pjsip_regc *regc = (pjsip_regc*) entry->user_data;
     pjsip_tx_data *tdata;
     pj_status_t status;
-    
-    PJ_UNUSED_ARG(timer_heap);
 
     /* Temporarily increase busy flag to prevent regc from being deleted
      * in pjsip_regc_send() or in the callback
      */
     pjsip_regc_add_ref(regc);
 
-    entry->id = 0;
-    status = pjsip_regc_register(regc, 1, &tdata);
+    status = pjsip_regc_register(regc, autoreg, &tdata);
     if (status == PJ_SUCCESS) {
         status = pjsip_regc_send(regc, tdata);
     } 
     
-    if (status != PJ_SUCCESS && regc->cb) {
-        char errmsg[PJ_ERR_MSG_SIZE];
-        pj_str_t reason = pj_strerror(status, errmsg, sizeof(errmsg));
-        call_callback(regc, status, 400, &reason, NULL, NOEXP, 0, NULL,
-                      PJ_FALSE);
+    if (status != PJ_SUCCESS) {
+        regc->last_failed = PJ_TRUE;
+        if (regc->cb) {
+            char errmsg[PJ_ERR_MSG_SIZE];
+            pj_str_t reason = pj_strerror(status, errmsg, sizeof(errmsg));
+            call_callback(regc, status, 400, &reason, NULL, NOEXP, 0, NULL,
+                          PJ_FALSE);
+        }
     }
 
     /* Delete the record if user destroy regc during the callback. */
     pjsip_regc_dec_ref(regc);
 }
 
+static void regc_refresh_timer_cb( pj_timer_heap_t *timer_heap,
+                                   struct pj_timer_entry *entry)
+{
+    pjsip_regc *regc = (pjsip_regc*) entry->user_data;
+    
+    PJ_UNUSED_ARG(timer_heap);
+
+    entry->id = 0;
+
+    /* Let the scheduler send the refresh when it is attached */
+    if (regc->sched) {
+        regc_sched_enqueue(regc, PJ_TRUE, PJ_FALSE);
+        return;
+    }
+
+    regc_send_register(regc, PJ_TRUE);
+}
+
 static void schedule_registration ( pjsip_regc *regc, pj_uint32_t expiration )
 {
     if (regc->auto_reg && expiration > 0 && expiration != NOEXP) {
@@ -861,13 +932,31 @@ static void schedule_registration ( pjsip_regc *regc, pj_uint32_t expiration )
         }
         if (delay.sec < DELAY_BEFORE_REFRESH) 
             delay.sec = DELAY_BEFORE_REFRESH;
+
+        /* Spread the refreshes of registrations in the scheduler */
+        if (regc->sched && regc->sched->param.refresh_jitter &&
+            delay.sec > DELAY_BEFORE_REFRESH)
+        {
+            pj_uint32_t msec, jitter;
+
+            msec = (pj_uint32_t)delay.sec * 1000;
+            jitter = (pj_uint32_t)pj_rand() %
+                     (msec / 100 * regc->sched->param.refresh_jitter + 1);
+            if (msec - jitter < DELAY_BEFORE_REFRESH * 1000)
+                jitter = msec - DELAY_BEFORE_REFRESH * 1000;
+            msec -= jitter;
+
+            delay.sec = msec / 1000;
+            delay.msec = msec % 1000;
+        }
+
         regc->timer.cb = &regc_refresh_timer_cb;
         regc->timer.id = REFRESH_TIMER;
         regc->timer.user_data = regc;
         pjsip_endpt_schedule_timer( regc->endpt, &regc->timer, &delay);
         pj_gettimeofday(&regc->last_reg);
         regc->next_reg = regc->last_reg;
-        regc->next_reg.sec += delay.sec;
+        PJ_TIME_VAL_ADD(regc->next_reg, delay);
     }
 }
 
@@ -940,6 +1029,7 @@ static pj_uint32_t calculate_response_expiration(const pjsip_regc *regc,
     const pjsip_hdr *hdr;
 
     /* Enumerate all Contact headers in the response */
+    pjsip_msg_parse_lazy_hdrs(rdata->msg_info.msg);
     *contact_cnt = 0;
     for (hdr=msg->hdr.next; hdr!=&msg->hdr; hdr=hdr->next) {
         if (hdr->type == PJSIP_H_CONTACT && 
@@ -1365,6 +1455,8 @@ handle_err:
         pjsip_contact_hdr *contact[PJSIP_REGC_MAX_CONTACT];
         pj_bool_t is_unreg;
 
+        regc->last_failed = (tsx->status_code/100 != 2);
+
         if (tsx->status_code/100 == 2) {
 
             rdata = event->body.tsx_state.src.rdata;
@@ -1563,3 +1655,373 @@ PJ_DEF(pj_status_t) pjsip_regc_set_auth_sess( pjsip_regc *regc,
     PJ_ASSERT_RETURN(regc, PJ_EINVAL);
     return pjsip_auth_clt_set_parent(&regc->auth_sess, session);
 }
+
+
+/*****************************************************************************
+ * Registration scheduler.
+ */
+
+static void regc_sched_timer_cb(pj_timer_heap_t *timer_heap,
+                                struct pj_timer_entry *entry);
+
+PJ_DEF(void) pjsip_regc_sched_param_default(pjsip_regc_sched_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->max_rate = PJSIP_REGC_SCHED_MAX_RATE;
+    param->init_jitter = PJSIP_REGC_SCHED_INIT_JITTER;
+    param->refresh_jitter = PJSIP_REGC_SCHED_REFRESH_JITTER;
+}
+
+PJ_DEF(pj_status_t) pjsip_regc_sched_create(
+                                        pjsip_endpoint *endpt,
+                                        const pjsip_regc_sched_param *param,
+                                        pjsip_regc_sched **p_sched)
+{
+    pj_pool_t *pool;
+    pjsip_regc_sched *sched;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && p_sched, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!param || param->refresh_jitter < 100, PJ_EINVAL);
+
+    pool = pjsip_endpt_create_pool(endpt, "regcsched%p", 512, 512);
+    PJ_ASSERT_RETURN(pool != NULL, PJ_ENOMEM);
+
+    sched = PJ_POOL_ZALLOC_T(pool, pjsip_regc_sched);
+    sched->pool = pool;
+    sched->endpt = endpt;
+    if (param)
+        pj_memcpy(&sched->param, param, sizeof(*param));
+    else
+        pjsip_regc_sched_param_default(&sched->param);
+
+    status = pj_lock_create_simple_mutex(pool, pool->obj_name, &sched->lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+
+    pj_list_init(&sched->retry_list);
+    pj_list_init(&sched->queue_list);
+    pj_timer_entry_init(&sched->timer, 0, sched, &regc_sched_timer_cb);
+
+    *p_sched = sched;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjsip_regc_sched_destroy(pjsip_regc_sched *sched)
+{
+    PJ_ASSERT_RETURN(sched, PJ_EINVAL);
+
+    /* Drop the queued registrations. The reference is released outside
+     * the lock, since it may destroy the client registration.
+     */
+    for (;;) {
+        regc_sched_entry *e = NULL;
+
+        pj_lock_acquire(sched->lock);
+        if (!pj_list_empty(&sched->retry_list))
+            e = sched->retry_list.next;
+        else if (!pj_list_empty(&sched->queue_list))
+            e = sched->queue_list.next;
+        if (e) {
+            pj_list_erase(e);
+            e->queued = PJ_FALSE;
+        }
+        pj_lock_release(sched->lock);
+
+        if (!e)
+            break;
+        pjsip_regc_dec_ref(e->regc);
+    }
+
+    if (sched->timer.id != 0) {
+        pjsip_endpt_cancel_timer(sched->endpt, &sched->timer);
+        sched->timer.id = 0;
+    }
+
+    pj_lock_destroy(sched->lock);
+    pjsip_endpt_release_pool(sched->endpt, sched->pool);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjsip_regc_sched_get_info(pjsip_regc_sched *sched,
+                                              pjsip_regc_sched_info *info)
+{
+    PJ_ASSERT_RETURN(sched && info, PJ_EINVAL);
+
+    pj_lock_acquire(sched->lock);
+    info->queue_cnt = sched->queue_cnt;
+    info->retry_cnt = sched->retry_cnt;
+    info->sent_cnt = sched->sent_cnt;
+    pj_lock_release(sched->lock);
+
+    return PJ_SUCCESS;
+}
+
+/* Convert tick time to usec */
+static pj_uint64_t tv_to_usec(const pj_time_val *t)
+{
+    return (pj_uint64_t)t->sec * 1000000 + (pj_uint64_t)t->msec * 1000;
+}
+
+/* Get the time the scheduler needs to run, the scheduler must be locked */
+static pj_bool_t sched_get_wake_time(pjsip_regc_sched *sched,
+                                     pj_time_val *wake)
+{
+    if (!pj_list_empty(&sched->retry_list)) {
+        *wake = sched->retry_list.next->ready;
+    } else if (!pj_list_empty(&sched->queue_list)) {
+        *wake = sched->queue_list.next->ready;
+    } else {
+        return PJ_FALSE;
+    }
+
+    if (sched->param.max_rate &&
+        tv_to_usec(wake) < sched->next_send)
+    {
+        /* Round up, the request can't be sent before next_send */
+        pj_uint64_t msec = (sched->next_send + 999) / 1000;
+        wake->sec = (long)(msec / 1000);
+        wake->msec = (long)(msec % 1000);
+    }
+
+    return PJ_TRUE;
+}
+
+/* Schedule the timer for the earliest entry, the scheduler must be locked */
+static void sched_update_timer(pjsip_regc_sched *sched)
+{
+    pj_time_val wake, now, delay;
+
+    /* The timer callback will reschedule when it's done */
+    if (sched->in_callback)
+        return;
+
+    if (!sched_get_wake_time(sched, &wake))
+        return;
+
+    if (sched->timer.id != 0) {
+        if (PJ_TIME_VAL_GTE(wake, sched->wake_time))
+            return;
+        pjsip_endpt_cancel_timer(sched->endpt, &sched->timer);
+        sched->timer.id = 0;
+    }
+
+    pj_gettickcount(&now);
+    if (PJ_TIME_VAL_GT(wake, now)) {
+        delay = wake;
+        PJ_TIME_VAL_SUB(delay, now);
+    } else {
+        delay.sec = delay.msec = 0;
+    }
+
+    sched->wake_time = wake;
+    sched->timer.id = 1;
+    if (pjsip_endpt_schedule_timer(sched->endpt, &sched->timer,
+                                   &delay) != PJ_SUCCESS)
+    {
+        sched->timer.id = 0;
+    }
+}
+
+/* Take the entry that may be sent now, the scheduler must be locked */
+static regc_sched_entry *sched_pop_ready(pjsip_regc_sched *sched)
+{
+    regc_sched_entry *e = NULL;
+    pj_time_val now;
+    pj_uint64_t now_usec;
+
+    pj_gettickcount(&now);
+    now_usec = tv_to_usec(&now);
+
+    if (sched->param.max_rate && now_usec < sched->next_send)
+        return NULL;
+
+    /* Retries go before the other registrations */
+    if (!pj_list_empty(&sched->retry_list) &&
+        PJ_TIME_VAL_LTE(sched->retry_list.next->ready, now))
+    {
+        e = sched->retry_list.next;
+        --sched->retry_cnt;
+    } else if (!pj_list_empty(&sched->queue_list) &&
+               PJ_TIME_VAL_LTE(sched->queue_list.next->ready, now))
+    {
+        e = sched->queue_list.next;
+    } else {
+        return NULL;
+    }
+
+    pj_list_erase(e);
+    e->queued = PJ_FALSE;
+    --sched->queue_cnt;
+    ++sched->sent_cnt;
+
+    if (sched->param.max_rate) {
+        pj_uint64_t interval = 1000000 / sched->param.max_rate;
+        pj_uint64_t max_lag = interval > 1000 ? interval : 1000;
+
+        if (interval == 0)
+            interval = 1;
+
+        /* Don't let the sends that were skipped while the queue was empty
+         * be made up with a burst. Lagging less than a tick (or one
+         * interval) behind is normal, since the timer only has msec
+         * resolution, and is kept so the fractions add up to the rate.
+         */
+        if (sched->next_send + max_lag <= now_usec)
+            sched->next_send = now_usec;
+        sched->next_send += interval;
+    }
+
+    return e;
+}
+
+static void regc_sched_timer_cb(pj_timer_heap_t *timer_heap,
+                                struct pj_timer_entry *entry)
+{
+    pjsip_regc_sched *sched = (pjsip_regc_sched*) entry->user_data;
+
+    PJ_UNUSED_ARG(timer_heap);
+
+    pj_lock_acquire(sched->lock);
+    entry->id = 0;
+    sched->in_callback = PJ_TRUE;
+    pj_lock_release(sched->lock);
+
+    for (;;) {
+        regc_sched_entry *e;
+        pjsip_regc *regc;
+        pj_bool_t autoreg;
+
+        pj_lock_acquire(sched->lock);
+        e = sched_pop_ready(sched);
+        if (!e) {
+            sched->in_callback = PJ_FALSE;
+            sched_update_timer(sched);
+            pj_lock_release(sched->lock);
+            break;
+        }
+        regc = e->regc;
+        autoreg = e->autoreg;
+        pj_lock_release(sched->lock);
+
+        if (!regc->_delete_flag)
+            regc_send_register(regc, autoreg);
+
+        /* Release the reference of the queue */
+        pjsip_regc_dec_ref(regc);
+    }
+}
+
+/* Queue the registration in the scheduler */
+static void regc_sched_enqueue(pjsip_regc *regc, pj_bool_t autoreg,
+                               pj_bool_t jitter)
+{
+    pjsip_regc_sched *sched = regc->sched;
+    regc_sched_entry *e = &regc->sched_entry;
+    regc_sched_entry *list, *pos;
+
+    pj_lock_acquire(sched->lock);
+
+    e->autoreg = autoreg;
+    if (e->queued) {
+        pj_lock_release(sched->lock);
+        return;
+    }
+
+    pj_gettickcount(&e->ready);
+    e->is_retry = regc->last_failed;
+    if (e->is_retry) {
+        list = &sched->retry_list;
+        ++sched->retry_cnt;
+    } else {
+        list = &sched->queue_list;
+        if (jitter && sched->param.init_jitter) {
+            pj_time_val delay;
+            unsigned msec;
+
+            msec = (unsigned)pj_rand() % (sched->param.init_jitter + 1);
+            delay.sec = msec / 1000;
+            delay.msec = msec % 1000;
+            PJ_TIME_VAL_ADD(e->ready, delay);
+        }
+    }
+
+    /* Keep the list sorted by the ready time */
+    pos = list->prev;
+    while (pos != list && PJ_TIME_VAL_GT(pos->ready, e->ready))
+        pos = pos->prev;
+    pj_list_insert_after(pos, e);
+
+    e->queued = PJ_TRUE;
+    ++sched->queue_cnt;
+
+    /* The queue keeps a reference to the client registration */
+    pjsip_regc_add_ref(regc);
+
+    sched_update_timer(sched);
+
+    pj_lock_release(sched->lock);
+}
+
+/* Remove the registration from the scheduler's queue. This doesn't destroy
+ * the client registration, the caller is expected to hold a reference to
+ * it or to be about to destroy it.
+ */
+static void regc_sched_cancel(pjsip_regc *regc)
+{
+    pjsip_regc_sched *sched = regc->sched;
+    regc_sched_entry *e = &regc->sched_entry;
+    pj_bool_t queued;
+
+    if (!sched)
+        return;
+
+    pj_lock_acquire(sched->lock);
+    queued = e->queued;
+    if (queued) {
+        pj_list_erase(e);
+        e->queued = PJ_FALSE;
+        --sched->queue_cnt;
+        if (e->is_retry)
+            --sched->retry_cnt;
+    }
+    pj_lock_release(sched->lock);
+
+    if (queued)
+        pj_atomic_dec(regc->busy_ctr);
+}
+
+PJ_DEF(pj_status_t) pjsip_regc_set_sched(pjsip_regc *regc,
+                                         pjsip_regc_sched *sched)
+{
+    PJ_ASSERT_RETURN(regc, PJ_EINVAL);
+
+    pj_lock_acquire(regc->lock);
+    if (regc->sched != sched) {
+        regc_sched_cancel(regc);
+        regc->sched = sched;
+        regc->sched_entry.regc = regc;
+    }
+    pj_lock_release(regc->lock);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjsip_regc_sched_register(pjsip_regc *regc,
+                                              pj_bool_t autoreg)
+{
+    PJ_ASSERT_RETURN(regc, PJ_EINVAL);
+
+    pj_lock_acquire(regc->lock);
+    if (!regc->sched) {
+        pj_lock_release(regc->lock);
+        return PJ_EINVALIDOP;
+    }
+    regc_sched_enqueue(regc, autoreg, PJ_TRUE);
+    pj_lock_release(regc->lock);
+
+    return PJ_SUCCESS;
+}
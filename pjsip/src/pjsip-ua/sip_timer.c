@@ -1221,8 +1221,10 @@ PJ_DEF(pj_status_t) pjsip_timer_update_resp(pjsip_inv_session *inv,
                         }
                     }
                 }
-                if (!req_hdr_has_timer)
+                if (!req_hdr_has_timer) {
+                    pjsip_hdr_unfreeze(req_hdr);
                     req_hdr->values[req_hdr->count++] = STR_TIMER;
+                }
             }
             
             /* Finally, start timer. */
@@ -106,6 +106,10 @@ const pjsip_auth_algorithm pjsip_auth_algorithms[] = {
 #  define AUTH_TRACE_(expr)
 #endif
 
+/* Send authorization from the last challenge in new requests? */
+#define AUTO_SEND_NEXT(sess) \
+    (PJSIP_AUTH_AUTO_SEND_NEXT || (sess)->pref.auto_send_next)
+
 #define DO_ON_PARENT_LOCKED(sess, call) \
     do { \
         pj_status_t on_parent = PJ_SUCCESS; \
@@ -208,6 +212,64 @@ static void digestNtoStr(const unsigned char digest[], int n, char *output)
 }
 
 
+/* Compute ha1 = (digest)(username ":" realm ":" password) as string. */
+static void create_ha1(const EVP_MD *md, unsigned digest_len,
+                       const pj_str_t *username, const pj_str_t *realm,
+                       const pj_str_t *passwd, char *ha1)
+{
+    unsigned char digest[PJSIP_AUTH_MAX_DIGEST_BUFFER_LENGTH];
+    unsigned dig_len = digest_len;
+    DEFINE_HASH_CONTEXT;
+
+    mdctx = EVP_MD_CTX_new();
+
+    EVP_DigestInit_ex(mdctx, md, NULL);
+    EVP_DigestUpdate(mdctx, username->ptr, username->slen);
+    EVP_DigestUpdate(mdctx, ":", 1);
+    EVP_DigestUpdate(mdctx, realm->ptr, realm->slen);
+    EVP_DigestUpdate(mdctx, ":", 1);
+    EVP_DigestUpdate(mdctx, passwd->ptr, passwd->slen);
+
+    EVP_DigestFinal_ex(mdctx, digest, &dig_len);
+    EVP_MD_CTX_free(mdctx);
+
+    digestNtoStr(digest, dig_len, ha1);
+}
+
+
+/*
+ * Create the HA1 of a plain text password credential.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_create_ha1(pj_str_t *result,
+                                          const pj_str_t *realm,
+                                          const pjsip_cred_info *cred_info,
+                                          pjsip_auth_algorithm_type algorithm_type)
+{
+    const pjsip_auth_algorithm *algorithm;
+    const EVP_MD* md;
+
+    PJ_ASSERT_RETURN(result && realm && cred_info, PJ_EINVAL);
+    PJ_ASSERT_RETURN(PJSIP_CRED_DATA_IS_PASSWD(cred_info), PJ_EINVAL);
+
+    algorithm = pjsip_auth_get_algorithm_by_type(algorithm_type);
+    if (!algorithm || !pjsip_auth_is_algorithm_supported(algorithm_type))
+        return PJ_ENOTSUP;
+
+    PJ_ASSERT_RETURN(result->slen >= (pj_ssize_t)algorithm->digest_str_length,
+                     PJ_ETOOSMALL);
+
+    md = EVP_get_digestbyname(algorithm->openssl_name);
+    if (md == NULL)
+        return PJ_ENOTSUP;
+
+    create_ha1(md, algorithm->digest_length, &cred_info->username, realm,
+               &cred_info->data, result->ptr);
+    result->slen = algorithm->digest_str_length;
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Create response digest based on the parameters and store the
  * digest ASCII in 'result'.
@@ -309,18 +371,8 @@ PJ_DEF(pj_status_t) pjsip_auth_create_digest2( pj_str_t *result,
         /***
          *** ha1 = (digest)(username ":" realm ":" password)
          ***/
-        mdctx = EVP_MD_CTX_new();
-
-        EVP_DigestInit_ex(mdctx, md, NULL);
-        EVP_DigestUpdate(mdctx, cred_info->username.ptr, cred_info->username.slen);
-        EVP_DigestUpdate(mdctx, ":", 1);
-        EVP_DigestUpdate(mdctx, realm->ptr, realm->slen);
-        EVP_DigestUpdate(mdctx, ":", 1);
-        EVP_DigestUpdate(mdctx, cred_info->data.ptr, cred_info->data.slen);
-
-        EVP_DigestFinal_ex(mdctx, digest, &dig_len);
-        EVP_MD_CTX_free(mdctx);
-        digestNtoStr(digest, dig_len, ha1);
+        create_ha1(md, digest_len, &cred_info->username, realm,
+                   &cred_info->data, ha1);
 
     } else {
         AUTH_TRACE_((THIS_FILE, " Using pre computed digest for %.*s digest",
@@ -628,11 +680,15 @@ static pj_status_t respond_digest( pj_pool_t *pool,
  * Update authentication session with a challenge.
  */
 static void update_digest_session( pjsip_cached_auth *cached_auth,
-                                   const pjsip_www_authenticate_hdr *hdr )
+                                   const pjsip_www_authenticate_hdr *hdr,
+                                   pj_bool_t save_chal )
 {
     if (hdr->challenge.digest.qop.slen == 0) {
-#if PJSIP_AUTH_AUTO_SEND_NEXT!=0
-        if (!cached_auth->last_chal || pj_stricmp2(&hdr->scheme, "digest")) {
+        if (!save_chal) {
+            /* Not needed to send the next request */
+        } else if (!cached_auth->last_chal ||
+                   pj_stricmp2(&hdr->scheme, "digest"))
+        {
             cached_auth->last_chal = (pjsip_www_authenticate_hdr*)
                                      pjsip_hdr_clone(cached_auth->pool, hdr);
         } else {
@@ -654,7 +710,6 @@ static void update_digest_session( pjsip_cached_auth *cached_auth,
                                        pjsip_hdr_clone(cached_auth->pool, hdr);
             }
         }
-#endif
         return;
     }
 
@@ -832,6 +887,7 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_init(  pjsip_auth_clt_sess *sess,
 
     sess->parent = NULL;
     sess->lock = NULL;
+    pj_bzero(&sess->stat, sizeof(sess->stat));
     return PJ_SUCCESS;
 }
 
@@ -1042,6 +1098,66 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_get_prefs(pjsip_auth_clt_sess *sess,
 }
 
 
+/*
+ * Get the statistics of the client authentication session.
+ */
+PJ_DEF(pj_status_t) pjsip_auth_clt_get_stat(pjsip_auth_clt_sess *sess,
+                                            pjsip_auth_clt_stat *stat)
+{
+    PJ_ASSERT_RETURN(sess && stat, PJ_EINVAL);
+    DO_ON_PARENT_LOCKED(sess, pjsip_auth_clt_get_stat(sess->parent, stat));
+    pj_memcpy(stat, &sess->stat, sizeof(pjsip_auth_clt_stat));
+    return PJ_SUCCESS;
+}
+
+
+/* Get the credential to respond to a challenge with. A password is
+ * replaced by its "ha1", which is only hashed the first time.
+ */
+static const pjsip_cred_info *get_ha1_cred(pjsip_auth_clt_sess *sess,
+                                           pjsip_cached_auth *cached_auth,
+                                           const pjsip_cred_info *cred_info,
+                                           const pj_str_t *realm,
+                                           pjsip_cred_info *ha1_cred)
+{
+    /* The cached auth is per realm and algorithm, the realm is compared
+     * as the case matters for the hash.
+     */
+    if (!cached_auth ||
+        cred_info->data_type != PJSIP_CRED_DATA_PLAIN_PASSWD ||
+        pj_strcmp(&cached_auth->realm, realm) != 0)
+    {
+        return cred_info;
+    }
+
+    if (cached_auth->ha1_cred != cred_info) {
+        pj_str_t ha1;
+
+        ha1.ptr = cached_auth->ha1;
+        ha1.slen = sizeof(cached_auth->ha1);
+        if (pjsip_auth_create_ha1(&ha1, realm, cred_info,
+                                  cached_auth->challenge_algorithm_type)
+                != PJ_SUCCESS)
+        {
+            return cred_info;
+        }
+        cached_auth->ha1_cred = cred_info;
+        cached_auth->ha1_len = ha1.slen;
+        ++sess->stat.ha1_cnt;
+    } else {
+        ++sess->stat.ha1_reuse_cnt;
+    }
+
+    pj_memcpy(ha1_cred, cred_info, sizeof(*ha1_cred));
+    ha1_cred->data_type = PJSIP_CRED_DATA_DIGEST;
+    ha1_cred->algorithm_type = cached_auth->challenge_algorithm_type;
+    ha1_cred->data.ptr = cached_auth->ha1;
+    ha1_cred->data.slen = cached_auth->ha1_len;
+
+    return ha1_cred;
+}
+
+
 /*
  * Create Authorization/Proxy-Authorization response header based on the challege
  * in WWW-Authenticate/Proxy-Authenticate header.
@@ -1051,7 +1167,7 @@ static pj_status_t auth_respond( pj_pool_t *req_pool,
                                  const pjsip_uri *uri,
                                  const pjsip_cred_info *cred_info,
                                  const pjsip_method *method,
-                                 pj_pool_t *sess_pool,
+                                 pjsip_auth_clt_sess *sess,
                                  pjsip_cached_auth *cached_auth,
                                  pjsip_authorization_hdr **p_h_auth,
                                  const pjsip_auth_algorithm_type challenge_algorithm_type)
@@ -1064,7 +1180,7 @@ static pj_status_t auth_respond( pj_pool_t *req_pool,
 
     /* Verify arguments. */
     PJ_ASSERT_RETURN(req_pool && hdr && uri && cred_info && method &&
-                     sess_pool && cached_auth && p_h_auth, PJ_EINVAL);
+                     sess && cached_auth && p_h_auth, PJ_EINVAL);
 
     /* Print URL in the original request. */
     uri_str.ptr = tmp;
@@ -1075,13 +1191,12 @@ static pj_status_t auth_respond( pj_pool_t *req_pool,
 
 #   if (PJSIP_AUTH_HEADER_CACHING)
     {
-        pool = sess_pool;
+        pool = sess->pool;
         PJ_UNUSED_ARG(req_pool);
     }
 #   else
     {
         pool = req_pool;
-        PJ_UNUSED_ARG(sess_pool);
     }
 #   endif
 
@@ -1097,12 +1212,13 @@ static pj_status_t auth_respond( pj_pool_t *req_pool,
     if (!pj_stricmp(&hdr->scheme, &pjsip_DIGEST_STR)) {
         pj_str_t *cnonce = NULL;
         pj_uint32_t nc = 1;
+        pjsip_cred_info ha1_cred;
 
         /* Update the session (nonce-count etc) if required. */
 #       if PJSIP_AUTH_QOP_SUPPORT
         {
             if (cached_auth) {
-                update_digest_session( cached_auth, hdr );
+                update_digest_session( cached_auth, hdr, AUTO_SEND_NEXT(sess) );
 
                 cnonce = &cached_auth->cnonce;
                 nc = cached_auth->nc;
@@ -1110,6 +1226,9 @@ static pj_status_t auth_respond( pj_pool_t *req_pool,
         }
 #       endif   /* PJSIP_AUTH_QOP_SUPPORT */
 
+        cred_info = get_ha1_cred(sess, cached_auth, cred_info,
+                                 &hdr->challenge.digest.realm, &ha1_cred);
+
         hauth->scheme = pjsip_DIGEST_STR;
         status = respond_digest( pool, &hauth->credential.digest,
                                  &hdr->challenge.digest, &uri_str, cred_info,
@@ -1161,7 +1280,7 @@ static pj_status_t auth_respond( pj_pool_t *req_pool,
 
 #       if defined(PJSIP_AUTH_AUTO_SEND_NEXT) && PJSIP_AUTH_AUTO_SEND_NEXT!=0
             if (hdr != cached_auth->last_chal) {
-                cached_auth->last_chal = pjsip_hdr_clone(sess_pool, hdr);
+                cached_auth->last_chal = pjsip_hdr_clone(sess->pool, hdr);
             }
 #       endif
     }
@@ -1173,7 +1292,6 @@ static pj_status_t auth_respond( pj_pool_t *req_pool,
 }
 
 
-#if defined(PJSIP_AUTH_AUTO_SEND_NEXT) && PJSIP_AUTH_AUTO_SEND_NEXT!=0
 static pj_status_t new_auth_for_req( pjsip_tx_data *tdata,
                                      pjsip_auth_clt_sess *sess,
                                      pjsip_cached_auth *auth,
@@ -1194,18 +1312,18 @@ static pj_status_t new_auth_for_req( pjsip_tx_data *tdata,
     status = auth_respond( tdata->pool, auth->last_chal,
                            tdata->msg->line.req.uri,
                            cred, &tdata->msg->line.req.method,
-                           sess->pool, auth, &hauth, auth->challenge_algorithm_type);
+                           sess, auth, &hauth, auth->challenge_algorithm_type);
     if (status != PJ_SUCCESS)
         return status;
 
     pjsip_msg_add_hdr( tdata->msg, (pjsip_hdr*)hauth);
+    ++sess->stat.reuse_cnt;
 
     if (p_h_auth)
         *p_h_auth = hauth;
 
     return PJ_SUCCESS;
 }
-#endif
 
 
 /* Find credential in list of (Proxy-)Authorization headers */
@@ -1288,6 +1406,8 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_init_req( pjsip_auth_clt_sess *sess,
         auth->stale_cnt = 0;
 
         if (auth->qop_value == PJSIP_AUTH_QOP_NONE) {
+            pj_bool_t cached = PJ_FALSE;
+
 #           if defined(PJSIP_AUTH_HEADER_CACHING) && \
                PJSIP_AUTH_HEADER_CACHING!=0
             {
@@ -1298,32 +1418,23 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_init_req( pjsip_auth_clt_sess *sess,
                         hauth = pjsip_hdr_shallow_clone(tdata->pool, entry->hdr);
                         //pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)hauth);
                         pj_list_push_back(&added, hauth);
+                        ++sess->stat.reuse_cnt;
+                        cached = PJ_TRUE;
                         break;
                     }
                     entry = entry->next;
                 }
-
-#               if defined(PJSIP_AUTH_AUTO_SEND_NEXT) && \
-                           PJSIP_AUTH_AUTO_SEND_NEXT!=0
-                {
-                    if (entry == &auth->cached_hdr)
-                        new_auth_for_req( tdata, sess, auth, NULL);
-                }
-#               endif
-
-            }
-#           elif defined(PJSIP_AUTH_AUTO_SEND_NEXT) && \
-                 PJSIP_AUTH_AUTO_SEND_NEXT!=0
-            {
-                new_auth_for_req( tdata, sess, auth, NULL);
             }
 #           endif
 
+            if (!cached && AUTO_SEND_NEXT(sess) && auth->last_chal)
+                new_auth_for_req( tdata, sess, auth, NULL);
+
         }
-#       if defined(PJSIP_AUTH_QOP_SUPPORT) && \
-           defined(PJSIP_AUTH_AUTO_SEND_NEXT) && \
-           (PJSIP_AUTH_QOP_SUPPORT && PJSIP_AUTH_AUTO_SEND_NEXT)
-        else if (auth->qop_value == PJSIP_AUTH_QOP_AUTH) {
+#       if defined(PJSIP_AUTH_QOP_SUPPORT) && PJSIP_AUTH_QOP_SUPPORT!=0
+        else if (auth->qop_value == PJSIP_AUTH_QOP_AUTH &&
+                 AUTO_SEND_NEXT(sess))
+        {
             /* For qop="auth", we have to re-create the authorization header.
              */
             const pjsip_cred_info *cred;
@@ -1342,15 +1453,16 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_init_req( pjsip_auth_clt_sess *sess,
                                    tdata->msg->line.req.uri,
                                    cred,
                                    &tdata->msg->line.req.method,
-                                   sess->pool, auth, &hauth,
+                                   sess, auth, &hauth,
                                    auth->challenge_algorithm_type);
             if (status != PJ_SUCCESS)
                 return status;
 
             //pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)hauth);
             pj_list_push_back(&added, hauth);
+            ++sess->stat.reuse_cnt;
         }
-#       endif   /* PJSIP_AUTH_QOP_SUPPORT && PJSIP_AUTH_AUTO_SEND_NEXT */
+#       endif   /* PJSIP_AUTH_QOP_SUPPORT */
 
         auth = auth->next;
     }
@@ -1592,7 +1704,7 @@ static pj_status_t process_auth( pj_pool_t *req_pool,
     /* Respond to authorization challenge. */
     status = auth_respond( req_pool, hchal, uri, cred,
                            &tdata->msg->line.req.method,
-                           sess->pool, cached_auth, h_auth, challenge_algorithm_type);
+                           sess, cached_auth, h_auth, challenge_algorithm_type);
     return status;
 }
 
@@ -1634,6 +1746,7 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_reinit_req(  pjsip_auth_clt_sess *sess,
     /*
      * Respond to each authentication challenge.
      */
+    pjsip_msg_parse_lazy_hdrs(rdata->msg_info.msg);
     hdr = rdata->msg_info.msg->hdr.next;
     chal_cnt = 0;
     auth_cnt = 0;
@@ -1656,6 +1769,7 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_reinit_req(  pjsip_auth_clt_sess *sess,
 
         hchal = (const pjsip_www_authenticate_hdr*)hdr;
         ++chal_cnt;
+        ++sess->stat.chal_cnt;
 
         /* At the current time, "digest" scheme is the only one supported. */
         if (pj_stricmp(&hchal->scheme, &pjsip_DIGEST_STR) != 0) {
@@ -1750,6 +1864,7 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_reinit_req(  pjsip_auth_clt_sess *sess,
 
     /* Retrying.. */
     tdata->auth_retry = PJ_TRUE;
+    ++sess->stat.retry_cnt;
 
     /* Increment reference counter. */
     pjsip_tx_data_add_ref(tdata);
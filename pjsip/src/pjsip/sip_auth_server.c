@@ -22,7 +22,12 @@
 #include <pjsip/sip_auth_msg.h>
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_transport.h>
+#include <pj/hash.h>
+#include <pj/list.h>
+#include <pj/lock.h>
 #include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
 #include <pj/string.h>
 #include <pj/assert.h>
 
@@ -72,11 +77,452 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_init2(
     pj_strdup( pool, &auth_srv->realm, param->realm);
     auth_srv->lookup2 = param->lookup2;
     auth_srv->is_proxy = (param->options & PJSIP_AUTH_SRV_IS_PROXY);
+    auth_srv->cache = param->cache;
+    auth_srv->nonce_store = param->nonce_store;
 
     return PJ_SUCCESS;
 }
 
 
+/*****************************************************************************
+ *
+ * CREDENTIAL CACHE
+ *
+ *****************************************************************************/
+
+/* Cached credential. The key is the algorithm type, the realm, a zero
+ * byte and the account name.
+ */
+typedef struct cache_entry
+{
+    PJ_DECL_LIST_MEMBER(struct cache_entry);
+
+    char                 key[PJSIP_AUTH_SRV_CACHE_KEY_LEN];
+    unsigned             key_len;
+    unsigned             realm_len;
+    pj_uint32_t          hval;
+    pj_hash_entry_buf    hbuf;
+    pj_uint32_t          expiry;
+    char                 ha1[PJSIP_AUTH_MAX_DIGEST_BUFFER_LENGTH * 2];
+    pj_ssize_t           ha1_len;
+} cache_entry;
+
+struct pjsip_auth_srv_cache
+{
+    pj_pool_t           *pool;
+    pj_lock_t           *lock;
+    pj_hash_table_t     *ht;
+    unsigned             max_cnt;
+    unsigned             ttl;
+    unsigned             cnt;
+    cache_entry          lru;           /* Least recently used first */
+    cache_entry          free_list;
+    unsigned             hits;
+    unsigned             misses;
+};
+
+/* Monotonic time in msec, for expiry of cache and nonce store entries. */
+static pj_uint32_t now_msec(void)
+{
+    pj_time_val now;
+
+    pj_gettickcount(&now);
+    return PJ_TIME_VAL_MSEC(now);
+}
+
+/* Build the key of a cached credential, returns zero if it's too long. */
+static unsigned cache_key(char *key, pjsip_auth_algorithm_type algorithm_type,
+                          const pj_str_t *realm, const pj_str_t *acc_name)
+{
+    unsigned len = 1 + (unsigned)realm->slen + 1 + (unsigned)acc_name->slen;
+
+    if (len > PJSIP_AUTH_SRV_CACHE_KEY_LEN)
+        return 0;
+
+    key[0] = (char)algorithm_type;
+    pj_memcpy(key + 1, realm->ptr, realm->slen);
+    key[1 + realm->slen] = '\0';
+    pj_memcpy(key + 2 + realm->slen, acc_name->ptr, acc_name->slen);
+
+    return len;
+}
+
+/* Remove an entry, the cache must be locked. */
+static void cache_remove(pjsip_auth_srv_cache *cache, cache_entry *e)
+{
+    pj_hash_set_np(cache->ht, e->key, e->key_len, e->hval, e->hbuf, NULL);
+    pj_list_erase(e);
+    pj_list_push_back(&cache->free_list, e);
+    --cache->cnt;
+}
+
+PJ_DEF(pj_status_t) pjsip_auth_srv_cache_create(pj_pool_factory *pf,
+                                                unsigned max_cnt,
+                                                unsigned ttl,
+                                                pjsip_auth_srv_cache **p_cache)
+{
+    pj_pool_t *pool;
+    pjsip_auth_srv_cache *cache;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf && p_cache, PJ_EINVAL);
+
+    pool = pj_pool_create(pf, "authcache%p", 1024, 1024, NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    cache = PJ_POOL_ZALLOC_T(pool, pjsip_auth_srv_cache);
+    cache->pool = pool;
+    cache->max_cnt = max_cnt ? max_cnt : PJSIP_AUTH_SRV_CACHE_MAX_CNT;
+    cache->ttl = ttl ? ttl : PJSIP_AUTH_SRV_CACHE_TTL;
+    pj_list_init(&cache->lru);
+    pj_list_init(&cache->free_list);
+
+    cache->ht = pj_hash_create(pool, cache->max_cnt);
+    status = pj_lock_create_simple_mutex(pool, "authcache%p", &cache->lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+
+    *p_cache = cache;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pjsip_auth_srv_cache_invalidate(pjsip_auth_srv_cache *cache,
+                                             const pj_str_t *realm,
+                                             const pj_str_t *acc_name)
+{
+    cache_entry *e, *next;
+
+    PJ_ASSERT_ON_FAIL(cache && realm, return);
+
+    pj_lock_acquire(cache->lock);
+    for (e = cache->lru.next; e != &cache->lru; e = next) {
+        next = e->next;
+
+        if (e->realm_len != (unsigned)realm->slen ||
+            pj_memcmp(e->key + 1, realm->ptr, realm->slen) != 0)
+        {
+            continue;
+        }
+        if (acc_name &&
+            (e->key_len - e->realm_len - 2 != (unsigned)acc_name->slen ||
+             pj_memcmp(e->key + e->realm_len + 2, acc_name->ptr,
+                       acc_name->slen) != 0))
+        {
+            continue;
+        }
+        cache_remove(cache, e);
+    }
+    pj_lock_release(cache->lock);
+}
+
+PJ_DEF(void) pjsip_auth_srv_cache_get_stat(pjsip_auth_srv_cache *cache,
+                                           unsigned *hits,
+                                           unsigned *misses)
+{
+    PJ_ASSERT_ON_FAIL(cache, return);
+
+    pj_lock_acquire(cache->lock);
+    if (hits)
+        *hits = cache->hits;
+    if (misses)
+        *misses = cache->misses;
+    pj_lock_release(cache->lock);
+}
+
+PJ_DEF(pj_status_t) pjsip_auth_srv_cache_destroy(pjsip_auth_srv_cache *cache)
+{
+    PJ_ASSERT_RETURN(cache, PJ_EINVAL);
+
+    pj_lock_destroy(cache->lock);
+    pj_pool_release(cache->pool);
+
+    return PJ_SUCCESS;
+}
+
+/* Find the cached HA1 of the account and put it in cred_info. */
+static pj_bool_t cache_get(pjsip_auth_srv_cache *cache,
+                           pjsip_auth_algorithm_type algorithm_type,
+                           const pj_str_t *realm, const pj_str_t *acc_name,
+                           pjsip_cred_info *cred_info, char *ha1)
+{
+    char key[PJSIP_AUTH_SRV_CACHE_KEY_LEN];
+    unsigned key_len;
+    cache_entry *e;
+    pj_bool_t found = PJ_FALSE;
+
+    key_len = cache_key(key, algorithm_type, realm, acc_name);
+    if (!key_len)
+        return PJ_FALSE;
+
+    pj_lock_acquire(cache->lock);
+
+    e = (cache_entry*) pj_hash_get(cache->ht, key, key_len, NULL);
+    if (e && (pj_int32_t)(now_msec() - e->expiry) >= 0) {
+        cache_remove(cache, e);
+        e = NULL;
+    }
+
+    if (e) {
+        /* Most recently used */
+        pj_list_erase(e);
+        pj_list_push_back(&cache->lru, e);
+
+        pj_memcpy(ha1, e->ha1, e->ha1_len);
+        cred_info->data.ptr = ha1;
+        cred_info->data.slen = e->ha1_len;
+        cred_info->data_type = PJSIP_CRED_DATA_DIGEST;
+        cred_info->algorithm_type = algorithm_type;
+        ++cache->hits;
+        found = PJ_TRUE;
+    } else {
+        ++cache->misses;
+    }
+
+    pj_lock_release(cache->lock);
+
+    return found;
+}
+
+/* Cache the HA1 of a credential which has just been verified. */
+static void cache_put(pjsip_auth_srv_cache *cache,
+                      pjsip_auth_algorithm_type algorithm_type,
+                      const pj_str_t *realm, const pj_str_t *acc_name,
+                      const pjsip_cred_info *cred_info)
+{
+    char key[PJSIP_AUTH_SRV_CACHE_KEY_LEN];
+    char ha1_buf[PJSIP_AUTH_MAX_DIGEST_BUFFER_LENGTH * 2];
+    pj_str_t ha1;
+    unsigned key_len;
+    pj_uint32_t hval = 0;
+    cache_entry *e;
+
+    key_len = cache_key(key, algorithm_type, realm, acc_name);
+    if (!key_len)
+        return;
+
+    if (PJSIP_CRED_DATA_IS_PASSWD(cred_info)) {
+        ha1.ptr = ha1_buf;
+        ha1.slen = sizeof(ha1_buf);
+        if (pjsip_auth_create_ha1(&ha1, &cred_info->realm, cred_info,
+                                  algorithm_type) != PJ_SUCCESS)
+        {
+            return;
+        }
+    } else if (PJSIP_CRED_DATA_IS_DIGEST(cred_info) &&
+               cred_info->algorithm_type == algorithm_type &&
+               cred_info->data.slen <= (pj_ssize_t)sizeof(ha1_buf))
+    {
+        ha1 = cred_info->data;
+    } else {
+        return;
+    }
+
+    pj_lock_acquire(cache->lock);
+
+    e = (cache_entry*) pj_hash_get(cache->ht, key, key_len, &hval);
+    if (e) {
+        pj_list_erase(e);
+    } else {
+        if (!pj_list_empty(&cache->free_list)) {
+            e = cache->free_list.next;
+            pj_list_erase(e);
+        } else if (cache->cnt < cache->max_cnt) {
+            e = PJ_POOL_ALLOC_T(cache->pool, cache_entry);
+        } else {
+            /* Replace the least recently used */
+            cache_remove(cache, cache->lru.next);
+            e = cache->free_list.next;
+            pj_list_erase(e);
+        }
+
+        pj_memcpy(e->key, key, key_len);
+        e->key_len = key_len;
+        e->realm_len = (unsigned)realm->slen;
+        e->hval = hval;
+        pj_hash_set_np(cache->ht, e->key, key_len, hval, e->hbuf, e);
+        ++cache->cnt;
+    }
+
+    pj_memcpy(e->ha1, ha1.ptr, ha1.slen);
+    e->ha1_len = ha1.slen;
+    e->expiry = now_msec() + cache->ttl * 1000;
+    pj_list_push_back(&cache->lru, e);
+
+    pj_lock_release(cache->lock);
+}
+
+
+/*****************************************************************************
+ *
+ * NONCE STORE
+ *
+ *****************************************************************************/
+
+typedef struct nonce_entry
+{
+    PJ_DECL_LIST_MEMBER(struct nonce_entry);
+
+    char                 nonce[PJSIP_AUTH_NONCE_MAX_LEN];
+    unsigned             len;
+    pj_uint32_t          hval;
+    pj_hash_entry_buf    hbuf;
+    pj_uint32_t          expiry;
+    pj_uint32_t          nc;            /* Highest nonce count used */
+} nonce_entry;
+
+struct pjsip_auth_nonce_store
+{
+    pj_pool_t           *pool;
+    pj_lock_t           *lock;
+    pj_hash_table_t     *ht;
+    unsigned             max_cnt;
+    unsigned             lifetime;
+    unsigned             cnt;
+    nonce_entry          list;          /* Oldest first */
+    nonce_entry          free_list;
+};
+
+/* Remove a nonce, the store must be locked. */
+static void nonce_remove(pjsip_auth_nonce_store *store, nonce_entry *e)
+{
+    pj_hash_set_np(store->ht, e->nonce, e->len, e->hval, e->hbuf, NULL);
+    pj_list_erase(e);
+    pj_list_push_back(&store->free_list, e);
+    --store->cnt;
+}
+
+PJ_DEF(pj_status_t) pjsip_auth_nonce_store_create(pj_pool_factory *pf,
+                                                  unsigned max_cnt,
+                                                  unsigned lifetime,
+                                                  pjsip_auth_nonce_store **p_store)
+{
+    pj_pool_t *pool;
+    pjsip_auth_nonce_store *store;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pf && p_store, PJ_EINVAL);
+
+    pool = pj_pool_create(pf, "nonces%p", 1024, 1024, NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    store = PJ_POOL_ZALLOC_T(pool, pjsip_auth_nonce_store);
+    store->pool = pool;
+    store->max_cnt = max_cnt ? max_cnt : PJSIP_AUTH_NONCE_STORE_MAX_CNT;
+    store->lifetime = lifetime ? lifetime : PJSIP_AUTH_NONCE_LIFETIME;
+    pj_list_init(&store->list);
+    pj_list_init(&store->free_list);
+
+    store->ht = pj_hash_create(pool, store->max_cnt);
+    status = pj_lock_create_simple_mutex(pool, "nonces%p", &store->lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+
+    *p_store = store;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pjsip_auth_nonce_store_destroy(pjsip_auth_nonce_store *store)
+{
+    PJ_ASSERT_RETURN(store, PJ_EINVAL);
+
+    pj_lock_destroy(store->lock);
+    pj_pool_release(store->pool);
+
+    return PJ_SUCCESS;
+}
+
+/* Remember a nonce sent in a challenge. */
+static pj_status_t nonce_add(pjsip_auth_nonce_store *store,
+                             const pj_str_t *nonce)
+{
+    pj_uint32_t now = now_msec();
+    pj_uint32_t hval = 0;
+    nonce_entry *e;
+
+    if (nonce->slen > PJSIP_AUTH_NONCE_MAX_LEN)
+        return PJ_ETOOBIG;
+
+    pj_lock_acquire(store->lock);
+
+    /* Forget the expired nonces */
+    while (!pj_list_empty(&store->list) &&
+           (pj_int32_t)(now - store->list.next->expiry) >= 0)
+    {
+        nonce_remove(store, store->list.next);
+    }
+
+    e = (nonce_entry*) pj_hash_get(store->ht, nonce->ptr, 
+                                   (unsigned)nonce->slen, &hval);
+    if (e) {
+        pj_list_erase(e);
+    } else {
+        if (!pj_list_empty(&store->free_list)) {
+            e = store->free_list.next;
+            pj_list_erase(e);
+        } else if (store->cnt < store->max_cnt) {
+            e = PJ_POOL_ALLOC_T(store->pool, nonce_entry);
+        } else {
+            /* Forget the oldest */
+            nonce_remove(store, store->list.next);
+            e = store->free_list.next;
+            pj_list_erase(e);
+        }
+
+        pj_memcpy(e->nonce, nonce->ptr, nonce->slen);
+        e->len = (unsigned)nonce->slen;
+        e->hval = hval;
+        pj_hash_set_np(store->ht, e->nonce, e->len, hval, e->hbuf, e);
+        ++store->cnt;
+    }
+
+    e->nc = 0;
+    e->expiry = now + store->lifetime * 1000;
+    pj_list_push_back(&store->list, e);
+
+    pj_lock_release(store->lock);
+
+    return PJ_SUCCESS;
+}
+
+/* Check that the nonce of a verified authorization is still valid, and
+ * that its nonce count hasn't been used before.
+ */
+static pj_status_t nonce_check(pjsip_auth_nonce_store *store,
+                               const pjsip_digest_credential *dig)
+{
+    nonce_entry *e;
+    pj_status_t status = PJ_SUCCESS;
+
+    pj_lock_acquire(store->lock);
+
+    e = (nonce_entry*) pj_hash_get(store->ht, dig->nonce.ptr,
+                                   (unsigned)dig->nonce.slen, NULL);
+    if (!e) {
+        status = PJSIP_EAUTHSTALENONCE;
+    } else if ((pj_int32_t)(now_msec() - e->expiry) >= 0) {
+        nonce_remove(store, e);
+        status = PJSIP_EAUTHSTALENONCE;
+    } else if (dig->qop.slen) {
+        pj_uint32_t nc = (pj_uint32_t)pj_strtoul2(&dig->nc, NULL, 16);
+
+        if (nc <= e->nc)
+            status = PJSIP_EAUTHSTALENONCE;
+        else
+            e->nc = nc;
+    }
+
+    pj_lock_release(store->lock);
+
+    return status;
+}
+
+
 /* Verify incoming Authorization/Proxy-Authorization header against the 
  * specified credential.
  */
@@ -174,6 +620,8 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
     pjsip_hdr_e htype;
     pj_str_t acc_name;
     pjsip_cred_info cred_info;
+    char ha1[PJSIP_AUTH_MAX_DIGEST_BUFFER_LENGTH * 2];
+    pj_bool_t from_cache = PJ_FALSE;
     pj_status_t status;
     const pjsip_auth_algorithm *algorithm;
 
@@ -226,7 +674,16 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
     /* Find the credential information for the account. */
     pj_bzero(&cred_info, sizeof(cred_info));
 
-    if (auth_srv->lookup2) {
+    if (auth_srv->cache &&
+        cache_get(auth_srv->cache, algorithm->algorithm_type,
+                  &auth_srv->realm, &acc_name, &cred_info, ha1))
+    {
+        cred_info.realm = h_auth->credential.digest.realm;
+        cred_info.username = acc_name;
+        cred_info.scheme = pjsip_DIGEST_STR;
+        from_cache = PJ_TRUE;
+
+    } else if (auth_srv->lookup2) {
         pjsip_auth_lookup_cred_param param;
 
         pj_bzero(&param, sizeof(param));
@@ -262,8 +719,25 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_verify( pjsip_auth_srv *auth_srv,
                                &cred_info);
     if (status != PJ_SUCCESS) {
         *status_code = PJSIP_SC_FORBIDDEN;
+        return status;
     }
-    return status;
+
+    if (auth_srv->cache && !from_cache) {
+        cache_put(auth_srv->cache, algorithm->algorithm_type,
+                  &auth_srv->realm, &acc_name, &cred_info);
+    }
+
+    /* The credential is correct, but the nonce must be fresh too. */
+    if (auth_srv->nonce_store) {
+        status = nonce_check(auth_srv->nonce_store,
+                             &h_auth->credential.digest);
+        if (status != PJ_SUCCESS) {
+            *status_code = auth_srv->is_proxy ? 407 : 401;
+            return status;
+        }
+    }
+
+    return PJ_SUCCESS;
 }
 
 
@@ -328,6 +802,18 @@ PJ_DEF(pj_status_t) pjsip_auth_srv_challenge2(  pjsip_auth_srv *auth_srv,
     pj_strdup(tdata->pool, &hdr->challenge.digest.realm, &auth_srv->realm);
     hdr->challenge.digest.stale = stale;
 
+    /* Remember the nonce to verify the authorization */
+    if (auth_srv->nonce_store) {
+        pj_status_t status;
+
+        status = nonce_add(auth_srv->nonce_store, &hdr->challenge.digest.nonce);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(4,(THIS_FILE, status, "Unable to store nonce %.*s",
+                         (int)hdr->challenge.digest.nonce.slen,
+                         hdr->challenge.digest.nonce.ptr));
+        }
+    }
+
     pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)hdr);
 
     return PJ_SUCCESS;
@@ -39,7 +39,9 @@ pjsip_cfg_t pjsip_sip_cfg_var =
        0,
        PJSIP_ENCODE_SHORT_HNAME,
        PJSIP_ACCEPT_MULTIPLE_SDP_ANSWERS,
-       0
+       0,
+       PJSIP_LAZY_HDR_PARSING,
+       PJSIP_RX_WORKER_CNT
     },
 
     /* Transaction settings */
@@ -48,7 +50,8 @@ pjsip_cfg_t pjsip_sip_cfg_var =
        PJSIP_T1_TIMEOUT,
        PJSIP_T2_TIMEOUT,
        PJSIP_T4_TIMEOUT,
-       PJSIP_TD_TIMEOUT
+       PJSIP_TD_TIMEOUT,
+       PJSIP_TSX_RETRANS_WHEEL
     },
 
     /* Client registration client */
@@ -58,12 +61,14 @@ pjsip_cfg_t pjsip_sip_cfg_var =
 
     /* TCP transport settings */
     {
-        PJSIP_TCP_KEEP_ALIVE_INTERVAL
+        PJSIP_TCP_KEEP_ALIVE_INTERVAL,
+        PJSIP_TCP_MAX_MSG_LEN
     },
 
     /* TLS transport settings */
     {
-        PJSIP_TLS_KEEP_ALIVE_INTERVAL
+        PJSIP_TLS_KEEP_ALIVE_INTERVAL,
+        PJSIP_TLS_MAX_MSG_LEN
     }
 };
 
@@ -118,6 +123,8 @@ PJ_DEF(void) pjsip_dump_config(void)
                PJSIP_TLS_TRANSPORT_DONT_CREATE_LISTENER));
     PJ_LOG(3, (id, " PJSIP_TCP_KEEP_ALIVE_INTERVAL                      : %d", 
                PJSIP_TCP_KEEP_ALIVE_INTERVAL));
+    PJ_LOG(3, (id, " PJSIP_TCP_MAX_MSG_LEN                              : %d", 
+               PJSIP_TCP_MAX_MSG_LEN));
     PJ_LOG(3, (id, " PJSIP_POOL_INC_TRANSPORT                           : %d", 
                PJSIP_POOL_INC_TRANSPORT));
     PJ_LOG(3, (id, " PJSIP_POOL_LEN_TDATA                               : %d", 
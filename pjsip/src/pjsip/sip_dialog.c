@@ -119,6 +119,7 @@ static pj_status_t create_dialog( pjsip_user_agent *ua,
     pj_grp_lock_add_ref(dlg->grp_lock_);
     pj_grp_lock_add_handler(dlg->grp_lock_, pool, dlg, &dlg_on_destroy);
 
+    pjsip_tpcache_init(&dlg->tp_cache, dlg->grp_lock_);
     pjsip_target_set_init(&dlg->target_set);
 
     *p_dlg = dlg;
@@ -135,6 +136,7 @@ static void destroy_dialog( pjsip_dialog *dlg, pj_bool_t unlock_mutex )
         pjsip_tpselector_dec_ref(&dlg->tp_sel);
         pj_bzero(&dlg->tp_sel, sizeof(pjsip_tpselector));
     }
+    pjsip_tpcache_clear(&dlg->tp_cache);
     pjsip_auth_clt_deinit(&dlg->auth_sess);
 
     pj_grp_lock_dec_ref(dlg->grp_lock_);
@@ -272,6 +274,9 @@ PJ_DEF(pj_status_t) pjsip_dlg_create_uac2(
         goto on_error;
     }
 
+    /* Local contact doesn't change, keep it encoded */
+    pjsip_hdr_freeze(dlg->pool, dlg->local.contact);
+
     /* Init remote info. */
     dlg->remote.info = pjsip_to_hdr_create(dlg->pool);
     pj_strdup_with_null(dlg->pool, &dlg->remote.info_str,
@@ -452,6 +457,9 @@ pj_status_t create_uas_dialog( pjsip_user_agent *ua,
         dlg->local.contact->uri = dlg->local.info->uri;
     }
 
+    /* Local contact doesn't change, keep it encoded */
+    pjsip_hdr_freeze(dlg->pool, dlg->local.contact);
+
     /* Init remote info from the From header. */
     dlg->remote.info = (pjsip_fromto_hdr*)
                        pjsip_hdr_clone(dlg->pool, rdata->msg_info.from);
@@ -543,6 +551,7 @@ pj_status_t create_uas_dialog( pjsip_user_agent *ua,
         /* Clone the Record-Route, change the type to Route header. */
         route = (pjsip_route_hdr*) pjsip_hdr_clone(dlg->pool, rr);
         pjsip_routing_hdr_set_route(route);
+        pjsip_hdr_freeze(dlg->pool, route);
 
         /* Add to route set. */
         pj_list_push_back(&dlg->route_set, route);
@@ -813,6 +822,7 @@ PJ_DEF(pj_status_t) pjsip_dlg_fork( const pjsip_dialog *first_dlg,
             pjsip_route_hdr *r;
             r = (pjsip_route_hdr*) pjsip_hdr_clone(dlg->pool, hdr);
             pjsip_routing_hdr_set_route(r);
+            pjsip_hdr_freeze(dlg->pool, r);
             pj_list_push_back(&dlg->route_set, r);
         }
     }
@@ -916,6 +926,7 @@ PJ_DEF(pj_status_t) pjsip_dlg_set_route_set( pjsip_dialog *dlg,
         pjsip_route_hdr *new_r;
 
         new_r = (pjsip_route_hdr*) pjsip_hdr_clone(dlg->pool, r);
+        pjsip_hdr_freeze(dlg->pool, new_r);
         pj_list_push_back(&dlg->route_set, new_r);
 
         r = r->next;
@@ -1353,6 +1364,11 @@ PJ_DEF(pj_status_t) pjsip_dlg_send_request( pjsip_dialog *dlg,
         tdata->via_tp = dlg->via_tp;
     }
 
+#if PJSIP_DLG_USE_TPCACHE
+    /* Let the transport manager reuse the transport of previous requests */
+    pjsip_tx_data_set_tpcache(tdata, &dlg->tp_cache);
+#endif
+
     /* Update dialog's CSeq and message's CSeq if request is not
      * ACK nor CANCEL.
      */
@@ -1984,6 +2000,7 @@ static void dlg_update_routeset(pjsip_dialog *dlg, const pjsip_rx_data *rdata)
             pjsip_route_hdr *r;
             r = (pjsip_route_hdr*) pjsip_hdr_clone(dlg->pool, hdr);
             pjsip_routing_hdr_set_route(r);
+            pjsip_hdr_freeze(dlg->pool, r);
             pj_list_push_back(&dlg->route_set, r);
         }
     }
@@ -49,6 +49,40 @@ typedef struct exit_cb
 } exit_cb;
 
 
+/* Module list, sorted by priority, as seen by message dispatch. Once
+ * published it is not modified until it has been replaced and all
+ * dispatch locks have been taken by the writer.
+ */
+typedef struct module_snapshot
+{
+    unsigned                        count;
+    pjsip_module                   *mod[PJSIP_MAX_MODULE];
+} module_snapshot;
+
+
+/* Incoming message waiting in the queue of a worker. */
+typedef struct rx_job
+{
+    PJ_DECL_LIST_MEMBER             (struct rx_job);
+    pjsip_rx_data                  *rdata;
+} rx_job;
+
+
+/* Worker thread processing the incoming messages of a set of Call-IDs,
+ * see pjsip_cfg_t.endpt.rx_worker_cnt.
+ */
+typedef struct rx_worker
+{
+    pjsip_endpoint                 *endpt;
+    pj_thread_t                    *thread;
+    pj_sem_t                       *sem;
+    pj_mutex_t                     *mutex;
+    rx_job                          queue;
+    unsigned                        queue_len;
+    pj_bool_t                       quit;
+} rx_worker;
+
+
 /**
  * The SIP endpoint.
  */
@@ -81,8 +115,8 @@ struct pjsip_endpoint
     /** DNS Resolver. */
     pjsip_resolver_t    *resolver;
 
-    /** Modules lock. */
-    pj_rwmutex_t        *mod_mutex;
+    /** Modules lock, serializes module registration. */
+    pj_mutex_t          *mod_mutex;
 
     /** Modules. */
     pjsip_module        *modules[PJSIP_MAX_MODULE];
@@ -90,6 +124,20 @@ struct pjsip_endpoint
     /** Module list, sorted by priority. */
     pjsip_module         module_list;
 
+    /** Snapshot of module list used by message dispatch. */
+    module_snapshot     *mod_snap;
+
+    /** Snapshot buffers, the one not published is free for the next
+     *  update. */
+    module_snapshot      mod_snap_buf[2];
+
+    /** Dispatch locks, selected by the calling thread. */
+    pj_rwmutex_t        *mod_dispatch_lock[PJSIP_MODULE_DISPATCH_LOCK_CNT];
+
+    /** Workers processing incoming messages. */
+    unsigned             rx_worker_cnt;
+    rx_worker           *rx_worker;
+
     /** Capability header list. */
     pjsip_hdr            cap_hdr;
 
@@ -102,11 +150,11 @@ struct pjsip_endpoint
 
 
 #if defined(PJSIP_SAFE_MODULE) && PJSIP_SAFE_MODULE!=0
-#   define LOCK_MODULE_ACCESS(ept)      pj_rwmutex_lock_read(ept->mod_mutex)
-#   define UNLOCK_MODULE_ACCESS(ept)    pj_rwmutex_unlock_read(ept->mod_mutex)
+#   define LOCK_MODULE_ACCESS(ept)      lock_module_access(ept)
+#   define UNLOCK_MODULE_ACCESS(ept,l)  pj_rwmutex_unlock_read(l)
 #else
-#   define LOCK_MODULE_ACCESS(endpt)
-#   define UNLOCK_MODULE_ACCESS(endpt)
+#   define LOCK_MODULE_ACCESS(endpt)    NULL
+#   define UNLOCK_MODULE_ACCESS(endpt,l) PJ_UNUSED_ARG(l)
 #endif
 
 
@@ -120,6 +168,10 @@ static pj_status_t endpt_on_tx_msg( pjsip_endpoint *endpt,
                                     pjsip_tx_data *tdata );
 static pj_status_t unload_module(pjsip_endpoint *endpt,
                                  pjsip_module *mod);
+static void destroy_module_locks(pjsip_endpoint *endpt);
+static pj_status_t create_rx_workers(pjsip_endpoint *endpt, unsigned cnt);
+static void stop_rx_workers(pjsip_endpoint *endpt);
+static void destroy_rx_workers(pjsip_endpoint *endpt);
 
 /* Defined in sip_parser.c */
 void init_sip_parser(void);
@@ -144,6 +196,55 @@ static void pool_callback( pj_pool_t *pool, pj_size_t size )
 }
 
 
+#if defined(PJSIP_SAFE_MODULE) && PJSIP_SAFE_MODULE!=0
+/* Lock the dispatch lock of the calling thread for reading. */
+static pj_rwmutex_t *lock_module_access(pjsip_endpoint *endpt)
+{
+    pj_size_t thread = (pj_size_t)pj_thread_this();
+    pj_rwmutex_t *lock;
+
+    lock = endpt->mod_dispatch_lock[(thread ^ (thread >> 8)) %
+                                    PJSIP_MODULE_DISPATCH_LOCK_CNT];
+    pj_rwmutex_lock_read(lock);
+    return lock;
+}
+#endif
+
+/* Publish the snapshot of module list, without the excluded module.
+ * Module lock must be held.
+ */
+static void publish_modules(pjsip_endpoint *endpt,
+                            const pjsip_module *exclude)
+{
+    module_snapshot *snap;
+    pjsip_module *m;
+    unsigned i;
+
+    /* Build in the buffer that is not published */
+    snap = (endpt->mod_snap == &endpt->mod_snap_buf[0]) ?
+                &endpt->mod_snap_buf[1] : &endpt->mod_snap_buf[0];
+    snap->count = 0;
+    for (m = endpt->module_list.next; m != &endpt->module_list; m = m->next) {
+        if (m != exclude)
+            snap->mod[snap->count++] = m;
+    }
+
+    /* Once all dispatch locks are taken for writing, nobody is using the
+     * previous snapshot anymore, nor calling the excluded module.
+     */
+    for (i=0; i<PJ_ARRAY_SIZE(endpt->mod_dispatch_lock); ++i) {
+        if (endpt->mod_dispatch_lock[i])
+            pj_rwmutex_lock_write(endpt->mod_dispatch_lock[i]);
+    }
+
+    endpt->mod_snap = snap;
+
+    for (i=0; i<PJ_ARRAY_SIZE(endpt->mod_dispatch_lock); ++i) {
+        if (endpt->mod_dispatch_lock[i])
+            pj_rwmutex_unlock_write(endpt->mod_dispatch_lock[i]);
+    }
+}
+
 /* Compare module name, used for searching module based on name. */
 static int cmp_mod_name(void *name, const void *mod)
 {
@@ -163,7 +264,7 @@ PJ_DEF(pj_status_t) pjsip_endpt_register_module( pjsip_endpoint *endpt,
     pjsip_module *m;
     unsigned i;
 
-    pj_rwmutex_lock_write(endpt->mod_mutex);
+    pj_mutex_lock(endpt->mod_mutex);
 
     /* Make sure that this module has not been registered. */
     PJ_ASSERT_ON_FAIL(  pj_list_find_node(&endpt->module_list, mod) == NULL,
@@ -214,13 +315,16 @@ PJ_DEF(pj_status_t) pjsip_endpt_register_module( pjsip_endpoint *endpt,
     }
     pj_list_insert_before(m, mod);
 
+    /* Make it visible to message dispatch. */
+    publish_modules(endpt, NULL);
+
     /* Done. */
 
     PJ_LOG(4,(THIS_FILE, "Module \"%.*s\" registered", 
               (int)mod->name.slen, mod->name.ptr));
 
 on_return:
-    pj_rwmutex_unlock_write(endpt->mod_mutex);
+    pj_mutex_unlock(endpt->mod_mutex);
     return status;
 }
 
@@ -234,7 +338,7 @@ PJ_DEF(pj_status_t) pjsip_endpt_unregister_module( pjsip_endpoint *endpt,
 {
     pj_status_t status;
 
-    pj_rwmutex_lock_write(endpt->mod_mutex);
+    pj_mutex_lock(endpt->mod_mutex);
 
     /* Make sure the module exists in the list. */
     PJ_ASSERT_ON_FAIL(  pj_list_find_node(&endpt->module_list, mod) == mod,
@@ -246,6 +350,9 @@ PJ_DEF(pj_status_t) pjsip_endpt_unregister_module( pjsip_endpoint *endpt,
                         endpt->modules[mod->id] == mod,
                         {status = PJ_ENOTFOUND; goto on_return;});
 
+    /* Stop dispatching messages to the module. */
+    publish_modules(endpt, mod);
+
     /* Try to stop the module. */
     if (mod->stop) {
         status = (*mod->stop)();
@@ -256,7 +363,11 @@ PJ_DEF(pj_status_t) pjsip_endpt_unregister_module( pjsip_endpoint *endpt,
     status = unload_module(endpt, mod);
 
 on_return:
-    pj_rwmutex_unlock_write(endpt->mod_mutex);
+    /* The module is still in the list if it refused to stop or unload */
+    if (status != PJ_SUCCESS && mod->id >= 0)
+        publish_modules(endpt, NULL);
+
+    pj_mutex_unlock(endpt->mod_mutex);
 
     if (status != PJ_SUCCESS) {
         char errmsg[PJ_ERR_MSG_SIZE];
@@ -289,6 +400,7 @@ static pj_status_t unload_module(pjsip_endpoint *endpt,
 
     /* Remove module from list. */
     pj_list_erase(mod);
+    publish_modules(endpt, NULL);
 
     /* Set module Id to -1. */
     mod->id = -1;
@@ -404,11 +516,15 @@ PJ_DEF(pj_status_t) pjsip_endpt_add_capability( pjsip_endpoint *endpt,
     }
 
     /* Add the tags to the header. */
+    pjsip_hdr_unfreeze(hdr);
     for (i=0; i<count; ++i) {
         pj_strdup(endpt->pool, &hdr->values[hdr->count], &tags[i]);
         ++hdr->count;
     }
 
+    /* Capability headers are put in many messages, keep them encoded */
+    pjsip_hdr_freeze(endpt->pool, hdr);
+
     /* Done. */
     return PJ_SUCCESS;
 }
@@ -434,6 +550,9 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
     pjsip_endpoint *endpt;
     pjsip_max_fwd_hdr *mf_hdr;
     pj_lock_t *lock = NULL;
+#if defined(PJSIP_SAFE_MODULE) && PJSIP_SAFE_MODULE!=0
+    unsigned i;
+#endif
 
 
     status = pj_register_strerror(PJSIP_ERRNO_START, PJ_ERRNO_SPACE_SIZE,
@@ -462,11 +581,23 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
     /* Initialize exit callback list. */
     pj_list_init(&endpt->exit_cb_list);
 
-    /* Create R/W mutex for module manipulation. */
-    status = pj_rwmutex_create(endpt->pool, "ept%p", &endpt->mod_mutex);
+    /* Create mutex for module manipulation. */
+    status = pj_mutex_create_recursive(endpt->pool, "ept%p",
+                                       &endpt->mod_mutex);
     if (status != PJ_SUCCESS)
         goto on_error;
 
+    /* Create module dispatch locks and publish the empty module list. */
+#if defined(PJSIP_SAFE_MODULE) && PJSIP_SAFE_MODULE!=0
+    for (i=0; i<PJ_ARRAY_SIZE(endpt->mod_dispatch_lock); ++i) {
+        status = pj_rwmutex_create(endpt->pool, "eptmod%p",
+                                   &endpt->mod_dispatch_lock[i]);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+    }
+#endif
+    endpt->mod_snap = &endpt->mod_snap_buf[0];
+
     /* Init parser. */
     init_sip_parser();
 
@@ -534,17 +665,24 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
     /* Add "Max-Forwards" for request header. */
     mf_hdr = pjsip_max_fwd_hdr_create(endpt->pool,
                                       PJSIP_MAX_FORWARDS_VALUE);
+    pjsip_hdr_freeze(endpt->pool, mf_hdr);
     pj_list_insert_before( &endpt->req_hdr, mf_hdr);
 
     /* Initialize capability header list. */
     pj_list_init(&endpt->cap_hdr);
 
+    /* Create workers for incoming messages. */
+    status = create_rx_workers(endpt, pjsip_cfg()->endpt.rx_worker_cnt);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
 
     /* Done. */
     *p_endpt = endpt;
     return status;
 
 on_error:
+    stop_rx_workers(endpt);
     if (endpt->transport_mgr) {
         pjsip_tpmgr_destroy(endpt->transport_mgr);
         endpt->transport_mgr = NULL;
@@ -562,16 +700,31 @@ on_error:
         endpt->mutex = NULL;
     }
     deinit_sip_parser();
-    if (endpt->mod_mutex) {
-        pj_rwmutex_destroy(endpt->mod_mutex);
-        endpt->mod_mutex = NULL;
-    }
+    destroy_module_locks(endpt);
+    destroy_rx_workers(endpt);
     pj_pool_release( endpt->pool );
 
     PJ_PERROR(4, (THIS_FILE, status, "Error creating endpoint"));
     return status;
 }
 
+/* Destroy module mutex and dispatch locks */
+static void destroy_module_locks(pjsip_endpoint *endpt)
+{
+    unsigned i;
+
+    for (i=0; i<PJ_ARRAY_SIZE(endpt->mod_dispatch_lock); ++i) {
+        if (endpt->mod_dispatch_lock[i]) {
+            pj_rwmutex_destroy(endpt->mod_dispatch_lock[i]);
+            endpt->mod_dispatch_lock[i] = NULL;
+        }
+    }
+    if (endpt->mod_mutex) {
+        pj_mutex_destroy(endpt->mod_mutex);
+        endpt->mod_mutex = NULL;
+    }
+}
+
 /*
  * Destroy endpoint.
  */
@@ -582,6 +735,9 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
 
     PJ_LOG(5, (THIS_FILE, "Destroying endpoint instance.."));
 
+    /* Process the queued incoming messages and stop the workers */
+    stop_rx_workers(endpt);
+
     /* Phase 1: stop all modules */
     mod = endpt->module_list.prev;
     while (mod != &endpt->module_list) {
@@ -628,8 +784,11 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
     /* Deinit parser */
     deinit_sip_parser();
 
-    /* Delete module's mutex */
-    pj_rwmutex_destroy(endpt->mod_mutex);
+    /* Delete module's mutexes */
+    destroy_module_locks(endpt);
+
+    /* Delete workers' queues */
+    destroy_rx_workers(endpt);
 
     /* Finally destroy pool. */
     pj_pool_release(endpt->pool);
@@ -875,7 +1034,8 @@ PJ_DEF(pj_status_t) pjsip_endpt_process_rx_data( pjsip_endpoint *endpt,
 {
     pjsip_msg *msg;
     pjsip_process_rdata_param def_prm;
-    pjsip_module *mod;
+    const module_snapshot *snap;
+    pj_rwmutex_t *lock;
     pj_bool_t handled = PJ_FALSE;
     unsigned i;
     pj_status_t status;
@@ -898,52 +1058,50 @@ PJ_DEF(pj_status_t) pjsip_endpt_process_rx_data( pjsip_endpoint *endpt,
         pj_log_push_indent();
     }
 
-    LOCK_MODULE_ACCESS(endpt);
+    lock = LOCK_MODULE_ACCESS(endpt);
+    snap = endpt->mod_snap;
 
     /* Find start module */
+    i = 0;
     if (p->start_mod) {
-        mod = (pjsip_module*)
-              pj_list_find_node(&endpt->module_list, p->start_mod);
-        if (!mod) {
+        while (i < snap->count && snap->mod[i] != p->start_mod)
+            ++i;
+        if (i == snap->count) {
             status = PJ_ENOTFOUND;
             goto on_return;
         }
-    } else {
-        mod = endpt->module_list.next;
     }
 
     /* Start after the specified index */
-    for (i=0; i < p->idx_after_start && mod != &endpt->module_list; ++i) {
-        mod = mod->next;
-    }
+    i += p->idx_after_start;
 
     /* Start with the specified priority */
-    while (mod != &endpt->module_list && mod->priority < (int)p->start_prio) {
-        mod = mod->next;
+    while (i < snap->count && snap->mod[i]->priority < (int)p->start_prio) {
+        ++i;
     }
 
-    if (mod == &endpt->module_list) {
+    if (i >= snap->count) {
         status = PJ_ENOTFOUND;
         goto on_return;
     }
 
     /* Distribute */
     if (msg->type == PJSIP_REQUEST_MSG) {
-        do {
+        for (; i < snap->count; ++i) {
+            pjsip_module *mod = snap->mod[i];
             if (mod->on_rx_request)
                 handled = (*mod->on_rx_request)(rdata);
             if (handled)
                 break;
-            mod = mod->next;
-        } while (mod != &endpt->module_list);
+        }
     } else {
-        do {
+        for (; i < snap->count; ++i) {
+            pjsip_module *mod = snap->mod[i];
             if (mod->on_rx_response)
                 handled = (*mod->on_rx_response)(rdata);
             if (handled)
                 break;
-            mod = mod->next;
-        } while (mod != &endpt->module_list);
+        }
     }
 
     status = PJ_SUCCESS;
@@ -952,7 +1110,7 @@ on_return:
     if (p_handled)
         *p_handled = handled;
 
-    UNLOCK_MODULE_ACCESS(endpt);
+    UNLOCK_MODULE_ACCESS(endpt, lock);
     if (!p->silent) {
         pj_log_pop_indent();
     }
@@ -960,12 +1118,11 @@ on_return:
 }
 
 /*
- * This is the callback that is called by the transport manager when it 
- * receives a message from the network.
+ * Distribute incoming message to modules. This is called by the thread
+ * which received the message, or by the worker of its Call-ID.
  */
-static void endpt_on_rx_msg( pjsip_endpoint *endpt,
-                             pj_status_t status,
-                             pjsip_rx_data *rdata )
+static void process_rx_msg( pjsip_endpoint *endpt,
+                            pjsip_rx_data *rdata )
 {
     pjsip_msg *msg = rdata->msg_info.msg;
     pjsip_process_rdata_param proc_prm;
@@ -973,47 +1130,6 @@ static void endpt_on_rx_msg( pjsip_endpoint *endpt,
 
     PJ_UNUSED_ARG(msg);
 
-    if (status != PJ_SUCCESS) {
-        char info[30];
-        char errmsg[PJ_ERR_MSG_SIZE];
-
-        info[0] = '\0';
-
-        if (status == PJSIP_EMISSINGHDR) {
-            pj_str_t p;
-
-            p.ptr = info; p.slen = 0;
-
-            if (rdata->msg_info.cid == NULL || rdata->msg_info.cid->id.slen)
-                pj_strcpy2(&p, "Call-ID");
-            if (rdata->msg_info.from == NULL)
-                pj_strcpy2(&p, " From");
-            if (rdata->msg_info.to == NULL)
-                pj_strcpy2(&p, " To");
-            if (rdata->msg_info.via == NULL)
-                pj_strcpy2(&p, " Via");
-            if (rdata->msg_info.cseq == NULL) 
-                pj_strcpy2(&p, " CSeq");
-
-            p.ptr[p.slen] = '\0';
-        }
-
-        pj_strerror(status, errmsg, sizeof(errmsg));
-
-        PJ_LOG(1, (THIS_FILE, 
-                  "Error processing packet from %s:%d: %s %s [code %d]:\n"
-                  "%.*s\n"
-                  "-- end of packet.",
-                  rdata->pkt_info.src_name, 
-                  rdata->pkt_info.src_port,
-                  errmsg,
-                  info,
-                  status,
-                  (int)rdata->msg_info.len,     
-                  rdata->msg_info.msg_buf));
-        return;
-    }
-
     PJ_LOG(5, (THIS_FILE, "Processing incoming message: %s", 
                pjsip_rx_data_get_info(rdata)));
     pj_log_push_indent();
@@ -1100,6 +1216,231 @@ static void endpt_on_rx_msg( pjsip_endpoint *endpt,
     pj_log_pop_indent();
 }
 
+/* Worker thread, processes the incoming messages in its queue. */
+static int rx_worker_thread(void *arg)
+{
+    rx_worker *w = (rx_worker*)arg;
+
+    for (;;) {
+        rx_job *job;
+
+        pj_sem_wait(w->sem);
+
+        pj_mutex_lock(w->mutex);
+        if (pj_list_empty(&w->queue)) {
+            pj_bool_t quit = w->quit;
+            pj_mutex_unlock(w->mutex);
+            if (quit)
+                break;
+            continue;
+        }
+        job = w->queue.next;
+        pj_list_erase(job);
+        --w->queue_len;
+        pj_mutex_unlock(w->mutex);
+
+        process_rx_msg(w->endpt, job->rdata);
+        pjsip_rx_data_free_cloned(job->rdata);
+    }
+
+    return 0;
+}
+
+/* Queue incoming message to the worker of its Call-ID. The message is
+ * dropped if it can't be queued, since processing it in the receiving
+ * thread could overtake the queued messages of the same Call-ID.
+ */
+static pj_status_t queue_rx_msg(pjsip_endpoint *endpt,
+                                pjsip_rx_data *rdata)
+{
+    const pj_str_t *call_id = &rdata->msg_info.cid->id;
+    rx_worker *w;
+    pjsip_rx_data *clone;
+    rx_job *job;
+    pj_status_t status;
+
+    w = &endpt->rx_worker[pj_hash_calc(0, call_id->ptr,
+                                       (unsigned)call_id->slen) %
+                          endpt->rx_worker_cnt];
+
+    /* The rdata is reused by the transport once we return */
+    status = pjsip_rx_data_clone(rdata, 0, &clone);
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(2,(THIS_FILE, status, "Dropping %s from %s:%d, unable to "
+                                        "clone it for worker",
+                     pjsip_rx_data_get_info(rdata),
+                     rdata->pkt_info.src_name,
+                     rdata->pkt_info.src_port));
+        return status;
+    }
+
+    job = PJ_POOL_ZALLOC_T(clone->tp_info.pool, rx_job);
+    job->rdata = clone;
+
+    pj_mutex_lock(w->mutex);
+    if (w->quit) {
+        status = PJ_EINVALIDOP;
+    } else if (w->queue_len >= PJSIP_RX_WORKER_MAX_QUEUE) {
+        status = PJ_ETOOMANY;
+    } else {
+        pj_list_push_back(&w->queue, job);
+        ++w->queue_len;
+    }
+    pj_mutex_unlock(w->mutex);
+
+    if (status != PJ_SUCCESS) {
+        PJ_LOG(2,(THIS_FILE, "Dropping %s from %s:%d, worker %s",
+                             pjsip_rx_data_get_info(rdata),
+                             rdata->pkt_info.src_name,
+                             rdata->pkt_info.src_port,
+                             (status == PJ_ETOOMANY ? "queue is full" :
+                                                      "is stopped")));
+        pjsip_rx_data_free_cloned(clone);
+        return status;
+    }
+
+    pj_sem_post(w->sem);
+    return PJ_SUCCESS;
+}
+
+/* Create the workers for incoming messages */
+static pj_status_t create_rx_workers(pjsip_endpoint *endpt, unsigned cnt)
+{
+    unsigned i;
+    pj_status_t status;
+
+    if (cnt == 0)
+        return PJ_SUCCESS;
+
+    endpt->rx_worker = (rx_worker*)
+                       pj_pool_zalloc(endpt->pool, cnt * sizeof(rx_worker));
+    endpt->rx_worker_cnt = cnt;
+
+    for (i=0; i<cnt; ++i) {
+        rx_worker *w = &endpt->rx_worker[i];
+
+        w->endpt = endpt;
+        pj_list_init(&w->queue);
+
+        status = pj_mutex_create_simple(endpt->pool, "rxw%p", &w->mutex);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        status = pj_sem_create(endpt->pool, "rxw%p", 0, PJ_MAXINT32,
+                               &w->sem);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        status = pj_thread_create(endpt->pool, "rxw%p", &rx_worker_thread,
+                                  w, 0, 0, &w->thread);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+
+    PJ_LOG(4,(THIS_FILE, "Incoming messages are processed by %d workers",
+              cnt));
+
+    return PJ_SUCCESS;
+}
+
+/* Let the workers finish their queue and stop them. Messages received
+ * afterwards are dropped.
+ */
+static void stop_rx_workers(pjsip_endpoint *endpt)
+{
+    unsigned i;
+
+    for (i=0; i<endpt->rx_worker_cnt; ++i) {
+        rx_worker *w = &endpt->rx_worker[i];
+
+        if (!w->thread)
+            continue;
+
+        pj_mutex_lock(w->mutex);
+        w->quit = PJ_TRUE;
+        pj_mutex_unlock(w->mutex);
+        pj_sem_post(w->sem);
+
+        pj_thread_join(w->thread);
+        pj_thread_destroy(w->thread);
+        w->thread = NULL;
+    }
+}
+
+/* Destroy the queues of the workers */
+static void destroy_rx_workers(pjsip_endpoint *endpt)
+{
+    unsigned i;
+
+    for (i=0; i<endpt->rx_worker_cnt; ++i) {
+        rx_worker *w = &endpt->rx_worker[i];
+
+        if (w->sem)
+            pj_sem_destroy(w->sem);
+        if (w->mutex)
+            pj_mutex_destroy(w->mutex);
+    }
+    endpt->rx_worker_cnt = 0;
+}
+
+/*
+ * This is the callback that is called by the transport manager when it 
+ * receives a message from the network.
+ */
+static void endpt_on_rx_msg( pjsip_endpoint *endpt,
+                             pj_status_t status,
+                             pjsip_rx_data *rdata )
+{
+    if (status != PJ_SUCCESS) {
+        char info[30];
+        char errmsg[PJ_ERR_MSG_SIZE];
+
+        info[0] = '\0';
+
+        if (status == PJSIP_EMISSINGHDR) {
+            pj_str_t p;
+
+            p.ptr = info; p.slen = 0;
+
+            if (rdata->msg_info.cid == NULL || rdata->msg_info.cid->id.slen)
+                pj_strcpy2(&p, "Call-ID");
+            if (rdata->msg_info.from == NULL)
+                pj_strcpy2(&p, " From");
+            if (rdata->msg_info.to == NULL)
+                pj_strcpy2(&p, " To");
+            if (rdata->msg_info.via == NULL)
+                pj_strcpy2(&p, " Via");
+            if (rdata->msg_info.cseq == NULL) 
+                pj_strcpy2(&p, " CSeq");
+
+            p.ptr[p.slen] = '\0';
+        }
+
+        pj_strerror(status, errmsg, sizeof(errmsg));
+
+        PJ_LOG(1, (THIS_FILE, 
+                  "Error processing packet from %s:%d: %s %s [code %d]:\n"
+                  "%.*s\n"
+                  "-- end of packet.",
+                  rdata->pkt_info.src_name, 
+                  rdata->pkt_info.src_port,
+                  errmsg,
+                  info,
+                  status,
+                  (int)rdata->msg_info.len,     
+                  rdata->msg_info.msg_buf));
+        return;
+    }
+
+    /* Queue it to the worker of the Call-ID to keep dialog affinity */
+    if (endpt->rx_worker_cnt) {
+        queue_rx_msg(endpt, rdata);
+        return;
+    }
+
+    process_rx_msg(endpt, rdata);
+}
+
 /*
  * This callback is called by transport manager before message is sent.
  * Modules may inspect the message before it's actually sent.
@@ -1108,32 +1449,35 @@ static pj_status_t endpt_on_tx_msg( pjsip_endpoint *endpt,
                                     pjsip_tx_data *tdata )
 {
     pj_status_t status = PJ_SUCCESS;
-    pjsip_module *mod;
+    const module_snapshot *snap;
+    pj_rwmutex_t *lock;
+    unsigned i;
 
     /* Distribute to modules, starting from modules with LOWEST priority */
-    LOCK_MODULE_ACCESS(endpt);
+    lock = LOCK_MODULE_ACCESS(endpt);
+    snap = endpt->mod_snap;
 
-    mod = endpt->module_list.prev;
+    i = snap->count;
     if (tdata->msg->type == PJSIP_REQUEST_MSG) {
-        while (mod != &endpt->module_list) {
+        while (i-- > 0) {
+            pjsip_module *mod = snap->mod[i];
             if (mod->on_tx_request)
                 status = (*mod->on_tx_request)(tdata);
             if (status != PJ_SUCCESS)
                 break;
-            mod = mod->prev;
         }
 
     } else {
-        while (mod != &endpt->module_list) {
+        while (i-- > 0) {
+            pjsip_module *mod = snap->mod[i];
             if (mod->on_tx_response)
                 status = (*mod->on_tx_response)(tdata);
             if (status != PJ_SUCCESS)
                 break;
-            mod = mod->prev;
         }
     }
 
-    UNLOCK_MODULE_ACCESS(endpt);
+    UNLOCK_MODULE_ACCESS(endpt, lock);
 
     return status;
 }
@@ -1193,6 +1537,15 @@ PJ_DEF(pj_dns_resolver*) pjsip_endpt_get_resolver(pjsip_endpoint *endpt)
     return pjsip_resolver_get_resolver(endpt->resolver);
 }
 
+/*
+ * Get the SIP resolver engine.
+ */
+PJ_DEF(pjsip_resolver_t*) pjsip_endpt_get_sip_resolver(pjsip_endpoint *endpt)
+{
+    PJ_ASSERT_RETURN(endpt, NULL);
+    return endpt->resolver;
+}
+
 /*
  * Resolve
  */
@@ -20,6 +20,7 @@
 #include <pjsip/sip_parser.h>
 #include <pjsip/print_util.h>
 #include <pjsip/sip_errno.h>
+#include <pjsip/sip_private.h>
 #include <pj/ctype.h>
 #include <pj/guid.h>
 #include <pj/string.h>
@@ -29,6 +30,8 @@
 #include <pj/math.h>
 #include <pjlib-util/string.h>
 
+#define THIS_FILE       "sip_msg.c"
+
 PJ_DEF_DATA(const pjsip_method) pjsip_invite_method =
         { PJSIP_INVITE_METHOD, { "INVITE",6 }};
 
@@ -148,6 +151,9 @@ const pjsip_hdr_name_info_t pjsip_hdr_names[] =
 static pj_str_t status_phrase[710];
 static int print_media_type(char *buf, unsigned len,
                             const pjsip_media_type *media);
+static pj_bool_t lazy_hdr_match(const pjsip_hdr *hdr, pjsip_hdr_e type);
+static pj_bool_t lazy_hdr_match_name(const pjsip_hdr *hdr,
+                                     const pj_str_t *name);
 
 static int init_status_phrase()
 {
@@ -323,30 +329,64 @@ PJ_DEF(pjsip_msg*) pjsip_msg_create( pj_pool_t *pool, pjsip_msg_type_e type)
     return msg;
 }
 
+static void hdr_arena_count(pjsip_clone_arena *a, const pjsip_hdr *hdr);
+static pjsip_hdr* hdr_arena_copy(pjsip_clone_arena *a, const pjsip_hdr *hdr);
+
 PJ_DEF(pjsip_msg*) pjsip_msg_clone( pj_pool_t *pool, const pjsip_msg *src)
 {
+    pjsip_clone_arena arena;
     pjsip_msg *dst;
     const pjsip_hdr *sh;
+    char *buf;
+
+    /* Count the size of the message, so that the request/status line
+     * and the headers can be copied into a single allocation.
+     */
+    pj_bzero(&arena, sizeof(arena));
+    arena.pool = pool;
+    pjsip_arena_count(&arena, sizeof(pjsip_msg));
+    if (src->type == PJSIP_REQUEST_MSG) {
+        if (src->line.req.method.id == PJSIP_OTHER_METHOD)
+            pjsip_arena_count_str(&arena, &src->line.req.method.name);
+        pjsip_uri_arena_count(&arena, src->line.req.uri);
+    } else {
+        pjsip_arena_count_str(&arena, &src->line.status.reason);
+    }
+
+    for (sh=src->hdr.next; sh!=&src->hdr; sh=sh->next)
+        hdr_arena_count(&arena, sh);
 
-    dst = pjsip_msg_create(pool, src->type);
+    buf = (char*) pj_pool_alloc(pool, arena.obj_size + arena.str_size);
+    arena.obj = buf;
+    arena.str = buf + arena.obj_size;
+
+    dst = (pjsip_msg*) pjsip_arena_alloc(&arena, sizeof(pjsip_msg));
+    pj_list_init(&dst->hdr);
+    dst->type = src->type;
+    dst->body = NULL;
 
     /* Clone request/status line */
     if (src->type == PJSIP_REQUEST_MSG) {
-        pjsip_method_copy(pool, &dst->line.req.method, &src->line.req.method);
-        dst->line.req.uri = (pjsip_uri*) pjsip_uri_clone(pool, 
-                                                         src->line.req.uri);
+        dst->line.req.method.id = src->line.req.method.id;
+        if (src->line.req.method.id == PJSIP_OTHER_METHOD) {
+            pjsip_arena_strdup(&arena, &dst->line.req.method.name,
+                               &src->line.req.method.name);
+        } else {
+            dst->line.req.method.name = src->line.req.method.name;
+        }
+        dst->line.req.uri = pjsip_uri_arena_copy(&arena, src->line.req.uri);
     } else {
         dst->line.status.code = src->line.status.code;
-        pj_strdup(pool, &dst->line.status.reason, &src->line.status.reason);
+        pjsip_arena_strdup(&arena, &dst->line.status.reason,
+                           &src->line.status.reason);
     }
 
     /* Clone headers */
-    sh = src->hdr.next;
-    while (sh != &src->hdr) {
-        pjsip_hdr *dh = (pjsip_hdr*) pjsip_hdr_clone(pool, sh);
-        pjsip_msg_add_hdr(dst, dh);
-        sh = sh->next;
-    }
+    for (sh=src->hdr.next; sh!=&src->hdr; sh=sh->next)
+        pjsip_msg_add_hdr(dst, hdr_arena_copy(&arena, sh));
+
+    pj_assert(arena.obj == buf + arena.obj_size &&
+              arena.str == buf + arena.obj_size + arena.str_size);
 
     /* Clone message body */
     if (src->body) {
@@ -365,6 +405,19 @@ PJ_DEF(void*)  pjsip_hdr_find( const void *hdr_list,
         hdr = end->next;
     }
     for (; hdr!=end; hdr = hdr->next) {
+        if (pjsip_hdr_is_lazy(hdr)) {
+            pjsip_hdr *parsed;
+
+            /* Unparsed lazy headers are PJSIP_H_OTHER, skip the ones
+             * that can't be of the requested type.
+             */
+            if (!lazy_hdr_match(hdr, hdr_type))
+                continue;
+
+            parsed = pjsip_lazy_hdr_parse((pjsip_lazy_hdr*)hdr);
+            if (parsed)
+                hdr = parsed;
+        }
         if (hdr->type == hdr_type)
             return (void*)hdr;
     }
@@ -381,6 +434,11 @@ PJ_DEF(void*)  pjsip_hdr_find_by_name( const void *hdr_list,
         hdr = end->next;
     }
     for (; hdr!=end; hdr = hdr->next) {
+        if (pjsip_hdr_is_lazy(hdr) && lazy_hdr_match_name(hdr, name)) {
+            pjsip_hdr *parsed = pjsip_lazy_hdr_parse((pjsip_lazy_hdr*)hdr);
+            if (parsed)
+                hdr = parsed;
+        }
         if (pj_stricmp(&hdr->name, name) == 0)
             return (void*)hdr;
     }
@@ -398,6 +456,14 @@ PJ_DEF(void*)  pjsip_hdr_find_by_names( const void *hdr_list,
         hdr = end->next;
     }
     for (; hdr!=end; hdr = hdr->next) {
+        if (pjsip_hdr_is_lazy(hdr) &&
+            (lazy_hdr_match_name(hdr, name) ||
+             pj_stricmp(&hdr->name, sname) == 0))
+        {
+            pjsip_hdr *parsed = pjsip_lazy_hdr_parse((pjsip_lazy_hdr*)hdr);
+            if (parsed)
+                hdr = parsed;
+        }
         if (pj_stricmp(&hdr->name, name) == 0)
             return (void*)hdr;
         if (pj_stricmp(&hdr->name, sname) == 0)
@@ -629,6 +695,107 @@ PJ_DEF(int) pjsip_hdr_print_on( void *hdr_ptr, char *buf, pj_size_t len)
     return (*hdr->vptr->print_on)(hdr_ptr, buf, len);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * Frozen header.
+ *
+ * The header keeps its type and structure, only its vptr is replaced with
+ * a per-instance vptr which also carries the original vptr and the encoded
+ * header.
+ */
+typedef struct frozen_vptr
+{
+    pjsip_hdr_vptr          vptr;       /* Must be the first member */
+    const pjsip_hdr_vptr   *orig;
+    pj_str_t                encoded;
+} frozen_vptr;
+
+static int frozen_hdr_print( pjsip_hdr *hdr, char *buf, pj_size_t size );
+static pjsip_hdr* frozen_hdr_clone( pj_pool_t *pool, const pjsip_hdr *hdr );
+static pjsip_hdr* frozen_hdr_shallow_clone( pj_pool_t *pool,
+                                            const pjsip_hdr *hdr );
+
+static frozen_vptr* create_frozen_vptr( pj_pool_t *pool,
+                                        const pjsip_hdr_vptr *orig,
+                                        const pj_str_t *encoded )
+{
+    frozen_vptr *fv = PJ_POOL_ALLOC_T(pool, frozen_vptr);
+
+    fv->vptr.clone = (pjsip_hdr_clone_fptr) &frozen_hdr_clone;
+    fv->vptr.shallow_clone = (pjsip_hdr_clone_fptr) &frozen_hdr_shallow_clone;
+    fv->vptr.print_on = (pjsip_hdr_print_fptr) &frozen_hdr_print;
+    fv->orig = orig;
+    pj_strdup(pool, &fv->encoded, encoded);
+    return fv;
+}
+
+static int frozen_hdr_print( pjsip_hdr *hdr, char *buf, pj_size_t size )
+{
+    const frozen_vptr *fv = (const frozen_vptr*) hdr->vptr;
+
+    if ((pj_ssize_t)size < fv->encoded.slen)
+        return -1;
+    pj_memcpy(buf, fv->encoded.ptr, fv->encoded.slen);
+    return (int)fv->encoded.slen;
+}
+
+static pjsip_hdr* frozen_hdr_clone( pj_pool_t *pool, const pjsip_hdr *rhs )
+{
+    const frozen_vptr *fv = (const frozen_vptr*) rhs->vptr;
+    pjsip_hdr *hdr;
+
+    hdr = (pjsip_hdr*) (*fv->orig->clone)(pool, rhs);
+    hdr->vptr = &create_frozen_vptr(pool, fv->orig, &fv->encoded)->vptr;
+    return hdr;
+}
+
+static pjsip_hdr* frozen_hdr_shallow_clone( pj_pool_t *pool,
+                                            const pjsip_hdr *rhs )
+{
+    const frozen_vptr *fv = (const frozen_vptr*) rhs->vptr;
+    pjsip_hdr *hdr;
+
+    hdr = (pjsip_hdr*) (*fv->orig->shallow_clone)(pool, rhs);
+    hdr->vptr = rhs->vptr;
+    return hdr;
+}
+
+PJ_DEF(pj_bool_t) pjsip_hdr_is_frozen( const void *hdr )
+{
+    const pjsip_hdr *h = (const pjsip_hdr*) hdr;
+    return h->vptr->print_on == (pjsip_hdr_print_fptr) &frozen_hdr_print;
+}
+
+PJ_DEF(void) pjsip_hdr_unfreeze( void *hdr )
+{
+    pjsip_hdr *h = (pjsip_hdr*) hdr;
+
+    if (pjsip_hdr_is_frozen(h))
+        h->vptr = (pjsip_hdr_vptr*) ((const frozen_vptr*)h->vptr)->orig;
+}
+
+PJ_DEF(pj_status_t) pjsip_hdr_freeze( pj_pool_t *pool, void *hdr )
+{
+    pjsip_hdr *h = (pjsip_hdr*) hdr;
+    char buf[PJSIP_MAX_FROZEN_HDR_LEN];
+    pj_str_t encoded;
+    int len;
+
+    PJ_ASSERT_RETURN(pool && hdr, PJ_EINVAL);
+    PJ_ASSERT_RETURN(!pjsip_hdr_is_lazy(hdr), PJ_EINVALIDOP);
+
+    pjsip_hdr_unfreeze(h);
+
+    len = (*h->vptr->print_on)(h, buf, sizeof(buf));
+    if (len < 0)
+        return PJSIP_EMSGTOOLONG;
+
+    pj_strset(&encoded, buf, len);
+    h->vptr = &create_frozen_vptr(pool, h->vptr, &encoded)->vptr;
+
+    return PJ_SUCCESS;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /*
  * Status/Reason Phrase
@@ -833,6 +1000,144 @@ static pjsip_generic_string_hdr* pjsip_generic_string_hdr_shallow_clone( pj_pool
     return hdr;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * Lazy header, printed as generic string header until it is parsed.
+ */
+
+static pjsip_lazy_hdr* pjsip_lazy_hdr_clone( pj_pool_t *pool,
+                                             const pjsip_lazy_hdr *hdr);
+static pjsip_lazy_hdr* pjsip_lazy_hdr_shallow_clone( pj_pool_t *pool,
+                                                     const pjsip_lazy_hdr *hdr);
+
+static pjsip_hdr_vptr lazy_hdr_vptr = 
+{
+    (pjsip_hdr_clone_fptr) &pjsip_lazy_hdr_clone,
+    (pjsip_hdr_clone_fptr) &pjsip_lazy_hdr_shallow_clone,
+    (pjsip_hdr_print_fptr) &pjsip_generic_string_hdr_print,
+};
+
+PJ_DEF(pjsip_lazy_hdr*) pjsip_lazy_hdr_create(pj_pool_t *pool,
+                                              const pj_str_t *hname,
+                                              const pj_str_t *hvalue)
+{
+    pjsip_lazy_hdr *hdr = PJ_POOL_ALLOC_T(pool, pjsip_lazy_hdr);
+
+    init_hdr(hdr, PJSIP_H_OTHER, &lazy_hdr_vptr);
+    hdr->name = hdr->sname = *hname;
+    if (hvalue) {
+        hdr->hvalue = *hvalue;
+    } else {
+        hdr->hvalue.ptr = NULL;
+        hdr->hvalue.slen = 0;
+    }
+    hdr->pool = pool;
+    return hdr;
+}
+
+static pjsip_lazy_hdr* pjsip_lazy_hdr_clone( pj_pool_t *pool,
+                                             const pjsip_lazy_hdr *rhs)
+{
+    pjsip_lazy_hdr *hdr = PJ_POOL_ALLOC_T(pool, pjsip_lazy_hdr);
+
+    init_hdr(hdr, PJSIP_H_OTHER, &lazy_hdr_vptr);
+    pj_strdup(pool, &hdr->name, &rhs->name);
+    hdr->sname = hdr->name;
+    pj_strdup(pool, &hdr->hvalue, &rhs->hvalue);
+    hdr->pool = pool;
+    return hdr;
+}
+
+static pjsip_lazy_hdr* pjsip_lazy_hdr_shallow_clone( pj_pool_t *pool,
+                                                     const pjsip_lazy_hdr *rhs)
+{
+    pjsip_lazy_hdr *hdr = PJ_POOL_ALLOC_T(pool, pjsip_lazy_hdr);
+    pj_memcpy(hdr, rhs, sizeof(*hdr));
+    hdr->pool = pool;
+    return hdr;
+}
+
+PJ_DEF(pj_bool_t) pjsip_hdr_is_lazy(const void *hdr)
+{
+    return ((const pjsip_hdr*)hdr)->vptr == &lazy_hdr_vptr;
+}
+
+PJ_DEF(pjsip_hdr*) pjsip_lazy_hdr_parse(pjsip_lazy_hdr *lhdr)
+{
+    pjsip_hdr *hdr;
+    char *buf;
+
+    PJ_ASSERT_RETURN(lhdr && lhdr->vptr == &lazy_hdr_vptr, NULL);
+
+    /* The scanner needs NULL terminated input */
+    buf = (char*) pj_pool_alloc(lhdr->pool, lhdr->hvalue.slen + 1);
+    pj_memcpy(buf, lhdr->hvalue.ptr, lhdr->hvalue.slen);
+    buf[lhdr->hvalue.slen] = '\0';
+
+    hdr = (pjsip_hdr*) pjsip_parse_hdr(lhdr->pool, &lhdr->name, buf,
+                                       lhdr->hvalue.slen, NULL);
+    if (!hdr) {
+        PJ_LOG(4,(THIS_FILE, "Error parsing %.*s header, keeping it as "
+                  "generic header", (int)lhdr->name.slen, lhdr->name.ptr));
+        lhdr->vptr = &generic_hdr_vptr;
+        return NULL;
+    }
+
+    /* Parsing may yield a list of headers */
+    pj_list_insert_nodes_before(lhdr, hdr);
+    pj_list_erase(lhdr);
+
+    return hdr;
+}
+
+/* Check if the lazy header may be of the specified type */
+static pj_bool_t lazy_hdr_match(const pjsip_hdr *hdr, pjsip_hdr_e type)
+{
+    const pjsip_hdr_name_info_t *info;
+
+    /* Headers with a name from pjsip_hdr_names[] are parsed to their
+     * own type, the rest are parsed to PJSIP_H_OTHER.
+     */
+    if (type == PJSIP_H_OTHER) {
+        int t;
+
+        for (t=0; t<PJSIP_H_OTHER; ++t) {
+            if (lazy_hdr_match(hdr, (pjsip_hdr_e)t))
+                return PJ_FALSE;
+        }
+        return PJ_TRUE;
+    }
+
+    info = &pjsip_hdr_names[type];
+    if (hdr->name.slen == 1) {
+        return info->sname &&
+               pj_tolower(*hdr->name.ptr) == pj_tolower(*info->sname);
+    }
+    return hdr->name.slen == (pj_ssize_t)info->name_len &&
+           pj_ansi_strnicmp(hdr->name.ptr, info->name, info->name_len) == 0;
+}
+
+/* Check if the lazy header may have the specified name after parsing */
+static pj_bool_t lazy_hdr_match_name(const pjsip_hdr *hdr,
+                                     const pj_str_t *name)
+{
+    /* Compact form is only known after parsing */
+    return hdr->name.slen == 1 || pj_stricmp(&hdr->name, name) == 0;
+}
+
+PJ_DEF(void) pjsip_msg_parse_lazy_hdrs( pjsip_msg *msg )
+{
+    pjsip_hdr *hdr = msg->hdr.next;
+
+    while (hdr != &msg->hdr) {
+        pjsip_hdr *next = hdr->next;
+
+        if (hdr->vptr == &lazy_hdr_vptr)
+            pjsip_lazy_hdr_parse((pjsip_lazy_hdr*)hdr);
+        hdr = next;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /*
  * Generic pjsip_hdr_names/integer value header.
@@ -2156,6 +2461,282 @@ static pjsip_via_hdr* pjsip_via_hdr_shallow_clone( pj_pool_t *pool,
     return hdr;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * Contiguous clone of the headers, used by pjsip_msg_clone(). The result
+ * must be the same as the clone function of the header. Headers with other
+ * vptr (e.g. frozen and authentication headers) are cloned from the pool.
+ */
+static void hname_arena_count(pjsip_clone_arena *a, const pjsip_hdr *hdr)
+{
+    pjsip_arena_count_str(a, &hdr->name);
+    if (hdr->sname.ptr != hdr->name.ptr || hdr->sname.slen > hdr->name.slen)
+        pjsip_arena_count_str(a, &hdr->sname);
+}
+
+static void hname_arena_copy(pjsip_clone_arena *a, pjsip_hdr *dst,
+                             const pjsip_hdr *src)
+{
+    pjsip_arena_strdup(a, &dst->name, &src->name);
+    if (src->sname.ptr != src->name.ptr || src->sname.slen > src->name.slen) {
+        pjsip_arena_strdup(a, &dst->sname, &src->sname);
+    } else {
+        dst->sname.ptr = dst->name.ptr;
+        dst->sname.slen = src->sname.slen;
+    }
+}
+
+static void hdr_arena_count(pjsip_clone_arena *a, const pjsip_hdr *hdr)
+{
+    const pjsip_hdr_vptr *vptr = hdr->vptr;
+
+    if (vptr == &generic_hdr_vptr) {
+        const pjsip_generic_string_hdr *h =
+            (const pjsip_generic_string_hdr*) hdr;
+        pjsip_arena_count(a, sizeof(*h));
+        hname_arena_count(a, hdr);
+        pjsip_arena_count_str(a, &h->hvalue);
+
+    } else if (vptr == &lazy_hdr_vptr) {
+        const pjsip_lazy_hdr *h = (const pjsip_lazy_hdr*) hdr;
+        pjsip_arena_count(a, sizeof(*h));
+        pjsip_arena_count_str(a, &h->name);
+        pjsip_arena_count_str(a, &h->hvalue);
+
+    } else if (vptr == &generic_int_hdr_vptr) {
+        pjsip_arena_count(a, sizeof(pjsip_generic_int_hdr));
+        pjsip_arena_count_str(a, &hdr->name);
+
+    } else if (vptr == &generic_array_hdr_vptr) {
+        const pjsip_generic_array_hdr *h =
+            (const pjsip_generic_array_hdr*) hdr;
+        unsigned i, count = PJ_MIN(h->count, PJSIP_GENERIC_ARRAY_MAX_COUNT);
+
+        pjsip_arena_count(a, sizeof(*h));
+        pjsip_arena_count_str(a, &h->name);
+        for (i=0; i<count; ++i)
+            pjsip_arena_count_str(a, &h->values[i]);
+
+    } else if (vptr == &clen_hdr_vptr) {
+        pjsip_arena_count(a, sizeof(pjsip_clen_hdr));
+
+    } else if (vptr == &cseq_hdr_vptr) {
+        const pjsip_cseq_hdr *h = (const pjsip_cseq_hdr*) hdr;
+        pjsip_arena_count(a, sizeof(*h));
+        if (h->method.id == PJSIP_OTHER_METHOD)
+            pjsip_arena_count_str(a, &h->method.name);
+
+    } else if (vptr == &contact_hdr_vptr) {
+        const pjsip_contact_hdr *h = (const pjsip_contact_hdr*) hdr;
+        pjsip_arena_count(a, sizeof(*h));
+        if (!h->star) {
+            pjsip_uri_arena_count(a, h->uri);
+            pjsip_param_arena_count(a, &h->other_param);
+        }
+
+    } else if (vptr == &ctype_hdr_vptr) {
+        const pjsip_ctype_hdr *h = (const pjsip_ctype_hdr*) hdr;
+        pjsip_arena_count(a, sizeof(*h));
+        pjsip_arena_count_str(a, &h->media.type);
+        pjsip_arena_count_str(a, &h->media.subtype);
+        pjsip_param_arena_count(a, &h->media.param);
+
+    } else if (vptr == &fromto_hdr_vptr) {
+        const pjsip_fromto_hdr *h = (const pjsip_fromto_hdr*) hdr;
+        pjsip_arena_count(a, sizeof(*h));
+        pjsip_uri_arena_count(a, h->uri);
+        pjsip_arena_count_str(a, &h->tag);
+        pjsip_param_arena_count(a, &h->other_param);
+
+    } else if (vptr == &routing_hdr_vptr) {
+        const pjsip_routing_hdr *h = (const pjsip_routing_hdr*) hdr;
+        pjsip_arena_count(a, sizeof(*h));
+        pjsip_arena_count_str(a, &h->name_addr.display);
+        pjsip_uri_arena_count(a, h->name_addr.uri);
+        pjsip_param_arena_count(a, &h->other_param);
+
+    } else if (vptr == &retry_after_hdr_vptr) {
+        const pjsip_retry_after_hdr *h = (const pjsip_retry_after_hdr*) hdr;
+        pjsip_arena_count(a, sizeof(*h));
+        pjsip_arena_count_str(a, &h->comment);
+        pjsip_param_arena_count(a, &h->param);
+
+    } else if (vptr == &via_hdr_vptr) {
+        const pjsip_via_hdr *h = (const pjsip_via_hdr*) hdr;
+        pjsip_arena_count(a, sizeof(*h));
+        pjsip_arena_count_str(a, &h->transport);
+        pjsip_arena_count_str(a, &h->sent_by.host);
+        pjsip_arena_count_str(a, &h->maddr_param);
+        pjsip_arena_count_str(a, &h->recvd_param);
+        pjsip_arena_count_str(a, &h->branch_param);
+        pjsip_param_arena_count(a, &h->other_param);
+        pjsip_arena_count_str(a, &h->comment);
+    }
+}
+
+static pjsip_hdr* hdr_arena_copy(pjsip_clone_arena *a, const pjsip_hdr *hdr)
+{
+    const pjsip_hdr_vptr *vptr = hdr->vptr;
+
+    if (vptr == &generic_hdr_vptr) {
+        const pjsip_generic_string_hdr *rhs =
+            (const pjsip_generic_string_hdr*) hdr;
+        pjsip_generic_string_hdr *h;
+
+        h = (pjsip_generic_string_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, rhs->type, &generic_hdr_vptr);
+        hname_arena_copy(a, (pjsip_hdr*)h, hdr);
+        pjsip_arena_strdup(a, &h->hvalue, &rhs->hvalue);
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &lazy_hdr_vptr) {
+        const pjsip_lazy_hdr *rhs = (const pjsip_lazy_hdr*) hdr;
+        pjsip_lazy_hdr *h;
+
+        h = (pjsip_lazy_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, PJSIP_H_OTHER, &lazy_hdr_vptr);
+        pjsip_arena_strdup(a, &h->name, &rhs->name);
+        h->sname = h->name;
+        pjsip_arena_strdup(a, &h->hvalue, &rhs->hvalue);
+        h->pool = a->pool;
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &generic_int_hdr_vptr) {
+        const pjsip_generic_int_hdr *rhs = (const pjsip_generic_int_hdr*) hdr;
+        pjsip_generic_int_hdr *h;
+
+        h = (pjsip_generic_int_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, rhs->type, &generic_int_hdr_vptr);
+        pjsip_arena_strdup(a, &h->name, &rhs->name);
+        h->sname = h->name;
+        h->ivalue = rhs->ivalue;
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &generic_array_hdr_vptr) {
+        const pjsip_generic_array_hdr *rhs =
+            (const pjsip_generic_array_hdr*) hdr;
+        pjsip_generic_array_hdr *h;
+        unsigned i;
+
+        h = (pjsip_generic_array_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, rhs->type, &generic_array_hdr_vptr);
+        pjsip_arena_strdup(a, &h->name, &rhs->name);
+        h->sname = h->name;
+        h->count = PJ_MIN(rhs->count, PJSIP_GENERIC_ARRAY_MAX_COUNT);
+        for (i=0; i<h->count; ++i)
+            pjsip_arena_strdup(a, &h->values[i], &rhs->values[i]);
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &clen_hdr_vptr) {
+        const pjsip_clen_hdr *rhs = (const pjsip_clen_hdr*) hdr;
+        pjsip_clen_hdr *h;
+
+        h = (pjsip_clen_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, PJSIP_H_CONTENT_LENGTH, &clen_hdr_vptr);
+        h->len = rhs->len;
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &cseq_hdr_vptr) {
+        const pjsip_cseq_hdr *rhs = (const pjsip_cseq_hdr*) hdr;
+        pjsip_cseq_hdr *h;
+
+        h = (pjsip_cseq_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, PJSIP_H_CSEQ, &cseq_hdr_vptr);
+        h->cseq = rhs->cseq;
+        h->method.id = rhs->method.id;
+        if (rhs->method.id == PJSIP_OTHER_METHOD)
+            pjsip_arena_strdup(a, &h->method.name, &rhs->method.name);
+        else
+            h->method.name = rhs->method.name;
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &contact_hdr_vptr) {
+        const pjsip_contact_hdr *rhs = (const pjsip_contact_hdr*) hdr;
+        pjsip_contact_hdr *h;
+
+        h = (pjsip_contact_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        pj_bzero(h, sizeof(*h));
+        init_hdr(h, PJSIP_H_CONTACT, &contact_hdr_vptr);
+        h->expires = PJSIP_EXPIRES_NOT_SPECIFIED;
+        pj_list_init(&h->other_param);
+        h->star = rhs->star;
+        if (!h->star) {
+            h->uri = pjsip_uri_arena_copy(a, rhs->uri);
+            h->q1000 = rhs->q1000;
+            h->expires = rhs->expires;
+            pjsip_param_arena_copy(a, &h->other_param, &rhs->other_param);
+        }
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &ctype_hdr_vptr) {
+        const pjsip_ctype_hdr *rhs = (const pjsip_ctype_hdr*) hdr;
+        pjsip_ctype_hdr *h;
+
+        h = (pjsip_ctype_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, PJSIP_H_CONTENT_TYPE, &ctype_hdr_vptr);
+        pjsip_arena_strdup(a, &h->media.type, &rhs->media.type);
+        pjsip_arena_strdup(a, &h->media.subtype, &rhs->media.subtype);
+        pjsip_param_arena_copy(a, &h->media.param, &rhs->media.param);
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &fromto_hdr_vptr) {
+        const pjsip_fromto_hdr *rhs = (const pjsip_fromto_hdr*) hdr;
+        pjsip_fromto_hdr *h;
+
+        h = (pjsip_fromto_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, rhs->type, &fromto_hdr_vptr);
+        h->name = rhs->name;
+        h->sname = rhs->sname;
+        h->uri = pjsip_uri_arena_copy(a, rhs->uri);
+        pjsip_arena_strdup(a, &h->tag, &rhs->tag);
+        pjsip_param_arena_copy(a, &h->other_param, &rhs->other_param);
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &routing_hdr_vptr) {
+        const pjsip_routing_hdr *rhs = (const pjsip_routing_hdr*) hdr;
+        pjsip_routing_hdr *h;
+
+        h = (pjsip_routing_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, rhs->type, rhs->vptr);
+        pjsip_name_addr_init(&h->name_addr);
+        pjsip_arena_strdup(a, &h->name_addr.display, &rhs->name_addr.display);
+        h->name_addr.uri = pjsip_uri_arena_copy(a, rhs->name_addr.uri);
+        pjsip_param_arena_copy(a, &h->other_param, &rhs->other_param);
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &retry_after_hdr_vptr) {
+        const pjsip_retry_after_hdr *rhs = (const pjsip_retry_after_hdr*) hdr;
+        pjsip_retry_after_hdr *h;
+
+        h = (pjsip_retry_after_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, PJSIP_H_RETRY_AFTER, &retry_after_hdr_vptr);
+        h->ivalue = rhs->ivalue;
+        pjsip_arena_strdup(a, &h->comment, &rhs->comment);
+        pjsip_param_arena_copy(a, &h->param, &rhs->param);
+        return (pjsip_hdr*) h;
+
+    } else if (vptr == &via_hdr_vptr) {
+        const pjsip_via_hdr *rhs = (const pjsip_via_hdr*) hdr;
+        pjsip_via_hdr *h;
+
+        h = (pjsip_via_hdr*) pjsip_arena_alloc(a, sizeof(*h));
+        init_hdr(h, PJSIP_H_VIA, &via_hdr_vptr);
+        pjsip_arena_strdup(a, &h->transport, &rhs->transport);
+        pjsip_arena_strdup(a, &h->sent_by.host, &rhs->sent_by.host);
+        h->sent_by.port = rhs->sent_by.port;
+        h->ttl_param = rhs->ttl_param;
+        h->rport_param = rhs->rport_param;
+        pjsip_arena_strdup(a, &h->maddr_param, &rhs->maddr_param);
+        pjsip_arena_strdup(a, &h->recvd_param, &rhs->recvd_param);
+        pjsip_arena_strdup(a, &h->branch_param, &rhs->branch_param);
+        pjsip_param_arena_copy(a, &h->other_param, &rhs->other_param);
+        pjsip_arena_strdup(a, &h->comment, &rhs->comment);
+        return (pjsip_hdr*) h;
+    }
+
+    return (pjsip_hdr*) pjsip_hdr_clone(a->pool, hdr);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /*
  * Warning header.
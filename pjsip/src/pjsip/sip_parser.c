@@ -185,6 +185,8 @@ static pjsip_hdr*   parse_hdr_to( pjsip_parse_ctx *ctx );
 static pjsip_hdr*   parse_hdr_unsupported( pjsip_parse_ctx *ctx );
 static pjsip_hdr*   parse_hdr_via( pjsip_parse_ctx *ctx );
 static pjsip_hdr*   parse_hdr_generic_string( pjsip_parse_ctx *ctx);
+static void         parse_generic_string_hdr( pjsip_generic_string_hdr *hdr,
+                                              pjsip_parse_ctx *ctx);
 
 /* Convert non NULL terminated string to integer. */
 static unsigned long pj_strtoul_mindigit(const pj_str_t *str, 
@@ -791,6 +793,22 @@ PJ_DEF(pj_status_t) pjsip_register_uri_parser( char *scheme,
     return PJ_SUCCESS;
 }
 
+/* Check if the header must be parsed right away when lazy header parsing
+ * is enabled, i.e. it is referenced by rdata's msg_info or it is needed to
+ * parse the message body. Only the top Via is needed.
+ */
+static pj_bool_t is_eager_hdr(pjsip_parse_hdr_func *func, pj_bool_t has_via)
+{
+    return func == &parse_hdr_call_id || func == &parse_hdr_cseq ||
+           func == &parse_hdr_from || func == &parse_hdr_to ||
+           func == &parse_hdr_max_forwards ||
+           func == &parse_hdr_content_len ||
+           func == &parse_hdr_content_type ||
+           func == &parse_hdr_require || func == &parse_hdr_supported ||
+           func == &parse_hdr_route || func == &parse_hdr_rr ||
+           (func == &parse_hdr_via && !has_via);
+}
+
 /* Public function to parse SIP message. */
 PJ_DEF(pjsip_msg*) pjsip_parse_msg( pj_pool_t *pool, 
                                     char *buf, pj_size_t size,
@@ -1023,12 +1041,14 @@ static pjsip_msg *int_parse_msg( pjsip_parse_ctx *ctx,
      * preserved when re-entering the PJ_TRY block after an error.
      */
     volatile pj_bool_t parsing_headers;
+    volatile pj_bool_t has_via = PJ_FALSE;
     pjsip_msg *volatile msg = NULL;
     pjsip_ctype_hdr *volatile ctype_hdr = NULL;
 
     pj_str_t hname;
     pj_scanner *scanner = ctx->scanner;
     pj_pool_t *pool = ctx->pool;
+    pj_bool_t lazy = pjsip_cfg()->endpt.lazy_hdr_parsing;
     PJ_USE_EXCEPTION;
 
     parsing_headers = PJ_FALSE;
@@ -1086,7 +1106,13 @@ parse_headers:
              * If no handler is found, then treat the header as generic
              * hname/hvalue pair.
              */
-            if (func) {
+            if (func && lazy && !is_eager_hdr(func, has_via)) {
+                /* Keep the raw value, it will be parsed on first lookup */
+                hdr = (pjsip_hdr*)pjsip_lazy_hdr_create(pool, &hname, NULL);
+                parse_generic_string_hdr((pjsip_generic_string_hdr*)hdr,
+                                         ctx);
+
+            } else if (func) {
                 hdr = (*func)(ctx);
 
                 /* Note:
@@ -1101,6 +1127,8 @@ parse_headers:
                  */
                 if (hdr && hdr->type == PJSIP_H_CONTENT_TYPE) {
                     ctype_hdr = (pjsip_ctype_hdr*)hdr;
+                } else if (hdr && hdr->type == PJSIP_H_VIA) {
+                    has_via = PJ_TRUE;
                 }
 
             } else {
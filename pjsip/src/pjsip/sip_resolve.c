@@ -25,7 +25,10 @@
 #include <pj/array.h>
 #include <pj/assert.h>
 #include <pj/ctype.h>
+#include <pj/hash.h>
+#include <pj/list.h>
 #include <pj/log.h>
+#include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/rand.h>
 #include <pj/string.h>
@@ -33,6 +36,32 @@
 
 #define THIS_FILE   "sip_resolve.c"
 
+/* Target key is the address bytes followed by the port */
+#define TARGET_KEY_LEN  (sizeof(pj_in6_addr) + 2)
+
+/* Routing cache entry, keeping a target set resolved with DNS */
+struct cache_entry
+{
+    PJ_DECL_LIST_MEMBER(struct cache_entry);
+    pj_pool_t               *pool;
+    pj_str_t                 key;
+    pj_hash_entry_buf        hbuf;
+    pj_time_val              expiry;
+    pjsip_server_addresses   server;
+};
+
+/* Health score of a target address */
+struct target_entry
+{
+    PJ_DECL_LIST_MEMBER(struct target_entry);
+    char                     key[TARGET_KEY_LEN];
+    unsigned                 key_len;
+    pj_hash_entry_buf        hbuf;
+    unsigned                 fail_cnt;
+    pj_time_val              down_until;
+    unsigned                 srtt;
+};
+
 struct naptr_target
 {
     pj_str_t                res_type;       /**< e.g. "_sip._udp"   */
@@ -54,6 +83,9 @@ struct query
     pj_grp_lock_t           *grp_lock;
     pj_status_t              last_error;
 
+    pjsip_resolver_t        *resolver;
+    pj_str_t                 cache_key;
+
     /* Original request: */
     struct {
         pjsip_host_info      target;
@@ -74,6 +106,17 @@ struct pjsip_resolver_t
     pj_dns_resolver *res;
     pj_grp_lock_t   *grp_lock;
     pjsip_ext_resolver *ext_res;
+
+    /* Routing cache, only valid when cache_pool is set */
+    pj_pool_factory *cache_pf;
+    pj_pool_t       *cache_pool;
+    pjsip_resolver_cache_cfg cache_cfg;
+    pj_hash_table_t *cache_ht;
+    struct cache_entry cache_list;      /* LRU first */
+    unsigned         cache_cnt;
+    pj_hash_table_t *target_ht;
+    struct target_entry target_list;    /* LRU first */
+    unsigned         target_cnt;
 };
 
 
@@ -86,6 +129,7 @@ static void dns_a_callback(void *user_data,
 static void dns_aaaa_callback(void *user_data,
                               pj_status_t status,
                               pj_dns_parsed_packet *response);
+static void clear_cache(pjsip_resolver_t *res);
 
 
 /*
@@ -173,11 +217,453 @@ PJ_DEF(void) pjsip_resolver_destroy(pjsip_resolver_t *resolver)
     }
 
     if (resolver->grp_lock) {
+        pj_grp_lock_acquire(resolver->grp_lock);
+        clear_cache(resolver);
+        pj_grp_lock_release(resolver->grp_lock);
+
         pj_grp_lock_dec_ref(resolver->grp_lock);
         resolver->grp_lock = NULL;
     }
 }
 
+
+/*
+ * Initialize routing cache settings with default values.
+ */
+PJ_DEF(void) pjsip_resolver_cache_cfg_default(pjsip_resolver_cache_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->ttl = PJSIP_RESOLVE_CACHE_TTL;
+    cfg->max_cnt = PJSIP_RESOLVE_CACHE_MAX_CNT;
+    cfg->fail_threshold = PJSIP_RESOLVE_FAIL_THRESHOLD;
+    cfg->down_time = PJSIP_RESOLVE_DOWN_TIME;
+}
+
+
+/* Remove a target set from the cache, resolver must be locked */
+static void remove_cache_entry(pjsip_resolver_t *res, struct cache_entry *e)
+{
+    pj_hash_set(NULL, res->cache_ht, e->key.ptr, (unsigned)e->key.slen, 0,
+                NULL);
+    pj_list_erase(e);
+    --res->cache_cnt;
+    pj_pool_release(e->pool);
+}
+
+
+/* Destroy the routing cache, resolver must be locked */
+static void clear_cache(pjsip_resolver_t *res)
+{
+    if (!res->cache_pool)
+        return;
+
+    while (!pj_list_empty(&res->cache_list))
+        remove_cache_entry(res, res->cache_list.next);
+
+    pj_pool_release(res->cache_pool);
+    res->cache_pool = NULL;
+    res->cache_ht = NULL;
+    res->target_ht = NULL;
+    res->target_cnt = 0;
+}
+
+
+/*
+ * Enable, reconfigure, or disable the routing cache.
+ */
+PJ_DEF(pj_status_t) pjsip_resolver_set_cache(pjsip_resolver_t *res,
+                                             pj_pool_factory *pf,
+                                             const pjsip_resolver_cache_cfg *cfg)
+{
+    pj_pool_t *pool;
+
+    PJ_ASSERT_RETURN(res && (pf || !cfg), PJ_EINVAL);
+    PJ_ASSERT_RETURN(!cfg || (cfg->max_cnt && cfg->fail_threshold),
+                     PJ_EINVAL);
+
+    pj_grp_lock_acquire(res->grp_lock);
+
+    clear_cache(res);
+
+    if (!cfg) {
+        pj_grp_lock_release(res->grp_lock);
+        return PJ_SUCCESS;
+    }
+
+    pool = pj_pool_create(pf, "rcache%p", 512, 512, NULL);
+    if (!pool) {
+        pj_grp_lock_release(res->grp_lock);
+        return PJ_ENOMEM;
+    }
+
+    res->cache_pf = pf;
+    res->cache_pool = pool;
+    pj_memcpy(&res->cache_cfg, cfg, sizeof(*cfg));
+    res->cache_ht = pj_hash_create(pool, cfg->max_cnt);
+    pj_list_init(&res->cache_list);
+    res->cache_cnt = 0;
+    res->target_ht = pj_hash_create(pool, cfg->max_cnt);
+    pj_list_init(&res->target_list);
+    res->target_cnt = 0;
+
+    pj_grp_lock_release(res->grp_lock);
+
+    return PJ_SUCCESS;
+}
+
+
+/* Build the health key of a target address */
+static unsigned get_target_key(const pj_sockaddr_t *addr,
+                               char key[TARGET_KEY_LEN])
+{
+    unsigned len = pj_sockaddr_get_addr_len(addr);
+    pj_uint16_t port = pj_sockaddr_get_port(addr);
+
+    if (len > TARGET_KEY_LEN - 2)
+        len = TARGET_KEY_LEN - 2;
+    pj_memcpy(key, pj_sockaddr_get_addr(addr), len);
+    key[len++] = (char)(port >> 8);
+    key[len++] = (char)(port & 0xFF);
+
+    return len;
+}
+
+
+/* Find the health score of a target, resolver must be locked */
+static struct target_entry *find_target(pjsip_resolver_t *res,
+                                        const pj_sockaddr_t *addr)
+{
+    char key[TARGET_KEY_LEN];
+    unsigned key_len;
+
+    key_len = get_target_key(addr, key);
+    return (struct target_entry*)
+           pj_hash_get(res->target_ht, key, key_len, NULL);
+}
+
+
+/* Check if target is currently down, resolver must be locked */
+static pj_bool_t is_target_down(pjsip_resolver_t *res,
+                                const struct target_entry *t,
+                                const pj_time_val *now)
+{
+    return t && t->fail_cnt >= res->cache_cfg.fail_threshold &&
+           PJ_TIME_VAL_LT(*now, t->down_until);
+}
+
+
+/*
+ * Report the outcome of a request sent to a target.
+ */
+PJ_DEF(void) pjsip_resolver_report_target(pjsip_resolver_t *res,
+                                          const pj_sockaddr_t *addr,
+                                          int addr_len,
+                                          int code,
+                                          unsigned rtt)
+{
+    struct target_entry *t;
+    pj_bool_t failed;
+    pj_time_val now;
+
+    PJ_ASSERT_ON_FAIL(res && addr, return);
+
+    /* Fast path when the cache is not enabled */
+    if (!res->cache_pool || addr_len <= 0)
+        return;
+
+    failed = (code == PJSIP_SC_TSX_TIMEOUT ||
+              code == PJSIP_SC_SERVICE_UNAVAILABLE);
+
+    pj_grp_lock_acquire(res->grp_lock);
+
+    if (!res->cache_pool) {
+        pj_grp_lock_release(res->grp_lock);
+        return;
+    }
+
+    t = find_target(res, addr);
+    if (t) {
+        pj_list_erase(t);
+    } else {
+        /* Only start tracking a target when something is worth keeping */
+        if (!failed && !rtt) {
+            pj_grp_lock_release(res->grp_lock);
+            return;
+        }
+
+        if (res->target_cnt >= res->cache_cfg.max_cnt) {
+            /* Recycle the least recently reported target */
+            t = res->target_list.next;
+            pj_list_erase(t);
+            pj_hash_set(NULL, res->target_ht, t->key, t->key_len, 0, NULL);
+        } else {
+            t = PJ_POOL_ALLOC_T(res->cache_pool, struct target_entry);
+            ++res->target_cnt;
+        }
+
+        pj_bzero(t, sizeof(*t));
+        t->key_len = get_target_key(addr, t->key);
+        pj_hash_set_np(res->target_ht, t->key, t->key_len, 0, t->hbuf, t);
+    }
+    pj_list_push_back(&res->target_list, t);
+
+    if (failed) {
+        ++t->fail_cnt;
+        if (t->fail_cnt >= res->cache_cfg.fail_threshold) {
+            char addr_str[PJ_INET6_ADDRSTRLEN+10];
+
+            pj_gettickcount(&now);
+            t->down_until = now;
+            t->down_until.sec += res->cache_cfg.down_time;
+
+            PJ_LOG(4,(THIS_FILE, "Target %s is down after %d failure(s), "
+                      "last status %d",
+                      pj_sockaddr_print(addr, addr_str, sizeof(addr_str), 3),
+                      t->fail_cnt, code));
+        }
+    } else {
+        t->fail_cnt = 0;
+        t->down_until.sec = t->down_until.msec = 0;
+        if (rtt)
+            t->srtt = t->srtt ? (7 * t->srtt + rtt) / 8 : rtt;
+    }
+
+    pj_grp_lock_release(res->grp_lock);
+}
+
+
+/*
+ * Get the health information of a target address.
+ */
+PJ_DEF(pj_status_t) pjsip_resolver_get_target_info(
+                                        pjsip_resolver_t *res,
+                                        const pj_sockaddr_t *addr,
+                                        int addr_len,
+                                        pjsip_resolver_target_info *info)
+{
+    struct target_entry *t;
+    pj_time_val now;
+
+    PJ_ASSERT_RETURN(res && addr && addr_len > 0 && info, PJ_EINVAL);
+
+    pj_grp_lock_acquire(res->grp_lock);
+
+    t = res->cache_pool ? find_target(res, addr) : NULL;
+    if (!t) {
+        pj_grp_lock_release(res->grp_lock);
+        return PJ_ENOTFOUND;
+    }
+
+    pj_gettickcount(&now);
+    info->fail_cnt = t->fail_cnt;
+    info->is_down = is_target_down(res, t, &now);
+    info->rtt = t->srtt;
+
+    pj_grp_lock_release(res->grp_lock);
+
+    return PJ_SUCCESS;
+}
+
+#if PJSIP_HAS_RESOLVER
+
+/* Move entry at index src to index dst (dst <= src), keeping the order
+ * of the entries in between.
+ */
+static void move_entry(pjsip_server_addresses *srv, unsigned dst,
+                       unsigned src)
+{
+    pjsip_server_address_record tmp;
+
+    if (dst == src)
+        return;
+
+    pj_memcpy(&tmp, &srv->entry[src], sizeof(tmp));
+    pj_memmove(&srv->entry[dst+1], &srv->entry[dst],
+               (src - dst) * sizeof(tmp));
+    pj_memcpy(&srv->entry[dst], &tmp, sizeof(tmp));
+}
+
+
+/*
+ * Order the targets: by priority, then with RFC 2782 weighted random
+ * selection within the same priority, and put targets that are down at
+ * the end of the list. Resolver must be locked.
+ */
+static void order_targets(pjsip_resolver_t *res, pjsip_server_addresses *srv)
+{
+    unsigned i, j, k, n;
+    pj_time_val now;
+
+    /* Stable sort by priority */
+    for (i = 1; i < srv->count; ++i) {
+        for (j = i; j > 0 && srv->entry[j-1].priority >
+                             srv->entry[i].priority; --j)
+            ;
+        move_entry(srv, j, i);
+    }
+
+    for (i = 0; i < srv->count; i = j) {
+        unsigned sum = 0;
+
+        for (j = i; j < srv->count &&
+                    srv->entry[j].priority == srv->entry[i].priority; ++j)
+        {
+            sum += srv->entry[j].weight;
+        }
+
+        /* Zero weight entries go first, so they have small chance to be
+         * selected (RFC 2782).
+         */
+        for (k = i, n = i; k < j; ++k) {
+            if (srv->entry[k].weight == 0)
+                move_entry(srv, n++, k);
+        }
+
+        /* Weighted random selection */
+        for (k = i; k < j && sum > 0; ++k) {
+            unsigned r = (unsigned)pj_rand() % (sum + 1);
+            unsigned running = 0;
+
+            for (n = k; n < j - 1; ++n) {
+                running += srv->entry[n].weight;
+                if (running >= r)
+                    break;
+            }
+
+            sum -= srv->entry[n].weight;
+            move_entry(srv, k, n);
+        }
+    }
+
+    /* Put targets that are down at the end of the list */
+    if (res->target_cnt == 0)
+        return;
+
+    pj_gettickcount(&now);
+    for (i = 0, n = srv->count; i < n; ) {
+        struct target_entry *t = find_target(res, &srv->entry[i].addr);
+
+        if (is_target_down(res, t, &now)) {
+            pjsip_server_address_record tmp;
+
+            pj_memcpy(&tmp, &srv->entry[i], sizeof(tmp));
+            pj_memmove(&srv->entry[i], &srv->entry[i+1],
+                       (srv->count - i - 1) * sizeof(tmp));
+            pj_memcpy(&srv->entry[srv->count-1], &tmp, sizeof(tmp));
+            --n;
+        } else {
+            ++i;
+        }
+    }
+}
+
+
+/* Build the cache key of a resolution request */
+static void get_cache_key(pj_pool_t *pool, const pjsip_host_info *target,
+                          pjsip_transport_type_e type, pj_str_t *key)
+{
+    key->ptr = (char*)pj_pool_alloc(pool, target->addr.host.slen + 24);
+    key->slen = pj_ansi_snprintf(key->ptr, target->addr.host.slen + 24,
+                                 "%d:%d:", type, target->addr.port);
+    pj_memcpy(key->ptr + key->slen, target->addr.host.ptr,
+              target->addr.host.slen);
+    key->slen += target->addr.host.slen;
+}
+
+
+/* Look up the target set in the cache, and copy it to the application
+ * pool if it's found. Resolver must be locked.
+ */
+static pj_bool_t lookup_cache(pjsip_resolver_t *res, pj_pool_t *pool,
+                              const pj_str_t *key,
+                              pjsip_server_addresses *srv)
+{
+    struct cache_entry *e;
+    pj_time_val now;
+    unsigned i;
+
+    e = (struct cache_entry*)
+        pj_hash_get_lower(res->cache_ht, key->ptr, (unsigned)key->slen, NULL);
+    if (!e)
+        return PJ_FALSE;
+
+    pj_gettickcount(&now);
+    if (PJ_TIME_VAL_GTE(now, e->expiry)) {
+        remove_cache_entry(res, e);
+        return PJ_FALSE;
+    }
+
+    pj_memcpy(srv, &e->server, sizeof(*srv));
+    for (i = 0; i < srv->count; ++i)
+        pj_strdup(pool, &srv->entry[i].name, &e->server.entry[i].name);
+
+    /* Most recently used */
+    pj_list_erase(e);
+    pj_list_push_back(&res->cache_list, e);
+
+    order_targets(res, srv);
+
+    return PJ_TRUE;
+}
+
+
+/* Store the target set in the cache, resolver must be locked */
+static void store_cache(pjsip_resolver_t *res, const pj_str_t *key,
+                        const pjsip_server_addresses *srv)
+{
+    struct cache_entry *e;
+    pj_pool_t *pool;
+    unsigned i;
+
+    e = (struct cache_entry*)
+        pj_hash_get_lower(res->cache_ht, key->ptr, (unsigned)key->slen, NULL);
+    if (e)
+        remove_cache_entry(res, e);
+    else if (res->cache_cnt >= res->cache_cfg.max_cnt)
+        remove_cache_entry(res, res->cache_list.next);
+
+    pool = pj_pool_create(res->cache_pf, "rcentry%p", 512, 512, NULL);
+    if (!pool)
+        return;
+
+    e = PJ_POOL_ZALLOC_T(pool, struct cache_entry);
+    e->pool = pool;
+    pj_strdup(pool, &e->key, key);
+    pj_memcpy(&e->server, srv, sizeof(*srv));
+    for (i = 0; i < srv->count; ++i)
+        pj_strdup(pool, &e->server.entry[i].name, &srv->entry[i].name);
+
+    pj_gettickcount(&e->expiry);
+    e->expiry.sec += res->cache_cfg.ttl;
+
+    pj_hash_set_np_lower(res->cache_ht, e->key.ptr, (unsigned)e->key.slen, 0,
+                         e->hbuf, e);
+    pj_list_push_back(&res->cache_list, e);
+    ++res->cache_cnt;
+}
+
+
+/* Complete the query: update the cache and call the callback */
+static void query_complete(struct query *query, pj_status_t status,
+                           pjsip_server_addresses *srv)
+{
+    pjsip_resolver_t *res = query->resolver;
+
+    if (status == PJ_SUCCESS && query->cache_key.slen) {
+        pj_grp_lock_acquire(res->grp_lock);
+        if (res->cache_pool) {
+            if (res->cache_cfg.ttl)
+                store_cache(res, &query->cache_key, srv);
+            order_targets(res, srv);
+        }
+        pj_grp_lock_release(res->grp_lock);
+    }
+
+    (*query->cb)(status, query->token, status == PJ_SUCCESS ? srv : NULL);
+}
+
+#endif  /* PJSIP_HAS_RESOLVER */
+
 /*
  * Internal:
  *  determine if an address is a valid IP address, and if it is,
@@ -216,6 +702,9 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
     struct query *query;
     pjsip_transport_type_e type = target->type;
     int af = pj_AF_UNSPEC();
+#if PJSIP_HAS_RESOLVER
+    pj_str_t cache_key;
+#endif
 
     /* If an external implementation has been provided use it instead */
     if (resolver->ext_res) {
@@ -405,12 +894,38 @@ PJ_DEF(void) pjsip_resolve( pjsip_resolver_t *resolver,
     /* Target is not an IP address so we need to resolve it. */
 #if PJSIP_HAS_RESOLVER
 
+    /* Try the routing cache first */
+    cache_key.slen = 0;
+    if (resolver->cache_pool) {
+        pj_bool_t found = PJ_FALSE;
+
+        get_cache_key(pool, target, type, &cache_key);
+
+        pj_grp_lock_acquire(resolver->grp_lock);
+        if (resolver->cache_pool)
+            found = lookup_cache(resolver, pool, &cache_key, &svr_addr);
+        pj_grp_lock_release(resolver->grp_lock);
+
+        if (found) {
+            PJ_LOG(5,(THIS_FILE, "Target '%.*s:%d' type=%s resolved from "
+                      "routing cache, %d address(es)",
+                      (int)target->addr.host.slen, target->addr.host.ptr,
+                      target->addr.port,
+                      pjsip_transport_get_type_name(target->type),
+                      svr_addr.count));
+            (*cb)(PJ_SUCCESS, token, &svr_addr);
+            return;
+        }
+    }
+
     /* Build the query state */
     query = PJ_POOL_ZALLOC_T(pool, struct query);
     query->objname = THIS_FILE;
     query->token = token;
     query->cb = cb;
     query->grp_lock = resolver->grp_lock;
+    query->resolver = resolver;
+    query->cache_key = cache_key;
     query->req.target = *target;
     pj_strdup(pool, &query->req.target.addr.host, &target->addr.host);
 
@@ -595,9 +1110,9 @@ static void dns_a_callback(void *user_data,
     /* Call the callback if all DNS queries have been completed */
     if (query->object == NULL && query->object6 == NULL) {
         if (srv->count > 0)
-            (*query->cb)(PJ_SUCCESS, query->token, &query->server);
+            query_complete(query, PJ_SUCCESS, &query->server);
         else
-            (*query->cb)(query->last_error, query->token, NULL);
+            query_complete(query, query->last_error, NULL);
     }
 
     pj_grp_lock_release(query->grp_lock);
@@ -659,9 +1174,9 @@ static void dns_aaaa_callback(void *user_data,
     /* Call the callback if all DNS queries have been completed */
     if (query->object == NULL && query->object6 == NULL) {
         if (srv->count > 0)
-            (*query->cb)(PJ_SUCCESS, query->token, &query->server);
+            query_complete(query, PJ_SUCCESS, &query->server);
         else
-            (*query->cb)(query->last_error, query->token, NULL);
+            query_complete(query, query->last_error, NULL);
     }
 
     pj_grp_lock_release(query->grp_lock);
@@ -682,7 +1197,7 @@ static void srv_resolver_cb(void *user_data,
                      "DNS A/AAAA record resolution failed"));
 
         /* Call the callback */
-        (*query->cb)(status, query->token, NULL);
+        query_complete(query, status, NULL);
         return;
     }
 
@@ -718,7 +1233,7 @@ static void srv_resolver_cb(void *user_data,
     }
 
     /* Call the callback */
-    (*query->cb)(PJ_SUCCESS, query->token, &srv);
+    query_complete(query, PJ_SUCCESS, &srv);
 }
 
 #endif  /* PJSIP_HAS_RESOLVER */
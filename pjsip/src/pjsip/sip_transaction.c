@@ -23,6 +23,7 @@
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_event.h>
 #include <pjlib-util/errno.h>
+#include <pjlib-util/metrics.h>
 #include <pj/hash.h>
 #include <pj/pool.h>
 #include <pj/os.h>
@@ -40,13 +41,6 @@
 #define TSX_TRACE_(expr)
 #endif
 
-/* When this macro is set, transaction will keep the hashed value
- * so that future lookup (to unregister transaction) does not need
- * to recalculate the hash again. It should gains a little bit of
- * performance, so generally we'd want this.
- */
-#define PRECALC_HASH
-
 
 /* Defined in sip_util_statefull.c */
 extern pjsip_module mod_stateful_util;
@@ -66,15 +60,65 @@ static pj_status_t mod_tsx_layer_unload(void);
 static pj_bool_t   mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata);
 static pj_bool_t   mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata);
 
+/* Partition of the transaction table. A transaction is put in the
+ * partition selected by the hash of its key, and in the partition selected
+ * by the hash of its secondary key for htable2.
+ */
+typedef struct tsx_shard
+{
+    pj_mutex_t          *mutex;
+    pj_hash_table_t     *htable;
+    pj_hash_table_t     *htable2;
+} tsx_shard;
+
+/* State of a transaction's entry in the retransmission wheel */
+enum
+{
+    RETRANS_IDLE,       /* Not scheduled in the wheel.                      */
+    RETRANS_QUEUED,     /* Queued in a bucket.                              */
+    RETRANS_FIRING      /* Removed from the bucket by a sweep, and about to
+                           be dispatched to the transaction.                */
+};
+
+/* Entry of a transaction in the retransmission wheel */
+typedef struct pjsip_tsx_retrans
+{
+    PJ_DECL_LIST_MEMBER(struct pjsip_tsx_retrans);
+    pjsip_transaction   *tsx;
+    pj_time_val          due;
+    int                  state;
+} tsx_retrans;
+
+/* Bucket of the retransmission wheel. All entries in a bucket have the
+ * same interval, so appending them keeps the list sorted by due time and
+ * only the head needs a timer.
+ */
+typedef struct retrans_bucket
+{
+    unsigned             msec;      /* Interval, zero if bucket is free.    */
+    tsx_retrans          list;      /* Queued entries, by due time.         */
+    pj_timer_entry       timer;     /* Timer for the head, id is non-zero
+                                       while it is scheduled or a sweep is
+                                       in progress.                         */
+} retrans_bucket;
+
 /* Transaction layer module definition. */
 static struct mod_tsx_layer
 {
     struct pjsip_module  mod;
     pj_pool_t           *pool;
     pjsip_endpoint      *endpt;
-    pj_mutex_t          *mutex;
-    pj_hash_table_t     *htable;
-    pj_hash_table_t     *htable2;
+    tsx_shard            shard[PJSIP_TSX_TABLE_SHARD_CNT];
+
+    /* Retransmission wheel */
+    pj_mutex_t          *retrans_mutex;
+    retrans_bucket       retrans_bucket[PJSIP_TSX_RETRANS_BUCKET_CNT];
+
+    /* Metrics, registered in the default registry */
+    pj_metrics          *metrics;
+    pj_metric           *m_created;
+    pj_metric           *m_timeout;
+    pj_metric           *m_count;
 } mod_tsx_layer = 
 {   {
         NULL, NULL,                     /* List's prev and next.    */
@@ -172,6 +216,8 @@ static pj_status_t tsx_on_state_destroyed(      pjsip_transaction *tsx,
                                                 pjsip_event *event);
 static void        tsx_timer_callback( pj_timer_heap_t *theap, 
                                        pj_timer_entry *entry);
+static void        retrans_bucket_callback( pj_timer_heap_t *theap,
+                                            pj_timer_entry *entry);
 static void        tsx_tp_state_callback(
                                        pjsip_transport *tp,
                                        pjsip_transport_state state,
@@ -194,6 +240,9 @@ static int         tsx_send_msg( pjsip_transaction *tsx,
                                  pjsip_tx_data *tdata);
 static void        tsx_update_transport( pjsip_transaction *tsx, 
                                          pjsip_transport *tp);
+static void        tsx_report_target( pjsip_transaction *tsx,
+                                      const pj_sockaddr *addr,
+                                      int addr_len, int code);
 
 
 /* State handlers for UAC, indexed by state */
@@ -497,9 +546,102 @@ PJ_DEF(void) pjsip_tsx_set_max_retransmit_count(int max)
 /*
  * Create transaction layer module and registers it to the endpoint.
  */
+/* Get the partition for the key with the specified hash value. The low
+ * bits of the hash value select the bucket inside the partition's hash
+ * table, so use the top bits of a multiplicative hash of all bits, to keep
+ * the buckets of each partition evenly used.
+ */
+static tsx_shard *get_shard(pj_uint32_t hval)
+{
+    return &mod_tsx_layer.shard[((pj_uint32_t)(hval * 0x9E3779B1U) >> 16) %
+                                PJSIP_TSX_TABLE_SHARD_CNT];
+}
+
+/* Get the number of transactions in all partitions */
+static unsigned get_tsx_count(void)
+{
+    unsigned i, count = 0;
+
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+        tsx_shard *shard = &mod_tsx_layer.shard[i];
+
+        pj_mutex_lock(shard->mutex);
+        count += pj_hash_count(shard->htable);
+        pj_mutex_unlock(shard->mutex);
+    }
+
+    return count;
+}
+
+/* Destroy the mutexes of the partitions */
+static void destroy_shards(void)
+{
+    unsigned i;
+
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+        if (mod_tsx_layer.shard[i].mutex) {
+            pj_mutex_destroy(mod_tsx_layer.shard[i].mutex);
+            mod_tsx_layer.shard[i].mutex = NULL;
+        }
+    }
+}
+
+/* Cancel the timers of the retransmission wheel and destroy its mutex */
+static void destroy_retrans_wheel(void)
+{
+    pj_timer_heap_t *timer_heap;
+    unsigned i;
+
+    if (!mod_tsx_layer.retrans_mutex)
+        return;
+
+    timer_heap = pjsip_endpt_get_timer_heap(mod_tsx_layer.endpt);
+    for (i=0; i<PJSIP_TSX_RETRANS_BUCKET_CNT; ++i) {
+        pj_timer_heap_cancel_if_active(timer_heap,
+                                       &mod_tsx_layer.retrans_bucket[i].timer,
+                                       0);
+    }
+
+    pj_mutex_destroy(mod_tsx_layer.retrans_mutex);
+    mod_tsx_layer.retrans_mutex = NULL;
+}
+
+/* Update the transaction count gauge when the metrics are rendered */
+static void tsx_layer_collect_metrics(pj_metrics *metrics, void *user_data)
+{
+    PJ_UNUSED_ARG(metrics);
+    PJ_UNUSED_ARG(user_data);
+
+    pj_metric_set(mod_tsx_layer.m_count, get_tsx_count());
+}
+
+/* Register the metrics of transaction layer to the default registry */
+static void tsx_layer_init_metrics(void)
+{
+    pj_metrics *metrics = pj_metrics_get_default();
+
+    mod_tsx_layer.metrics = metrics;
+    mod_tsx_layer.m_created = mod_tsx_layer.m_timeout = NULL;
+    mod_tsx_layer.m_count = NULL;
+    if (!metrics)
+        return;
+
+    pj_metrics_add_counter(metrics, "pjsip_tsx_created_total",
+                           "Number of transactions created",
+                           &mod_tsx_layer.m_created);
+    pj_metrics_add_counter(metrics, "pjsip_tsx_timeout_total",
+                           "Number of transactions terminated with timeout",
+                           &mod_tsx_layer.m_timeout);
+    pj_metrics_add_gauge(metrics, "pjsip_tsx_count",
+                         "Number of transactions in the table",
+                         &mod_tsx_layer.m_count);
+    pj_metrics_add_collector(metrics, &tsx_layer_collect_metrics, NULL);
+}
+
 PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
 {
     pj_pool_t *pool;
+    unsigned i, max_count;
     pj_status_t status;
 
 
@@ -528,31 +670,58 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
     mod_tsx_layer.endpt = endpt;
 
 
-    /* Create hash table. */
-    mod_tsx_layer.htable = pj_hash_create( pool, pjsip_cfg()->tsx.max_count );
-    mod_tsx_layer.htable2 = pj_hash_create(pool, pjsip_cfg()->tsx.max_count);
-    if (!mod_tsx_layer.htable || !mod_tsx_layer.htable2) {
-        pjsip_endpt_release_pool(endpt, pool);
-        return PJ_ENOMEM;
+    /* Create hash table and mutex of each partition. */
+    max_count = pjsip_cfg()->tsx.max_count / PJSIP_TSX_TABLE_SHARD_CNT;
+    pj_bzero(mod_tsx_layer.shard, sizeof(mod_tsx_layer.shard));
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+        tsx_shard *shard = &mod_tsx_layer.shard[i];
+
+        shard->htable = pj_hash_create(pool, max_count);
+        shard->htable2 = pj_hash_create(pool, max_count);
+        if (!shard->htable || !shard->htable2) {
+            destroy_shards();
+            pjsip_endpt_release_pool(endpt, pool);
+            return PJ_ENOMEM;
+        }
+
+        status = pj_mutex_create_recursive(pool, "tsxlayer%p",
+                                           &shard->mutex);
+        if (status != PJ_SUCCESS) {
+            destroy_shards();
+            pjsip_endpt_release_pool(endpt, pool);
+            return status;
+        }
     }
 
-    /* Create group lock. */
-    status = pj_mutex_create_recursive(pool, "tsxlayer", &mod_tsx_layer.mutex);
+    /* Create the retransmission wheel. */
+    status = pj_mutex_create_simple(pool, "tsxretrans",
+                                    &mod_tsx_layer.retrans_mutex);
     if (status != PJ_SUCCESS) {
+        destroy_shards();
         pjsip_endpt_release_pool(endpt, pool);
         return status;
     }
+    for (i=0; i<PJSIP_TSX_RETRANS_BUCKET_CNT; ++i) {
+        retrans_bucket *b = &mod_tsx_layer.retrans_bucket[i];
+
+        b->msec = 0;
+        pj_list_init(&b->list);
+        pj_timer_entry_init(&b->timer, 0, b, &retrans_bucket_callback);
+    }
 
     /*
      * Register transaction layer module to endpoint.
      */
     status = pjsip_endpt_register_module( endpt, &mod_tsx_layer.mod );
     if (status != PJ_SUCCESS) {
-        pj_mutex_destroy(mod_tsx_layer.mutex);
+        destroy_retrans_wheel();
+        destroy_shards();
         pjsip_endpt_release_pool(endpt, pool);
         return status;
     }
 
+    tsx_layer_init_metrics();
+
     /* Register mod_stateful_util module (sip_util_statefull.c) */
     status = pjsip_endpt_register_module(endpt, &mod_stateful_util);
     if (status != PJ_SUCCESS) {
@@ -593,21 +762,24 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_destroy(void)
  */
 static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
 {
+    tsx_shard *shard;
+
     pj_assert(tsx->transaction_key.slen != 0);
 
     /* Lock hash table mutex. */
-    pj_mutex_lock(mod_tsx_layer.mutex);
+    shard = get_shard(tsx->hashed_key);
+    pj_mutex_lock(shard->mutex);
 
     /* Check if no transaction with the same key exists. 
      * Do not use PJ_ASSERT_RETURN since it evaluates the expression
      * twice!
      */
-    if(pj_hash_get_lower(mod_tsx_layer.htable, 
+    if(pj_hash_get_lower(shard->htable, 
                          tsx->transaction_key.ptr,
                          (unsigned)tsx->transaction_key.slen, 
-                         NULL))
+                         &tsx->hashed_key))
     {
-        pj_mutex_unlock(mod_tsx_layer.mutex);
+        pj_mutex_unlock(shard->mutex);
         PJ_LOG(2,(THIS_FILE, 
                   "Unable to register %.*s transaction (key exists)",
                   (int)tsx->method.name.slen,
@@ -622,32 +794,26 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
 
     /* Register the transaction to the hash tables. We register the tsx
      * to the secondary hash table only if it's UAS, for the purpose of
-     * detecting merged requests.
+     * detecting merged requests. The secondary key may belong to another
+     * partition, only one partition is locked at a time.
      */
-#ifdef PRECALC_HASH
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
+    pj_hash_set_lower( tsx->pool, shard->htable,
                        tsx->transaction_key.ptr,
                        (unsigned)tsx->transaction_key.slen, 
                        tsx->hashed_key, tsx);
+
+    /* Unlock mutex. */
+    pj_mutex_unlock(shard->mutex);
+
     if (tsx->role == PJSIP_ROLE_UAS) {
-        pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable2,
+        shard = get_shard(tsx->hashed_key2);
+        pj_mutex_lock(shard->mutex);
+        pj_hash_set_lower( tsx->pool, shard->htable2,
                            tsx->transaction_key2.ptr,
                            (unsigned)tsx->transaction_key2.slen,
                            tsx->hashed_key2, tsx);
+        pj_mutex_unlock(shard->mutex);
     }
-#else
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
-                       tsx->transaction_key.ptr,
-                       tsx->transaction_key.slen, 0, tsx);
-    if (tsx->role == PJSIP_ROLE_UAS) {
-        pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable2,
-                           tsx->transaction_key2.ptr,
-                           tsx->transaction_key2.slen, 0, tsx);
-    }
-#endif
-
-    /* Unlock mutex. */
-    pj_mutex_unlock(mod_tsx_layer.mutex);
 
     return PJ_SUCCESS;
 }
@@ -658,6 +824,8 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
  */
 static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
 {
+    tsx_shard *shard;
+
     if (mod_tsx_layer.mod.id == -1) {
         /* The transaction layer has been unregistered. This could happen
          * if the transaction was pending on transport and the application
@@ -670,37 +838,28 @@ static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
     pj_assert(tsx->transaction_key.slen != 0);
     //pj_assert(tsx->state != PJSIP_TSX_STATE_NULL);
 
-    /* Lock hash table mutex. */
-    pj_mutex_lock(mod_tsx_layer.mutex);
-
     /* Unregister the transaction from the hash tables. */
-#ifdef PRECALC_HASH
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
+    shard = get_shard(tsx->hashed_key);
+    pj_mutex_lock(shard->mutex);
+    pj_hash_set_lower( NULL, shard->htable, tsx->transaction_key.ptr,
                        (unsigned)tsx->transaction_key.slen, tsx->hashed_key,
                        NULL);
+    pj_mutex_unlock(shard->mutex);
+
     if (tsx->role == PJSIP_ROLE_UAS) {
-        pj_hash_set_lower(NULL, mod_tsx_layer.htable2,
+        shard = get_shard(tsx->hashed_key2);
+        pj_mutex_lock(shard->mutex);
+        pj_hash_set_lower(NULL, shard->htable2,
                           tsx->transaction_key2.ptr,
                           (unsigned)tsx->transaction_key2.slen,
                           tsx->hashed_key2, NULL);
+        pj_mutex_unlock(shard->mutex);
     }
-#else
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
-                       tsx->transaction_key.slen, 0, NULL);
-    if (tsx->role == PJSIP_ROLE_UAS) {
-        pj_hash_set_lower(NULL, mod_tsx_layer.htable2,
-                          tsx->transaction_key2.ptr,
-                          tsx->transaction_key2.slen, 0, NULL);
-    }
-#endif
 
     TSX_TRACE_((THIS_FILE, 
                 "Transaction %p unregistered, hkey=0x%p and key=%.*s",
                 tsx, tsx->hashed_key, tsx->transaction_key.slen,
                 tsx->transaction_key.ptr));
-
-    /* Unlock mutex. */
-    pj_mutex_unlock(mod_tsx_layer.mutex);
 }
 
 
@@ -715,9 +874,7 @@ PJ_DEF(unsigned) pjsip_tsx_layer_get_tsx_count(void)
     /* Are we registered? */
     PJ_ASSERT_RETURN(mod_tsx_layer.endpt!=NULL, 0);
 
-    pj_mutex_lock(mod_tsx_layer.mutex);
-    count = pj_hash_count(mod_tsx_layer.htable);
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    count = get_tsx_count();
 
     return count;
 }
@@ -730,11 +887,15 @@ static pjsip_transaction* find_tsx( const pj_str_t *key, pj_bool_t lock,
                                     pj_bool_t add_ref )
 {
     pjsip_transaction *tsx;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
+    tsx_shard *shard;
+
+    hval = pj_hash_calc_tolower(0, NULL, key);
+    shard = get_shard(hval);
 
-    pj_mutex_lock(mod_tsx_layer.mutex);
+    pj_mutex_lock(shard->mutex);
     tsx = (pjsip_transaction*)
-          pj_hash_get_lower( mod_tsx_layer.htable, key->ptr, 
+          pj_hash_get_lower( shard->htable, key->ptr, 
                              (unsigned)key->slen, &hval );
     
     /* Prevent the transaction to get deleted before we have chance to lock it.
@@ -742,7 +903,7 @@ static pjsip_transaction* find_tsx( const pj_str_t *key, pj_bool_t lock,
     if (tsx)
         pj_grp_lock_add_ref(tsx->grp_lock);
     
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     TSX_TRACE_((THIS_FILE, 
                 "Finding tsx with hkey=0x%p and key=%.*s: found %p",
@@ -802,27 +963,39 @@ static pj_status_t mod_tsx_layer_start(void)
 static pj_status_t mod_tsx_layer_stop(void)
 {
     pj_hash_iterator_t it_buf, *it;
+    unsigned i;
 
     PJ_LOG(4,(THIS_FILE, "Stopping transaction layer module"));
 
-    pj_mutex_lock(mod_tsx_layer.mutex);
+    /* Destroy all transactions. Each transaction is taken from the table
+     * with the partition lock held, and destroyed after the lock is
+     * released, since unregistering it locks the partition of its
+     * secondary key.
+     */
+    for (i=0; i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+        tsx_shard *shard = &mod_tsx_layer.shard[i];
+
+        for (;;) {
+            pjsip_transaction *tsx = NULL;
+
+            pj_mutex_lock(shard->mutex);
+            it = pj_hash_first(shard->htable, &it_buf);
+            if (it) {
+                tsx = (pjsip_transaction*) pj_hash_this(shard->htable, it);
+                pj_grp_lock_add_ref(tsx->grp_lock);
+            }
+            pj_mutex_unlock(shard->mutex);
+
+            if (!tsx)
+                break;
 
-    /* Destroy all transactions. */
-    it = pj_hash_first(mod_tsx_layer.htable, &it_buf);
-    while (it) {
-        pjsip_transaction *tsx = (pjsip_transaction*) 
-                                 pj_hash_this(mod_tsx_layer.htable, it);
-        pj_hash_iterator_t *next = pj_hash_next(mod_tsx_layer.htable, it);
-        if (tsx) {
             pjsip_tsx_terminate(tsx, PJSIP_SC_SERVICE_UNAVAILABLE);
             mod_tsx_layer_unregister_tsx(tsx);
             tsx_shutdown(tsx);
+            pj_grp_lock_dec_ref(tsx->grp_lock);
         }
-        it = next;
     }
 
-    pj_mutex_unlock(mod_tsx_layer.mutex);
-
     PJ_LOG(4,(THIS_FILE, "Stopped transaction layer module"));
 
     return PJ_SUCCESS;
@@ -834,8 +1007,15 @@ static void tsx_layer_destroy(pjsip_endpoint *endpt)
 {
     PJ_UNUSED_ARG(endpt);
 
-    /* Destroy mutex. */
-    pj_mutex_destroy(mod_tsx_layer.mutex);
+    if (mod_tsx_layer.metrics) {
+        pj_metrics_remove_collector(mod_tsx_layer.metrics,
+                                    &tsx_layer_collect_metrics, NULL);
+        mod_tsx_layer.metrics = NULL;
+    }
+
+    /* Destroy mutexes. */
+    destroy_retrans_wheel();
+    destroy_shards();
 
     /* Release pool. */
     pjsip_endpt_release_pool(mod_tsx_layer.endpt, mod_tsx_layer.pool);
@@ -858,7 +1038,7 @@ static pj_status_t mod_tsx_layer_unload(void)
      * crash when the pending transaction finally got error response
      * from transport and when it tries to unregister itself.
      */
-    if (pj_hash_count(mod_tsx_layer.htable) != 0) {
+    if (get_tsx_count() != 0) {
         pj_status_t status;
         status = pjsip_endpt_atexit(mod_tsx_layer.endpt, &tsx_layer_destroy);
         if (status != PJ_SUCCESS) {
@@ -879,8 +1059,9 @@ PJ_DEF(pjsip_transaction *)
 pjsip_tsx_detect_merged_requests(pjsip_rx_data *rdata)
 {
     pj_str_t key, key2;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
     pjsip_transaction *tsx = NULL;
+    tsx_shard *shard;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(rdata->msg_info.msg->type == PJSIP_REQUEST_MSG, NULL);
@@ -896,34 +1077,37 @@ pjsip_tsx_detect_merged_requests(pjsip_rx_data *rdata)
     if (status != PJ_SUCCESS)
         return NULL;
 
-    pj_mutex_lock( mod_tsx_layer.mutex );
+    hval = pj_hash_calc_tolower(0, NULL, &key);
+    shard = get_shard(hval);
+    pj_mutex_lock( shard->mutex );
 
     /* This request must not match any transaction in our primary hash
      * table.
      */
-    if (pj_hash_get_lower(mod_tsx_layer.htable, key.ptr, (unsigned)key.slen,
+    if (pj_hash_get_lower(shard->htable, key.ptr, (unsigned)key.slen,
                           &hval) != NULL)
     {
-        pj_mutex_unlock( mod_tsx_layer.mutex);
+        pj_mutex_unlock( shard->mutex);
         return NULL;
     }
 
+    pj_mutex_unlock( shard->mutex);
+
     /* Now check it against our secondary hash table, based on a key that
      * consists of From tag, CSeq, and Call-ID.
      */
     status = create_tsx_key_2543(rdata->tp_info.pool, &key2, PJSIP_ROLE_UAS,
                                  &rdata->msg_info.cseq->method, rdata,
                                  PJ_FALSE);
-    if (status != PJ_SUCCESS) {
-        pj_mutex_unlock( mod_tsx_layer.mutex);
+    if (status != PJ_SUCCESS)
         return NULL;
-    }
 
-    hval = 0;
-    tsx = pj_hash_get_lower(mod_tsx_layer.htable2, key2.ptr,
+    hval = pj_hash_calc_tolower(0, NULL, &key2);
+    shard = get_shard(hval);
+    pj_mutex_lock( shard->mutex );
+    tsx = pj_hash_get_lower(shard->htable2, key2.ptr,
                             (unsigned)key2.slen, &hval);
-
-    pj_mutex_unlock( mod_tsx_layer.mutex);
+    pj_mutex_unlock( shard->mutex);
 
     return tsx;
 }
@@ -934,17 +1118,20 @@ pjsip_tsx_detect_merged_requests(pjsip_rx_data *rdata)
 static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
 {
     pj_str_t key;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
     pjsip_transaction *tsx;
+    tsx_shard *shard;
 
     pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_ROLE_UAS,
                          &rdata->msg_info.cseq->method, rdata);
 
     /* Find transaction. */
-    pj_mutex_lock( mod_tsx_layer.mutex );
+    hval = pj_hash_calc_tolower(0, NULL, &key);
+    shard = get_shard(hval);
+    pj_mutex_lock( shard->mutex );
 
     tsx = (pjsip_transaction*) 
-          pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+          pj_hash_get_lower( shard->htable, key.ptr, (unsigned)key.slen, 
                              &hval );
 
 
@@ -958,7 +1145,7 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
          * Reject the request so that endpoint passes the request to
          * upper layer modules.
          */
-        pj_mutex_unlock( mod_tsx_layer.mutex);
+        pj_mutex_unlock( shard->mutex);
         return PJ_FALSE;
     }
 
@@ -970,7 +1157,7 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
         tsx->method.id == PJSIP_INVITE_METHOD &&
         tsx->status_code/100 == 2)
     {
-        pj_mutex_unlock( mod_tsx_layer.mutex);
+        pj_mutex_unlock( shard->mutex);
         return PJ_FALSE;
     }
 
@@ -980,7 +1167,7 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
     pj_grp_lock_add_ref(tsx->grp_lock);
     
     /* Unlock hash table. */
-    pj_mutex_unlock( mod_tsx_layer.mutex );
+    pj_mutex_unlock( shard->mutex );
 
     /* Simulate race condition! */
     PJ_RACE_ME(5);
@@ -1000,17 +1187,20 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
 static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
 {
     pj_str_t key;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
     pjsip_transaction *tsx;
+    tsx_shard *shard;
 
     pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_ROLE_UAC,
                          &rdata->msg_info.cseq->method, rdata);
 
     /* Find transaction. */
-    pj_mutex_lock( mod_tsx_layer.mutex );
+    hval = pj_hash_calc_tolower(0, NULL, &key);
+    shard = get_shard(hval);
+    pj_mutex_lock( shard->mutex );
 
     tsx = (pjsip_transaction*) 
-          pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+          pj_hash_get_lower( shard->htable, key.ptr, (unsigned)key.slen, 
                              &hval );
 
 
@@ -1024,7 +1214,7 @@ static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
          * Reject the request so that endpoint passes the request to
          * upper layer modules.
          */
-        pj_mutex_unlock( mod_tsx_layer.mutex);
+        pj_mutex_unlock( shard->mutex);
         return PJ_FALSE;
     }
 
@@ -1034,7 +1224,7 @@ static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
     pj_grp_lock_add_ref(tsx->grp_lock);
 
     /* Unlock hash table. */
-    pj_mutex_unlock( mod_tsx_layer.mutex );
+    pj_mutex_unlock( shard->mutex );
 
     /* Simulate race condition! */
     PJ_RACE_ME(5);
@@ -1065,38 +1255,42 @@ PJ_DEF(void) pjsip_tsx_layer_dump(pj_bool_t detail)
 {
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_hash_iterator_t itbuf, *it;
+    unsigned i, count;
 
-    /* Lock mutex. */
-    pj_mutex_lock(mod_tsx_layer.mutex);
+    count = get_tsx_count();
 
     PJ_LOG(3, (THIS_FILE, "Dumping transaction table:"));
-    PJ_LOG(3, (THIS_FILE, " Total %d transactions", 
-                          pj_hash_count(mod_tsx_layer.htable)));
+    PJ_LOG(3, (THIS_FILE, " Total %d transactions", count));
 
-    if (detail) {
-        it = pj_hash_first(mod_tsx_layer.htable, &itbuf);
-        if (it == NULL) {
-            PJ_LOG(3, (THIS_FILE, " - none - "));
-        } else {
-            while (it != NULL) {
-                pjsip_transaction *tsx = (pjsip_transaction*) 
-                                         pj_hash_this(mod_tsx_layer.htable,it);
-
-                PJ_LOG(3, (THIS_FILE, " %s %s|%d|%s",
-                           tsx->obj_name,
-                           (tsx->last_tx? 
-                                pjsip_tx_data_get_info(tsx->last_tx): 
-                                "none"),
-                           tsx->status_code,
-                           pjsip_tsx_state_str(tsx->state)));
-
-                it = pj_hash_next(mod_tsx_layer.htable, it);
-            }
-        }
+    if (detail && count == 0) {
+        PJ_LOG(3, (THIS_FILE, " - none - "));
     }
 
-    /* Unlock mutex. */
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    for (i=0; detail && i<PJSIP_TSX_TABLE_SHARD_CNT; ++i) {
+        tsx_shard *shard = &mod_tsx_layer.shard[i];
+
+        /* Lock mutex. */
+        pj_mutex_lock(shard->mutex);
+
+        it = pj_hash_first(shard->htable, &itbuf);
+        while (it != NULL) {
+            pjsip_transaction *tsx = (pjsip_transaction*) 
+                                     pj_hash_this(shard->htable, it);
+
+            PJ_LOG(3, (THIS_FILE, " %s %s|%d|%s",
+                       tsx->obj_name,
+                       (tsx->last_tx? 
+                            pjsip_tx_data_get_info(tsx->last_tx): 
+                            "none"),
+                       tsx->status_code,
+                       pjsip_tsx_state_str(tsx->state)));
+
+            it = pj_hash_next(shard->htable, it);
+        }
+
+        /* Unlock mutex. */
+        pj_mutex_unlock(shard->mutex);
+    }
 #endif
 }
 
@@ -1143,6 +1337,227 @@ static int tsx_cancel_timer(pjsip_transaction *tsx,
     return pj_timer_heap_cancel_if_active(timer_heap, entry, TIMER_INACTIVE);
 }
 
+/* Schedule the bucket timer for the head of the bucket, or release the
+ * bucket if it is empty. The wheel must be locked.
+ */
+static void retrans_bucket_sched(retrans_bucket *b, const pj_time_val *now)
+{
+    pj_timer_heap_t *timer_heap = pjsip_endpt_get_timer_heap(
+                                                    mod_tsx_layer.endpt);
+    pj_time_val delay;
+    pj_status_t status;
+
+    if (pj_list_empty(&b->list)) {
+        b->timer.id = 0;
+        b->msec = 0;
+        return;
+    }
+
+    delay = b->list.next->due;
+    PJ_TIME_VAL_SUB(delay, *now);
+    if (delay.sec < 0 || delay.msec < 0)
+        delay.sec = delay.msec = 0;
+
+    b->timer.id = 1;
+    status = pj_timer_heap_schedule(timer_heap, &b->timer, &delay);
+    if (status != PJ_SUCCESS) {
+        PJ_PERROR(2,(THIS_FILE, status, "Error scheduling retransmission "
+                     "wheel timer"));
+        b->timer.id = 0;
+    }
+}
+
+/* Queue the retransmission timer of the transaction in the retransmission
+ * wheel. Returns non-success if there is no bucket for the interval, in
+ * which case the timer heap should be used.
+ */
+static pj_status_t retrans_wheel_schedule(pjsip_transaction *tsx,
+                                          const pj_time_val *delay)
+{
+    tsx_retrans *r = tsx->retrans;
+    retrans_bucket *b = NULL, *free_b = NULL;
+    unsigned i, msec;
+
+    msec = (unsigned)PJ_TIME_VAL_MSEC(*delay);
+    if (msec == 0)
+        return PJ_EINVAL;
+
+    pj_mutex_lock(mod_tsx_layer.retrans_mutex);
+
+    for (i=0; i<PJSIP_TSX_RETRANS_BUCKET_CNT; ++i) {
+        retrans_bucket *bi = &mod_tsx_layer.retrans_bucket[i];
+
+        if (bi->msec == msec) {
+            b = bi;
+            break;
+        } else if (bi->msec == 0 && bi->timer.id == 0 && !free_b) {
+            free_b = bi;
+        }
+    }
+
+    if (!b) {
+        if (!free_b) {
+            pj_mutex_unlock(mod_tsx_layer.retrans_mutex);
+            return PJ_ETOOMANY;
+        }
+        b = free_b;
+        b->msec = msec;
+    }
+
+    /* Each queued entry holds a reference to the transaction, as a
+     * scheduled timer does.
+     */
+    if (r->state == RETRANS_QUEUED)
+        pj_list_erase(r);
+    else
+        pj_grp_lock_add_ref(tsx->grp_lock);
+
+    pj_gettickcount(&r->due);
+    PJ_TIME_VAL_ADD(r->due, *delay);
+    r->state = RETRANS_QUEUED;
+    pj_list_push_back(&b->list, r);
+
+    /* Otherwise the timer is scheduled, or the running sweep will
+     * schedule it.
+     */
+    if (b->timer.id == 0) {
+        pj_time_val now;
+
+        pj_gettickcount(&now);
+        retrans_bucket_sched(b, &now);
+    }
+
+    pj_mutex_unlock(mod_tsx_layer.retrans_mutex);
+
+    return PJ_SUCCESS;
+}
+
+/* Remove the transaction from the retransmission wheel. */
+static void retrans_wheel_cancel(pjsip_transaction *tsx)
+{
+    tsx_retrans *r = tsx->retrans;
+    pj_bool_t queued;
+
+    pj_mutex_lock(mod_tsx_layer.retrans_mutex);
+    queued = (r->state == RETRANS_QUEUED);
+    if (queued)
+        pj_list_erase(r);
+
+    /* A firing entry is released by the sweep */
+    r->state = RETRANS_IDLE;
+    pj_mutex_unlock(mod_tsx_layer.retrans_mutex);
+
+    if (queued)
+        pj_grp_lock_dec_ref(tsx->grp_lock);
+}
+
+/* Dispatch retransmission timer event of an entry collected by a sweep */
+static void retrans_wheel_fire(tsx_retrans *r)
+{
+    pjsip_transaction *tsx = r->tsx;
+    pj_bool_t fire;
+
+    pj_grp_lock_acquire(tsx->grp_lock);
+
+    /* The entry may have been cancelled or rescheduled meanwhile */
+    pj_mutex_lock(mod_tsx_layer.retrans_mutex);
+    fire = (r->state == RETRANS_FIRING);
+    if (fire)
+        r->state = RETRANS_IDLE;
+    pj_mutex_unlock(mod_tsx_layer.retrans_mutex);
+
+    if (fire && tsx->state < PJSIP_TSX_STATE_DESTROYED) {
+        pjsip_event event;
+
+        PJ_LOG(5,(tsx->obj_name, "Retransmit timer event"));
+        pj_log_push_indent();
+
+        PJSIP_EVENT_INIT_TIMER(event, &tsx->retransmit_timer);
+        (*tsx->state_handler)(tsx, &event);
+
+        pj_log_pop_indent();
+    }
+
+    pj_grp_lock_release(tsx->grp_lock);
+
+    /* Release the reference held while the entry was queued */
+    pj_grp_lock_dec_ref(tsx->grp_lock);
+}
+
+/* Bucket timer callback: collect the entries that are due in batches,
+ * then dispatch them.
+ */
+static void retrans_bucket_callback(pj_timer_heap_t *theap,
+                                    pj_timer_entry *entry)
+{
+    retrans_bucket *b = (retrans_bucket*) entry->user_data;
+    tsx_retrans *batch[PJSIP_TSX_RETRANS_BATCH_SIZE];
+    unsigned i, cnt;
+
+    PJ_UNUSED_ARG(theap);
+
+    do {
+        pj_time_val now;
+
+        pj_gettickcount(&now);
+        cnt = 0;
+
+        pj_mutex_lock(mod_tsx_layer.retrans_mutex);
+        while (cnt < PJ_ARRAY_SIZE(batch) && !pj_list_empty(&b->list) &&
+               PJ_TIME_VAL_LTE(b->list.next->due, now))
+        {
+            tsx_retrans *r = b->list.next;
+
+            pj_list_erase(r);
+            r->state = RETRANS_FIRING;
+            batch[cnt++] = r;
+        }
+
+        /* Reschedule when the bucket has been swept */
+        if (cnt < PJ_ARRAY_SIZE(batch))
+            retrans_bucket_sched(b, &now);
+        pj_mutex_unlock(mod_tsx_layer.retrans_mutex);
+
+        for (i=0; i<cnt; ++i)
+            retrans_wheel_fire(batch[i]);
+
+    } while (cnt == PJ_ARRAY_SIZE(batch));
+}
+
+/* Utility: schedule the retransmission timer, in the retransmission wheel
+ * if it is enabled.
+ */
+static void tsx_schedule_retrans(pjsip_transaction *tsx,
+                                 const pj_time_val *delay)
+{
+    if (pjsip_cfg()->tsx.retrans_wheel &&
+        retrans_wheel_schedule(tsx, delay) == PJ_SUCCESS)
+    {
+        return;
+    }
+
+    tsx_schedule_timer(tsx, &tsx->retransmit_timer, delay, RETRANSMIT_TIMER);
+}
+
+/* Utility: cancel the retransmission timer */
+static void tsx_cancel_retrans(pjsip_transaction *tsx)
+{
+    retrans_wheel_cancel(tsx);
+    tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+}
+
+/* Utility: check if the retransmission timer is scheduled */
+static pj_bool_t tsx_retrans_running(pjsip_transaction *tsx)
+{
+    pj_bool_t queued;
+
+    pj_mutex_lock(mod_tsx_layer.retrans_mutex);
+    queued = (tsx->retrans->state == RETRANS_QUEUED);
+    pj_mutex_unlock(mod_tsx_layer.retrans_mutex);
+
+    return queued || pj_timer_entry_running(&tsx->retransmit_timer);
+}
+
 /* Create and initialize basic transaction structure.
  * This function is called by both UAC and UAS creation.
  */
@@ -1164,6 +1579,8 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
     tsx->tsx_user = tsx_user;
     tsx->endpt = mod_tsx_layer.endpt;
 
+    pj_metric_inc(mod_tsx_layer.m_created);
+
     pj_ansi_snprintf(tsx->obj_name, sizeof(tsx->obj_name), 
                      "tsx%p", tsx);
     pj_memcpy(pool->obj_name, tsx->obj_name, sizeof(pool->obj_name));
@@ -1175,6 +1592,8 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
     tsx->timeout_timer.id = TIMER_INACTIVE;
     tsx->timeout_timer.user_data = tsx;
     tsx->timeout_timer.cb = &tsx_timer_callback;
+    tsx->retrans = PJ_POOL_ZALLOC_T(pool, tsx_retrans);
+    tsx->retrans->tsx = tsx;
     
     if (grp_lock) {
         tsx->grp_lock = grp_lock;
@@ -1234,7 +1653,7 @@ static pj_status_t tsx_shutdown( pjsip_transaction *tsx )
     tsx_cancel_timer(tsx, &tsx->timeout_timer);
 
     /* Cancel retransmission timer. */
-    tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+    tsx_cancel_retrans(tsx);
 
     /* Clear some pending flags. */
     tsx->transport_flag &= ~(TSX_HAS_PENDING_RESCHED | TSX_HAS_PENDING_SEND);
@@ -1605,9 +2024,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uac2(pjsip_module *tsx_user,
                          &via->branch_param);
 
     /* Calculate hashed key value. */
-#ifdef PRECALC_HASH
     tsx->hashed_key = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key);
-#endif
 
     PJ_LOG(6, (tsx->obj_name, "tsx_key=%.*s", (int)tsx->transaction_key.slen,
                tsx->transaction_key.ptr));
@@ -1759,10 +2176,8 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uas2(pjsip_module *tsx_user,
     }
 
     /* Calculate hashed key value. */
-#ifdef PRECALC_HASH
     tsx->hashed_key = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key);
     tsx->hashed_key2 = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key2);
-#endif
 
     /* Duplicate branch parameter for transaction. */
     branch = &rdata->msg_info.via->branch_param;
@@ -1859,6 +2274,9 @@ PJ_DEF(pj_status_t) pjsip_tsx_set_transport(pjsip_transaction *tsx,
 static void tsx_set_status_code(pjsip_transaction *tsx,
                                 int code, const pj_str_t *reason)
 {
+    if (code == PJSIP_SC_TSX_TIMEOUT && tsx->status_code != code)
+        pj_metric_inc(mod_tsx_layer.m_timeout);
+
     tsx->status_code = code;
     if (reason)
         pj_strdup(tsx->pool, &tsx->status_text, reason);
@@ -1937,7 +2355,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_stop_retransmit(pjsip_transaction *tsx)
 
     pj_grp_lock_acquire(tsx->grp_lock);
     /* Cancel retransmission timer. */
-    tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+    tsx_cancel_retrans(tsx);
     pj_grp_lock_release(tsx->grp_lock);
 
     pj_log_pop_indent();
@@ -2159,6 +2577,17 @@ static void send_msg_callback( pjsip_send_state *send_state,
         /* Failed to send! */
         pj_assert(sent != 0);
 
+        /* Let the resolver know that the target is unreachable */
+        if (tsx->role == PJSIP_ROLE_UAC &&
+            tdata->dest_info.cur_addr < tdata->dest_info.addr.count)
+        {
+            pjsip_server_address_record *rec;
+
+            rec = &tdata->dest_info.addr.entry[tdata->dest_info.cur_addr];
+            tsx_report_target(tsx, &rec->addr, rec->addr_len,
+                              PJSIP_SC_TSX_TRANSPORT_ERROR);
+        }
+
         /* If transaction is using the same transport as the failed one, 
          * release the transport.
          */
@@ -2633,8 +3062,7 @@ static void tsx_resched_retransmission( pjsip_transaction *tsx )
 
         timeout.sec = msec_time / 1000;
         timeout.msec = msec_time % 1000;
-        tsx_schedule_timer( tsx, &tsx->retransmit_timer, &timeout,
-                            RETRANSMIT_TIMER);
+        tsx_schedule_retrans(tsx, &timeout);
     }
 }
 
@@ -2645,7 +3073,7 @@ static pj_status_t tsx_retransmit( pjsip_transaction *tsx, int resched)
 {
     pj_status_t status;
 
-    if (resched && pj_timer_entry_running(&tsx->retransmit_timer)) {
+    if (resched && tsx_retrans_running(tsx)) {
         /* We've been asked to reschedule but the timer is already rerunning.
          * This can only happen in a race condition where, between removing
          * this retransmit timer from the heap and actually scheduling it,
@@ -2705,13 +3133,41 @@ static pj_status_t tsx_retransmit( pjsip_transaction *tsx, int resched)
     /* Cancel retransmission timer if transport is pending. */
     if (resched && (tsx->transport_flag & TSX_HAS_PENDING_TRANSPORT))
     {
-        tsx_cancel_timer( tsx, &tsx->retransmit_timer );
+        tsx_cancel_retrans(tsx);
         tsx->transport_flag |= TSX_HAS_PENDING_RESCHED;
     }
 
     return PJ_SUCCESS;
 }
 
+/*
+ * Report the outcome of the request to the SIP resolver, to update the
+ * health score of the target. The round trip time is only meaningful when
+ * the request has not been retransmitted.
+ */
+static void tsx_report_target( pjsip_transaction *tsx,
+                               const pj_sockaddr *addr,
+                               int addr_len, int code)
+{
+    unsigned rtt = 0;
+
+    if (addr_len <= 0)
+        return;
+
+    if (tsx->retransmit_count == 0 && tsx->send_time.sec != 0 &&
+        code != PJSIP_SC_TSX_TIMEOUT)
+    {
+        pj_time_val now;
+
+        pj_gettickcount(&now);
+        PJ_TIME_VAL_SUB(now, tsx->send_time);
+        rtt = PJ_TIME_VAL_MSEC(now);
+    }
+
+    pjsip_resolver_report_target(pjsip_endpt_get_sip_resolver(tsx->endpt),
+                                 addr, addr_len, code, rtt);
+}
+
 static void tsx_update_transport( pjsip_transaction *tsx, 
                                   pjsip_transport *tp)
 {
@@ -2785,6 +3241,7 @@ static pj_status_t tsx_on_state_null( pjsip_transaction *tsx,
         }
 
         /* Send the message. */
+        pj_gettickcount(&tsx->send_time);
         status = tsx_send_msg( tsx, tdata);
         if (status != PJ_SUCCESS) {
             return status;
@@ -2807,8 +3264,7 @@ static pj_status_t tsx_on_state_null( pjsip_transaction *tsx,
             if (tsx->transport_flag & TSX_HAS_PENDING_TRANSPORT) {
                 tsx->transport_flag |= TSX_HAS_PENDING_RESCHED;
             } else {
-                tsx_schedule_timer(tsx, &tsx->retransmit_timer,
-                                   &t1_timer_val, RETRANSMIT_TIMER);
+                tsx_schedule_retrans(tsx, &t1_timer_val);
             }
         }
 
@@ -2846,10 +3302,14 @@ static pj_status_t tsx_on_state_calling( pjsip_transaction *tsx,
                event->body.timer.entry == &tsx->timeout_timer) 
     {
         /* Cancel retransmission timer. */
-        tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+        tsx_cancel_retrans(tsx);
 
         tsx->transport_flag &= ~(TSX_HAS_PENDING_RESCHED);
 
+        /* Let the resolver know that the target didn't respond */
+        tsx_report_target(tsx, &tsx->addr, tsx->addr_len,
+                          PJSIP_SC_TSX_TIMEOUT);
+
         /* Set status code */
         tsx_set_status_code(tsx, PJSIP_SC_TSX_TIMEOUT, NULL);
 
@@ -2877,7 +3337,7 @@ static pj_status_t tsx_on_state_calling( pjsip_transaction *tsx,
          * timer.
          */
         if (code >= 200) {
-            tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+            tsx_cancel_retrans(tsx);
 
             if (tsx->timeout_timer.id != 0) {
                 lock_timer(tsx);
@@ -2889,7 +3349,7 @@ static pj_status_t tsx_on_state_calling( pjsip_transaction *tsx,
             /* Cancel retransmit timer (for non-INVITE transaction, the
              * retransmit timer will be rescheduled at T2.
              */
-            tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+            tsx_cancel_retrans(tsx);
 
             /* For provisional response, only cancel retransmit when this
              * is an INVITE transaction. For non-INVITE, section 17.1.2.1
@@ -2906,8 +3366,7 @@ static pj_status_t tsx_on_state_calling( pjsip_transaction *tsx,
 
             } else {
                 if (!tsx->is_reliable) {
-                    tsx_schedule_timer(tsx, &tsx->retransmit_timer,
-                                       &t2_timer_val, RETRANSMIT_TIMER);
+                    tsx_schedule_retrans(tsx, &t2_timer_val);
                 }
             }
         }
@@ -3065,7 +3524,7 @@ static pj_status_t tsx_on_state_proceeding_uas( pjsip_transaction *tsx,
             {
 
                 /* Stop 1xx retransmission timer, if any */
-                tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+                tsx_cancel_retrans(tsx);
 
                 /* Schedule retransmission */
                 tsx->retransmit_count = 0;
@@ -3073,15 +3532,14 @@ static pj_status_t tsx_on_state_proceeding_uas( pjsip_transaction *tsx,
                     tsx->transport_flag |= TSX_HAS_PENDING_RESCHED;
                 } else {
                     pj_time_val delay = {PJSIP_TSX_1XX_RETRANS_DELAY, 0};
-                    tsx_schedule_timer( tsx, &tsx->retransmit_timer, &delay,
-                                        RETRANSMIT_TIMER);
+                    tsx_schedule_retrans(tsx, &delay);
                 }
             }
 
         } else if (PJSIP_IS_STATUS_IN_CLASS(tsx->status_code, 200)) {
 
             /* Stop 1xx retransmission timer, if any */
-            tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+            tsx_cancel_retrans(tsx);
 
             if (tsx->method.id == PJSIP_INVITE_METHOD && tsx->handle_200resp==0) {
 
@@ -3102,8 +3560,7 @@ static pj_status_t tsx_on_state_proceeding_uas( pjsip_transaction *tsx,
                     if (tsx->transport_flag & TSX_HAS_PENDING_TRANSPORT) {
                         tsx->transport_flag |= TSX_HAS_PENDING_RESCHED;
                     } else {
-                        tsx_schedule_timer( tsx, &tsx->retransmit_timer,
-                                            &t1_timer_val, RETRANSMIT_TIMER);
+                        tsx_schedule_retrans(tsx, &t1_timer_val);
                     }
                 }
 
@@ -3153,7 +3610,7 @@ static pj_status_t tsx_on_state_proceeding_uas( pjsip_transaction *tsx,
         } else if (tsx->status_code >= 300) {
 
             /* Stop 1xx retransmission timer, if any */
-            tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+            tsx_cancel_retrans(tsx);
 
             /* 3xx-6xx class message causes transaction to move to 
              * "Completed" state. 
@@ -3198,8 +3655,7 @@ static pj_status_t tsx_on_state_proceeding_uas( pjsip_transaction *tsx,
                     if (tsx->transport_flag & TSX_HAS_PENDING_TRANSPORT) {
                         tsx->transport_flag |= TSX_HAS_PENDING_RESCHED;
                     } else {
-                        tsx_schedule_timer(tsx, &tsx->retransmit_timer,
-                                           &t1_timer_val, RETRANSMIT_TIMER);
+                        tsx_schedule_retrans(tsx, &t1_timer_val);
                     }
                 }
             }
@@ -3287,6 +3743,16 @@ static pj_status_t tsx_on_state_proceeding_uac(pjsip_transaction *tsx,
         tsx_set_status_code(tsx, msg->line.status.code, 
                             &msg->line.status.reason);
 
+        /* Update the target health with the first response, or with
+         * the final 503 after provisional response.
+         */
+        if (tsx->state == PJSIP_TSX_STATE_CALLING ||
+            tsx->status_code == PJSIP_SC_SERVICE_UNAVAILABLE)
+        {
+            tsx_report_target(tsx, &tsx->addr, tsx->addr_len,
+                              tsx->status_code);
+        }
+
     } else {
         if (event->body.timer.entry == &tsx->retransmit_timer) {
             /* Retransmit message. */
@@ -3342,7 +3808,7 @@ static pj_status_t tsx_on_state_proceeding_uac(pjsip_transaction *tsx,
             unlock_timer(tsx);
 
             /* Cancel retransmission timer */
-            tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+            tsx_cancel_retrans(tsx);
 
             /* Move state to Completed, inform TU. */
             tsx_set_state( tsx, PJSIP_TSX_STATE_COMPLETED, 
@@ -3421,7 +3887,7 @@ static pj_status_t tsx_on_state_proceeding_uac(pjsip_transaction *tsx,
         pjsip_tx_data *ack_tdata = NULL;
 
         /* Cancel retransmission timer */
-        tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+        tsx_cancel_retrans(tsx);
 
         /* Stop timer B. */
         lock_timer(tsx);
@@ -3547,7 +4013,7 @@ static pj_status_t tsx_on_state_completed_uas( pjsip_transaction *tsx,
             }
 
             /* Cease retransmission. */
-            tsx_cancel_timer(tsx, &tsx->retransmit_timer);
+            tsx_cancel_retrans(tsx);
 
             tsx->transport_flag &= ~(TSX_HAS_PENDING_RESCHED);
 
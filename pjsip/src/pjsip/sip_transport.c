@@ -23,6 +23,7 @@
 #include <pjsip/sip_private.h>
 #include <pjsip/sip_errno.h>
 #include <pjsip/sip_module.h>
+#include <pjlib-util/metrics.h>
 #include <pj/addr_resolv.h>
 #include <pj/except.h>
 #include <pj/os.h>
@@ -33,6 +34,7 @@
 #include <pj/pool.h>
 #include <pj/assert.h>
 #include <pj/lock.h>
+#include <pj/math.h>
 #include <pj/list.h>
 
 
@@ -110,9 +112,10 @@ enum timer_id {
 static pj_status_t mod_on_tx_msg(pjsip_tx_data *tdata);
 
 /* This module has sole purpose to print transmit data to contigous buffer
- * before actually transmitted to the wire. 
+ * before actually transmitted to the wire. Each transport manager registers
+ * its own copy, so that several endpoints can coexist in one process.
  */
-static pjsip_module mod_msg_print = 
+static const pjsip_module mod_msg_print_tmpl = 
 {
     NULL, NULL,                         /* prev and next                    */
     { "mod-msg-print", 13},             /* Name.                            */
@@ -137,6 +140,29 @@ typedef struct transport
     pjsip_transport *tp;
 } transport;
 
+/* Transport group, see pjsip_tpmgr_create_tpgroup() */
+struct pjsip_tpgroup
+{
+    PJ_DECL_LIST_MEMBER(struct pjsip_tpgroup);
+
+    pj_pool_t              *pool;
+    pj_grp_lock_t          *grp_lock;
+    pjsip_tpmgr            *mgr;
+    pjsip_transport_type_e  type;
+    pj_sockaddr             rem_addr;
+    int                     addr_len;
+    pj_str_t                host;
+    pjsip_tpgroup_cfg       cfg;
+    pj_timer_entry          timer;
+    pj_bool_t               is_destroying;
+
+    /* Next connection to use for round-robin selection */
+    unsigned                rr_idx;
+
+    /* The connections, each holding a reference */
+    pjsip_transport        *tp[PJSIP_TPGROUP_MAX_CONN];
+};
+
 /*
  * Transport manager.
  */
@@ -161,8 +187,31 @@ struct pjsip_tpmgr
      */
     pjsip_tx_data    tdata_list;
 
+    /* This endpoint's instance of mod_msg_print_tmpl. */
+    pjsip_module     mod_msg_print;
+
     /* List of free transport entry. */
     transport        tp_entry_freelist;
+
+    /* Generation counter, incremented (with the lock held) whenever a
+     * transport is added to or removed from the hash table. Used to
+     * validate transport cache entries without taking the lock.
+     */
+    volatile unsigned tp_gen;
+
+    /* Recycled tdata pools, and rdata pools of TCP/TLS connections */
+    pjsip_pool_cache *tdata_pools;
+    pjsip_pool_cache *rdata_pools;
+
+    /* Transport groups */
+    pjsip_tpgroup    tpgroup_list;
+
+    /* Metrics, registered in the default registry */
+    pj_metrics      *metrics;
+    pj_metric       *m_rx_msg;
+    pj_metric       *m_rx_error;
+    pj_metric       *m_tx_msg;
+    pj_metric       *m_tp_count;
 };
 
 
@@ -295,6 +344,7 @@ static struct transport_names_t
 static void tp_state_callback(pjsip_transport *tp,
                               pjsip_transport_state state,
                               const pjsip_transport_state_info *info);
+static void tpgroup_release(pjsip_tpgroup *grp);
 
 
 static struct transport_names_t *get_tpname(pjsip_transport_type_e type)
@@ -476,6 +526,216 @@ PJ_DEF(void) pjsip_tpselector_dec_ref(pjsip_tpselector *sel)
 }
 
 
+/*
+ * Initialize transport cache.
+ */
+PJ_DEF(void) pjsip_tpcache_init(pjsip_tpcache *cache,
+                                pj_grp_lock_t *grp_lock)
+{
+    pj_bzero(cache, sizeof(*cache));
+    cache->grp_lock = grp_lock;
+}
+
+
+/*
+ * Forget the cached transport.
+ */
+PJ_DEF(void) pjsip_tpcache_clear(pjsip_tpcache *cache)
+{
+    pjsip_transport *tp;
+
+    pj_grp_lock_acquire(cache->grp_lock);
+    tp = cache->tp;
+    cache->tp = NULL;
+    pj_grp_lock_release(cache->grp_lock);
+
+    /* The cache only keeps the transport memory alive, see tpcache_put() */
+    if (tp)
+        pj_grp_lock_dec_ref(tp->grp_lock);
+}
+
+
+/*****************************************************************************
+ *
+ * POOL CACHE.
+ *
+ *****************************************************************************/
+
+/*
+ * Bounded stack of reset pools of the same size. The transport manager
+ * holds a reference to the cache, and so does every pool given out by
+ * the cache.
+ */
+struct pjsip_pool_cache
+{
+    pj_pool_t       *pool;
+    pj_grp_lock_t   *grp_lock;
+    pjsip_endpoint  *endpt;
+    const char      *name;
+    pj_size_t        initial_size;
+    pj_size_t        increment_size;
+
+    unsigned         max;
+    unsigned         cnt;
+    pj_pool_t      **pools;
+
+    /* Statistics */
+    pj_size_t        reused;
+    pj_size_t        created;
+    pj_size_t        released;
+};
+
+static void pool_cache_on_destroy(void *arg)
+{
+    pjsip_pool_cache *cache = (pjsip_pool_cache*)arg;
+
+    while (cache->cnt)
+        pj_pool_release(cache->pools[--cache->cnt]);
+
+    pj_pool_safe_release(&cache->pool);
+}
+
+static pj_status_t pool_cache_create(pjsip_endpoint *endpt,
+                                     const char *name,
+                                     pj_size_t initial_size,
+                                     pj_size_t increment_size,
+                                     unsigned max,
+                                     pjsip_pool_cache **p_cache)
+{
+    pj_pool_t *pool;
+    pjsip_pool_cache *cache;
+    pj_status_t status;
+
+    pool = pjsip_endpt_create_pool(endpt, "plcache%p", 256, 256);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    cache = PJ_POOL_ZALLOC_T(pool, pjsip_pool_cache);
+    cache->pool = pool;
+    cache->endpt = endpt;
+    cache->name = name;
+    cache->initial_size = initial_size;
+    cache->increment_size = increment_size;
+    cache->max = max;
+    if (max) {
+        cache->pools = (pj_pool_t**)
+                       pj_pool_calloc(pool, max, sizeof(pj_pool_t*));
+    }
+
+    status = pj_grp_lock_create_w_handler(pool, NULL, cache,
+                                          &pool_cache_on_destroy,
+                                          &cache->grp_lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+    pj_grp_lock_add_ref(cache->grp_lock);
+
+    *p_cache = cache;
+    return PJ_SUCCESS;
+}
+
+/* Get a pool from the cache, or create a new one if the cache is empty.
+ * The new pool can only be created while the endpoint is still alive.
+ */
+static pj_pool_t *pool_cache_get(pjsip_pool_cache *cache)
+{
+    pj_pool_t *pool = NULL;
+
+    pj_grp_lock_acquire(cache->grp_lock);
+    if (cache->cnt) {
+        pool = cache->pools[--cache->cnt];
+        ++cache->reused;
+    } else {
+        ++cache->created;
+    }
+    pj_grp_lock_add_ref(cache->grp_lock);
+    pj_grp_lock_release(cache->grp_lock);
+
+    if (!pool) {
+        pool = pjsip_endpt_create_pool(cache->endpt, cache->name,
+                                       cache->initial_size,
+                                       cache->increment_size);
+        if (!pool)
+            pj_grp_lock_dec_ref(cache->grp_lock);
+    }
+
+    return pool;
+}
+
+/* Return a pool to the cache, release it if the cache is full. */
+static void pool_cache_put(pjsip_pool_cache *cache, pj_pool_t *pool,
+                           pj_bool_t secure)
+{
+    if (secure) {
+        pj_pool_block *b = pool->block_list.next;
+        while (b != &pool->block_list) {
+            volatile unsigned char *p = b->buf;
+            while (p < b->end) *p++ = 0;
+            b = b->next;
+        }
+    }
+
+    /* This also releases the blocks other than the first one */
+    pj_pool_reset(pool);
+
+    pj_grp_lock_acquire(cache->grp_lock);
+    if (cache->cnt < cache->max) {
+        cache->pools[cache->cnt++] = pool;
+        pool = NULL;
+    } else {
+        ++cache->released;
+    }
+    pj_grp_lock_release(cache->grp_lock);
+
+    if (pool)
+        pj_pool_release(pool);
+
+    pj_grp_lock_dec_ref(cache->grp_lock);
+}
+
+static void pool_cache_dump(pjsip_pool_cache *cache, const char *title)
+{
+#if PJ_LOG_MAX_LEVEL >= 3
+    pj_grp_lock_acquire(cache->grp_lock);
+    PJ_LOG(3,(THIS_FILE, " %s pools: %u cached (max %u), %lu reused, "
+                         "%lu created, %lu released",
+              title, cache->cnt, cache->max,
+              (unsigned long)cache->reused,
+              (unsigned long)cache->created,
+              (unsigned long)cache->released));
+    pj_grp_lock_release(cache->grp_lock);
+#else
+    PJ_UNUSED_ARG(cache);
+    PJ_UNUSED_ARG(title);
+#endif
+}
+
+/*
+ * Get pool for rdata of connection oriented transports.
+ */
+PJ_DEF(pj_pool_t*) pjsip_tpmgr_create_rdata_pool(pjsip_tpmgr *mgr,
+                                                 pjsip_pool_cache **p_cache)
+{
+    PJ_ASSERT_RETURN(mgr && p_cache, NULL);
+
+    *p_cache = mgr->rdata_pools;
+    return pool_cache_get(mgr->rdata_pools);
+}
+
+/*
+ * Return pool to the cache.
+ */
+PJ_DEF(void) pjsip_pool_cache_release(pjsip_pool_cache *cache,
+                                      pj_pool_t *pool,
+                                      pj_bool_t secure)
+{
+    PJ_ASSERT_ON_FAIL(cache && pool, return);
+
+    pool_cache_put(cache, pool, secure);
+}
+
+
 /*****************************************************************************
  *
  * TRANSMIT DATA BUFFER MANIPULATION.
@@ -494,9 +754,7 @@ PJ_DEF(pj_status_t) pjsip_tx_data_create( pjsip_tpmgr *mgr,
 
     PJ_ASSERT_RETURN(mgr && p_tdata, PJ_EINVAL);
 
-    pool = pjsip_endpt_create_pool( mgr->endpt, "tdta%p",
-                                    PJSIP_POOL_LEN_TDATA,
-                                    PJSIP_POOL_INC_TDATA );
+    pool = pool_cache_get(mgr->tdata_pools);
     if (!pool)
         return PJ_ENOMEM;
 
@@ -508,14 +766,15 @@ PJ_DEF(pj_status_t) pjsip_tx_data_create( pjsip_tpmgr *mgr,
 
     status = pj_atomic_create(tdata->pool, 0, &tdata->ref_cnt);
     if (status != PJ_SUCCESS) {
-        pjsip_endpt_release_pool( mgr->endpt, tdata->pool );
+        pool_cache_put(mgr->tdata_pools, tdata->pool, PJ_FALSE);
         return status;
     }
     
     //status = pj_lock_create_simple_mutex(pool, "tdta%p", &tdata->lock);
     status = pj_lock_create_null_mutex(pool, "tdta%p", &tdata->lock);
     if (status != PJ_SUCCESS) {
-        pjsip_endpt_release_pool( mgr->endpt, tdata->pool );
+        pj_atomic_destroy(tdata->ref_cnt);
+        pool_cache_put(mgr->tdata_pools, tdata->pool, PJ_FALSE);
         return status;
     }
 
@@ -551,6 +810,8 @@ static void tx_data_destroy(pjsip_tx_data *tdata)
     PJ_LOG(5,(tdata->obj_name, "Destroying txdata %s",
               pjsip_tx_data_get_info(tdata)));
     pjsip_tpselector_dec_ref(&tdata->tp_sel);
+    if (tdata->tp_cache)
+        pj_grp_lock_dec_ref(tdata->tp_cache->grp_lock);
 #if defined(PJ_DEBUG) && PJ_DEBUG!=0
     pj_atomic_dec( tdata->mgr->tdata_counter );
 #endif
@@ -564,7 +825,7 @@ static void tx_data_destroy(pjsip_tx_data *tdata)
 
     pj_atomic_destroy( tdata->ref_cnt );
     pj_lock_destroy( tdata->lock );
-    pjsip_endpt_release_pool( tdata->mgr->endpt, tdata->pool );
+    pool_cache_put( tdata->mgr->tdata_pools, tdata->pool, PJ_FALSE );
 }
 
 /*
@@ -713,6 +974,26 @@ PJ_DEF(pj_status_t) pjsip_tx_data_set_transport(pjsip_tx_data *tdata,
     return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pjsip_tx_data_set_tpcache(pjsip_tx_data *tdata,
+                                              pjsip_tpcache *cache)
+{
+    PJ_ASSERT_RETURN(tdata, PJ_EINVAL);
+
+    pj_lock_acquire(tdata->lock);
+
+    if (tdata->tp_cache != cache) {
+        if (cache)
+            pj_grp_lock_add_ref(cache->grp_lock);
+        if (tdata->tp_cache)
+            pj_grp_lock_dec_ref(tdata->tp_cache->grp_lock);
+        tdata->tp_cache = cache;
+    }
+
+    pj_lock_release(tdata->lock);
+
+    return PJ_SUCCESS;
+}
+
 /* Clone pjsip_tx_data. */
 PJ_DEF(pj_status_t) pjsip_tx_data_clone(const pjsip_tx_data *src,
                                         unsigned flags,
@@ -810,9 +1091,22 @@ PJ_DEF(pj_status_t) pjsip_rx_data_clone( const pjsip_rx_data *src,
     /* pkt_info can be memcopied */
     pj_memcpy(&dst->pkt_info, &src->pkt_info, sizeof(src->pkt_info));
 
-    /* msg_info needs deep clone */
-    dst->msg_info.msg_buf = dst->pkt_info.packet +
-                            (src->msg_info.msg_buf - src->pkt_info.packet);
+    /* msg_info needs deep clone. Large messages of stream transports
+     * are not in the packet buffer but in the stream's overflow buffer.
+     */
+    if (src->msg_info.msg_buf >= src->pkt_info.packet &&
+        src->msg_info.msg_buf < src->pkt_info.packet +
+                                sizeof(src->pkt_info.packet))
+    {
+        dst->msg_info.msg_buf = dst->pkt_info.packet +
+                                (src->msg_info.msg_buf - src->pkt_info.packet);
+    } else {
+        dst->msg_info.msg_buf = (char*) pj_pool_alloc(pool,
+                                                      src->msg_info.len + 1);
+        pj_memcpy(dst->msg_info.msg_buf, src->msg_info.msg_buf,
+                  src->msg_info.len);
+        dst->msg_info.msg_buf[src->msg_info.len] = '\0';
+    }
     dst->msg_info.len = src->msg_info.len;
     dst->msg_info.msg = pjsip_msg_clone(pool, src->msg_info.msg);
     pj_list_init(&dst->msg_info.parse_err);
@@ -979,6 +1273,9 @@ PJ_DEF(pj_status_t) pjsip_transport_send(  pjsip_transport *tr,
     status = (*tr->send_msg)(tr, tdata,  addr, addr_len, (void*)tdata, 
                              &transport_send_callback);
 
+    if (status == PJ_SUCCESS || status == PJ_EPENDING)
+        pj_metric_inc(tr->tpmgr->m_tx_msg);
+
     if (status != PJ_EPENDING) {
         tdata->is_pending = 0;
 
@@ -1332,6 +1629,7 @@ PJ_DEF(pj_status_t) pjsip_transport_register( pjsip_tpmgr *mgr,
         TRACE_((THIS_FILE, "Remote address not registered, "
                            "added the transport to the hash"));
     }
+    ++mgr->tp_gen;
 
     /* Add ref transport group lock, if any */
     if (tp->grp_lock)
@@ -1413,6 +1711,7 @@ static pj_status_t destroy_transport( pjsip_tpmgr *mgr,
                 pj_list_erase(tp_iter);
                 /* Put back to the transport freelist. */
                 pj_list_push_back(&mgr->tp_entry_freelist, tp_iter);
+                ++mgr->tp_gen;
 
                 break;
             }
@@ -1620,6 +1919,39 @@ static pj_bool_t pjsip_tpmgr_is_tpfactory_valid(pjsip_tpmgr *mgr,
 /*
  * Create a new transport manager.
  */
+/* Update the transport count gauge when the metrics are rendered */
+static void tpmgr_collect_metrics(pj_metrics *metrics, void *user_data)
+{
+    pjsip_tpmgr *mgr = (pjsip_tpmgr*)user_data;
+
+    PJ_UNUSED_ARG(metrics);
+    pj_metric_set(mgr->m_tp_count, pj_hash_count(mgr->table));
+}
+
+/* Register the metrics of transport manager to the default registry */
+static void tpmgr_init_metrics(pjsip_tpmgr *mgr)
+{
+    pj_metrics *metrics = pj_metrics_get_default();
+
+    if (!metrics)
+        return;
+
+    mgr->metrics = metrics;
+    pj_metrics_add_counter(metrics, "pjsip_rx_msg_total",
+                           "Number of valid SIP messages received",
+                           &mgr->m_rx_msg);
+    pj_metrics_add_counter(metrics, "pjsip_rx_error_total",
+                           "Number of received packets dropped because "
+                           "of errors", &mgr->m_rx_error);
+    pj_metrics_add_counter(metrics, "pjsip_tx_msg_total",
+                           "Number of SIP messages sent",
+                           &mgr->m_tx_msg);
+    pj_metrics_add_gauge(metrics, "pjsip_transport_count",
+                         "Number of transports",
+                         &mgr->m_tp_count);
+    pj_metrics_add_collector(metrics, &tpmgr_collect_metrics, mgr);
+}
+
 PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
                                         pjsip_endpoint *endpt,
                                         pjsip_rx_callback rx_cb,
@@ -1633,11 +1965,6 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
 
     PJ_ASSERT_RETURN(pool && endpt && rx_cb && p_mgr, PJ_EINVAL);
 
-    /* Register mod_msg_print module. */
-    status = pjsip_endpt_register_module(endpt, &mod_msg_print);
-    if (status != PJ_SUCCESS)
-        return status;
-
     /* Create and initialize transport manager. */
     mgr_pool = pjsip_endpt_create_pool(endpt, "tpmgr",
                                        TPMGR_POOL_INIT_SIZE,
@@ -1651,8 +1978,18 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
     if (!mgr->pool)
         return PJ_ENOMEM;
 
+    /* Register mod_msg_print module. */
+    pj_memcpy(&mgr->mod_msg_print, &mod_msg_print_tmpl,
+              sizeof(mgr->mod_msg_print));
+    status = pjsip_endpt_register_module(endpt, &mgr->mod_msg_print);
+    if (status != PJ_SUCCESS) {
+        pjsip_endpt_release_pool(endpt, mgr_pool);
+        return status;
+    }
+
     pj_list_init(&mgr->factory_list);
     pj_list_init(&mgr->tdata_list);
+    pj_list_init(&mgr->tpgroup_list);
     pj_list_init(&mgr->tp_entry_freelist);
 
     mgr->table = pj_hash_create(mgr->pool, PJSIP_TPMGR_HTABLE_SIZE);
@@ -1663,6 +2000,20 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
     if (status != PJ_SUCCESS)
         return status;
 
+    status = pool_cache_create(endpt, "tdta%p", PJSIP_POOL_LEN_TDATA,
+                               PJSIP_POOL_INC_TDATA,
+                               PJSIP_TDATA_POOL_CACHE_SIZE,
+                               &mgr->tdata_pools);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    status = pool_cache_create(endpt, "rtd%p", PJSIP_POOL_RDATA_LEN,
+                               PJSIP_POOL_RDATA_INC,
+                               PJSIP_RDATA_POOL_CACHE_SIZE,
+                               &mgr->rdata_pools);
+    if (status != PJ_SUCCESS)
+        return status;
+
     for (; i < PJSIP_TRANSPORT_ENTRY_ALLOC_CNT; ++i) {
         transport *tp_add = NULL;
 
@@ -1684,6 +2035,8 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
     /* Set transport state callback */
     pjsip_tpmgr_set_state_cb(mgr, &tp_state_callback);
 
+    tpmgr_init_metrics(mgr);
+
     PJ_LOG(5, (THIS_FILE, "Transport manager created."));
 
     *p_mgr = mgr;
@@ -1957,8 +2310,20 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
 
     PJ_LOG(5, (THIS_FILE, "Destroying transport manager"));
 
+    if (mgr->metrics) {
+        pj_metrics_remove_collector(mgr->metrics, &tpmgr_collect_metrics,
+                                    mgr);
+        mgr->metrics = NULL;
+    }
+
     pj_lock_acquire(mgr->lock);
 
+    /*
+     * Release the connections of transport groups.
+     */
+    while (!pj_list_empty(&mgr->tpgroup_list))
+        tpgroup_release(mgr->tpgroup_list.next);
+
     /*
      * Destroy all transports in the hash table.
      */
@@ -2009,6 +2374,10 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
         PJ_LOG(3,(THIS_FILE, "Cleaned up dangling transmit buffer(s)."));
     }
 
+    /* Pools still in use keep their cache alive until they are returned */
+    pj_grp_lock_dec_ref(mgr->tdata_pools->grp_lock);
+    pj_grp_lock_dec_ref(mgr->rdata_pools->grp_lock);
+
 #if defined(PJ_DEBUG) && PJ_DEBUG!=0
     pj_atomic_destroy(mgr->tdata_counter);
 #endif
@@ -2016,8 +2385,8 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
     pj_lock_destroy(mgr->lock);
 
     /* Unregister mod_msg_print. */
-    if (mod_msg_print.id != -1) {
-        pjsip_endpt_unregister_module(endpt, &mod_msg_print);
+    if (mgr->mod_msg_print.id != -1) {
+        pjsip_endpt_unregister_module(endpt, &mgr->mod_msg_print);
     }
 
     if (mgr->pool) {
@@ -2083,12 +2452,41 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_shutdown_all(
 
 
 /*
- * pjsip_tpmgr_receive_packet()
- *
- * Called by tranports when they receive a new packet.
+ * Check whether the pending partial message at the start of the buffer is
+ * known to be still incomplete, without running pjsip_find_msg() over it
+ * again. Only the newly received data is searched for the end of headers.
  */
-PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
-                                               pjsip_rx_data *rdata)
+static pj_bool_t stream_msg_pending(pjsip_rx_stream *stream,
+                                    const char *buf, pj_size_t len)
+{
+    const pj_str_t end_hdr = { "\n\r\n", 3};
+    pj_size_t start;
+    pj_str_t s;
+
+    if (stream->msg_size)
+        return len < stream->msg_size;
+
+    if (stream->scanned == 0 || len < stream->scanned)
+        return PJ_FALSE;
+
+    /* The end of headers may straddle the old and new data */
+    start = (stream->scanned > 2) ? stream->scanned - 2 : 0;
+    s.ptr = (char*)buf + start;
+    s.slen = len - start;
+    if (pj_strstr(&s, &end_hdr) != NULL)
+        return PJ_FALSE;
+
+    stream->scanned = len;
+    return PJ_TRUE;
+}
+
+/*
+ * Process all messages in the buffer. For stream oriented transports, a
+ * partial message larger than max_len is reported as overflow.
+ */
+static pj_size_t receive_packet(pjsip_tpmgr *mgr, pjsip_rx_data *rdata,
+                                char *pkt, pj_size_t len, pj_size_t max_len,
+                                pjsip_rx_stream *stream)
 {
     pjsip_transport *tr = rdata->tp_info.transport;
 
@@ -2096,13 +2494,8 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
     pj_size_t remaining_len;
     pj_size_t total_processed = 0;
 
-    /* Check size. */
-    pj_assert(rdata->pkt_info.len > 0);
-    if (rdata->pkt_info.len <= 0)
-        return -1;
-
-    current_pkt = rdata->pkt_info.packet;
-    remaining_len = rdata->pkt_info.len;
+    current_pkt = pkt;
+    remaining_len = len;
 
     tr->last_recv_len = rdata->pkt_info.len;
     pj_get_timestamp(&tr->last_recv_ts);
@@ -2181,16 +2574,34 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
                 }
             }
 
+            /* Don't search the pending message again if the new data
+             * can't have completed it.
+             */
+            if (stream) {
+                if (current_pkt == pkt &&
+                    stream_msg_pending(stream, current_pkt, remaining_len))
+                {
+                    return total_processed;
+                }
+                stream->msg_size = stream->scanned = 0;
+            }
+
             msg_status = pjsip_find_msg(current_pkt, remaining_len, PJ_FALSE, 
                                         &msg_fragment_size);
             if (msg_status != PJ_SUCCESS) {
                 pj_status_t dd_status = msg_status;
 
                 if (msg_status == PJSIP_EPARTIALMSG) {
-                    if (remaining_len != PJSIP_MAX_PKT_LEN) {
+                    if (remaining_len < max_len) {
                         /* We only get partial message: Not enough data in
                          * packet.
                          */
+                        if (stream) {
+                            if (msg_fragment_size > remaining_len)
+                                stream->msg_size = msg_fragment_size;
+                            else
+                                stream->scanned = remaining_len;
+                        }
                         return total_processed;
                     }
                     /* Overflow, buffer too small. */
@@ -2209,6 +2620,7 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
                 }
 
                 if (1) {
+                    pj_metric_inc(mgr->m_rx_error);
                     mgr->on_rx_msg(mgr->endpt, dd_status, rdata);
 
                     /* Notify application */
@@ -2243,7 +2655,7 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
                 }
 
                 /* Exhaust all data. */
-                return rdata->pkt_info.len;
+                return len;
             }
         }
 
@@ -2307,6 +2719,9 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
                       rdata->msg_info.msg_buf));
             }
 
+            if (tmp.slen)
+                pj_metric_inc(mgr->m_rx_error);
+
             /* Notify application about the dropped data (syntax error) */
             if (tmp.slen && mgr->tp_drop_data_cb) {
                 pjsip_tp_dropped_data dd;
@@ -2332,6 +2747,7 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
             rdata->msg_info.via == NULL || 
             rdata->msg_info.cseq == NULL) 
         {
+            pj_metric_inc(mgr->m_rx_error);
             mgr->on_rx_msg(mgr->endpt, PJSIP_EMISSINGHDR, rdata);
 
             /* Notify application about the missing header. */
@@ -2365,6 +2781,7 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
             if (rdata->msg_info.msg->line.status.code < 100 ||
                 rdata->msg_info.msg->line.status.code >= 700)
             {
+                pj_metric_inc(mgr->m_rx_error);
                 mgr->on_rx_msg(mgr->endpt, PJSIP_EINVALIDSTATUS, rdata);
 
                 /* Notify application about the invalid status. */
@@ -2413,6 +2830,7 @@ PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
 
         /* Call the transport manager's upstream message callback.
          */
+        pj_metric_inc(mgr->m_rx_msg);
         mgr->on_rx_msg(mgr->endpt, PJ_SUCCESS, rdata);
 
 
@@ -2428,6 +2846,584 @@ finish_process_fragment:
 }
 
 
+/*
+ * pjsip_tpmgr_receive_packet()
+ *
+ * Called by tranports when they receive a new packet.
+ */
+PJ_DEF(pj_ssize_t) pjsip_tpmgr_receive_packet( pjsip_tpmgr *mgr,
+                                               pjsip_rx_data *rdata)
+{
+    /* Check size. */
+    pj_assert(rdata->pkt_info.len > 0);
+    if (rdata->pkt_info.len <= 0)
+        return -1;
+
+    return receive_packet(mgr, rdata, rdata->pkt_info.packet,
+                          rdata->pkt_info.len, PJSIP_MAX_PKT_LEN, NULL);
+}
+
+
+PJ_DEF(void) pjsip_rx_stream_init(pjsip_rx_stream *stream,
+                                  pj_size_t max_msg_len)
+{
+    pj_bzero(stream, sizeof(*stream));
+    stream->max_msg_len = max_msg_len;
+}
+
+
+PJ_DEF(void) pjsip_rx_stream_reset(pjsip_rx_stream *stream)
+{
+    if (stream->pool)
+        pj_pool_release(stream->pool);
+
+    stream->pool = NULL;
+    stream->buf = NULL;
+    stream->size = stream->len = 0;
+    stream->msg_size = stream->scanned = 0;
+}
+
+
+/*
+ * Make room for at least need bytes in the overflow buffer. The buffer
+ * grows to the size of the pending message if it is known, otherwise by
+ * doubling, and never beyond the maximum message size plus one read.
+ */
+static pj_status_t stream_grow(pjsip_rx_stream *stream,
+                               pjsip_rx_data *rdata, pj_size_t need)
+{
+    pj_size_t size, max_size;
+    pj_pool_t *pool;
+    char *buf;
+
+    if (need <= stream->size)
+        return PJ_SUCCESS;
+
+    max_size = PJ_MAX(stream->max_msg_len, sizeof(rdata->pkt_info.packet)) +
+               sizeof(rdata->pkt_info.packet);
+    if (need > max_size)
+        return PJSIP_ERXOVERFLOW;
+
+    size = PJ_MAX(stream->size * 2, sizeof(rdata->pkt_info.packet) * 2);
+    if (stream->msg_size > size)
+        size = stream->msg_size;
+    if (size < need)
+        size = need;
+    if (size > max_size)
+        size = max_size;
+
+    /* Plus the NULL terminator required by the parser */
+    pool = pj_pool_create(rdata->tp_info.pool->factory, "rxbuf%p",
+                          size + 1 + 128, 256, NULL);
+    if (!pool)
+        return PJ_ENOMEM;
+    buf = (char*) pj_pool_alloc(pool, size + 1);
+
+    if (stream->len)
+        pj_memcpy(buf, stream->buf, stream->len);
+    if (stream->pool)
+        pj_pool_release(stream->pool);
+
+    stream->pool = pool;
+    stream->buf = buf;
+    stream->size = size;
+    return PJ_SUCCESS;
+}
+
+
+/*
+ * pjsip_tpmgr_receive_stream()
+ *
+ * Called by stream oriented transports when they receive new data.
+ */
+PJ_DEF(pj_size_t) pjsip_tpmgr_receive_stream(pjsip_tpmgr *mgr,
+                                             pjsip_rx_data *rdata,
+                                             pjsip_rx_stream *stream)
+{
+    char *packet = rdata->pkt_info.packet;
+    pj_size_t len = rdata->pkt_info.len;
+    pj_size_t max_len, eaten, remainder;
+    pj_status_t status;
+
+    pj_assert(rdata->pkt_info.len > 0);
+    if (rdata->pkt_info.len <= 0)
+        return 0;
+
+    max_len = PJ_MAX(stream->max_msg_len, sizeof(rdata->pkt_info.packet));
+
+    if (stream->buf == NULL) {
+        eaten = receive_packet(mgr, rdata, packet, len, max_len, stream);
+        remainder = len - eaten;
+
+        if (remainder < sizeof(rdata->pkt_info.packet)) {
+            /* Move unprocessed data to the front of the buffer */
+            if (remainder > 0 && eaten > 0)
+                pj_memmove(packet, packet + eaten, remainder);
+            return remainder;
+        }
+
+        /* The packet buffer is full with a partial message, continue
+         * receiving it in the overflow buffer.
+         */
+        status = stream_grow(stream, rdata, remainder +
+                                            sizeof(rdata->pkt_info.packet));
+        if (status != PJ_SUCCESS)
+            goto on_error;
+
+        PJ_LOG(5, (THIS_FILE, "%s receiving large message in overflow "
+                   "buffer of %lu bytes", rdata->tp_info.transport->obj_name,
+                   (unsigned long)stream->size));
+
+        pj_memcpy(stream->buf, packet, remainder);
+        stream->len = remainder;
+        return 0;
+    }
+
+    /* Append the new data to the overflow buffer */
+    status = stream_grow(stream, rdata, stream->len + len);
+    if (status != PJ_SUCCESS)
+        goto on_error;
+
+    pj_memcpy(stream->buf + stream->len, packet, len);
+    stream->len += len;
+
+    eaten = receive_packet(mgr, rdata, stream->buf, stream->len, max_len,
+                           stream);
+    remainder = stream->len - eaten;
+
+    if (remainder < sizeof(rdata->pkt_info.packet)) {
+        /* Back to the packet buffer, release the overflow buffer */
+        if (remainder > 0)
+            pj_memcpy(packet, stream->buf + eaten, remainder);
+        pj_pool_release(stream->pool);
+        stream->pool = NULL;
+        stream->buf = NULL;
+        stream->size = stream->len = 0;
+        return remainder;
+    }
+
+    if (eaten > 0)
+        pj_memmove(stream->buf, stream->buf + eaten, remainder);
+    stream->len = remainder;
+    return 0;
+
+on_error:
+    PJ_PERROR(2, (THIS_FILE, status, "%s dropping %lu bytes of partial "
+                  "message", rdata->tp_info.transport->obj_name,
+                  (unsigned long)(stream->len + len)));
+    pjsip_rx_stream_reset(stream);
+    return 0;
+}
+
+
+/*
+ * Get the transport cached by the tdata's transport cache, if it is still
+ * the transport that the hash table lookup would return.
+ */
+static pjsip_transport *tpcache_get(pjsip_tpmgr *mgr,
+                                    pjsip_transport_type_e type,
+                                    const pj_sockaddr_t *remote,
+                                    int addr_len,
+                                    pjsip_tx_data *tdata)
+{
+    pjsip_tpcache *cache = tdata->tp_cache;
+    pjsip_transport *tp;
+    unsigned gen;
+
+    pj_grp_lock_acquire(cache->grp_lock);
+
+    tp = cache->tp;
+    gen = cache->gen;
+    if (tp && cache->gen == mgr->tp_gen && tp->tpmgr == mgr &&
+        cache->type == type && cache->addr_len == addr_len &&
+        pj_memcmp(&cache->rem_addr, remote, addr_len) == 0 &&
+        !tp->is_shutdown && !tp->is_destroying &&
+        pj_atomic_get(tp->ref_cnt) > 0)
+    {
+        /* For secure transport, make sure tdata's destination host
+         * still matches the transport's remote host.
+         */
+        if ((pjsip_transport_get_flag_from_type(type) &
+             PJSIP_TRANSPORT_SECURE) &&
+            pj_stricmp(&tdata->dest_info.name, &tp->remote_name.host))
+        {
+            tp = NULL;
+        } else {
+            /* The transport is in use, so normally this won't need the
+             * transport manager lock (see pjsip_transport_add_ref()).
+             */
+            pjsip_transport_add_ref(tp);
+        }
+    } else {
+        tp = NULL;
+    }
+
+    pj_grp_lock_release(cache->grp_lock);
+
+    /* The checks above were made without the transport manager lock, so
+     * the transport may have been unregistered or started destroying
+     * before the reference was taken. Verify again now that it can't go
+     * away, and treat it as a cache miss if so.
+     */
+    if (tp && (gen != mgr->tp_gen || tp->is_destroying)) {
+        pjsip_transport_dec_ref(tp);
+        tp = NULL;
+    }
+
+    return tp;
+}
+
+/*
+ * Remember the transport acquired for the destination in the cache.
+ */
+static void tpcache_put(pjsip_tpcache *cache,
+                        pjsip_transport *tp,
+                        pjsip_transport_type_e type,
+                        const pj_sockaddr_t *remote,
+                        int addr_len,
+                        unsigned gen)
+{
+    pjsip_transport *old;
+
+    /* The cache doesn't hold a transport reference, which would prevent
+     * the transport from being shut down or destroyed while idle, but
+     * only a reference to the transport's group lock to keep the
+     * transport memory valid.
+     */
+    if (!tp->grp_lock)
+        return;
+
+    pj_grp_lock_add_ref(tp->grp_lock);
+
+    pj_grp_lock_acquire(cache->grp_lock);
+    old = cache->tp;
+    cache->tp = tp;
+    cache->type = type;
+    pj_memcpy(&cache->rem_addr, remote, addr_len);
+    cache->addr_len = addr_len;
+    cache->gen = gen;
+    pj_grp_lock_release(cache->grp_lock);
+
+    if (old)
+        pj_grp_lock_dec_ref(old->grp_lock);
+}
+
+/*****************************************************************************
+ *
+ * TRANSPORT GROUP
+ *
+ *****************************************************************************/
+
+static pj_bool_t tpgroup_tp_usable(const pjsip_transport *tp)
+{
+    return tp && !tp->is_shutdown && !tp->is_destroying;
+}
+
+/* Open connection idx of the group, the manager lock must be held. */
+static pj_status_t tpgroup_connect(pjsip_tpgroup *grp, unsigned idx)
+{
+    pjsip_tpmgr *mgr = grp->mgr;
+    pjsip_tpfactory *factory;
+    pjsip_tx_data *tdata = NULL;
+    pjsip_transport *tp;
+    pj_status_t status;
+
+    factory = mgr->factory_list.next;
+    while (factory != &mgr->factory_list && factory->type != grp->type)
+        factory = factory->next;
+
+    if (factory == &mgr->factory_list)
+        return PJSIP_EUNSUPTRANSPORT;
+
+    /* Factories get the destination host name from the tdata */
+    if (grp->host.slen) {
+        status = pjsip_tx_data_create(mgr, &tdata);
+        if (status != PJ_SUCCESS)
+            return status;
+        tdata->dest_info.name = grp->host;
+    }
+
+    if (factory->create_transport2) {
+        status = factory->create_transport2(factory, mgr, mgr->endpt,
+                                            &grp->rem_addr, grp->addr_len,
+                                            tdata, &tp);
+    } else {
+        status = factory->create_transport(factory, mgr, mgr->endpt,
+                                           &grp->rem_addr, grp->addr_len,
+                                           &tp);
+    }
+
+    if (tdata)
+        pjsip_tx_data_dec_ref(tdata);
+
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pjsip_transport_add_ref(tp);
+    tp->factory = factory;
+    grp->tp[idx] = tp;
+
+    return PJ_SUCCESS;
+}
+
+/* Replace the connections that have been closed, the manager lock must
+ * be held.
+ */
+static void tpgroup_check(pjsip_tpgroup *grp)
+{
+    unsigned i;
+
+    for (i = 0; i < grp->cfg.conn_cnt; ++i) {
+        pj_status_t status;
+
+        if (tpgroup_tp_usable(grp->tp[i]))
+            continue;
+
+        if (grp->tp[i]) {
+            PJ_LOG(4, (grp->pool->obj_name, "Replacing closed connection %s",
+                       grp->tp[i]->obj_name));
+            pjsip_transport_dec_ref(grp->tp[i]);
+            grp->tp[i] = NULL;
+        }
+
+        status = tpgroup_connect(grp, i);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(3, (grp->pool->obj_name, status,
+                          "Unable to open connection %d", i));
+        }
+    }
+}
+
+static void tpgroup_on_timer(pj_timer_heap_t *th, pj_timer_entry *e)
+{
+    pjsip_tpgroup *grp = (pjsip_tpgroup*) e->user_data;
+    pjsip_tpmgr *mgr = grp->mgr;
+
+    PJ_UNUSED_ARG(th);
+
+    pj_lock_acquire(mgr->lock);
+    if (!grp->is_destroying) {
+        pj_time_val delay;
+
+        tpgroup_check(grp);
+
+        delay.sec = grp->cfg.check_interval;
+        delay.msec = 0;
+        pjsip_endpt_schedule_timer_w_grp_lock(mgr->endpt, &grp->timer,
+                                              &delay, 1, grp->grp_lock);
+    }
+    pj_lock_release(mgr->lock);
+}
+
+static void tpgroup_on_destroy(void *arg)
+{
+    pjsip_tpgroup *grp = (pjsip_tpgroup*) arg;
+
+    pj_pool_safe_release(&grp->pool);
+}
+
+/* Release the connections of the group and remove it from the manager,
+ * the manager lock must be held.
+ */
+static void tpgroup_release(pjsip_tpgroup *grp)
+{
+    unsigned i;
+
+    if (grp->is_destroying)
+        return;
+
+    grp->is_destroying = PJ_TRUE;
+    pj_list_erase(grp);
+    pjsip_endpt_cancel_timer(grp->mgr->endpt, &grp->timer);
+
+    for (i = 0; i < grp->cfg.conn_cnt; ++i) {
+        if (grp->tp[i]) {
+            pjsip_transport_dec_ref(grp->tp[i]);
+            grp->tp[i] = NULL;
+        }
+    }
+
+    pj_grp_lock_dec_ref(grp->grp_lock);
+}
+
+/*
+ * Select a connection of a transport group to the destination, the
+ * manager lock must be held. Returns NULL if there is no such group or
+ * none of its connections is usable.
+ */
+static pjsip_transport *tpgroup_select(pjsip_tpmgr *mgr,
+                                       pjsip_transport_type_e type,
+                                       const pj_sockaddr_t *remote,
+                                       int addr_len,
+                                       const pjsip_tx_data *tdata)
+{
+    unsigned flag = pjsip_transport_get_flag_from_type(type);
+    pjsip_tpgroup *grp;
+
+    for (grp = mgr->tpgroup_list.next; grp != &mgr->tpgroup_list;
+         grp = grp->next)
+    {
+        pjsip_transport *sel_tp = NULL;
+        long min_ref = 0;
+        unsigned i, n = grp->cfg.conn_cnt;
+
+        if (grp->type != type || grp->addr_len != addr_len ||
+            pj_sockaddr_cmp(&grp->rem_addr, remote) != 0)
+        {
+            continue;
+        }
+
+        for (i = 0; i < n; ++i) {
+            unsigned idx = (grp->rr_idx + i) % n;
+            pjsip_transport *tp = grp->tp[idx];
+            long ref;
+
+            if (!tpgroup_tp_usable(tp))
+                continue;
+
+            /* Same host name check as the hash table lookup */
+            if ((flag & PJSIP_TRANSPORT_SECURE) && tdata &&
+                pj_stricmp(&tdata->dest_info.name, &tp->remote_name.host))
+            {
+                continue;
+            }
+
+            if (grp->cfg.sel == PJSIP_TPGROUP_ROUND_ROBIN) {
+                sel_tp = tp;
+                grp->rr_idx = (idx + 1) % n;
+                break;
+            }
+
+            ref = pj_atomic_get(tp->ref_cnt);
+            if (!sel_tp || ref < min_ref) {
+                sel_tp = tp;
+                min_ref = ref;
+            }
+        }
+
+        if (sel_tp)
+            return sel_tp;
+    }
+
+    return NULL;
+}
+
+PJ_DEF(void) pjsip_tpgroup_cfg_default(pjsip_tpgroup_cfg *cfg)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->conn_cnt = PJSIP_TPGROUP_CONN_CNT;
+    cfg->sel = PJSIP_TPGROUP_ROUND_ROBIN;
+    cfg->check_interval = PJSIP_TPGROUP_CHECK_INTERVAL;
+}
+
+/*
+ * Create a transport group.
+ */
+PJ_DEF(pj_status_t) pjsip_tpmgr_create_tpgroup(pjsip_tpmgr *mgr,
+                                               pjsip_transport_type_e type,
+                                               const pj_sockaddr_t *remote,
+                                               int addr_len,
+                                               const pj_str_t *host,
+                                               const pjsip_tpgroup_cfg *cfg,
+                                               pjsip_tpgroup **p_grp)
+{
+    pjsip_tpgroup_cfg default_cfg;
+    pjsip_tpgroup *grp;
+    pj_pool_t *pool;
+    pj_time_val delay;
+    char addr[PJ_INET6_ADDRSTRLEN+10];
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(mgr && remote && p_grp, PJ_EINVAL);
+    PJ_ASSERT_RETURN(addr_len > 0 && addr_len <= (int)sizeof(pj_sockaddr),
+                     PJ_EINVAL);
+    PJ_ASSERT_RETURN(pjsip_transport_get_flag_from_type(type) &
+                     PJSIP_TRANSPORT_RELIABLE, PJSIP_ETPNOTSUITABLE);
+
+    if (!cfg) {
+        pjsip_tpgroup_cfg_default(&default_cfg);
+        cfg = &default_cfg;
+    }
+    PJ_ASSERT_RETURN(cfg->conn_cnt > 0 &&
+                     cfg->conn_cnt <= PJSIP_TPGROUP_MAX_CONN &&
+                     cfg->check_interval > 0, PJ_EINVAL);
+
+    pool = pjsip_endpt_create_pool(mgr->endpt, "tpgrp%p", 512, 512);
+    if (!pool)
+        return PJ_ENOMEM;
+
+    grp = PJ_POOL_ZALLOC_T(pool, pjsip_tpgroup);
+    grp->pool = pool;
+    grp->mgr = mgr;
+    grp->type = type;
+    pj_memcpy(&grp->rem_addr, remote, addr_len);
+    grp->addr_len = addr_len;
+    if (host)
+        pj_strdup(pool, &grp->host, host);
+    pj_memcpy(&grp->cfg, cfg, sizeof(*cfg));
+    pj_timer_entry_init(&grp->timer, 0, grp, &tpgroup_on_timer);
+
+    status = pj_grp_lock_create_w_handler(pool, NULL, grp,
+                                          &tpgroup_on_destroy,
+                                          &grp->grp_lock);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool);
+        return status;
+    }
+    pj_grp_lock_add_ref(grp->grp_lock);
+
+    pj_lock_acquire(mgr->lock);
+
+    tpgroup_check(grp);
+    pj_list_push_back(&mgr->tpgroup_list, grp);
+
+    delay.sec = grp->cfg.check_interval;
+    delay.msec = 0;
+    pjsip_endpt_schedule_timer_w_grp_lock(mgr->endpt, &grp->timer, &delay,
+                                          1, grp->grp_lock);
+
+    pj_lock_release(mgr->lock);
+
+    PJ_LOG(4, (pool->obj_name, "Transport group to %s %s created with %d "
+               "connections", pjsip_transport_get_type_name(type),
+               pj_sockaddr_print(remote, addr, sizeof(addr), 3),
+               cfg->conn_cnt));
+
+    *p_grp = grp;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(unsigned) pjsip_tpgroup_get_conn_cnt(pjsip_tpgroup *grp)
+{
+    unsigned i, cnt = 0;
+
+    PJ_ASSERT_RETURN(grp, 0);
+
+    pj_lock_acquire(grp->mgr->lock);
+    for (i = 0; i < grp->cfg.conn_cnt; ++i) {
+        if (tpgroup_tp_usable(grp->tp[i]))
+            ++cnt;
+    }
+    pj_lock_release(grp->mgr->lock);
+
+    return cnt;
+}
+
+PJ_DEF(pj_status_t) pjsip_tpgroup_destroy(pjsip_tpgroup *grp)
+{
+    pjsip_tpmgr *mgr;
+
+    PJ_ASSERT_RETURN(grp, PJ_EINVAL);
+
+    mgr = grp->mgr;
+    pj_lock_acquire(mgr->lock);
+    tpgroup_release(grp);
+    pj_lock_release(mgr->lock);
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * pjsip_tpmgr_acquire_transport()
  *
@@ -2461,6 +3457,8 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_acquire_transport2(pjsip_tpmgr *mgr,
                                                    pjsip_transport **tp)
 {
     pjsip_tpfactory *factory;
+    pjsip_tpcache *cache = NULL;
+    unsigned gen = 0;
     pj_status_t status;
 
     TRACE_((THIS_FILE, "Acquiring transport type=%s, sel=%s remote=%s:%d "
@@ -2472,6 +3470,25 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_acquire_transport2(pjsip_tpmgr *mgr,
                        tdata? tdata->dest_info.name.slen : 10,
                        tdata? tdata->dest_info.name.ptr  : "-no tdata-"));
 
+    /* Try the transport cache first, unless a specific transport or
+     * listener is requested or connection reuse is disabled.
+     */
+    if (tdata && tdata->tp_cache &&
+        (!sel || (sel->type == PJSIP_TPSELECTOR_NONE &&
+                  !sel->disable_connection_reuse)))
+    {
+        pjsip_transport *cached;
+
+        cache = tdata->tp_cache;
+        cached = tpcache_get(mgr, type, remote, addr_len, tdata);
+        if (cached) {
+            *tp = cached;
+            TRACE_((THIS_FILE, "Transport %s acquired from cache",
+                               cached->obj_name));
+            return PJ_SUCCESS;
+        }
+    }
+
     pj_lock_acquire(mgr->lock);
 
     TRACE_((THIS_FILE, "Acquiring transport got the lock"));
@@ -2550,7 +3567,22 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_acquire_transport2(pjsip_tpmgr *mgr,
             }
         }
 
-        if (!sel || sel->disable_connection_reuse == PJ_FALSE) {
+        /* Use a connection of the transport group to the destination,
+         * if there is one.
+         */
+        if (!pj_list_empty(&mgr->tpgroup_list) &&
+            (!sel || (sel->type != PJSIP_TPSELECTOR_LISTENER &&
+                      sel->disable_connection_reuse == PJ_FALSE)))
+        {
+            tp_ref = tpgroup_select(mgr, type, remote, addr_len, tdata);
+
+            TRACE_((THIS_FILE, "Search transport group found %s",
+                               tp_ref? tp_ref->obj_name : "none"));
+        }
+
+        if (tp_ref == NULL &&
+            (!sel || sel->disable_connection_reuse == PJ_FALSE))
+        {
             pj_bzero(&key, sizeof(key));
             key_len = sizeof(key.type) + addr_len;
 
@@ -2677,9 +3709,13 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_acquire_transport2(pjsip_tpmgr *mgr,
              * Transport found!
              */
             pjsip_transport_add_ref(tp_ref);
+            gen = mgr->tp_gen;
             pj_lock_release(mgr->lock);
             *tp = tp_ref;
 
+            if (cache)
+                tpcache_put(cache, tp_ref, type, remote, addr_len, gen);
+
             TRACE_((THIS_FILE, "Transport %s acquired", tp_ref->obj_name));
             return PJ_SUCCESS;
         }
@@ -2757,8 +3793,13 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_acquire_transport2(pjsip_tpmgr *mgr,
             {pj_lock_release(mgr->lock); return PJ_EBUG;});
         pjsip_transport_add_ref(*tp);
         (*tp)->factory = factory;
+        gen = mgr->tp_gen;
     }
     pj_lock_release(mgr->lock);
+
+    if (status == PJ_SUCCESS && cache)
+        tpcache_put(cache, *tp, type, remote, addr_len, gen);
+
     return status;
 }
 
@@ -2779,6 +3820,9 @@ PJ_DEF(void) pjsip_tpmgr_dump_transports(pjsip_tpmgr *mgr)
               pj_atomic_get(mgr->tdata_counter)));
 #endif
 
+    pool_cache_dump(mgr->tdata_pools, "Transmit data");
+    pool_cache_dump(mgr->rdata_pools, "Receive data");
+
     PJ_LOG(3, (THIS_FILE, " Dumping listeners:"));
     factory = mgr->factory_list.next;
     while (factory != &mgr->factory_list) {
@@ -2791,6 +3835,29 @@ PJ_DEF(void) pjsip_tpmgr_dump_transports(pjsip_tpmgr *mgr)
         factory = factory->next;
     }
 
+    if (!pj_list_empty(&mgr->tpgroup_list)) {
+        pjsip_tpgroup *grp;
+
+        PJ_LOG(3, (THIS_FILE, " Dumping transport groups:"));
+        for (grp = mgr->tpgroup_list.next; grp != &mgr->tpgroup_list;
+             grp = grp->next)
+        {
+            char addr[PJ_INET6_ADDRSTRLEN+10];
+            unsigned i, cnt = 0;
+
+            for (i = 0; i < grp->cfg.conn_cnt; ++i) {
+                if (tpgroup_tp_usable(grp->tp[i]))
+                    ++cnt;
+            }
+            PJ_LOG(3, (THIS_FILE, "  %s %s %s: %d/%d connections",
+                       grp->pool->obj_name,
+                       pjsip_transport_get_type_name(grp->type),
+                       pj_sockaddr_print(&grp->rem_addr, addr,
+                                         sizeof(addr), 3),
+                       cnt, grp->cfg.conn_cnt));
+        }
+    }
+
     itr = pj_hash_first(mgr->table, &itr_val);
     if (itr) {
         PJ_LOG(3, (THIS_FILE, " Dumping transports:"));
@@ -118,6 +118,12 @@ struct tcp_transport
      */
     pjsip_rx_data            rdata;
 
+    /* Where the rdata pool goes back to when the transport is destroyed */
+    pjsip_pool_cache        *rdata_pool_cache;
+
+    /* Overflow buffer and state of partially received message */
+    pjsip_rx_stream          rx_stream;
+
     /* Pending transmission list. */
     struct delayed_tdata     delayed_list;
 
@@ -884,8 +890,11 @@ static void tcp_on_destroy(void *arg)
         tcp->base.ref_cnt = NULL;
     }
 
+    pjsip_rx_stream_reset(&tcp->rx_stream);
+
     if (tcp->rdata.tp_info.pool) {
-        pj_pool_release(tcp->rdata.tp_info.pool);
+        pjsip_pool_cache_release(tcp->rdata_pool_cache,
+                                 tcp->rdata.tp_info.pool, PJ_FALSE);
         tcp->rdata.tp_info.pool = NULL;
     }
 
@@ -926,17 +935,16 @@ static pj_status_t tcp_start_read(struct tcp_transport *tcp)
     void *readbuf[1];
     pj_status_t status;
 
-    /* Init rdata */
-    pool = pjsip_endpt_create_pool(tcp->base.endpt,
-                                   "rtd%p",
-                                   PJSIP_POOL_RDATA_LEN,
-                                   PJSIP_POOL_RDATA_INC);
+    /* Init rdata, the pool may be recycled from a closed connection */
+    pool = pjsip_tpmgr_create_rdata_pool(pjsip_endpt_get_tpmgr(tcp->base.endpt),
+                                         &tcp->rdata_pool_cache);
     if (!pool) {
         tcp_perror(tcp->base.obj_name, "Unable to create pool", PJ_ENOMEM);
         return PJ_ENOMEM;
     }
 
     tcp->rdata.tp_info.pool = pool;
+    pjsip_rx_stream_init(&tcp->rx_stream, pjsip_cfg()->tcp.max_msg_len);
 
     tcp->rdata.tp_info.transport = &tcp->base;
     tcp->rdata.tp_info.tp_data = tcp;
@@ -1409,8 +1417,6 @@ static pj_bool_t on_data_read(pj_activesock_t *asock,
      * to be parsed.
      */
     if (status == PJ_SUCCESS) {
-        pj_size_t size_eaten;
-
         /* Mark this as an activity */
         pj_gettimeofday(&tcp->last_activity);
 
@@ -1422,22 +1428,15 @@ static pj_bool_t on_data_read(pj_activesock_t *asock,
         pj_gettimeofday(&rdata->pkt_info.timestamp);
 
         /* Report to transport manager.
-         * The transport manager will tell us how many bytes of the packet
-         * have been processed (as valid SIP message).
+         * The transport manager will tell us how many bytes of partial
+         * message it has left at the front of the buffer, larger partial
+         * messages are kept in the overflow buffer of the stream.
          */
-        size_eaten = 
-            pjsip_tpmgr_receive_packet(rdata->tp_info.transport->tpmgr, 
-                                       rdata);
-
-        pj_assert(size_eaten <= (pj_size_t)rdata->pkt_info.len);
-
-        /* Move unprocessed data to the front of the buffer */
-        *remainder = size - size_eaten;
-        if (*remainder > 0 && *remainder != size) {
-            pj_memmove(rdata->pkt_info.packet,
-                       rdata->pkt_info.packet + size_eaten,
-                       *remainder);
-        }
+        *remainder = 
+            pjsip_tpmgr_receive_stream(rdata->tp_info.transport->tpmgr, 
+                                       rdata, &tcp->rx_stream);
+
+        pj_assert(*remainder < sizeof(rdata->pkt_info.packet));
 
     } else {
 
@@ -108,6 +108,12 @@ struct tls_transport
      */
     pjsip_rx_data            rdata;
 
+    /* Where the rdata pool goes back to when the transport is destroyed */
+    pjsip_pool_cache        *rdata_pool_cache;
+
+    /* Overflow buffer and state of partially received message */
+    pjsip_rx_stream          rx_stream;
+
     /* Pending transmission list. */
     struct delayed_tdata     delayed_list;
 
@@ -1050,8 +1056,13 @@ static void tls_on_destroy(void *arg)
 {
     struct tls_transport *tls = (struct tls_transport*)arg;
 
+    pjsip_rx_stream_reset(&tls->rx_stream);
+
     if (tls->rdata.tp_info.pool) {
-        pj_pool_secure_release(&tls->rdata.tp_info.pool);
+        /* The pool is wiped before it's recycled or released */
+        pjsip_pool_cache_release(tls->rdata_pool_cache,
+                                 tls->rdata.tp_info.pool, PJ_TRUE);
+        tls->rdata.tp_info.pool = NULL;
     }
 
     if (tls->base.lock) {
@@ -1153,11 +1164,9 @@ static pj_status_t tls_start_read(struct tls_transport *tls)
     void *readbuf[1];
     pj_status_t status;
 
-    /* Init rdata */
-    pool = pjsip_endpt_create_pool(tls->base.endpt,
-                                   "rtd%p",
-                                   PJSIP_POOL_RDATA_LEN,
-                                   PJSIP_POOL_RDATA_INC);
+    /* Init rdata, the pool may be recycled from a closed connection */
+    pool = pjsip_tpmgr_create_rdata_pool(pjsip_endpt_get_tpmgr(tls->base.endpt),
+                                         &tls->rdata_pool_cache);
     if (!pool) {
         tls_perror(tls->base.obj_name, "Unable to create pool", PJ_ENOMEM,
                    NULL);
@@ -1165,6 +1174,7 @@ static pj_status_t tls_start_read(struct tls_transport *tls)
     }
 
     tls->rdata.tp_info.pool = pool;
+    pjsip_rx_stream_init(&tls->rx_stream, pjsip_cfg()->tls.max_msg_len);
 
     tls->rdata.tp_info.transport = &tls->base;
     tls->rdata.tp_info.tp_data = tls;
@@ -1835,8 +1845,6 @@ static pj_bool_t on_data_read(pj_ssl_sock_t *ssock,
      * to be parsed.
      */
     if (status == PJ_SUCCESS) {
-        pj_size_t size_eaten;
-
         /* Mark this as an activity */
         pj_gettimeofday(&tls->last_activity);
 
@@ -1848,22 +1856,15 @@ static pj_bool_t on_data_read(pj_ssl_sock_t *ssock,
         pj_gettimeofday(&rdata->pkt_info.timestamp);
 
         /* Report to transport manager.
-         * The transport manager will tell us how many bytes of the packet
-         * have been processed (as valid SIP message).
+         * The transport manager will tell us how many bytes of partial
+         * message it has left at the front of the buffer, larger partial
+         * messages are kept in the overflow buffer of the stream.
          */
-        size_eaten = 
-            pjsip_tpmgr_receive_packet(rdata->tp_info.transport->tpmgr, 
-                                       rdata);
-
-        pj_assert(size_eaten <= (pj_size_t)rdata->pkt_info.len);
-
-        /* Move unprocessed data to the front of the buffer */
-        *remainder = size - size_eaten;
-        if (*remainder > 0 && *remainder != size) {
-            pj_memmove(rdata->pkt_info.packet,
-                       rdata->pkt_info.packet + size_eaten,
-                       *remainder);
-        }
+        *remainder = 
+            pjsip_tpmgr_receive_stream(rdata->tp_info.transport->tpmgr, 
+                                       rdata, &tls->rx_stream);
+
+        pj_assert(*remainder < sizeof(rdata->pkt_info.packet));
 
     } else {
 
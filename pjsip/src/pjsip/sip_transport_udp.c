@@ -65,6 +65,28 @@
 #endif
 
 
+/* Statistic counters are updated with relaxed atomic add where available.
+ * Otherwise they are updated without synchronization, since they are only
+ * informational.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE==2
+#   define STAT_ADD(c, v)   __atomic_fetch_add(&(c), (pj_uint64_t)(v), \
+                                               __ATOMIC_RELAXED)
+#   define STAT_GET(c)      __atomic_load_n(&(c), __ATOMIC_RELAXED)
+#else
+#   define STAT_ADD(c, v)   ((c) += (pj_uint64_t)(v))
+#   define STAT_GET(c)      (c)
+#endif
+
+
+/* Additional socket of a multi-socket transport */
+struct udp_sock
+{
+    pj_sock_t           sock;
+    pj_ioqueue_key_t   *key;
+};
+
 /* Struct udp_transport "inherits" struct pjsip_transport */
 struct udp_transport
 {
@@ -77,11 +99,34 @@ struct udp_transport
     pj_bool_t           is_paused;
     int                 read_loop_spin;
 
+    /* Read slots per socket, rdata are laid out socket by socket */
+    unsigned            async_cnt;
+
+    /* Number of active sockets, including the first one (sock) */
+    unsigned            sock_cnt;
+    unsigned            max_sock_cnt;
+    struct udp_sock    *ext_sock;
+
+    /* Socket buffer sizes */
+    unsigned            rcvbuf_size;
+    unsigned            sndbuf_size;
+
+    /* Statistics, per socket */
+    pjsip_udp_transport_stat *stat;
+
     /* Group lock to be used by UDP transport and ioqueue key */
     pj_grp_lock_t      *grp_lock;
 };
 
 
+/* Get the ioqueue key of the socket */
+static pj_ioqueue_key_t *get_sock_key(struct udp_transport *tp,
+                                      unsigned sock_idx)
+{
+    return sock_idx ? tp->ext_sock[sock_idx-1].key : tp->key;
+}
+
+
 /*
  * Initialize transport's receive buffer from the specified pool.
  */
@@ -126,9 +171,13 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
     pjsip_rx_data_op_key *rdata_op_key = (pjsip_rx_data_op_key*) op_key;
     pjsip_rx_data *rdata = rdata_op_key->rdata;
     struct udp_transport *tp = (struct udp_transport*)rdata->tp_info.transport;
+    pjsip_udp_transport_stat *stat;
     int i;
     pj_status_t status;
 
+    stat = &tp->stat[(unsigned)(pj_ssize_t)rdata->tp_info.tp_data /
+                     tp->async_cnt];
+
     ++tp->read_loop_spin;
 
     /* Don't do anything if transport is closing. */
@@ -189,6 +238,9 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
                               sizeof(rdata->pkt_info.src_name), 0);
             rdata->pkt_info.src_port = pj_sockaddr_get_port(src_addr);
 
+            STAT_ADD(stat->rx_pkt, 1);
+            STAT_ADD(stat->rx_bytes, bytes_read);
+
             size_eaten = 
                 pjsip_tpmgr_receive_packet(rdata->tp_info.transport->tpmgr, 
                                            rdata);
@@ -198,17 +250,26 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
                 size_eaten = rdata->pkt_info.len;
             }
 
+            if (rdata->msg_info.msg == NULL ||
+                !pj_list_empty(&rdata->msg_info.parse_err))
+            {
+                STAT_ADD(stat->rx_parse_err, 1);
+            }
+
             /* Since this is UDP, the whole buffer is the message. */
             rdata->pkt_info.len = 0;
 
         } else if (bytes_read >= 0 && bytes_read <= MIN_SIZE) {
 
-            /* TODO: */
+            /* Too short to be a SIP message */
+            if (bytes_read > 0)
+                STAT_ADD(stat->rx_drop, 1);
 
         } else if (-bytes_read != PJ_STATUS_FROM_OS(OSERR_EWOULDBLOCK) &&
                    -bytes_read != PJ_STATUS_FROM_OS(OSERR_EINPROGRESS) && 
                    -bytes_read != PJ_STATUS_FROM_OS(OSERR_ECONNRESET)) 
         {
+            STAT_ADD(stat->rx_err, 1);
 
             /* Report error to endpoint. */
             PJSIP_ENDPT_LOG_ERROR((rdata->tp_info.transport->endpt,
@@ -283,6 +344,7 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
                     status != PJ_STATUS_FROM_OS(OSERR_EINPROGRESS) && 
                     status != PJ_STATUS_FROM_OS(OSERR_ECONNRESET)) 
                 {
+                    STAT_ADD(stat->rx_err, 1);
                     PJSIP_ENDPT_LOG_ERROR((rdata->tp_info.transport->endpt,
                                            rdata->tp_info.transport->obj_name,
                                            status, 
@@ -325,6 +387,13 @@ static void udp_on_write_complete( pj_ioqueue_key_t *key,
 
     tdata_op_key->tdata = NULL;
 
+    if (bytes_sent > 0) {
+        STAT_ADD(tp->stat[0].tx_pkt, 1);
+        STAT_ADD(tp->stat[0].tx_bytes, bytes_sent);
+    } else {
+        STAT_ADD(tp->stat[0].tx_err, 1);
+    }
+
 #if 0
     /* Auto restart is disabled, see #2881 */
     if (-bytes_sent == PJ_ESOCKETSTOP) {
@@ -386,6 +455,13 @@ static pj_status_t udp_send_msg( pjsip_transport *transport,
                                tdata->buf.start, &size, 0,
                                rem_addr, addr_len);
 
+    if (status == PJ_SUCCESS) {
+        STAT_ADD(tp->stat[0].tx_pkt, 1);
+        STAT_ADD(tp->stat[0].tx_bytes, size);
+    } else if (status != PJ_EPENDING) {
+        STAT_ADD(tp->stat[0].tx_err, 1);
+    }
+
     if (status != PJ_EPENDING) {
 #if 0
         /* Auto restart is disabled, see #2881 */
@@ -438,6 +514,28 @@ static void udp_on_destroy(void *arg)
 }
 
 
+/* Close the additional sockets of the transport */
+static void close_ext_socks(struct udp_transport *tp)
+{
+    unsigned i;
+
+    for (i = 1; i < tp->sock_cnt; ++i) {
+        struct udp_sock *us = &tp->ext_sock[i-1];
+
+        if (us->key) {
+            /* This implicitly closes the socket */
+            pj_ioqueue_unregister(us->key);
+            us->key = NULL;
+        } else if (us->sock != PJ_INVALID_SOCKET) {
+            pj_sock_close(us->sock);
+        }
+        us->sock = PJ_INVALID_SOCKET;
+    }
+
+    tp->sock_cnt = 1;
+}
+
+
 /*
  * udp_destroy()
  *
@@ -465,6 +563,7 @@ static pj_status_t udp_destroy( pjsip_transport *transport )
     */
 
     /* Unregister from ioqueue. */
+    close_ext_socks(tp);
     if (tp->key) {
         pj_ioqueue_unregister(tp->key);
         tp->key = NULL;
@@ -524,9 +623,25 @@ static pj_status_t udp_shutdown(pjsip_transport *transport)
 }
 
 
+/* Enable SO_REUSEPORT, so several sockets can share the address */
+static pj_status_t set_reuse_port(pj_sock_t sock)
+{
+#if defined(SO_REUSEPORT)
+    int enabled = 1;
+
+    return pj_sock_setsockopt(sock, pj_SOL_SOCKET(), (pj_uint16_t)SO_REUSEPORT,
+                              &enabled, sizeof(enabled));
+#else
+    PJ_UNUSED_ARG(sock);
+    return PJ_ENOTSUP;
+#endif
+}
+
+
 /* Create socket */
 static pj_status_t create_socket(int af, const pj_sockaddr_t *local_a,
-                                 int addr_len, pj_sock_t *p_sock)
+                                 int addr_len, pj_bool_t reuse_port,
+                                 pj_sock_t *p_sock)
 {
     pj_sock_t sock;
     pj_sockaddr_in tmp_addr;
@@ -537,6 +652,14 @@ static pj_status_t create_socket(int af, const pj_sockaddr_t *local_a,
     if (status != PJ_SUCCESS)
         return status;
 
+    if (reuse_port) {
+        status = set_reuse_port(sock);
+        if (status != PJ_SUCCESS) {
+            pj_sock_close(sock);
+            return status;
+        }
+    }
+
     if (local_a == NULL) {
         if (af == pj_AF_INET6()) {
             pj_bzero(&tmp_addr6, sizeof(tmp_addr6));
@@ -660,35 +783,45 @@ static void udp_set_pub_name(struct udp_transport *tp,
     PJ_CHECK_TRUNC_STR(len, tp->base.info, INFO_LEN);
 }
 
-/* Set the socket handle of the transport */
-static void udp_set_socket(struct udp_transport *tp,
-                           pj_sock_t sock,
-                           const pjsip_host_port *a_name)
+/* Adjust socket send and receive buffer sizes */
+static void udp_set_sobuf(struct udp_transport *tp, pj_sock_t sock)
 {
-#if PJSIP_UDP_SO_RCVBUF_SIZE || PJSIP_UDP_SO_SNDBUF_SIZE
-    long sobuf_size;
+    unsigned sobuf_size;
     pj_status_t status;
-#endif
 
     /* Adjust socket rcvbuf size */
-#if PJSIP_UDP_SO_RCVBUF_SIZE
-    sobuf_size = PJSIP_UDP_SO_RCVBUF_SIZE;
-    status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_RCVBUF(),
-                                &sobuf_size, sizeof(sobuf_size));
-    if (status != PJ_SUCCESS) {
-        PJ_PERROR(4,(THIS_FILE, status, "Error setting SO_RCVBUF"));
+    if (tp->rcvbuf_size) {
+        sobuf_size = tp->rcvbuf_size;
+        status = pj_sock_setsockopt_sobuf(sock, pj_SO_RCVBUF(), PJ_TRUE,
+                                          &sobuf_size);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(4,(THIS_FILE, status, "Error setting SO_RCVBUF"));
+        } else {
+            PJ_LOG(5,(tp->base.obj_name, "SO_RCVBUF set to %u (requested "
+                      "%u)", sobuf_size, tp->rcvbuf_size));
+        }
     }
-#endif
 
     /* Adjust socket sndbuf size */
-#if PJSIP_UDP_SO_SNDBUF_SIZE
-    sobuf_size = PJSIP_UDP_SO_SNDBUF_SIZE;
-    status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_SNDBUF(),
-                                &sobuf_size, sizeof(sobuf_size));
-    if (status != PJ_SUCCESS) {
-        PJ_PERROR(4,(THIS_FILE, status, "Error setting SO_SNDBUF"));
+    if (tp->sndbuf_size) {
+        sobuf_size = tp->sndbuf_size;
+        status = pj_sock_setsockopt_sobuf(sock, pj_SO_SNDBUF(), PJ_TRUE,
+                                          &sobuf_size);
+        if (status != PJ_SUCCESS) {
+            PJ_PERROR(4,(THIS_FILE, status, "Error setting SO_SNDBUF"));
+        } else {
+            PJ_LOG(5,(tp->base.obj_name, "SO_SNDBUF set to %u (requested "
+                      "%u)", sobuf_size, tp->sndbuf_size));
+        }
     }
-#endif
+}
+
+/* Set the socket handle of the transport */
+static void udp_set_socket(struct udp_transport *tp,
+                           pj_sock_t sock,
+                           const pjsip_host_port *a_name)
+{
+    udp_set_sobuf(tp, sock);
 
     /* Set the socket. */
     tp->sock = sock;
@@ -702,12 +835,9 @@ static pj_status_t register_to_ioqueue(struct udp_transport *tp)
 {
     pj_ioqueue_t *ioqueue;
     pj_ioqueue_callback ioqueue_cb;
+    unsigned i;
     pj_status_t status;
 
-    /* Ignore if already registered */
-    if (tp->key != NULL)
-        return PJ_SUCCESS;
-
     /* Create group lock if not yet (don't need to do so on UDP restart) */
     if (!tp->grp_lock) {
         status = pj_grp_lock_create(tp->base.pool, NULL, &tp->grp_lock);
@@ -727,23 +857,45 @@ static pj_status_t register_to_ioqueue(struct udp_transport *tp)
     ioqueue_cb.on_read_complete = &udp_on_read_complete;
     ioqueue_cb.on_write_complete = &udp_on_write_complete;
 
-    return pj_ioqueue_register_sock2(tp->base.pool, ioqueue, tp->sock,
-                                     tp->grp_lock, tp, &ioqueue_cb, &tp->key);
+    /* Ignore sockets which are already registered */
+    if (tp->key == NULL) {
+        status = pj_ioqueue_register_sock2(tp->base.pool, ioqueue, tp->sock,
+                                           tp->grp_lock, tp, &ioqueue_cb,
+                                           &tp->key);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+
+    for (i = 1; i < tp->sock_cnt; ++i) {
+        struct udp_sock *us = &tp->ext_sock[i-1];
+
+        if (us->key != NULL)
+            continue;
+
+        status = pj_ioqueue_register_sock2(tp->base.pool, ioqueue, us->sock,
+                                           tp->grp_lock, tp, &ioqueue_cb,
+                                           &us->key);
+        if (status != PJ_SUCCESS)
+            return status;
+    }
+
+    return PJ_SUCCESS;
 }
 
 /* Start ioqueue asynchronous reading to all rdata */
 static pj_status_t start_async_read(struct udp_transport *tp)
 {
-    int i;
+    unsigned i;
     pj_status_t status;
 
-    /* Start reading the ioqueue. */
-    for (i=0; i<tp->rdata_cnt; ++i) {
+    /* Start reading the ioqueue, on the rdata of active sockets. */
+    for (i=0; i<tp->async_cnt * tp->sock_cnt; ++i) {
+        pj_ioqueue_key_t *key = get_sock_key(tp, i / tp->async_cnt);
         pj_ssize_t size;
 
         size = sizeof(tp->rdata[i]->pkt_info.packet);
         tp->rdata[i]->pkt_info.src_addr_len = sizeof(tp->rdata[i]->pkt_info.src_addr);
-        status = pj_ioqueue_recvfrom(tp->key, 
+        status = pj_ioqueue_recvfrom(key, 
                                      &tp->rdata[i]->tp_info.op_key.op_key,
                                      tp->rdata[i]->pkt_info.packet,
                                      &size, PJ_IOQUEUE_ALWAYS_ASYNC,
@@ -751,7 +903,7 @@ static pj_status_t start_async_read(struct udp_transport *tp)
                                      &tp->rdata[i]->pkt_info.src_addr_len);
         if (status == PJ_SUCCESS) {
             pj_assert(!"Shouldn't happen because PJ_IOQUEUE_ALWAYS_ASYNC!");
-            udp_on_read_complete(tp->key, &tp->rdata[i]->tp_info.op_key.op_key,
+            udp_on_read_complete(key, &tp->rdata[i]->tp_info.op_key.op_key,
                                  size);
         } else if (status != PJ_EPENDING) {
             /* Error! */
@@ -770,19 +922,22 @@ static pj_status_t start_async_read(struct udp_transport *tp)
  */
 static pj_status_t transport_attach( pjsip_endpoint *endpt,
                                      pjsip_transport_type_e type,
-                                     pj_sock_t sock,
+                                     const pj_sock_t sock[],
                                      const pjsip_host_port *a_name,
-                                     unsigned async_cnt,
+                                     const pjsip_udp_transport_cfg *cfg,
                                      pjsip_transport **p_transport)
 {
     pj_pool_t *pool;
     struct udp_transport *tp;
     const char *format, *ipv6_quoteb = "", *ipv6_quotee = "";
-    unsigned i;
+    unsigned i, async_cnt, sock_cnt;
     pj_status_t status;
 
-    PJ_ASSERT_RETURN(endpt && sock!=PJ_INVALID_SOCKET && a_name && async_cnt>0,
-                     PJ_EINVAL);
+    PJ_ASSERT_RETURN(endpt && sock && sock[0]!=PJ_INVALID_SOCKET && a_name &&
+                     cfg && cfg->async_cnt>0 && cfg->sock_cnt>0, PJ_EINVAL);
+
+    async_cnt = cfg->async_cnt;
+    sock_cnt = cfg->sock_cnt;
 
     /* Object name. */
     if (type & PJSIP_TRANSPORT_IPV6) {
@@ -812,6 +967,20 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
     /* Save pool. */
     tp->base.pool = pool;
 
+    /* Sockets and read slots */
+    tp->sock = PJ_INVALID_SOCKET;
+    tp->async_cnt = async_cnt;
+    tp->sock_cnt = 1;
+    tp->max_sock_cnt = sock_cnt;
+    tp->rcvbuf_size = cfg->rcvbuf_size;
+    tp->sndbuf_size = cfg->sndbuf_size;
+    tp->stat = (pjsip_udp_transport_stat*)
+               pj_pool_calloc(pool, sock_cnt, sizeof(tp->stat[0]));
+    if (sock_cnt > 1) {
+        tp->ext_sock = (struct udp_sock*)
+                       pj_pool_calloc(pool, sock_cnt-1, sizeof(tp->ext_sock[0]));
+    }
+
     pj_memcpy(tp->base.obj_name, pool->obj_name, PJ_MAX_OBJ_NAME);
 
     /* Init reference counter. */
@@ -843,7 +1012,7 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
     tp->base.addr_len = sizeof(tp->base.local_addr);
 
     /* Init local address. */
-    status = pj_sock_getsockname(sock, &tp->base.local_addr, 
+    status = pj_sock_getsockname(sock[0], &tp->base.local_addr, 
                                  &tp->base.addr_len);
     if (status != PJ_SUCCESS)
         goto on_error;
@@ -864,7 +1033,14 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
     /* Transport manager and timer will be initialized by tpmgr */
 
     /* Attach socket and assign name. */
-    udp_set_socket(tp, sock, a_name);
+    udp_set_socket(tp, sock[0], a_name);
+
+    /* Attach the additional sockets */
+    for (i = 1; i < sock_cnt; ++i) {
+        udp_set_sobuf(tp, sock[i]);
+        tp->ext_sock[i-1].sock = sock[i];
+    }
+    tp->sock_cnt = sock_cnt;
 
     /* Register to ioqueue */
     status = register_to_ioqueue(tp);
@@ -891,9 +1067,9 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
     /* Create rdata and put it in the array. */
     tp->rdata_cnt = 0;
     tp->rdata = (pjsip_rx_data**)
-                pj_pool_calloc(tp->base.pool, async_cnt, 
+                pj_pool_calloc(tp->base.pool, async_cnt * sock_cnt, 
                                sizeof(pjsip_rx_data*));
-    for (i=0; i<async_cnt; ++i) {
+    for (i=0; i<async_cnt * sock_cnt; ++i) {
         pj_pool_t *rdata_pool = pjsip_endpt_create_pool(endpt, "rtd%p", 
                                                         PJSIP_POOL_RDATA_LEN,
                                                         PJSIP_POOL_RDATA_INC);
@@ -919,17 +1095,24 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
         *p_transport = &tp->base;
     
     PJ_LOG(4,(tp->base.obj_name, 
-              "SIP %s started, published address is %s%.*s%s:%d",
+              "SIP %s started, published address is %s%.*s%s:%d, "
+              "%d socket(s) with %d read slot(s) each",
               pjsip_transport_get_type_desc((pjsip_transport_type_e)tp->base.key.type),
               ipv6_quoteb,
               (int)tp->base.local_name.host.slen,
               tp->base.local_name.host.ptr,
               ipv6_quotee,
-              tp->base.local_name.port));
+              tp->base.local_name.port,
+              sock_cnt, async_cnt));
 
     return PJ_SUCCESS;
 
 on_error:
+    /* The additional sockets are owned by the transport */
+    if (tp->sock == PJ_INVALID_SOCKET) {
+        for (i = 1; i < sock_cnt; ++i)
+            pj_sock_close(sock[i]);
+    }
     udp_destroy((pjsip_transport*)tp);
     return status;
 }
@@ -941,8 +1124,8 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_attach( pjsip_endpoint *endpt,
                                                 unsigned async_cnt,
                                                 pjsip_transport **p_transport)
 {
-    return transport_attach(endpt, PJSIP_TRANSPORT_UDP, sock, a_name,
-                            async_cnt, p_transport);
+    return pjsip_udp_transport_attach2(endpt, PJSIP_TRANSPORT_UDP, sock,
+                                       a_name, async_cnt, p_transport);
 }
 
 PJ_DEF(pj_status_t) pjsip_udp_transport_attach2( pjsip_endpoint *endpt,
@@ -952,8 +1135,13 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_attach2( pjsip_endpoint *endpt,
                                                  unsigned async_cnt,
                                                  pjsip_transport **p_transport)
 {
-    return transport_attach(endpt, type, sock, a_name,
-                            async_cnt, p_transport);
+    pjsip_udp_transport_cfg cfg;
+
+    pjsip_udp_transport_cfg_default(&cfg, (type & PJSIP_TRANSPORT_IPV6) ?
+                                          pj_AF_INET6() : pj_AF_INET());
+    cfg.async_cnt = async_cnt;
+
+    return transport_attach(endpt, type, &sock, a_name, &cfg, p_transport);
 }
 
 
@@ -967,6 +1155,9 @@ PJ_DEF(void) pjsip_udp_transport_cfg_default(pjsip_udp_transport_cfg *cfg,
     cfg->af = af;
     pj_sockaddr_init(cfg->af, &cfg->bind_addr, NULL, 0);
     cfg->async_cnt = 1;
+    cfg->sock_cnt = 1;
+    cfg->rcvbuf_size = PJSIP_UDP_SO_RCVBUF_SIZE;
+    cfg->sndbuf_size = PJSIP_UDP_SO_SNDBUF_SIZE;
 }
 
 
@@ -980,15 +1171,18 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start2(
                                         const pjsip_udp_transport_cfg *cfg,
                                         pjsip_transport **p_transport)
 {
-    pj_sock_t sock;
+    pj_sock_t sock[PJSIP_UDP_MAX_SOCK_CNT];
     pj_status_t status;
     pjsip_host_port addr_name;
     char addr_buf[PJ_INET6_ADDRSTRLEN];
     pjsip_transport_type_e transport_type;
+    pj_sockaddr bound_addr;
     pj_uint16_t af;
     int addr_len;
+    unsigned i;
 
-    PJ_ASSERT_RETURN(endpt && cfg && cfg->async_cnt, PJ_EINVAL);
+    PJ_ASSERT_RETURN(endpt && cfg && cfg->async_cnt && cfg->sock_cnt &&
+                     cfg->sock_cnt <= PJSIP_UDP_MAX_SOCK_CNT, PJ_EINVAL);
 
     if (cfg->bind_addr.addr.sa_family == pj_AF_INET()) {
         af = pj_AF_INET();
@@ -1000,35 +1194,62 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start2(
         addr_len = sizeof(pj_sockaddr_in6);
     }
 
-    status = create_socket(af, &cfg->bind_addr, addr_len, &sock);
+    for (i = 0; i < cfg->sock_cnt; ++i)
+        sock[i] = PJ_INVALID_SOCKET;
+
+    status = create_socket(af, &cfg->bind_addr, addr_len, cfg->sock_cnt > 1,
+                           &sock[0]);
     if (status != PJ_SUCCESS)
         return status;
 
-    /* Apply QoS, if specified */
-    pj_sock_apply_qos2(sock, cfg->qos_type, &cfg->qos_params,
-                       2, THIS_FILE, "SIP UDP transport");
+    /* The additional sockets are bound to the address that the first
+     * socket is bound to, in case the port was chosen by the system.
+     */
+    if (cfg->sock_cnt > 1) {
+        addr_len = sizeof(bound_addr);
+        status = pj_sock_getsockname(sock[0], &bound_addr, &addr_len);
+        if (status != PJ_SUCCESS)
+            goto on_error;
+
+        for (i = 1; i < cfg->sock_cnt; ++i) {
+            status = create_socket(af, &bound_addr, addr_len, PJ_TRUE,
+                                   &sock[i]);
+            if (status != PJ_SUCCESS)
+                goto on_error;
+        }
+    }
 
-    /* Apply sockopt, if specified */
-    if (cfg->sockopt_params.cnt)
-        pj_sock_setsockopt_params(sock, &cfg->sockopt_params);
+    for (i = 0; i < cfg->sock_cnt; ++i) {
+        /* Apply QoS, if specified */
+        pj_sock_apply_qos2(sock[i], cfg->qos_type, &cfg->qos_params,
+                           2, THIS_FILE, "SIP UDP transport");
+
+        /* Apply sockopt, if specified */
+        if (cfg->sockopt_params.cnt)
+            pj_sock_setsockopt_params(sock[i], &cfg->sockopt_params);
+    }
 
     if (cfg->addr_name.host.slen == 0) {
         /* Address name is not specified.
          * Build a name based on bound address.
          */
-        status = get_published_name(sock, addr_buf, sizeof(addr_buf),
+        status = get_published_name(sock[0], addr_buf, sizeof(addr_buf),
                                     &addr_name);
-        if (status != PJ_SUCCESS) {
-            pj_sock_close(sock);
-            return status;
-        }
+        if (status != PJ_SUCCESS)
+            goto on_error;
     } else {
         addr_name = cfg->addr_name;
     }
 
-    return pjsip_udp_transport_attach2(endpt, transport_type, sock,
-                                       &addr_name, cfg->async_cnt,
-                                       p_transport);
+    return transport_attach(endpt, transport_type, sock, &addr_name, cfg,
+                            p_transport);
+
+on_error:
+    for (i = 0; i < cfg->sock_cnt; ++i) {
+        if (sock[i] != PJ_INVALID_SOCKET)
+            pj_sock_close(sock[i]);
+    }
+    return status;
 }
 
 /*
@@ -1092,6 +1313,49 @@ PJ_DEF(pj_sock_t) pjsip_udp_transport_get_socket(pjsip_transport *transport)
 }
 
 
+/*
+ * Retrieve packet statistics of the transport.
+ */
+PJ_DEF(pj_status_t) pjsip_udp_transport_get_stat(
+                                        pjsip_transport *transport,
+                                        int sock_idx,
+                                        pjsip_udp_transport_stat *stat)
+{
+    struct udp_transport *tp;
+    unsigned i, first, last;
+
+    PJ_ASSERT_RETURN(transport && stat, PJ_EINVAL);
+
+    tp = (struct udp_transport*) transport;
+
+    if (sock_idx < 0) {
+        first = 0;
+        last = tp->max_sock_cnt;
+    } else if ((unsigned)sock_idx < tp->max_sock_cnt) {
+        first = sock_idx;
+        last = sock_idx + 1;
+    } else {
+        return PJ_EINVAL;
+    }
+
+    pj_bzero(stat, sizeof(*stat));
+    for (i = first; i < last; ++i) {
+        const pjsip_udp_transport_stat *s = &tp->stat[i];
+
+        stat->rx_pkt       += STAT_GET(s->rx_pkt);
+        stat->rx_bytes     += STAT_GET(s->rx_bytes);
+        stat->rx_drop      += STAT_GET(s->rx_drop);
+        stat->rx_parse_err += STAT_GET(s->rx_parse_err);
+        stat->rx_err       += STAT_GET(s->rx_err);
+        stat->tx_pkt       += STAT_GET(s->tx_pkt);
+        stat->tx_bytes     += STAT_GET(s->tx_bytes);
+        stat->tx_err       += STAT_GET(s->tx_err);
+    }
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Temporarily pause or shutdown the transport. 
  */
@@ -1118,13 +1382,14 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_pause(pjsip_transport *transport,
     tp->is_paused = PJ_TRUE;
 
     /* Cancel the ioqueue operation. */
-    for (i=0; i<(unsigned)tp->rdata_cnt; ++i) {
-        pj_ioqueue_post_completion(tp->key, 
+    for (i=0; i<tp->async_cnt*tp->sock_cnt; ++i) {
+        pj_ioqueue_post_completion(get_sock_key(tp, i / tp->async_cnt),
                                    &tp->rdata[i]->tp_info.op_key.op_key, -1);
     }
 
     /* Destroy the socket? */
     if (option & PJSIP_UDP_TRANSPORT_DESTROY_SOCKET) {
+        close_ext_socks(tp);
         if (tp->key) {
             /* This implicitly closes the socket */
             pj_ioqueue_unregister(tp->key);
@@ -1194,7 +1459,10 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_restart2(pjsip_transport *transport,
 
         /* Request to recreate transport */
 
-        /* Destroy existing socket, if any. */
+        /* Destroy existing sockets, if any. The replacement transport
+         * is backed by a single socket.
+         */
+        close_ext_socks(tp);
         if (tp->key) {
             /* This implicitly closes the socket */
             pj_ioqueue_unregister(tp->key);
@@ -1212,7 +1480,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_restart2(pjsip_transport *transport,
         if (sock == PJ_INVALID_SOCKET) {
             status = create_socket(local?local->addr.sa_family:pj_AF_UNSPEC(), 
                                    local, local?pj_sockaddr_get_len(local):0, 
-                                   &sock);
+                                   PJ_FALSE, &sock);
             if (status != PJ_SUCCESS)
                 return status;
         }
@@ -71,6 +71,18 @@ struct dlg_set
     struct dlg_set_head  dlg_list;
 };
 
+/* Partition of the dialog table. A dialog set is put in the partition
+ * selected by the hash of its Call-ID. All dialogs in a dialog set and all
+ * messages of these dialogs have the same Call-ID, so finding the dialog
+ * of a message only needs the lock of one partition.
+ */
+typedef struct dlg_shard
+{
+    pj_mutex_t          *mutex;
+    pj_hash_table_t     *dlg_table;
+    struct dlg_set       free_dlgset_nodes;
+} dlg_shard;
+
 
 /*
  * Module interface.
@@ -80,10 +92,9 @@ static struct user_agent
     pjsip_module         mod;
     pj_pool_t           *pool;
     pjsip_endpoint      *endpt;
-    pj_mutex_t          *mutex;
-    pj_hash_table_t     *dlg_table;
+    pj_mutex_t          *mutex;     /* Protects the pool.       */
     pjsip_ua_init_param  param;
-    struct dlg_set       free_dlgset_nodes;
+    dlg_shard            shard[PJSIP_UA_DLG_TABLE_SHARD_CNT];
 
 } mod_ua = 
 {
@@ -111,6 +122,7 @@ static struct user_agent
  */
 static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
 {
+    unsigned i, max_count;
     pj_status_t status;
 
     /* Initialize the user agent. */
@@ -124,11 +136,23 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
     if (status != PJ_SUCCESS)
         return status;
 
-    mod_ua.dlg_table = pj_hash_create(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT);
-    if (mod_ua.dlg_table == NULL)
-        return PJ_ENOMEM;
+    /* Create hash table and mutex of each partition. */
+    max_count = PJSIP_MAX_DIALOG_COUNT / PJSIP_UA_DLG_TABLE_SHARD_CNT;
+    pj_bzero(mod_ua.shard, sizeof(mod_ua.shard));
+    for (i=0; i<PJSIP_UA_DLG_TABLE_SHARD_CNT; ++i) {
+        dlg_shard *shard = &mod_ua.shard[i];
+
+        shard->dlg_table = pj_hash_create(mod_ua.pool, max_count);
+        if (shard->dlg_table == NULL)
+            return PJ_ENOMEM;
 
-    pj_list_init(&mod_ua.free_dlgset_nodes);
+        status = pj_mutex_create_recursive(mod_ua.pool, " ua%p",
+                                           &shard->mutex);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        pj_list_init(&shard->free_dlgset_nodes);
+    }
 
     /* Initialize dialog lock. */
     status = pj_thread_local_alloc(&pjsip_dlg_lock_tls_id);
@@ -148,9 +172,18 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
  */
 static pj_status_t mod_ua_unload(void)
 {
+    unsigned i;
+
     pj_thread_local_free(pjsip_dlg_lock_tls_id);
     pj_mutex_destroy(mod_ua.mutex);
 
+    for (i=0; i<PJSIP_UA_DLG_TABLE_SHARD_CNT; ++i) {
+        if (mod_ua.shard[i].mutex) {
+            pj_mutex_destroy(mod_ua.shard[i].mutex);
+            mod_ua.shard[i].mutex = NULL;
+        }
+    }
+
     /* Release pool */
     if (mod_ua.pool) {
         pjsip_endpt_release_pool( mod_ua.endpt, mod_ua.pool );
@@ -264,21 +297,35 @@ PJ_DEF(void) pjsip_ua_create_dlg_set_key( pj_pool_t *pool,
 }
 */
 
+/*
+ * Get the partition of the dialog table for the Call-ID.
+ */
+static dlg_shard *get_shard(const pj_str_t *call_id)
+{
+    pj_uint32_t hval;
+
+    hval = pj_hash_calc(0, call_id->ptr, (unsigned)call_id->slen);
+    return &mod_ua.shard[hval % PJSIP_UA_DLG_TABLE_SHARD_CNT];
+}
+
 /*
  * Acquire one dlg_set node to be put in the hash table.
- * This will first look in the free nodes list, then allocate
- * a new one from UA's pool when one is not available.
+ * This will first look in the free nodes list of the partition, then
+ * allocate a new one from UA's pool when one is not available.
+ * The partition must be locked.
  */
-static struct dlg_set *alloc_dlgset_node(void)
+static struct dlg_set *alloc_dlgset_node(dlg_shard *shard)
 {
     struct dlg_set *set;
 
-    if (!pj_list_empty(&mod_ua.free_dlgset_nodes)) {
-        set = mod_ua.free_dlgset_nodes.next;
+    if (!pj_list_empty(&shard->free_dlgset_nodes)) {
+        set = shard->free_dlgset_nodes.next;
         pj_list_erase(set);
         return set;
     } else {
+        pj_mutex_lock(mod_ua.mutex);
         set = PJ_POOL_ALLOC_T(mod_ua.pool, struct dlg_set);
+        pj_mutex_unlock(mod_ua.mutex);
         return set;
     }
 }
@@ -290,6 +337,8 @@ static struct dlg_set *alloc_dlgset_node(void)
 PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
                                            pjsip_dialog *dlg )
 {
+    dlg_shard *shard;
+
     /* Sanity check. */
     PJ_ASSERT_RETURN(ua && dlg, PJ_EINVAL);
 
@@ -302,15 +351,16 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
     //               (dlg->role==PJSIP_ROLE_UAS && dlg->remote.info->tag.slen
     //                && dlg->remote.tag_hval != 0), PJ_EBUG);
 
-    /* Lock the user agent. */
-    pj_mutex_lock(mod_ua.mutex);
+    /* Lock the partition of the user agent. */
+    shard = get_shard(&dlg->call_id->id);
+    pj_mutex_lock(shard->mutex);
 
     /* For UAC, check if there is existing dialog in the same set. */
     if (dlg->role == PJSIP_ROLE_UAC) {
         struct dlg_set *dlg_set;
 
         dlg_set = (struct dlg_set*)
-                  pj_hash_get_lower( mod_ua.dlg_table,
+                  pj_hash_get_lower( shard->dlg_table,
                                      dlg->local.info->tag.ptr, 
                                      (unsigned)dlg->local.info->tag.slen,
                                      &dlg->local.tag_hval);
@@ -328,7 +378,7 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
             /* This is the first dialog in the dialog set. 
              * Create the dialog set and add this dialog to it.
              */
-            dlg_set = alloc_dlgset_node();
+            dlg_set = alloc_dlgset_node(shard);
             dlg_set->ht_key = dlg->local.info->tag;
             pj_list_init(&dlg_set->dlg_list);
             pj_list_push_back(&dlg_set->dlg_list, dlg);
@@ -336,7 +386,7 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
             dlg->dlg_set = dlg_set;
 
             /* Register the dialog set in the hash table. */
-            pj_hash_set_np_lower(mod_ua.dlg_table, 
+            pj_hash_set_np_lower(shard->dlg_table, 
                                  dlg_set->ht_key.ptr,
                                  (unsigned)dlg_set->ht_key.slen,
                                  dlg->local.tag_hval, dlg_set->ht_entry,
@@ -347,21 +397,21 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
         /* For UAS, create the dialog set with a single dialog as member. */
         struct dlg_set *dlg_set;
 
-        dlg_set = alloc_dlgset_node();
+        dlg_set = alloc_dlgset_node(shard);
         dlg_set->ht_key = dlg->local.info->tag;
         pj_list_init(&dlg_set->dlg_list);
         pj_list_push_back(&dlg_set->dlg_list, dlg);
 
         dlg->dlg_set = dlg_set;
 
-        pj_hash_set_np_lower(mod_ua.dlg_table, 
+        pj_hash_set_np_lower(shard->dlg_table, 
                              dlg_set->ht_key.ptr,
                              (unsigned)dlg_set->ht_key.slen,
                              dlg->local.tag_hval, dlg_set->ht_entry, dlg_set);
     }
 
     /* Unlock user agent. */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Done. */
     return PJ_SUCCESS;
@@ -371,6 +421,7 @@ PJ_DEF(pj_status_t) pjsip_ua_register_dlg( pjsip_user_agent *ua,
 PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
                                              pjsip_dialog *dlg )
 {
+    dlg_shard *shard;
     struct dlg_set *dlg_set;
     pjsip_dialog *d;
 
@@ -380,8 +431,9 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
     /* Check that dialog has been registered. */
     PJ_ASSERT_RETURN(dlg->dlg_set, PJ_EINVALIDOP);
 
-    /* Lock user agent. */
-    pj_mutex_lock(mod_ua.mutex);
+    /* Lock the partition of the user agent. */
+    shard = get_shard(&dlg->call_id->id);
+    pj_mutex_lock(shard->mutex);
 
     /* Find this dialog from the dialog set. */
     dlg_set = (struct dlg_set*) dlg->dlg_set;
@@ -392,7 +444,7 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
 
     if (d != dlg) {
         pj_assert(!"Dialog is not registered!");
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         return PJ_EINVALIDOP;
     }
 
@@ -403,16 +455,16 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
     if (pj_list_empty(&dlg_set->dlg_list)) {
 
         /* Verify that the dialog set is valid */
-        pj_assert(pj_hash_get_lower(mod_ua.dlg_table, dlg_set->ht_key.ptr,
+        pj_assert(pj_hash_get_lower(shard->dlg_table, dlg_set->ht_key.ptr,
                                     (unsigned)dlg_set->ht_key.slen,
                                     &dlg->local.tag_hval) == dlg_set);
 
-        pj_hash_set_lower(NULL, mod_ua.dlg_table, dlg_set->ht_key.ptr,
+        pj_hash_set_lower(NULL, shard->dlg_table, dlg_set->ht_key.ptr,
                           (unsigned)dlg_set->ht_key.slen,
                           dlg->local.tag_hval, NULL);
 
         /* Return dlg_set to free nodes. */
-        pj_list_push_back(&mod_ua.free_dlgset_nodes, dlg_set);
+        pj_list_push_back(&shard->free_dlgset_nodes, dlg_set);
     } else {
         /* If the just unregistered dialog is being used as hash key,
          * reset the dlg_set entry with a new key (i.e: from the first dialog
@@ -426,13 +478,13 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
             /* Verify that the old & new keys share the hash value */
             pj_assert(key_dlg->local.tag_hval == dlg->local.tag_hval);
 
-            pj_hash_set_lower(NULL, mod_ua.dlg_table, dlg_set->ht_key.ptr,
+            pj_hash_set_lower(NULL, shard->dlg_table, dlg_set->ht_key.ptr,
                               (unsigned)dlg_set->ht_key.slen,
                               dlg->local.tag_hval, NULL);
 
             dlg_set->ht_key = key_dlg->local.info->tag;
 
-            pj_hash_set_np_lower(mod_ua.dlg_table,
+            pj_hash_set_np_lower(shard->dlg_table,
                                  dlg_set->ht_key.ptr,
                                  (unsigned)dlg_set->ht_key.slen,
                                  key_dlg->local.tag_hval, dlg_set->ht_entry,
@@ -441,7 +493,7 @@ PJ_DEF(pj_status_t) pjsip_ua_unregister_dlg( pjsip_user_agent *ua,
     }
 
     /* Unlock user agent. */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Done. */
     return PJ_SUCCESS;
@@ -470,13 +522,17 @@ PJ_DEF(pjsip_dialog*) pjsip_tsx_get_dlg( pjsip_transaction *tsx )
  */
 PJ_DEF(unsigned) pjsip_ua_get_dlg_set_count(void)
 {
-    unsigned count;
+    unsigned i, count = 0;
 
     PJ_ASSERT_RETURN(mod_ua.endpt, 0);
 
-    pj_mutex_lock(mod_ua.mutex);
-    count = pj_hash_count(mod_ua.dlg_table);
-    pj_mutex_unlock(mod_ua.mutex);
+    for (i=0; i<PJSIP_UA_DLG_TABLE_SHARD_CNT; ++i) {
+        dlg_shard *shard = &mod_ua.shard[i];
+
+        pj_mutex_lock(shard->mutex);
+        count += pj_hash_count(shard->dlg_table);
+        pj_mutex_unlock(shard->mutex);
+    }
 
     return count;
 }
@@ -490,21 +546,23 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
                                            const pj_str_t *remote_tag,
                                            pj_bool_t lock_dialog)
 {
+    dlg_shard *shard;
     struct dlg_set *dlg_set;
     pjsip_dialog *dlg;
 
     PJ_ASSERT_RETURN(call_id && local_tag && remote_tag, NULL);
 
-    /* Lock user agent. */
-    pj_mutex_lock(mod_ua.mutex);
+    /* Lock the partition of the user agent. */
+    shard = get_shard(call_id);
+    pj_mutex_lock(shard->mutex);
 
     /* Lookup the dialog set. */
     dlg_set = (struct dlg_set*)
-              pj_hash_get_lower(mod_ua.dlg_table, local_tag->ptr,
+              pj_hash_get_lower(shard->dlg_table, local_tag->ptr,
                                 (unsigned)local_tag->slen, NULL);
     if (dlg_set == NULL) {
         /* Not found */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         return NULL;
     }
 
@@ -520,7 +578,7 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
 
     if (dlg == (pjsip_dialog*)&dlg_set->dlg_list) {
         /* Not found */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         return NULL;
     }
 
@@ -530,7 +588,7 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
         PJ_LOG(6, (THIS_FILE, "Dialog not found: local and remote tags "
                               "matched but not call id"));
 
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         return NULL;
     }
 
@@ -546,18 +604,18 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
              */
 
             /* Unlock user agent. */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
             /* Lock dialog */
             pjsip_dlg_inc_lock(dlg);
 
         } else {
             /* Unlock user agent. */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
         }
 
     } else {
         /* Unlock user agent. */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
     }
 
     return dlg;
@@ -566,8 +624,10 @@ PJ_DEF(pjsip_dialog*) pjsip_ua_find_dialog(const pj_str_t *call_id,
 
 /*
  * Find the first dialog in dialog set in hash table for an incoming message.
+ * The partition of the message's Call-ID must be locked.
  */
-static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
+static struct dlg_set *find_dlg_set_for_msg( dlg_shard *shard,
+                                             pjsip_rx_data *rdata )
 {
     /* CANCEL message doesn't have To tag, so we must lookup the dialog
      * by finding the INVITE UAS transaction being cancelled.
@@ -620,7 +680,7 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
 
         /* Lookup the dialog set. */
         dlg_set = (struct dlg_set*)
-                  pj_hash_get_lower(mod_ua.dlg_table, tag->ptr, 
+                  pj_hash_get_lower(shard->dlg_table, tag->ptr, 
                                     (unsigned)tag->slen, NULL);
         return dlg_set;
     }
@@ -629,6 +689,7 @@ static struct dlg_set *find_dlg_set_for_msg( pjsip_rx_data *rdata )
 /* On received requests. */
 static pj_bool_t mod_ua_on_rx_request(pjsip_rx_data *rdata)
 {
+    dlg_shard *shard;
     struct dlg_set *dlg_set;
     pj_str_t *from_tag;
     pjsip_dialog *dlg;
@@ -647,20 +708,23 @@ static pj_bool_t mod_ua_on_rx_request(pjsip_rx_data *rdata)
     if (rdata->msg_info.msg->line.req.method.id == PJSIP_REGISTER_METHOD)
         return PJ_FALSE;
 
+    /* All dialogs that the request may belong to are in this partition */
+    shard = get_shard(&rdata->msg_info.cid->id);
+
 retry_on_deadlock:
 
     /* Lock user agent before looking up the dialog hash table. */
-    pj_mutex_lock(mod_ua.mutex);
+    pj_mutex_lock(shard->mutex);
 
     /* Lookup the dialog set, based on the To tag header. */
-    dlg_set = find_dlg_set_for_msg(rdata);
+    dlg_set = find_dlg_set_for_msg(shard, rdata);
 
     /* If dialog is not found, respond with 481 (Call/Transaction
      * Does Not Exist).
      */
     if (dlg_set == NULL) {
         /* Unable to find dialog. */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
 
         if (rdata->msg_info.msg->line.req.method.id != PJSIP_ACK_METHOD) {
             PJ_LOG(5,(THIS_FILE, 
@@ -701,7 +765,7 @@ retry_on_deadlock:
 
         if (first_dlg->remote.info->tag.slen != 0) {
             /* Not found. Mulfunction UAC? */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
 
             if (rdata->msg_info.msg->line.req.method.id != PJSIP_ACK_METHOD) {
                 PJ_LOG(5,(THIS_FILE, 
@@ -733,13 +797,13 @@ retry_on_deadlock:
          * because of deadlock. Release UA mutex, yield, and retry 
          * the whole thing once again.
          */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         pj_thread_sleep(0);
         goto retry_on_deadlock;
     }
 
     /* Done with processing in UA layer, release lock */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Pass to dialog. */
     pjsip_dlg_on_rx_request(dlg, rdata);
@@ -757,6 +821,7 @@ retry_on_deadlock:
 static pj_bool_t mod_ua_on_rx_response(pjsip_rx_data *rdata)
 {
     pjsip_transaction *tsx;
+    dlg_shard *shard;
     struct dlg_set *dlg_set;
     pjsip_dialog *dlg;
     pj_status_t status;
@@ -771,12 +836,15 @@ static pj_bool_t mod_ua_on_rx_response(pjsip_rx_data *rdata)
      * the response is a forked response.
      */
 
+    /* All dialogs that the response may belong to are in this partition */
+    shard = get_shard(&rdata->msg_info.cid->id);
+
 retry_on_deadlock:
 
     dlg = NULL;
 
     /* Lock user agent dlg table before we're doing anything. */
-    pj_mutex_lock(mod_ua.mutex);
+    pj_mutex_lock(shard->mutex);
 
     /* Check if transaction is present. */
     tsx = pjsip_rdata_get_tsx(rdata);
@@ -785,10 +853,20 @@ retry_on_deadlock:
         dlg = pjsip_tsx_get_dlg(tsx);
         if (!dlg) {
             /* Unlock dialog hash table. */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
             return PJ_FALSE;
         }
 
+        /* The response should have the Call-ID of the request, but if
+         * it doesn't, lock the partition of the dialog instead. The
+         * transaction keeps the dialog alive meanwhile.
+         */
+        if (get_shard(&dlg->call_id->id) != shard) {
+            pj_mutex_unlock(shard->mutex);
+            shard = get_shard(&dlg->call_id->id);
+            goto retry_on_deadlock;
+        }
+
         /* Get the dialog set. */
         dlg_set = (struct dlg_set*) dlg->dlg_set;
 
@@ -812,21 +890,21 @@ retry_on_deadlock:
              * or a very late response.
              */
             /* Unlock dialog hash table. */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
             return PJ_FALSE;
         }
 
 
         /* Get the dialog set. */
         dlg_set = (struct dlg_set*)
-                  pj_hash_get_lower(mod_ua.dlg_table, 
+                  pj_hash_get_lower(shard->dlg_table, 
                                     rdata->msg_info.from->tag.ptr,
                                     (unsigned)rdata->msg_info.from->tag.slen,
                                     NULL);
 
         if (!dlg_set) {
             /* Unlock dialog hash table. */
-            pj_mutex_unlock(mod_ua.mutex);
+            pj_mutex_unlock(shard->mutex);
 
             /* Strayed 2xx response!! */
             PJ_LOG(4,(THIS_FILE, 
@@ -896,7 +974,7 @@ retry_on_deadlock:
                 dlg = (*mod_ua.param.on_dlg_forked)(dlg_set->dlg_list.next, 
                                                     rdata);
                 if (dlg == NULL) {
-                    pj_mutex_unlock(mod_ua.mutex);
+                    pj_mutex_unlock(shard->mutex);
                     return PJ_TRUE;
                 }
             } else {
@@ -942,13 +1020,13 @@ retry_on_deadlock:
          * situation, and for safety, try to avoid deadlock by releasing
          * UA mutex, yield, and retry the whole processing once again.
          */
-        pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
         pj_thread_sleep(0);
         goto retry_on_deadlock;
     }
 
     /* We're done with processing in the UA layer, we can release the mutex */
-    pj_mutex_unlock(mod_ua.mutex);
+    pj_mutex_unlock(shard->mutex);
 
     /* Pass the response to the dialog. */
     pjsip_dlg_on_rx_response(dlg, rdata);
@@ -994,21 +1072,27 @@ PJ_DEF(void) pjsip_ua_dump(pj_bool_t detail)
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_hash_iterator_t itbuf, *it;
     char dlginfo[128];
+    unsigned i, count;
 
-    pj_mutex_lock(mod_ua.mutex);
+    count = pjsip_ua_get_dlg_set_count();
+    PJ_LOG(3, (THIS_FILE, "Number of dialog sets: %u", count));
 
-    PJ_LOG(3, (THIS_FILE, "Number of dialog sets: %u", 
-                          pj_hash_count(mod_ua.dlg_table)));
+    if (!detail || count == 0)
+        return;
+
+    PJ_LOG(3, (THIS_FILE, "Dumping dialog sets:"));
+    for (i=0; i<PJSIP_UA_DLG_TABLE_SHARD_CNT; ++i) {
+        dlg_shard *shard = &mod_ua.shard[i];
+
+        pj_mutex_lock(shard->mutex);
 
-    if (detail && pj_hash_count(mod_ua.dlg_table)) {
-        PJ_LOG(3, (THIS_FILE, "Dumping dialog sets:"));
-        it = pj_hash_first(mod_ua.dlg_table, &itbuf);
-        for (; it != NULL; it = pj_hash_next(mod_ua.dlg_table, it))  {
+        it = pj_hash_first(shard->dlg_table, &itbuf);
+        for (; it != NULL; it = pj_hash_next(shard->dlg_table, it))  {
             struct dlg_set *dlg_set;
             pjsip_dialog *dlg;
             const char *title;
 
-            dlg_set = (struct dlg_set*) pj_hash_this(mod_ua.dlg_table, it);
+            dlg_set = (struct dlg_set*) pj_hash_this(shard->dlg_table, it);
             if (!dlg_set || pj_list_empty(&dlg_set->dlg_list)) continue;
 
             /* First dialog in dialog set. */
@@ -1028,9 +1112,9 @@ PJ_DEF(void) pjsip_ua_dump(pj_bool_t detail)
                 dlg = dlg->next;
             }
         }
-    }
 
-    pj_mutex_unlock(mod_ua.mutex);
+        pj_mutex_unlock(shard->mutex);
+    }
 #endif
 }
 
@@ -21,6 +21,7 @@
 #include <pjsip/sip_parser.h>
 #include <pjsip/print_util.h>
 #include <pjsip/sip_errno.h>
+#include <pjsip/sip_private.h>
 #include <pjlib-util/string.h>
 #include <pj/string.h>
 #include <pj/pool.h>
@@ -99,6 +100,35 @@ PJ_DEF(void) pjsip_param_shallow_clone( pj_pool_t *pool,
     }
 }
 
+void pjsip_param_arena_count(pjsip_clone_arena *a, const pjsip_param *list)
+{
+    const pjsip_param *p = list->next;
+
+    while (p && p != list) {
+        pjsip_arena_count(a, sizeof(pjsip_param));
+        pjsip_arena_count_str(a, &p->name);
+        pjsip_arena_count_str(a, &p->value);
+        p = p->next;
+    }
+}
+
+void pjsip_param_arena_copy(pjsip_clone_arena *a, pjsip_param *dst_list,
+                            const pjsip_param *src_list)
+{
+    const pjsip_param *p = src_list->next;
+
+    pj_list_init(dst_list);
+    while (p && p != src_list) {
+        pjsip_param *new_param;
+
+        new_param = (pjsip_param*) pjsip_arena_alloc(a, sizeof(pjsip_param));
+        pjsip_arena_strdup(a, &new_param->name, &p->name);
+        pjsip_arena_strdup(a, &new_param->value, &p->value);
+        pj_list_insert_before(dst_list, new_param);
+        p = p->next;
+    }
+}
+
 PJ_DEF(pj_ssize_t) pjsip_param_print_on( const pjsip_param *param_list,
                                          char *buf, pj_size_t size,
                                          const pj_cis_t *pname_spec,
@@ -618,6 +648,81 @@ static pjsip_name_addr* pjsip_name_addr_clone( pj_pool_t *pool,
     return addr;
 }
 
+/*
+ * Clone arena (see sip_private.h). Only SIP/SIPS URI and name-addr are
+ * copied to the arena, other schemes are cloned from the pool.
+ */
+void pjsip_uri_arena_count(pjsip_clone_arena *a, const pjsip_uri *uri)
+{
+    if (!uri)
+        return;
+
+    if (uri->vptr == &sip_url_vptr || uri->vptr == &sips_url_vptr) {
+        const pjsip_sip_uri *url = (const pjsip_sip_uri*) uri;
+
+        pjsip_arena_count(a, sizeof(pjsip_sip_uri));
+        pjsip_arena_count_str(a, &url->user);
+        pjsip_arena_count_str(a, &url->passwd);
+#if defined (PJSIP_URI_USE_ORIG_USERPASS) && (PJSIP_URI_USE_ORIG_USERPASS)
+        pjsip_arena_count_str(a, &url->orig_userpass);
+#endif
+        pjsip_arena_count_str(a, &url->host);
+        pjsip_arena_count_str(a, &url->user_param);
+        pjsip_arena_count_str(a, &url->method_param);
+        pjsip_arena_count_str(a, &url->transport_param);
+        pjsip_arena_count_str(a, &url->maddr_param);
+        pjsip_param_arena_count(a, &url->other_param);
+        pjsip_param_arena_count(a, &url->header_param);
+
+    } else if (uri->vptr == &name_addr_vptr) {
+        const pjsip_name_addr *name = (const pjsip_name_addr*) uri;
+
+        pjsip_arena_count(a, sizeof(pjsip_name_addr));
+        pjsip_arena_count_str(a, &name->display);
+        pjsip_uri_arena_count(a, name->uri);
+    }
+}
+
+pjsip_uri* pjsip_uri_arena_copy(pjsip_clone_arena *a, const pjsip_uri *uri)
+{
+    if (!uri)
+        return NULL;
+
+    if (uri->vptr == &sip_url_vptr || uri->vptr == &sips_url_vptr) {
+        const pjsip_sip_uri *rhs = (const pjsip_sip_uri*) uri;
+        pjsip_sip_uri *url;
+
+        url = (pjsip_sip_uri*) pjsip_arena_alloc(a, sizeof(pjsip_sip_uri));
+        pj_memcpy(url, rhs, sizeof(pjsip_sip_uri));
+        pjsip_arena_strdup(a, &url->user, &rhs->user);
+        pjsip_arena_strdup(a, &url->passwd, &rhs->passwd);
+#if defined (PJSIP_URI_USE_ORIG_USERPASS) && (PJSIP_URI_USE_ORIG_USERPASS)
+        pjsip_arena_strdup(a, &url->orig_userpass, &rhs->orig_userpass);
+#endif
+        pjsip_arena_strdup(a, &url->host, &rhs->host);
+        pjsip_arena_strdup(a, &url->user_param, &rhs->user_param);
+        pjsip_arena_strdup(a, &url->method_param, &rhs->method_param);
+        pjsip_arena_strdup(a, &url->transport_param, &rhs->transport_param);
+        pjsip_arena_strdup(a, &url->maddr_param, &rhs->maddr_param);
+        pjsip_param_arena_copy(a, &url->other_param, &rhs->other_param);
+        pjsip_param_arena_copy(a, &url->header_param, &rhs->header_param);
+        return (pjsip_uri*) url;
+
+    } else if (uri->vptr == &name_addr_vptr) {
+        const pjsip_name_addr *rhs = (const pjsip_name_addr*) uri;
+        pjsip_name_addr *addr;
+
+        addr = (pjsip_name_addr*) pjsip_arena_alloc(a,
+                                                    sizeof(pjsip_name_addr));
+        pjsip_name_addr_init(addr);
+        pjsip_arena_strdup(a, &addr->display, &rhs->display);
+        addr->uri = pjsip_uri_arena_copy(a, rhs->uri);
+        return (pjsip_uri*) addr;
+    }
+
+    return (pjsip_uri*) pjsip_uri_clone(a->pool, uri);
+}
+
 static int pjsip_name_addr_compare(  pjsip_uri_context_e context,
                                      const pjsip_name_addr *naddr1,
                                      const pjsip_name_addr *naddr2)
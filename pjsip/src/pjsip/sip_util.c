@@ -106,6 +106,7 @@ PJ_DEF(pj_status_t) pjsip_target_set_add_from_msg( pjsip_target_set *tset,
     PJ_ASSERT_RETURN(tset && pool && msg, PJ_EINVAL);
 
     /* Scan for Contact headers and add the URI */
+    pjsip_msg_parse_lazy_hdrs((pjsip_msg*)msg);
     hdr = msg->hdr.next;
     while (hdr != &msg->hdr) {
         if (hdr->type == PJSIP_H_CONTACT) {
@@ -66,6 +66,222 @@ PJ_DEF(pj_status_t) pjsip_endpt_clone_msg( pjsip_endpoint *endpt,
 */
 
 
+/* Headers which are handled by zero-copy forwarding */
+enum raw_hdr_id
+{
+    RAW_HDR_OTHER,
+    RAW_HDR_SKIP,
+    RAW_HDR_VIA,
+    RAW_HDR_MAX_FWD,
+    RAW_HDR_FROM,
+    RAW_HDR_TO,
+    RAW_HDR_CALL_ID,
+    RAW_HDR_CSEQ
+};
+
+static const struct raw_hdr_name
+{
+    pj_str_t    name;
+    char        compact;
+    unsigned    id;
+} raw_hdr_names[] =
+{
+    { {"Via", 3},               'v',    RAW_HDR_VIA },
+    { {"Max-Forwards", 12},     0,      RAW_HDR_MAX_FWD },
+    { {"From", 4},              'f',    RAW_HDR_FROM },
+    { {"To", 2},                't',    RAW_HDR_TO },
+    { {"Call-ID", 7},           'i',    RAW_HDR_CALL_ID },
+    { {"CSeq", 4},              0,      RAW_HDR_CSEQ },
+    { {"Content-Length", 14},   'l',    RAW_HDR_SKIP },
+    { {"Content-Type", 12},     'c',    RAW_HDR_SKIP }
+};
+
+/* Identify the header name, checking the length first since most header
+ * names don't need to be compared at all.
+ */
+static unsigned get_raw_hdr_id(const pj_str_t *hname)
+{
+    unsigned i;
+
+    if (hname->slen == 1) {
+        char c = (char)pj_tolower(*hname->ptr);
+        for (i=0; i<PJ_ARRAY_SIZE(raw_hdr_names); ++i) {
+            if (raw_hdr_names[i].compact == c)
+                return raw_hdr_names[i].id;
+        }
+        return RAW_HDR_OTHER;
+    }
+
+    for (i=0; i<PJ_ARRAY_SIZE(raw_hdr_names); ++i) {
+        if (raw_hdr_names[i].name.slen == hname->slen &&
+            pj_stricmp(&raw_hdr_names[i].name, hname) == 0)
+        {
+            return raw_hdr_names[i].id;
+        }
+    }
+    return RAW_HDR_OTHER;
+}
+
+/* Create the Via header to be put on top of the forwarded request */
+static pjsip_via_hdr *create_fwd_via(pjsip_tx_data *tdata,
+                                     pjsip_rx_data *rdata,
+                                     const pj_str_t *branch)
+{
+    pjsip_via_hdr *hvia;
+
+    hvia = pjsip_via_hdr_create(tdata->pool);
+    if (branch)
+        pj_strdup(tdata->pool, &hvia->branch_param, branch);
+    else {
+        pj_str_t new_branch = pjsip_calculate_branch_id(rdata);
+        pj_strdup(tdata->pool, &hvia->branch_param, &new_branch);
+    }
+    return hvia;
+}
+
+/* Find the first comma separating header values, outside quoted string */
+static char *find_value_sep(char *p, char *end)
+{
+    pj_bool_t quoted = PJ_FALSE;
+
+    for (; p < end; ++p) {
+        if (*p == '"')
+            quoted = !quoted;
+        else if (*p == '\\' && quoted && p+1 < end)
+            ++p;
+        else if (*p == ',' && !quoted)
+            return p;
+    }
+    return NULL;
+}
+
+/*
+ * Add the headers of the received message to the forwarded message with
+ * PJSIP_FWD_ZERO_COPY. The received packet is copied once, and unchanged
+ * headers are added as lazy headers referring to the copy. If via is not
+ * NULL it is added before the first Via header (request), otherwise the
+ * first Via value is removed (response).
+ */
+static pj_status_t add_raw_hdrs(pjsip_tx_data *tdata, pjsip_rx_data *rdata,
+                                pjsip_via_hdr *via)
+{
+    pjsip_msg *dst = tdata->msg;
+    unsigned seen = 0;
+    char *p, *end;
+
+    p = (char*) pj_pool_alloc(tdata->pool, rdata->msg_info.len + 1);
+    pj_memcpy(p, rdata->msg_info.msg_buf, rdata->msg_info.len);
+    end = p + rdata->msg_info.len;
+    *end = '\0';
+
+    /* Skip the start line */
+    p = (char*) pj_memchr(p, '\n', end - p);
+    if (!p)
+        return PJSIP_EINVALIDMSG;
+    ++p;
+
+    /* Headers end with an empty line */
+    while (p < end && *p != '\r' && *p != '\n') {
+        pj_str_t hname, hvalue;
+        char *line = p, *colon, *eol, *sep;
+        pjsip_hdr *hdr = NULL, *src = NULL;
+        unsigned id;
+
+        /* Find the end of the header, including continuation lines */
+        for (;;) {
+            eol = (char*) pj_memchr(p, '\n', end - p);
+            if (!eol)
+                return PJSIP_EINVALIDMSG;
+            p = eol + 1;
+            if (p == end || (*p != ' ' && *p != '\t'))
+                break;
+        }
+
+        colon = (char*) pj_memchr(line, ':', eol - line);
+        if (!colon)
+            return PJSIP_EINVALIDHDR;
+
+        hname.ptr = line;
+        hname.slen = colon - line;
+        pj_strrtrim(&hname);
+
+        hvalue.ptr = colon + 1;
+        hvalue.slen = eol - hvalue.ptr;
+        pj_strtrim(&hvalue);
+
+        /* Only the first occurrence of the headers is handled */
+        id = get_raw_hdr_id(&hname);
+        if (id != RAW_HDR_SKIP) {
+            if (seen & (1 << id))
+                id = RAW_HDR_OTHER;
+            seen |= (1 << id);
+        }
+
+        switch (id) {
+        case RAW_HDR_SKIP:
+            /* Content-Type and Content-Length are generated when the
+             * message is printed.
+             */
+            continue;
+
+        case RAW_HDR_VIA:
+            /* The first value is removed from responses. For requests,
+             * it is cloned since the received and rport parameters may
+             * have been set by the endpoint.
+             */
+            if (via) {
+                pjsip_msg_add_hdr(dst, (pjsip_hdr*)via);
+                pjsip_msg_add_hdr(dst, (pjsip_hdr*)
+                                  pjsip_hdr_clone(tdata->pool,
+                                                  rdata->msg_info.via));
+            }
+            sep = find_value_sep(hvalue.ptr, hvalue.ptr + hvalue.slen);
+            if (!sep)
+                continue;
+            hvalue.slen -= (sep + 1 - hvalue.ptr);
+            hvalue.ptr = sep + 1;
+            pj_strltrim(&hvalue);
+            break;
+
+        case RAW_HDR_MAX_FWD:
+            if (rdata->msg_info.max_fwd) {
+                int ivalue = rdata->msg_info.max_fwd->ivalue - 1;
+                hdr = (pjsip_hdr*) pjsip_max_fwd_hdr_create(tdata->pool,
+                                                            ivalue);
+            }
+            break;
+
+        case RAW_HDR_FROM:
+            src = (pjsip_hdr*) rdata->msg_info.from;
+            break;
+
+        case RAW_HDR_TO:
+            src = (pjsip_hdr*) rdata->msg_info.to;
+            break;
+
+        case RAW_HDR_CALL_ID:
+            src = (pjsip_hdr*) rdata->msg_info.cid;
+            break;
+
+        case RAW_HDR_CSEQ:
+            src = (pjsip_hdr*) rdata->msg_info.cseq;
+            break;
+        }
+
+        /* These are used by the transaction layer, keep them parsed */
+        if (src)
+            hdr = (pjsip_hdr*) pjsip_hdr_clone(tdata->pool, src);
+
+        if (!hdr)
+            hdr = (pjsip_hdr*) pjsip_lazy_hdr_create(tdata->pool, &hname,
+                                                     &hvalue);
+        pjsip_msg_add_hdr(dst, hdr);
+    }
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Create new request message to be forwarded upstream to new destination URI 
  * in uri. 
@@ -86,8 +302,6 @@ PJ_DEF(pj_status_t) pjsip_endpt_create_request_fwd(pjsip_endpoint *endpt,
     PJ_ASSERT_RETURN(rdata->msg_info.msg->type == PJSIP_REQUEST_MSG, 
                      PJSIP_ENOTREQUESTMSG);
 
-    PJ_UNUSED_ARG(options);
-
 
     /* Request forwarding rule in RFC 3261 section 16.6:
      *
@@ -138,8 +352,19 @@ PJ_DEF(pj_status_t) pjsip_endpt_create_request_fwd(pjsip_endpoint *endpt,
                                pjsip_uri_clone(tdata->pool, src->line.req.uri);
         }
 
+        /* Reuse the received bytes for unchanged headers. Fallback to
+         * cloning if the raw headers are somehow unusable.
+         */
+        if ((options & PJSIP_FWD_ZERO_COPY) &&
+            add_raw_hdrs(tdata, rdata,
+                         create_fwd_via(tdata, rdata, branch)) != PJ_SUCCESS)
+        {
+            pj_list_init(&dst->hdr);
+            options &= ~PJSIP_FWD_ZERO_COPY;
+        }
+
         /* Clone ALL headers */
-        hsrc = src->hdr.next;
+        hsrc = (options & PJSIP_FWD_ZERO_COPY) ? &src->hdr : src->hdr.next;
         while (hsrc != &src->hdr) {
 
             pjsip_hdr *hdst;
@@ -148,16 +373,8 @@ PJ_DEF(pj_status_t) pjsip_endpt_create_request_fwd(pjsip_endpoint *endpt,
              * cloning the header.
              */
             if (hsrc == (pjsip_hdr*)rdata->msg_info.via) {
-                pjsip_via_hdr *hvia;
-                hvia = pjsip_via_hdr_create(tdata->pool);
-                if (branch)
-                    pj_strdup(tdata->pool, &hvia->branch_param, branch);
-                else {
-                    pj_str_t new_branch = pjsip_calculate_branch_id(rdata);
-                    pj_strdup(tdata->pool, &hvia->branch_param, &new_branch);
-                }
-                pjsip_msg_add_hdr(dst, (pjsip_hdr*)hvia);
-
+                pjsip_msg_add_hdr(dst, (pjsip_hdr*)
+                                  create_fwd_via(tdata, rdata, branch));
             }
             /* Skip Content-Type and Content-Length as these would be 
              * generated when the the message is printed.
@@ -254,8 +471,6 @@ PJ_DEF(pj_status_t) pjsip_endpt_create_response_fwd( pjsip_endpoint *endpt,
     pj_status_t status;
     PJ_USE_EXCEPTION;
 
-    PJ_UNUSED_ARG(options);
-
     status = pjsip_endpt_create_tdata(endpt, &tdata);
     if (status != PJ_SUCCESS)
         return status;
@@ -275,8 +490,15 @@ PJ_DEF(pj_status_t) pjsip_endpt_create_response_fwd( pjsip_endpoint *endpt,
         pj_strdup(tdata->pool, &dst->line.status.reason, 
                   &src->line.status.reason);
 
+        if ((options & PJSIP_FWD_ZERO_COPY) &&
+            add_raw_hdrs(tdata, rdata, NULL) != PJ_SUCCESS)
+        {
+            pj_list_init(&dst->hdr);
+            options &= ~PJSIP_FWD_ZERO_COPY;
+        }
+
         /* Duplicate all headers */
-        hsrc = src->hdr.next;
+        hsrc = (options & PJSIP_FWD_ZERO_COPY) ? &src->hdr : src->hdr.next;
         while (hsrc != &src->hdr) {
             
             /* Skip Content-Type and Content-Length as these would be 
@@ -1291,6 +1291,7 @@ PJ_DEF(pj_status_t) pjsua_acc_modify( pjsua_acc_id acc_id,
 
     /* Authentication preference */
     acc->cfg.auth_pref.initial_auth = cfg->auth_pref.initial_auth;
+    acc->cfg.auth_pref.auto_send_next = cfg->auth_pref.auto_send_next;
     if (pj_strcmp(&acc->cfg.auth_pref.algorithm, &cfg->auth_pref.algorithm)) {
         pj_strdup_with_null(acc->pool, &acc->cfg.auth_pref.algorithm, 
                             &cfg->auth_pref.algorithm);
@@ -21,6 +21,7 @@
 #include "util.hpp"
 
 #define THIS_FILE       "json.cpp"
+#define JSON_FILE_BUF_SIZE  4096
 
 using namespace pj;
 using namespace std;
@@ -227,7 +228,15 @@ void JsonDocument::saveFile(const string &filename) PJSUA2_THROW(Error)
     if (status != PJ_SUCCESS)
         PJSUA2_RAISE_ERROR(status);
 
-    status = pj_json_writef(root, &json_file_writer, &sd.fd);
+    /* Write through a large buffer so that big documents don't cost
+     * one file write per JSON token.
+     */
+    pj_json_stream_writer sw;
+    char buf[JSON_FILE_BUF_SIZE];
+
+    pj_json_sw_init(&sw, buf, sizeof(buf), &json_file_writer, &sd);
+    pj_json_sw_elem(&sw, root);
+    status = pj_json_sw_flush(&sw);
     pj_file_close(sd.fd);
 
     if (status != PJ_SUCCESS)
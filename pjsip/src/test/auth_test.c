@@ -0,0 +1,482 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjsip.h>
+#include <pjlib.h>
+
+#define THIS_FILE   "auth_test.c"
+
+#define REALM       "example.com"
+#define USER        "alice"
+#define PASSWD      "secret"
+#define URI         "sip:" REALM
+
+static unsigned lookup_cnt;
+
+static pj_status_t lookup_cred(pj_pool_t *pool,
+                               const pjsip_auth_lookup_cred_param *param,
+                               pjsip_cred_info *cred_info)
+{
+    PJ_UNUSED_ARG(pool);
+
+    ++lookup_cnt;
+
+    if (pj_strcmp2(&param->acc_name, USER) != 0)
+        return PJSIP_EAUTHACCNOTFOUND;
+
+    pj_bzero(cred_info, sizeof(*cred_info));
+    cred_info->realm = pj_str(REALM);
+    cred_info->scheme = pj_str("digest");
+    cred_info->username = pj_str(USER);
+    cred_info->data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
+    cred_info->data = pj_str(PASSWD);
+
+    return PJ_SUCCESS;
+}
+
+/* Challenge and return the nonce. */
+static pj_status_t challenge(pjsip_auth_srv *srv, pj_pool_t *pool,
+                             pj_str_t *nonce)
+{
+    const pj_str_t qop = { "auth", 4 };
+    pjsip_tx_data *tdata;
+    pjsip_www_authenticate_hdr *hdr;
+    pj_status_t status;
+
+    status = pjsip_endpt_create_tdata(endpt, &tdata);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    pjsip_tx_data_add_ref(tdata);
+    tdata->msg = pjsip_msg_create(tdata->pool, PJSIP_RESPONSE_MSG);
+    tdata->msg->line.status.code = 401;
+
+    status = pjsip_auth_srv_challenge2(srv, &qop, NULL, NULL, PJ_FALSE, tdata,
+                                       PJSIP_AUTH_ALGORITHM_MD5);
+    if (status == PJ_SUCCESS) {
+        hdr = (pjsip_www_authenticate_hdr*)
+              pjsip_msg_find_hdr(tdata->msg, PJSIP_H_WWW_AUTHENTICATE, NULL);
+        pj_strdup(pool, nonce, &hdr->challenge.digest.nonce);
+    }
+
+    pjsip_tx_data_dec_ref(tdata);
+    return status;
+}
+
+/* Parse the message as if it was received by a transport */
+static pjsip_rx_data *parse_msg(pj_pool_t *pool, char *buf)
+{
+    pjsip_rx_data *rdata = PJ_POOL_ZALLOC_T(pool, pjsip_rx_data);
+
+    rdata->tp_info.pool = pool;
+    rdata->msg_info.msg_buf = buf;
+    rdata->msg_info.len = (int)pj_ansi_strlen(buf);
+    pj_list_init(&rdata->msg_info.parse_err);
+
+    if (!pjsip_parse_rdata(buf, rdata->msg_info.len, rdata))
+        return NULL;
+    return rdata;
+}
+
+/* Send an authorized REGISTER to the server. */
+static pj_status_t verify(pjsip_auth_srv *srv, pj_pool_t *pool,
+                          const pj_str_t *nonce, const char *nc,
+                          const char *passwd, int *status_code)
+{
+    const pj_str_t method = { "REGISTER", 8 };
+    const pj_str_t realm = { REALM, sizeof(REALM)-1 };
+    const pj_str_t uri = { URI, sizeof(URI)-1 };
+    const pj_str_t cnonce = { "abcdef", 6 };
+    const pj_str_t qop = { "auth", 4 };
+    char digest_buf[PJSIP_AUTH_MAX_DIGEST_BUFFER_LENGTH * 2];
+    pj_str_t digest, nc_str;
+    pjsip_cred_info cred;
+    pjsip_rx_data *rdata;
+    char *buf;
+    pj_status_t status;
+
+    pj_bzero(&cred, sizeof(cred));
+    cred.realm = realm;
+    cred.username = pj_str(USER);
+    cred.data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
+    cred.data = pj_str((char*)passwd);
+
+    nc_str = pj_str((char*)nc);
+    digest.ptr = digest_buf;
+    digest.slen = sizeof(digest_buf);
+    status = pjsip_auth_create_digest2(&digest, nonce, &nc_str, &cnonce, &qop,
+                                       &uri, &realm, &cred, &method,
+                                       PJSIP_AUTH_ALGORITHM_MD5);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    buf = (char*) pj_pool_alloc(pool, PJSIP_MAX_PKT_LEN);
+    pj_ansi_snprintf(buf, PJSIP_MAX_PKT_LEN,
+        "REGISTER " URI " SIP/2.0\r\n"
+        "Via: SIP/2.0/UDP 10.0.0.1;branch=z9hG4bKauth\r\n"
+        "From: <sip:" USER "@" REALM ">;tag=1\r\n"
+        "To: <sip:" USER "@" REALM ">\r\n"
+        "Call-ID: auth-test\r\n"
+        "CSeq: 1 REGISTER\r\n"
+        "Authorization: Digest username=\"" USER "\", realm=\"" REALM "\", "
+            "nonce=\"%.*s\", uri=\"" URI "\", response=\"%.*s\", "
+            "algorithm=MD5, qop=auth, nc=%s, cnonce=\"abcdef\"\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n",
+        (int)nonce->slen, nonce->ptr, (int)digest.slen, digest.ptr, nc);
+
+    rdata = parse_msg(pool, buf);
+    if (!rdata)
+        return PJSIP_EINVALIDMSG;
+
+    *status_code = 0;
+    return pjsip_auth_srv_verify(srv, rdata, status_code);
+}
+
+/*
+ * Credential cache: the lookup function is only called on the first
+ * request, until the account is invalidated.
+ */
+static int cache_test(pj_pool_t *pool)
+{
+    const pj_str_t realm = { REALM, sizeof(REALM)-1 };
+    const pj_str_t user = { USER, sizeof(USER)-1 };
+    pjsip_auth_srv_init_param param;
+    pjsip_auth_srv srv;
+    pjsip_auth_srv_cache *cache;
+    unsigned hits, misses;
+    pj_str_t nonce;
+    int code, rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  credential cache test"));
+
+    status = pjsip_auth_srv_cache_create(&caching_pool.factory, 0, 0,
+                                         &cache);
+    if (status != PJ_SUCCESS)
+        return -100;
+
+    pj_bzero(&param, sizeof(param));
+    param.realm = &realm;
+    param.lookup2 = &lookup_cred;
+    param.cache = cache;
+    pjsip_auth_srv_init2(pool, &srv, &param);
+
+    lookup_cnt = 0;
+    if (challenge(&srv, pool, &nonce) != PJ_SUCCESS) {
+        rc = -110;
+        goto on_return;
+    }
+
+    if (verify(&srv, pool, &nonce, "00000001", PASSWD, &code) != PJ_SUCCESS ||
+        verify(&srv, pool, &nonce, "00000002", PASSWD, &code) != PJ_SUCCESS ||
+        verify(&srv, pool, &nonce, "00000003", PASSWD, &code) != PJ_SUCCESS)
+    {
+        rc = -120;
+        goto on_return;
+    }
+    if (lookup_cnt != 1) {
+        PJ_LOG(3,(THIS_FILE, "   error: %d lookups", lookup_cnt));
+        rc = -130;
+        goto on_return;
+    }
+
+    /* Wrong password is still rejected with a cached credential */
+    status = verify(&srv, pool, &nonce, "00000004", "wrong", &code);
+    if (status != PJSIP_EAUTHINVALIDDIGEST || code != PJSIP_SC_FORBIDDEN) {
+        rc = -140;
+        goto on_return;
+    }
+
+    pjsip_auth_srv_cache_get_stat(cache, &hits, &misses);
+    if (hits != 3 || misses != 1) {
+        PJ_LOG(3,(THIS_FILE, "   error: %d hits, %d misses", hits, misses));
+        rc = -150;
+        goto on_return;
+    }
+
+    /* Looked up again after invalidation */
+    pjsip_auth_srv_cache_invalidate(cache, &realm, &user);
+    if (verify(&srv, pool, &nonce, "00000005", PASSWD, &code) != PJ_SUCCESS ||
+        lookup_cnt != 2)
+    {
+        rc = -160;
+        goto on_return;
+    }
+
+on_return:
+    pjsip_auth_srv_cache_destroy(cache);
+    return rc;
+}
+
+/*
+ * Nonce store: only issued nonces are accepted, and a nonce count can't
+ * be used twice.
+ */
+static int nonce_test(pj_pool_t *pool)
+{
+    const pj_str_t realm = { REALM, sizeof(REALM)-1 };
+    const pj_str_t unknown = { "0123456789abcdef", 16 };
+    pjsip_auth_srv_init_param param;
+    pjsip_auth_srv srv;
+    pjsip_auth_nonce_store *store;
+    pj_str_t nonce;
+    int code, rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  nonce store test"));
+
+    status = pjsip_auth_nonce_store_create(&caching_pool.factory, 0, 0,
+                                           &store);
+    if (status != PJ_SUCCESS)
+        return -200;
+
+    pj_bzero(&param, sizeof(param));
+    param.realm = &realm;
+    param.lookup2 = &lookup_cred;
+    param.nonce_store = store;
+    pjsip_auth_srv_init2(pool, &srv, &param);
+
+    if (challenge(&srv, pool, &nonce) != PJ_SUCCESS) {
+        rc = -210;
+        goto on_return;
+    }
+
+    status = verify(&srv, pool, &nonce, "00000001", PASSWD, &code);
+    if (status != PJ_SUCCESS) {
+        app_perror("   error: verification failed", status);
+        rc = -220;
+        goto on_return;
+    }
+
+    /* Replayed nonce count */
+    status = verify(&srv, pool, &nonce, "00000001", PASSWD, &code);
+    if (status != PJSIP_EAUTHSTALENONCE || code != 401) {
+        rc = -230;
+        goto on_return;
+    }
+
+    if (verify(&srv, pool, &nonce, "0000000a", PASSWD, &code) != PJ_SUCCESS) {
+        rc = -240;
+        goto on_return;
+    }
+
+    /* Nonce not issued by the server */
+    status = verify(&srv, pool, &unknown, "00000001", PASSWD, &code);
+    if (status != PJSIP_EAUTHSTALENONCE || code != 401) {
+        rc = -250;
+        goto on_return;
+    }
+
+    /* Wrong password is not reported as stale */
+    status = verify(&srv, pool, &unknown, "00000002", "wrong", &code);
+    if (status != PJSIP_EAUTHINVALIDDIGEST) {
+        rc = -260;
+        goto on_return;
+    }
+
+on_return:
+    pjsip_auth_nonce_store_destroy(store);
+    return rc;
+}
+
+/* Create a REGISTER request with the client session. */
+static pj_status_t create_request(pjsip_auth_clt_sess *sess,
+                                  pjsip_tx_data **p_tdata)
+{
+    const pj_str_t target = { URI, sizeof(URI)-1 };
+    const pj_str_t aor = { "<sip:" USER "@" REALM ">",
+                           sizeof("<sip:" USER "@" REALM ">")-1 };
+    pjsip_via_hdr *via;
+    pj_status_t status;
+
+    status = pjsip_endpt_create_request(endpt, &pjsip_register_method,
+                                        &target, &aor, &aor, NULL, NULL, -1,
+                                        NULL, p_tdata);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr((*p_tdata)->msg, PJSIP_H_VIA,
+                                              NULL);
+    via->transport = pj_str("UDP");
+    via->sent_by.host = pj_str("10.0.0.1");
+
+    status = pjsip_auth_clt_init_req(sess, *p_tdata);
+    if (status != PJ_SUCCESS)
+        pjsip_tx_data_dec_ref(*p_tdata);
+
+    return status;
+}
+
+/* Verify the authorization of a request sent by the client session. */
+static pj_status_t verify_request(pjsip_auth_srv *srv, pj_pool_t *pool,
+                                  pjsip_tx_data *tdata)
+{
+    pjsip_rx_data *rdata;
+    char *buf;
+    pj_ssize_t len;
+    int code;
+
+    buf = (char*) pj_pool_alloc(pool, PJSIP_MAX_PKT_LEN);
+    len = pjsip_msg_print(tdata->msg, buf, PJSIP_MAX_PKT_LEN - 1);
+    if (len < 1)
+        return PJSIP_EMSGTOOLONG;
+    buf[len] = '\0';
+
+    rdata = parse_msg(pool, buf);
+    if (!rdata)
+        return PJSIP_EINVALIDMSG;
+
+    return pjsip_auth_srv_verify(srv, rdata, &code);
+}
+
+/*
+ * Client session: the "ha1" is only hashed once, and new requests are
+ * sent with authorization from the last challenge.
+ */
+static int client_test(pj_pool_t *pool)
+{
+    const pj_str_t realm = { REALM, sizeof(REALM)-1 };
+    pjsip_auth_srv_init_param param;
+    pjsip_auth_srv srv;
+    pjsip_auth_clt_sess sess;
+    pjsip_auth_clt_pref pref;
+    pjsip_auth_clt_stat stat;
+    pjsip_cred_info cred;
+    pjsip_tx_data *tdata, *new_tdata;
+    pjsip_rx_data *rdata;
+    pj_str_t nonce;
+    char *buf;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  client session test"));
+
+    pj_bzero(&param, sizeof(param));
+    param.realm = &realm;
+    param.lookup2 = &lookup_cred;
+    pjsip_auth_srv_init2(pool, &srv, &param);
+
+    pj_bzero(&sess, sizeof(sess));
+    pjsip_auth_clt_init(&sess, endpt, pool, 0);
+
+    pj_bzero(&cred, sizeof(cred));
+    cred.realm = realm;
+    cred.scheme = pj_str("digest");
+    cred.username = pj_str(USER);
+    cred.data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
+    cred.data = pj_str(PASSWD);
+    pjsip_auth_clt_set_credentials(&sess, 1, &cred);
+
+    pj_bzero(&pref, sizeof(pref));
+    pref.auto_send_next = PJ_TRUE;
+    pjsip_auth_clt_set_prefs(&sess, &pref);
+
+    if (challenge(&srv, pool, &nonce) != PJ_SUCCESS) {
+        rc = -300;
+        goto on_return;
+    }
+
+    /* The first request is challenged */
+    if (create_request(&sess, &tdata) != PJ_SUCCESS) {
+        rc = -310;
+        goto on_return;
+    }
+
+    buf = (char*) pj_pool_alloc(pool, PJSIP_MAX_PKT_LEN);
+    pj_ansi_snprintf(buf, PJSIP_MAX_PKT_LEN,
+        "SIP/2.0 401 Unauthorized\r\n"
+        "Via: SIP/2.0/UDP 10.0.0.1;branch=z9hG4bKauth\r\n"
+        "From: <sip:" USER "@" REALM ">;tag=1\r\n"
+        "To: <sip:" USER "@" REALM ">;tag=2\r\n"
+        "Call-ID: auth-test\r\n"
+        "CSeq: 1 REGISTER\r\n"
+        "WWW-Authenticate: Digest realm=\"" REALM "\", nonce=\"%.*s\", "
+            "qop=\"auth\", algorithm=MD5\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n",
+        (int)nonce.slen, nonce.ptr);
+    rdata = parse_msg(pool, buf);
+    if (!rdata) {
+        pjsip_tx_data_dec_ref(tdata);
+        rc = -320;
+        goto on_return;
+    }
+
+    status = pjsip_auth_clt_reinit_req(&sess, rdata, tdata, &new_tdata);
+    pjsip_tx_data_dec_ref(tdata);
+    if (status != PJ_SUCCESS) {
+        app_perror("   error: unable to authorize request", status);
+        rc = -330;
+        goto on_return;
+    }
+
+    status = verify_request(&srv, pool, new_tdata);
+    pjsip_tx_data_dec_ref(new_tdata);
+    if (status != PJ_SUCCESS) {
+        app_perror("   error: authorization rejected", status);
+        rc = -340;
+        goto on_return;
+    }
+
+    /* The next request is authorized without a challenge */
+    if (create_request(&sess, &tdata) != PJ_SUCCESS) {
+        rc = -350;
+        goto on_return;
+    }
+    status = verify_request(&srv, pool, tdata);
+    pjsip_tx_data_dec_ref(tdata);
+    if (status != PJ_SUCCESS) {
+        app_perror("   error: next authorization rejected", status);
+        rc = -360;
+        goto on_return;
+    }
+
+    pjsip_auth_clt_get_stat(&sess, &stat);
+    if (stat.chal_cnt != 1 || stat.retry_cnt != 1 || stat.reuse_cnt != 1 ||
+        stat.ha1_cnt != 1 || stat.ha1_reuse_cnt != 1)
+    {
+        PJ_LOG(3,(THIS_FILE, "   error: chal=%d retry=%d reuse=%d ha1=%d "
+                  "ha1_reuse=%d", stat.chal_cnt, stat.retry_cnt,
+                  stat.reuse_cnt, stat.ha1_cnt, stat.ha1_reuse_cnt));
+        rc = -370;
+        goto on_return;
+    }
+
+on_return:
+    pjsip_auth_clt_deinit(&sess);
+    return rc;
+}
+
+int auth_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    pool = pjsip_endpt_create_pool(endpt, "authtest", 4000, 4000);
+
+    rc = cache_test(pool);
+    if (rc == 0)
+        rc = nonce_test(pool);
+    if (rc == 0)
+        rc = client_test(pool);
+
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
@@ -20,3 +20,231 @@
 #include "test.h"
 #include <pjsip.h>
 
+
+#define THIS_FILE   "dlg_core_test.c"
+
+/* Number of dialogs in the dialog table during the tests */
+#define DLG_CNT     1000
+
+
+/* Dialog lookup from several worker threads at once */
+typedef struct lookup_worker
+{
+    pj_thread_t     *thread;
+    pjsip_dialog   **dlg;
+    unsigned         dlg_cnt;
+    unsigned         start;
+    unsigned         loop;
+    unsigned         found;
+} lookup_worker;
+
+static int lookup_worker_thread(void *arg)
+{
+    lookup_worker *w = (lookup_worker*)arg;
+    unsigned i, idx = w->start;
+
+    for (i=0; i<w->loop; ++i) {
+        pjsip_dialog *dlg = w->dlg[idx];
+
+        if (pjsip_ua_find_dialog(&dlg->call_id->id, &dlg->local.info->tag,
+                                 &dlg->remote.info->tag, PJ_FALSE) == dlg)
+        {
+            ++w->found;
+        }
+        if (++idx == w->dlg_cnt)
+            idx = 0;
+    }
+    return 0;
+}
+
+static int lookup_dlg_bench(pj_pool_t *pool, pjsip_dialog *dlg[],
+                            unsigned dlg_cnt, unsigned loop,
+                            unsigned thread_cnt, pj_timestamp *p_elapsed)
+{
+    lookup_worker *workers;
+    pj_timestamp t1, t2;
+    unsigned i;
+    int rc = 0;
+
+    workers = (lookup_worker*)
+              pj_pool_zalloc(pool, thread_cnt * sizeof(lookup_worker));
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<thread_cnt; ++i) {
+        workers[i].dlg = dlg;
+        workers[i].dlg_cnt = dlg_cnt;
+        workers[i].start = i * dlg_cnt / thread_cnt;
+        workers[i].loop = loop / thread_cnt;
+        PJ_TEST_SUCCESS(pj_thread_create(pool, "dlglookup%p",
+                                         &lookup_worker_thread, &workers[i],
+                                         0, 0, &workers[i].thread),
+                        NULL, {rc=-110; break;});
+    }
+    for (i=0; i<thread_cnt; ++i) {
+        if (workers[i].thread) {
+            pj_thread_join(workers[i].thread);
+            pj_thread_destroy(workers[i].thread);
+        }
+    }
+    pj_get_timestamp(&t2);
+    pj_sub_timestamp(&t2, &t1);
+    p_elapsed->u64 = t2.u64;
+
+    for (i=0; rc==0 && i<thread_cnt; ++i) {
+        PJ_TEST_EQ(workers[i].found, workers[i].loop, NULL, rc=-120);
+    }
+
+    return rc;
+}
+
+/* Check that dialogs are found only by their own Call-ID and tags */
+static int lookup_dlg_test(pjsip_dialog *dlg[], unsigned dlg_cnt,
+                           unsigned initial_cnt)
+{
+    const pj_str_t bad = pj_str("no-such-id");
+    pjsip_dialog *found;
+    unsigned i;
+
+    PJ_TEST_EQ(pjsip_ua_get_dlg_set_count(), initial_cnt + dlg_cnt, NULL,
+               return -200);
+
+    for (i=0; i<dlg_cnt; ++i) {
+        pjsip_dialog *d = dlg[i];
+
+        /* Don't lock, releasing the lock destroys dialog without session */
+        found = pjsip_ua_find_dialog(&d->call_id->id, &d->local.info->tag,
+                                     &d->remote.info->tag, PJ_FALSE);
+        PJ_TEST_EQ(found, d, NULL, return -210);
+
+        PJ_TEST_EQ(pjsip_ua_find_dialog(&bad, &d->local.info->tag,
+                                        &d->remote.info->tag, PJ_FALSE),
+                   NULL, NULL, return -220);
+        PJ_TEST_EQ(pjsip_ua_find_dialog(&d->call_id->id, &bad,
+                                        &d->remote.info->tag, PJ_FALSE),
+                   NULL, NULL, return -230);
+        PJ_TEST_EQ(pjsip_ua_find_dialog(&d->call_id->id, &d->local.info->tag,
+                                        &bad, PJ_FALSE),
+                   NULL, NULL, return -240);
+    }
+
+    return 0;
+}
+
+
+/* Dialogs shared by the test and the benchmark */
+static struct dlg_core_global
+{
+    pj_pool_t       *pool;
+    pjsip_dialog   **dlg;
+    unsigned         initial_cnt;
+    pj_bool_t        ua_initialized;
+} g;
+
+static int create_dialogs(void)
+{
+    pj_str_t local_uri = pj_str("<sip:dlg-core-test@127.0.0.1>");
+    pj_str_t remote_uri = pj_str("<sip:remote@127.0.0.1>");
+    unsigned i;
+
+    pj_bzero(&g, sizeof(g));
+
+    /* Init UA layer */
+    if (pjsip_ua_instance()->id == -1) {
+        PJ_TEST_SUCCESS(pjsip_ua_init_module(endpt, NULL), NULL, return -20);
+        g.ua_initialized = PJ_TRUE;
+    }
+
+    /* Dialogs of the previous tests may still be around */
+    g.initial_cnt = pjsip_ua_get_dlg_set_count();
+
+    g.pool = pjsip_endpt_create_pool(endpt, "dlgcore", 4000, 4000);
+    g.dlg = (pjsip_dialog**) pj_pool_zalloc(g.pool,
+                                            DLG_CNT * sizeof(pjsip_dialog*));
+
+    for (i=0; i<DLG_CNT; ++i) {
+        PJ_TEST_SUCCESS(pjsip_dlg_create_uac(pjsip_ua_instance(), &local_uri,
+                                             NULL, &remote_uri, NULL,
+                                             &g.dlg[i]),
+                        NULL, return -30);
+    }
+
+    return 0;
+}
+
+static int destroy_dialogs(int rc)
+{
+    unsigned i;
+
+    if (g.pool) {
+        for (i=0; i<DLG_CNT; ++i) {
+            if (g.dlg[i])
+                pjsip_dlg_terminate(g.dlg[i]);
+        }
+        if (rc == 0) {
+            PJ_TEST_EQ(pjsip_ua_get_dlg_set_count(), g.initial_cnt, NULL,
+                       rc=-40);
+        }
+        pj_pool_release(g.pool);
+    }
+
+    if (g.ua_initialized)
+        pjsip_ua_destroy();
+
+    pj_bzero(&g, sizeof(g));
+    return rc;
+}
+
+int dlg_core_test(void)
+{
+    int rc;
+
+    rc = create_dialogs();
+    if (rc == 0)
+        rc = lookup_dlg_test(g.dlg, DLG_CNT, g.initial_cnt);
+
+    return destroy_dialogs(rc);
+}
+
+int dlg_core_bench(void)
+{
+    enum { LOOKUP_LOOP=1600000 };
+    static const unsigned lookup_threads[] = { 1, 4, 8, 16 };
+    pj_timestamp elapsed, freq;
+    unsigned i, speed;
+    char desc[250];
+    int rc;
+
+    PJ_TEST_SUCCESS(pj_get_timestamp_freq(&freq), NULL, return -10);
+
+    rc = create_dialogs();
+    if (rc != 0)
+        return destroy_dialogs(rc);
+
+    /*
+     * Benchmark concurrent lookup
+     */
+    PJ_LOG(3,(THIS_FILE, "   benchmarking concurrent dialog lookup:"));
+    for (i=0; i<PJ_ARRAY_SIZE(lookup_threads); ++i) {
+        char name[40];
+
+        rc = lookup_dlg_bench(g.pool, g.dlg, DLG_CNT, LOOKUP_LOOP,
+                              lookup_threads[i], &elapsed);
+        if (rc != 0)
+            break;
+
+        speed = (unsigned)(freq.u64 * LOOKUP_LOOP / elapsed.u64);
+        PJ_LOG(3,(THIS_FILE, "    %2d thread(s): %d lookup/sec",
+                  lookup_threads[i], speed));
+
+        pj_ansi_snprintf(name, sizeof(name), "lookup-dlg-%d-threads-per-sec",
+                         lookup_threads[i]);
+        pj_ansi_snprintf(desc, sizeof(desc),
+                         "Number of dialog lookups per second with "
+                         "<tt>pjsip_ua_find_dialog()</tt> from %d "
+                         "threads, among %d dialogs.",
+                         lookup_threads[i], DLG_CNT);
+        report_ival(name, speed, "lookup/sec", desc);
+    }
+
+    return destroy_dialogs(rc);
+}
@@ -506,6 +506,37 @@ static int round_robin_test(pj_pool_t *pool)
 }
 
 
+/* Replace the A record of a host in the DNS resolver cache */
+static void set_a_record(pj_dns_resolver *resv, char *name, char *addr)
+{
+    pj_dns_parsed_packet pkt;
+    pj_dns_parsed_query q;
+    pj_dns_parsed_rr ans;
+    pj_str_t tmp;
+
+    pj_bzero(&pkt, sizeof(pkt));
+    pj_bzero(&ans, sizeof(ans));
+
+    ans.name = pj_str(name);
+    ans.type = PJ_DNS_TYPE_A;
+    ans.dnsclass = PJ_DNS_CLASS_IN;
+    ans.ttl = 3600;
+    ans.rdata.a.ip_addr = pj_inet_addr(pj_cstr(&tmp, addr));
+
+    q.name = ans.name;
+    q.type = ans.type;
+    q.dnsclass = ans.dnsclass;
+
+    pkt.hdr.flags = PJ_DNS_SET_QR(1);
+    pkt.hdr.qdcount = 1;
+    pkt.hdr.anscount = 1;
+    pkt.q = &q;
+    pkt.ans = &ans;
+
+    pj_dns_resolver_add_entry(resv, &pkt, PJ_FALSE);
+}
+
+
 #define C(expr)     status = expr; \
                     if (status != PJ_SUCCESS) app_perror(THIS_FILE, "Error", status);
 
@@ -541,6 +572,96 @@ static void create_ref(pjsip_server_addresses *r,
 }
 
 
+/*
+ * Routing cache and target health test.
+ */
+static int routing_cache_test(pj_pool_t *pool, pj_dns_resolver *resv)
+{
+    pjsip_resolver_t *res = pjsip_endpt_get_sip_resolver(endpt);
+    pjsip_resolver_cache_cfg cfg;
+    pjsip_resolver_target_info info;
+    pjsip_server_addresses ref;
+    pj_sockaddr target;
+    pj_str_t tmp;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, " Performing routing cache test.."));
+
+    pjsip_resolver_cache_cfg_default(&cfg);
+    PJ_TEST_SUCCESS(pjsip_resolver_set_cache(res, &caching_pool.factory,
+                                             &cfg), NULL, return -10);
+
+    pj_sockaddr_init(pj_AF_INET(), &target, pj_cstr(&tmp, "6.6.6.6"),
+                     50060);
+
+    /* Populate the cache */
+    create_ref(&ref, PJSIP_TRANSPORT_TCP, "6.6.6.6", 50060);
+    add_ref(&ref, PJSIP_TRANSPORT_TCP, "7.7.7.7", 50060);
+    PJ_TEST_SUCCESS(test_resolve("routing cache: populate", pool,
+                                 PJSIP_TRANSPORT_TCP, "domain.com", 0, &ref),
+                    NULL, { rc = -20; goto on_return; });
+
+    /* Change the DNS record, the result must still come from the cache */
+    set_a_record(resv, "sip06.domain.com", "8.8.8.8");
+    PJ_TEST_SUCCESS(test_resolve("routing cache: hit", pool,
+                                 PJSIP_TRANSPORT_TCP, "domain.com", 0, &ref),
+                    NULL, { rc = -30; goto on_return; });
+
+    /* Unknown target */
+    PJ_TEST_EQ(pjsip_resolver_get_target_info(res, &target,
+                                              pj_sockaddr_get_len(&target),
+                                              &info),
+               PJ_ENOTFOUND, NULL, { rc = -40; goto on_return; });
+
+    /* A single failure doesn't put the target down yet */
+    pjsip_resolver_report_target(res, &target, pj_sockaddr_get_len(&target),
+                                 PJSIP_SC_TSX_TIMEOUT, 0);
+    PJ_TEST_SUCCESS(pjsip_resolver_get_target_info(res, &target,
+                                                   pj_sockaddr_get_len(&target),
+                                                   &info),
+                    NULL, { rc = -50; goto on_return; });
+    PJ_TEST_EQ(info.fail_cnt, 1, NULL, { rc = -51; goto on_return; });
+    PJ_TEST_EQ(info.is_down, PJ_FALSE, NULL, { rc = -52; goto on_return; });
+
+    /* Second failure does, and the target must be tried last */
+    pjsip_resolver_report_target(res, &target, pj_sockaddr_get_len(&target),
+                                 PJSIP_SC_SERVICE_UNAVAILABLE, 0);
+    PJ_TEST_SUCCESS(pjsip_resolver_get_target_info(res, &target,
+                                                   pj_sockaddr_get_len(&target),
+                                                   &info),
+                    NULL, { rc = -60; goto on_return; });
+    PJ_TEST_EQ(info.is_down, PJ_TRUE, NULL, { rc = -61; goto on_return; });
+
+    create_ref(&ref, PJSIP_TRANSPORT_TCP, "7.7.7.7", 50060);
+    add_ref(&ref, PJSIP_TRANSPORT_TCP, "6.6.6.6", 50060);
+    PJ_TEST_SUCCESS(test_resolve("routing cache: target down", pool,
+                                 PJSIP_TRANSPORT_TCP, "domain.com", 0, &ref),
+                    NULL, { rc = -70; goto on_return; });
+
+    /* A response brings the target back */
+    pjsip_resolver_report_target(res, &target, pj_sockaddr_get_len(&target),
+                                 PJSIP_SC_OK, 20);
+    PJ_TEST_SUCCESS(pjsip_resolver_get_target_info(res, &target,
+                                                   pj_sockaddr_get_len(&target),
+                                                   &info),
+                    NULL, { rc = -80; goto on_return; });
+    PJ_TEST_EQ(info.fail_cnt, 0, NULL, { rc = -81; goto on_return; });
+    PJ_TEST_EQ(info.is_down, PJ_FALSE, NULL, { rc = -82; goto on_return; });
+    PJ_TEST_EQ(info.rtt, 20, NULL, { rc = -83; goto on_return; });
+
+    create_ref(&ref, PJSIP_TRANSPORT_TCP, "6.6.6.6", 50060);
+    add_ref(&ref, PJSIP_TRANSPORT_TCP, "7.7.7.7", 50060);
+    PJ_TEST_SUCCESS(test_resolve("routing cache: target up", pool,
+                                 PJSIP_TRANSPORT_TCP, "domain.com", 0, &ref),
+                    NULL, { rc = -90; goto on_return; });
+
+on_return:
+    pjsip_resolver_set_cache(res, NULL, NULL);
+    set_a_record(resv, "sip06.domain.com", "6.6.6.6");
+    return rc;
+}
+
+
 /*
  * Main test entry.
  */
@@ -645,6 +766,10 @@ int resolve_test(void)
     if (round_robin_test(pool) != 0)
         return -170;
 
+    /* Routing cache test */
+    if (routing_cache_test(pool, resv) != 0)
+        return -175;
+
     /* Timeout test */
     {
         status = test_resolve("timeout test", pool, PJSIP_TRANSPORT_UNSPECIFIED, "an.invalid.address", 0, NULL);
@@ -316,6 +316,9 @@ parse_msg:
     if ((var.flag & FLAG_PARSE_ONLY) || entry->creator==NULL)
         return PJ_SUCCESS;
 
+    /* Lazy headers must be parsed before the headers are compared */
+    pjsip_msg_parse_lazy_hdrs(parsed_msg);
+
     /* Create reference message. */
     ref_msg = entry->creator(pool);
     if (ref_msg == NULL) {
@@ -849,7 +852,767 @@ static pj_status_t simple_test(void)
 }
 
 
+/*****************************************************************************/
+/* Lazy header parsing */
+static int lazy_test(void)
+{
+    char buf[] =
+        "INVITE sip:bob@example.com SIP/2.0\r\n"
+        "Via: SIP/2.0/UDP proxy.example.com;branch=z9hG4bK-1\r\n"
+        "v: SIP/2.0/UDP client.example.com;branch=z9hG4bK-2, "
+            "SIP/2.0/TCP host;branch=z9hG4bK-3\r\n"
+        "Max-Forwards: 70\r\n"
+        "From: <sip:alice@example.com>;tag=1\r\n"
+        "To: <sip:bob@example.com>\r\n"
+        "Call-ID: lazy@example.com\r\n"
+        "CSeq: 1 INVITE\r\n"
+        "m: <sip:alice@client.example.com>;expires=60\r\n"
+        "Allow: INVITE, ACK, BYE\r\n"
+        "Expires: bad value\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n";
+    const pj_str_t STR_ALLOW = { "Allow", 5 };
+    pj_bool_t saved_lazy = pjsip_cfg()->endpt.lazy_hdr_parsing;
+    pj_pool_t *pool;
+    pjsip_msg *msg, *clone;
+    pjsip_hdr *hdr;
+    pjsip_via_hdr *via;
+    pjsip_contact_hdr *contact;
+    pjsip_allow_hdr *allow;
+    pjsip_generic_string_hdr *expires;
+    char pbuf[PJSIP_MAX_PKT_LEN];
+    pj_ssize_t len;
+    unsigned i, lazy_cnt = 0;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  lazy header parsing test.."));
+
+    pjsip_cfg()->endpt.lazy_hdr_parsing = PJ_TRUE;
+
+    /* Parsing all lazy headers must give the same message */
+    for (i=0; i<PJ_ARRAY_SIZE(test_array); ++i) {
+        pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+        rc = test_entry(pool, &test_array[i]);
+        pjsip_endpt_release_pool(endpt, pool);
+        if (rc != 0) {
+            rc = -500 + rc;
+            goto on_return;
+        }
+    }
+
+    pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+
+    msg = pjsip_parse_msg(pool, buf, pj_ansi_strlen(buf), NULL);
+    PJ_TEST_NOT_NULL(msg, NULL, { rc = -700; goto on_error; });
+
+    /* Second Via line, Contact, Allow and Expires are not parsed yet */
+    for (hdr=msg->hdr.next; hdr!=&msg->hdr; hdr=hdr->next) {
+        if (pjsip_hdr_is_lazy(hdr))
+            ++lazy_cnt;
+    }
+    PJ_TEST_EQ(lazy_cnt, 4, NULL, { rc = -701; goto on_error; });
+
+    clone = pjsip_msg_clone(pool, msg);
+
+    /* Printing a lazy header prints the raw value */
+    len = pjsip_msg_print(msg, pbuf, sizeof(pbuf));
+    PJ_TEST_GT(len, 0, NULL, { rc = -702; goto on_error; });
+    pbuf[len] = '\0';
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(pbuf, "\r\nm: <sip:alice@client."
+                                          "example.com>;expires=60\r\n"),
+                     pbuf, { rc = -703; goto on_error; });
+
+    /* The top Via is parsed, the others on lookup */
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_VIA, NULL);
+    PJ_TEST_NOT_NULL(via, NULL, { rc = -704; goto on_error; });
+    PJ_TEST_EQ(pj_strcmp2(&via->branch_param, "z9hG4bK-1"), 0, NULL,
+               { rc = -705; goto on_error; });
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_VIA, via->next);
+    PJ_TEST_NOT_NULL(via, NULL, { rc = -706; goto on_error; });
+    PJ_TEST_EQ(pj_strcmp2(&via->branch_param, "z9hG4bK-2"), 0, NULL,
+               { rc = -707; goto on_error; });
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_VIA, via->next);
+    PJ_TEST_NOT_NULL(via, NULL, { rc = -708; goto on_error; });
+    PJ_TEST_EQ(pj_strcmp2(&via->branch_param, "z9hG4bK-3"), 0, NULL,
+               { rc = -709; goto on_error; });
+    PJ_TEST_EQ(pjsip_msg_find_hdr(msg, PJSIP_H_VIA, via->next), NULL, NULL,
+               { rc = -710; goto on_error; });
+
+    /* Compact form */
+    contact = (pjsip_contact_hdr*)
+              pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, NULL);
+    PJ_TEST_NOT_NULL(contact, NULL, { rc = -711; goto on_error; });
+    PJ_TEST_EQ(contact->expires, 60, NULL, { rc = -712; goto on_error; });
+
+    /* Lookup by name */
+    allow = (pjsip_allow_hdr*)
+            pjsip_msg_find_hdr_by_name(msg, &STR_ALLOW, NULL);
+    PJ_TEST_NOT_NULL(allow, NULL, { rc = -713; goto on_error; });
+    PJ_TEST_EQ(allow->type, PJSIP_H_ALLOW, NULL, { rc = -714; goto on_error; });
+    PJ_TEST_EQ(allow->count, 3, NULL, { rc = -715; goto on_error; });
+
+    /* Invalid header is kept as generic header */
+    PJ_TEST_EQ(pjsip_msg_find_hdr(msg, PJSIP_H_EXPIRES, NULL), NULL, NULL,
+               { rc = -716; goto on_error; });
+    expires = (pjsip_generic_string_hdr*)
+              pjsip_msg_find_hdr(msg, PJSIP_H_OTHER, NULL);
+    PJ_TEST_NOT_NULL(expires, NULL, { rc = -717; goto on_error; });
+    PJ_TEST_EQ(pjsip_hdr_is_lazy(expires), PJ_FALSE, NULL,
+               { rc = -718; goto on_error; });
+    PJ_TEST_EQ(pj_strcmp2(&expires->hvalue, "bad value"), 0, NULL,
+               { rc = -719; goto on_error; });
+
+    /* The clone keeps its own lazy headers, and looking for unknown
+     * headers doesn't parse lazy headers of known types.
+     */
+    PJ_TEST_EQ(pjsip_msg_find_hdr(clone, PJSIP_H_OTHER, NULL), NULL, NULL,
+               { rc = -722; goto on_error; });
+    lazy_cnt = 0;
+    for (hdr=clone->hdr.next; hdr!=&clone->hdr; hdr=hdr->next) {
+        if (pjsip_hdr_is_lazy(hdr))
+            ++lazy_cnt;
+    }
+    PJ_TEST_EQ(lazy_cnt, 4, NULL, { rc = -723; goto on_error; });
+
+    contact = (pjsip_contact_hdr*)
+              pjsip_msg_find_hdr(clone, PJSIP_H_CONTACT, NULL);
+    PJ_TEST_NOT_NULL(contact, NULL, { rc = -720; goto on_error; });
+    pjsip_msg_parse_lazy_hdrs(clone);
+    for (hdr=clone->hdr.next; hdr!=&clone->hdr; hdr=hdr->next) {
+        PJ_TEST_EQ(pjsip_hdr_is_lazy(hdr), PJ_FALSE, NULL,
+                   { rc = -721; goto on_error; });
+    }
+
+on_error:
+    pjsip_endpt_release_pool(endpt, pool);
+on_return:
+    pjsip_cfg()->endpt.lazy_hdr_parsing = saved_lazy;
+    return rc;
+}
+
+
+/*****************************************************************************/
+/* Frozen headers */
+static const char *frozen_hdrs[][2] =
+{
+    { "Allow", "INVITE, ACK, BYE, CANCEL, OPTIONS, PRACK, UPDATE, NOTIFY, "
+               "SUBSCRIBE, REFER, MESSAGE" },
+    { "Supported", "replaces, 100rel, timer, norefersub, trickle-ice" },
+    { "Contact", "<sip:alice@192.168.0.1:5060;transport=tcp;ob>;"
+                 "+sip.instance=\"<urn:uuid:00000000-0000-1000-8000-"
+                 "000A95A0E128>\"" },
+    { "Route", "<sip:edge.example.com;transport=tcp;lr>" },
+    { "Route", "<sip:core.example.com;lr>" }
+};
+
+/* Create a message with the headers above, optionally frozen */
+static pjsip_msg *create_frozen_msg(pj_pool_t *pool, pj_bool_t freeze)
+{
+    pjsip_msg *msg;
+    unsigned i;
+
+    msg = pjsip_msg_create(pool, PJSIP_REQUEST_MSG);
+    pjsip_method_set(&msg->line.req.method, PJSIP_INVITE_METHOD);
+    msg->line.req.uri = pjsip_parse_uri(pool, "sip:bob@example.com", 19, 0);
+
+    for (i=0; i<PJ_ARRAY_SIZE(frozen_hdrs); ++i) {
+        pj_str_t hname = pj_str((char*)frozen_hdrs[i][0]);
+        pj_str_t value;
+        pjsip_hdr *hdr;
+
+        pj_strdup2_with_null(pool, &value, frozen_hdrs[i][1]);
+        hdr = (pjsip_hdr*) pjsip_parse_hdr(pool, &hname, value.ptr,
+                                           value.slen, NULL);
+        if (!hdr)
+            return NULL;
+        if (freeze && pjsip_hdr_freeze(pool, hdr) != PJ_SUCCESS)
+            return NULL;
+        pjsip_msg_add_hdr(msg, hdr);
+    }
+    return msg;
+}
+
+static int frozen_test(void)
+{
+    char buf1[PJSIP_MAX_PKT_LEN], buf2[PJSIP_MAX_PKT_LEN];
+    char long_value[PJSIP_MAX_FROZEN_HDR_LEN + 1];
+    const pj_str_t hname = { "X-Long", 6 };
+    pj_pool_t *pool;
+    pjsip_msg *msg, *frozen, *clone;
+    pjsip_allow_hdr *allow, *shallow;
+    pjsip_generic_string_hdr *hlong;
+    pj_ssize_t len1, len2;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  frozen header test.."));
+
+    pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+
+    msg = create_frozen_msg(pool, PJ_FALSE);
+    frozen = create_frozen_msg(pool, PJ_TRUE);
+    PJ_TEST_NOT_NULL(msg, NULL, { rc = -900; goto on_return; });
+    PJ_TEST_NOT_NULL(frozen, NULL, { rc = -901; goto on_return; });
+
+    /* Frozen headers print the same */
+    len1 = pjsip_msg_print(msg, buf1, sizeof(buf1));
+    len2 = pjsip_msg_print(frozen, buf2, sizeof(buf2));
+    PJ_TEST_GT(len1, 0, NULL, { rc = -902; goto on_return; });
+    PJ_TEST_EQ(len1, len2, NULL, { rc = -903; goto on_return; });
+    PJ_TEST_EQ(pj_memcmp(buf1, buf2, len1), 0, NULL,
+               { rc = -904; goto on_return; });
+
+    /* Clones are frozen too and keep the header type */
+    clone = pjsip_msg_clone(pool, frozen);
+    allow = (pjsip_allow_hdr*) pjsip_msg_find_hdr(clone, PJSIP_H_ALLOW, NULL);
+    PJ_TEST_NOT_NULL(allow, NULL, { rc = -905; goto on_return; });
+    PJ_TEST_TRUE(pjsip_hdr_is_frozen(allow), NULL,
+                 { rc = -906; goto on_return; });
+    PJ_TEST_EQ(allow->count, 11, NULL, { rc = -907; goto on_return; });
+    len2 = pjsip_msg_print(clone, buf2, sizeof(buf2));
+    PJ_TEST_EQ(len1, len2, NULL, { rc = -908; goto on_return; });
+    PJ_TEST_EQ(pj_memcmp(buf1, buf2, len1), 0, NULL,
+               { rc = -909; goto on_return; });
+
+    /* Modify a shallow clone after unfreezing it */
+    shallow = (pjsip_allow_hdr*) pjsip_hdr_shallow_clone(pool, allow);
+    PJ_TEST_TRUE(pjsip_hdr_is_frozen(shallow), NULL,
+                 { rc = -910; goto on_return; });
+    pjsip_hdr_unfreeze(shallow);
+    PJ_TEST_EQ(pjsip_hdr_is_frozen(shallow), PJ_FALSE, NULL,
+               { rc = -911; goto on_return; });
+    shallow->count = 2;
+    len2 = pjsip_hdr_print_on(shallow, buf2, sizeof(buf2));
+    PJ_TEST_EQ(len2, 18, NULL, { rc = -912; goto on_return; });
+    PJ_TEST_EQ(pj_memcmp(buf2, "Allow: INVITE, ACK", 18), 0, NULL,
+               { rc = -913; goto on_return; });
+    PJ_TEST_TRUE(pjsip_hdr_is_frozen(allow), NULL,
+                 { rc = -914; goto on_return; });
+
+    /* Refreeze after modification */
+    PJ_TEST_SUCCESS(pjsip_hdr_freeze(pool, shallow), NULL,
+                    { rc = -915; goto on_return; });
+    PJ_TEST_EQ(pjsip_hdr_print_on(shallow, buf2, sizeof(buf2)), 18, NULL,
+               { rc = -916; goto on_return; });
+
+    /* Not enough buffer */
+    PJ_TEST_EQ(pjsip_hdr_print_on(shallow, buf2, 10), -1, NULL,
+               { rc = -917; goto on_return; });
+
+    /* Too long header is not frozen */
+    pj_memset(long_value, 'x', sizeof(long_value));
+    hlong = pjsip_generic_string_hdr_create(pool, &hname, NULL);
+    pj_strset(&hlong->hvalue, long_value, sizeof(long_value));
+    PJ_TEST_EQ(pjsip_hdr_freeze(pool, hlong), PJSIP_EMSGTOOLONG, NULL,
+               { rc = -918; goto on_return; });
+    PJ_TEST_EQ(pjsip_hdr_is_frozen(hlong), PJ_FALSE, NULL,
+               { rc = -919; goto on_return; });
+
+on_return:
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
+
+/*****************************************************************************/
+/* Zero-copy forwarding */
+static char fwd_req[] =
+    "INVITE sip:bob@example.com SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP edge.example.com;branch=z9hG4bK-2\r\n"
+    "Via: SIP/2.0/UDP 10.0.0.1:5060;rport;branch=z9hG4bK-1\r\n"
+    "Max-Forwards: 70\r\n"
+    "Route: <sip:proxy.example.com;lr>\r\n"
+    "Route: <sip:core.example.com;transport=tcp;lr>\r\n"
+    "Record-Route: <sip:edge.example.com;lr>\r\n"
+    "From: \"Alice\" <sip:alice@example.com>;tag=1\r\n"
+    "To: <sip:bob@example.com>\r\n"
+    "Call-ID: fwd@example.com\r\n"
+    "CSeq: 1 INVITE\r\n"
+    "Contact: <sip:alice@10.0.0.1:5060;transport=udp>;+sip.instance="
+        "\"<urn:uuid:00000000-0000-1000-8000-000A95A0E128>\"\r\n"
+    "P-Asserted-Identity: \"Alice\" <sip:alice@example.com>\r\n"
+    "User-Agent: pjsip-test\r\n"
+    "Allow: INVITE, ACK, BYE, CANCEL, OPTIONS, UPDATE, REFER\r\n"
+    "Supported: replaces, timer, 100rel\r\n"
+    "Session-Expires: 1800;refresher=uac\r\n"
+    "Content-Type: application/sdp\r\n"
+    "Content-Length: 4\r\n"
+    "\r\n"
+    "v=0\n";
+
+/* Parse the message as if it was received by a transport */
+static pjsip_rx_data *fwd_parse(pj_pool_t *pool, char *buf)
+{
+    pjsip_rx_data *rdata = PJ_POOL_ZALLOC_T(pool, pjsip_rx_data);
+
+    rdata->tp_info.pool = pool;
+    rdata->msg_info.msg_buf = buf;
+    rdata->msg_info.len = (int)pj_ansi_strlen(buf);
+    pj_list_init(&rdata->msg_info.parse_err);
+
+    if (!pjsip_parse_rdata(buf, rdata->msg_info.len, rdata))
+        return NULL;
+    return rdata;
+}
+
+/* Create and print the forwarded message */
+static int fwd_print(pjsip_rx_data *rdata, unsigned options,
+                     pjsip_tx_data **p_tdata)
+{
+    const pj_str_t branch = { "z9hG4bK-fwd", 11 };
+    pj_status_t status;
+
+    if (rdata->msg_info.msg->type == PJSIP_REQUEST_MSG) {
+        status = pjsip_endpt_create_request_fwd(endpt, rdata, NULL, &branch,
+                                                options, p_tdata);
+    } else {
+        status = pjsip_endpt_create_response_fwd(endpt, rdata, options,
+                                                 p_tdata);
+    }
+    if (status != PJ_SUCCESS)
+        return status;
+
+    status = pjsip_tx_data_encode(*p_tdata);
+    if (status != PJ_SUCCESS) {
+        pjsip_tx_data_dec_ref(*p_tdata);
+        return status;
+    }
+    return PJ_SUCCESS;
+}
+
+static int fwd_test(void)
+{
+    char res[] =
+        "SIP/2.0 180 Ringing\r\n"
+        "Via: SIP/2.0/UDP proxy.example.com;branch=z9hG4bK-fwd, "
+            "SIP/2.0/UDP 10.0.0.1:5060;rport=5060;branch=z9hG4bK-1\r\n"
+        "From: <sip:alice@example.com>;tag=1\r\n"
+        "t: <sip:bob@example.com>;tag=2\r\n"
+        "Call-ID: fwd@example.com\r\n"
+        "CSeq: 1 INVITE\r\n"
+        "X-Folded: first,\r\n second\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n";
+    char req[sizeof(fwd_req)];
+    pj_pool_t *pool;
+    pjsip_rx_data *rdata;
+    pjsip_tx_data *full = NULL, *raw = NULL;
+    pjsip_hdr *hdr;
+    pjsip_via_hdr *via;
+    pjsip_contact_hdr *contact;
+    unsigned lazy_cnt = 0;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  zero-copy forwarding test.."));
+
+    pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+
+    pj_memcpy(req, fwd_req, sizeof(fwd_req));
+    rdata = fwd_parse(pool, req);
+    PJ_TEST_NOT_NULL(rdata, NULL, { rc = -800; goto on_return; });
+
+    /* Forwarded request must be identical to the cloned one */
+    PJ_TEST_SUCCESS(fwd_print(rdata, 0, &full), NULL,
+                    { rc = -801; goto on_return; });
+    PJ_TEST_SUCCESS(fwd_print(rdata, PJSIP_FWD_ZERO_COPY, &raw), NULL,
+                    { rc = -802; goto on_return; });
+    PJ_TEST_EQ(raw->buf.cur - raw->buf.start, full->buf.cur - full->buf.start,
+               raw->buf.start, { rc = -803; goto on_return; });
+    PJ_TEST_EQ(pj_memcmp(raw->buf.start, full->buf.start,
+                         full->buf.cur - full->buf.start), 0,
+               raw->buf.start, { rc = -804; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(raw->buf.start, "\r\nMax-Forwards: 69"),
+                     raw->buf.start, { rc = -805; goto on_return; });
+
+    /* Headers which are not used by the proxy are kept raw */
+    for (hdr=raw->msg->hdr.next; hdr!=&raw->msg->hdr; hdr=hdr->next) {
+        if (pjsip_hdr_is_lazy(hdr))
+            ++lazy_cnt;
+    }
+    PJ_TEST_EQ(lazy_cnt, 10, NULL, { rc = -806; goto on_return; });
+
+    /* Modified headers are re-encoded, removed ones are gone */
+    hdr = (pjsip_hdr*) pjsip_msg_find_hdr(raw->msg, PJSIP_H_ROUTE, NULL);
+    PJ_TEST_NOT_NULL(hdr, NULL, { rc = -807; goto on_return; });
+    pj_list_erase(hdr);
+    contact = (pjsip_contact_hdr*)
+              pjsip_msg_find_hdr(raw->msg, PJSIP_H_CONTACT, NULL);
+    PJ_TEST_NOT_NULL(contact, NULL, { rc = -808; goto on_return; });
+    contact->expires = 30;
+    pjsip_tx_data_invalidate_msg(raw);
+    PJ_TEST_SUCCESS(pjsip_tx_data_encode(raw), NULL,
+                    { rc = -809; goto on_return; });
+    PJ_TEST_EQ(pj_ansi_strstr(raw->buf.start, "<sip:proxy."), NULL,
+               raw->buf.start, { rc = -810; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(raw->buf.start, "transport=udp>"
+                                                    ";expires=30;"),
+                     raw->buf.start, { rc = -811; goto on_return; });
+
+    pjsip_tx_data_dec_ref(full);
+    pjsip_tx_data_dec_ref(raw);
+    full = raw = NULL;
+
+    /* Response: only the first value of the top Via line is removed */
+    rdata = fwd_parse(pool, res);
+    PJ_TEST_NOT_NULL(rdata, NULL, { rc = -820; goto on_return; });
+    PJ_TEST_SUCCESS(fwd_print(rdata, PJSIP_FWD_ZERO_COPY, &raw), NULL,
+                    { rc = -821; goto on_return; });
+
+    PJ_TEST_EQ(pj_ansi_strstr(raw->buf.start, "proxy.example.com"), NULL,
+               raw->buf.start, { rc = -822; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(raw->buf.start,
+                                    "\r\nVia: SIP/2.0/UDP 10.0.0.1:5060;"
+                                    "rport=5060;branch=z9hG4bK-1\r\n"),
+                     raw->buf.start, { rc = -823; goto on_return; });
+    PJ_TEST_NOT_NULL(pj_ansi_strstr(raw->buf.start,
+                                    "\r\nX-Folded: first,\r\n second\r\n"),
+                     raw->buf.start, { rc = -824; goto on_return; });
+
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(raw->msg, PJSIP_H_VIA, NULL);
+    PJ_TEST_NOT_NULL(via, NULL, { rc = -825; goto on_return; });
+    PJ_TEST_EQ(via->rport_param, 5060, NULL, { rc = -826; goto on_return; });
+    PJ_TEST_EQ(pjsip_msg_find_hdr(raw->msg, PJSIP_H_VIA, via->next), NULL,
+               NULL, { rc = -827; goto on_return; });
+
+on_return:
+    if (full)
+        pjsip_tx_data_dec_ref(full);
+    if (raw)
+        pjsip_tx_data_dec_ref(raw);
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
+
+
+/*****************************************************************************/
+/* Contiguous message clone */
+static char clone_req[] =
+    "PUBLISH sips:bob:secret@example.com:5061;user=phone;method=INVITE;"
+        "ttl=3;maddr=10.0.0.2;lr;x=y SIP/2.0\r\n"
+    "Via: SIP/2.0/TLS 10.0.0.1:5061;received=10.0.0.9;ttl=2;maddr=10.0.0.3;"
+        "branch=z9hG4bK-3;x-param\r\n"
+    "From: \"Alice\" <tel:+1-212-555-0101>;tag=abc;x=1\r\n"
+    "To: sip:bob@example.com\r\n"
+    "Call-ID: clone@example.com\r\n"
+    "CSeq: 7 PUBLISH\r\n"
+    "Contact: *\r\n"
+    "Expires: 0\r\n"
+    "Retry-After: 120 (busy);duration=60\r\n"
+    "Authorization: Digest username=\"alice\", realm=\"example.com\", "
+        "nonce=\"1\", uri=\"sip:example.com\", response=\"2\"\r\n"
+    "X-Custom: some value\r\n"
+    "Content-Type: text/plain;charset=utf-8\r\n"
+    "Content-Length: 5\r\n"
+    "\r\n"
+    "hello";
+
+/* Clone the message the old way, header by header */
+static pjsip_msg *hdr_clone_msg(pj_pool_t *pool, const pjsip_msg *src)
+{
+    pjsip_msg *dst = pjsip_msg_create(pool, src->type);
+    const pjsip_hdr *sh;
+
+    if (src->type == PJSIP_REQUEST_MSG) {
+        pjsip_method_copy(pool, &dst->line.req.method, &src->line.req.method);
+        dst->line.req.uri = (pjsip_uri*) pjsip_uri_clone(pool,
+                                                         src->line.req.uri);
+    } else {
+        dst->line.status.code = src->line.status.code;
+        pj_strdup(pool, &dst->line.status.reason, &src->line.status.reason);
+    }
+
+    for (sh=src->hdr.next; sh!=&src->hdr; sh=sh->next)
+        pjsip_msg_add_hdr(dst, (pjsip_hdr*) pjsip_hdr_clone(pool, sh));
+
+    if (src->body)
+        dst->body = pjsip_msg_body_clone(pool, src->body);
+
+    return dst;
+}
+
+static int clone_test(void)
+{
+    char *const msgs[] = { fwd_req, clone_req };
+    pj_bool_t saved_lazy = pjsip_cfg()->endpt.lazy_hdr_parsing;
+    char req[sizeof(fwd_req) + sizeof(clone_req)];
+    char buf1[PJSIP_MAX_PKT_LEN], buf2[PJSIP_MAX_PKT_LEN];
+    pj_pool_t *pool = NULL, *clone_pool = NULL;
+    int mode, rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  contiguous clone test.."));
+
+    for (mode=0; mode<4; ++mode) {
+        pjsip_rx_data *rdata;
+        pjsip_msg *msg;
+        pj_ssize_t len1, len2;
+        pj_size_t used;
+
+        /* Clone with full and lazy header parsing */
+        pjsip_cfg()->endpt.lazy_hdr_parsing = (mode >= 2);
+
+        pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+        clone_pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE,
+                                             POOL_SIZE);
+
+        pj_ansi_strxcpy(req, msgs[mode % 2], sizeof(req));
+        rdata = fwd_parse(pool, req);
+        PJ_TEST_NOT_NULL(rdata, NULL, { rc = -850; goto on_return; });
+        len1 = pjsip_msg_print(rdata->msg_info.msg, buf1, sizeof(buf1));
+        PJ_TEST_GT(len1, 0, NULL, { rc = -851; goto on_return; });
+
+        used = pj_pool_get_used_size(clone_pool);
+        msg = pjsip_msg_clone(clone_pool, rdata->msg_info.msg);
+        PJ_TEST_NOT_NULL(msg, NULL, { rc = -852; goto on_return; });
+        used = pj_pool_get_used_size(clone_pool) - used;
+
+        /* The clone must not refer to the original message */
+        pj_memset(req, 'x', sizeof(req));
+        pjsip_endpt_release_pool(endpt, pool);
+        pool = NULL;
+
+        len2 = pjsip_msg_print(msg, buf2, sizeof(buf2));
+        PJ_TEST_EQ(len2, len1, buf2, { rc = -853; goto on_return; });
+        PJ_TEST_EQ(pj_memcmp(buf1, buf2, len1), 0, buf2,
+                   { rc = -854; goto on_return; });
+
+        /* Lazy headers of the clone can still be parsed */
+        if (mode >= 2) {
+            pjsip_msg_parse_lazy_hdrs(msg);
+            PJ_TEST_NOT_NULL(pjsip_msg_find_hdr(msg, PJSIP_H_CSEQ, NULL),
+                             NULL, { rc = -855; goto on_return; });
+        }
+
+        /* And it doesn't take more memory than the header by header clone */
+        pj_pool_reset(clone_pool);
+        pj_ansi_strxcpy(req, msgs[mode % 2], sizeof(req));
+        pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+        rdata = fwd_parse(pool, req);
+        PJ_TEST_NOT_NULL(rdata, NULL, { rc = -856; goto on_return; });
+        hdr_clone_msg(clone_pool, rdata->msg_info.msg);
+        PJ_TEST_LTE(used, pj_pool_get_used_size(clone_pool), NULL,
+                    { rc = -857; goto on_return; });
+
+        pjsip_endpt_release_pool(endpt, pool);
+        pjsip_endpt_release_pool(endpt, clone_pool);
+        pool = clone_pool = NULL;
+    }
+
+on_return:
+    pjsip_cfg()->endpt.lazy_hdr_parsing = saved_lazy;
+    if (pool)
+        pjsip_endpt_release_pool(endpt, pool);
+    if (clone_pool)
+        pjsip_endpt_release_pool(endpt, clone_pool);
+    return rc;
+}
+
+
 #if INCLUDE_BENCHMARKS
+/* Compare printing speed of normal and frozen headers */
+static int frozen_benchmark(unsigned *p_normal, unsigned *p_frozen)
+{
+    char buf[PJSIP_MAX_PKT_LEN];
+    pj_pool_t *pool;
+    unsigned *result[2];
+    int mode, loop;
+    pj_status_t status = PJ_SUCCESS;
+
+    pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+    result[0] = p_normal;
+    result[1] = p_frozen;
+
+    for (mode=0; mode<2; ++mode) {
+        pjsip_msg *msg;
+        pj_timestamp t1, t2;
+        pj_highprec_t usec, cnt;
+
+        msg = create_frozen_msg(pool, mode == 1);
+        if (!msg) {
+            status = -930;
+            break;
+        }
+
+        pj_get_timestamp(&t1);
+        for (loop=0; loop<LOOP; ++loop) {
+            if (pjsip_msg_print(msg, buf, sizeof(buf)) < 0) {
+                status = -931;
+                break;
+            }
+        }
+        pj_get_timestamp(&t2);
+        if (status != PJ_SUCCESS)
+            break;
+
+        usec = pj_elapsed_usec(&t1, &t2);
+        if (usec == 0) usec = 1;
+        cnt = LOOP;
+        pj_highprec_mul(cnt, 1000000);
+        pj_highprec_div(cnt, usec);
+        *result[mode] = (unsigned)cnt;
+
+        PJ_LOG(3,(THIS_FILE, "    %s headers: %u msg print/sec",
+                  (mode ? "frozen" : "normal"), *result[mode]));
+    }
+
+    pjsip_endpt_release_pool(endpt, pool);
+    return status;
+}
+
+/* Compare forwarding speed of cloned and zero-copy requests */
+static int fwd_benchmark(unsigned *p_clone, unsigned *p_raw)
+{
+    char req[sizeof(fwd_req)];
+    pj_pool_t *pool;
+    pjsip_rx_data *rdata;
+    unsigned *result[2];
+    int mode, loop;
+    pj_status_t status = PJ_SUCCESS;
+
+    pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+    pj_memcpy(req, fwd_req, sizeof(fwd_req));
+    rdata = fwd_parse(pool, req);
+    if (!rdata) {
+        pjsip_endpt_release_pool(endpt, pool);
+        return -830;
+    }
+
+    result[0] = p_clone;
+    result[1] = p_raw;
+
+    for (mode=0; mode<2; ++mode) {
+        pj_timestamp t1, t2;
+        pj_highprec_t usec, cnt;
+
+        pj_get_timestamp(&t1);
+        for (loop=0; loop<LOOP; ++loop) {
+            pjsip_tx_data *tdata;
+
+            status = fwd_print(rdata, mode ? PJSIP_FWD_ZERO_COPY : 0,
+                               &tdata);
+            if (status != PJ_SUCCESS)
+                break;
+            pjsip_tx_data_dec_ref(tdata);
+        }
+        pj_get_timestamp(&t2);
+        if (status != PJ_SUCCESS)
+            break;
+
+        usec = pj_elapsed_usec(&t1, &t2);
+        if (usec == 0) usec = 1;
+        cnt = LOOP;
+        pj_highprec_mul(cnt, 1000000);
+        pj_highprec_div(cnt, usec);
+        *result[mode] = (unsigned)cnt;
+
+        PJ_LOG(3,(THIS_FILE, "    %s forwarding: %u msg/sec",
+                  (mode ? "zero-copy" : "clone"), *result[mode]));
+    }
+
+    pjsip_endpt_release_pool(endpt, pool);
+    return status;
+}
+
+/* Compare cloning speed of header by header and contiguous clone */
+static int clone_benchmark(unsigned *p_hdr, unsigned *p_arena)
+{
+    char req[sizeof(fwd_req)];
+    pj_pool_t *pool, *clone_pool;
+    pjsip_rx_data *rdata;
+    unsigned *result[2];
+    int mode, loop;
+
+    pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+    clone_pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+    pj_memcpy(req, fwd_req, sizeof(fwd_req));
+    rdata = fwd_parse(pool, req);
+    if (!rdata) {
+        pjsip_endpt_release_pool(endpt, clone_pool);
+        pjsip_endpt_release_pool(endpt, pool);
+        return -860;
+    }
+
+    result[0] = p_hdr;
+    result[1] = p_arena;
+
+    for (mode=0; mode<2; ++mode) {
+        pj_timestamp t1, t2;
+        pj_highprec_t usec, cnt;
+
+        pj_get_timestamp(&t1);
+        for (loop=0; loop<LOOP; ++loop) {
+            if (mode == 0)
+                hdr_clone_msg(clone_pool, rdata->msg_info.msg);
+            else
+                pjsip_msg_clone(clone_pool, rdata->msg_info.msg);
+            pj_pool_reset(clone_pool);
+        }
+        pj_get_timestamp(&t2);
+
+        usec = pj_elapsed_usec(&t1, &t2);
+        if (usec == 0) usec = 1;
+        cnt = LOOP;
+        pj_highprec_mul(cnt, 1000000);
+        pj_highprec_div(cnt, usec);
+        *result[mode] = (unsigned)cnt;
+
+        PJ_LOG(3,(THIS_FILE, "    %s clone: %u msg/sec",
+                  (mode ? "contiguous" : "header by header"), *result[mode]));
+    }
+
+    pjsip_endpt_release_pool(endpt, clone_pool);
+    pjsip_endpt_release_pool(endpt, pool);
+    return PJ_SUCCESS;
+}
+
+/* Compare parsing speed with and without lazy header parsing */
+static int lazy_benchmark(unsigned *p_eager, unsigned *p_lazy)
+{
+    pj_bool_t saved_lazy = pjsip_cfg()->endpt.lazy_hdr_parsing;
+    pj_timestamp zero;
+    unsigned *result[2];
+    int mode, i, loop;
+    pj_status_t status = PJ_SUCCESS;
+
+    result[0] = p_eager;
+    result[1] = p_lazy;
+    zero.u64 = 0;
+
+    for (mode=0; mode<2; ++mode) {
+        pj_highprec_t usec, cnt;
+
+        pjsip_cfg()->endpt.lazy_hdr_parsing = (mode == 1);
+        pj_bzero(&var, sizeof(var));
+        var.flag = FLAG_PARSE_ONLY;
+
+        for (loop=0; loop<LOOP && status==PJ_SUCCESS; ++loop) {
+            for (i=0; i<(int)PJ_ARRAY_SIZE(test_array); ++i) {
+                pj_pool_t *pool;
+
+                pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE,
+                                               POOL_SIZE);
+                status = test_entry(pool, &test_array[i]);
+                pjsip_endpt_release_pool(endpt, pool);
+                if (status != PJ_SUCCESS)
+                    break;
+            }
+        }
+        if (status != PJ_SUCCESS)
+            break;
+
+        usec = pj_elapsed_usec(&zero, &var.parse_time);
+        cnt = LOOP * PJ_ARRAY_SIZE(test_array);
+        pj_highprec_mul(cnt, 1000000);
+        pj_highprec_div(cnt, usec);
+        *result[mode] = (unsigned)cnt;
+
+        PJ_LOG(3,(THIS_FILE, "    %s parsing: %u msg/sec",
+                  (mode ? "lazy" : "full"), *result[mode]));
+    }
+
+    var.flag = 0;
+    pjsip_cfg()->endpt.lazy_hdr_parsing = saved_lazy;
+    return status;
+}
+
 static int msg_benchmark(unsigned *p_detect, unsigned *p_parse, 
                          unsigned *p_print)
 {
@@ -2012,6 +2775,22 @@ int msg_test(void)
     if (status != PJ_SUCCESS)
         return status;
 
+    status = lazy_test();
+    if (status != 0)
+        return status;
+
+    status = frozen_test();
+    if (status != 0)
+        return status;
+
+    status = fwd_test();
+    if (status != 0)
+        return status;
+
+    status = clone_test();
+    if (status != 0)
+        return status;
+
 #if INCLUDE_BENCHMARKS
     for (i=0; i<COUNT; ++i) {
         PJ_LOG(3,(THIS_FILE, "  benchmarking (%d of %d)..", i+1, COUNT));
@@ -2083,6 +2862,68 @@ int msg_test(void)
                 "SIP messages printed per second). "
                 "The value is derived from msg-print-per-sec above.");
 
+    /* Lazy header parsing */
+    {
+        unsigned eager, lazy;
+
+        status = lazy_benchmark(&eager, &lazy);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        pj_ansi_snprintf(desc, sizeof(desc),
+                         "Number of SIP messages can be parsed per second "
+                         "with lazy header parsing enabled (%u msg/sec "
+                         "with full parsing)", eager);
+        report_ival("msg-lazy-parse-per-sec", lazy, "msg/sec", desc);
+    }
+
+    /* Frozen headers */
+    {
+        unsigned normal, frozen;
+
+        status = frozen_benchmark(&normal, &frozen);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        pj_ansi_snprintf(desc, sizeof(desc),
+                         "Number of messages with Allow, Supported, Contact "
+                         "and Route headers can be printed per second when "
+                         "the headers are frozen with pjsip_hdr_freeze() "
+                         "(%u msg/sec when they are not)", normal);
+        report_ival("msg-print-frozen-per-sec", frozen, "msg/sec", desc);
+    }
+
+    /* Zero-copy forwarding */
+    {
+        unsigned clone, raw;
+
+        status = fwd_benchmark(&clone, &raw);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        pj_ansi_snprintf(desc, sizeof(desc),
+                         "Number of SIP requests can be forwarded (created "
+                         "and printed) per second with PJSIP_FWD_ZERO_COPY "
+                         "(%u msg/sec when the request is cloned)", clone);
+        report_ival("msg-fwd-zero-copy-per-sec", raw, "msg/sec", desc);
+    }
+
+    /* Contiguous clone */
+    {
+        unsigned hdr, arena;
+
+        status = clone_benchmark(&hdr, &arena);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        pj_ansi_snprintf(desc, sizeof(desc),
+                         "Number of SIP requests can be cloned per second "
+                         "by <tt>pjsip_msg_clone()</tt> into a single "
+                         "allocation (%u msg/sec when cloned header by "
+                         "header)", hdr);
+        report_ival("msg-clone-per-sec", arena, "msg/sec", desc);
+    }
+
 #endif  /* INCLUDE_BENCHMARKS */
 
     return PJ_SUCCESS;
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+#include <pjsip-simple/presence.h>
+#include <pjsip.h>
+#include <pjlib.h>
+
+#define THIS_FILE       "pidf_test.c"
+
+/*
+ * Check that pjsip_pres_parse_pidf_basic() gives the same result as
+ * the XML tree based pjsip_pres_parse_pidf2().
+ */
+static struct test_t
+{
+    const char *title;
+    const char *body;
+    unsigned    info_cnt;
+    const char *note;
+} p_tests[] =
+{
+    {
+        "tuples with person and activities",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<presence xmlns=\"urn:ietf:params:xml:ns:pidf\"\n"
+        "          xmlns:dm=\"urn:ietf:params:xml:ns:pidf:data-model\"\n"
+        "          xmlns:rpid=\"urn:ietf:params:xml:ns:pidf:rpid\"\n"
+        "          entity=\"sip:alice@example.com\">\n"
+        " <tuple id=\"t1\">\n"
+        "  <status><basic>open</basic></status>\n"
+        "  <contact priority=\"0.8\">sip:alice@pc.example.com</contact>\n"
+        "  <note>tuple note</note>\n"
+        " </tuple>\n"
+        " <tuple id=\"t2\">\n"
+        "  <status><basic>closed</basic></status>\n"
+        "  <contact>sip:alice@phone.example.com</contact>\n"
+        "  <note>second tuple note</note>\n"
+        " </tuple>\n"
+        " <note>root note</note>\n"
+        " <dm:person id=\"p1\">\n"
+        "  <rpid:activities>\n"
+        "   <rpid:note>activities note</rpid:note>\n"
+        "   <rpid:away/>\n"
+        "  </rpid:activities>\n"
+        "  <dm:note>person note</dm:note>\n"
+        " </dm:person>\n"
+        "</presence>",
+        2, "activities note"
+    },
+    {
+        "person note without activities note",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<presence entity=\"sip:bob@example.com\">\n"
+        " <tuple id=\"b1\">\n"
+        "  <status><basic>closed</basic></status>\n"
+        "  <contact>sip:bob@example.com</contact>\n"
+        "  <note>tuple note</note>\n"
+        " </tuple>\n"
+        " <person id=\"p2\">\n"
+        "  <activities><busy/></activities>\n"
+        "  <note>person note</note>\n"
+        " </person>\n"
+        "</presence>",
+        1, "person note"
+    },
+    {
+        "tuple note without person",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<presence entity=\"sip:carol@example.com\">\n"
+        " <tuple id=\"c1\">\n"
+        "  <status><basic>open</basic></status>\n"
+        "  <contact>sip:carol@example.com</contact>\n"
+        "  <note>tuple note</note>\n"
+        " </tuple>\n"
+        " <note>root note</note>\n"
+        "</presence>",
+        1, "tuple note"
+    },
+    {
+        "root note only",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<presence entity=\"sip:dave@example.com\">\n"
+        " <tuple id=\"d1\">\n"
+        "  <status><basic>open</basic></status>\n"
+        " </tuple>\n"
+        " <tuple id=\"d2\">\n"
+        "  <status><basic>open</basic></status>\n"
+        "  <note>second tuple note</note>\n"
+        " </tuple>\n"
+        " <note>root note</note>\n"
+        "</presence>",
+        2, "root note"
+    },
+    {
+        "more tuples than PJSIP_PRES_STATUS_MAX_INFO",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<presence entity=\"sip:eve@example.com\">\n"
+        " <tuple id=\"e1\"><status><basic>open</basic></status>"
+        "<contact>sip:e1@example.com</contact></tuple>\n"
+        " <tuple id=\"e2\"><status><basic>closed</basic></status>"
+        "<contact>sip:e2@example.com</contact></tuple>\n"
+        " <tuple id=\"e3\"><status><basic>open</basic></status>"
+        "<contact>sip:e3@example.com</contact></tuple>\n"
+        " <tuple id=\"e4\"><status><basic>closed</basic></status>"
+        "<contact>sip:e4@example.com</contact></tuple>\n"
+        " <tuple id=\"e5\"><status><basic>open</basic></status>"
+        "<contact>sip:e5@example.com</contact></tuple>\n"
+        " <tuple id=\"e6\"><status><basic>closed</basic></status>"
+        "<contact>sip:e6@example.com</contact></tuple>\n"
+        " <tuple id=\"e7\"><status><basic>open</basic></status>"
+        "<contact>sip:e7@example.com</contact></tuple>\n"
+        " <tuple id=\"e8\"><status><basic>closed</basic></status>"
+        "<contact>sip:e8@example.com</contact></tuple>\n"
+        " <tuple id=\"e9\"><status><basic>open</basic></status>"
+        "<contact>sip:e9@example.com</contact><note>e9</note></tuple>\n"
+        " <tuple id=\"e10\"><status><basic>open</basic></status>"
+        "<contact>sip:e10@example.com</contact></tuple>\n"
+        " <person><note>person note</note></person>\n"
+        "</presence>",
+        PJSIP_PRES_STATUS_MAX_INFO, "person note"
+    },
+};
+
+static int verify(pj_pool_t *pool, const struct test_t *t)
+{
+    pjsip_pres_status st1, st2;
+    char *body1, *body2;
+    unsigned len, i;
+
+    PJ_LOG(3,(THIS_FILE, "  %s", t->title));
+
+    /* Both parsers get their own copy of the body */
+    len = (unsigned)pj_ansi_strlen(t->body);
+    body1 = (char*)pj_pool_alloc(pool, len+1);
+    pj_memcpy(body1, t->body, len+1);
+    body2 = (char*)pj_pool_alloc(pool, len+1);
+    pj_memcpy(body2, t->body, len+1);
+
+    pj_bzero(&st1, sizeof(st1));
+    pj_bzero(&st2, sizeof(st2));
+
+    PJ_TEST_SUCCESS(pjsip_pres_parse_pidf2(body1, len, pool, &st1),
+                    NULL, return -10);
+    PJ_TEST_SUCCESS(pjsip_pres_parse_pidf_basic(body2, len, pool, &st2),
+                    NULL, return -20);
+
+    PJ_TEST_EQ(st1.info_cnt, t->info_cnt, NULL, return -30);
+    PJ_TEST_EQ(st2.info_cnt, st1.info_cnt, NULL, return -31);
+
+    for (i=0; i<st1.info_cnt; ++i) {
+        PJ_TEST_EQ(pj_strcmp(&st2.info[i].id, &st1.info[i].id), 0,
+                   NULL, return -40);
+        PJ_TEST_EQ(pj_strcmp(&st2.info[i].contact, &st1.info[i].contact), 0,
+                   NULL, return -41);
+        PJ_TEST_EQ(st2.info[i].basic_open, st1.info[i].basic_open,
+                   NULL, return -42);
+    }
+
+    PJ_TEST_EQ(pj_strcmp2(&st1.info[0].rpid.note, t->note), 0,
+               t->title, return -50);
+    PJ_TEST_EQ(pj_strcmp(&st2.info[0].rpid.note, &st1.info[0].rpid.note), 0,
+               t->title, return -51);
+
+    return 0;
+}
+
+int pidf_test(void)
+{
+    pj_pool_t *pool;
+    unsigned i;
+    int rc = 0;
+
+    pool = pjsip_endpt_create_pool(endpt, NULL, 4000, 4000);
+
+    for (i=0; i<PJ_ARRAY_SIZE(p_tests); ++i) {
+        rc = verify(pool, &p_tests[i]);
+        if (rc != 0) {
+            rc = rc - i*100;
+            break;
+        }
+    }
+
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}
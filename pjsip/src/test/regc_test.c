@@ -153,6 +153,7 @@ static pj_bool_t regs_rx_request(pjsip_rx_data *rdata)
         {
             pjsip_hdr *hsrc;
 
+            pjsip_msg_parse_lazy_hdrs(msg);
             for (hsrc=msg->hdr.next; hsrc!=&msg->hdr; hsrc=hsrc->next) {
                 pjsip_contact_hdr *hdst;
 
@@ -753,6 +754,160 @@ static int auth_send_error(const pj_str_t *registrar_uri,
 
 
 
+/* Registrations sent through a registration scheduler */
+static struct sched_result
+{
+    unsigned        cnt;
+    pjsip_regc     *regc[4];
+    int             code[4];
+    pj_time_val     time[4];
+} sched_result;
+
+static void sched_client_cb(struct pjsip_regc_cbparam *param)
+{
+    unsigned i = sched_result.cnt;
+
+    if (i < PJ_ARRAY_SIZE(sched_result.regc)) {
+        sched_result.regc[i] = param->regc;
+        sched_result.code[i] = param->code;
+        pj_gettickcount(&sched_result.time[i]);
+        sched_result.cnt++;
+    }
+}
+
+static int sched_test(const pj_str_t *registrar_uri)
+{
+    enum { RATE = 2, CNT = 3, TIMEOUT = 10 };
+    struct registrar_cfg server_cfg = 
+        /* respond      code    auth      contact  exp_prm expires more_contacts */
+        { PJ_TRUE,      500,    PJ_FALSE, NONE,    0,      0,      {NULL, 0}};
+    const pj_str_t aor = pj_str("<sip:regc-test@pjsip.org>");
+    pj_str_t contact = pj_str("<sip:c@C>");
+    pjsip_regc_sched_param param;
+    pjsip_regc_sched *sched = NULL;
+    pjsip_regc_sched_info info;
+    pjsip_regc *regc[CNT];
+    pj_time_val elapsed;
+    unsigned i;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  registration scheduler (takes ~2 secs)"));
+
+    pj_bzero(regc, sizeof(regc));
+    pj_bzero(&sched_result, sizeof(sched_result));
+    pj_memcpy(&registrar.cfg, &server_cfg, sizeof(server_cfg));
+
+    pjsip_regc_sched_param_default(&param);
+    param.max_rate = RATE;
+    param.init_jitter = 0;
+    status = pjsip_regc_sched_create(endpt, &param, &sched);
+    if (status != PJ_SUCCESS)
+        return -700;
+
+    for (i=0; i<CNT; ++i) {
+        status = pjsip_regc_create(endpt, NULL, &sched_client_cb, &regc[i]);
+        if (status != PJ_SUCCESS) {
+            rc = -710;
+            goto on_return;
+        }
+        status = pjsip_regc_init(regc[i], registrar_uri, &aor, &aor, 1,
+                                 &contact, 60);
+        if (status != PJ_SUCCESS) {
+            rc = -720;
+            goto on_return;
+        }
+        pjsip_regc_set_sched(regc[i], sched);
+    }
+
+    /* Unattached client can't be queued */
+    pjsip_regc_set_sched(regc[0], NULL);
+    if (pjsip_regc_sched_register(regc[0], PJ_FALSE) != PJ_EINVALIDOP) {
+        rc = -730;
+        goto on_return;
+    }
+    pjsip_regc_set_sched(regc[0], sched);
+
+    /* The first client fails to register */
+    pjsip_regc_sched_register(regc[0], PJ_FALSE);
+    for (i=0; i<TIMEOUT*10 && sched_result.cnt==0; ++i)
+        flush_events(100);
+
+    if (sched_result.cnt != 1 || sched_result.code[0] != 500) {
+        PJ_LOG(3,(THIS_FILE, "    error: expecting one 500 response"));
+        rc = -740;
+        goto on_return;
+    }
+
+    /* Queue the other clients, then the retry of the first client, which
+     * must be sent first.
+     */
+    registrar.cfg.status_code = 200;
+    sched_result.cnt = 0;
+    for (i=1; i<CNT; ++i)
+        pjsip_regc_sched_register(regc[i], PJ_FALSE);
+    pjsip_regc_sched_register(regc[0], PJ_FALSE);
+
+    pjsip_regc_sched_get_info(sched, &info);
+    if (info.queue_cnt != CNT || info.retry_cnt != 1) {
+        PJ_LOG(3,(THIS_FILE, "    error: invalid queue_cnt=%d retry_cnt=%d",
+                  info.queue_cnt, info.retry_cnt));
+        rc = -750;
+        goto on_return;
+    }
+
+    for (i=0; i<TIMEOUT*10 && sched_result.cnt<CNT; ++i)
+        flush_events(100);
+
+    if (sched_result.cnt != CNT) {
+        PJ_LOG(3,(THIS_FILE, "    error: test has timed out"));
+        rc = -760;
+        goto on_return;
+    }
+    if (sched_result.regc[0] != regc[0]) {
+        PJ_LOG(3,(THIS_FILE, "    error: retry was not sent first"));
+        rc = -770;
+        goto on_return;
+    }
+    for (i=0; i<CNT; ++i) {
+        if (sched_result.code[i] != 200) {
+            PJ_LOG(3,(THIS_FILE, "    error: expecting code=200, got %d",
+                      sched_result.code[i]));
+            rc = -780;
+            goto on_return;
+        }
+    }
+
+    /* The requests are paced by the rate limit */
+    elapsed = sched_result.time[CNT-1];
+    PJ_TIME_VAL_SUB(elapsed, sched_result.time[0]);
+    if (PJ_TIME_VAL_MSEC(elapsed) < (CNT-1) * 1000 / RATE - 100) {
+        PJ_LOG(3,(THIS_FILE, "    error: requests are not paced, "
+                  "elapsed=%ld ms", (long)PJ_TIME_VAL_MSEC(elapsed)));
+        rc = -790;
+        goto on_return;
+    }
+
+    pjsip_regc_sched_get_info(sched, &info);
+    if (info.queue_cnt != 0 || info.retry_cnt != 0 ||
+        info.sent_cnt != CNT + 1)
+    {
+        PJ_LOG(3,(THIS_FILE, "    error: invalid queue_cnt=%d retry_cnt=%d "
+                  "sent_cnt=%d", info.queue_cnt, info.retry_cnt,
+                  info.sent_cnt));
+        rc = -800;
+        goto on_return;
+    }
+
+on_return:
+    for (i=0; i<CNT; ++i) {
+        if (regc[i])
+            pjsip_regc_destroy(regc[i]);
+    }
+    pjsip_regc_sched_destroy(sched);
+    return rc;
+}
+
 
 /************************************************************************/
 enum
@@ -1168,6 +1323,11 @@ int regc_test(void)
     if (rc != 0)
         goto on_return;
 
+    /* Registration scheduler */
+    rc = sched_test(&registrar_uri);
+    if (rc != 0)
+        goto on_return;
+
 on_return:
     if (registrar.mod.id != -1) {
         pjsip_endpt_unregister_module(endpt, &registrar.mod);
@@ -310,12 +310,21 @@ int test_main(int argc, char *argv[])
     UT_ADD_TEST(&test_app.ut_app, txdata_test, 0);
 #endif
 
+#if INCLUDE_AUTH_TEST
+    UT_ADD_TEST(&test_app.ut_app, auth_test, 0);
+#endif
+
+#if INCLUDE_PIDF_TEST
+    UT_ADD_TEST(&test_app.ut_app, pidf_test, 0);
+#endif
+
 #if INCLUDE_TSX_BENCH
     UT_ADD_TEST(&test_app.ut_app, tsx_bench, 0);
 #endif
 
 #if INCLUDE_LOOP_TEST
     UT_ADD_TEST(&test_app.ut_app, transport_loop_multi_test, 0);
+    UT_ADD_TEST(&test_app.ut_app, transport_loop_dispatch_test, 0);
 #endif
 
 #if INCLUDE_RESOLVE_TEST
@@ -367,6 +376,20 @@ int test_main(int argc, char *argv[])
 
     /* Note: put exclusive tests last */
 
+    /*
+     * dlg_core_test() and dlg_core_bench() need exclusive because they
+     * register the UA layer if no other test has done so, and unregister
+     * it afterwards
+     */
+#if INCLUDE_DLG_CORE_TEST
+    UT_ADD_TEST(&test_app.ut_app, dlg_core_test,
+                PJ_TEST_EXCLUSIVE | PJ_TEST_KEEP_LAST);
+#endif
+#if INCLUDE_DLG_CORE_BENCH
+    UT_ADD_TEST(&test_app.ut_app, dlg_core_bench,
+                PJ_TEST_EXCLUSIVE | PJ_TEST_KEEP_LAST);
+#endif
+
     /*
      * regc_test() needs exclusive because it modifies pjsip_cfg()
      */
@@ -64,6 +64,8 @@ extern pj_caching_pool caching_pool;
 #define INCLUDE_MSG_TEST        INCLUDE_MESSAGING_GROUP
 #define INCLUDE_MULTIPART_TEST  INCLUDE_MESSAGING_GROUP
 #define INCLUDE_TXDATA_TEST     INCLUDE_MESSAGING_GROUP
+#define INCLUDE_AUTH_TEST       INCLUDE_MESSAGING_GROUP
+#define INCLUDE_PIDF_TEST       INCLUDE_MESSAGING_GROUP
 #define INCLUDE_TSX_BENCH       (INCLUDE_MESSAGING_GROUP && WITH_BENCHMARK)
 #define INCLUDE_UDP_TEST        INCLUDE_TRANSPORT_GROUP
 #define INCLUDE_LOOP_TEST       INCLUDE_TRANSPORT_GROUP
@@ -71,6 +73,8 @@ extern pj_caching_pool caching_pool;
 #define INCLUDE_RESOLVE_TEST    INCLUDE_TRANSPORT_GROUP
 #define INCLUDE_TSX_TEST        INCLUDE_TSX_GROUP
 #define INCLUDE_TSX_DESTROY_TEST INCLUDE_TSX_GROUP
+#define INCLUDE_DLG_CORE_TEST   INCLUDE_TSX_GROUP
+#define INCLUDE_DLG_CORE_BENCH  (INCLUDE_TSX_GROUP && WITH_BENCHMARK)
 #define INCLUDE_INV_OA_TEST     INCLUDE_INV_GROUP
 #define INCLUDE_REGC_TEST       INCLUDE_REGC_GROUP
 
@@ -81,12 +85,17 @@ int msg_test(void);
 int msg_err_test(void);
 int multipart_test(void);
 int txdata_test(void);
+int auth_test(void);
+int pidf_test(void);
 int tsx_bench(void);
 int tsx_destroy_test(void);
+int dlg_core_test(void);
+int dlg_core_bench(void);
 int transport_udp_test(void);
 int transport_loop_test(void);
 int transport_loop_multi_test(void);
 int transport_loop_resolve_error_test(void);
+int transport_loop_dispatch_test(void);
 int transport_tcp_test(void);
 int resolve_test(void);
 int regc_test(void);
@@ -407,3 +407,164 @@ int transport_loop_resolve_error_test()
     pjsip_transport_dec_ref(loop);
     return status;
 }
+
+
+/*
+ * Call-ID affinity dispatch: messages of the same call must be processed
+ * in order, by the same worker thread.
+ */
+#define DISPATCH_CALLS      16
+#define DISPATCH_MSGS       20
+#define DISPATCH_CID        "dispatch-test-"
+
+static struct
+{
+    pj_mutex_t      *mutex;
+    unsigned         rx_cnt;
+    int              status;
+    struct {
+        pj_thread_t *thread;
+        unsigned     last_cseq;
+    } call[DISPATCH_CALLS];
+} dt;
+
+static pj_bool_t dispatch_on_rx_request(pjsip_rx_data *rdata)
+{
+    const pj_str_t *cid = &rdata->msg_info.cid->id;
+    const pj_str_t prefix = { DISPATCH_CID, sizeof(DISPATCH_CID)-1 };
+    pj_str_t idx_str;
+    unsigned idx;
+
+    if (cid->slen <= prefix.slen || pj_strncmp(cid, &prefix, prefix.slen))
+        return PJ_FALSE;
+
+    idx_str.ptr = cid->ptr + prefix.slen;
+    idx_str.slen = cid->slen - prefix.slen;
+    idx = pj_strtoul(&idx_str);
+
+    pj_mutex_lock(dt.mutex);
+    PJ_TEST_LT(idx, DISPATCH_CALLS, NULL, {dt.status=-300; goto on_return;});
+    if (dt.call[idx].thread == NULL)
+        dt.call[idx].thread = pj_thread_this();
+    PJ_TEST_EQ(dt.call[idx].thread, pj_thread_this(), "thread changed",
+               dt.status=-310);
+    PJ_TEST_EQ(rdata->msg_info.cseq->cseq, (int)dt.call[idx].last_cseq+1,
+               "out of order", dt.status=-320);
+    dt.call[idx].last_cseq = rdata->msg_info.cseq->cseq;
+    ++dt.rx_cnt;
+
+on_return:
+    pj_mutex_unlock(dt.mutex);
+    return PJ_TRUE;
+}
+
+static pjsip_module dispatch_tester_mod =
+{
+    NULL, NULL,                         /* prev and next        */
+    { "dispatch_test", 13},             /* Name.                */
+    -1,                                 /* Id                   */
+    PJSIP_MOD_PRIORITY_APPLICATION,     /* Priority             */
+    NULL,                               /* load()               */
+    NULL,                               /* start()              */
+    NULL,                               /* stop()               */
+    NULL,                               /* unload()             */
+    &dispatch_on_rx_request,            /* on_rx_request()      */
+    NULL,                               /* on_rx_response()     */
+    NULL,                               /* on_tx_request()      */
+    NULL,                               /* on_tx_response()     */
+    NULL,                               /* on_tsx_state()       */
+};
+
+int transport_loop_dispatch_test(void)
+{
+#define ERR(rc__)   { rc=rc__; goto on_return; }
+    enum { WORKER_CNT = 4, TIMEOUT = 5000 };
+    pjsip_endpoint *endpt2 = NULL;
+    pjsip_transport *loop = NULL;
+    unsigned old_worker_cnt = pjsip_cfg()->endpt.rx_worker_cnt;
+    pj_pool_t *pool;
+    pj_str_t target = pj_str("sip:bob@127.0.0.1;transport=loop-dgram");
+    pj_str_t from = pj_str("<sip:dispatch_test@127.0.0.1>");
+    pj_time_val timeout, now;
+    unsigned i, j, thread_cnt;
+    int rc = 0;
+
+    pool = pjsip_endpt_create_pool(endpt, "dispatchtest", 1000, 1000);
+    pj_bzero(&dt, sizeof(dt));
+    PJ_TEST_SUCCESS(pj_mutex_create_simple(pool, "dispatchtest", &dt.mutex),
+                    NULL, ERR(-10));
+
+    /* Separate endpoint with dispatch workers */
+    pjsip_cfg()->endpt.rx_worker_cnt = WORKER_CNT;
+    rc = pjsip_endpt_create(&caching_pool.factory, "dispatch", &endpt2);
+    pjsip_cfg()->endpt.rx_worker_cnt = old_worker_cnt;
+    PJ_TEST_SUCCESS(rc, NULL, ERR(-20));
+
+    PJ_TEST_SUCCESS(pjsip_endpt_register_module(endpt2, &dispatch_tester_mod),
+                    NULL, ERR(-30));
+    PJ_TEST_SUCCESS(pjsip_loop_start(endpt2, &loop), NULL, ERR(-40));
+    pjsip_transport_add_ref(loop);
+
+    /* Interleave the requests of the calls */
+    for (j=0; j<DISPATCH_MSGS; ++j) {
+        for (i=0; i<DISPATCH_CALLS; ++i) {
+            char cid_buf[32];
+            pj_str_t cid;
+            pjsip_tx_data *tdata;
+
+            cid.ptr = cid_buf;
+            cid.slen = pj_ansi_snprintf(cid_buf, sizeof(cid_buf),
+                                        DISPATCH_CID "%d", i);
+            PJ_TEST_SUCCESS(pjsip_endpt_create_request(endpt2,
+                                                &pjsip_options_method,
+                                                &target, &from, &target,
+                                                NULL, &cid, j+1, NULL,
+                                                &tdata),
+                            NULL, ERR(-50));
+            PJ_TEST_SUCCESS(pjsip_endpt_send_request_stateless(endpt2, tdata,
+                                                               NULL, NULL),
+                            NULL, ERR(-60));
+        }
+    }
+
+    /* Wait until all requests are processed */
+    pj_gettickcount(&timeout);
+    timeout.msec += TIMEOUT;
+    pj_time_val_normalize(&timeout);
+    do {
+        pj_thread_sleep(10);
+        pj_gettickcount(&now);
+    } while (dt.rx_cnt < DISPATCH_CALLS * DISPATCH_MSGS && dt.status == 0 &&
+             PJ_TIME_VAL_LT(now, timeout));
+
+    PJ_TEST_EQ(dt.status, 0, NULL, ERR(dt.status));
+    PJ_TEST_EQ(dt.rx_cnt, DISPATCH_CALLS * DISPATCH_MSGS, NULL, ERR(-70));
+
+    /* The calls must have been spread to more than one worker */
+    for (i=0, thread_cnt=0; i<DISPATCH_CALLS; ++i) {
+        for (j=0; j<i; ++j) {
+            if (dt.call[j].thread == dt.call[i].thread)
+                break;
+        }
+        if (j == i)
+            ++thread_cnt;
+        PJ_TEST_NEQ(dt.call[i].thread, pj_thread_this(), NULL, ERR(-80));
+    }
+    PJ_TEST_GT(thread_cnt, 1, NULL, ERR(-90));
+
+on_return:
+    if (loop) {
+        pjsip_transport_shutdown(loop);
+        pjsip_transport_dec_ref(loop);
+    }
+    if (endpt2) {
+        if (dispatch_tester_mod.id != -1)
+            pjsip_endpt_unregister_module(endpt2, &dispatch_tester_mod);
+        pjsip_endpt_destroy(endpt2);
+    }
+    if (dt.mutex)
+        pj_mutex_destroy(dt.mutex);
+    pj_pool_release(pool);
+    return rc;
+#undef ERR
+}
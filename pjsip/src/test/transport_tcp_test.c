@@ -147,6 +147,242 @@ static pj_status_t multi_listener_test(pjsip_tpfactory *factory[],
     return PJ_SUCCESS;
 }
 
+/*
+ * Messages larger than the receive packet buffer must be received in the
+ * connection's overflow buffer, and smaller ones after it in the packet
+ * buffer again.
+ */
+#define LARGE_MSG_CALL_ID   "Transport-Large-Msg-Test"
+
+static struct large_msg_test_t
+{
+    int         rx_cnt;
+    pj_ssize_t  rx_body_len[2];
+} lm_g;
+
+static pj_bool_t large_msg_on_rx_request(pjsip_rx_data *rdata)
+{
+    pjsip_msg_body *body = rdata->msg_info.msg->body;
+
+    if (pj_strcmp2(&rdata->msg_info.cid->id, LARGE_MSG_CALL_ID) != 0)
+        return PJ_FALSE;
+
+    if (lm_g.rx_cnt < (int)PJ_ARRAY_SIZE(lm_g.rx_body_len))
+        lm_g.rx_body_len[lm_g.rx_cnt] = body ? (pj_ssize_t)body->len : -1;
+    ++lm_g.rx_cnt;
+    return PJ_TRUE;
+}
+
+static pjsip_module large_msg_module =
+{
+    NULL, NULL,                         /* prev and next        */
+    { "Large-Msg-Test", 14},            /* Name.                */
+    -1,                                 /* Id                   */
+    PJSIP_MOD_PRIORITY_TSX_LAYER-1,     /* Priority             */
+    NULL,                               /* load()               */
+    NULL,                               /* start()              */
+    NULL,                               /* stop()               */
+    NULL,                               /* unload()             */
+    &large_msg_on_rx_request,           /* on_rx_request()      */
+    NULL,                               /* on_rx_response()     */
+    NULL,                               /* on_tx_request()      */
+    NULL,                               /* on_tx_response()     */
+    NULL,                               /* on_tsx_state()       */
+};
+
+static int large_msg_test(const char *host_port_param)
+{
+    enum { LARGE_BODY = 6 * PJSIP_MAX_PKT_LEN + 123, SMALL_BODY = 100 };
+    const pj_ssize_t body_len[2] = { LARGE_BODY, SMALL_BODY };
+    pj_bool_t msg_log_enabled;
+    char target_url[PJSIP_MAX_URL_SIZE + 16];
+    pj_str_t target, from, call_id, body;
+    pjsip_method method;
+    pj_pool_t *pool;
+    pj_time_val timeout;
+    unsigned i;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  large message test..."));
+
+    if (pjsip_cfg()->tcp.max_msg_len < LARGE_BODY + PJSIP_MAX_PKT_LEN) {
+        PJ_LOG(3,(THIS_FILE, "   skipped, PJSIP_TCP_MAX_MSG_LEN is too small"));
+        return 0;
+    }
+
+    status = pjsip_endpt_register_module(endpt, &large_msg_module);
+    if (status != PJ_SUCCESS) {
+        app_perror("   error: unable to register module", status);
+        return -200;
+    }
+
+    msg_log_enabled = msg_logger_set_enabled(0);
+    pool = pjsip_endpt_create_pool(endpt, "largemsg", 512, 512);
+    pj_bzero(&lm_g, sizeof(lm_g));
+
+    pj_ansi_snprintf(target_url, sizeof(target_url), "sip:large@%s",
+                     host_port_param);
+    target = pj_str(target_url);
+    from = pj_str("<sip:large_msg_test@example.com>");
+    call_id = pj_str(LARGE_MSG_CALL_ID);
+    pjsip_method_set(&method, PJSIP_OPTIONS_METHOD);
+
+    for (i=0; i<PJ_ARRAY_SIZE(body_len); ++i) {
+        pjsip_tx_data *tdata;
+
+        body.ptr = (char*)pj_pool_alloc(pool, body_len[i]);
+        body.slen = body_len[i];
+        pj_memset(body.ptr, 'a' + i, body.slen);
+
+        status = pjsip_endpt_create_request(endpt, &method, &target, &from,
+                                            &target, NULL, &call_id, i+1,
+                                            &body, &tdata);
+        if (status != PJ_SUCCESS) {
+            app_perror("   error: unable to create request", status);
+            rc = -210;
+            goto on_return;
+        }
+
+        /* Encode in a buffer large enough for the message */
+        tdata->buf.start = (char*)pj_pool_alloc(tdata->pool,
+                                                body_len[i] + 1000);
+        tdata->buf.cur = tdata->buf.start;
+        tdata->buf.end = tdata->buf.start + body_len[i] + 1000;
+
+        status = pjsip_endpt_send_request_stateless(endpt, tdata, NULL, NULL);
+        if (status != PJ_SUCCESS) {
+            app_perror("   error: unable to send request", status);
+            pjsip_tx_data_dec_ref(tdata);
+            rc = -220;
+            goto on_return;
+        }
+    }
+
+    pj_gettimeofday(&timeout);
+    timeout.sec += 2;
+    while (lm_g.rx_cnt < (int)PJ_ARRAY_SIZE(body_len)) {
+        pj_time_val now, poll_interval = { 0, 10 };
+
+        pj_gettimeofday(&now);
+        if (PJ_TIME_VAL_GTE(now, timeout)) {
+            PJ_LOG(3,(THIS_FILE, "   error: only %d of %d messages received",
+                      lm_g.rx_cnt, (int)PJ_ARRAY_SIZE(body_len)));
+            rc = -230;
+            goto on_return;
+        }
+        pjsip_endpt_handle_events(endpt, &poll_interval);
+    }
+
+    for (i=0; i<PJ_ARRAY_SIZE(body_len); ++i) {
+        if (lm_g.rx_body_len[i] != body_len[i]) {
+            PJ_LOG(3,(THIS_FILE, "   error: message %d body is %d bytes, "
+                      "expecting %d", i, (int)lm_g.rx_body_len[i],
+                      (int)body_len[i]));
+            rc = -240;
+            goto on_return;
+        }
+    }
+
+on_return:
+    pj_pool_release(pool);
+    msg_logger_set_enabled(msg_log_enabled);
+    pjsip_endpt_unregister_module(endpt, &large_msg_module);
+    return rc;
+}
+
+/*
+ * Transport group: connections are used in turn, and closed ones are
+ * skipped and replaced.
+ */
+static int tpgroup_test(pjsip_tpfactory *factory)
+{
+    enum { CONN_CNT = 3 };
+    pjsip_tpgroup_cfg cfg;
+    pjsip_tpgroup *grp;
+    pjsip_transport *tp[CONN_CNT+1], *closed;
+    pj_sockaddr_in rem_addr;
+    unsigned i, j;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  transport group test..."));
+
+    pj_sockaddr_in_init(&rem_addr, &factory->addr_name.host,
+                        (pj_uint16_t)factory->addr_name.port);
+
+    pjsip_tpgroup_cfg_default(&cfg);
+    cfg.conn_cnt = CONN_CNT;
+    cfg.check_interval = 1;
+    status = pjsip_tpmgr_create_tpgroup(pjsip_endpt_get_tpmgr(endpt),
+                                        PJSIP_TRANSPORT_TCP, &rem_addr,
+                                        sizeof(rem_addr), NULL, &cfg, &grp);
+    if (status != PJ_SUCCESS) {
+        app_perror("   error: unable to create transport group", status);
+        return -300;
+    }
+
+    if (pjsip_tpgroup_get_conn_cnt(grp) != CONN_CNT) {
+        rc = -310;
+        goto on_return;
+    }
+
+    /* Round-robin over the connections */
+    for (i = 0; i <= CONN_CNT; ++i) {
+        status = pjsip_endpt_acquire_transport(endpt, PJSIP_TRANSPORT_TCP,
+                                               &rem_addr, sizeof(rem_addr),
+                                               NULL, &tp[i]);
+        if (status != PJ_SUCCESS) {
+            app_perror("   error: unable to acquire transport", status);
+            for (j = 0; j < i; ++j)
+                pjsip_transport_dec_ref(tp[j]);
+            rc = -320;
+            goto on_return;
+        }
+    }
+    for (i = 0; i < CONN_CNT; ++i) {
+        for (j = i+1; j < CONN_CNT; ++j) {
+            if (tp[i] == tp[j])
+                rc = -330;
+        }
+    }
+    if (tp[CONN_CNT] != tp[0])
+        rc = -340;
+    for (i = 0; i <= CONN_CNT; ++i)
+        pjsip_transport_dec_ref(tp[i]);
+    if (rc != 0)
+        goto on_return;
+
+    /* A closed connection is not used */
+    closed = tp[0];
+    pjsip_transport_shutdown(closed);
+    for (i = 0; i < CONN_CNT && rc == 0; ++i) {
+        pjsip_transport *t;
+
+        status = pjsip_endpt_acquire_transport(endpt, PJSIP_TRANSPORT_TCP,
+                                               &rem_addr, sizeof(rem_addr),
+                                               NULL, &t);
+        if (status != PJ_SUCCESS) {
+            rc = -350;
+            break;
+        }
+        if (t == closed)
+            rc = -360;
+        pjsip_transport_dec_ref(t);
+    }
+    if (rc != 0)
+        goto on_return;
+
+    /* And is replaced on the next check */
+    flush_events(1500);
+    if (pjsip_tpgroup_get_conn_cnt(grp) != CONN_CNT)
+        rc = -370;
+
+on_return:
+    pjsip_tpgroup_destroy(grp);
+    return rc;
+}
+
 int transport_tcp_test(void)
 {
     enum { SEND_RECV_LOOP = 8 };
@@ -216,6 +452,15 @@ int transport_tcp_test(void)
     if (pkt_lost != 0)
         PJ_LOG(3,(THIS_FILE, "   note: %d packet(s) was lost", pkt_lost));
 
+    /* Messages larger than the receive buffer */
+    status = large_msg_test(host_port_param);
+    if (status != 0) {
+        for (i = 0; i < num_tp ; ++i) {
+            pjsip_transport_dec_ref(tcp[i]);
+        }
+        return status;
+    }
+
     /* Load test */
     if ((status=transport_load_test(PJSIP_TRANSPORT_TCP,
                                     host_port_param)) != 0)
@@ -223,6 +468,15 @@ int transport_tcp_test(void)
         return status;
     }
 
+    /* Connection group */
+    status = tpgroup_test(tpfactory[0]);
+    if (status != 0) {
+        for (i = 0; i < num_tp ; ++i) {
+            pjsip_transport_dec_ref(tcp[i]);
+        }
+        return status;
+    }
+
     /* Check again that reference counter is still 1. */
     for (i = 0; i < num_tp; ++i) {
         if (pj_atomic_get(tcp[i]->ref_cnt) != 1)
@@ -118,6 +118,241 @@ on_return:
 #undef ERR
 }
 
+/* Transport cache: the cached transport is used as long as no transport
+ * is registered or destroyed.
+ */
+static int tpcache_test(pjsip_transport *tp[], unsigned num_tp)
+{
+#define ERR(rc__)   { rc=rc__; goto on_return; }
+    pjsip_tpmgr *tpmgr = pjsip_endpt_get_tpmgr(endpt);
+    pj_pool_t *pool;
+    pj_grp_lock_t *grp_lock = NULL;
+    pjsip_tpcache cache;
+    pjsip_tx_data *tdata = NULL;
+    pjsip_transport *acq_tp = NULL, *cached_tp = NULL, *new_tp = NULL;
+    pj_sockaddr_in rem_addr, addr;
+    pj_str_t s;
+    unsigned i;
+    int rc;
+
+    pool = pjsip_endpt_create_pool(endpt, "tpcache", 512, 512);
+    PJ_TEST_SUCCESS(pj_grp_lock_create(pool, NULL, &grp_lock), NULL,
+                    ERR(-200));
+    pj_grp_lock_add_ref(grp_lock);
+    pjsip_tpcache_init(&cache, grp_lock);
+
+    PJ_TEST_SUCCESS(pjsip_endpt_create_tdata(endpt, &tdata), NULL, ERR(-205));
+    pjsip_tx_data_add_ref(tdata);
+    PJ_TEST_SUCCESS(pjsip_tx_data_set_tpcache(tdata, &cache), NULL,
+                    ERR(-210));
+
+    /* First acquisition looks up the transport and fills the cache */
+    pj_sockaddr_in_init(&rem_addr, pj_cstr(&s, "1.1.1.1"), 80);
+    PJ_TEST_SUCCESS(pjsip_tpmgr_acquire_transport2(tpmgr, PJSIP_TRANSPORT_UDP,
+                                                   &rem_addr,
+                                                   sizeof(rem_addr), NULL,
+                                                   tdata, &acq_tp),
+                    NULL, ERR(-220));
+    PJ_TEST_EQ(cache.tp, acq_tp, NULL, ERR(-225));
+
+    /* Plant another transport in the cache, to see that the next
+     * acquisition takes it from the cache rather than from the lookup.
+     */
+    for (i=0; i<num_tp && tp[i]==acq_tp; ++i)
+        ;
+    PJ_TEST_LT(i, num_tp, NULL, ERR(-230));
+    cached_tp = tp[i];
+    pj_grp_lock_add_ref(cached_tp->grp_lock);
+    pj_grp_lock_dec_ref(acq_tp->grp_lock);
+    cache.tp = cached_tp;
+    pjsip_transport_dec_ref(acq_tp);
+    acq_tp = NULL;
+
+    PJ_TEST_SUCCESS(pjsip_tpmgr_acquire_transport2(tpmgr, PJSIP_TRANSPORT_UDP,
+                                                   &rem_addr,
+                                                   sizeof(rem_addr), NULL,
+                                                   tdata, &acq_tp),
+                    NULL, ERR(-240));
+    PJ_TEST_EQ(acq_tp, cached_tp, NULL, ERR(-245));
+    PJ_TEST_EQ(pj_atomic_get(cached_tp->ref_cnt), 2, NULL, ERR(-250));
+    pjsip_transport_dec_ref(acq_tp);
+    acq_tp = NULL;
+
+    /* Registering a transport invalidates the cache */
+    pj_sockaddr_in_init(&addr, NULL, (pj_uint16_t)(TEST_UDP_PORT+num_tp));
+    PJ_TEST_SUCCESS(pjsip_udp_transport_start(endpt, &addr, NULL, 1,
+                                              &new_tp),
+                    NULL, ERR(-260));
+    PJ_TEST_SUCCESS(pjsip_tpmgr_acquire_transport2(tpmgr, PJSIP_TRANSPORT_UDP,
+                                                   &rem_addr,
+                                                   sizeof(rem_addr), NULL,
+                                                   tdata, &acq_tp),
+                    NULL, ERR(-270));
+    PJ_TEST_NEQ(acq_tp, cached_tp, NULL, ERR(-275));
+    PJ_TEST_EQ(cache.tp, acq_tp, NULL, ERR(-280));
+
+    rc = 0;
+
+on_return:
+    if (acq_tp)
+        pjsip_transport_dec_ref(acq_tp);
+    if (new_tp) {
+        pjsip_transport_dec_ref(new_tp);
+        pjsip_transport_destroy(new_tp);
+    }
+    if (tdata)
+        pjsip_tx_data_dec_ref(tdata);
+    if (grp_lock) {
+        pjsip_tpcache_clear(&cache);
+        pj_grp_lock_dec_ref(grp_lock);
+    }
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+#undef ERR
+}
+
+/* Wait for a packet on the socket and read it */
+static pj_status_t recv_raw(pj_sock_t sock, char *buf, pj_ssize_t *len,
+                            pj_sockaddr *src_addr, int *addr_len)
+{
+    pj_fd_set_t rset;
+    pj_time_val timeout = { 2, 0 };
+
+    PJ_FD_ZERO(&rset);
+    PJ_FD_SET(sock, &rset);
+    if (pj_sock_select((int)sock+1, &rset, NULL, NULL, &timeout) != 1)
+        return PJ_ETIMEDOUT;
+
+    return pj_sock_recvfrom(sock, buf, len, 0, src_addr, addr_len);
+}
+
+/* Multiple sockets and read slots, and packet statistics. */
+static int stat_test(void)
+{
+#define ERR(rc__)   { rc=rc__; goto on_return; }
+    static const char resp[] =
+        "SIP/2.0 200 OK\r\n"
+        "Via: SIP/2.0/UDP 127.0.0.1:5060;branch=z9hG4bKudp-stat-test\r\n"
+        "From: <sip:alice@127.0.0.1>;tag=1\r\n"
+        "To: <sip:bob@127.0.0.1>;tag=2\r\n"
+        "Call-ID: udp-stat-test\r\n"
+        "CSeq: 1 OPTIONS\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n";
+    static const char garbage[] =
+        "This is not a SIP message, although it is long enough to be one\r\n"
+        "\r\n";
+    static const char short_pkt[] = "hello";
+    pjsip_udp_transport_cfg cfg;
+    pjsip_udp_transport_stat stat, sock_stat;
+    pjsip_transport *tp = NULL;
+    pjsip_tpselector sel;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_sockaddr addr, src_addr;
+    pj_str_t s;
+    char buf[512];
+    pj_ssize_t len;
+    pj_uint64_t rx_pkt;
+    int i, addr_len, rc;
+
+    pjsip_udp_transport_cfg_default(&cfg, pj_AF_INET());
+    pj_sockaddr_init(pj_AF_INET(), &cfg.bind_addr, pj_cstr(&s, "127.0.0.1"),
+                     0);
+    cfg.async_cnt = 2;
+    cfg.sock_cnt = 2;
+    cfg.rcvbuf_size = 256 * 1024;
+    cfg.sndbuf_size = 256 * 1024;
+
+    rc = pjsip_udp_transport_start2(endpt, &cfg, &tp);
+    if (rc == PJ_ENOTSUP) {
+        PJ_LOG(3,(THIS_FILE, "   SO_REUSEPORT not supported, using single "
+                             "socket"));
+        cfg.sock_cnt = 1;
+        rc = pjsip_udp_transport_start2(endpt, &cfg, &tp);
+    }
+    PJ_TEST_SUCCESS(rc, NULL, ERR(-300));
+
+    PJ_TEST_SUCCESS(pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock),
+                    NULL, ERR(-305));
+    pj_sockaddr_init(pj_AF_INET(), &addr, pj_cstr(&s, "127.0.0.1"), 0);
+    PJ_TEST_SUCCESS(pj_sock_bind(sock, &addr, pj_sockaddr_get_len(&addr)),
+                    NULL, ERR(-310));
+    addr_len = sizeof(addr);
+    PJ_TEST_SUCCESS(pj_sock_getsockname(sock, &addr, &addr_len), NULL,
+                    ERR(-315));
+
+    /* Send a packet from the transport */
+    pj_bzero(&sel, sizeof(sel));
+    sel.type = PJSIP_TPSELECTOR_TRANSPORT;
+    sel.u.transport = tp;
+    rc = pjsip_tpmgr_send_raw(pjsip_endpt_get_tpmgr(endpt),
+                              PJSIP_TRANSPORT_UDP, &sel, NULL, resp,
+                              sizeof(resp)-1, &addr, addr_len, NULL, NULL);
+    PJ_TEST_TRUE(rc==PJ_SUCCESS || rc==PJ_EPENDING, NULL, ERR(-320));
+
+    len = sizeof(buf);
+    addr_len = sizeof(src_addr);
+    PJ_TEST_SUCCESS(recv_raw(sock, buf, &len, &src_addr, &addr_len), NULL,
+                    ERR(-325));
+    PJ_TEST_EQ(len, (pj_ssize_t)sizeof(resp)-1, NULL, ERR(-330));
+
+    PJ_TEST_SUCCESS(pjsip_udp_transport_get_stat(tp, -1, &stat), NULL,
+                    ERR(-335));
+    PJ_TEST_EQ(stat.tx_pkt, 1, NULL, ERR(-340));
+    PJ_TEST_EQ(stat.tx_bytes, sizeof(resp)-1, NULL, ERR(-345));
+
+    /* Send a valid message, a malformed one, and one too short */
+    len = sizeof(resp)-1;
+    PJ_TEST_SUCCESS(pj_sock_sendto(sock, resp, &len, 0, &src_addr, addr_len),
+                    NULL, ERR(-350));
+    len = sizeof(garbage)-1;
+    PJ_TEST_SUCCESS(pj_sock_sendto(sock, garbage, &len, 0, &src_addr,
+                                   addr_len),
+                    NULL, ERR(-355));
+    len = sizeof(short_pkt)-1;
+    PJ_TEST_SUCCESS(pj_sock_sendto(sock, short_pkt, &len, 0, &src_addr,
+                                   addr_len),
+                    NULL, ERR(-360));
+
+    for (i=0; i<20; ++i) {
+        flush_events(100);
+        pjsip_udp_transport_get_stat(tp, -1, &stat);
+        if (stat.rx_pkt + stat.rx_drop >= 3)
+            break;
+    }
+
+    PJ_TEST_EQ(stat.rx_pkt, 2, NULL, ERR(-365));
+    PJ_TEST_EQ(stat.rx_bytes, sizeof(resp)-1 + sizeof(garbage)-1, NULL,
+               ERR(-370));
+    PJ_TEST_EQ(stat.rx_parse_err, 1, NULL, ERR(-375));
+    PJ_TEST_EQ(stat.rx_drop, 1, NULL, ERR(-380));
+    PJ_TEST_EQ(stat.rx_err, 0, NULL, ERR(-385));
+
+    /* Per socket statistics add up to the total */
+    rx_pkt = 0;
+    for (i=0; i<(int)cfg.sock_cnt; ++i) {
+        PJ_TEST_SUCCESS(pjsip_udp_transport_get_stat(tp, i, &sock_stat),
+                        NULL, ERR(-390));
+        rx_pkt += sock_stat.rx_pkt;
+    }
+    PJ_TEST_EQ(rx_pkt, stat.rx_pkt, NULL, ERR(-395));
+
+    PJ_TEST_EQ(pjsip_udp_transport_get_stat(tp, cfg.sock_cnt, &sock_stat),
+               PJ_EINVAL, NULL, ERR(-400));
+
+    rc = 0;
+
+on_return:
+    if (sock != PJ_INVALID_SOCKET)
+        pj_sock_close(sock);
+    if (tp) {
+        pjsip_transport_dec_ref(tp);
+        pjsip_transport_destroy(tp);
+    }
+    return rc;
+#undef ERR
+}
+
 /*
  * UDP transport test.
  */
@@ -136,6 +371,14 @@ int transport_udp_test(void)
     if (status != PJ_SUCCESS)
         return status;
 
+    status = tpcache_test(&tp[0], NUM_TP);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    status = stat_test();
+    if (status != PJ_SUCCESS)
+        return status;
+
     /* Basic transport's send/receive loopback test. */
     pj_sockaddr_in_init(&rem_addr, pj_cstr(&s, "127.0.0.1"), TEST_UDP_PORT);
     for (i=0; i<SEND_RECV_LOOP; ++i) {
@@ -191,9 +191,126 @@ on_error:
 
 
 
+/* Transaction lookup from several worker threads at once */
+typedef struct lookup_worker
+{
+    pj_thread_t     *thread;
+    pj_str_t        *keys;
+    unsigned         key_cnt;
+    unsigned         start;
+    unsigned         loop;
+    unsigned         found;
+} lookup_worker;
+
+static int lookup_worker_thread(void *arg)
+{
+    lookup_worker *w = (lookup_worker*)arg;
+    unsigned i, idx = w->start;
+
+    for (i=0; i<w->loop; ++i) {
+        pjsip_transaction *tsx;
+
+        tsx = pjsip_tsx_layer_find_tsx2(&w->keys[idx], PJ_TRUE);
+        if (tsx) {
+            ++w->found;
+            pj_grp_lock_dec_ref(tsx->grp_lock);
+        }
+        if (++idx == w->key_cnt)
+            idx = 0;
+    }
+    return 0;
+}
+
+static int lookup_tsx_bench(unsigned working_set, unsigned loop,
+                            unsigned thread_cnt, pj_timestamp *p_elapsed)
+{
+    unsigned i;
+    pj_pool_t *pool;
+    pjsip_tx_data *request;
+    pjsip_transaction **tsx;
+    pj_str_t *keys;
+    lookup_worker *workers;
+    pj_timestamp t1, t2;
+    pjsip_via_hdr *via;
+    int rc = 0;
+
+    pj_str_t str_target = pj_str("sip:someuser@someprovider.com");
+    pj_str_t str_from = pj_str("\"Local User\" <sip:tsx_bench@serviceprovider.com>");
+    pj_str_t str_to = pj_str("\"Remote User\" <sip:remoteuser@serviceprovider.com>");
+    pj_str_t str_contact = str_from;
+
+    PJ_TEST_SUCCESS(pjsip_endpt_create_request(endpt, &pjsip_invite_method,
+                                        &str_target, &str_from, &str_to,
+                                        &str_contact, NULL, -1, NULL,
+                                        &request),
+                    NULL, return -310);
+
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(request->msg, PJSIP_H_VIA,
+                                              NULL);
+
+    pool = pjsip_endpt_create_pool(endpt, "tsxlookup", 4000, 4000);
+    tsx = (pjsip_transaction**)
+          pj_pool_zalloc(pool, working_set * sizeof(pjsip_transaction*));
+    keys = (pj_str_t*) pj_pool_zalloc(pool, working_set * sizeof(pj_str_t));
+    workers = (lookup_worker*)
+              pj_pool_zalloc(pool, thread_cnt * sizeof(lookup_worker));
+
+    pj_bzero(&mod_tsx_user, sizeof(mod_tsx_user));
+    mod_tsx_user.id = -1;
+
+    for (i=0; i<working_set; ++i) {
+        PJ_TEST_SUCCESS(pjsip_tsx_create_uac(&mod_tsx_user, request, &tsx[i]),
+                        NULL, {rc=-320; goto on_error;});
+        pj_strdup(pool, &keys[i], &tsx[i]->transaction_key);
+
+        /* Reset branch param */
+        via->branch_param.slen = 0;
+    }
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<thread_cnt; ++i) {
+        workers[i].keys = keys;
+        workers[i].key_cnt = working_set;
+        workers[i].start = i * working_set / thread_cnt;
+        workers[i].loop = loop / thread_cnt;
+        PJ_TEST_SUCCESS(pj_thread_create(pool, "tsxlookup%p",
+                                         &lookup_worker_thread, &workers[i],
+                                         0, 0, &workers[i].thread),
+                        NULL, {rc=-330; break;});
+    }
+    for (i=0; i<thread_cnt; ++i) {
+        if (workers[i].thread) {
+            pj_thread_join(workers[i].thread);
+            pj_thread_destroy(workers[i].thread);
+        }
+    }
+    pj_get_timestamp(&t2);
+    pj_sub_timestamp(&t2, &t1);
+    p_elapsed->u64 = t2.u64;
+
+    for (i=0; rc==0 && i<thread_cnt; ++i) {
+        PJ_TEST_EQ(workers[i].found, workers[i].loop, NULL, rc=-340);
+    }
+
+on_error:
+    for (i=0; i<working_set; ++i) {
+        if (tsx[i]) {
+            pjsip_tsx_terminate(tsx[i], 601);
+            tsx[i] = NULL;
+            pj_timer_heap_poll(pjsip_endpt_get_timer_heap(endpt), NULL);
+        }
+    }
+    pjsip_tx_data_dec_ref(request);
+    pj_pool_release(pool);
+    flush_events(2000);
+    return rc;
+}
+
+
 int tsx_bench(void)
 {
-    enum { WORKING_SET=10000, REPEAT = 4 };
+    enum { WORKING_SET=10000, REPEAT = 4, LOOKUP_LOOP = 1600000 };
+    static const unsigned lookup_threads[] = { 1, 4, 8, 16 };
     unsigned i, speed;
     pj_timestamp usec[REPEAT], min, freq;
     char desc[250];
@@ -286,6 +403,33 @@ int tsx_bench(void)
     report_ival("create-uas-tsx-per-sec", 
                 speed, "tsx/sec", desc);
 
+
+    /*
+     * Benchmark concurrent lookup
+     */
+    PJ_LOG(3,(THIS_FILE, "   benchmarking concurrent transaction lookup:"));
+    for (i=0; i<PJ_ARRAY_SIZE(lookup_threads); ++i) {
+        char name[40];
+
+        status = lookup_tsx_bench(WORKING_SET, LOOKUP_LOOP,
+                                  lookup_threads[i], &usec[0]);
+        if (status != PJ_SUCCESS)
+            return status;
+
+        speed = (unsigned)(freq.u64 * LOOKUP_LOOP / usec[0].u64);
+        PJ_LOG(3,(THIS_FILE, "    %2d thread(s): %d lookup/sec",
+                  lookup_threads[i], speed));
+
+        pj_ansi_snprintf(name, sizeof(name), "lookup-tsx-%d-threads-per-sec",
+                         lookup_threads[i]);
+        pj_ansi_snprintf(desc, sizeof(desc),
+                         "Number of transaction lookups per second with "
+                         "<tt>pjsip_tsx_layer_find_tsx2()</tt> from %d "
+                         "threads, among %d transactions.",
+                         lookup_threads[i], WORKING_SET);
+        report_ival(name, speed, "lookup/sec", desc);
+    }
+
     return PJ_SUCCESS;
 }
 
@@ -1299,6 +1299,47 @@ static int tsx_uac_retransmit_test(unsigned tid)
     return status;
 }
 
+/*
+ * Same as above, with retransmissions scheduled in the retransmission
+ * wheel of the transaction layer instead of in the timer heap.
+ */
+static int tsx_uac_retrans_wheel_test(unsigned tid)
+{
+    const pjsip_method *methods[] =
+    {
+        &pjsip_invite_method,
+        &pjsip_options_method
+    };
+    pj_bool_t prev_wheel = pjsip_cfg()->tsx.retrans_wheel;
+    int status = 0, enabled;
+    int i;
+
+    PJ_LOG(3,(THIS_FILE, "  test1: uac retransmit and timeout test with "
+                         "retransmission wheel"));
+
+    enabled = msg_logger_set_enabled(0);
+    pjsip_cfg()->tsx.retrans_wheel = PJ_TRUE;
+
+    for (i=0; i<(int)PJ_ARRAY_SIZE(methods); ++i) {
+        PJ_LOG(3,(THIS_FILE, "   variant %c: %s", ('a' + i),
+                  methods[i]->name.ptr));
+
+        if (g[tid].test_param->type == PJSIP_TRANSPORT_LOOP_DGRAM)
+            pjsip_loop_set_failure(g[tid].loop, 0, NULL);
+
+        status = perform_tsx_test(tid, -510, g[tid].TARGET_URI,
+                                  g[tid].FROM_URI, TEST1_BRANCH_ID,
+                                  35, methods[i]);
+        if (status != 0)
+            break;
+    }
+
+    pjsip_cfg()->tsx.retrans_wheel = prev_wheel;
+    msg_logger_set_enabled(enabled);
+
+    return status;
+}
+
 /*****************************************************************************
  **
  ** TEST2_BRANCH_ID: UAC resolve error test.
@@ -1549,6 +1590,12 @@ int tsx_uac_test(unsigned tid)
     if (status != 0)
         goto on_return;
 
+    if ((g[tid].tp_flag & PJSIP_TRANSPORT_RELIABLE) == 0) {
+        status = tsx_uac_retrans_wheel_test(tid);
+        if (status != 0)
+            goto on_return;
+    }
+
     /* TEST2_BRANCH_ID: Resolve error test. */
     status = tsx_resolve_error_test(tid);
     if (status != 0)
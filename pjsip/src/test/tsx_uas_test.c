@@ -1649,6 +1649,29 @@ static int tsx_ack_test(unsigned tid)
     return 0;
 }
 
+/*
+ * Same as test7 to test9, with retransmissions of the final response
+ * scheduled in the retransmission wheel of the transaction layer instead
+ * of in the timer heap.
+ */
+static int tsx_uas_retrans_wheel_test(unsigned tid)
+{
+    pj_bool_t prev_wheel = pjsip_cfg()->tsx.retrans_wheel;
+    int status;
+
+    PJ_LOG(3,(THIS_FILE, "  test7 to test9 with retransmission wheel"));
+
+    pjsip_cfg()->tsx.retrans_wheel = PJ_TRUE;
+
+    status = tsx_final_response_retransmission_test(tid);
+    if (status == 0)
+        status = tsx_ack_test(tid);
+
+    pjsip_cfg()->tsx.retrans_wheel = prev_wheel;
+
+    return status;
+}
+
 
 
 /*****************************************************************************
@@ -1838,6 +1861,15 @@ int tsx_uas_test(unsigned tid)
             goto on_return;
     }
 
+    /* TEST7_BRANCH_ID to TEST9_BRANCH_ID again, with the retransmission
+     * wheel. Only applicable for non-reliable transports.
+     */
+    if ((g[tid].tp_flag & PJSIP_TRANSPORT_RELIABLE) == 0) {
+        status = tsx_uas_retrans_wheel_test(tid);
+        if (status != 0)
+            goto on_return;
+    }
+
     /* TEST10_BRANCH_ID: test transport failure in TRYING state.
      * TEST11_BRANCH_ID: test transport failure in PROCEEDING state.
      * TEST12_BRANCH_ID: test transport failure in CONNECTED state.
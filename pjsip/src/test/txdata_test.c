@@ -624,6 +624,41 @@ static int txdata_test_uri_params(void)
 }
 
 
+/*
+ * Transmit data pools are recycled by the transport manager.
+ */
+static int tdata_recycle_test(void)
+{
+    enum { RECYCLE_LOOP = 100 };
+    pjsip_tx_data *tdata;
+    pj_pool_t *last_pool = NULL;
+    unsigned i, reused = 0;
+
+    PJ_LOG(3,(THIS_FILE, "   tdata pool recycling test"));
+
+    for (i=0; i<RECYCLE_LOOP; ++i) {
+        PJ_TEST_SUCCESS(pjsip_endpt_create_tdata(endpt, &tdata), NULL,
+                        return -800);
+        if (tdata->pool == last_pool)
+            ++reused;
+        last_pool = tdata->pool;
+
+        pjsip_tx_data_add_ref(tdata);
+        PJ_TEST_EQ(pjsip_tx_data_dec_ref(tdata), PJSIP_EBUFDESTROYED, NULL,
+                   return -810);
+    }
+
+    /* Other tests may run concurrently and take the pool, but not always */
+#if PJSIP_TDATA_POOL_CACHE_SIZE
+    PJ_TEST_GT(reused, 0, "tdata pool was never recycled", return -820);
+#else
+    PJ_UNUSED_ARG(reused);
+#endif
+
+    return 0;
+}
+
+
 /*
  * create request benchmark
  */
@@ -795,6 +830,10 @@ int txdata_test(void)
     if (status != 0)
         return status;
 
+    status = tdata_recycle_test();
+    if (status != 0)
+        return status;
+
 
     /*
      * Benchmark create_request()